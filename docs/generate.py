@@ -91,7 +91,7 @@ def format_af(lf, af):
     ret = ret.replace("<", "&lt;").replace(">", "&gt;")
     ret = link_custom_type(ret)
     name = lf["name"]
-    param = af["param"].replace("vector<", "array<")
+    param = af["param"].replace("vector<", "array<").replace("span<", "array<")
     param = link_custom_type(param)
     fun = f"{ret} {name}({param})".strip()
     return fun
@@ -183,6 +183,8 @@ In safe mode (default) the following standard and custom functions are available
 - `io.type`
 - `io.open_data`: like `io.open` but restricted to base directory `Mods/Data/modname`
 - `io.open_mod`: like `io.open` but restricted to the mod directory
+- `io.map_data`: maps a file from `Mods/Data/modname` read only into memory and returns a [MappedFile](#MappedFile), or nil if it can't be opened
+- `io.map_mod`: like `io.map_data` but for the mod directory
 
 Safely opened files can be used normally through the `file:` handle. Files and folders opened in write mode are automatically created.
 
@@ -231,7 +233,14 @@ set_callback(function(load_ctx)
         some_mod_data_that_should_be_saved = json.decode(load_data_str)
     end
 end, ON.LOAD)
-```"""
+```
+
+`json` is implemented natively with the same interface and errors as [rxi/json.lua](https://github.com/rxi/json.lua). `json.decode` also accepts a [MappedFile](#MappedFile) from `io.map_data` or `io.map_mod`, which parses big files straight from the mapping without reading them into a string first."""
+)
+print("\n## binser")
+print(
+    """`binser.pack(value, compress)` turns a value into a compact binary string and `binser.unpack(data)` turns it back. It's native and much faster than `json` for big tables, can be used the same way for save data and network messages.
+Supports nil, booleans, numbers, strings and tables of those, a table that is referenced multiple times or from itself comes back the same way. Metatables are not kept. Pass `true` for `compress` to compress the result where that makes it smaller."""
 )
 print("\n## inspect")
 include_example("inspect")
@@ -738,7 +747,7 @@ Type | Name | Description
                             ret = m.group(1) or "nil"
                             name = m.group(2)
                             if m.group(3):
-                                param = m.group(3).strip().replace("vector<", "array<") + ")"
+                                param = m.group(3).strip().replace("vector<", "array<").replace("span<", "array<") + ")"
                             signature = name + param
                     signature = signature.strip()
                     ret = ret.replace("<", "&lt;").replace(">", "&gt;")
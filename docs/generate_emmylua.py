@@ -228,15 +228,28 @@ prng = nil
 exports = nil
 
 ---The json library converts tables to json and json to tables
----Check https://github.com/rxi/json.lua for more information
+---Native, same interface as https://github.com/rxi/json.lua, decode also takes a MappedFile
 ---@class Json
----@field decode fun(str: string): table @Decode a json string into a table
+---@field decode fun(str: string|MappedFile): table @Decode a json string into a table
 ---@field encode fun(tbl: table): string @Encode a table into a json string
 ---@type Json
 json = nil
 
+---Native binary serializer, faster and smaller than json for big tables
+---@class Binser
+---@field pack fun(value: any, compress: boolean?): string @Pack a value into a binary string
+---@field unpack fun(data: string): any @Unpack a value packed with binser.pack
+---@type Binser
+binser = nil
+
 io.open_data = io.open
 io.open_mod = io.open
+---@param filename string
+---@return MappedFile?
+function io.map_data(filename) end
+---@param filename string
+---@return MappedFile?
+function io.map_mod(filename) end
 os.remove_data = os.remove
 os.remove_mod = os.remove
 """)
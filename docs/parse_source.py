@@ -74,6 +74,8 @@ header_files = [
     "../src/game_api/math.hpp",
     "../src/game_api/rpc.hpp",
     "../src/game_api/entity_lookup.hpp",
+    "../src/game_api/entity_fields.hpp",
+    "../src/game_api/navigation.hpp",
     "../src/game_api/drops.hpp",
     "../src/game_api/spawn_api.hpp",
     "../src/game_api/script.hpp",
@@ -106,6 +108,9 @@ header_files = [
     "../src/game_api/savedata.hpp",
     "../src/game_api/level_api.hpp",
     "../src/game_api/level_api_types.hpp",
+    "../src/game_api/level_gen_stats.hpp",
+    "../src/game_api/gpu_timing.hpp",
+    "../src/game_api/frame_limiter.hpp",
     "../src/game_api/items.hpp",
     "../src/game_api/screen.hpp",
     "../src/game_api/screen_arena.hpp",
@@ -118,6 +123,7 @@ header_files = [
     "../src/game_api/script/usertypes/save_context.hpp",
     "../src/game_api/script/usertypes/hitbox_lua.hpp",
     "../src/game_api/script/usertypes/socket_lua.hpp",
+    "../src/game_api/script/usertypes/point_buffer_lua.hpp",
     "../src/imgui/imgui.h",
     "../src/game_api/script/usertypes/level_lua.cpp",
     "../src/game_api/script/usertypes/gui_lua.cpp",
@@ -126,6 +132,10 @@ header_files = [
     "../src/game_api/bucket.hpp",
     "../src/game_api/socket.hpp",
     "../src/game_api/savestate.hpp",
+    "../src/game_api/savestate_ring.hpp",
+    "../src/game_api/state_tree.hpp",
+    "../src/game_api/state_hash.hpp",
+    "../src/game_api/script/callback_profiler.hpp",
     "../src/game_api/game_patches.hpp",
     "../src/game_api/liquid_engine.hpp",
 ]
@@ -169,6 +179,8 @@ api_files = [
     "../src/game_api/script/usertypes/screen_lua.cpp",
     "../src/game_api/script/usertypes/screen_arena_lua.cpp",
     "../src/game_api/script/usertypes/socket_lua.cpp",
+    "../src/game_api/script/usertypes/mapped_file_lua.cpp",
+    "../src/game_api/script/usertypes/point_buffer_lua.cpp",
     "../src/game_api/script/usertypes/steam_lua.cpp",
     "../src/game_api/script/usertypes/logic_lua.cpp",
     "../src/game_api/script/usertypes/bucket_lua.cpp",
@@ -177,6 +189,8 @@ api_files = [
     "../src/game_api/script/usertypes/spawn_lua.cpp",
     "../src/game_api/script/usertypes/options_lua.cpp",
     "../src/game_api/script/usertypes/game_patches_lua.cpp",
+    "../src/game_api/script/usertypes/entity_lookup_lua.cpp",
+    "../src/game_api/script/usertypes/navigation_lua.cpp",
 ]
 vtable_api_files = [
     "../src/game_api/script/usertypes/vtables_lua.cpp",
@@ -928,6 +942,28 @@ def run_parse():
                         "function": True,
                     }
                 )
+                if override_table == "ENTITY_OVERRIDE":
+                    vars.append(
+                        {
+                            "name": "set_pre_virtual_for_type",
+                            "signature": f"optional<CallbackId> set_pre_virtual_for_type(ENT_TYPE entity_type, {override_table} entry, function fun)",
+                            "comment": [
+                                "Hooks before the virtual function at index `entry` for every entity of `entity_type`, call it on the type, e.g. `Movable.set_pre_virtual_for_type(ENT_TYPE.MONS_SNAKE, ENTITY_OVERRIDE.DAMAGE, fun)`.",
+                                "Much cheaper than hooking every entity of the type when it spawns. Returns `nil` if `entry` can't be hooked from this type, clear it with `clear_callback`.",
+                            ],
+                            "function": True,
+                        }
+                    )
+                    vars.append(
+                        {
+                            "name": "set_post_virtual_for_type",
+                            "signature": f"optional<CallbackId> set_post_virtual_for_type(ENT_TYPE entity_type, {override_table} entry, function fun)",
+                            "comment": [
+                                "Hooks after the virtual function at index `entry` for every entity of `entity_type`, see `set_pre_virtual_for_type`."
+                            ],
+                            "function": True,
+                        }
+                    )
 
                 for entry in vtable["entries"].values():
                     entry_name = entry["name"]
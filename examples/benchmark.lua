@@ -0,0 +1,56 @@
+meta.name = "API benchmark"
+meta.version = "WIP"
+meta.description = "Times the common API calls from Lua, run it in a level to compare binding overhead between versions."
+meta.author = "Overlunky"
+
+local results = {}
+local run_draw = false
+
+local function run_level_benchmarks()
+    if #players < 1 then
+        print("Need a player in a level")
+        return
+    end
+    results = {}
+    local px, py, pl = get_position(players[1].uid)
+    local uids = get_entities_by(0, MASK.ANY, LAYER.BOTH)
+
+    table.insert(results, benchmark("get_entities_by", function()
+        get_entities_by(0, MASK.ANY, LAYER.BOTH)
+    end, 1000))
+    table.insert(results, benchmark("get_entities_by monsters", function()
+        get_entities_by(0, MASK.MONSTER, LAYER.PLAYER)
+    end))
+    local i = 0
+    table.insert(results, benchmark("get_entity", function()
+        i = i % #uids + 1
+        get_entity(uids[i])
+    end))
+    table.insert(results, benchmark("get_position", function()
+        i = i % #uids + 1
+        get_position(uids[i])
+    end))
+    table.insert(results, benchmark("entity field", function()
+        local ent = players[1]
+        local _ = ent.x + ent.y
+    end))
+    table.insert(results, benchmark("spawn and destroy", function()
+        get_entity(spawn(ENT_TYPE.ITEM_ROCK, px, py + 2, pl, 0, 0)):destroy()
+    end, 1000))
+    -- Draw calls only work in a draw callback, they run on the next GUIFRAME
+    run_draw = true
+end
+
+set_callback(function(ctx)
+    if not run_draw then return end
+    run_draw = false
+    table.insert(results, benchmark("draw_rect", function()
+        ctx:draw_rect(0, 0, 0.01, 0.01, 1, 0, 0x00000000)
+    end))
+    table.insert(results, benchmark("draw_text", function()
+        ctx:draw_text(0, 0, 0, "", 0x00000000)
+    end))
+    print(json.encode(results))
+end, ON.GUIFRAME)
+
+register_option_button("run", "Run benchmarks", "Prints the results as they finish and all of them as json at the end", run_level_benchmarks)
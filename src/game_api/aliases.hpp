@@ -151,6 +151,9 @@ enum class PAUSE_TRIGGER : int64_t
     SCREEN = 1 << 2,
     EXIT = 1 << 3,
     ONCE = 1 << 4,
+    SPAWN = 1 << 5,
+    TIME_LEVEL = 1 << 6,
+    SCRIPT_ERROR = 1 << 7,
 };
 ENUM_CLASS_FLAGS(PAUSE_TRIGGER);
 
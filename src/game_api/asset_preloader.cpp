@@ -0,0 +1,131 @@
+#include "asset_preloader.hpp"
+
+#include <algorithm>          // for max
+#include <atomic>             // for atomic
+#include <condition_variable> // for condition_variable
+#include <cstdint>            // for uint32_t
+#include <cstdio>             // for fopen_s, fread, fclose
+#include <deque>              // for deque
+#include <functional>         // for function
+#include <future>             // for promise, future
+#include <memory>             // for make_shared, shared_ptr
+#include <mutex>              // for mutex, lock_guard, unique_lock
+#include <thread>             // for thread
+#include <utility>            // for move
+
+#include "file_api.hpp"      // for cache_image
+#include "sound_manager.hpp" // for SoundManager
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+class PreloadWorkers
+{
+  public:
+    static PreloadWorkers& get()
+    {
+        static PreloadWorkers workers;
+        return workers;
+    }
+
+    void push(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock{jobs_lock};
+            jobs.push_back(std::move(job));
+            if (!started)
+            {
+                started = true;
+                const uint32_t num_workers = std::max(std::thread::hardware_concurrency() / 2, 1u);
+                for (uint32_t i = 0; i < num_workers; ++i)
+                {
+                    std::thread(&PreloadWorkers::work, this).detach();
+                }
+            }
+        }
+        jobs_available.notify_one();
+    }
+
+  private:
+    void work()
+    {
+        ServiceThreads::get().register_current("PreloadWorker", THREAD_POOL::IO);
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock lock{jobs_lock};
+                jobs_available.wait(lock, [this]()
+                                    { return !jobs.empty(); });
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::mutex jobs_lock;
+    std::condition_variable jobs_available;
+    std::deque<std::function<void()>> jobs;
+    bool started{false};
+};
+
+void read_whole_file(const std::string& path)
+{
+    FILE* file{nullptr};
+    if (fopen_s(&file, path.c_str(), "rb") != 0 || file == nullptr)
+        return;
+    char buffer[64 * 1024];
+    while (fread(buffer, 1, sizeof(buffer), file) == sizeof(buffer))
+    {
+    }
+    fclose(file);
+}
+
+void run_on_preload_workers(std::function<void()> job)
+{
+    PreloadWorkers::get().push(std::move(job));
+}
+
+std::future<void> preload_assets(AssetPreloadList assets, SoundManager* sound_manager)
+{
+    struct PreloadProgress
+    {
+        std::atomic<size_t> remaining;
+        std::promise<void> done;
+    };
+
+    const size_t num_assets = assets.images.size() + assets.sounds.size() + assets.files.size();
+    auto progress = std::make_shared<PreloadProgress>();
+    progress->remaining = num_assets;
+    std::future<void> future = progress->done.get_future();
+    if (num_assets == 0)
+    {
+        progress->done.set_value();
+        return future;
+    }
+
+    // One job per asset so a long music track doesn't hold back the small images
+    auto push_job = [progress](std::function<void()> load)
+    {
+        PreloadWorkers::get().push([progress, load = std::move(load)]()
+                                   {
+                                       load();
+                                       if (--progress->remaining == 0)
+                                           progress->done.set_value(); });
+    };
+    for (std::string& image : assets.images)
+    {
+        push_job([image = std::move(image)]()
+                 { cache_image(image); });
+    }
+    for (std::string& sound : assets.sounds)
+    {
+        push_job([sound = std::move(sound), sound_manager]()
+                 { if (sound_manager) sound_manager->predecode_sound(sound); });
+    }
+    for (std::string& file : assets.files)
+    {
+        push_job([file = std::move(file)]()
+                 { read_whole_file(file); });
+    }
+    return future;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <functional> // for function
+#include <future>     // for future
+#include <string>     // for string
+#include <vector>     // for vector
+
+class SoundManager;
+
+struct AssetPreloadList
+{
+    // Converted to the texture cache, so define_texture only has to read the cached dds
+    std::vector<std::string> images;
+    // Decoded into memory, so get_sound doesn't have to
+    std::vector<std::string> sounds;
+    // Read once so they are in the OS file cache when the game asks for them, e.g. level files
+    std::vector<std::string> files;
+};
+
+// Runs the job on one of the shared preload workers
+void run_on_preload_workers(std::function<void()> job);
+// Queues every asset on the shared preload workers, the future becomes ready once all of them were processed
+std::future<void> preload_assets(AssetPreloadList assets, SoundManager* sound_manager);
@@ -0,0 +1,126 @@
+#include "async_file_writer.hpp"
+
+#include <Windows.h>  // for MoveFileExW, MOVEFILE_REPLACE_EXISTING, MOVEFILE_WRITE_THROUGH
+#include <filesystem> // for path, remove
+#include <fstream>    // for ofstream
+#include <utility>    // for move
+
+#include "logger.h"          // for DEBUG
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+AsyncFileWriter& AsyncFileWriter::get()
+{
+    // Never destroyed, the detached thread may still be waiting on it while statics are torn down
+    static AsyncFileWriter* writer = new AsyncFileWriter();
+    return *writer;
+}
+
+std::future<bool> AsyncFileWriter::write(std::string path, std::string data, std::ios_base::openmode mode)
+{
+    return run([path = std::move(path), data = std::move(data), mode]()
+               { return write_atomically(path, data, mode); });
+}
+
+std::future<bool> AsyncFileWriter::run(std::function<bool()> job)
+{
+    std::future<bool> result;
+    {
+        std::lock_guard guard{lock};
+        Job& queued = jobs.emplace_back(Job{std::move(job), {}});
+        result = queued.result.get_future();
+        if (!thread.joinable())
+        {
+            thread = std::thread(&AsyncFileWriter::work, this);
+            thread.detach();
+        }
+    }
+    wake.notify_one();
+    return result;
+}
+
+void AsyncFileWriter::flush()
+{
+    std::unique_lock guard{lock};
+    idle.wait(guard, [this]
+              { return jobs.empty() && !busy; });
+}
+
+void AsyncFileWriter::drain()
+{
+    // The thread may have been killed holding the lock, then its queue is lost either way
+    std::unique_lock guard{lock, std::try_to_lock};
+    if (!guard.owns_lock())
+        return;
+    std::deque<Job> left;
+    left.swap(jobs);
+    guard.unlock();
+
+    for (Job& job : left)
+    {
+        try
+        {
+            job.result.set_value(job.fun());
+        }
+        catch (const std::exception& e)
+        {
+            DEBUG("Async file write failed: {}", e.what());
+            job.result.set_value(false);
+        }
+    }
+}
+
+void AsyncFileWriter::work()
+{
+    ServiceThreads::get().register_current("AsyncFileWriter", THREAD_POOL::IO);
+    std::unique_lock guard{lock};
+    while (true)
+    {
+        wake.wait(guard, [this]
+                  { return !jobs.empty(); });
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        guard.unlock();
+
+        bool success = false;
+        try
+        {
+            success = job.fun();
+        }
+        catch (const std::exception& e)
+        {
+            DEBUG("Async file write failed: {}", e.what());
+        }
+        job.result.set_value(success);
+
+        guard.lock();
+        busy = false;
+        if (jobs.empty())
+            idle.notify_all();
+    }
+}
+
+bool AsyncFileWriter::write_atomically(const std::string& path, std::string_view data, std::ios_base::openmode mode)
+{
+    const std::filesystem::path target{path};
+    std::filesystem::path temp{target};
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, mode | std::ios_base::trunc);
+        out.write(data.data(), data.size());
+        out.flush();
+        if (!out)
+        {
+            DEBUG("Couldn't write '{}'", temp.string());
+            return false;
+        }
+    }
+    if (!MoveFileExW(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DEBUG("Couldn't replace '{}': {}", path, GetLastError());
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
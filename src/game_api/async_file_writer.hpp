@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable> // for condition_variable
+#include <deque>              // for deque
+#include <functional>         // for function
+#include <future>             // for future, promise
+#include <ios>                // for ios_base
+#include <mutex>              // for mutex
+#include <string>             // for string
+#include <string_view>        // for string_view
+#include <thread>             // for thread
+
+// Single background thread for file writes that shouldn't stall the game thread, jobs run one after another in the order they were queued
+class AsyncFileWriter
+{
+  public:
+    static AsyncFileWriter& get();
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    // `data` is owned by the job, the caller can reuse its buffer right away
+    std::future<bool> write(std::string path, std::string data, std::ios_base::openmode mode = std::ios_base::binary);
+    std::future<bool> run(std::function<bool()> job);
+    // Blocks until everything queued so far has run, call before reading back a file that may still be queued
+    void flush();
+    // For the process exit, when the writer thread may already be gone: runs what's still queued on the calling thread without waiting for it
+    void drain();
+
+    // Writes next to `path` and moves the result over it, so the file is either the old or the new version even if the game dies mid write
+    static bool write_atomically(const std::string& path, std::string_view data, std::ios_base::openmode mode = std::ios_base::binary);
+
+  private:
+    AsyncFileWriter() = default;
+
+    struct Job
+    {
+        std::function<bool()> fun;
+        std::promise<bool> result;
+    };
+
+    void work();
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Job> jobs;
+    bool busy{false};
+    std::thread thread;
+};
@@ -0,0 +1,128 @@
+#include "benchmark.hpp"
+
+#include <algorithm>    // for sort, max
+#include <fmt/format.h> // for format
+#include <utility>      // for move, pair
+
+#include "entity.hpp"          // for Entity
+#include "entity_lookup.hpp"   // for get_entities_by
+#include "frame_telemetry.hpp" // for FrameTelemetry
+#include "heap_base.hpp"       // for HeapBase, relocate_heap_words
+#include "logger.h"            // for ERR
+#include "memory.hpp"          // for Memory
+#include "savestate.hpp"       // for SaveState
+#include "script/events.hpp"   // for pre_get_feat
+#include "search.hpp"          // for find_inst
+#include "state.hpp"           // for StateMemory
+
+std::string BenchmarkResult::to_json() const
+{
+    return fmt::format(R"({{"name":"{}","ops":{},"ops_per_sec":{:.1f},"p50_us":{:.3f},"p90_us":{:.3f},"p99_us":{:.3f},"max_us":{:.3f}}})", name, ops, ops_per_second, p50_us, p90_us, p99_us, max_us);
+}
+
+BenchmarkSuite::BenchmarkSuite(uint32_t iterations_, uint32_t seed_, std::string filter_)
+    : iterations{iterations_}, seed{seed_}, filter{std::move(filter_)}
+{
+}
+
+void BenchmarkSuite::run(std::string_view name, Case fun, uint32_t divisor, uint32_t batch)
+{
+    if (!filter.empty() && name.find(filter) == std::string_view::npos)
+        return;
+
+    // Every case starts from the same seed, so adding a case doesn't change the inputs of the others
+    std::mt19937 rng{seed};
+    const uint32_t batches = std::max(iterations / divisor / batch, 5u);
+    std::vector<double> latencies;
+    latencies.reserve(batches);
+    double total_us = 0.0;
+    for (uint32_t i = 0; i < batches; ++i)
+    {
+        const int64_t start = FrameTelemetry::now();
+        for (uint32_t j = 0; j < batch; ++j)
+            fun(rng);
+        const double batch_us = FrameTelemetry::ticks_to_ms(FrameTelemetry::now() - start) * 1000.0;
+        total_us += batch_us;
+        latencies.push_back(batch_us / batch);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double p)
+    { return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+    const uint32_t ops = batches * batch;
+    results.push_back({
+        std::string{name},
+        ops,
+        total_us > 0.0 ? ops / total_us * 1'000'000.0 : 0.0,
+        percentile(0.5),
+        percentile(0.9),
+        percentile(0.99),
+        latencies.back(),
+    });
+}
+
+void BenchmarkSuite::run_api_cases()
+{
+    const std::vector<uint32_t> uids = get_entities_by({}, ENTITY_MASK::ANY, LAYER::BOTH);
+    if (uids.empty())
+        return;
+
+    run("get_entities_by", [](std::mt19937&)
+        { get_entities_by({}, ENTITY_MASK::ANY, LAYER::BOTH); },
+        10);
+
+    StateMemory* state = HeapBase::get().state();
+    run("StateMemory::get_entity", [&](std::mt19937& rng)
+        { state->get_entity(uids[rng() % uids.size()]); },
+        1, 64);
+
+    {
+        // 32MiB per copy, the snapshot memory is allocated once by the first save
+        SaveState snapshot;
+        run("HeapBase::copy_to", [&](std::mt19937&)
+            { snapshot.save(false); },
+            100);
+        run("HeapBase::copy_to incremental", [&](std::mt19937&)
+            { snapshot.save(true); },
+            100);
+    }
+
+    {
+        // The copy kernels against the scalar reference, out of the live heap into a scratch buffer so nothing has to be loaded after
+        const size_t* heap = reinterpret_cast<const size_t*>(HeapBase::get_main().address());
+        std::vector<size_t> scratch(0x400000);
+        constexpr std::pair<HeapCopyKernel, std::string_view> kernels[]{
+            {HeapCopyKernel::Scalar, "relocate_heap_words scalar"},
+            {HeapCopyKernel::SSE2, "relocate_heap_words sse2"},
+            {HeapCopyKernel::AVX2, "relocate_heap_words avx2"},
+        };
+        for (auto [kernel, name] : kernels)
+        {
+            if (kernel == HeapCopyKernel::AVX2 && best_heap_copy_kernel() != HeapCopyKernel::AVX2)
+                continue;
+            run(name, [&](std::mt19937&)
+                { relocate_heap_words(heap, scratch.data(), kernel); },
+                100);
+            // The pointers are moved to the scratch address, so the reference has to be relocated into the same buffer
+            relocate_heap_words(heap, scratch.data(), HeapCopyKernel::Scalar);
+            const std::vector<size_t> reference = scratch;
+            relocate_heap_words(heap, scratch.data(), kernel);
+            if (scratch != reference)
+                ERR("{} doesn't match the scalar reference", name);
+        }
+    }
+
+    {
+        // Bytes from the end of the range, so the needle is there but most likely only found after scanning all of it, find_inst throws on a miss
+        constexpr size_t search_end = 0x400000;
+        const char* exe = Memory::get().exe();
+        const std::string_view needle{exe + search_end - 16, 12};
+        run("find_inst", [=](std::mt19937&)
+            { find_inst(exe, needle, 0, search_end, "benchmark", false); },
+            10);
+    }
+
+    run("event dispatch (pre_get_feat)", [](std::mt19937& rng)
+        { pre_get_feat((FEAT)(rng() % 32 + 1)); },
+        1, 16);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>     // for uint32_t
+#include <functional>  // for function
+#include <random>      // for mt19937
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint32_t ops;
+    double ops_per_second;
+    // Latency of a single op
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double max_us;
+
+    // One line of json, so the output of a run can be collected and compared across releases
+    std::string to_json() const;
+};
+
+// Times the API hot paths inside the running game, the cases need a loaded level so they can't run from a standalone executable
+// Uids and other inputs are picked with a fixed seed, so the same level state gives comparable runs
+class BenchmarkSuite
+{
+  public:
+    using Case = std::function<void(std::mt19937& rng)>;
+
+    BenchmarkSuite(uint32_t iterations, uint32_t seed, std::string filter);
+
+    // Calls `fun` iterations / `divisor` times, timed in batches of `batch` calls for the ops that are too quick to time one by one
+    void run(std::string_view name, Case fun, uint32_t divisor = 1, uint32_t batch = 1);
+    // get_entities_by, StateMemory::get_entity, HeapBase::copy_to and its kernels, find_inst and the event dispatch
+    void run_api_cases();
+
+    const std::vector<BenchmarkResult>& get_results() const
+    {
+        return results;
+    }
+
+  private:
+    uint32_t iterations;
+    uint32_t seed;
+    std::string filter;
+    std::vector<BenchmarkResult> results;
+};
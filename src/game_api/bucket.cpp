@@ -1,5 +1,7 @@
 #include "bucket.hpp"
 
+#include <algorithm> // for find
+
 #include "entities_chars.hpp" // for Player
 #include "game_manager.hpp"   // for GameManager, get_game_manager
 #include "items.hpp"          // for Items
@@ -33,22 +35,29 @@ void PauseAPI::set_pause(PAUSE_TYPE flags)
     state->pause = (uint8_t)(((uint32_t)flags) & 0x3f);
 }
 
-bool PauseAPI::check_trigger(PAUSE_TRIGGER& trigger, PAUSE_SCREEN& screen) const
+bool PauseAPI::check_trigger(PAUSE_TRIGGER& trigger, PAUSE_SCREEN& screen)
 {
-    bool match = false;
+    PAUSE_TRIGGER fired = PAUSE_TRIGGER::NONE;
     auto state = get_state_ptr();
 
     if (state->loading == 2 && (trigger & PAUSE_TRIGGER::SCREEN) != PAUSE_TRIGGER::NONE && (screen == PAUSE_SCREEN::NONE || (screen & (PAUSE_SCREEN)(1 << state->screen_next)) != PAUSE_SCREEN::NONE))
-        match = true;
+        fired = fired | PAUSE_TRIGGER::SCREEN;
 
     if ((trigger & PAUSE_TRIGGER::FADE_START) != PAUSE_TRIGGER::NONE && state->fade_timer > 0 && state->fade_timer == state->fade_length && state->fade_timer != last_fade_timer)
-        match = true;
+        fired = fired | PAUSE_TRIGGER::FADE_START;
 
     if ((trigger & PAUSE_TRIGGER::FADE_END) != PAUSE_TRIGGER::NONE && state->fade_timer == 1 && state->fade_timer != last_fade_timer)
-        match = true;
+        fired = fired | PAUSE_TRIGGER::FADE_END;
 
     if ((trigger & PAUSE_TRIGGER::EXIT) != PAUSE_TRIGGER::NONE && (state->screen == 12 || state->screen == 11) && (state->level_flags & (1 << 20)) && !(last_level_flags & (1 << 20)))
-        match = true;
+        fired = fired | PAUSE_TRIGGER::EXIT;
+
+    fired = fired | (trigger & pending_triggers & (PAUSE_TRIGGER::SPAWN | PAUSE_TRIGGER::SCRIPT_ERROR));
+
+    if ((trigger & PAUSE_TRIGGER::TIME_LEVEL) != PAUSE_TRIGGER::NONE && state->screen == 12 && state->time_level == trigger_time_level)
+        fired = fired | PAUSE_TRIGGER::TIME_LEVEL;
+
+    bool match = fired != PAUSE_TRIGGER::NONE;
 
     if (match && (trigger & PAUSE_TRIGGER::ONCE) != PAUSE_TRIGGER::NONE)
         trigger = PAUSE_TRIGGER::NONE;
@@ -56,9 +65,35 @@ bool PauseAPI::check_trigger(PAUSE_TRIGGER& trigger, PAUSE_SCREEN& screen) const
     if (match && (uint64_t)last_trigger_frame == API::get_global_update_count())
         match = false;
 
+    if (match)
+    {
+        last_trigger = fired;
+        // Only what was emitted is consumed, a spawn or error that was held back by the once per frame check fires on the next one
+        pending_triggers &= ~fired;
+    }
+
     return match;
 }
 
+void PauseAPI::on_spawn(ENT_TYPE type, int32_t uid)
+{
+    // Runs for every spawned entity, so bail out before looking at the types unless something waits for a spawn
+    if (((pause_trigger | unpause_trigger) & PAUSE_TRIGGER::SPAWN) == PAUSE_TRIGGER::NONE)
+        return;
+    if (!trigger_spawn_types.empty() && std::find(trigger_spawn_types.begin(), trigger_spawn_types.end(), type) == trigger_spawn_types.end())
+        return;
+    pending_triggers = pending_triggers | PAUSE_TRIGGER::SPAWN;
+    last_spawn_uid = uid;
+}
+
+void PauseAPI::on_error(std::string_view error)
+{
+    if (((pause_trigger | unpause_trigger) & PAUSE_TRIGGER::SCRIPT_ERROR) == PAUSE_TRIGGER::NONE)
+        return;
+    pending_triggers = pending_triggers | PAUSE_TRIGGER::SCRIPT_ERROR;
+    last_error = error;
+}
+
 bool PauseAPI::loading()
 {
     auto state = get_state_ptr();
@@ -104,6 +139,8 @@ bool PauseAPI::event(PAUSE_TYPE pause_event)
         }
         last_fade_timer = state->fade_timer;
         last_level_flags = state->level_flags;
+        // Whatever no trigger waits for anymore is dropped, it shouldn't fire when a trigger asks for it later
+        pending_triggers &= pause_trigger | unpause_trigger;
     }
 
     auto is_loading = loading();
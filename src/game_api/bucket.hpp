@@ -1,10 +1,13 @@
 #pragma once
 
+#include <functional>
 #include <map>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <variant>
+#include <vector>
 
 #include "aliases.hpp"
 
@@ -25,6 +28,16 @@ struct EditedMemory
     bool dirty;
 };
 
+// Hashes the same as std::hash<std::string>, so every API instance sharing the bucket finds the same entries
+struct TransparentStringHash
+{
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const
+    {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
 struct Overlunky
 {
     /// Current Overlunky options. Read only.
@@ -98,6 +111,19 @@ struct PauseAPI
     /// Enable to clear affected input when modifiers are held, disable to ignore all input events, i.e. keep held button state as it was before pressing the modifier key
     bool modifiers_clear_input{false};
 
+    /// Entity types that fire PAUSE_TRIGGER.SPAWN when spawned, any spawned entity fires it when empty
+    std::vector<ENT_TYPE> trigger_spawn_types;
+    /// Value of state.time_level that fires PAUSE_TRIGGER.TIME_LEVEL
+    uint32_t trigger_time_level{0};
+    /// The conditions that fired on the last automatic pause or unpause, cheap to poll for a debugger UI
+    PAUSE_TRIGGER last_trigger{PAUSE_TRIGGER::NONE};
+    /// Uid of the entity that last fired PAUSE_TRIGGER.SPAWN, -1 if none did yet
+    int32_t last_spawn_uid{-1};
+    /// Error of the callback that last fired PAUSE_TRIGGER.SCRIPT_ERROR
+    std::string last_error;
+    // SPAWN and SCRIPT_ERROR happen in the middle of an update, the hooks only flag them here until a trigger check emits them
+    PAUSE_TRIGGER pending_triggers{PAUSE_TRIGGER::NONE};
+
     /// Get the current pause flags
     PAUSE_TYPE get_pause();
     /// Set the current pause flags
@@ -138,7 +164,9 @@ struct PauseAPI
         set_pause(pause);
     }
     bool event(PAUSE_TYPE event);
-    bool check_trigger(PAUSE_TRIGGER& trigger, PAUSE_SCREEN& screen) const;
+    bool check_trigger(PAUSE_TRIGGER& trigger, PAUSE_SCREEN& screen);
+    void on_spawn(ENT_TYPE type, int32_t uid);
+    void on_error(std::string_view error);
     void pre_loop()
     {
         blocked = false;
@@ -168,7 +196,7 @@ class Bucket
     // Used by Overlunky to restart adventure runs with same seed, updated by PRE_LOAD_SCREEN
     std::pair<int64_t, int64_t> adventure_seed{0, 0};
     // Used by memory for recoverable memory interoperability
-    std::unordered_map<std::string, EditedMemory> original_memory;
+    std::unordered_map<std::string, EditedMemory, TransparentStringHash, std::equal_to<>> original_memory;
     /// PauseAPI is used by Overlunky and can be used to control the Overlunky pause options from scripts. Can be accessed from the global `pause` more easily.
     PauseAPI* pause_api;
     // Used by blockable PRE callbacks to forward BLOCKED events from Overlunky to Playlunky
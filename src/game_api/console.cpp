@@ -18,13 +18,10 @@ SpelunkyConsole::SpelunkyConsole(SoundManager* sound_manager)
 }
 SpelunkyConsole::~SpelunkyConsole() = default;
 
+// The message ring can be read without locking the backend, so this doesn't wait for a script that is running
 void SpelunkyConsole::loop_messages(std::function<void(const ScriptMessage&)> message_fun) const
 {
-    auto impl = m_Impl->Lock();
-    for (const ScriptMessage& message : impl->messages)
-    {
-        message_fun(message);
-    }
+    m_Impl->messages.for_each(message_fun);
 }
 std::vector<std::string> SpelunkyConsole::consume_requires()
 {
@@ -32,7 +29,7 @@ std::vector<std::string> SpelunkyConsole::consume_requires()
 }
 std::deque<ScriptMessage> SpelunkyConsole::consume_messages()
 {
-    return std::move(m_Impl->Lock()->messages);
+    return m_Impl->messages.consume();
 }
 
 bool SpelunkyConsole::is_enabled()
@@ -65,7 +62,15 @@ bool SpelunkyConsole::has_new_history() const
 }
 void SpelunkyConsole::set_max_history_size(size_t max_history)
 {
-    m_Impl->Lock()->max_history = max_history;
+    auto impl = m_Impl->Lock();
+    impl->max_history = max_history;
+    impl->trim_history();
+}
+void SpelunkyConsole::set_max_history_bytes(size_t max_history_bytes)
+{
+    auto impl = m_Impl->Lock();
+    impl->max_history_bytes = max_history_bytes;
+    impl->trim_history();
 }
 void SpelunkyConsole::save_history(std::string_view path)
 {
@@ -121,6 +126,10 @@ std::string SpelunkyConsole::dump_api()
 {
     return m_Impl->Lock()->dump_api();
 }
+std::string SpelunkyConsole::dump_api_json()
+{
+    return m_Impl->Lock()->dump_api_json();
+}
 
 void SpelunkyConsole::set_selected_uid(uint32_t uid)
 {
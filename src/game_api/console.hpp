@@ -33,11 +33,14 @@ class SpelunkyConsole
 
     bool has_new_history() const;
     void set_max_history_size(size_t max_history);
+    // Bytes of commands and results the history keeps on top of the item count
+    void set_max_history_bytes(size_t max_history_bytes);
     void save_history(std::string_view path);
     void load_history(std::string_view path);
     void push_history(std::string history_item, std::vector<ScriptMessage> result_item);
 
     std::string dump_api();
+    std::string dump_api_json();
 
     class LuaConsole* get_impl()
     {
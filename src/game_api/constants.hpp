@@ -1,5 +0,0 @@
-#pragma once
-
-#include <string_view>
-
-inline constexpr std::u16string_view no_return_str{u"~[:NO_RETURN:]#"};
@@ -2,9 +2,10 @@
 
 #include <string> // for operator""sv
 
-#include "heap_base.hpp" // for OnHeapPointer
-#include "memory.hpp"    // for memory_read, Memory
-#include "search.hpp"    // for get_address
+#include "game_heap_stats.hpp" // for GameHeapStats
+#include "heap_base.hpp"       // for OnHeapPointer
+#include "memory.hpp"          // for memory_read, Memory
+#include "search.hpp"          // for get_address
 
 using CustomMallocFun = void*(void*, std::size_t);
 using CustomFreeFun = void*(void*, void*);
@@ -13,13 +14,20 @@ void* custom_malloc(std::size_t size)
 {
     static CustomMallocFun* _malloc = (CustomMallocFun*)get_address("custom_malloc"sv);
     static size_t _heap_ptr_malloc_base = *reinterpret_cast<size_t*>(get_address("malloc_base"sv));
+    static auto& stats = GameHeapStats::get();
     void* _alloc_base = OnHeapPointer<void>(_heap_ptr_malloc_base).decode();
-    return _malloc(_alloc_base, size);
+    void* mem = _malloc(_alloc_base, size);
+    if (stats.is_enabled())
+        stats.on_alloc(mem, size, "custom_malloc");
+    return mem;
 }
 void custom_free(void* mem)
 {
     static CustomFreeFun* _free = (CustomFreeFun*)get_address("custom_free"sv);
     static size_t _heap_ptr_malloc_base = *reinterpret_cast<size_t*>(get_address("malloc_base"sv));
+    static auto& stats = GameHeapStats::get();
+    if (stats.is_enabled())
+        stats.on_free(mem);
     void* _alloc_base = OnHeapPointer<void>(_heap_ptr_malloc_base).decode();
     _free(_alloc_base, mem);
 }
@@ -2,7 +2,8 @@
 
 #include <string> // for operator""sv
 
-#include "search.hpp" // for get_address
+#include "game_heap_stats.hpp" // for GameHeapStats
+#include "search.hpp"          // for get_address
 
 using GameMallocFun = decltype(game_malloc);
 using GameFreeFun = decltype(game_free);
@@ -10,10 +11,17 @@ using GameFreeFun = decltype(game_free);
 void* game_malloc(std::size_t size)
 {
     static GameMallocFun* _malloc = *(GameMallocFun**)get_address("game_malloc"sv);
-    return _malloc(size);
+    static auto& stats = GameHeapStats::get();
+    void* mem = _malloc(size);
+    if (stats.is_enabled())
+        stats.on_alloc(mem, size, "game_malloc");
+    return mem;
 }
 void game_free(void* mem)
 {
     static GameFreeFun* _free = *(GameFreeFun**)get_address("game_free"sv);
+    static auto& stats = GameHeapStats::get();
+    if (stats.is_enabled())
+        stats.on_free(mem);
     _free(mem);
 }
@@ -1,6 +1,12 @@
+#pragma once
+
 /* Crc - 32 BIT ANSI X3.66 CRC checksum files */
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <intrin.h>
+#include <nmmintrin.h>
 #include <string_view>
 
 /**********************************************************************\
@@ -337,3 +343,66 @@ constexpr uint32_t crc32str(std::string_view str)
 
     return ~oldcrc32;
 }
+
+// CRC32-C (Castagnoli polynomial 0x82f63b78) of 64 bit words, which SSE4.2 computes with one instruction per word
+// Not the same checksum as crc32str, only use it where both sides use this one
+constexpr std::array<uint32_t, 256> crc_32c_tab = []()
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+        table[i] = crc;
+    }
+    return table;
+}();
+
+constexpr uint32_t crc32c_u64_table(uint32_t crc, uint64_t value)
+{
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        crc = crc_32c_tab[(crc ^ static_cast<uint32_t>(value)) & 0xff] ^ (crc >> 8);
+        value >>= 8;
+    }
+    return crc;
+}
+
+inline bool has_crc32_instructions()
+{
+    static const bool has = []()
+    {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 20)) != 0; // SSE4.2
+    }();
+    return has;
+}
+
+// The compiler is only allowed to use the instruction in here, the build doesn't assume SSE4.2
+#if defined(__clang__) || defined(__GNUC__)
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#else
+#define CRC32C_TARGET
+#endif
+
+template <class FunT>
+CRC32C_TARGET uint32_t crc32c_words_sse42(uint32_t crc, const uint64_t* words, size_t count, FunT&& transform)
+{
+    uint64_t crc64 = crc;
+    for (size_t i = 0; i < count; ++i)
+        crc64 = _mm_crc32_u64(crc64, transform(words[i]));
+    return static_cast<uint32_t>(crc64);
+}
+
+// Hashes `count` words, `transform` is applied to every word first, with crc32 instructions if the cpu has them
+template <class FunT>
+uint32_t crc32c_words(uint32_t crc, const uint64_t* words, size_t count, FunT&& transform)
+{
+    if (has_crc32_instructions())
+        return crc32c_words_sse42(crc, words, count, transform);
+    for (size_t i = 0; i < count; ++i)
+        crc = crc32c_u64_table(crc, transform(words[i]));
+    return crc;
+}
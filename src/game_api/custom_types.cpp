@@ -357,8 +357,20 @@ std::span<const ENT_TYPE> make_custom_entity_type_list(StrArgs... ent_type_ids)
 }
 
 std::map<CUSTOM_TYPE, std::vector<ENT_TYPE>> user_custom_types;
+std::map<CUSTOM_TYPE, EntityTypeBitmap> user_custom_type_bitmaps;
 uint32_t g_last_custom_id = (uint32_t)custom_type_max;
 
+EntityTypeBitmap make_entity_type_bitmap(std::span<const ENT_TYPE> types)
+{
+    EntityTypeBitmap bitmap;
+    for (ENT_TYPE type : types)
+    {
+        if (type < bitmap.size())
+            bitmap.set(type);
+    }
+    return bitmap;
+}
+
 std::span<const ENT_TYPE> get_custom_entity_types(CUSTOM_TYPE type)
 {
     if (type < CUSTOM_TYPE::ACIDBUBBLE)
@@ -1642,17 +1654,36 @@ CUSTOM_TYPE add_new_custom_type(std::vector<ENT_TYPE> types)
     {
         types.push_back(g_last_custom_id);
     }
+    user_custom_type_bitmaps.emplace((CUSTOM_TYPE)g_last_custom_id, make_entity_type_bitmap(types));
     user_custom_types.emplace((CUSTOM_TYPE)g_last_custom_id, std::move(types));
     return (CUSTOM_TYPE)g_last_custom_id;
 }
 
-bool is_type_movable(ENT_TYPE type)
+const EntityTypeBitmap& get_custom_entity_type_bitmap(CUSTOM_TYPE type)
 {
-    auto movable_types = get_custom_entity_types(CUSTOM_TYPE::MOVABLE);
-    if (std::find(movable_types.begin(), movable_types.end(), type) != movable_types.end())
-        return true;
+    // Covers every id the switch in get_custom_entity_types handles, so it takes precedence over user types the same way
+    static const std::vector<EntityTypeBitmap> builtin_bitmaps = []()
+    {
+        std::vector<EntityTypeBitmap> bitmaps;
+        for (uint32_t id = (uint32_t)CUSTOM_TYPE::ACIDBUBBLE; id <= (uint32_t)CUSTOM_TYPE::PURCHASABLE; ++id)
+        {
+            bitmaps.push_back(make_entity_type_bitmap(get_custom_entity_types((CUSTOM_TYPE)id)));
+        }
+        return bitmaps;
+    }();
+    static const EntityTypeBitmap no_types{};
 
-    return false;
+    if (type >= CUSTOM_TYPE::ACIDBUBBLE && type <= CUSTOM_TYPE::PURCHASABLE)
+        return builtin_bitmaps[(uint32_t)type - (uint32_t)CUSTOM_TYPE::ACIDBUBBLE];
+
+    auto it = user_custom_type_bitmaps.find(type);
+    return it != user_custom_type_bitmaps.end() ? it->second : no_types;
+}
+
+bool is_type_movable(ENT_TYPE type)
+{
+    const EntityTypeBitmap& movable_types = get_custom_entity_type_bitmap(CUSTOM_TYPE::MOVABLE);
+    return type < movable_types.size() && movable_types.test(type);
 }
 
 const std::vector<std::pair<CUSTOM_TYPE, std::string_view>>& get_custom_types_vector()
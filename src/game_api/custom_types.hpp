@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bitset>      // for bitset
 #include <cstdint>     // for uint32_t
 #include <map>         // for map
 #include <span>        // for span
@@ -349,7 +350,11 @@ enum class CUSTOM_TYPE : uint32_t
 
 constexpr CUSTOM_TYPE custom_type_max = CUSTOM_TYPE::YETIQUEEN;
 
+using EntityTypeBitmap = std::bitset<0x394>;
+
 std::span<const ENT_TYPE> get_custom_entity_types(CUSTOM_TYPE type);
+// Same types as `get_custom_entity_types` as a bitmap over ENT_TYPE, built once for the builtin types and when a new type is added
+const EntityTypeBitmap& get_custom_entity_type_bitmap(CUSTOM_TYPE type);
 CUSTOM_TYPE add_new_custom_type(std::vector<ENT_TYPE> types);
 bool is_type_movable(ENT_TYPE type);
 const std::vector<std::pair<CUSTOM_TYPE, std::string_view>>& get_custom_types_vector();
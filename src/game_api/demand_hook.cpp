@@ -0,0 +1,88 @@
+#include "demand_hook.hpp"
+
+#include <Windows.h> // for LONG, NO_ERROR
+#include <detours.h> // for DetourAttach, DetourDetach
+#include <mutex>     // for lock_guard
+#include <utility>   // for move
+
+#include "detour_transaction.hpp" // for hook_transaction_begin, hook_transaction_commit
+#include "logger.h"               // for DEBUG
+#include "script/lua_vm.hpp"      // for global_lua_lock
+
+namespace
+{
+bool g_demand_hooks_enabled{false};
+
+std::vector<DemandHook*>& get_demand_hooks()
+{
+    static std::vector<DemandHook*> hooks;
+    return hooks;
+}
+} // namespace
+
+DemandHook::DemandHook(std::string_view hook_name, std::function<void()> resolve_fun, std::vector<Detour> hook_detours, std::function<bool()> wanted_fun)
+    : name{hook_name}, resolve{std::move(resolve_fun)}, detours{std::move(hook_detours)}, wanted{std::move(wanted_fun)}
+{
+    get_demand_hooks().push_back(this);
+}
+
+void DemandHook::commit(bool attach)
+{
+    pending = true;
+    hook_transaction_begin();
+    for (auto [trampoline, detour] : detours)
+    {
+        if (attach)
+            DetourAttach(trampoline, detour);
+        else
+            DetourDetach(trampoline, detour);
+    }
+
+    // Only counts as attached once the detours are in, which for a batched transaction is when the batch ends
+    const LONG error = hook_transaction_commit([this, attach](bool committed)
+                                               {
+                                                   pending = false;
+                                                   if (committed)
+                                                       attached = attach;
+                                               });
+    if (error != NO_ERROR)
+    {
+        DEBUG("Failed {} {}: {}\n", attach ? "hooking" : "unhooking", name, error);
+    }
+}
+
+void enable_demand_hooks()
+{
+    // The wanted checks look at the backends, all of these run with the lua lock held for that
+    std::lock_guard lock{global_lua_lock};
+    if (g_demand_hooks_enabled)
+        return;
+    g_demand_hooks_enabled = true;
+    for (DemandHook* hook : get_demand_hooks())
+        hook->resolve();
+    attach_demand_hooks();
+}
+
+void attach_demand_hooks()
+{
+    std::lock_guard lock{global_lua_lock};
+    if (!g_demand_hooks_enabled)
+        return;
+    for (DemandHook* hook : get_demand_hooks())
+    {
+        if (!hook->attached && !hook->pending && hook->wanted())
+            hook->commit(true);
+    }
+}
+
+void update_demand_hooks()
+{
+    std::lock_guard lock{global_lua_lock};
+    if (!g_demand_hooks_enabled)
+        return;
+    for (DemandHook* hook : get_demand_hooks())
+    {
+        if (!hook->pending && hook->attached != hook->wanted())
+            hook->commit(!hook->attached);
+    }
+}
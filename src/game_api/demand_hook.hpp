@@ -0,0 +1,47 @@
+#pragma once
+
+#include <functional>  // for function
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+// A set of detours that is only attached while something wants it, so the game doesn't call through them for nothing
+// The hooks register themselves, nothing is attached before enable_demand_hooks is called by API::init
+class DemandHook
+{
+  public:
+    struct Detour
+    {
+        void** trampoline;
+        void* detour;
+    };
+
+    // `resolve` points the trampolines at the game's functions, it runs once when the hooks are enabled, after that
+    // the trampolines can always be called, they go straight to the game's functions while detached
+    DemandHook(std::string_view name, std::function<void()> resolve, std::vector<Detour> detours, std::function<bool()> wanted);
+
+    bool is_attached() const
+    {
+        return attached;
+    }
+
+  private:
+    friend void enable_demand_hooks();
+    friend void attach_demand_hooks();
+    friend void update_demand_hooks();
+
+    void commit(bool attach);
+
+    std::string_view name;
+    std::function<void()> resolve;
+    std::vector<Detour> detours;
+    std::function<bool()> wanted;
+    bool attached{false};
+    // Set while the detours wait for their transaction to commit, committing them again in the same batch would fail all of it
+    bool pending{false};
+};
+
+void enable_demand_hooks();
+// Attaches the hooks that are wanted now, call it after anything that could make a hook wanted
+void attach_demand_hooks();
+// Also detaches the hooks nothing wants anymore, only call it where none of the hooked functions can be running
+void update_demand_hooks();
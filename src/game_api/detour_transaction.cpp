@@ -0,0 +1,74 @@
+#include "detour_transaction.hpp"
+
+#include <Windows.h> // for GetCurrentThread, LONG, NO_ERROR
+#include <detours.h> // for DetourTransactionBegin, DetourTransactionCommitEx, DetourUpdateThread
+#include <utility>   // for move, exchange
+#include <vector>    // for vector
+
+#include "logger.h"   // for DEBUG
+#include "search.hpp" // for symbolicate_address
+
+namespace
+{
+thread_local bool g_detour_transaction_open{false};
+thread_local std::vector<std::function<void(bool)>> g_detour_transaction_done;
+
+// Names the function whose detour failed, the error code alone doesn't say which of the hooks it was
+LONG commit_transaction()
+{
+    PVOID* failed_pointer{nullptr};
+    const LONG error = DetourTransactionCommitEx(&failed_pointer);
+    if (error != NO_ERROR && failed_pointer != nullptr)
+    {
+        DEBUG("Failed detouring {}\n", symbolicate_address(reinterpret_cast<size_t>(*failed_pointer)));
+    }
+    return error;
+}
+} // namespace
+
+DetourTransaction::DetourTransaction()
+    : outermost{!g_detour_transaction_open}
+{
+    if (outermost)
+    {
+        DetourTransactionBegin();
+        DetourUpdateThread(GetCurrentThread());
+        g_detour_transaction_open = true;
+    }
+}
+DetourTransaction::~DetourTransaction()
+{
+    if (outermost)
+    {
+        g_detour_transaction_open = false;
+        const LONG error = commit_transaction();
+        if (error != NO_ERROR)
+        {
+            DEBUG("Failed committing the batched hooks: {}\n", error);
+        }
+        for (auto& on_done : std::exchange(g_detour_transaction_done, {}))
+            on_done(error == NO_ERROR);
+    }
+}
+
+void hook_transaction_begin()
+{
+    if (!g_detour_transaction_open)
+    {
+        DetourTransactionBegin();
+        DetourUpdateThread(GetCurrentThread());
+    }
+}
+long hook_transaction_commit(std::function<void(bool)> on_done)
+{
+    if (g_detour_transaction_open)
+    {
+        if (on_done)
+            g_detour_transaction_done.push_back(std::move(on_done));
+        return NO_ERROR;
+    }
+    const LONG error = commit_transaction();
+    if (on_done)
+        on_done(error == NO_ERROR);
+    return error;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional> // for function
+
+// While one is alive, the hook_transaction_begin/hook_transaction_commit pairs on this thread join it instead of running
+// their own Detours transaction, the threads are suspended once and all the hooks go in together when the outermost one ends
+// A single failed attach fails the whole transaction, which leaves none of the hooks in rather than some of them
+class DetourTransaction
+{
+  public:
+    DetourTransaction();
+    ~DetourTransaction();
+    DetourTransaction(const DetourTransaction&) = delete;
+    DetourTransaction& operator=(const DetourTransaction&) = delete;
+
+  private:
+    bool outermost;
+};
+
+// Begins a Detours transaction that updates the calling thread, or joins the open DetourTransaction
+void hook_transaction_begin();
+// Commits what hook_transaction_begin began, a joined transaction returns NO_ERROR and the outermost DetourTransaction logs the error instead
+// `on_done` is called with whether the hooks went in once they actually did, for a joined transaction that is when the outermost one ends
+long hook_transaction_commit(std::function<void(bool)> on_done = {});
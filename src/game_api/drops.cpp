@@ -1,12 +1,14 @@
 #include "drops.hpp"
 
-#include <new>         // for operator new
-#include <optional>    // for nullopt
-#include <string_view> //
-#include <utility>     // for min, max
+#include <new>           // for operator new
+#include <optional>      // for nullopt
+#include <string>        // for string
+#include <string_view>   //
+#include <unordered_map> // for unordered_map, erase_if
+#include <utility>       // for min, max, pair
 
 #include "entity_db.hpp" // for to_id
-#include "memory.hpp"    // for Memory, recover_mem, write_mem_recoverable
+#include "memory.hpp"    // for Memory, recover_mem, write_mem_recoverable, PatchTransaction
 #include "search.hpp"    // for find_inst
 
 ///
@@ -336,6 +338,94 @@ std::vector<DropChanceEntry> dropchance_entries{
     {"YETI_PITCHERSMITT", "\xE8\x03\x00\x00"sv, VTABLE_OFFSET::MONS_YETI, 3},
 };
 
+namespace
+{
+struct DropSiteOwner
+{
+    // "drop_chance" or "replace_drop", the backups that hold the original bytes
+    std::string_view backup;
+    std::string group;
+};
+// The group that wrote a patch site last, writing a site from anywhere else takes it away from the group
+std::unordered_map<size_t, DropSiteOwner> g_drop_site_owners;
+
+void set_drop_site_owner(std::string_view backup, size_t address, std::string_view group)
+{
+    if (group.empty())
+        g_drop_site_owners.erase(address);
+    else
+        g_drop_site_owners[address] = {backup, std::string{group}};
+}
+void clear_drop_site_owners(std::string_view backup)
+{
+    std::erase_if(g_drop_site_owners, [backup](const auto& site)
+                  { return site.second.backup == backup; });
+}
+
+bool resolve_drop_chance(DropChanceEntry& entry)
+{
+    if (entry.offset == 0)
+    {
+        auto& memory = Memory::get();
+        size_t offset = memory.at_exe(find_inst(memory.exe(), entry.pattern, get_virtual_function_address(entry.vtable_offset, entry.vtable_rel_offset)));
+        if (offset > memory.exe_address())
+        {
+            entry.offset = offset;
+        }
+    }
+    return entry.offset != 0;
+}
+void write_drop_chance(const DropChanceEntry& entry, uint32_t new_drop_chance)
+{
+    if (entry.chance_sizeof == 4)
+    {
+        write_mem_recoverable("drop_chance", entry.offset, new_drop_chance, true);
+    }
+    else if (entry.chance_sizeof == 1)
+    {
+        uint8_t value = static_cast<uint8_t>(new_drop_chance);
+        write_mem_recoverable("drop_chance", entry.offset, value, true);
+    }
+}
+
+bool resolve_drop(DropEntry& entry)
+{
+    if (entry.offsets[0] == 0)
+    {
+        auto& memory = Memory::get();
+        size_t offset = 0;
+        const auto drop_name{"DROP." + entry.caption};
+
+        if (entry.vtable_offset == VTABLE_OFFSET::NONE)
+            offset = memory.after_bundle_address();
+        else
+            offset = get_virtual_function_address(entry.vtable_offset, entry.vtable_rel_offset);
+
+        if (offset == 0)
+            return false;
+
+        int x = 0;
+        do
+        {
+            offset = find_inst(memory.exe(), entry.pattern, offset, std::nullopt, drop_name);
+            if (offset == 0)
+                return false;
+
+            entry.offsets[x] = memory.at_exe(offset + entry.value_offset);
+
+            offset += entry.pattern.size();
+            ++x;
+        } while (x < entry.vtable_occurrence && x < 3);
+    }
+    return entry.offsets[0] != 0;
+}
+bool is_valid_drop_type(ENT_TYPE entity_type)
+{
+    const static auto nof_ent_types = to_id("ENT_TYPE_LIQUID_COARSE_LAVA") + 1;
+    return entity_type < nof_ent_types;
+}
+} // namespace
+
 void set_drop_chance(DROPCHANCE dropchance_id, uint32_t new_drop_chance)
 {
     if (dropchance_id < (int32_t)dropchance_entries.size())
@@ -343,44 +433,32 @@ void set_drop_chance(DROPCHANCE dropchance_id, uint32_t new_drop_chance)
         if (dropchance_id < 0)
         {
             if (dropchance_id == -1)
+            {
                 recover_mem("drop_chance");
+                clear_drop_site_owners("drop_chance");
+            }
             return;
         }
         auto& entry = dropchance_entries.at(dropchance_id);
-        if (entry.offset == 0)
-        {
-            auto& memory = Memory::get();
-            size_t offset = memory.at_exe(find_inst(memory.exe(), entry.pattern, get_virtual_function_address(entry.vtable_offset, entry.vtable_rel_offset)));
-            if (offset > memory.exe_address())
-            {
-                entry.offset = offset;
-            }
-        }
-
-        if (entry.offset != 0)
+        if (resolve_drop_chance(entry))
         {
-            if (entry.chance_sizeof == 4)
-            {
-                write_mem_recoverable("drop_chance", entry.offset, new_drop_chance, true);
-            }
-            else if (entry.chance_sizeof == 1)
-            {
-                uint8_t value = static_cast<uint8_t>(new_drop_chance);
-                write_mem_recoverable("drop_chance", entry.offset, value, true);
-            }
+            write_drop_chance(entry, new_drop_chance);
+            set_drop_site_owner("drop_chance", entry.offset, {});
         }
     }
 }
 
 void replace_drop(DROP drop_id, ENT_TYPE new_drop_entity_type)
 {
-    const static auto nof_ent_types = to_id("ENT_TYPE_LIQUID_COARSE_LAVA") + 1;
-    if (drop_id < (int32_t)drop_entries.size() && new_drop_entity_type < nof_ent_types)
+    if (drop_id < (int32_t)drop_entries.size() && is_valid_drop_type(new_drop_entity_type))
     {
         if (drop_id < 0)
         {
             if (drop_id == -1)
+            {
                 recover_mem("replace_drop");
+                clear_drop_site_owners("replace_drop");
+            }
 
             return;
         }
@@ -389,46 +467,83 @@ void replace_drop(DROP drop_id, ENT_TYPE new_drop_entity_type)
         {
             for (int x = 0; x < 3; ++x)
                 if (entry.offsets[x])
+                {
                     recover_mem("replace_drop", entry.offsets[x]);
+                    set_drop_site_owner("replace_drop", entry.offsets[x], {});
+                }
 
             return;
         }
-        if (entry.offsets[0] == 0)
+        if (resolve_drop(entry))
         {
-            auto& memory = Memory::get();
-            size_t offset = 0;
-            const auto drop_name{"DROP." + entry.caption};
-
-            if (entry.vtable_offset == VTABLE_OFFSET::NONE)
-                offset = memory.after_bundle_address();
-            else
-                offset = get_virtual_function_address(entry.vtable_offset, entry.vtable_rel_offset);
-
-            if (offset == 0)
-                return;
-
-            int x = 0;
-            do
+            for (auto x = 0; x < entry.vtable_occurrence; ++x)
             {
-                offset = find_inst(memory.exe(), entry.pattern, offset, std::nullopt, drop_name);
-                if (offset == 0)
-                    return;
+                write_mem_recoverable("replace_drop", entry.offsets[x], new_drop_entity_type, true);
+                set_drop_site_owner("replace_drop", entry.offsets[x], {});
+            }
+        }
+    }
+}
 
-                entry.offsets[x] = memory.at_exe(offset + entry.value_offset);
+size_t set_drop_chances(const std::vector<std::pair<DROPCHANCE, uint32_t>>& chances, std::string_view group)
+{
+    // Every site is looked up before anything is written, so the writes can be applied together
+    std::vector<std::pair<const DropChanceEntry*, uint32_t>> resolved;
+    resolved.reserve(chances.size());
+    for (auto [dropchance_id, new_drop_chance] : chances)
+    {
+        if (dropchance_id < 0 || dropchance_id >= (int32_t)dropchance_entries.size())
+            continue;
+        auto& entry = dropchance_entries[dropchance_id];
+        if (resolve_drop_chance(entry))
+            resolved.emplace_back(&entry, new_drop_chance);
+    }
 
-                offset += entry.pattern.size();
-                ++x;
-            } while (x < entry.vtable_occurrence && x < 3);
-        }
+    PatchTransaction transaction;
+    for (auto [entry, new_drop_chance] : resolved)
+    {
+        write_drop_chance(*entry, new_drop_chance);
+        set_drop_site_owner("drop_chance", entry->offset, group);
+    }
+    return resolved.size();
+}
+
+size_t replace_drops(const std::vector<std::pair<DROP, ENT_TYPE>>& drops, std::string_view group)
+{
+    std::vector<std::pair<const DropEntry*, ENT_TYPE>> resolved;
+    resolved.reserve(drops.size());
+    for (auto [drop_id, new_drop_entity_type] : drops)
+    {
+        if (drop_id < 0 || drop_id >= (int32_t)drop_entries.size() || new_drop_entity_type == 0 || !is_valid_drop_type(new_drop_entity_type))
+            continue;
+        auto& entry = drop_entries[drop_id];
+        if (resolve_drop(entry))
+            resolved.emplace_back(&entry, new_drop_entity_type);
+    }
 
-        if (entry.offsets[0] != 0)
+    PatchTransaction transaction;
+    for (auto [entry, new_drop_entity_type] : resolved)
+    {
+        for (auto x = 0; x < entry->vtable_occurrence; ++x)
         {
-            for (auto x = 0; x < entry.vtable_occurrence; ++x)
-            {
-                write_mem_recoverable("replace_drop", entry.offsets[x], new_drop_entity_type, true);
-            }
+            write_mem_recoverable("replace_drop", entry->offsets[x], new_drop_entity_type, true);
+            set_drop_site_owner("replace_drop", entry->offsets[x], group);
         }
     }
+    return resolved.size();
+}
+
+void reset_drop_group(std::string_view group)
+{
+    // Sites another group or a single call wrote since are left alone, they aren't this group's changes anymore
+    PatchTransaction transaction;
+    std::erase_if(g_drop_site_owners, [group](const auto& site)
+                  {
+                      if (site.second.group != group)
+                          return false;
+                      recover_mem(site.second.backup, site.first);
+                      return true;
+                  });
 }
 
 #ifdef PERFORM_DROPS_TEST
@@ -1,9 +1,11 @@
 #pragma once
 
-#include <cstddef> // for size_t
-#include <cstdint> // for uint32_t, uint8_t, int32_t
-#include <string>  // for string, allocator
-#include <vector>  // for vector
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint32_t, uint8_t, int32_t
+#include <string>      // for string, allocator
+#include <string_view> // for string_view
+#include <utility>     // for pair
+#include <vector>      // for vector
 
 #include "aliases.hpp"       // for ENT_TYPE
 #include "virtual_table.hpp" // for VTABLE_OFFSET
@@ -33,6 +35,12 @@ void set_drop_chance(DROPCHANCE dropchance_id, uint32_t new_drop_chance);
 using DROP = int32_t;
 void replace_drop(DROP drop_id, ENT_TYPE new_drop_entity_type);
 
+// Same as calling set_drop_chance or replace_drop for each couple, but all the patch sites are resolved first and written in one PatchTransaction
+// The patched sites are remembered under `group`, so reset_drop_group can put back the ones no one else wrote since, returns the amount of couples that were applied
+size_t set_drop_chances(const std::vector<std::pair<DROPCHANCE, uint32_t>>& chances, std::string_view group);
+size_t replace_drops(const std::vector<std::pair<DROP, ENT_TYPE>>& drops, std::string_view group);
+void reset_drop_group(std::string_view group);
+
 extern std::vector<DropEntry> drop_entries;
 
 extern std::vector<DropChanceEntry> dropchance_entries;
@@ -16,7 +16,8 @@
 #include "entities_chars.hpp"        // for Player
 #include "entities_monsters.hpp"     // for MegaJellyfish
 #include "entity_hooks_info.hpp"     // for EntityHooksInfo
-#include "entity_lookup.hpp"         // for get_proper_types
+#include "entity_lookup.hpp"         // for get_proper_types, EntityTypeSet
+#include "entity_traversal.hpp"      // for for_each_attached
 #include "heap_base.hpp"             // for HeapBase
 #include "liquid_engine.hpp"         // for LiquidPhysicsEngine
 #include "memory.hpp"                // for write_mem_prot
@@ -103,12 +104,53 @@ void Entity::perform_teleport(uint8_t delta_x, uint8_t delta_y)
     tp(this, delta_x, delta_y);
 }
 
+namespace
+{
+thread_local AbsPositionScope* g_abs_position_scope{nullptr};
+}
+
+AbsPositionScope::AbsPositionScope()
+    : outer{g_abs_position_scope}
+{
+    if (outer == nullptr)
+        g_abs_position_scope = this;
+}
+AbsPositionScope::~AbsPositionScope()
+{
+    if (outer == nullptr)
+        g_abs_position_scope = nullptr;
+}
+
+void AbsPositionScope::invalidate()
+{
+    if (g_abs_position_scope != nullptr)
+        g_abs_position_scope->overlays.clear();
+}
+
+Vec2 AbsPositionScope::overlay_position(const Entity* overlay)
+{
+    if (auto it = overlays.find(overlay); it != overlays.end())
+        return it->second;
+
+    // Not the abs_position of the overlay, the chain only adds up the plain positions, like the walk without a scope does
+    Vec2 position{overlay->x, overlay->y};
+    if (overlay->overlay != nullptr)
+        position += overlay_position(overlay->overlay);
+    overlays.emplace(overlay, position);
+    return position;
+}
+
 Vec2 Entity::abs_position() const
 {
     // if (abs_x != -FLT_MAX && abs_y != -FLT_MAX) // shortcut, if available
     //     return {abs_x, abs_y}; // using abs_x/y may have some issues https://github.com/spelunky-fyi/overlunky/issues/408
 
     auto [x_pos, y_pos] = position_self();
+    if (overlay != nullptr && g_abs_position_scope != nullptr)
+    {
+        const Vec2 overlay_pos = g_abs_position_scope->overlay_position(overlay);
+        return {x_pos + overlay_pos.x, y_pos + overlay_pos.y};
+    }
 
     // overlay exists if player is riding something / etc
     Entity* overlay_nested = overlay;
@@ -241,6 +283,10 @@ Entity* get_entity_ptr(uint32_t uid)
 {
     return HeapBase::get().state()->get_entity(uid);
 }
+std::vector<Entity*> get_entities_ptr(const std::vector<uint32_t>& uids)
+{
+    return HeapBase::get().state()->get_entities(uids);
+}
 
 std::vector<uint32_t> Movable::get_all_behaviors()
 {
@@ -304,6 +350,7 @@ void Movable::set_position(float to_x, float to_y)
 {
     if (overlay)
         return;
+    AbsPositionScope::invalidate();
     auto dx = to_x - x;
     auto dy = to_y - y;
     x = to_x;
@@ -326,60 +373,84 @@ void Movable::set_position(float to_x, float to_y)
         camera->set_position(dx, dy);
 }
 
-template <typename F>
-bool recursive(Entity* ent, std::optional<ENTITY_MASK> mask, std::vector<ENT_TYPE> ent_types, RECURSIVE_MODE rec_mode, F func)
+void push_attached_entities(Entity* ent, std::vector<Entity*>& out)
 {
-    auto actual_mask = [](ENTITY_MASK m) -> ENTITY_MASK // for the MASK.ANY
-    { return m == ENTITY_MASK::ANY ? (ENTITY_MASK)0xFFFF : m; };
+    const auto items = ent->items.entities();
+    out.insert(out.end(), items.begin(), items.end());
 
-    if (rec_mode == RECURSIVE_MODE::EXCLUSIVE)
-    {
-        if (mask.has_value() && !!(actual_mask(mask.value()) & ent->type->search_flags))
-            return false;
+    static const ENT_TYPE jellys[] = {
+        to_id("ENT_TYPE_MONS_MEGAJELLYFISH"),
+        to_id("ENT_TYPE_MONS_MEGAJELLYFISH_BACKGROUND"),
+    };
+    static const ENT_TYPE jellys_tails[] = {
+        to_id("ENT_TYPE_FX_MEGAJELLYFISH_TAIL"),
+        to_id("ENT_TYPE_FX_MEGAJELLYFISH_TAIL_BG"),
+    };
 
-        if (std::find(ent_types.begin(), ent_types.end(), ent->type->id) != ent_types.end())
-            return false;
-    }
-    else if (rec_mode == RECURSIVE_MODE::INCLUSIVE)
+    if (ent->type->id == jellys[0] || ent->type->id == jellys[1]) // special only for MEGAJELLYFISH
     {
-        if (mask.has_value() && !(actual_mask(mask.value()) & ent->type->search_flags))
+        auto true_type = (MegaJellyfish*)ent;
+        auto currend_uid = true_type->tail_bg_uid;
+        for (int idx = 0; idx < 8; ++idx)
         {
-            if (std::find(ent_types.begin(), ent_types.end(), ent->type->id) == ent_types.end())
-                return false;
+            auto tail_ent = get_entity_ptr(currend_uid + idx);
+            if (tail_ent != nullptr && (tail_ent->type->id == jellys_tails[0] || tail_ent->type->id == jellys_tails[1])) // only kill the tail
+            {
+                out.push_back(tail_ent);
+            }
         }
-        else if (std::find(ent_types.begin(), ent_types.end(), ent->type->id) == ent_types.end())
-            return false;
     }
-    const std::vector<Entity*> items{ent->items.entities().begin(), ent->items.entities().end()};
-    for (auto entity : items)
+}
+
+// Filter of kill_recursive and destroy_recursive, the types are resolved into a bitset once per call
+class RecursiveFilter
+{
+  public:
+    RecursiveFilter(std::optional<ENTITY_MASK> mask_, const std::vector<ENT_TYPE>& ent_types, RECURSIVE_MODE rec_mode_)
+        : rec_mode{rec_mode_}, types{ent_types}
     {
-        recursive(entity, mask, ent_types, rec_mode, func);
+        if (mask_.has_value())
+            mask = mask_.value() == ENTITY_MASK::ANY ? (ENTITY_MASK)0xFFFF : mask_.value(); // for the MASK.ANY
     }
 
+    bool passes(const Entity* ent) const
     {
-        static const ENT_TYPE jellys[] = {
-            to_id("ENT_TYPE_MONS_MEGAJELLYFISH"),
-            to_id("ENT_TYPE_MONS_MEGAJELLYFISH_BACKGROUND"),
-        };
-        static const ENT_TYPE jellys_tails[] = {
-            to_id("ENT_TYPE_FX_MEGAJELLYFISH_TAIL"),
-            to_id("ENT_TYPE_FX_MEGAJELLYFISH_TAIL_BG"),
-        };
-
-        if (ent->type->id == jellys[0] || ent->type->id == jellys[1]) // special only for MEGAJELLYFISH
+        const bool in_mask = mask.has_value() && !!(mask.value() & ent->type->search_flags);
+        const bool in_types = !types.matches_any() && types.contains(ent->type->id);
+        switch (rec_mode)
         {
-            auto true_type = (MegaJellyfish*)ent;
-            auto currend_uid = true_type->tail_bg_uid;
-            for (int idx = 0; idx < 8; ++idx)
-            {
-                auto tail_ent = get_entity_ptr(currend_uid + idx);
-                if (tail_ent != nullptr && (tail_ent->type->id == jellys_tails[0] || tail_ent->type->id == jellys_tails[1])) // only kill the tail
-                {
-                    recursive(tail_ent, mask, ent_types, rec_mode, func);
-                }
-            }
+        case RECURSIVE_MODE::EXCLUSIVE:
+            return !in_mask && !in_types;
+        case RECURSIVE_MODE::INCLUSIVE:
+            return in_mask || in_types;
+        default:
+            return true;
         }
     }
+
+  private:
+    RECURSIVE_MODE rec_mode;
+    std::optional<ENTITY_MASK> mask;
+    // Unlike in the lookups an empty list matches nothing here
+    EntityTypeSet types;
+};
+
+template <typename F>
+bool recursive(Entity* ent, std::optional<ENTITY_MASK> mask, const std::vector<ENT_TYPE>& ent_types, RECURSIVE_MODE rec_mode, F func)
+{
+    const RecursiveFilter filter{mask, ent_types, rec_mode};
+    if (!filter.passes(ent))
+        return false;
+
+    for_each_attached(
+        ent,
+        [&filter](Entity* child)
+        { return filter.passes(child); },
+        [&func](Entity* child)
+        {
+            func(child);
+            return false;
+        });
     func(ent);
     return true;
 }
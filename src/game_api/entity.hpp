@@ -111,6 +111,9 @@ class Entity
     uint32_t i9c;
     /* for the autodoc
     any user_data;
+    /// Read several fields in one call, `ent:get_fields({"x", "y", "health"})` returns `{x = .., y = .., health = ..}`. Quicker than reading them one by one for the
+    /// common Entity and Movable fields and `type_id` (`type.id`), those are read from fixed offsets. Movable fields are left out for entities that aren't movable
+    table get_fields(array<string> names);
     */
     // {x, y}
     Vec2 position_self() const
@@ -326,4 +329,27 @@ class Entity
     virtual void apply_db() = 0; // 36, This is actually just an initialize call that is happening once after  the entity is created
 };
 
+// While one is alive on this thread, abs_position remembers the absolute position of every overlay it walks, so entities
+// held by, riding or standing on the same thing don't walk its chain again. Only open it around code that doesn't move
+// entities, e.g. the entity queries, move_entity_abs, attach_entity and Movable::set_position drop what it remembered anyway
+class AbsPositionScope
+{
+  public:
+    AbsPositionScope();
+    ~AbsPositionScope();
+    AbsPositionScope(const AbsPositionScope&) = delete;
+    AbsPositionScope& operator=(const AbsPositionScope&) = delete;
+
+    static void invalidate();
+
+  private:
+    friend class Entity;
+    Vec2 overlay_position(const Entity* overlay);
+
+    std::unordered_map<const Entity*, Vec2> overlays;
+    AbsPositionScope* outer;
+};
+
 Entity* get_entity_ptr(uint32_t uid);
+// nullptr for the uids that don't exist
+std::vector<Entity*> get_entities_ptr(const std::vector<uint32_t>& uids);
@@ -1,17 +1,22 @@
 #include "entity_db.hpp"
 #include "entity.hpp"
 
-#include <chrono>  // for operator<=>, operator-, operator+
-#include <cmath>   // for round
-#include <compare> // for operator<, operator<=, operator>
-#include <cstdint> // for uint32_t, uint16_t, uint8_t
-#include <cstdlib> // for abs, NULL, size_t
-#include <list>    // for _List_const_iterator
-#include <map>     // for _Tree_iterator, map, _Tree_cons...
-#include <new>     // for operator new
-#include <string>  // for allocator, string, operator""sv
-#include <thread>  // for sleep_for
-#include <vector>  // for vector, _Vector_iterator, erase_if
+#include <algorithm>     // for sort, transform
+#include <array>         // for array
+#include <cctype>        // for tolower
+#include <chrono>        // for operator<=>, operator-, operator+
+#include <cmath>         // for round
+#include <compare>       // for operator<, operator<=, operator>
+#include <cstdint>       // for uint32_t, uint16_t, uint8_t
+#include <cstdlib>       // for abs, NULL, size_t
+#include <list>          // for _List_const_iterator
+#include <map>           // for _Tree_iterator, map, _Tree_cons...
+#include <new>           // for operator new
+#include <string>        // for allocator, string, operator""sv
+#include <string_view>   // for string_view
+#include <thread>        // for sleep_for
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector, _Vector_iterator, erase_if
 
 #include "entities_chars.hpp"    // for Player
 #include "entity_hooks_info.hpp" // for EntityHooksInfo
@@ -40,20 +45,10 @@ EntityFactory* entity_factory()
     return cache_entity_factory;
 }
 
-std::vector<EntityItem> list_entities()
+size_t get_entity_type_count()
 {
     const EntityFactory* entity_factory_ptr = entity_factory();
-    if (!entity_factory_ptr)
-        return {};
-
-    const auto& map = entity_factory_ptr->entity_map;
-
-    std::vector<EntityItem> result;
-    for (const auto& [name, id] : map)
-    {
-        result.emplace_back(name, id);
-    }
-    return result;
+    return entity_factory_ptr ? entity_factory_ptr->entity_map.size() : 0;
 }
 
 EntityDB* get_type(ENT_TYPE id)
@@ -69,30 +64,66 @@ EntityDB* get_type(ENT_TYPE id)
     return entity_factory_ptr->types + id;
 }
 
-ENT_TYPE to_id(std::string_view name)
+const EntityCatalog& get_entity_catalog()
 {
-    static const std::unordered_map<std::string, uint16_t>* map;
-    if (map == nullptr)
+    // Never destroyed, the names are handed out as views
+    static const EntityCatalog* catalog = []()
     {
         const EntityFactory* entity_factory_ptr = entity_factory();
-        if (!entity_factory_ptr)
-            return (ENT_TYPE)~0;
-        map = &entity_factory_ptr->entity_map;
-    }
-    auto it = map->find(std::string(name));
-    return it != map->end() ? it->second : (ENT_TYPE)~0;
+        auto* new_catalog = new EntityCatalog{};
+        new_catalog->items.reserve(entity_factory_ptr->entity_map.size());
+        for (const auto& [name, type_id] : entity_factory_ptr->entity_map)
+            new_catalog->items.emplace_back(name, type_id);
+        std::sort(new_catalog->items.begin(), new_catalog->items.end());
+
+        constexpr std::string_view prefix{"ENT_TYPE_"};
+        new_catalog->search_keys.reserve(new_catalog->items.size());
+        new_catalog->ids.reserve(new_catalog->items.size());
+        for (const EntityItem& item : new_catalog->items)
+        {
+            std::string_view short_name{item.name};
+            if (short_name.starts_with(prefix))
+                short_name.remove_prefix(prefix.size());
+
+            std::string& key = new_catalog->search_keys.emplace_back(short_name);
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c)
+                           { return (char)std::tolower(c); });
+            if (item.id < EntityCatalog::MAX_TYPES)
+            {
+                new_catalog->full_names[item.id] = item.name;
+                new_catalog->short_names[item.id] = short_name;
+                new_catalog->ids.emplace(new_catalog->full_names[item.id], static_cast<uint16_t>(item.id));
+            }
+        }
+        return new_catalog;
+    }();
+    return *catalog;
+}
+
+const std::string& EntityCatalog::full_name(ENT_TYPE id) const
+{
+    static const std::string empty;
+    return id < MAX_TYPES ? full_names[id] : empty;
+}
+const std::string& EntityCatalog::short_name(ENT_TYPE id) const
+{
+    static const std::string empty;
+    return id < MAX_TYPES ? short_names[id] : empty;
+}
+
+const std::vector<EntityItem>& list_entities()
+{
+    return get_entity_catalog().items;
+}
+
+ENT_TYPE to_id(std::string_view name)
+{
+    const EntityCatalog& catalog = get_entity_catalog();
+    auto it = catalog.ids.find(name);
+    return it != catalog.ids.end() ? it->second : (ENT_TYPE)~0;
 }
 
 std::string_view to_name(ENT_TYPE id)
 {
-    const EntityFactory* entity_factory_ptr = entity_factory();
-    if (entity_factory_ptr)
-    {
-        for (const auto& [name, type_id] : entity_factory_ptr->entity_map)
-        {
-            if (type_id == id)
-                return name;
-        }
-    }
-    return {};
+    return get_entity_catalog().full_name(id);
 }
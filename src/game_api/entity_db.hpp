@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>         // for array
 #include <cstddef>       // for size_t
 #include <cstdint>       // for uint8_t, uint32_t, int32_t, uint16_t, int64_t
 #include <functional>    // for function, equal_to
@@ -132,6 +133,27 @@ struct EntityItem
     }
 };
 
+// Every entity type of the game, built the first time it's asked for, which has to be after the game filled the entity factory
+// It never changes after that, so the API, the scripts and the UI all share it instead of going through the factory's map
+struct EntityCatalog
+{
+    static constexpr size_t MAX_TYPES = 0x395;
+
+    // Sorted by id
+    std::vector<EntityItem> items;
+    // Lowercase names without the "ENT_TYPE_" prefix, in the order of `items`
+    std::vector<std::string> search_keys;
+    // By id, empty for the ids without a type
+    std::array<std::string, MAX_TYPES> full_names;
+    // By id, without the "ENT_TYPE_" prefix
+    std::array<std::string, MAX_TYPES> short_names;
+    std::unordered_map<std::string_view, uint16_t> ids;
+
+    // Empty for ids without a type, including the custom types
+    const std::string& full_name(ENT_TYPE id) const;
+    const std::string& short_name(ENT_TYPE id) const;
+};
+
 struct EntityPool
 {
     std::uint32_t slot_size;
@@ -156,6 +178,10 @@ ENT_TYPE to_id(std::string_view id);
 
 std::string_view to_name(ENT_TYPE id);
 
-std::vector<EntityItem> list_entities();
+// Sorted by id
+const std::vector<EntityItem>& list_entities();
+const EntityCatalog& get_entity_catalog();
+// Types the entity factory knows so far, to wait for the game to fill it before anything builds the catalog
+size_t get_entity_type_count();
 
 EntityFactory* entity_factory();
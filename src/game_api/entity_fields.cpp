@@ -0,0 +1,278 @@
+#include "entity_fields.hpp"
+
+#include <cstddef>     // for offsetof
+#include <cstring>     // for memcpy
+#include <stdexcept>   // for runtime_error
+#include <type_traits> // for is_same_v, is_enum_v, underlying_type_t
+
+#include "entity.hpp"    // for Entity
+#include "entity_db.hpp" // for EntityDB
+#include "layer.hpp"     // for Layer, EntityList
+#include "movable.hpp"   // for Movable
+#include "state.hpp"     // for StateMemory, get_state_ptr
+
+namespace
+{
+template <class T>
+constexpr ENTITY_FIELD_TYPE field_type_of()
+{
+    if constexpr (std::is_enum_v<T>)
+        return field_type_of<std::underlying_type_t<T>>();
+    else if constexpr (std::is_same_v<T, float>)
+        return ENTITY_FIELD_TYPE::FLOAT;
+    else if constexpr (std::is_same_v<T, int32_t>)
+        return ENTITY_FIELD_TYPE::INT32;
+    else if constexpr (std::is_same_v<T, uint32_t>)
+        return ENTITY_FIELD_TYPE::UINT32;
+    else if constexpr (std::is_same_v<T, uint16_t>)
+        return ENTITY_FIELD_TYPE::UINT16;
+    else if constexpr (std::is_same_v<T, uint8_t>)
+        return ENTITY_FIELD_TYPE::UINT8;
+    else if constexpr (std::is_same_v<T, bool>)
+        return ENTITY_FIELD_TYPE::BOOL;
+    else
+        static_assert(std::is_same_v<T, void>, "unsupported entity field type");
+}
+
+// Movable derives only from Entity, so the offsets of both share the same base
+static_assert(std::is_base_of_v<Entity, Movable>);
+#define ENTITY_FIELD(field) EntityField{#field, field_type_of<decltype(Entity::field)>(), false, offsetof(Entity, field)}
+#define MOVABLE_FIELD(field) EntityField{#field, field_type_of<decltype(Movable::field)>(), true, offsetof(Movable, field)}
+const EntityField g_entity_fields[]{
+    EntityField{"type_id", ENTITY_FIELD_TYPE::TYPE_ID, false, 0},
+    ENTITY_FIELD(uid),
+    ENTITY_FIELD(flags),
+    ENTITY_FIELD(more_flags),
+    ENTITY_FIELD(animation_frame),
+    ENTITY_FIELD(draw_depth),
+    ENTITY_FIELD(x),
+    ENTITY_FIELD(y),
+    ENTITY_FIELD(abs_x),
+    ENTITY_FIELD(abs_y),
+    ENTITY_FIELD(w),
+    ENTITY_FIELD(h),
+    ENTITY_FIELD(special_offsetx),
+    ENTITY_FIELD(special_offsety),
+    ENTITY_FIELD(offsetx),
+    ENTITY_FIELD(offsety),
+    ENTITY_FIELD(hitboxx),
+    ENTITY_FIELD(hitboxy),
+    ENTITY_FIELD(angle),
+    ENTITY_FIELD(tilew),
+    ENTITY_FIELD(tileh),
+    ENTITY_FIELD(layer),
+    MOVABLE_FIELD(movex),
+    MOVABLE_FIELD(movey),
+    MOVABLE_FIELD(buttons),
+    MOVABLE_FIELD(buttons_previous),
+    MOVABLE_FIELD(stand_counter),
+    MOVABLE_FIELD(jump_height_multiplier),
+    MOVABLE_FIELD(price),
+    MOVABLE_FIELD(owner_uid),
+    MOVABLE_FIELD(last_owner_uid),
+    MOVABLE_FIELD(idle_counter),
+    MOVABLE_FIELD(standing_on_uid),
+    MOVABLE_FIELD(velocityx),
+    MOVABLE_FIELD(velocityy),
+    MOVABLE_FIELD(holding_uid),
+    MOVABLE_FIELD(state),
+    MOVABLE_FIELD(last_state),
+    MOVABLE_FIELD(move_state),
+    MOVABLE_FIELD(health),
+    MOVABLE_FIELD(stun_timer),
+};
+#undef ENTITY_FIELD
+#undef MOVABLE_FIELD
+
+template <class T>
+T read_raw(const Entity* entity, size_t offset)
+{
+    T value;
+    std::memcpy(&value, reinterpret_cast<const char*>(entity) + offset, sizeof(T));
+    return value;
+}
+} // namespace
+
+std::span<const EntityField> get_entity_fields()
+{
+    return g_entity_fields;
+}
+const EntityField* find_entity_field(std::string_view name)
+{
+    for (const EntityField& field : g_entity_fields)
+    {
+        if (field.name == name)
+            return &field;
+    }
+    return nullptr;
+}
+
+double read_entity_field(const Entity* entity, const EntityField& field)
+{
+    switch (field.type)
+    {
+    case ENTITY_FIELD_TYPE::FLOAT:
+        return read_raw<float>(entity, field.offset);
+    case ENTITY_FIELD_TYPE::INT32:
+        return read_raw<int32_t>(entity, field.offset);
+    case ENTITY_FIELD_TYPE::UINT32:
+        return read_raw<uint32_t>(entity, field.offset);
+    case ENTITY_FIELD_TYPE::UINT16:
+        return read_raw<uint16_t>(entity, field.offset);
+    case ENTITY_FIELD_TYPE::UINT8:
+        return read_raw<uint8_t>(entity, field.offset);
+    case ENTITY_FIELD_TYPE::BOOL:
+        return read_raw<bool>(entity, field.offset) ? 1.0 : 0.0;
+    case ENTITY_FIELD_TYPE::TYPE_ID:
+        return entity->type != nullptr ? entity->type->id : 0;
+    }
+    return 0.0;
+}
+
+size_t entity_field_size(ENTITY_FIELD_TYPE type)
+{
+    switch (type)
+    {
+    case ENTITY_FIELD_TYPE::UINT16:
+        return 2;
+    case ENTITY_FIELD_TYPE::UINT8:
+    case ENTITY_FIELD_TYPE::BOOL:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+EntitySnapshot::EntitySnapshot(ENTITY_MASK mask, LAYER layer, const std::vector<std::string>& field_names)
+{
+    columns.reserve(field_names.size());
+    for (const std::string& name : field_names)
+    {
+        const EntityField* field = find_entity_field(name);
+        if (field == nullptr)
+            throw std::runtime_error("snapshot_entities: no field '" + name + "'");
+        columns.push_back({field, {}});
+    }
+
+    StateMemory* state = get_state_ptr();
+    const EntityList* lists[2]{};
+    if (layer == LAYER::BOTH)
+    {
+        lists[0] = &state->layers[0]->all_entities;
+        lists[1] = &state->layers[1]->all_entities;
+    }
+    else
+    {
+        lists[0] = &state->layer(layer)->all_entities;
+    }
+
+    uint32_t capacity = 0;
+    for (const EntityList* list : lists)
+        capacity += list ? list->size : 0;
+    for (Column& column : columns)
+        column.data.resize((size_t)capacity * entity_field_size(column.field->type));
+
+    for (const EntityList* list : lists)
+    {
+        if (list == nullptr)
+            continue;
+        for (Entity* entity : list->entities())
+        {
+            if (mask != ENTITY_MASK::ANY && !(entity->type->search_flags & mask))
+                continue;
+            const bool is_movable = entity->is_movable();
+            for (Column& column : columns)
+            {
+                const EntityField& field = *column.field;
+                if (field.movable && !is_movable)
+                    continue;
+                const size_t size = entity_field_size(field.type);
+                uint8_t* out = column.data.data() + (size_t)count * size;
+                if (field.type == ENTITY_FIELD_TYPE::TYPE_ID)
+                    std::memcpy(out, &entity->type->id, size);
+                else
+                    std::memcpy(out, reinterpret_cast<const char*>(entity) + field.offset, size);
+            }
+            count++;
+        }
+    }
+    for (Column& column : columns)
+        column.data.resize((size_t)count * entity_field_size(column.field->type));
+}
+
+const EntitySnapshot::Column* EntitySnapshot::find_column(std::string_view field) const
+{
+    for (const Column& column : columns)
+    {
+        if (column.field->name == field)
+            return &column;
+    }
+    return nullptr;
+}
+
+double EntitySnapshot::read(const Column& column, uint32_t index) const
+{
+    const uint8_t* in = column.data.data() + (size_t)index * entity_field_size(column.field->type);
+    const auto read_as = [in]<class T>(T)
+    {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        return (double)value;
+    };
+    switch (column.field->type)
+    {
+    case ENTITY_FIELD_TYPE::FLOAT:
+        return read_as(float{});
+    case ENTITY_FIELD_TYPE::INT32:
+        return read_as(int32_t{});
+    case ENTITY_FIELD_TYPE::UINT32:
+    case ENTITY_FIELD_TYPE::TYPE_ID:
+        return read_as(uint32_t{});
+    case ENTITY_FIELD_TYPE::UINT16:
+        return read_as(uint16_t{});
+    case ENTITY_FIELD_TYPE::UINT8:
+        return read_as(uint8_t{});
+    case ENTITY_FIELD_TYPE::BOOL:
+        return *in != 0 ? 1.0 : 0.0;
+    }
+    return 0.0;
+}
+
+std::optional<double> EntitySnapshot::get(std::string_view field, uint32_t index) const
+{
+    const Column* column = find_column(field);
+    if (column == nullptr || index == 0 || index > count)
+        return std::nullopt;
+    return read(*column, index - 1);
+}
+
+std::vector<double> EntitySnapshot::column(std::string_view field) const
+{
+    std::vector<double> values;
+    if (const Column* column = find_column(field))
+    {
+        values.reserve(count);
+        for (uint32_t i = 0; i < count; ++i)
+            values.push_back(read(*column, i));
+    }
+    return values;
+}
+
+std::string EntitySnapshot::serialize() const
+{
+    std::string out;
+    const auto write_u32 = [&out](uint32_t value)
+    { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    out.append("OLES", 4);
+    write_u32(FORMAT_VERSION);
+    write_u32(count);
+    write_u32((uint32_t)columns.size());
+    for (const Column& column : columns)
+    {
+        out.push_back((char)column.field->name.size());
+        out.append(column.field->name);
+        out.push_back((char)column.field->type);
+        out.append(reinterpret_cast<const char*>(column.data.data()), column.data.size());
+    }
+    return out;
+}
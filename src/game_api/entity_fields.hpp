@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t, uint32_t
+#include <optional>    // for optional
+#include <span>        // for span
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+#include "aliases.hpp" // for ENTITY_MASK, LAYER
+
+class Entity;
+
+enum class ENTITY_FIELD_TYPE : uint8_t
+{
+    FLOAT,
+    INT32,
+    UINT32,
+    UINT16,
+    UINT8,
+    BOOL,
+    // type->id, the only field that isn't stored in the entity itself
+    TYPE_ID,
+};
+
+// A field of Entity or Movable read straight from its offset, for reading many fields or many entities without going through the usertypes
+struct EntityField
+{
+    std::string_view name;
+    ENTITY_FIELD_TYPE type;
+    // Only exists on entities that are `is_movable`
+    bool movable;
+    size_t offset;
+};
+
+// Same names as the usertype fields
+std::span<const EntityField> get_entity_fields();
+const EntityField* find_entity_field(std::string_view name);
+
+// Doesn't check if the entity has the field, the movable ones need `is_movable`
+double read_entity_field(const Entity* entity, const EntityField& field);
+inline bool is_integer_field(const EntityField& field)
+{
+    return field.type != ENTITY_FIELD_TYPE::FLOAT && field.type != ENTITY_FIELD_TYPE::BOOL;
+}
+
+/// Some fields of every entity matching a mask, taken in one pass over the entity lists and stored as one packed column per field, see [snapshot_entities](#snapshot_entities)
+/// Entities that don't have a field, like the Movable fields on a floor, have 0 in its column
+class EntitySnapshot
+{
+  public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    // Throws on unknown field names
+    EntitySnapshot(ENTITY_MASK mask, LAYER layer, const std::vector<std::string>& field_names);
+
+    /// Number of entities in the snapshot
+    uint32_t size() const
+    {
+        return count;
+    }
+    /// Value of a field of the entity at `index` (1-based), nil if out of range or the field wasn't taken
+    std::optional<double> get(std::string_view field, uint32_t index) const;
+    /// The whole column of a field, in the same order as the uids
+    std::vector<double> column(std::string_view field) const;
+    /// Binary form, for sending it with a UdpServer or saving it: "OLES", u32 version, u32 count, u32 number of columns,
+    /// then for each column a u8 name length, the name, a u8 type (0 float, 1 int32, 2 uint32, 3 uint16, 4 uint8, 5 bool, 6 uint32 type id) and count values, all little-endian
+    std::string serialize() const;
+
+  private:
+    struct Column
+    {
+        const EntityField* field;
+        std::vector<uint8_t> data;
+    };
+    const Column* find_column(std::string_view field) const;
+    double read(const Column& column, uint32_t index) const;
+
+    uint32_t count{0};
+    std::vector<Column> columns;
+};
+
+size_t entity_field_size(ENTITY_FIELD_TYPE type);
@@ -1,11 +1,19 @@
 #include "entity_lookup.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "custom_types.hpp"
 #include "entity.hpp"
+#include "entity_db.hpp"
+#include "entity_traversal.hpp"
 #include "layer.hpp"
+#include "movable.hpp"
 #include "state.hpp"
 
 bool entity_type_check(const std::vector<ENT_TYPE>& types_array, const ENT_TYPE find)
@@ -36,6 +44,21 @@ std::vector<ENT_TYPE> get_proper_types(std::vector<ENT_TYPE> ent_types)
     return ent_types;
 }
 
+EntityTypeSet::EntityTypeSet(const std::vector<ENT_TYPE>& entity_types)
+{
+    any = entity_types.empty() || entity_types[0] == 0;
+    if (any)
+        return;
+
+    for (ENT_TYPE type : entity_types)
+    {
+        if (type >= (ENT_TYPE)CUSTOM_TYPE::ACIDBUBBLE)
+            types |= get_custom_entity_type_bitmap(static_cast<CUSTOM_TYPE>(type));
+        else if (type <= MAX_TYPE)
+            types.set(type);
+    }
+}
+
 int32_t get_grid_entity_at(float x, float y, LAYER layer)
 {
     if (Entity* ent = get_state_ptr()->layer(layer)->get_grid_entity_at(x, y))
@@ -44,6 +67,47 @@ int32_t get_grid_entity_at(float x, float y, LAYER layer)
     return -1;
 }
 
+int32_t GridEntities::get(float gx, float gy) const
+{
+    const int32_t ix = static_cast<int32_t>(std::round(gx)) - x;
+    const int32_t iy = y - static_cast<int32_t>(std::round(gy));
+    if (ix < 0 || ix >= width || iy < 0 || iy >= height)
+        return -1;
+    return uids[iy * width + ix];
+}
+
+GridEntities get_grid_entities_in_rect(float x1, float y1, float x2, float y2, LAYER layer)
+{
+    const int32_t left = std::max(static_cast<int32_t>(std::round(std::min(x1, x2))), 0);
+    const int32_t right = std::min(static_cast<int32_t>(std::round(std::max(x1, x2))), static_cast<int32_t>(g_level_max_x) - 1);
+    const int32_t bottom = std::max(static_cast<int32_t>(std::round(std::min(y1, y2))), 0);
+    const int32_t top = std::min(static_cast<int32_t>(std::round(std::max(y1, y2))), static_cast<int32_t>(g_level_max_y) - 1);
+
+    GridEntities grid;
+    if (left > right || bottom > top)
+        return grid;
+
+    grid.x = left;
+    grid.y = top;
+    grid.width = right - left + 1;
+    grid.height = top - bottom + 1;
+    grid.uids.resize(static_cast<size_t>(grid.width) * grid.height, -1);
+
+    // Each row of the rectangle is contiguous in the layer's grid
+    const Layer* layer_ptr = get_state_ptr()->layer(layer);
+    int32_t* out = grid.uids.data();
+    for (int32_t iy = top; iy >= bottom; --iy)
+    {
+        Entity* const* row = layer_ptr->grid_entities[iy];
+        for (int32_t ix = left; ix <= right; ++ix, ++out)
+        {
+            if (Entity* ent = row[ix])
+                *out = ent->uid;
+        }
+    }
+    return grid;
+}
+
 std::vector<uint32_t> get_entities_overlapping_grid(float x, float y, LAYER layer)
 {
     auto state = get_state_ptr();
@@ -61,6 +125,51 @@ std::vector<uint32_t> get_entities_overlapping_grid(float x, float y, LAYER laye
     return uids;
 }
 
+EntityListView::EntityListView(Source source_, LAYER layer_, uint32_t key_)
+    : source{source_}, layer{enum_to_layer(layer_)}, key{key_}
+{
+}
+const EntityList* EntityListView::get() const
+{
+    Layer* l = get_state_ptr()->layers[layer];
+    switch (source)
+    {
+    case Source::ALL:
+        return &l->all_entities;
+    case Source::MASK:
+    {
+        auto it = l->entities_by_mask.find(key);
+        return it != l->entities_by_mask.end() ? &it->second : nullptr;
+    }
+    case Source::DRAW_DEPTH:
+        return key < l->entities_by_draw_depth.size() ? &l->entities_by_draw_depth[key] : nullptr;
+    case Source::GRID:
+    {
+        const uint32_t ix = key % g_level_max_x;
+        const uint32_t iy = key / g_level_max_x;
+        return iy < g_level_max_y ? &l->entities_overlapping_grid[iy][ix] : nullptr;
+    }
+    }
+    return nullptr;
+}
+uint32_t EntityListView::size() const
+{
+    const EntityList* list = get();
+    return list ? list->size : 0;
+}
+std::optional<uint32_t> EntityListView::uid_at(uint32_t index) const
+{
+    const EntityList* list = get();
+    if (list && index < list->size)
+        return list->uid_list[index];
+    return std::nullopt;
+}
+bool EntityListView::contains(uint32_t uid) const
+{
+    const EntityList* list = get();
+    return list && list->contains(uid);
+}
+
 template <class FunT>
 requires std::is_invocable_v<FunT, const EntityList&>
 void foreach_mask(ENTITY_MASK mask, Layer* l, FunT&& fun)
@@ -85,19 +194,123 @@ void foreach_mask(ENTITY_MASK mask, Layer* l, FunT&& fun)
     }
 }
 
-std::vector<uint32_t> get_entities_by(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, LAYER layer)
+// Type ids of the entities in `all_entities` of a layer, copied next to each other so filtering by type doesn't have to
+// load every entity and then its type, with the amount of entities of each type. It's compared to the uids of the list on
+// every use, the list is ordered by uid so the two are merged: kept uids keep their type, only new ones load theirs
+// A uid only keeps its type as long as the state isn't replaced, loading a state can give it to an entity of another type,
+// so `EntityCounter::invalidate` bumps the generation and every type is read again
+struct LayerTypeShadow
 {
-    auto state = get_state_ptr();
-    std::vector<uint32_t> found;
-    const std::vector<ENT_TYPE> proper_types = get_proper_types(std::move(entity_types));
+    const Layer* layer{nullptr};
+    uint64_t generation{0};
+    std::vector<uint32_t> uids;
+    std::vector<uint16_t> types;
+    std::array<uint32_t, EntityTypeSet::MAX_TYPE + 1> by_type{};
+};
+std::array<LayerTypeShadow, 2> g_type_shadows;
+std::atomic<uint64_t> g_shadow_generation{1};
 
-    auto push_matching_types = [&proper_types, &found](const EntityList& entities)
+void count_shadow_type(LayerTypeShadow& shadow, uint16_t type, int32_t delta)
+{
+    if (type <= EntityTypeSet::MAX_TYPE)
+        shadow.by_type[type] += delta;
+}
+
+const LayerTypeShadow& get_type_shadow(uint8_t layer)
+{
+    const Layer* l = get_state_ptr()->layers[layer];
+    const EntityList& entities = l->all_entities;
+    const auto uids = entities.uids();
+    LayerTypeShadow& shadow = g_type_shadows[layer];
+    const uint64_t generation = g_shadow_generation.load(std::memory_order_acquire);
+
+    if (shadow.layer == l && shadow.generation == generation)
     {
-        for (auto& item : entities.entities())
+        if (std::equal(shadow.uids.begin(), shadow.uids.end(), uids.begin(), uids.end()))
+            return shadow;
+
+        // Removed uids drop out and new ones are loaded, falls back to reading all of them if the list isn't in order after all
+        std::vector<uint32_t> merged_uids;
+        std::vector<uint16_t> merged_types;
+        merged_uids.reserve(uids.size());
+        merged_types.reserve(uids.size());
+        size_t old = 0;
+        bool ordered = true;
+        for (size_t i = 0; i < uids.size() && ordered; ++i)
         {
-            if (entity_type_check(proper_types, item->type->id))
+            const uint32_t uid = uids[i];
+            ordered = i == 0 || uids[i - 1] < uid;
+            while (old < shadow.uids.size() && shadow.uids[old] < uid)
+                count_shadow_type(shadow, shadow.types[old++], -1);
+            uint16_t type;
+            if (old < shadow.uids.size() && shadow.uids[old] == uid)
             {
-                found.push_back(item->uid);
+                type = shadow.types[old++];
+            }
+            else
+            {
+                type = static_cast<uint16_t>(entities.ent_list[i]->type->id);
+                count_shadow_type(shadow, type, 1);
+            }
+            merged_uids.push_back(uid);
+            merged_types.push_back(type);
+        }
+        if (ordered)
+        {
+            while (old < shadow.uids.size())
+                count_shadow_type(shadow, shadow.types[old++], -1);
+            shadow.uids = std::move(merged_uids);
+            shadow.types = std::move(merged_types);
+            return shadow;
+        }
+    }
+
+    shadow.layer = l;
+    shadow.generation = generation;
+    shadow.uids.assign(uids.begin(), uids.end());
+    shadow.types.resize(entities.size);
+    shadow.by_type.fill(0);
+    for (size_t i = 0; i < entities.size; ++i)
+    {
+        shadow.types[i] = static_cast<uint16_t>(entities.ent_list[i]->type->id);
+        count_shadow_type(shadow, shadow.types[i], 1);
+    }
+    return shadow;
+}
+
+void fill_entities_by(std::vector<uint32_t>& found, const EntityTypeSet& types, ENTITY_MASK mask, LAYER layer)
+{
+    auto state = get_state_ptr();
+    // Results stay in the same order as going through `all_entities`, the lists of the masks aren't shadowed
+    auto push_matching_shadow = [&types, &found](uint8_t layer_index)
+    {
+        const LayerTypeShadow& shadow = get_type_shadow(layer_index);
+        for (size_t i = 0; i < shadow.types.size(); ++i)
+        {
+            if (types.contains(shadow.types[i]))
+            {
+                found.push_back(shadow.uids[i]);
+            }
+        }
+    };
+    auto push_matching_types = [&types, &found](const EntityList& entities)
+    {
+        // Gather the type ids first, so the loads of entity and type pointers don't have to wait for the checks
+        constexpr uint32_t batch_size = 64;
+        std::array<ENT_TYPE, batch_size> ids;
+        for (uint32_t start = 0; start < entities.size; start += batch_size)
+        {
+            const uint32_t count = std::min(batch_size, entities.size - start);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                ids[i] = entities.ent_list[start + i]->type->id;
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (types.contains(ids[i]))
+                {
+                    found.push_back(entities.uid_list[start + i]);
+                }
             }
         }
     };
@@ -111,7 +324,7 @@ std::vector<uint32_t> get_entities_by(std::vector<ENT_TYPE> entity_types, ENTITY
     {
         auto layer_front = state->layers[0];
         auto layer_back = state->layers[1];
-        if (proper_types.empty() || proper_types[0] == 0)
+        if (types.matches_any())
         {
             if (mask == ENTITY_MASK::ANY) // all entities
             {
@@ -126,6 +339,11 @@ std::vector<uint32_t> get_entities_by(std::vector<ENT_TYPE> entity_types, ENTITY
                 foreach_mask(mask, layer_back, insert_all_uids);
             }
         }
+        else if (mask == ENTITY_MASK::ANY)
+        {
+            push_matching_shadow(0);
+            push_matching_shadow(1);
+        }
         else
         {
             foreach_mask(mask, layer_front, push_matching_types);
@@ -134,79 +352,350 @@ std::vector<uint32_t> get_entities_by(std::vector<ENT_TYPE> entity_types, ENTITY
     }
     else
     {
-        if (proper_types.empty() || proper_types[0] == 0) // all types
+        if (types.matches_any()) // all types
         {
             foreach_mask(mask, state->layer(layer), insert_all_uids);
         }
+        else if (mask == ENTITY_MASK::ANY)
+        {
+            push_matching_shadow(enum_to_layer(layer));
+        }
         else
         {
             foreach_mask(mask, state->layer(layer), push_matching_types);
         }
     }
-    return found;
 }
 
-std::vector<uint32_t> get_entities_at(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, float x, float y, LAYER layer, float radius)
+std::vector<uint32_t> get_entities_by(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, LAYER layer)
 {
-    // TODO: use entity regions?
-    auto state = get_state_ptr();
     std::vector<uint32_t> found;
-    const std::vector<ENT_TYPE> proper_types = get_proper_types(std::move(entity_types));
-    auto push_entities_at = [&x, &y, &radius, &proper_types, &found](const EntityList& entities)
+    fill_entities_by(found, EntityTypeSet{entity_types}, mask, layer);
+    return found;
+}
+
+EntityCounter& EntityCounter::get()
+{
+    static EntityCounter counter;
+    return counter;
+}
+
+void EntityCounter::invalidate()
+{
+    g_shadow_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+uint32_t EntityCounter::count_in(const std::vector<ENT_TYPE>& entity_types, ENTITY_MASK mask, uint8_t layer)
+{
+    Layer* l = get_state_ptr()->layers[layer];
+    if (entity_types.empty() || entity_types[0] == 0)
+    {
+        // The game keeps these lists anyway
+        if (mask == ENTITY_MASK::ANY)
+            return l->all_entities.size;
+        uint32_t total = 0;
+        foreach_mask(mask, l, [&total](const EntityList& entities)
+                     { total += entities.size; });
+        return total;
+    }
+
+    const LayerTypeShadow& shadow = get_type_shadow(layer);
+    // Types listed twice or also part of a custom type are only counted once, like `get_entities_by`
+    EntityTypeBitmap counted;
+    uint32_t total = 0;
+    auto add_type = [&](ENT_TYPE type)
+    {
+        if (type > EntityTypeSet::MAX_TYPE || counted.test(type))
+            return;
+        counted.set(type);
+        if (mask != ENTITY_MASK::ANY)
+        {
+            const EntityDB* db = get_type(type);
+            if (db == nullptr || !(db->search_flags & mask))
+                return;
+        }
+        total += shadow.by_type[type];
+    };
+    for (ENT_TYPE type : entity_types)
+    {
+        if (type >= (ENT_TYPE)CUSTOM_TYPE::ACIDBUBBLE)
+        {
+            for (ENT_TYPE custom_type : get_custom_entity_types(static_cast<CUSTOM_TYPE>(type)))
+                add_type(custom_type);
+        }
+        else
+        {
+            add_type(type);
+        }
+    }
+    return total;
+}
+
+uint32_t EntityCounter::count(const std::vector<ENT_TYPE>& entity_types, ENTITY_MASK mask, LAYER layer)
+{
+    if (layer == LAYER::BOTH)
+        return count_in(entity_types, mask, 0) + count_in(entity_types, mask, 1);
+    return count_in(entity_types, mask, enum_to_layer(layer));
+}
+
+uint32_t get_entity_count(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, LAYER layer)
+{
+    return EntityCounter::get().count(entity_types, mask, layer);
+}
+
+// Entities with those masks are kept in the `entities_by_region*` grids and `entity_regions`
+// (FX, FLOOR, DECORATION, BG, SHADOW and LOGICAL are not)
+constexpr ENTITY_MASK g_region_masks = ENTITY_MASK::PLAYER | ENTITY_MASK::MOUNT | ENTITY_MASK::MONSTER | ENTITY_MASK::ITEM | ENTITY_MASK::EXPLOSION |
+                                       ENTITY_MASK::ROPE | ENTITY_MASK::ACTIVEFLOOR | ENTITY_MASK::LIQUID;
+constexpr ENTITY_MASK g_all_masks = static_cast<ENTITY_MASK>(0x7fff);
+constexpr int32_t g_region_size = 4;
+constexpr int32_t g_region_rows = 31;
+constexpr int32_t g_region_columns = 21;
+
+int32_t region_index(float pos, int32_t max)
+{
+    return std::clamp(static_cast<int32_t>(std::floor(pos / g_region_size)), 0, max - 1);
+}
+
+// Checks if the region grids can be trusted, the game only updates them on state update, so freshly spawned entities or entities
+// moved between layers can be missing until then
+bool regions_are_complete(Layer* l)
+{
+    size_t tracked_count = 0;
+    for (uint32_t test_flag = 1U; test_flag < 0x8000; test_flag <<= 1U)
+    {
+        if (!(g_region_masks & static_cast<ENTITY_MASK>(test_flag)))
+            continue;
+
+        const auto& it = l->entities_by_mask.find(test_flag);
+        if (it != l->entities_by_mask.end())
+            tracked_count += it->second.size;
+    }
+    return tracked_count == l->entity_regions.size();
+}
+
+void push_with_items(std::vector<Entity*>& candidates, Entity* ent)
+{
+    candidates.push_back(ent);
+    for (auto item : ent->items.entities())
+        push_with_items(candidates, item);
+}
+
+// Calls `fun` for every entity matching the mask that could be inside the box, candidates still need an exact check
+template <class FunT>
+requires std::is_invocable_v<FunT, Entity*>
+void foreach_entity_near(ENTITY_MASK mask, Layer* l, AABB box, FunT&& fun)
+{
+    const ENTITY_MASK region_mask = (mask == ENTITY_MASK::ANY ? g_all_masks : mask) & g_region_masks;
+    if (!region_mask || !regions_are_complete(l))
+    {
+        foreach_mask(mask, l, [&fun](const EntityList& entities)
+                     {
+                         for (auto item : entities.entities())
+                             fun(item); });
+        return;
+    }
+
+    const ENTITY_MASK scan_mask = (mask == ENTITY_MASK::ANY ? g_all_masks : mask) & ~g_region_masks;
+    if (!!scan_mask)
     {
-        for (auto& item : entities.entities())
+        foreach_mask(scan_mask, l, [&fun](const EntityList& entities)
+                     {
+                         for (auto item : entities.entities())
+                             fun(item); });
+    }
+
+    // one extra region on each side for entities that moved since the last state update
+    const int32_t min_x = std::max(region_index(box.left, g_region_columns) - 1, 0);
+    const int32_t max_x = std::min(region_index(box.right, g_region_columns) + 1, g_region_columns - 1);
+    const int32_t min_y = std::max(region_index(box.bottom, g_region_rows) - 1, 0);
+    const int32_t max_y = std::min(region_index(box.top, g_region_rows) + 1, g_region_rows - 1);
+
+    static thread_local std::vector<Entity*> candidates;
+    candidates.clear();
+    for (auto regions : {l->entities_by_region1, l->entities_by_region2, l->entities_by_region3, l->entities_by_region4})
+    {
+        for (int32_t y = min_y; y <= max_y; ++y)
         {
-            auto [ix, iy] = item->abs_position();
-            float distance = (float)std::sqrt(std::pow(x - ix, 2) + std::pow(y - iy, 2));
-            if (distance < radius && entity_type_check(proper_types, item->type->id))
+            for (int32_t x = min_x; x <= max_x; ++x)
             {
-                found.push_back(item->uid);
+                for (auto item : regions[y][x].entities())
+                {
+                    if (!!(item->type->search_flags & region_mask))
+                        push_with_items(candidates, item);
+                }
             }
         }
+    }
+
+    // the same entity can be in multiple regions
+    std::sort(candidates.begin(), candidates.end(), [](Entity* a, Entity* b)
+              { return a->uid < b->uid; });
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    for (auto item : candidates)
+    {
+        // items of candidates can have any mask, the ones outside of the region masks were already visited by the scan
+        if (!!(item->type->search_flags & region_mask))
+            fun(item);
+    }
+}
+
+void fill_entities_at(std::vector<uint32_t>& found, const EntityTypeSet& types, ENTITY_MASK mask, float x, float y, LAYER layer, float radius)
+{
+    // Held items, mounts and backpacks share their overlays, each chain is only walked once for the whole query
+    AbsPositionScope positions;
+    auto state = get_state_ptr();
+    const float radius_sq = radius * radius;
+    const AABB box{x - radius, y + radius, x + radius, y - radius};
+    auto push_entity_at = [&x, &y, &radius_sq, &types, &found](Entity* item)
+    {
+        const auto [ix, iy] = item->abs_position();
+        const float dx = x - ix;
+        const float dy = y - iy;
+        if (dx * dx + dy * dy < radius_sq && types.contains(item->type->id))
+        {
+            found.push_back(item->uid);
+        }
     };
-    foreach_mask(mask, state->layer(layer), push_entities_at);
+    foreach_entity_near(mask, state->layer(layer), box, push_entity_at);
     if (layer == LAYER::BOTH)
     {
         // if it's both, then the actual_layer is 0
-        foreach_mask(mask, state->layers[1], push_entities_at);
+        foreach_entity_near(mask, state->layers[1], box, push_entity_at);
     }
-    return found;
 }
 
-std::vector<uint32_t> get_entities_overlapping_hitbox(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, AABB hitbox, LAYER layer)
+void fill_entities_overlapping(std::vector<uint32_t>& found, const EntityTypeSet& types, ENTITY_MASK mask, AABB hitbox, Layer* layer)
 {
-    // TODO: use entity regions?
-    auto state = get_state_ptr();
-    std::vector<uint32_t> result;
-    const std::vector<ENT_TYPE> proper_types = get_proper_types(std::move(entity_types));
-
-    result = get_entities_overlapping_by_pointer(proper_types, mask, hitbox.left, hitbox.bottom, hitbox.right, hitbox.top, state->layer(layer));
+    AbsPositionScope positions;
+    foreach_entity_near(mask, layer, hitbox, [&types, &found, &hitbox](Entity* item)
+                        {
+                            if (types.contains(item->type->id) && item->overlaps_with(hitbox))
+                            {
+                                found.push_back(item->uid);
+                            } });
+}
 
+void fill_entities_overlapping(std::vector<uint32_t>& found, const EntityTypeSet& types, ENTITY_MASK mask, AABB hitbox, LAYER layer)
+{
+    auto state = get_state_ptr();
+    fill_entities_overlapping(found, types, mask, hitbox, state->layer(layer));
     if (layer == LAYER::BOTH)
     {
         // if it's both, then the actual_layer is 0
-        auto result2 = get_entities_overlapping_by_pointer(proper_types, mask, hitbox.left, hitbox.bottom, hitbox.right, hitbox.top, state->layers[1]);
-        result.insert(result.end(), result2.begin(), result2.end());
+        fill_entities_overlapping(found, types, mask, hitbox, state->layers[1]);
     }
-    return result;
+}
+
+std::vector<uint32_t> get_entities_at(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, float x, float y, LAYER layer, float radius)
+{
+    std::vector<uint32_t> found;
+    fill_entities_at(found, EntityTypeSet{entity_types}, mask, x, y, layer, radius);
+    return found;
+}
+
+Entity* get_nearest_entity_at(ENTITY_MASK mask, float x, float y, Layer* layer, float radius)
+{
+    AbsPositionScope positions;
+    Entity* nearest = nullptr;
+    // Only shrinks, so the candidates outside of the best distance so far are dropped with one compare
+    float nearest_sq = radius * radius;
+    const AABB box{x - radius, y + radius, x + radius, y - radius};
+    foreach_entity_near(mask, layer, box, [&](Entity* item)
+                        {
+                            const auto [ix, iy] = item->abs_position();
+                            const float dx = x - ix;
+                            const float dy = y - iy;
+                            const float distance_sq = dx * dx + dy * dy;
+                            if (distance_sq < nearest_sq)
+                            {
+                                nearest = item;
+                                nearest_sq = distance_sq;
+                            } });
+    return nearest;
+}
+
+std::vector<uint32_t> get_entities_overlapping_hitbox(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, AABB hitbox, LAYER layer)
+{
+    std::vector<uint32_t> found;
+    fill_entities_overlapping(found, EntityTypeSet{entity_types}, mask, hitbox, layer);
+    return found;
 }
 
 std::vector<uint32_t> get_entities_overlapping_by_pointer(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, float sx, float sy, float sx2, float sy2, Layer* layer)
 {
     std::vector<uint32_t> found;
-    foreach_mask(mask, layer, [&entity_types, &found, &sx, &sy, &sx2, &sy2](const EntityList& entities)
-                 {
-                     for (auto& item : entities.entities())
-                     {
-                         if (entity_type_check(std::move(entity_types), item->type->id) && item->overlaps_with(sx, sy, sx2, sy2))
-                         {
-                             found.push_back(item->uid);
-                         }
-                     } });
+    fill_entities_overlapping(found, EntityTypeSet{entity_types}, mask, AABB{sx, sy2, sx2, sy}, layer);
+    return found;
+}
 
+EntityQuery::EntityQuery(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask_, LAYER layer_)
+    : mask{mask_}, layer{layer_}, types{entity_types}
+{
+}
+
+void EntityQuery::set_types(std::vector<ENT_TYPE> entity_types)
+{
+    types = EntityTypeSet{entity_types};
+}
+
+const std::vector<uint32_t>& EntityQuery::get_entities()
+{
+    found.clear();
+    fill_entities_by(found, types, mask, layer);
     return found;
 }
 
+const std::vector<uint32_t>& EntityQuery::get_entities_at(float x, float y, float radius)
+{
+    found.clear();
+    fill_entities_at(found, types, mask, x, y, layer, radius);
+    return found;
+}
+
+const std::vector<uint32_t>& EntityQuery::get_entities_overlapping_hitbox(AABB hitbox)
+{
+    found.clear();
+    fill_entities_overlapping(found, types, mask, hitbox, layer);
+    return found;
+}
+
+void EntityFilter::set_types(std::vector<ENT_TYPE> entity_types)
+{
+    types = EntityTypeSet{entity_types};
+}
+
+bool EntityFilter::matches(const Entity* entity) const
+{
+    // Cheapest tests first, the Movable ones only run for what is left
+    if ((entity->flags & flags) != flags || (entity->flags & not_flags) != 0)
+        return false;
+    if ((entity->more_flags & more_flags) != more_flags || (entity->more_flags & not_more_flags) != 0)
+        return false;
+    if (layer != LAYER::BOTH && entity->layer != static_cast<uint8_t>(layer))
+        return false;
+    if (overlay_uid && (entity->overlay != nullptr ? entity->overlay->uid : NO_UID) != overlay_uid.value())
+        return false;
+    if ((mask != ENTITY_MASK::ANY && !(entity->type->search_flags & mask)) || !types.contains(entity->type->id))
+        return false;
+
+    if (state || min_health || max_health || owner_uid)
+    {
+        if (!entity->is_movable())
+            return false;
+        const auto movable = static_cast<const Movable*>(entity);
+        if (state && movable->state != state.value())
+            return false;
+        if (min_health && movable->health < min_health.value())
+            return false;
+        if (max_health && movable->health > max_health.value())
+            return false;
+        if (owner_uid && movable->owner_uid != owner_uid.value())
+            return false;
+    }
+    return true;
+}
+
 bool entity_has_item_uid(uint32_t uid, uint32_t item_uid)
 {
     Entity* entity = get_entity_ptr(uid);
@@ -223,10 +712,10 @@ bool entity_has_item_type(uint32_t uid, std::vector<ENT_TYPE> entity_types)
         return false;
     if (entity->items.size > 0)
     {
-        const std::vector<ENT_TYPE> proper_types = get_proper_types(std::move(entity_types));
+        const EntityTypeSet types{entity_types};
         for (auto item : entity->items.entities())
         {
-            if (entity_type_check(proper_types, item->type->id))
+            if (types.contains(item->type->id))
                 return true;
         }
     }
@@ -241,8 +730,8 @@ std::vector<uint32_t> entity_get_items_by(uint32_t uid, std::vector<ENT_TYPE> en
         return found;
     if (entity->items.size > 0)
     {
-        const std::vector<ENT_TYPE> proper_types = get_proper_types(std::move(entity_types));
-        if ((!proper_types.size() || !proper_types[0]) && mask == ENTITY_MASK::ANY) // all items
+        const EntityTypeSet types{entity_types};
+        if (types.matches_any() && mask == ENTITY_MASK::ANY) // all items
         {
             const auto uids = entity->items.uids();
             found.insert(found.end(), uids.begin(), uids.end());
@@ -251,7 +740,7 @@ std::vector<uint32_t> entity_get_items_by(uint32_t uid, std::vector<ENT_TYPE> en
         {
             for (auto item : entity->items.entities())
             {
-                if ((mask == ENTITY_MASK::ANY || !!(item->type->search_flags & mask)) && entity_type_check(proper_types, item->type->id))
+                if ((mask == ENTITY_MASK::ANY || !!(item->type->search_flags & mask)) && types.contains(item->type->id))
                 {
                     found.push_back(item->uid);
                 }
@@ -261,6 +750,25 @@ std::vector<uint32_t> entity_get_items_by(uint32_t uid, std::vector<ENT_TYPE> en
     return found;
 }
 
+void for_each_descendant(uint32_t uid, ENTITY_MASK mask, std::vector<ENT_TYPE> entity_types, const std::function<bool(Entity*)>& fun)
+{
+    Entity* entity = get_entity_ptr(uid);
+    if (entity == nullptr)
+        return;
+
+    const EntityTypeSet types{get_proper_types(std::move(entity_types))};
+    for_each_attached(
+        entity,
+        [](Entity*)
+        { return true; },
+        [&](Entity* descendant)
+        {
+            if ((mask == ENTITY_MASK::ANY || !!(descendant->type->search_flags & mask)) && types.contains(descendant->type->id))
+                return fun(descendant);
+            return false;
+        });
+}
+
 std::vector<uint32_t> get_entities_by_draw_depth(std::vector<uint8_t> draw_depths, LAYER l)
 {
     auto state = get_state_ptr();
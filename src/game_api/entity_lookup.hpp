@@ -1,18 +1,179 @@
 #pragma once
 
+#include <array>
+#include <bitset>
 #include <cstdint>
+#include <functional>
+#include <optional>
 #include <vector>
 
 #include "aliases.hpp"
+#include "custom_types.hpp"
 #include "math.hpp"
 
 struct Layer;
+struct EntityList;
+class Entity;
+
+// Set of entity types with constant time lookup, CUSTOM_TYPE entries are merged in from their precomputed bitmaps
+// An empty set (or one starting with 0) matches every type, same as `entity_type_check`
+class EntityTypeSet
+{
+  public:
+    static constexpr ENT_TYPE MAX_TYPE = 0x393;
+
+    EntityTypeSet() = default;
+    explicit EntityTypeSet(const std::vector<ENT_TYPE>& entity_types);
+
+    bool matches_any() const
+    {
+        return any;
+    }
+    bool contains(ENT_TYPE type) const
+    {
+        return any || (type <= MAX_TYPE && types.test(type));
+    }
+
+  private:
+    EntityTypeBitmap types;
+    bool any{true};
+};
+
+// Reusable entity lookup, the types are resolved once and the results are written into a buffer that is kept between calls
+class EntityQuery
+{
+  public:
+    EntityQuery(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask_, LAYER layer_);
+    EntityQuery(ENT_TYPE entity_type, ENTITY_MASK mask_, LAYER layer_)
+        : EntityQuery(std::vector<ENT_TYPE>{entity_type}, mask_, layer_)
+    {
+    }
+
+    void set_types(std::vector<ENT_TYPE> entity_types);
+
+    ENTITY_MASK mask;
+    LAYER layer;
+
+    // Same as the free functions, the returned reference is valid until the next query
+    const std::vector<uint32_t>& get_entities();
+    const std::vector<uint32_t>& get_entities_at(float x, float y, float radius);
+    const std::vector<uint32_t>& get_entities_overlapping_hitbox(AABB hitbox);
+
+    const std::vector<uint32_t>& results() const
+    {
+        return found;
+    }
+
+  private:
+    EntityTypeSet types;
+    std::vector<uint32_t> found;
+};
+
+// Declarative entity predicate, every condition is tested natively so filtering a lot of entities doesn't call a function for each one
+// An entity passes when it passes all the conditions that are set, the ones on Movable fields fail for entities that aren't movable
+struct EntityFilter
+{
+    ENTITY_MASK mask{ENTITY_MASK::ANY};
+    LAYER layer{LAYER::BOTH};
+    // All of these bits have to be set
+    uint32_t flags{0};
+    // None of these bits may be set
+    uint32_t not_flags{0};
+    uint32_t more_flags{0};
+    uint32_t not_more_flags{0};
+    std::optional<uint8_t> state;
+    std::optional<uint8_t> min_health;
+    std::optional<uint8_t> max_health;
+    // The uid the game uses for no entity, the same type as Entity::uid
+    static constexpr int32_t NO_UID = -1;
+
+    // NO_UID to only pass entities without an owner
+    std::optional<int32_t> owner_uid;
+    // NO_UID to only pass entities that aren't attached to anything
+    std::optional<int32_t> overlay_uid;
+
+    void set_types(std::vector<ENT_TYPE> entity_types);
+    // `layer` is compared as is, so it has to be FRONT, BACK or BOTH here
+    bool matches(const Entity* entity) const;
+
+  private:
+    EntityTypeSet types;
+};
+
+// Read-only view of one of the entity lists of a layer, the list is looked up again on every access so a view stays valid between levels
+class EntityListView
+{
+  public:
+    enum class Source : uint8_t
+    {
+        ALL,
+        MASK,
+        DRAW_DEPTH,
+        GRID,
+    };
+
+    EntityListView(Source source_, LAYER layer_, uint32_t key_ = 0);
+
+    // The current list, nullptr if it doesn't exist
+    const EntityList* get() const;
+    uint32_t size() const;
+    // Index is 0-based, returns nullopt when out of range
+    std::optional<uint32_t> uid_at(uint32_t index) const;
+    bool contains(uint32_t uid) const;
+
+  private:
+    Source source;
+    uint8_t layer;
+    uint32_t key;
+};
+
+// Number of entities of each type in both layers, kept with the type shadow of the layer lists: counts follow the uids that
+// were added to or removed from a list since the last call, only the types of new entities are loaded
+class EntityCounter
+{
+  public:
+    static EntityCounter& get();
+
+    // The state was replaced or a layer was loaded or unloaded, uids may now belong to entities of other types
+    void invalidate();
+
+    // Goes through the types only, not the entities, except the ones added since the last call
+    uint32_t count(const std::vector<ENT_TYPE>& entity_types, ENTITY_MASK mask, LAYER layer);
+
+  private:
+    EntityCounter() = default;
+
+    uint32_t count_in(const std::vector<ENT_TYPE>& entity_types, ENTITY_MASK mask, uint8_t layer);
+};
 
 int32_t get_grid_entity_at(float x, float y, LAYER layer);
 
+// Copy of the grid entities in a rectangle of a layer, packed row by row
+struct GridEntities
+{
+    /// Grid x of the left column
+    int32_t x{0};
+    /// Grid y of the top row
+    int32_t y{0};
+    int32_t width{0};
+    int32_t height{0};
+    /// Uids row by row from the top row down and left to right in each row, -1 where there is no grid entity
+    std::vector<int32_t> uids;
+
+    /// Uid of the grid entity at the position, -1 if there is none or the position is outside of the rectangle
+    int32_t get(float x, float y) const;
+};
+GridEntities get_grid_entities_in_rect(float x1, float y1, float x2, float y2, LAYER layer);
+
 std::vector<uint32_t> get_entities_overlapping_grid(float x, float y, LAYER layer);
 
 std::vector<uint32_t> get_entities_by(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, LAYER layer);
+// Same as the size of `get_entities_by` without building the list
+uint32_t get_entity_count(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, LAYER layer);
+inline uint32_t get_entity_count(ENT_TYPE entity_type, ENTITY_MASK mask, LAYER layer)
+{
+    return get_entity_count(std::vector<ENT_TYPE>{entity_type}, mask, layer);
+}
 
 inline std::vector<uint32_t> get_entities()
 {
@@ -43,6 +204,8 @@ inline std::vector<uint32_t> get_entities_at(ENT_TYPE entity_type, ENTITY_MASK m
 {
     return get_entities_at(std::vector<ENT_TYPE>{entity_type}, mask, x, y, layer, radius);
 }
+// Closest entity to the point that is inside the radius, nullptr if there is none, goes through the region grids like get_entities_at
+Entity* get_nearest_entity_at(ENTITY_MASK mask, float x, float y, Layer* layer, float radius);
 std::vector<uint32_t> get_entities_overlapping_hitbox(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask, AABB hitbox, LAYER layer);
 inline std::vector<uint32_t> get_entities_overlapping_hitbox(ENT_TYPE entity_type, ENTITY_MASK mask, AABB hitbox, LAYER layer)
 {
@@ -72,6 +235,9 @@ inline std::vector<uint32_t> entity_get_items_by(uint32_t uid, ENT_TYPE entity_t
 {
     return entity_get_items_by(uid, std::vector<ENT_TYPE>{entity_type}, mask);
 }
+// Everything attached to the entity, also what is attached to its items and so on, children before their parent
+// Calls `fun` for the ones matching the types and mask, return true from it to stop
+void for_each_descendant(uint32_t uid, ENTITY_MASK mask, std::vector<ENT_TYPE> entity_types, const std::function<bool(Entity*)>& fun);
 std::vector<uint32_t> get_entities_by_draw_depth(std::vector<uint8_t> draw_depths, LAYER l);
 inline std::vector<uint32_t> get_entities_by_draw_depth(uint8_t draw_depth, LAYER l)
 {
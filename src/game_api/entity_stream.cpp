@@ -0,0 +1,239 @@
+#include "entity_stream.hpp"
+
+#include <algorithm> // for sort, find_if, clamp, max
+#include <cmath>     // for lround
+#include <mutex>     // for mutex, lock_guard
+#include <utility>   // for move
+
+#include "entity_fields.hpp" // for EntitySnapshot
+
+namespace
+{
+std::mutex g_streams_lock;
+std::vector<EntityStream*> g_streams;
+
+void write_varint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+void write_zigzag(std::string& out, int64_t value)
+{
+    write_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+int32_t quantize(double position)
+{
+    // Some entities that are never placed have huge positions, they only have to survive the round trip
+    return static_cast<int32_t>(std::lround(std::clamp(position, -1e6, 1e6) * EntityStreamEncoder::POSITION_SCALE));
+}
+
+// Starts a new datagram whenever the current one is full, records never span two of them
+class DatagramWriter
+{
+  public:
+    DatagramWriter(uint8_t kind, uint32_t frame)
+        : kind{kind}, frame{frame}
+    {
+        begin();
+    }
+
+    std::string& record(int32_t uid, uint8_t op)
+    {
+        // The biggest record is a change of everything with 5 byte varints
+        if (current.size() + 32 > EntityStreamEncoder::MAX_DATAGRAM)
+        {
+            datagrams.push_back(std::move(current));
+            begin();
+        }
+        current.push_back(static_cast<char>(op));
+        write_varint(current, static_cast<uint32_t>(uid - last_uid));
+        last_uid = uid;
+        return current;
+    }
+
+    std::vector<std::string> finish()
+    {
+        current[5] = static_cast<char>(kind | 0x80);
+        datagrams.push_back(std::move(current));
+        return std::move(datagrams);
+    }
+
+  private:
+    void begin()
+    {
+        current.clear();
+        current.append("OLDS", 4);
+        current.push_back(static_cast<char>(EntityStreamEncoder::VERSION));
+        current.push_back(static_cast<char>(kind));
+        write_varint(current, frame);
+        last_uid = 0;
+    }
+
+    uint8_t kind;
+    uint32_t frame;
+    int32_t last_uid{0};
+    std::string current;
+    std::vector<std::string> datagrams;
+};
+
+void write_add(DatagramWriter& writer, int32_t uid, const EntityStreamEncoder::Record& record)
+{
+    std::string& out = writer.record(uid, 0);
+    write_varint(out, record.type);
+    write_zigzag(out, record.x);
+    write_zigzag(out, record.y);
+    out.push_back(static_cast<char>(record.layer));
+    out.push_back(static_cast<char>(record.state));
+}
+} // namespace
+
+std::vector<std::string> EntityStreamEncoder::encode(const EntitySnapshot& snapshot, bool keyframe)
+{
+    const std::vector<double> uids = snapshot.column("uid");
+    const std::vector<double> types = snapshot.column("type_id");
+    const std::vector<double> xs = snapshot.column("abs_x");
+    const std::vector<double> ys = snapshot.column("abs_y");
+    const std::vector<double> layers = snapshot.column("layer");
+    const std::vector<double> states = snapshot.column("state");
+
+    std::vector<std::pair<int32_t, Record>> current(snapshot.size());
+    for (uint32_t i = 0; i < snapshot.size(); ++i)
+    {
+        current[i] = {
+            static_cast<int32_t>(uids[i]),
+            Record{
+                static_cast<ENT_TYPE>(types[i]),
+                quantize(xs[i]),
+                quantize(ys[i]),
+                static_cast<uint8_t>(layers[i]),
+                static_cast<uint8_t>(states[i]),
+            },
+        };
+    }
+    std::sort(current.begin(), current.end(), [](const auto& lhs, const auto& rhs)
+              { return lhs.first < rhs.first; });
+
+    DatagramWriter writer{keyframe ? uint8_t{0} : uint8_t{1}, frame++};
+    if (keyframe)
+    {
+        for (const auto& [uid, record] : current)
+            write_add(writer, uid, record);
+    }
+    else
+    {
+        auto prev = previous.begin();
+        for (const auto& [uid, record] : current)
+        {
+            for (; prev != previous.end() && prev->first < uid; ++prev)
+                writer.record(prev->first, 2);
+            if (prev == previous.end() || prev->first != uid)
+            {
+                write_add(writer, uid, record);
+                continue;
+            }
+
+            const Record& before = prev->second;
+            ++prev;
+            const uint8_t changed = (record.x != before.x ? 1 : 0) | (record.y != before.y ? 2 : 0) | (record.layer != before.layer ? 4 : 0) |
+                                    (record.state != before.state ? 8 : 0) | (record.type != before.type ? 16 : 0);
+            if (changed == 0)
+                continue;
+            std::string& out = writer.record(uid, 1);
+            out.push_back(static_cast<char>(changed));
+            if (changed & 1)
+                write_zigzag(out, static_cast<int64_t>(record.x) - before.x);
+            if (changed & 2)
+                write_zigzag(out, static_cast<int64_t>(record.y) - before.y);
+            if (changed & 4)
+                out.push_back(static_cast<char>(record.layer));
+            if (changed & 8)
+                out.push_back(static_cast<char>(record.state));
+            if (changed & 16)
+                write_varint(out, record.type);
+        }
+        for (; prev != previous.end(); ++prev)
+            writer.record(prev->first, 2);
+    }
+
+    previous = std::move(current);
+    return writer.finish();
+}
+
+EntityStream::EntityStream(std::string host, in_port_t port, ENTITY_MASK mask_, uint32_t keyframe_interval_)
+    : server{std::move(host), port}, mask{mask_}, keyframe_interval{std::max(keyframe_interval_, 1u)}
+{
+    std::lock_guard lock{g_streams_lock};
+    g_streams.push_back(this);
+}
+EntityStream::~EntityStream()
+{
+    close();
+    std::lock_guard lock{g_streams_lock};
+    std::erase(g_streams, this);
+}
+
+void EntityStream::close()
+{
+    server.clear();
+    viewers.clear();
+}
+
+void EntityStream::update_all()
+{
+    std::lock_guard lock{g_streams_lock};
+    for (EntityStream* stream : g_streams)
+        stream->update();
+}
+
+void EntityStream::update()
+{
+    frames++;
+    // Any datagram subscribes its sender, viewers have to keep sending something to stay subscribed, "bye" unsubscribes right away
+    for (UdpPacket& packet : server.take_packets())
+    {
+        auto it = std::find_if(viewers.begin(), viewers.end(), [&](const Viewer& viewer)
+                               { return viewer.host == packet.host && viewer.port == packet.port; });
+        if (packet.data == "bye")
+        {
+            if (it != viewers.end())
+                viewers.erase(it);
+            continue;
+        }
+        if (it != viewers.end())
+        {
+            it->last_seen = frames;
+            continue;
+        }
+        viewers.push_back({std::move(packet.host), packet.port, frames});
+        // The new viewer doesn't know anything yet
+        needs_keyframe = true;
+    }
+    std::erase_if(viewers, [this](const Viewer& viewer)
+                  { return frames - viewer.last_seen > VIEWER_TIMEOUT_FRAMES; });
+    if (viewers.empty())
+    {
+        // Nobody saw the previous frames, the deltas are against what the viewers have
+        needs_keyframe = true;
+        return;
+    }
+
+    const bool keyframe = needs_keyframe || ++since_keyframe >= keyframe_interval;
+    if (keyframe)
+    {
+        needs_keyframe = false;
+        since_keyframe = 0;
+    }
+    const EntitySnapshot snapshot{mask, LAYER::BOTH, {"uid", "type_id", "abs_x", "abs_y", "layer", "state"}};
+    for (const std::string& datagram : encoder.encode(snapshot, keyframe))
+    {
+        for (const Viewer& viewer : viewers)
+        {
+            if (server.send(datagram, viewer.host, viewer.port))
+                bytes_sent += datagram.size();
+        }
+    }
+}
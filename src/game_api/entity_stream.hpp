@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>       // for size_t
+#include <cstdint>       // for uint32_t, int32_t, uint8_t, uint64_t
+#include <memory>        // for shared_ptr, weak_ptr
+#include <string>        // for string
+#include <utility>       // for pair
+#include <vector>        // for vector
+
+#include "aliases.hpp" // for ENTITY_MASK, ENT_TYPE
+#include "socket.hpp"  // for UdpServer, in_port_t
+
+class EntitySnapshot;
+
+// Encodes the entities of every frame against the ones of the frame before, keyframes have every entity in full
+// Each datagram starts with "OLDS", a u8 version, a u8 kind (0 keyframe, 1 delta, +0x80 on the last datagram of the frame) and a varint frame number,
+// followed by records sorted by uid, each a u8 op and the varint difference of its uid to the previous record's (the first one to 0):
+//   0 add:    varint type id, zigzag varint x and y in 1/256 tiles, u8 layer, u8 state
+//   1 change: u8 bits of what changed (1 x, 2 y, 4 layer, 8 state, 16 type id), then only those: zigzag varint delta for x and y, u8 layer, u8 state, varint type id
+//   2 remove: nothing
+// A keyframe only has adds and replaces everything the viewer had, so a lost delta is repaired by the next one
+class EntityStreamEncoder
+{
+  public:
+    static constexpr uint8_t VERSION = 1;
+    // Stays below the usual MTU so the datagrams aren't fragmented
+    static constexpr size_t MAX_DATAGRAM = 1200;
+    static constexpr float POSITION_SCALE = 256.0f;
+
+    struct Record
+    {
+        ENT_TYPE type;
+        int32_t x;
+        int32_t y;
+        uint8_t layer;
+        uint8_t state;
+    };
+
+    // Datagrams for the entities of `snapshot`, which needs the uid, type_id, abs_x, abs_y, layer and state fields
+    std::vector<std::string> encode(const EntitySnapshot& snapshot, bool keyframe);
+
+  private:
+    // Sorted by uid, so both frames are walked side by side
+    std::vector<std::pair<int32_t, Record>> previous;
+    uint32_t frame{0};
+};
+
+/// Streams the entities to remote viewers, see [start_entity_stream](#start_entity_stream)
+class EntityStream
+{
+  public:
+    // Viewers that haven't sent anything for this long are dropped
+    static constexpr uint32_t VIEWER_TIMEOUT_FRAMES = 60 * 10;
+
+    EntityStream(std::string host, in_port_t port, ENTITY_MASK mask, uint32_t keyframe_interval);
+    ~EntityStream();
+
+    /// Stop streaming and close the port
+    void close();
+    /// Number of viewers the frames are sent to
+    uint32_t get_viewers() const
+    {
+        return static_cast<uint32_t>(viewers.size());
+    }
+    /// Bytes sent so far, counted once for every viewer they were sent to
+    uint64_t get_bytes_sent() const
+    {
+        return bytes_sent;
+    }
+
+    // Called after every StateUpdate, sends the frame to all open streams that have viewers
+    static void update_all();
+
+  private:
+    struct Viewer
+    {
+        std::string host;
+        in_port_t port;
+        uint64_t last_seen;
+    };
+
+    void update();
+
+    UdpServer server;
+    ENTITY_MASK mask;
+    uint32_t keyframe_interval;
+    uint32_t since_keyframe{0};
+    bool needs_keyframe{true};
+    uint64_t frames{0};
+    uint64_t bytes_sent{0};
+    std::vector<Viewer> viewers;
+    EntityStreamEncoder encoder;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <utility> // for move
+#include <vector>  // for vector
+
+class Entity;
+
+// Appends what is attached to `ent`: its items and, for the mega jellyfish, the tail pieces, which aren't items
+void push_attached_entities(Entity* ent, std::vector<Entity*>& out);
+
+namespace detail
+{
+struct TraversalFrame
+{
+    Entity* ent;
+    bool expanded;
+};
+// Kept between walks so they don't allocate, a walk started from inside another one gets a fresh buffer
+inline thread_local std::vector<TraversalFrame> g_traversal_scratch;
+inline thread_local std::vector<Entity*> g_traversal_children;
+} // namespace detail
+
+// Walks everything attached to `root` with an explicit stack, children before their parent and in item order, the root itself is not visited
+// `enter(ent)` returns whether the entity and everything attached to it is walked, `visit(ent)` returns true to stop the walk
+// What is attached is read when an entity is entered, so `visit` may kill or destroy the entity it gets
+template <class EnterT, class VisitT>
+void for_each_attached(Entity* root, EnterT&& enter, VisitT&& visit)
+{
+    std::vector<detail::TraversalFrame> stack = std::move(detail::g_traversal_scratch);
+    std::vector<Entity*> children = std::move(detail::g_traversal_children);
+    stack.clear();
+
+    auto push_children = [&](Entity* ent)
+    {
+        children.clear();
+        push_attached_entities(ent, children);
+        // Reversed so the first item is on top
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+        {
+            stack.push_back({*it, false});
+        }
+    };
+
+    push_children(root);
+    while (!stack.empty())
+    {
+        detail::TraversalFrame& frame = stack.back();
+        if (frame.expanded)
+        {
+            Entity* ent = frame.ent;
+            stack.pop_back();
+            if (visit(ent))
+                break;
+            continue;
+        }
+
+        if (!enter(frame.ent))
+        {
+            stack.pop_back();
+            continue;
+        }
+        frame.expanded = true;
+        // `frame` is invalid after this
+        push_children(frame.ent);
+    }
+
+    detail::g_traversal_scratch = std::move(stack);
+    detail::g_traversal_children = std::move(children);
+}
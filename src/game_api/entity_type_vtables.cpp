@@ -0,0 +1,43 @@
+#include "entity_type_vtables.hpp"
+
+#include <unordered_map> // for unordered_map
+#include <utility>       // for move
+#include <vector>        // for vector
+
+#include "aliases.hpp"       // for ENTITY_MASK, LAYER
+#include "entity.hpp"        // for Entity, get_entity_ptr
+#include "entity_db.hpp"     // for EntityDB
+#include "entity_lookup.hpp" // for get_entities_by
+
+namespace
+{
+std::unordered_map<std::uint32_t, std::vector<std::function<void(Entity*)>>> g_pending_patches;
+} // namespace
+
+void patch_entity_type_vtable(std::uint32_t entity_type, std::function<void(Entity*)> patch)
+{
+    for (uint32_t uid : get_entities_by({entity_type}, ENTITY_MASK::ANY, LAYER::BOTH))
+    {
+        if (Entity* entity = get_entity_ptr(uid))
+        {
+            patch(entity);
+            return;
+        }
+    }
+    g_pending_patches[entity_type].push_back(std::move(patch));
+}
+
+void on_entity_type_spawned(Entity* entity)
+{
+    if (g_pending_patches.empty() || entity == nullptr)
+        return;
+
+    auto it = g_pending_patches.find(entity->type->id);
+    if (it == g_pending_patches.end())
+        return;
+    // Every entity of a type is the same class, so this one's vtable is the one all of them use
+    std::vector<std::function<void(Entity*)>> patches = std::move(it->second);
+    g_pending_patches.erase(it);
+    for (auto& patch : patches)
+        patch(entity);
+}
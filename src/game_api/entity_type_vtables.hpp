@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>    // for uint32_t
+#include <functional> // for function
+
+class Entity;
+
+// Calls `patch` with an entity of `entity_type` to patch the vtable every entity of that type shares, right away if one exists,
+// otherwise when the first one spawns. Vtables stay patched, so `patch` is only ever called once
+void patch_entity_type_vtable(std::uint32_t entity_type, std::function<void(Entity*)> patch);
+// Called for every spawned entity, only looks further if a patch is still waiting for its type
+void on_entity_type_spawned(Entity* entity);
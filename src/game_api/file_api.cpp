@@ -1,16 +1,33 @@
 #include "file_api.hpp"
 
+#include <algorithm>          // for find_if, max
 #include <atomic>
 #include <chrono>
+#include <cstdlib>            // for abs
+#include <condition_variable> // for condition_variable
+#include <deque>              // for deque
+#include <emmintrin.h>        // for _mm_mullo_epi16, _mm_packus_epi16, ...
+#include <filesystem>         // for exists, rename, create_directories
+#include <mutex>              // for mutex, lock_guard, unique_lock
+#include <optional>           // for optional, nullopt
 #include <string>
 #include <string_view>
+#include <system_error>       // for error_code
+#include <thread>             // for thread
+#include <unordered_map>      // for unordered_map
+#include <unordered_set>      // for unordered_set
+#include <vector>             // for vector
 
 #include <detours.h>
+#include <fmt/format.h> // for format
 
+#include "async_file_writer.hpp"         // for AsyncFileWriter
 #include "color.hpp"                     // for Color
 #include "containers/game_allocator.hpp" // game_malloc
+#include "game_heap_stats.hpp"           // for GameHeapTag
 #include "render_api.hpp"                // for RenderAPI
 #include "search.hpp"                    // for get_address
+#include "thread_policy.hpp"             // for ServiceThreads, THREAD_POOL
 #include "util.hpp"                      // for OnScopeExit
 #include "window_api.hpp"                // for get_device
 
@@ -55,7 +72,7 @@ WriteToFileCallback* g_WriteToFile{nullptr};
 GetImageFilePathCallback* g_GetImageFilePath{nullptr};
 MakeSavePathCallback g_MakeSavePathCallback{nullptr};
 
-std::string hash_path(std::string_view path)
+uint64_t hash_path_value(std::string_view path)
 {
     auto abs_path_str = std::filesystem::absolute(path).make_preferred().string();
     uint64_t res = 10000019;
@@ -66,15 +83,312 @@ std::string hash_path(std::string_view path)
         res = res * 8191 + merge;
         i++;
     } while (i < abs_path_str.length());
+    return res;
+}
+
+std::string hash_path(std::string_view path)
+{
+    const uint64_t res = hash_path_value(path);
     std::ostringstream ss;
     ss << std::hex << res << res;
     return ss.str();
 }
 
+// Memory mapped open addressing table in CACHE_DIR that remembers which source file each cache entry was made from,
+// so a cache hit is a single probe and a changed source image is detected without checking for the cache file
+class CacheIndex
+{
+  public:
+    struct SourceInfo
+    {
+        uint64_t mtime{0};
+        uint64_t size{0};
+    };
+
+    static CacheIndex& get()
+    {
+        static CacheIndex index;
+        return index;
+    }
+
+    // One GetFileAttributesEx call, returns nullopt if the source doesn't exist
+    static std::optional<SourceInfo> stat_source(const char* path)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+            return std::nullopt;
+        return SourceInfo{
+            (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime,
+            (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow,
+        };
+    }
+
+    bool is_valid(uint64_t path_hash, SourceInfo source)
+    {
+        std::lock_guard lock{index_lock};
+        if (!map())
+            return false;
+        const Entry* entry = find(path_hash);
+        return entry != nullptr && entry->source_mtime == source.mtime && entry->source_size == source.size && entry->cache_size != 0;
+    }
+
+    void update(uint64_t path_hash, SourceInfo source, uint64_t cache_size)
+    {
+        std::lock_guard lock{index_lock};
+        if (!map())
+            return;
+        if ((header->count + 1) * 4 > header->capacity * 3 && !remap(header->capacity * 2))
+            return;
+
+        Entry* entry = find_slot(path_hash);
+        if (entry->path_hash != path_hash)
+            header->count++;
+        *entry = {path_hash, source.mtime, source.size, cache_size};
+    }
+
+    // Entries are never removed from the table, they are only marked stale
+    void invalidate(uint64_t path_hash)
+    {
+        std::lock_guard lock{index_lock};
+        if (!map())
+            return;
+        if (Entry* entry = find(path_hash))
+            entry->cache_size = 0;
+    }
+
+    // Closes the mapping so the index file can be deleted with the rest of the cache, it is recreated on the next lookup
+    void close()
+    {
+        std::lock_guard lock{index_lock};
+        unmap();
+    }
+
+  private:
+    static constexpr uint32_t c_Magic{0x58444E49}; // "INDX"
+    static constexpr uint32_t c_Version{1};
+    static constexpr uint32_t c_InitialCapacity{1024};
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        uint32_t count;
+    };
+    struct Entry
+    {
+        uint64_t path_hash; // 0 means empty slot
+        uint64_t source_mtime;
+        uint64_t source_size;
+        uint64_t cache_size;
+    };
+
+    ~CacheIndex()
+    {
+        unmap();
+    }
+
+    static uint64_t file_size_for(uint32_t capacity)
+    {
+        return sizeof(Header) + static_cast<uint64_t>(capacity) * sizeof(Entry);
+    }
+
+    Entry* find_slot(uint64_t path_hash)
+    {
+        const uint32_t mask = header->capacity - 1;
+        for (uint32_t i = static_cast<uint32_t>(path_hash) & mask;; i = (i + 1) & mask)
+        {
+            if (entries[i].path_hash == path_hash || entries[i].path_hash == 0)
+                return &entries[i];
+        }
+    }
+    Entry* find(uint64_t path_hash)
+    {
+        Entry* entry = find_slot(path_hash);
+        return entry->path_hash == path_hash ? entry : nullptr;
+    }
+
+    bool map()
+    {
+        if (header != nullptr)
+            return true;
+
+        std::error_code ec;
+        std::filesystem::create_directories(CACHE_DIR, ec);
+        file = CreateFileA(CACHE_DIR "\\index.bin", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file, &size);
+        if (static_cast<uint64_t>(size.QuadPart) >= sizeof(Header) && map_view(static_cast<uint64_t>(size.QuadPart)))
+        {
+            const bool is_power_of_two = header->capacity != 0 && (header->capacity & (header->capacity - 1)) == 0;
+            if (header->magic == c_Magic && header->version == c_Version && is_power_of_two && file_size_for(header->capacity) == static_cast<uint64_t>(size.QuadPart))
+                return true;
+            unmap_view();
+        }
+
+        // Missing or incompatible index, start over with an empty one
+        if (!resize_file(file_size_for(c_InitialCapacity)) || !map_view(file_size_for(c_InitialCapacity)))
+        {
+            unmap();
+            return false;
+        }
+        memset(header, 0, file_size_for(c_InitialCapacity));
+        *header = {c_Magic, c_Version, c_InitialCapacity, 0};
+        return true;
+    }
+
+    bool remap(uint32_t new_capacity)
+    {
+        std::vector<Entry> old_entries{entries, entries + header->capacity};
+        unmap_view();
+        if (!resize_file(file_size_for(new_capacity)) || !map_view(file_size_for(new_capacity)))
+        {
+            unmap();
+            return false;
+        }
+        memset(header, 0, file_size_for(new_capacity));
+        *header = {c_Magic, c_Version, new_capacity, 0};
+        for (const Entry& entry : old_entries)
+        {
+            if (entry.path_hash != 0)
+            {
+                *find_slot(entry.path_hash) = entry;
+                header->count++;
+            }
+        }
+        return true;
+    }
+
+    bool resize_file(uint64_t size)
+    {
+        LARGE_INTEGER distance{};
+        distance.QuadPart = static_cast<LONGLONG>(size);
+        return SetFilePointerEx(file, distance, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    }
+
+    bool map_view(uint64_t size)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+        if (mapping == nullptr)
+            return false;
+        void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (view == nullptr)
+        {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            return false;
+        }
+        header = static_cast<Header*>(view);
+        entries = reinterpret_cast<Entry*>(header + 1);
+        return true;
+    }
+    void unmap_view()
+    {
+        if (header != nullptr)
+            UnmapViewOfFile(header);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        header = nullptr;
+        entries = nullptr;
+        mapping = nullptr;
+    }
+    void unmap()
+    {
+        unmap_view();
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+
+    std::mutex index_lock;
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+    Header* header{nullptr};
+    Entry* entries{nullptr};
+};
+
 std::filesystem::path get_cache_path(std::string_view path)
 {
     return std::filesystem::path(CACHE_DIR) / std::filesystem::path(hash_path(path) + ".DDS");
 }
+std::filesystem::path get_bytecode_cache_path(std::string_view path, std::string_view extension)
+{
+    return std::filesystem::path(CACHE_DIR) / std::filesystem::path(hash_path(path) + std::string{extension});
+}
+std::filesystem::path get_shader_cache_path(uint64_t key)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR "\\Shaders", ec);
+    return std::filesystem::path(CACHE_DIR "\\Shaders") / fmt::format("{:016x}.cso", key);
+}
+
+// Header of a .pcm cache file, the samples follow it in the format FMOD gets them in
+struct PcmCacheHeader
+{
+    // "OPCM" in the file
+    static constexpr uint32_t MAGIC = 0x4D43504F;
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    // Same as in the CacheIndex, from stat_source
+    uint64_t source_mtime;
+    uint64_t source_size;
+    int32_t num_channels;
+    int32_t frequency;
+    uint32_t format;
+    uint32_t data_size;
+};
+static_assert(sizeof(PcmCacheHeader) == 40);
+
+std::optional<CachedPcm> load_cached_pcm(const std::string& path)
+{
+    const auto source = CacheIndex::stat_source(path.c_str());
+    if (!source)
+        return std::nullopt;
+    auto file = MappedFile::open(get_bytecode_cache_path(path, ".pcm").string());
+    if (!file || file->size() < sizeof(PcmCacheHeader))
+        return std::nullopt;
+
+    PcmCacheHeader header;
+    memcpy(&header, file->view().data(), sizeof(header));
+    if (header.magic != PcmCacheHeader::MAGIC || header.version != PcmCacheHeader::VERSION || header.source_mtime != source->mtime ||
+        header.source_size != source->size || file->size() - sizeof(header) != header.data_size)
+        return std::nullopt;
+
+    const std::string_view samples = file->view().substr(sizeof(header));
+    return CachedPcm{std::move(file), header.num_channels, header.frequency, static_cast<SoundFormat>(header.format), samples};
+}
+
+void write_cached_pcm(const std::string& path, const DecodedAudioBuffer& buffer)
+{
+    const auto source = CacheIndex::stat_source(path.c_str());
+    // 16 bytes of padding on both sides of the samples
+    if (!source || buffer.data_size <= 32)
+        return;
+
+    const size_t data_size = buffer.data_size - 32;
+    const PcmCacheHeader header{
+        PcmCacheHeader::MAGIC,
+        PcmCacheHeader::VERSION,
+        source->mtime,
+        source->size,
+        buffer.num_channels,
+        buffer.frequency,
+        static_cast<uint32_t>(buffer.format),
+        static_cast<uint32_t>(data_size),
+    };
+    std::string data(sizeof(header) + data_size, '\0');
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), reinterpret_cast<const char*>(buffer.data.get()) + 16, data_size);
+
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR, ec);
+    AsyncFileWriter::get().write(get_bytecode_cache_path(path, ".pcm").string(), std::move(data));
+}
 
 void clear_cache(std::string_view file_path)
 {
@@ -91,12 +405,14 @@ void clear_cache(std::string_view file_path)
     if (path == "")
     {
         // DEBUG("Removing {}", cache_dir.string());
+        CacheIndex::get().close();
         std::filesystem::remove_all(cache_dir);
     }
     else
     {
         auto cache_file = get_cache_path(path);
         // DEBUG("Removing {}", cache_file.string());
+        CacheIndex::get().invalidate(hash_path_value(path));
         if (std::filesystem::exists(cache_file))
         {
             std::filesystem::remove(cache_file);
@@ -166,6 +482,306 @@ void get_heart_color_from_dds(const char* file_path, FileInfo* file)
     }
 }
 
+// Premultiplies rgb with alpha, 4 pixels at a time, alpha channel is left untouched
+void premultiply_alpha(uint8_t* image_data, size_t image_data_size)
+{
+    size_t i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i alpha_mask = _mm_set1_epi32(0xFF000000);
+    for (; i + 16 <= image_data_size; i += 16)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(image_data + i));
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+        const __m128i alpha_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128i alpha_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        lo = _mm_mullo_epi16(lo, alpha_lo);
+        hi = _mm_mullo_epi16(hi, alpha_hi);
+        // x / 255 == (x + 1 + (x >> 8)) >> 8 for all x <= 255 * 255
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+        const __m128i result = _mm_or_si128(_mm_andnot_si128(alpha_mask, _mm_packus_epi16(lo, hi)), _mm_and_si128(alpha_mask, pixels));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(image_data + i), result);
+    }
+    for (; i + 4 <= image_data_size; i += 4)
+    {
+        uint8_t* p = image_data + i;
+        const uint32_t alpha = p[3];
+        p[0] = (uint8_t)((p[0] * alpha + 1 + ((p[0] * alpha) >> 8)) >> 8);
+        p[1] = (uint8_t)((p[1] * alpha + 1 + ((p[1] * alpha) >> 8)) >> 8);
+        p[2] = (uint8_t)((p[2] * alpha + 1 + ((p[2] * alpha) >> 8)) >> 8);
+    }
+}
+
+// Halves a premultiplied rgba image with a box filter, odd edges are clamped
+void downsample_rgba(const uint8_t* src, uint32_t src_width, uint32_t src_height, uint8_t* dst, uint32_t dst_width, uint32_t dst_height)
+{
+    for (uint32_t y = 0; y < dst_height; ++y)
+    {
+        const uint32_t y0 = std::min(y * 2, src_height - 1);
+        const uint32_t y1 = std::min(y * 2 + 1, src_height - 1);
+        for (uint32_t x = 0; x < dst_width; ++x)
+        {
+            const uint32_t x0 = std::min(x * 2, src_width - 1);
+            const uint32_t x1 = std::min(x * 2 + 1, src_width - 1);
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const uint32_t sum = src[(y0 * src_width + x0) * 4 + c] + src[(y0 * src_width + x1) * 4 + c] + src[(y1 * src_width + x0) * 4 + c] + src[(y1 * src_width + x1) * 4 + c];
+                dst[(y * dst_width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+std::vector<char> encode_rgba_as_dds(uint8_t* image_data, uint32_t image_width, uint32_t image_height, bool generate_mipmaps)
+{
+    uint32_t mip_count = 1;
+    if (generate_mipmaps)
+    {
+        for (uint32_t size = std::max(image_width, image_height); size > 1; size /= 2)
+            mip_count++;
+    }
+
+    DDS_HEADER header{
+        124,        // hardcoded
+        0x0002100F, // required flags + pitch + mipmapped
+        static_cast<DWORD>(image_height),
+        static_cast<DWORD>(image_width),
+        static_cast<DWORD>(image_width * 4), // aka bytes per line
+        1,
+        mip_count,
+        {},
+        // pixel format sub structure
+        DDS_PIXELFORMAT{
+            32,   // size of pixel format structure, constant
+            0x41, // uncompressed RGB with alpha channel
+            0,    // compression mode (not used for uncompressed data)
+            32,
+            // bit masks for each channel, here for RGBA
+            0x000000FF,
+            0x0000FF00,
+            0x00FF0000,
+            0xFF000000,
+        },
+        mip_count > 1 ? 0x401008u : 0x1000u, // simple texture with only one surface, complex + mipmap when there is a mip chain
+        0,                                   // additional surface data, unused
+        0,                                   // unused
+        0,                                   // unused
+        0,
+    };
+
+    const size_t image_data_size = static_cast<size_t>(image_width) * image_height * 4;
+    premultiply_alpha(image_data, image_data_size);
+
+    size_t total_data_size = 0;
+    for (uint32_t level = 0, w = image_width, h = image_height; level < mip_count; ++level, w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+        total_data_size += static_cast<size_t>(w) * h * 4;
+
+    std::vector<char> dds(4 + sizeof(DDS_HEADER) + total_data_size);
+    memcpy(dds.data(), "DDS ", 4);
+    memcpy(dds.data() + 4, &header, sizeof(DDS_HEADER));
+    memcpy(dds.data() + 4 + sizeof(DDS_HEADER), image_data, image_data_size);
+
+    // Each level is filtered from the previous one, which is already premultiplied
+    auto* level_data = reinterpret_cast<uint8_t*>(dds.data() + 4 + sizeof(DDS_HEADER));
+    for (uint32_t level = 1, w = image_width, h = image_height; level < mip_count; ++level)
+    {
+        const uint32_t next_w = std::max(w / 2, 1u);
+        const uint32_t next_h = std::max(h / 2, 1u);
+        uint8_t* next_data = level_data + static_cast<size_t>(w) * h * 4;
+        downsample_rgba(level_data, w, h, next_data, next_w, next_h);
+        level_data = next_data;
+        w = next_w;
+        h = next_h;
+    }
+    return dds;
+}
+
+// Decodes an image and returns it as a complete dds file, empty if the image couldn't be decoded
+std::vector<char> encode_image_as_dds(const char* path)
+{
+    int image_width = 0;
+    int image_height = 0;
+    unsigned char* image_data = stbi_load(path, &image_width, &image_height, NULL, 4);
+    if (image_data == nullptr)
+        return {};
+    ON_SCOPE_EXIT(stbi_image_free(image_data));
+
+    return encode_rgba_as_dds(image_data, static_cast<uint32_t>(image_width), static_cast<uint32_t>(image_height), false);
+}
+
+// Writes to a temporary file first so a half written cache file is never picked up by the loader
+bool write_cache_file(const std::filesystem::path& cache_path, const std::vector<char>& dds)
+{
+    auto temp_path = cache_path;
+    temp_path += fmt::format(".{}.tmp", GetCurrentThreadId());
+
+    FILE* cache_file;
+    if (fopen_s(&cache_file, temp_path.string().c_str(), "wb") != 0)
+        return false;
+    const auto written = fwrite(dds.data(), sizeof(char), dds.size(), cache_file);
+    fclose(cache_file);
+
+    std::error_code ec;
+    if (written == dds.size())
+        std::filesystem::rename(temp_path, cache_path, ec);
+    if (written != dds.size() || ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+bool is_convertible_image(std::string_view path)
+{
+    using namespace std::string_view_literals;
+    const auto dot = path.find_last_of('.');
+    if (dot == std::string_view::npos)
+        return false;
+    const auto ext = path.substr(dot);
+    return ext == ".png"sv || ext == ".jpeg"sv || ext == ".bmp"sv || ext == ".tga"sv;
+}
+
+bool cache_image(const std::string& path)
+{
+    if (!is_convertible_image(path))
+        return false;
+
+    const uint64_t path_hash = hash_path_value(path);
+    const auto source = CacheIndex::stat_source(path.c_str());
+    if (!source)
+        return false;
+    if (CacheIndex::get().is_valid(path_hash, source.value()))
+        return true;
+
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR, ec);
+
+    const auto cache_path = get_cache_path(path);
+    std::vector<char> dds = encode_image_as_dds(path.c_str());
+    if (dds.empty() || !write_cache_file(cache_path, dds))
+        return false;
+
+    CacheIndex::get().update(path_hash, source.value(), dds.size());
+    DEBUG("Cached '{}' to '{}' in background", path, cache_path.string());
+    return true;
+}
+
+// Converts images to the dds cache on background threads, so the hooked loader only has to read the cached file
+class ImageCacheWarmer
+{
+  public:
+    static ImageCacheWarmer& get()
+    {
+        static ImageCacheWarmer warmer;
+        return warmer;
+    }
+
+    void enqueue(std::string path)
+    {
+        std::string cache_path = get_cache_path(path).string();
+        {
+            std::lock_guard lock{queue_lock};
+            if (pending.contains(cache_path))
+                return;
+            pending.insert(cache_path);
+            queue.push_back({std::move(path), std::move(cache_path)});
+            start_workers();
+        }
+        work_available.notify_one();
+    }
+
+    // Called by the loader before it looks at the cache, if the image is still waiting in the queue it is taken out and the loader converts it itself
+    void wait_for(const std::string& cache_path)
+    {
+        std::unique_lock lock{queue_lock};
+        if (!pending.contains(cache_path))
+            return;
+
+        auto it = std::find_if(queue.begin(), queue.end(), [&](const QueuedImage& image)
+                               { return image.cache_path == cache_path; });
+        if (it != queue.end())
+        {
+            queue.erase(it);
+            pending.erase(cache_path);
+            return;
+        }
+        work_done.wait(lock, [&]()
+                       { return !pending.contains(cache_path); });
+    }
+
+  private:
+    struct QueuedImage
+    {
+        std::string path;
+        std::string cache_path;
+    };
+
+    void start_workers()
+    {
+        if (workers_started)
+            return;
+        workers_started = true;
+
+        const uint32_t num_workers = std::max(std::thread::hardware_concurrency() / 2, 1u);
+        for (uint32_t i = 0; i < num_workers; ++i)
+        {
+            std::thread(&ImageCacheWarmer::worker, this).detach();
+        }
+    }
+
+    void worker()
+    {
+        ServiceThreads::get().register_current("ImageCacheWarmer", THREAD_POOL::IO);
+        while (true)
+        {
+            QueuedImage image;
+            {
+                std::unique_lock lock{queue_lock};
+                work_available.wait(lock, [this]()
+                                    { return !queue.empty(); });
+                image = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            cache_image(image.path);
+
+            {
+                std::lock_guard lock{queue_lock};
+                pending.erase(image.cache_path);
+            }
+            work_done.notify_all();
+        }
+    }
+
+    std::mutex queue_lock;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    std::deque<QueuedImage> queue;
+    std::unordered_set<std::string> pending;
+    bool workers_started{false};
+};
+
+void prewarm_image_cache(std::vector<std::string> image_paths)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR, ec);
+
+    auto& warmer = ImageCacheWarmer::get();
+    for (std::string& path : image_paths)
+    {
+        if (!is_convertible_image(path))
+            continue;
+        const auto source = CacheIndex::stat_source(path.c_str());
+        if (source && !CacheIndex::get().is_valid(hash_path_value(path), source.value()))
+        {
+            warmer.enqueue(std::move(path));
+        }
+    }
+}
+
 FileInfo* load_file_as_dds_if_image(const char* file_path, AllocFun alloc_fun)
 {
     using namespace std::string_view_literals;
@@ -175,111 +791,66 @@ FileInfo* load_file_as_dds_if_image(const char* file_path, AllocFun alloc_fun)
     {
         path = path.substr(prefix.size());
     }
-    auto ext = path.substr(path.find_last_of('.'));
 
-    std::filesystem::create_directories(CACHE_DIR);
+    if (!is_convertible_image(path))
+    {
+        return read_file_from_disk(file_path, alloc_fun);
+    }
+
     std::filesystem::path cache_path = get_cache_path(path);
+    ImageCacheWarmer::get().wait_for(cache_path.string());
 
-    if (std::filesystem::exists(cache_path))
+    const auto source = CacheIndex::stat_source(path.data());
+    if (!source)
+        return nullptr;
+
+    const uint64_t path_hash = hash_path_value(path);
+    if (CacheIndex::get().is_valid(path_hash, source.value()))
     {
         DEBUG("Loading '{}' from cache '{}'", path, cache_path.string());
-        auto file = read_file_from_disk(cache_path.string().c_str(), alloc_fun);
-        get_heart_color_from_dds(file_path, file);
-        return file;
-    }
-    else if (ext == ".png"sv || ext == ".jpeg"sv || ext == ".bmp"sv || ext == ".tga"sv)
-    {
-        int image_width = 0;
-        int image_height = 0;
-        unsigned char* image_data = stbi_load(path.data(), &image_width, &image_height, NULL, 4);
-        if (image_data != nullptr)
+        if (auto file = read_file_from_disk(cache_path.string().c_str(), alloc_fun))
         {
-            DDS_HEADER header{
-                124,        // hardcoded
-                0x0002100F, // required flags + pitch + mipmapped
-                static_cast<DWORD>(image_height),
-                static_cast<DWORD>(image_width),
-                static_cast<DWORD>(image_width * 4), // aka bytes per line
-                1,
-                1,
-                {},
-                // pixel format sub structure
-                DDS_PIXELFORMAT{
-                    32,   // size of pixel format structure, constant
-                    0x41, // uncompressed RGB with alpha channel
-                    0,    // compression mode (not used for uncompressed data)
-                    32,
-                    // bit masks for each channel, here for RGBA
-                    0x000000FF,
-                    0x0000FF00,
-                    0x00FF0000,
-                    0xFF000000,
-                },
-                0x1000, // simple texture with only one surface and no mipmaps
-                0,      // additional surface data, unused
-                0,      // unused
-                0,      // unused
-                0,
-            };
-
-            auto image_data_size = image_width * image_height * 4;
-
-            // multiply alpha and extract player indicator color for heart
-            const int magic_pixel = (int)(5888.875f * (float)image_width);
-            for (int i = 0; i < image_data_size; i += 4)
-            {
-                uint8_t* p = (uint8_t*)&image_data[i];
-                float alpha = (float)p[3] / 255.0f;
-                p[0] = (uint8_t)((float)p[0] * alpha);
-                p[1] = (uint8_t)((float)p[1] * alpha);
-                p[2] = (uint8_t)((float)p[2] * alpha);
-                // extract player indicator color
-                if (i == magic_pixel)
-                    set_heart_color_for_texture(std::string(file_path), Color((float)p[0] / 255.0f, (float)p[1] / 255.0f, (float)p[2] / 255.0f, (float)p[3] / 255.0f));
-            }
+            get_heart_color_from_dds(file_path, file);
+            return file;
+        }
+    }
 
-            int data_size = 4 + sizeof(DDS_HEADER) + image_data_size;
-            auto allocation_size = sizeof(FileInfo) + data_size;
-            auto file_buffer = (char*)alloc_fun(allocation_size);
+    std::vector<char> dds = encode_image_as_dds(path.data());
+    if (dds.empty())
+        return nullptr;
 
-            FileInfo* file_info = new (file_buffer) FileInfo{};
-            file_info->Data = file_buffer + sizeof(FileInfo);
-            file_info->DataSize = data_size;
-            file_info->AllocationSize = static_cast<int>(allocation_size);
+    const int data_size = static_cast<int>(dds.size());
+    auto allocation_size = sizeof(FileInfo) + data_size;
+    auto file_buffer = (char*)alloc_fun(allocation_size);
 
-            auto dds_image_data = file_buffer + sizeof(FileInfo);
-            memcpy(dds_image_data, "DDS ", 4);
-            memcpy(dds_image_data + 4, &header, sizeof(DDS_HEADER));
-            memcpy(dds_image_data + 4 + sizeof(DDS_HEADER), image_data, image_data_size);
+    FileInfo* file_info = new (file_buffer) FileInfo{};
+    file_info->Data = file_buffer + sizeof(FileInfo);
+    file_info->DataSize = data_size;
+    file_info->AllocationSize = static_cast<int>(allocation_size);
+    memcpy(file_info->Data, dds.data(), dds.size());
 
-            stbi_image_free(image_data);
+    // extract player indicator color for heart
+    get_heart_color_from_dds(file_path, file_info);
 
-            FILE* cache_file;
-            errno_t err;
-            if ((err = fopen_s(&cache_file, cache_path.string().c_str(), "wb")) == 0)
-            {
-                fwrite(file_info->Data, sizeof(char), file_info->DataSize, cache_file);
-                DEBUG("Cached '{}' to '{}'", path, cache_path.string());
-                fclose(cache_file);
-            }
-            else
-            {
-                DEBUG("Couldn't cache '{}' to '{}'", path, cache_path.string());
-            }
-            return file_info;
-        }
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR, ec);
+    if (write_cache_file(cache_path, dds))
+    {
+        CacheIndex::get().update(path_hash, source.value(), dds.size());
+        DEBUG("Cached '{}' to '{}'", path, cache_path.string());
     }
     else
     {
-        return read_file_from_disk(file_path, alloc_fun);
+        DEBUG("Couldn't cache '{}' to '{}'", path, cache_path.string());
     }
-    return nullptr;
+    return file_info;
 }
 
 using ReadEncryptedFileFun = FileInfo*(const char* file_path);
 ReadEncryptedFileFun* g_read_encrypted_file_trampoline{nullptr};
 FileInfo* read_encrypted_file(const char* file_path)
 {
+    GameHeapTag tag{"files"};
     if (auto file = g_OnLoadFile(file_path, &game_malloc))
     {
         return file;
@@ -290,13 +861,74 @@ FileInfo* read_encrypted_file(const char* file_path)
 ReadFromFileOrig* g_read_from_file_trampoline{nullptr};
 void read_from_file(const char* file, void** out_data, size_t* out_data_size)
 {
+    // A save of this file may still be queued
+    AsyncFileWriter::get().flush();
+    GameHeapTag tag{"files"};
     g_ReadFromFile(file, out_data, out_data_size, &game_malloc, g_read_from_file_trampoline);
 }
 
+FileInfo* read_game_file(const char* file_path)
+{
+    if (g_OnLoadFile != nullptr)
+    {
+        if (auto file = g_OnLoadFile(file_path, &game_malloc))
+        {
+            return file;
+        }
+    }
+    if (g_read_encrypted_file_trampoline != nullptr)
+    {
+        return g_read_encrypted_file_trampoline(file_path);
+    }
+    static ReadEncryptedFileFun* read_encrypted_file_fun = (ReadEncryptedFileFun*)get_address("read_encrypted_file"sv);
+    return read_encrypted_file_fun(file_path);
+}
+
 WriteToFileOrig* g_write_to_file_trampoline{nullptr};
+bool g_async_game_writes{false};
+int g_async_game_writers{0};
+void write_to_file_async(const char* backup_file, const char* file, void* data, size_t data_size)
+{
+    // The game frees its buffer as soon as this returns, so the writer gets a copy
+    // The game's own write function isn't called from the writer thread, the file is written the same way the script saves are
+    AsyncFileWriter::get().run(
+        [backup_file = std::string{backup_file != nullptr ? backup_file : ""},
+         file = std::string{file},
+         data = std::string{static_cast<const char*>(data), data_size}]()
+        {
+            // The backup keeps the previous save, in case the new one turns out broken
+            if (!backup_file.empty() && std::filesystem::exists(file))
+                CopyFileA(file.c_str(), backup_file.c_str(), FALSE);
+            return AsyncFileWriter::write_atomically(file, data);
+        });
+}
 void write_to_file(const char* backup_file, const char* file, void* data, size_t data_size)
 {
-    g_WriteToFile(backup_file, file, data, data_size, g_write_to_file_trampoline);
+    WriteToFileOrig* original = g_async_game_writes ? &write_to_file_async : g_write_to_file_trampoline;
+    if (g_WriteToFile != nullptr)
+    {
+        g_WriteToFile(backup_file, file, data, data_size, original);
+        return;
+    }
+    original(backup_file, file, data, data_size);
+}
+void hook_write_to_file()
+{
+    if (g_write_to_file_trampoline != nullptr)
+        return;
+
+    g_write_to_file_trampoline = (WriteToFileOrig*)get_address("write_to_file"sv);
+
+    DetourTransactionBegin();
+    DetourUpdateThread(GetCurrentThread());
+
+    DetourAttach((void**)&g_write_to_file_trampoline, write_to_file);
+
+    const LONG error = DetourTransactionCommit();
+    if (error != NO_ERROR)
+    {
+        DEBUG("Failed hooking WriteToFile: {}\n", error);
+    }
 }
 
 void register_on_load_file(LoadFileCallback on_load_file)
@@ -339,22 +971,22 @@ void register_on_read_from_file(ReadFromFileCallback on_read_from_file)
 }
 void register_on_write_to_file(WriteToFileCallback on_write_to_file)
 {
-    if (g_write_to_file_trampoline == nullptr && on_write_to_file != nullptr)
+    if (on_write_to_file != nullptr)
+        hook_write_to_file();
+    g_WriteToFile = on_write_to_file;
+}
+void set_async_game_writes(bool enable)
+{
+    g_async_game_writers = std::max(g_async_game_writers + (enable ? 1 : -1), 0);
+    if (g_async_game_writers > 0)
     {
-        g_write_to_file_trampoline = (WriteToFileOrig*)get_address("write_to_file"sv);
-
-        DetourTransactionBegin();
-        DetourUpdateThread(GetCurrentThread());
-
-        DetourAttach((void**)&g_write_to_file_trampoline, write_to_file);
-
-        const LONG error = DetourTransactionCommit();
-        if (error != NO_ERROR)
-        {
-            DEBUG("Failed hooking WriteToFile: {}\n", error);
-        }
+        hook_write_to_file();
     }
-    g_WriteToFile = on_write_to_file;
+    else
+    {
+        AsyncFileWriter::get().flush();
+    }
+    g_async_game_writes = g_async_game_writers > 0;
 }
 void register_get_image_file_path(GetImageFilePathCallback get_image_file_path)
 {
@@ -374,7 +1006,7 @@ std::string get_image_file_path(std::string root_path, std::string relative_path
     return root_path + '/' + relative_path;
 }
 
-bool create_d3d11_texture_from_file(const char* filename, ID3D11ShaderResourceView** out_srv, int* out_width, int* out_height, int crop_x, int crop_y, int crop_w, int crop_h)
+bool decode_image_file(const char* filename, std::vector<uint8_t>& out_pixels, int* out_width, int* out_height, int crop_x, int crop_y, int crop_w, int crop_h)
 {
     // Load from disk into a raw RGBA buffer
     int image_width = 0;
@@ -420,11 +1052,21 @@ bool create_d3d11_texture_from_file(const char* filename, ID3D11ShaderResourceVi
     }
     */
 
+    out_pixels.assign(image_data, image_data + (size_t)image_width * image_height * 4);
+    *out_width = image_width;
+    *out_height = image_height;
+    stbi_image_free(image_data);
+
+    return true;
+}
+
+bool create_d3d11_texture_from_pixels(const uint8_t* pixels, int width, int height, ID3D11ShaderResourceView** out_srv)
+{
     // Create texture
     D3D11_TEXTURE2D_DESC desc;
     ZeroMemory(&desc, sizeof(desc));
-    desc.Width = image_width;
-    desc.Height = image_height;
+    desc.Width = width;
+    desc.Height = height;
     desc.MipLevels = 1;
     desc.ArraySize = 1;
     desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -435,10 +1077,11 @@ bool create_d3d11_texture_from_file(const char* filename, ID3D11ShaderResourceVi
 
     ID3D11Texture2D* pTexture = NULL;
     D3D11_SUBRESOURCE_DATA subResource;
-    subResource.pSysMem = image_data;
+    subResource.pSysMem = pixels;
     subResource.SysMemPitch = desc.Width * 4;
     subResource.SysMemSlicePitch = 0;
-    get_device()->CreateTexture2D(&desc, &subResource, &pTexture);
+    if (FAILED(get_device()->CreateTexture2D(&desc, &subResource, &pTexture)))
+        return false;
 
     // Create texture view
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
@@ -447,13 +1090,24 @@ bool create_d3d11_texture_from_file(const char* filename, ID3D11ShaderResourceVi
     srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = desc.MipLevels;
     srvDesc.Texture2D.MostDetailedMip = 0;
-    get_device()->CreateShaderResourceView(pTexture, &srvDesc, out_srv);
+    const HRESULT result = get_device()->CreateShaderResourceView(pTexture, &srvDesc, out_srv);
     pTexture->Release();
 
+    return SUCCEEDED(result);
+}
+
+bool create_d3d11_texture_from_file(const char* filename, ID3D11ShaderResourceView** out_srv, int* out_width, int* out_height, int crop_x, int crop_y, int crop_w, int crop_h)
+{
+    std::vector<uint8_t> pixels;
+    int image_width = 0;
+    int image_height = 0;
+    if (!decode_image_file(filename, pixels, &image_width, &image_height, crop_x, crop_y, crop_w, crop_h))
+        return false;
+    if (!create_d3d11_texture_from_pixels(pixels.data(), image_width, image_height, out_srv))
+        return false;
+
     *out_width = image_width;
     *out_height = image_height;
-    stbi_image_free(image_data);
-
     return true;
 }
 
@@ -503,34 +1157,123 @@ bool create_d3d11_texture_from_memory(const unsigned char* buf, const unsigned i
     return true;
 }
 
-bool get_image_size_from_file(const char* filename, int* out_width, int* out_height)
+namespace
+{
+uint32_t read_be16(const unsigned char* p)
+{
+    return (p[0] << 8) | p[1];
+}
+uint32_t read_be32(const unsigned char* p)
+{
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+uint32_t read_le32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+// JPEG keeps the size in the frame header, which comes after the metadata segments, so those are skipped without reading them
+bool read_jpeg_size(FILE* f, int* out_width, int* out_height)
+{
+    unsigned char buf[9];
+    fseek(f, 2, SEEK_SET);
+    while (fread(buf, 1, 4, f) == 4)
+    {
+        if (buf[0] != 0xFF)
+            return false;
+        const unsigned char marker = buf[1];
+        const uint32_t length = read_be16(buf + 2);
+        if (length < 2)
+            return false;
+        // Any SOFn except DHT, JPG and DAC
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (fread(buf, 1, 5, f) != 5)
+                return false;
+            *out_height = read_be16(buf + 1);
+            *out_width = read_be16(buf + 3);
+            return true;
+        }
+        // Start of scan, the frame header should have come before
+        if (marker == 0xDA)
+            return false;
+        if (fseek(f, length - 2, SEEK_CUR) != 0)
+            return false;
+    }
+    return false;
+}
+
+bool read_image_size(const char* filename, int* out_width, int* out_height)
 {
     FILE* f{nullptr};
     auto error = fopen_s(&f, filename, "rb");
     if (error != 0 || f == nullptr)
         return false;
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (len < 24)
-    {
-        fclose(f);
-        return false;
-    }
+    OnScopeExit close{[f]()
+                      { fclose(f); }};
 
-    unsigned char buf[24];
-    fread(buf, 1, 24, f);
-    fclose(f);
+    unsigned char buf[26];
+    const size_t size = fread(buf, 1, sizeof(buf), f);
 
-    if (buf[0] == 0x89 && buf[1] == 'P' && buf[2] == 'N' && buf[3] == 'G' && buf[4] == 0x0D && buf[5] == 0x0A && buf[6] == 0x1A && buf[7] == 0x0A && buf[12] == 'I' && buf[13] == 'H' && buf[14] == 'D' && buf[15] == 'R')
+    if (size >= 24 && buf[0] == 0x89 && buf[1] == 'P' && buf[2] == 'N' && buf[3] == 'G' && buf[4] == 0x0D && buf[5] == 0x0A && buf[6] == 0x1A && buf[7] == 0x0A && buf[12] == 'I' && buf[13] == 'H' && buf[14] == 'D' && buf[15] == 'R')
+    {
+        *out_width = read_be32(buf + 16);
+        *out_height = read_be32(buf + 20);
+        return true;
+    }
+    if (size >= 20 && buf[0] == 'D' && buf[1] == 'D' && buf[2] == 'S' && buf[3] == ' ')
     {
-        *out_width = (buf[16] << 24) + (buf[17] << 16) + (buf[18] << 8) + (buf[19] << 0);
-        *out_height = (buf[20] << 24) + (buf[21] << 16) + (buf[22] << 8) + (buf[23] << 0);
+        // DDS_HEADER follows the magic, dwHeight comes before dwWidth
+        *out_height = read_le32(buf + 12);
+        *out_width = read_le32(buf + 16);
         return true;
     }
+    if (size >= 26 && buf[0] == 'B' && buf[1] == 'M')
+    {
+        // BITMAPINFOHEADER, a negative height means the rows are stored top down
+        *out_width = static_cast<int32_t>(read_le32(buf + 18));
+        *out_height = std::abs(static_cast<int32_t>(read_le32(buf + 22)));
+        return true;
+    }
+    if (size >= 4 && buf[0] == 0xFF && buf[1] == 0xD8)
+        return read_jpeg_size(f, out_width, out_height);
 
     return false;
 }
+} // namespace
+
+bool get_image_size_from_file(const char* filename, int* out_width, int* out_height)
+{
+    struct CachedSize
+    {
+        std::filesystem::file_time_type write_time;
+        int width;
+        int height;
+        bool valid;
+    };
+    static std::mutex cache_lock;
+    static std::unordered_map<std::string, CachedSize> cache;
+
+    // Only the write time is checked on a hit, so this can be asked every frame
+    std::error_code ec;
+    const auto write_time = std::filesystem::last_write_time(filename, ec);
+    if (ec)
+        return false;
+
+    std::lock_guard lock{cache_lock};
+    auto it = cache.find(filename);
+    if (it == cache.end() || it->second.write_time != write_time)
+    {
+        CachedSize size{write_time, 0, 0, false};
+        size.valid = read_image_size(filename, &size.width, &size.height);
+        it = cache.insert_or_assign(filename, size).first;
+    }
+    if (!it->second.valid)
+        return false;
+    *out_width = it->second.width;
+    *out_height = it->second.height;
+    return true;
+}
 
 /* decoding the whole image is slow af
 bool get_image_size_from_file(const char* filename, int* out_width, int* out_height)
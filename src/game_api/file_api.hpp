@@ -1,10 +1,18 @@
 #pragma once
 
 #include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t, uint32_t
 #include <cstdlib>     // for malloc
 #include <d3d11.h>     // for ID3D11ShaderResourceView
+#include <filesystem>  // for path
+#include <memory>      // for shared_ptr
+#include <optional>    // for optional
 #include <string>      // for string
 #include <string_view> // string_view
+#include <vector>      // for vector
+
+#include "audio_buffer.hpp" // for DecodedAudioBuffer, SoundFormat
+#include "mapped_file.hpp"  // for MappedFile
 
 using AllocFun = decltype(malloc);
 
@@ -25,18 +33,52 @@ using GetImageFilePathCallback = std::string(std::string root_path, std::string
 using MakeSavePathCallback = std::string (*)(std::string_view script_path, std::string_view script_name);
 
 FileInfo* load_file_as_dds_if_image(const char* file_path, AllocFun alloc_fun);
+// Reads a file the same way the game does, including files replaced by the load file callback, free the result with game_free
+FileInfo* read_game_file(const char* file_path);
+// Converts the images to the dds cache on worker threads, paths that aren't images or are already cached are skipped
+void prewarm_image_cache(std::vector<std::string> image_paths);
+// Converts the image to the dds cache right away on the calling thread, returns true if an up to date cache entry exists afterwards
+bool cache_image(const std::string& path);
+// Premultiplies `image_data` in place and returns a complete dds file, optionally with a box filtered mip chain
+std::vector<char> encode_rgba_as_dds(uint8_t* image_data, uint32_t image_width, uint32_t image_height, bool generate_mipmaps);
+bool write_cache_file(const std::filesystem::path& cache_path, const std::vector<char>& dds);
 
 void register_on_load_file(LoadFileCallback on_load_file);
 void register_on_read_from_file(ReadFromFileCallback on_read_from_file);
 void register_on_write_to_file(WriteToFileCallback on_write_to_file);
+// Hands the game's own file writes (savegame.sav and its backup) to the async file writer, the game thread only copies the buffer
+// Counted, the writes stay async until every enable got its disable
+void set_async_game_writes(bool enable);
 void register_get_image_file_path(GetImageFilePathCallback get_image_file_path);
 void register_make_save_path(MakeSavePathCallback make_save_path_callback);
 
 std::string get_image_file_path(std::string root_path, std::string relative_path);
 
+// RGBA pixels of the image, cropped if `crop_w` and `crop_h` are set, doesn't touch the device so it can run on any thread
+bool decode_image_file(const char* filename, std::vector<uint8_t>& out_pixels, int* out_width, int* out_height, int crop_x = 0, int crop_y = 0, int crop_w = 0, int crop_h = 0);
+bool create_d3d11_texture_from_pixels(const uint8_t* pixels, int width, int height, struct ID3D11ShaderResourceView** out_srv);
 bool create_d3d11_texture_from_file(const char* filename, struct ID3D11ShaderResourceView** out_srv, int* out_width, int* out_height, int crop_x = 0, int crop_y = 0, int crop_w = 0, int crop_h = 0);
 bool create_d3d11_texture_from_memory(const unsigned char* buf, const unsigned int buf_size, ID3D11ShaderResourceView** out_srv, int* out_width, int* out_height);
 bool get_image_size_from_file(const char* filename, int* out_width, int* out_height);
 
+// Decoded samples of a sound file from the cache next to the texture cache, mapped straight from the cache file
+struct CachedPcm
+{
+    std::shared_ptr<MappedFile> file;
+    int32_t num_channels;
+    int32_t frequency;
+    SoundFormat format;
+    // Points into `file`
+    std::string_view samples;
+};
+// nullopt if there's no cache entry or the sound file changed since it was made
+std::optional<CachedPcm> load_cached_pcm(const std::string& path);
+// Queued on the async file writer, `buffer` is copied
+void write_cached_pcm(const std::string& path, const DecodedAudioBuffer& buffer);
+
 std::string hash_path(std::string_view path);
+// Where the compiled Lua chunk for the source file at `path` is cached
+std::filesystem::path get_bytecode_cache_path(std::string_view path, std::string_view extension = ".luac");
+// Where the compiled shader with the ShaderCache key `key` is cached
+std::filesystem::path get_shader_cache_path(uint64_t key);
 void clear_cache(std::string_view path = "");
@@ -750,6 +750,9 @@ std::array pause_triggers{
     "Screen loaded",
     "Exit level",
     "Trigger only once",
+    "Entity spawned",
+    "Level time reached",
+    "Script error",
 };
 
 std::array levelgen_flags{
@@ -0,0 +1,145 @@
+#include "frame_limiter.hpp"
+
+#include <Windows.h> // for CreateWaitableTimerExW, SetWaitableTimerEx, WaitForSingleObject, QueryPerformanceCounter
+#include <algorithm> // for max, min
+#include <cmath>     // for sqrt
+
+#include "game_manager.hpp" // for get_game_manager, GameManager, GameProps
+#include "rpc.hpp"          // for set_frametime, get_frametime
+
+// Only in newer SDKs, older versions of Windows fail to create the timer with it and get a regular one
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace
+{
+int64_t now()
+{
+    LARGE_INTEGER ret;
+    QueryPerformanceCounter(&ret);
+    return ret.QuadPart;
+}
+} // namespace
+
+FrameLimiter& FrameLimiter::get()
+{
+    static FrameLimiter limiter;
+    return limiter;
+}
+
+FrameLimiter::FrameLimiter()
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    frequency = freq.QuadPart;
+
+    timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    high_resolution = timer != nullptr;
+    if (timer == nullptr)
+        timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    // A regular timer may wake up a whole scheduler tick late
+    set_spin(high_resolution ? 0.0005 : 0.002);
+}
+
+void FrameLimiter::set(std::optional<double> target)
+{
+    const bool was_on = target_ticks != 0;
+    target_ticks = target.value_or(0.0) > 0.0 ? (int64_t)(target.value() * frequency) : 0;
+    if (target_ticks != 0 && !was_on)
+    {
+        // A frametime a script set before is given back when the limiter is turned off
+        saved_frametime = get_frametime();
+        set_frametime(0.0);
+    }
+    else if (target_ticks == 0 && was_on)
+    {
+        set_frametime(saved_frametime);
+    }
+    deadline = 0;
+    last_start = 0;
+    reset_stats();
+}
+
+void FrameLimiter::set_spin(double seconds)
+{
+    spin_ticks = (int64_t)(std::max(seconds, 0.0) * frequency);
+}
+
+FrameLimiterStats FrameLimiter::get_stats() const
+{
+    const double to_ms = 1000.0 / frequency;
+    FrameLimiterStats stats{};
+    stats.frames = frames;
+    stats.late = late;
+    if (frames == 0)
+        return stats;
+    stats.last_ms = last_ticks * to_ms;
+    stats.min_ms = min_ticks * to_ms;
+    stats.max_ms = max_ticks * to_ms;
+    stats.average_ms = sum_ms / frames;
+    stats.deviation_ms = std::sqrt(std::max(0.0, sum_squares_ms / frames - stats.average_ms * stats.average_ms));
+    return stats;
+}
+
+void FrameLimiter::reset_stats()
+{
+    frames = 0;
+    late = 0;
+    last_ticks = 0;
+    min_ticks = 0;
+    max_ticks = 0;
+    sum_ms = 0.0;
+    sum_squares_ms = 0.0;
+}
+
+void FrameLimiter::add_sample(int64_t elapsed)
+{
+    const double ms = elapsed * 1000.0 / frequency;
+    min_ticks = frames == 0 ? elapsed : std::min(min_ticks, elapsed);
+    max_ticks = frames == 0 ? elapsed : std::max(max_ticks, elapsed);
+    last_ticks = elapsed;
+    sum_ms += ms;
+    sum_squares_ms += ms * ms;
+    frames++;
+}
+
+void FrameLimiter::wait()
+{
+    if (target_ticks == 0)
+        return;
+
+    // The game paces itself with the inactive frametime in the background, which isn't touched
+    static const auto gm = get_game_manager();
+    if (!gm->game_props->game_has_focus)
+    {
+        deadline = 0;
+        last_start = 0;
+        return;
+    }
+
+    int64_t start = now();
+    // More than a frame behind, after loading or a breakpoint, starts over instead of rushing to catch up
+    const bool resync = deadline == 0 || start - deadline > target_ticks;
+    if (!resync)
+    {
+        const int64_t sleep_ticks = deadline - start - spin_ticks;
+        if (sleep_ticks > 0 && timer != nullptr)
+        {
+            // Relative due time in 100 ns units
+            LARGE_INTEGER due;
+            due.QuadPart = -(sleep_ticks * 10'000'000 / frequency);
+            if (SetWaitableTimerEx(timer, &due, 0, nullptr, nullptr, nullptr, 0))
+                WaitForSingleObject(timer, INFINITE);
+        }
+        while ((start = now()) < deadline)
+            YieldProcessor();
+    }
+
+    if (deadline != 0 && start - deadline > frequency / 1000)
+        late++;
+    if (last_start != 0)
+        add_sample(start - last_start);
+    last_start = start;
+    deadline = (resync ? start : deadline) + target_ticks;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>  // for int64_t, uint64_t
+#include <optional> // for optional
+
+struct FrameLimiterStats
+{
+    /// Game loops paced since the stats were reset
+    uint64_t frames;
+    /// Time between the last two game loops in milliseconds
+    double last_ms;
+    double average_ms;
+    double min_ms;
+    double max_ms;
+    /// Standard deviation of the time between game loops in milliseconds
+    double deviation_ms;
+    /// Game loops that started more than 1 ms after their deadline
+    uint64_t late;
+};
+
+// Paces the game with a high resolution waitable timer and spins for the last bit of the wait, instead of the coarse sleep of the game
+// The game frametime is set to 0 while it's on, so every loop does exactly one update and the game doesn't wait on top of it
+class FrameLimiter
+{
+  public:
+    static FrameLimiter& get();
+
+    // Target seconds between game loops, nullopt turns it off and gives the pacing back to the game with the frametime it had before
+    void set(std::optional<double> target);
+    std::optional<double> get_target() const
+    {
+        if (target_ticks == 0)
+            return std::nullopt;
+        return (double)target_ticks / frequency;
+    }
+    // How long before the deadline the timer wakes up to spin the rest, in seconds
+    void set_spin(double seconds);
+
+    FrameLimiterStats get_stats() const;
+    void reset_stats();
+
+    // Called from wait_for_next_frame before the game processes input, waits until the next deadline
+    void wait();
+
+  private:
+    FrameLimiter();
+
+    void add_sample(int64_t elapsed);
+
+    void* timer{nullptr};
+    bool high_resolution{false};
+    int64_t frequency{0};
+    int64_t target_ticks{0};
+    int64_t spin_ticks{0};
+    int64_t deadline{0};
+    int64_t last_start{0};
+    // Engine frametime from before the limiter was turned on
+    double saved_frametime{0.0};
+
+    uint64_t frames{0};
+    uint64_t late{0};
+    int64_t last_ticks{0};
+    int64_t min_ticks{0};
+    int64_t max_ticks{0};
+    double sum_ms{0.0};
+    double sum_squares_ms{0.0};
+};
@@ -0,0 +1,177 @@
+#include "frame_telemetry.hpp"
+
+#include <Windows.h>    // for QueryPerformanceCounter, QueryPerformanceFrequency
+#include <algorithm>    // for sort, max, min
+#include <exception>    // for exception
+#include <fmt/format.h> // for format
+#include <memory>       // for unique_ptr
+#include <optional>     // for optional
+
+#include "logger.h"   // for DEBUG
+#include "socket.hpp" // for UdpServer
+
+FrameTelemetry& FrameTelemetry::get()
+{
+    static FrameTelemetry telemetry;
+    return telemetry;
+}
+
+void FrameTelemetry::add_phase_time(FRAME_PHASE phase, int64_t ticks)
+{
+    current_ticks[(size_t)phase] += ticks;
+}
+void FrameTelemetry::end_frame()
+{
+    const int64_t frame_end = now();
+    if (enabled.load(std::memory_order_relaxed))
+    {
+        const uint64_t frame = frames_written.load(std::memory_order_relaxed);
+        Slot& slot = ring[frame % HISTORY];
+        slot.sequence.store(frame * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.sample.frame = frame;
+        for (size_t i = 0; i < current_ticks.size(); ++i)
+        {
+            slot.sample.phase_ms[i] = ticks_to_ms(current_ticks[i]);
+        }
+        slot.sample.frame_ms = last_frame_end != 0 ? ticks_to_ms(frame_end - last_frame_end) : 0.0f;
+
+        slot.sequence.store(frame * 2 + 2, std::memory_order_release);
+        frames_written.store(frame + 1, std::memory_order_release);
+    }
+    current_ticks.fill(0);
+    last_frame_end = frame_end;
+}
+
+std::vector<FrameSample> FrameTelemetry::samples(size_t max_samples) const
+{
+    const uint64_t written = frames_written.load(std::memory_order_acquire);
+    const uint64_t count = std::min<uint64_t>({written, HISTORY, max_samples});
+
+    std::vector<FrameSample> copied;
+    copied.reserve(count);
+    for (uint64_t frame = written - count; frame < written; ++frame)
+    {
+        const Slot& slot = ring[frame % HISTORY];
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != frame * 2 + 2)
+            continue;
+        FrameSample sample = slot.sample;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before)
+            continue;
+        copied.push_back(sample);
+    }
+    return copied;
+}
+std::array<FramePhaseStats, FrameTelemetry::STAT_COUNT> FrameTelemetry::percentiles(const std::vector<FrameSample>& samples)
+{
+    std::array<FramePhaseStats, STAT_COUNT> stats{};
+    if (samples.empty())
+        return stats;
+
+    std::vector<float> values(samples.size());
+    for (size_t i = 0; i < STAT_COUNT; ++i)
+    {
+        for (size_t j = 0; j < samples.size(); ++j)
+        {
+            values[j] = i < (size_t)FRAME_PHASE::COUNT ? samples[j].phase_ms[i] : samples[j].frame_ms;
+        }
+        std::sort(values.begin(), values.end());
+        stats[i].p50 = values[values.size() / 2];
+        stats[i].p99 = values[std::min(values.size() - 1, values.size() * 99 / 100)];
+        stats[i].max = values.back();
+    }
+    return stats;
+}
+
+bool FrameTelemetry::start_streaming(std::string host, uint16_t port)
+{
+    // Answers on the receiving thread, there's no script to hand the datagrams to, the server lives until the game closes
+    static std::unique_ptr<UdpServer> server;
+    if (server)
+        return false;
+
+    try
+    {
+        server = std::make_unique<UdpServer>(
+            std::move(host),
+            port,
+            [this](std::string) -> std::optional<std::string>
+            {
+                // Limit the answer to what comfortably fits in a datagram
+                const std::vector<FrameSample> recent = samples(64);
+                const uint64_t streamed = frames_streamed.exchange(frames_written.load(std::memory_order_acquire));
+                std::string answer;
+                for (const FrameSample& sample : recent)
+                {
+                    if (sample.frame < streamed)
+                        continue;
+                    answer += fmt::format("{}", sample.frame);
+                    for (float phase_ms : sample.phase_ms)
+                        answer += fmt::format(" {:.3f}", phase_ms);
+                    answer += fmt::format(" {:.3f}\n", sample.frame_ms);
+                }
+                return answer;
+            });
+    }
+    catch (const std::exception& err)
+    {
+        DEBUG("Failed to start frame telemetry server: {}", err.what());
+        return false;
+    }
+    streaming = true;
+    return true;
+}
+bool FrameTelemetry::is_streaming() const
+{
+    return streaming;
+}
+
+int64_t FrameTelemetry::now()
+{
+    LARGE_INTEGER ret;
+    QueryPerformanceCounter(&ret);
+    return ret.QuadPart;
+}
+float FrameTelemetry::ticks_to_ms(int64_t ticks)
+{
+    static const double ms_per_tick = []()
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        return 1000.0 / (double)freq.QuadPart;
+    }();
+    return (float)((double)ticks * ms_per_tick);
+}
+int64_t FrameTelemetry::ms_to_ticks(float ms)
+{
+    static const double ticks_per_ms = []()
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        return (double)freq.QuadPart / 1000.0;
+    }();
+    return (int64_t)((double)ms * ticks_per_ms);
+}
+const char* FrameTelemetry::phase_name(FRAME_PHASE phase)
+{
+    switch (phase)
+    {
+    case FRAME_PHASE::PRE_UPDATE:
+        return "Pre update";
+    case FRAME_PHASE::GAME_UPDATE:
+        return "Game update";
+    case FRAME_PHASE::LUA_CALLBACKS:
+        return "Lua callbacks";
+    case FRAME_PHASE::IMGUI_DRAW:
+        return "ImGui draw";
+    case FRAME_PHASE::PRESENT:
+        return "Present";
+    case FRAME_PHASE::LUA_GC:
+        return "Lua GC";
+    default:
+        return "Frame";
+    }
+}
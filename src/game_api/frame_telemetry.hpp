@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>   // for array
+#include <atomic>  // for atomic
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t, int64_t, uint16_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+enum class FRAME_PHASE : uint8_t
+{
+    PRE_UPDATE,
+    GAME_UPDATE,
+    LUA_CALLBACKS,
+    IMGUI_DRAW,
+    PRESENT,
+    LUA_GC,
+    COUNT,
+};
+
+struct FrameSample
+{
+    uint64_t frame;
+    std::array<float, (size_t)FRAME_PHASE::COUNT> phase_ms;
+    // Time since the previous frame was presented
+    float frame_ms;
+};
+
+struct FramePhaseStats
+{
+    float p50;
+    float p99;
+    float max;
+};
+
+// Per phase frame timings, written by the game thread into a lock-free ring and read by the UI or the telemetry server
+class FrameTelemetry
+{
+  public:
+    static constexpr size_t HISTORY = 512;
+    static constexpr size_t STAT_COUNT = (size_t)FRAME_PHASE::COUNT + 1;
+
+    static FrameTelemetry& get();
+
+    void add_phase_time(FRAME_PHASE phase, int64_t ticks);
+    void end_frame();
+
+    // Copies the recorded samples oldest first, skipping slots that are being written to
+    std::vector<FrameSample> samples(size_t max_samples = HISTORY) const;
+    // Percentiles per phase, the last entry is the whole frame
+    static std::array<FramePhaseStats, STAT_COUNT> percentiles(const std::vector<FrameSample>& samples);
+
+    // Answers every datagram received on `host:port` with the samples recorded since the previous answer, as text lines
+    bool start_streaming(std::string host, uint16_t port);
+    bool is_streaming() const;
+
+    static int64_t now();
+    static float ticks_to_ms(int64_t ticks);
+    static int64_t ms_to_ticks(float ms);
+    static const char* phase_name(FRAME_PHASE phase);
+
+    std::atomic<bool> enabled{true};
+
+  private:
+    FrameTelemetry() = default;
+
+    struct Slot
+    {
+        // Odd while the slot is being written
+        std::atomic<uint64_t> sequence{0};
+        FrameSample sample;
+    };
+    std::array<Slot, HISTORY> ring;
+    std::atomic<uint64_t> frames_written{0};
+    std::atomic<uint64_t> frames_streamed{0};
+    std::array<int64_t, (size_t)FRAME_PHASE::COUNT> current_ticks{};
+    int64_t last_frame_end{0};
+    bool streaming{false};
+};
+
+class FramePhaseScope
+{
+  public:
+    FramePhaseScope(FRAME_PHASE phase_)
+        : phase{phase_}, start{FrameTelemetry::now()}
+    {
+    }
+    ~FramePhaseScope()
+    {
+        FrameTelemetry::get().add_phase_time(phase, FrameTelemetry::now() - start);
+    }
+
+  private:
+    FRAME_PHASE phase;
+    int64_t start;
+};
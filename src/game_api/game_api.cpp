@@ -1,7 +1,8 @@
 #include "game_api.hpp"
 
-#include "search.hpp" // for get_address
-#include "state.hpp"  // for StateMemory, get_state_ptr
+#include "screen_transform.hpp" // for ScreenTransform
+#include "search.hpp"           // for get_address
+#include "state.hpp"            // for StateMemory, get_state_ptr
 
 GameAPI* GameAPI::get()
 {
@@ -22,6 +23,7 @@ void GameAPI::set_zoom(std::optional<float> current, std::optional<float> target
     if (current.has_value())
     {
         renderer->current_zoom = current.value(); // - renderer->current_zoom_offset;
+        ScreenTransform::invalidate();
     }
     if (target.has_value())
     {
@@ -0,0 +1,145 @@
+#include "game_heap_stats.hpp"
+
+#include <functional>    // for hash, equal_to
+#include <mutex>         // for mutex, lock_guard
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+#include <unordered_set> // for unordered_set
+
+namespace
+{
+thread_local const char* g_current_tag{nullptr};
+thread_local uint32_t g_until_sample{0};
+
+struct SampledAllocation
+{
+    size_t size;
+    std::atomic<uint64_t>* live;
+};
+std::mutex g_sampled_lock;
+std::unordered_map<void*, SampledAllocation> g_sampled;
+// Checked before taking the lock on every free, most frees don't belong to a sampled allocation but this skips the lock when there are none
+std::atomic<size_t> g_sampled_count{0};
+} // namespace
+
+GameHeapTag::GameHeapTag(const char* tag)
+    : previous{g_current_tag}
+{
+    g_current_tag = tag;
+}
+GameHeapTag::~GameHeapTag()
+{
+    g_current_tag = previous;
+}
+const char* GameHeapTag::current()
+{
+    return g_current_tag;
+}
+void GameHeapTag::set_current(const char* tag)
+{
+    g_current_tag = tag;
+}
+const char* GameHeapTag::intern(std::string_view tag)
+{
+    static std::mutex interned_lock;
+    static std::unordered_set<std::string, std::hash<std::string_view>, std::equal_to<>>* interned = new std::unordered_set<std::string, std::hash<std::string_view>, std::equal_to<>>();
+    std::lock_guard lock{interned_lock};
+    auto it = interned->find(tag);
+    if (it == interned->end())
+        it = interned->emplace(tag).first;
+    return it->c_str();
+}
+
+GameHeapStats& GameHeapStats::get()
+{
+    static GameHeapStats stats;
+    return stats;
+}
+
+void GameHeapStats::set_enabled(bool enable)
+{
+    enabled.store(enable, std::memory_order_relaxed);
+    if (!enable)
+    {
+        std::lock_guard lock{g_sampled_lock};
+        g_sampled.clear();
+        g_sampled_count.store(0, std::memory_order_relaxed);
+        for (Slot& slot : slots)
+            slot.live_sampled.store(0, std::memory_order_relaxed);
+    }
+}
+
+GameHeapStats::Slot& GameHeapStats::find_slot(const char* tag)
+{
+    for (Slot& slot : slots)
+    {
+        const char* slot_tag = slot.tag.load(std::memory_order_acquire);
+        if (slot_tag == tag)
+            return slot;
+        if (slot_tag == nullptr && slot.tag.compare_exchange_strong(slot_tag, tag, std::memory_order_acq_rel))
+            return slot;
+        // Lost the race for the empty slot, it may have been taken for the same tag
+        if (slot_tag == tag)
+            return slot;
+    }
+    // Out of slots, the rest is counted under the last one
+    return slots.back();
+}
+
+void GameHeapStats::on_alloc(void* mem, size_t size, const char* default_tag)
+{
+    if (mem == nullptr)
+        return;
+    const char* tag = g_current_tag != nullptr ? g_current_tag : default_tag;
+    Slot& slot = find_slot(tag);
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    slot.bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (g_until_sample-- != 0)
+        return;
+    g_until_sample = SAMPLE_RATE - 1;
+    std::lock_guard lock{g_sampled_lock};
+    // The game may have reused the memory of a sampled allocation it freed itself
+    if (auto it = g_sampled.find(mem); it != g_sampled.end())
+    {
+        it->second.live->fetch_sub(it->second.size, std::memory_order_relaxed);
+        g_sampled.erase(it);
+    }
+    g_sampled.emplace(mem, SampledAllocation{size, &slot.live_sampled});
+    slot.live_sampled.fetch_add(size, std::memory_order_relaxed);
+    g_sampled_count.store(g_sampled.size(), std::memory_order_relaxed);
+}
+
+void GameHeapStats::on_free(void* mem)
+{
+    if (mem == nullptr)
+        return;
+    frees.fetch_add(1, std::memory_order_relaxed);
+    if (g_sampled_count.load(std::memory_order_relaxed) == 0)
+        return;
+    std::lock_guard lock{g_sampled_lock};
+    if (auto it = g_sampled.find(mem); it != g_sampled.end())
+    {
+        it->second.live->fetch_sub(it->second.size, std::memory_order_relaxed);
+        g_sampled.erase(it);
+        g_sampled_count.store(g_sampled.size(), std::memory_order_relaxed);
+    }
+}
+
+std::vector<GameHeapTagStats> GameHeapStats::collect() const
+{
+    std::vector<GameHeapTagStats> stats;
+    for (const Slot& slot : slots)
+    {
+        const char* tag = slot.tag.load(std::memory_order_acquire);
+        if (tag == nullptr)
+            break;
+        stats.push_back({
+            tag,
+            slot.allocations.load(std::memory_order_relaxed),
+            slot.bytes.load(std::memory_order_relaxed),
+            slot.live_sampled.load(std::memory_order_relaxed) * SAMPLE_RATE,
+        });
+    }
+    return stats;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>       // for array
+#include <atomic>      // for atomic
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint32_t, uint64_t
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+struct GameHeapTagStats
+{
+    const char* tag;
+    uint64_t allocations;
+    uint64_t bytes;
+    // Estimated from the sampled allocations that weren't freed yet
+    uint64_t live_bytes;
+};
+
+// Optional counters for everything the API allocates through game_malloc and custom_malloc, grouped by the GameHeapTag of the calling thread
+// Allocations and bytes are counted exactly, one in SAMPLE_RATE allocations is remembered to estimate how much of it is still alive
+// The game frees some of them itself without going through game_free, those are only noticed once the address is handed out again
+class GameHeapStats
+{
+  public:
+    static constexpr size_t MAX_TAGS = 32;
+    static constexpr uint32_t SAMPLE_RATE = 16;
+
+    static GameHeapStats& get();
+
+    bool is_enabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    // Disabling forgets the sampled allocations, so the live sizes start from 0 when it's enabled again
+    void set_enabled(bool enable);
+
+    // Called by the allocators with the size they were asked for
+    void on_alloc(void* mem, size_t size, const char* default_tag);
+    void on_free(void* mem);
+
+    std::vector<GameHeapTagStats> collect() const;
+    uint64_t get_frees() const
+    {
+        return frees.load(std::memory_order_relaxed);
+    }
+
+  private:
+    GameHeapStats() = default;
+
+    struct Slot
+    {
+        std::atomic<const char*> tag{nullptr};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> live_sampled{0};
+    };
+    Slot& find_slot(const char* tag);
+
+    std::atomic<bool> enabled{false};
+    std::array<Slot, MAX_TAGS> slots;
+    std::atomic<uint64_t> frees{0};
+};
+
+// Everything game_malloc and custom_malloc allocate on this thread while one is alive is counted under `tag`, which has to outlive the stats (a string literal)
+class GameHeapTag
+{
+  public:
+    GameHeapTag(const char* tag);
+    ~GameHeapTag();
+    GameHeapTag(const GameHeapTag&) = delete;
+    GameHeapTag& operator=(const GameHeapTag&) = delete;
+
+    // nullptr if there's no tag on this thread
+    static const char* current();
+    // For tags that don't stay in one scope, like the script that is running
+    static void set_current(const char* tag);
+    // Copy of `tag` that is never freed, the same pointer every time for the same text
+    static const char* intern(std::string_view tag);
+
+  private:
+    const char* previous;
+};
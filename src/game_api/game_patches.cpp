@@ -372,6 +372,7 @@ void activate_sparktraps_hack(bool activate)
         static const auto offset = get_address("sparktrap_angle_increment");
         const int32_t distance_offset = 0xF1;
 
+        PatchTransaction transaction;
         write_mem_recoverable("sparktraps_hack", offset, "\xF3\x0F\x58\x89\x6C\x01\x00\x00"sv, true);
         write_mem_recoverable("sparktraps_hack", offset + distance_offset, "\xF3\x0F\x10\xB9\x70\x01\x00\x00"sv, true);
     }
@@ -512,6 +513,7 @@ void set_time_ghost_enabled(bool b)
     }
     else
     {
+        PatchTransaction transaction;
         write_mem_recoverable("set_time_ghost_enabled", offset_trigger, "\xC3\x90\x90\x90"sv, true);
         write_mem_recoverable("set_time_ghost_enabled", offset_toast_trigger, "\xC3\x90\x90\x90"sv, true);
     }
@@ -589,12 +591,8 @@ void change_sunchallenge_spawns(std::vector<ENT_TYPE> ent_types)
         if (was_edited_before)
             VirtualFree(old_types_array, 0, MEM_RELEASE);
 
-        // just free it since it's just easier to put the code again
-        if (new_code_address != 0)
-        {
-            VirtualFree(reinterpret_cast<LPVOID>(new_code_address), 0, MEM_RELEASE);
-            new_code_address = 0;
-        }
+        // just put the code again next time, the old trampoline is pooled memory and can't be freed
+        new_code_address = 0;
         return;
     }
     const auto data_size = ent_types.size() * sizeof(ENT_TYPE);
@@ -822,6 +820,7 @@ void modify_ankh_health_gain(uint8_t health, uint8_t beat_add_health)
 
         if (health % beat_add_health == 0)
         {
+            PatchTransaction transaction;
             write_mem_recoverable("ankh_health", size_minus_one, (uint8_t)(health - 1), true);
             write_mem_recoverable("ankh_health", offsets[0], health, true);
             write_mem_recoverable("ankh_health", offsets[1], health, true);
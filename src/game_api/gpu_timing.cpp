@@ -0,0 +1,171 @@
+#include "gpu_timing.hpp"
+
+#include <d3d11.h> // for ID3D11Device, ID3D11DeviceContext, ID3D11Query, D3D11_QUERY_DATA_TIMESTAMP_DISJOINT
+
+namespace
+{
+constexpr uint32_t no_range = ~0u;
+
+ID3D11Query* create_query(ID3D11Device* device, D3D11_QUERY type)
+{
+    D3D11_QUERY_DESC desc{type, 0};
+    ID3D11Query* query{nullptr};
+    if (FAILED(device->CreateQuery(&desc, &query)))
+        return nullptr;
+    return query;
+}
+} // namespace
+
+GpuTiming& GpuTiming::get()
+{
+    static GpuTiming timing;
+    return timing;
+}
+
+void GpuTiming::init(ID3D11Device* device_, ID3D11DeviceContext* context_)
+{
+    device = device_;
+    context = context_;
+    open_range.fill(no_range);
+}
+
+const char* GpuTiming::section_name(GPU_SECTION section)
+{
+    switch (section)
+    {
+    case GPU_SECTION::FRAME:
+        return "frame";
+    case GPU_SECTION::RENDER_LAYER:
+        return "render_layer";
+    case GPU_SECTION::RENDER_LEVEL:
+        return "render_level";
+    case GPU_SECTION::RENDER_HUD:
+        return "render_hud";
+    case GPU_SECTION::RENDER_DRAW_DEPTH:
+        return "render_draw_depth";
+    case GPU_SECTION::IMGUI:
+        return "imgui";
+    default:
+        return "unknown";
+    }
+}
+
+void GpuTiming::begin_section(GPU_SECTION section)
+{
+    Frame& frame = frames[current];
+    const size_t i = (size_t)section;
+    if (!frame.recording || depth[i]++ != 0)
+        return;
+    if (frame.used_ranges == MAX_RANGES)
+        return;
+
+    const uint32_t range = frame.used_ranges;
+    for (size_t j = range * 2; j < range * 2 + 2; ++j)
+    {
+        if (frame.timestamps[j] == nullptr && (frame.timestamps[j] = create_query(device, D3D11_QUERY_TIMESTAMP)) == nullptr)
+            return;
+    }
+    frame.used_ranges++;
+    frame.sections[range] = section;
+    open_range[i] = range;
+    context->End(frame.timestamps[range * 2]);
+}
+void GpuTiming::end_section(GPU_SECTION section)
+{
+    Frame& frame = frames[current];
+    const size_t i = (size_t)section;
+    if (!frame.recording || depth[i] == 0 || --depth[i] != 0)
+        return;
+    if (open_range[i] == no_range)
+        return;
+
+    context->End(frame.timestamps[open_range[i] * 2 + 1]);
+    open_range[i] = no_range;
+}
+
+void GpuTiming::begin_frame(Frame& frame)
+{
+    if (frame.disjoint == nullptr && (frame.disjoint = create_query(device, D3D11_QUERY_TIMESTAMP_DISJOINT)) == nullptr)
+        return;
+
+    frame.used_ranges = 0;
+    frame.recording = true;
+    depth.fill(0);
+    open_range.fill(no_range);
+    context->Begin(frame.disjoint);
+    begin_section(GPU_SECTION::FRAME);
+}
+
+bool GpuTiming::resolve(Frame& frame)
+{
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    if (context->GetData(frame.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        return false;
+
+    std::vector<GpuSectionTiming> timings;
+    for (size_t i = 0; i < SECTION_COUNT; ++i)
+    {
+        timings.push_back({section_name((GPU_SECTION)i), 0, 0.0f});
+    }
+    for (uint32_t range = 0; range < frame.used_ranges; ++range)
+    {
+        UINT64 begin{0};
+        UINT64 end{0};
+        if (context->GetData(frame.timestamps[range * 2], &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+            context->GetData(frame.timestamps[range * 2 + 1], &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return false;
+
+        if (end < begin || disjoint.Frequency == 0)
+            continue;
+        GpuSectionTiming& timing = timings[(size_t)frame.sections[range]];
+        timing.calls++;
+        timing.ms += static_cast<float>(static_cast<double>(end - begin) * 1000.0 / static_cast<double>(disjoint.Frequency));
+    }
+    frame.pending = false;
+
+    // The clock changed frequency during the frame, so the timestamps can't be compared
+    if (disjoint.Disjoint)
+        return true;
+
+    std::lock_guard lock{results_lock};
+    results = std::move(timings);
+    return true;
+}
+
+void GpuTiming::end_frame()
+{
+    if (context == nullptr)
+        return;
+
+    Frame& frame = frames[current];
+    if (frame.recording)
+    {
+        // Every recorded range needs its end timestamp or the frame never finishes, this also closes the frame range
+        for (size_t i = 0; i < SECTION_COUNT; ++i)
+        {
+            if (open_range[i] != no_range)
+                context->End(frame.timestamps[open_range[i] * 2 + 1]);
+        }
+        context->End(frame.disjoint);
+        frame.recording = false;
+        frame.pending = true;
+    }
+
+    // Oldest first, stop at the first one that isn't done so results stay in order
+    for (size_t i = 1; i <= FRAMES_IN_FLIGHT; ++i)
+    {
+        Frame& old = frames[(current + i) % FRAMES_IN_FLIGHT];
+        if (old.pending && !resolve(old))
+            break;
+    }
+
+    current = (current + 1) % FRAMES_IN_FLIGHT;
+    if (enabled.load(std::memory_order_relaxed) && !frames[current].pending)
+        begin_frame(frames[current]);
+}
+
+std::vector<GpuSectionTiming> GpuTiming::last_frame() const
+{
+    std::lock_guard lock{results_lock};
+    return results;
+}
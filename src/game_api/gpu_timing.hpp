@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>   // for array
+#include <atomic>  // for atomic
+#include <cstddef> // for size_t
+#include <cstdint> // for uint32_t, uint64_t, uint8_t
+#include <mutex>   // for mutex
+#include <vector>  // for vector
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Query;
+
+enum class GPU_SECTION : uint8_t
+{
+    FRAME,
+    RENDER_LAYER,
+    RENDER_LEVEL,
+    RENDER_HUD,
+    RENDER_DRAW_DEPTH,
+    IMGUI,
+    COUNT,
+};
+
+struct GpuSectionTiming
+{
+    /// Name of the timed section
+    const char* name;
+    /// How often the section ran during the frame
+    uint32_t calls;
+    /// GPU time spent in the section, `frame` is the time between two presents
+    float ms;
+};
+
+// GPU time of the vanilla render hooks and the ImGui draw, measured with D3D11 timestamp queries.
+// Queries are read back a few frames later without flushing, frames that aren't done yet when their slot is needed again are not timed.
+class GpuTiming
+{
+  public:
+    static GpuTiming& get();
+
+    void init(ID3D11Device* device, ID3D11DeviceContext* context);
+
+    void begin_section(GPU_SECTION section);
+    void end_section(GPU_SECTION section);
+    // Call right before Present, closes the current frame, reads back finished ones and opens the next one
+    void end_frame();
+
+    // Timings of the newest frame the GPU finished, empty if none finished since timing was enabled
+    std::vector<GpuSectionTiming> last_frame() const;
+
+    static const char* section_name(GPU_SECTION section);
+
+    std::atomic<bool> enabled{false};
+
+  private:
+    GpuTiming() = default;
+
+    static constexpr size_t FRAMES_IN_FLIGHT = 4;
+    // Timestamp pairs per frame, render_draw_depth alone runs for every draw depth of both layers
+    static constexpr size_t MAX_RANGES = 256;
+    static constexpr size_t SECTION_COUNT = (size_t)GPU_SECTION::COUNT;
+
+    struct Frame
+    {
+        ID3D11Query* disjoint{nullptr};
+        std::array<ID3D11Query*, MAX_RANGES * 2> timestamps{};
+        std::array<GPU_SECTION, MAX_RANGES> sections{};
+        uint32_t used_ranges{0};
+        bool recording{false};
+        // Ended and waiting for the GPU
+        bool pending{false};
+    };
+
+    void begin_frame(Frame& frame);
+    bool resolve(Frame& frame);
+
+    ID3D11Device* device{nullptr};
+    ID3D11DeviceContext* context{nullptr};
+    std::array<Frame, FRAMES_IN_FLIGHT> frames;
+    size_t current{0};
+    // Only the outermost call of a section is timed, per section the range it's recorded in
+    std::array<uint32_t, SECTION_COUNT> depth{};
+    std::array<uint32_t, SECTION_COUNT> open_range{};
+
+    mutable std::mutex results_lock;
+    std::vector<GpuSectionTiming> results;
+};
+
+class GpuSectionScope
+{
+  public:
+    GpuSectionScope(GPU_SECTION section_)
+        : section{section_}
+    {
+        GpuTiming::get().begin_section(section);
+    }
+    ~GpuSectionScope()
+    {
+        GpuTiming::get().end_section(section);
+    }
+
+  private:
+    GPU_SECTION section;
+};
@@ -3,15 +3,24 @@
 #include <Windows.h> // for HANDLE, GetCurrentProcessId, GetCurrentThread
 
 #include <TlHelp32.h>   // for CreateToolhelp32Snapshot, THREADENTRY32, Thr...
+#include <immintrin.h>  // for _mm256_add_epi64, _mm_add_epi64, _xgetbv
+#include <intrin.h>     // for __cpuid, __cpuidex
 #include <winternl.h>   // for KPRIORITY, NTSTATUS, CLIENT_ID, THREADINFOCLASS
 #include <wtypesbase.h> // for ULONG
 
+#include "entity_lookup.hpp" // for EntityCounter
 #include "logger.h"          // for DEBUG
 #include "memory.hpp"        // for memory_read
+#include "navigation.hpp"    // for NavigationGrid
 #include "script/events.hpp" // for pre_copy_state_event
 #include "search.hpp"        // for get_address
 
-constexpr size_t TEB_OFFSET = 0x120;
+// The entities at the addresses the caches remember may be different ones now, while the frame count can stay the same
+static void main_heap_replaced()
+{
+    EntityCounter::get().invalidate();
+    NavigationGrid::get().invalidate();
+}
 
 HANDLE get_main_thread()
 {
@@ -65,7 +74,7 @@ size_t* get_thread_heap_base(HANDLE thread)
         OUT PULONG ReturnLength OPTIONAL);
     static const auto NtQueryInformationThread_ptr = reinterpret_cast<FuncPtr>(GetProcAddress(GetModuleHandle("ntdll.dll"), "NtQueryInformationThread"));
     NtQueryInformationThread_ptr(thread, (_THREADINFOCLASS)0, (&tib), sizeof(THREAD_BASIC_INFORMATION), nullptr);
-    return (size_t*)(memory_read<uint64_t>(((uint64_t*)tib.TebBaseAddress)[11]) + TEB_OFFSET);
+    return (size_t*)(memory_read<uint64_t>(((uint64_t*)tib.TebBaseAddress)[HeapBase::TLS_ARRAY_OFFSET / sizeof(uint64_t)]) + HeapBase::TEB_OFFSET);
 }
 
 HeapBase HeapBase::get_main()
@@ -75,14 +84,6 @@ HeapBase HeapBase::get_main()
     return *this_thread_heap_base_addr;
 }
 
-HeapBase HeapBase::get()
-{
-    thread_local const uintptr_t* this_thread_heap_base_addr = get_thread_heap_base(GetCurrentThread());
-    if (this_thread_heap_base_addr == nullptr || *this_thread_heap_base_addr == NULL) // keeping for now just to be sure
-        return get_main();
-    return *this_thread_heap_base_addr;
-}
-
 HeapBase HeapBase::get(uint8_t slot)
 {
     if (slot >= MAX_SAVE_SLOTS)
@@ -96,6 +97,9 @@ struct HeapClone
     {
         auto address = *(heap_container_from + 0x11); // original absolute offset: 0x88
         HeapBase heap_base_from{address};
+        get_copy_state_stats().heap_clones.fetch_add(1, std::memory_order_relaxed);
+        if (heap_to.address() == HeapBase::get_main().address())
+            main_heap_replaced();
         pre_copy_state_event(heap_base_from, heap_to);
     }
 };
@@ -104,6 +108,12 @@ struct HeapClone
 // HeapContainer has heap1 and heap2 variables, and some sort of timer, that just increases constantly, I guess to handle the rollback and multi-threaded stuff
 // The rest of what HeapContainer has is unknown for now
 // After writing to a chosen storage from the content of `from->heap1`, sets `to->heap2` to the newly copied thread storage
+CopyStateStats& get_copy_state_stats()
+{
+    static CopyStateStats stats;
+    return stats;
+}
+
 void init_heap_clone_hook()
 {
     auto heap_clone = get_address("heap_clone");
@@ -128,34 +138,171 @@ void init_heap_clone_hook()
     patch_and_redirect(heap_clone_redirect_from_addr, 7, redirect_code, false, 0, false);
 }
 
+// The scalar reference, the vector kernels below have to give the same result
+static void relocate_heap_words_scalar(const size_t* from, size_t* to, uintptr_t from_base, uintptr_t to_base)
+{
+    // Pointers that point somewhere in the same heap have to be moved to the new heap, that is `from_base < value < from_base + 0x2000000`
+    const size_t diff = to_base - from_base;
+    for (size_t i = 0; i < 0x400000; ++i)
+    {
+        const size_t value = from[i];
+        to[i] = value >= from_base + 0x2000000 || value <= from_base ? value : value + diff;
+    }
+}
+
+static void relocate_heap_words_sse2(const size_t* from, size_t* to, uintptr_t from_base, uintptr_t to_base)
+{
+    // SSE2 has no 64bit compare, so instead check `value - from_base - 1 <= 0x1FFFFFE` by testing the bits above 25 and the one value that passes that test
+    const __m128i from_base_plus_one = _mm_set1_epi64x(from_base + 1);
+    const __m128i past_range = _mm_set1_epi64x(0x1FFFFFF);
+    const __m128i diff = _mm_set1_epi64x(to_base - from_base);
+    const __m128i zero = _mm_setzero_si128();
+
+    // The heap is way bigger than the cache, so skip reading the destination before writing it
+    const bool aligned = to_base % 16 == 0;
+    for (size_t i = 0; i < 0x400000; i += 2)
+    {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+        const __m128i offset = _mm_sub_epi64(value, from_base_plus_one);
+        __m128i in_range = _mm_cmpeq_epi32(_mm_srli_epi64(offset, 25), zero);
+        in_range = _mm_and_si128(in_range, _mm_shuffle_epi32(in_range, _MM_SHUFFLE(2, 3, 0, 1)));
+        __m128i is_past = _mm_cmpeq_epi32(offset, past_range);
+        is_past = _mm_and_si128(is_past, _mm_shuffle_epi32(is_past, _MM_SHUFFLE(2, 3, 0, 1)));
+        const __m128i fixed = _mm_add_epi64(value, _mm_and_si128(_mm_andnot_si128(is_past, in_range), diff));
+        if (aligned)
+            _mm_stream_si128(reinterpret_cast<__m128i*>(to + i), fixed);
+        else
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), fixed);
+    }
+    _mm_sfence();
+}
+
+// The compiler is only allowed to use AVX2 in here, the game has to run without it
+#if defined(__clang__) || defined(__GNUC__)
+#define HEAP_COPY_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define HEAP_COPY_AVX2_TARGET
+#endif
+
+HEAP_COPY_AVX2_TARGET static void relocate_heap_words_avx2(const size_t* from, size_t* to, uintptr_t from_base, uintptr_t to_base)
+{
+    // The compare is signed, flipping the sign bits of both sides makes it `value - from_base - 1 < 0x1FFFFFF` unsigned
+    const __m256i from_base_plus_one = _mm256_set1_epi64x(from_base + 1);
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i limit = _mm256_set1_epi64x(static_cast<int64_t>(0x1FFFFFFull ^ 0x8000000000000000ull));
+    const __m256i diff = _mm256_set1_epi64x(to_base - from_base);
+
+    const bool aligned = to_base % 32 == 0;
+    for (size_t i = 0; i < 0x400000; i += 4)
+    {
+        const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+        const __m256i offset = _mm256_xor_si256(_mm256_sub_epi64(value, from_base_plus_one), sign);
+        const __m256i in_range = _mm256_cmpgt_epi64(limit, offset);
+        const __m256i fixed = _mm256_add_epi64(value, _mm256_and_si256(in_range, diff));
+        if (aligned)
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(to + i), fixed);
+        else
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(to + i), fixed);
+    }
+    _mm_sfence();
+}
+
+static bool has_avx2()
+{
+    static const bool has = []()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        // AVX, and the OS saves the ymm registers
+        constexpr int osxsave_avx = (1 << 27) | (1 << 28);
+        if ((info[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return has;
+}
+
+HeapCopyKernel best_heap_copy_kernel()
+{
+    return has_avx2() ? HeapCopyKernel::AVX2 : HeapCopyKernel::SSE2;
+}
+
+void relocate_heap_words(const size_t* from, size_t* to, HeapCopyKernel kernel)
+{
+    const auto from_base = reinterpret_cast<uintptr_t>(from);
+    const auto to_base = reinterpret_cast<uintptr_t>(to);
+    switch (kernel)
+    {
+    case HeapCopyKernel::Scalar:
+        relocate_heap_words_scalar(from, to, from_base, to_base);
+        break;
+    case HeapCopyKernel::SSE2:
+        relocate_heap_words_sse2(from, to, from_base, to_base);
+        break;
+    case HeapCopyKernel::AVX2:
+        // Falls back when asked for on a cpu that doesn't have it
+        if (has_avx2())
+            relocate_heap_words_avx2(from, to, from_base, to_base);
+        else
+            relocate_heap_words_sse2(from, to, from_base, to_base);
+        break;
+    }
+}
+
 void HeapBase::copy_to(HeapBase other) const
 {
     if (is_null() || other.is_null())
         return;
 
-    auto fromBaseState = address();
-    auto toBaseState = other.address();
-    size_t iterIdx = 1;
-    do
+    // Loading a state, the uids in it may belong to other types than what the entity lookups remember
+    if (other.address() == get_main().address())
+        main_heap_replaced();
+
+    static const HeapCopyKernel kernel = best_heap_copy_kernel();
+    relocate_heap_words(reinterpret_cast<const size_t*>(address()), reinterpret_cast<size_t*>(other.address()), kernel);
+};
+
+size_t HeapBase::copy_changed_to(HeapBase other) const
+{
+    if (is_null() || other.is_null())
+        return 0;
+    if (other.address() == get_main().address())
+        main_heap_replaced();
+
+    // The heap is allocated by the game so write watching is not available for it, instead the destination page is compared
+    // with what it should contain after the copy which only costs reads, most pages don't change between two frames
+    constexpr size_t heap_words = 0x400000;
+    constexpr size_t page_words = 0x1000 / sizeof(size_t);
+
+    const auto from_base = address();
+    const auto to_base = other.address();
+    const size_t diff = to_base - from_base;
+    const size_t* from = reinterpret_cast<const size_t*>(from_base);
+    size_t* to = reinterpret_cast<size_t*>(to_base);
+    auto fixed_value = [from_base, diff](size_t value)
     {
-        size_t copyContent = *(size_t*)((fromBaseState - 8) + iterIdx * 8);
-        // variable used to fix pointers that point somewhere in the same Thread
-        size_t diff = toBaseState - fromBaseState;
-        if (copyContent >= fromBaseState + 0x2000000 || copyContent <= fromBaseState)
-        {
-            diff = 0;
-        }
-        *(size_t*)(toBaseState + iterIdx * 8 + -8) = diff + copyContent;
+        // same check as in `copy_to`, only pointers into this heap have to be moved
+        return value >= from_base + 0x2000000 || value <= from_base ? value : value + diff;
+    };
 
-        // Almost same code as before, but on the next value, idk why
-        copyContent = *(size_t*)(fromBaseState + iterIdx * 8);
-        diff = toBaseState - fromBaseState;
-        if (copyContent >= fromBaseState + 0x2000000 || copyContent <= fromBaseState)
-        {
-            diff = 0;
-        }
-        *(size_t*)(toBaseState + iterIdx * 8) = diff + copyContent;
+    size_t changed_pages = 0;
+    for (size_t page = 0; page < heap_words; page += page_words)
+    {
+        size_t i = page;
+        const size_t page_end = page + page_words;
+        while (i < page_end && to[i] == fixed_value(from[i]))
+            ++i;
 
-        iterIdx = iterIdx + 2;
-    } while (iterIdx != 0x400001);
-};
+        if (i == page_end)
+            continue;
+
+        ++changed_pages;
+        for (; i < page_end; ++i)
+            to[i] = fixed_value(from[i]);
+    }
+    return changed_pages;
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>   // for atomic
 #include <cstddef>  // for size_t
-#include <cstdint>  // for uint32_t
+#include <cstdint>  // for uint32_t, uint64_t, int64_t
+#include <intrin.h> // for __readgsqword
 #include <stdlib.h> // for free
 
 struct PRNG;
@@ -11,10 +13,24 @@ struct LiquidPhysics;
 
 struct HeapBase
 {
+    // ThreadLocalStoragePointer in the TEB
+    static constexpr size_t TLS_ARRAY_OFFSET = 0x58;
+    // Heap base in the game's TLS block
+    static constexpr size_t TEB_OFFSET = 0x120;
+
     // get HeapBase from save slots
     static HeapBase get(uint8_t slot);
     // get local, fallback to main if can't get local
-    static HeapBase get();
+    static HeapBase get() noexcept
+    {
+        // The game keeps the heap base in its TLS block, which is the first entry of the TLS array the TEB points to,
+        // read directly since nearly every api call starts here
+        const uintptr_t tls_block = **reinterpret_cast<uintptr_t**>(__readgsqword(TLS_ARRAY_OFFSET));
+        const uintptr_t heap_base = *reinterpret_cast<uintptr_t*>(tls_block + TEB_OFFSET);
+        if (heap_base == NULL) // keeping for now just to be sure
+            return get_main();
+        return heap_base;
+    }
     // use only if you know what you're doing
     static HeapBase get_main();
 
@@ -63,6 +79,9 @@ struct HeapBase
     }
 
     void copy_to(HeapBase other) const;
+    // Same result as `copy_to`, but pages that already hold the right (pointer fixed) content are not written to
+    // Cheaper when `other` is a recent copy of this heap, returns the amount of pages that had to be written
+    size_t copy_changed_to(HeapBase other) const;
 
   protected:
     HeapBase(uintptr_t addr) noexcept
@@ -92,8 +111,22 @@ struct HeapBase
     };
     static const uint8_t MAX_SAVE_SLOTS = 5;
     friend class SaveState;
+    friend class SaveStateRing;
     friend struct HeapClone;
+    friend struct StateHash;
+};
+
+enum class HeapCopyKernel
+{
+    Scalar,
+    SSE2,
+    AVX2,
 };
+// The kernel `HeapBase::copy_to` uses, AVX2 when the cpu has it
+HeapCopyKernel best_heap_copy_kernel();
+// Copies the 0x400000 words of a heap from `from` to `to`, moving the pointers into the `from` heap to the same offset in `to`
+// Any kernel gives the same result, pick one only to compare them, e.g. against the scalar reference in the benchmark
+void relocate_heap_words(const size_t* from, size_t* to, HeapCopyKernel kernel);
 
 // Used for objects that are allocated with the game's custom allocator
 template <typename T>
@@ -118,3 +151,20 @@ class OnHeapPointer
 };
 
 void init_heap_clone_hook();
+
+struct CopyStateStats
+{
+    // Heap clones done by the game itself, many a frame for the rollback in online play
+    std::atomic<uint64_t> heap_clones{0};
+    // Every copy the scripts got to copy their locals for, the heap clones and the save state functions
+    std::atomic<uint64_t> copies{0};
+    // Time pre_copy_state_event took for all of them
+    std::atomic<int64_t> copy_ticks{0};
+    std::atomic<uint64_t> copied_user_datas{0};
+    // StateMemory.user_data tables passed on by reference since nothing touched them since the last copy
+    std::atomic<uint64_t> shared_user_datas{0};
+};
+CopyStateStats& get_copy_state_stats();
+
+// Handle of the first thread of the process, the one running the game loop
+void* get_main_thread();
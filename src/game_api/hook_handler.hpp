@@ -1,8 +1,9 @@
 #pragma once
 
-#include <cstdint>    // for uint32_t
-#include <functional> // function
-#include <vector>     // vector
+#include <cstdint>       // for uint32_t
+#include <functional>    // function
+#include <unordered_set> // unordered_set
+#include <vector>        // vector
 
 enum class CallbackType
 {
@@ -26,9 +27,16 @@ struct HookHandler
 
         bool operator==(const Hook&) const = default;
     };
+    struct HookHash
+    {
+        std::size_t operator()(const Hook& hook) const
+        {
+            return std::hash<std::uint64_t>{}((std::uint64_t)hook.callback_id << 32 | hook.aux_id);
+        }
+    };
     std::vector<Hook> hooks;
     std::vector<Hook> dtor_hooks;
-    std::vector<Hook> cleared_hooks;
+    std::unordered_set<Hook, HookHash> cleared_hooks;
 
     void add_hook(std::uint32_t callback_id, std::uint32_t aux_id)
     {
@@ -37,12 +45,12 @@ struct HookHandler
     }
     void clear_hook(std::uint32_t callback_id, std::uint32_t aux_id)
     {
-        cleared_hooks.push_back(Hook{callback_id, aux_id});
+        cleared_hooks.insert(Hook{callback_id, aux_id});
     }
 
     bool is_hook_cleared(std::uint32_t callback_id, std::uint32_t aux_id) const
     {
-        return std::find(cleared_hooks.begin(), cleared_hooks.end(), Hook{callback_id, aux_id}) != cleared_hooks.end();
+        return cleared_hooks.contains(Hook{callback_id, aux_id});
     }
 
     void clear_pending()
@@ -58,8 +66,9 @@ struct HookHandler
     }
     void clear_all_hooks()
     {
-        cleared_hooks = std::move(hooks);
-        for (auto [callback_id, aux_id] : cleared_hooks)
+        std::vector<Hook> all_hooks = std::move(hooks);
+        cleared_hooks.insert(all_hooks.begin(), all_hooks.end());
+        for (auto [callback_id, aux_id] : all_hooks)
         {
             unhook(callback_id, aux_id);
         }
@@ -83,7 +92,7 @@ struct HookHandler
   private:
     void pre_dtor(std::uint32_t aux_id)
     {
-        const auto aux_id_equal = [aux_id](Hook& hook)
+        const auto aux_id_equal = [aux_id](const Hook& hook)
         { return hook.aux_id == aux_id; };
 
         [[maybe_unused]] auto num_erased_hooks = std::erase_if(hooks, aux_id_equal);
@@ -128,3 +137,42 @@ struct HookHandler
     }
     inline static std::function<void(std::uint32_t, std::uint32_t)> unhook_impl{};
 };
+
+// Hooks for every entity of a type, they take their ids from the normal callbacks and are cleared with them
+struct TypeHookHandler
+{
+    std::vector<std::uint32_t> type_hooks;
+
+    void add_type_hook(std::uint32_t callback_id)
+    {
+        type_hooks.push_back(callback_id);
+    }
+    template <class SetT>
+    void clear_pending_type_hooks(const SetT& cleared_callbacks)
+    {
+        std::erase_if(type_hooks, [&cleared_callbacks](std::uint32_t callback_id)
+                      {
+                          if (!cleared_callbacks.contains(callback_id))
+                              return false;
+                          type_unhook_impl(callback_id);
+                          return true; });
+    }
+    void clear_all_type_hooks()
+    {
+        for (std::uint32_t callback_id : type_hooks)
+        {
+            type_unhook_impl(callback_id);
+        }
+        type_hooks.clear();
+    }
+
+    template <class CallableT>
+    static void set_type_unhook_impl(CallableT&& callable)
+    {
+        assert(type_unhook_impl == nullptr);
+        type_unhook_impl = std::forward<CallableT>(callable);
+    }
+
+  private:
+    inline static std::function<void(std::uint32_t)> type_unhook_impl{};
+};
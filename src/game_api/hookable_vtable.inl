@@ -2,6 +2,7 @@
 
 #include <cstddef>       // for size_t
 #include <cstdint>       // for uint32_t
+#include <functional>    // for function
 #include <string>        // for string, string_literals
 #include <string_view>   // for string_view
 #include <type_traits>   // false_type, is_function_v, ...
@@ -9,10 +10,11 @@
 
 #include <sol/sol.hpp> // table
 
-#include "entity_hooks_info.hpp" // for HookWithId
-#include "hook_handler.hpp"      // for HookHandler
-#include "script/safe_cb.hpp"    // for make_safe_clearable_cb
-#include "vtable_hook.hpp"       // for get_hook_function, ...
+#include "entity_hooks_info.hpp"   // for HookWithId
+#include "entity_type_vtables.hpp" // for patch_entity_type_vtable
+#include "hook_handler.hpp"        // for HookHandler
+#include "script/safe_cb.hpp"      // for make_safe_clearable_cb
+#include "vtable_hook.hpp"         // for get_hook_function, patch_vtable, ...
 
 #include "hookable_vtable.hpp"
 
@@ -130,6 +132,46 @@ struct VTableEntryImpl<VTableEntry<Name, Index, RetT(ArgsT...), BindBack, DoHook
                 backend->MyHookHandler::add_hook(callback_id, aux_id);
                 return callback_id;
             };
+
+            // The dtor isn't dispatched through the vtable detours, so it can't be hooked for a whole type
+            using namespace std::string_view_literals;
+            if constexpr (requires(SelfT* self) { self->type->id; } && Name.template to<std::string_view>() != "dtor"sv)
+            {
+                vtable.pre_type_setters[MyIndex] = [&vtable](std::uint32_t entity_type, sol::function fun) -> std::uint32_t
+                {
+                    auto backend = LuaBackend::get_calling_backend();
+                    std::uint32_t callback_id = backend->cbcount++;
+                    vtable.template set_type_pre<FreeSignature, MyIndex>(
+                        entity_type,
+                        callback_id,
+                        make_safe_clearable_cb<FreePreSignature, CallbackType::Normal>(
+                            std::move(fun),
+                            callback_id,
+                            -1,
+                            FrontBinder<>{},
+                            BindBack{}));
+
+                    backend->add_type_hook(callback_id);
+                    return callback_id;
+                };
+                vtable.post_type_setters[MyIndex] = [&vtable](std::uint32_t entity_type, sol::function fun) -> std::uint32_t
+                {
+                    auto backend = LuaBackend::get_calling_backend();
+                    std::uint32_t callback_id = backend->cbcount++;
+                    vtable.template set_type_post<FreeSignature, MyIndex>(
+                        entity_type,
+                        callback_id,
+                        make_safe_clearable_cb<FreePostSignature, CallbackType::Normal>(
+                            std::move(fun),
+                            callback_id,
+                            -1,
+                            FrontBinder<>{},
+                            BindBack{}));
+
+                    backend->add_type_hook(callback_id);
+                    return callback_id;
+                };
+            }
         }
     }
 };
@@ -257,6 +299,21 @@ struct VTableHookInfos : UniquePreHookInfos<Signatures...>,
     {
         return static_cast<PostHookInfos<make_void_return_t<Signature>>*>(this)->hooks;
     }
+    // Callbacks of one index without inserting into the maps, nullptr if there are none
+    template <function_signature Signature, std::uint32_t Index>
+    auto* find_pre()
+    {
+        auto& pre_hooks = get_pre<Signature>();
+        auto it = pre_hooks.find(Index);
+        return it != pre_hooks.end() && !it->second.empty() ? &it->second : nullptr;
+    }
+    template <function_signature Signature, std::uint32_t Index>
+    auto* find_post()
+    {
+        auto& post_hooks = get_post<Signature>();
+        auto it = post_hooks.find(Index);
+        return it != post_hooks.end() && !it->second.empty() ? &it->second : nullptr;
+    }
     void unhook(std::uint32_t callback_id)
     {
         unhook_pre_impl<UniquePreSignatures>::call(*this, callback_id);
@@ -389,6 +446,26 @@ struct HookableVTable
                 auto backend = LuaBackend::get_calling_backend();
                 backend->MyHookHandler::clear_hook(callback_id, aux_id);
             };
+
+            if constexpr (requires(SelfT* self) { self->type->id; })
+            {
+                lua_type["set_pre_virtual_for_type"] = [this](std::uint32_t entity_type, std::uint32_t index, sol::function fun) -> sol::optional<std::uint32_t>
+                {
+                    if (auto it = pre_type_setters.find(index); it != pre_type_setters.end())
+                    {
+                        return it->second(entity_type, std::move(fun));
+                    }
+                    return sol::nullopt;
+                };
+                lua_type["set_post_virtual_for_type"] = [this](std::uint32_t entity_type, std::uint32_t index, sol::function fun) -> sol::optional<std::uint32_t>
+                {
+                    if (auto it = post_type_setters.find(index); it != post_type_setters.end())
+                    {
+                        return it->second(entity_type, std::move(fun));
+                    }
+                    return sol::nullopt;
+                };
+            }
         }
 
         if (!table_name.empty())
@@ -491,55 +568,175 @@ struct HookableVTable
         hook_info.unhook(callback_id);
     }
 
+    // Hooks for every entity of a type, by type id, these entities don't need any hook infos of their own
+    std::unordered_map<std::uint32_t, MyHookInfos> my_type_hooks;
+    // Registered by the entries that can be hooked by type, by their index
+    std::unordered_map<std::uint32_t, std::function<std::uint32_t(std::uint32_t, sol::function)>> pre_type_setters;
+    std::unordered_map<std::uint32_t, std::function<std::uint32_t(std::uint32_t, sol::function)>> post_type_setters;
+
+    MyHookInfos* find_type_hooks([[maybe_unused]] SelfT* obj)
+    {
+        if constexpr (requires { obj->type->id; })
+        {
+            if (!my_type_hooks.empty())
+            {
+                auto it = my_type_hooks.find(obj->type->id);
+                return it != my_type_hooks.end() ? &it->second : nullptr;
+            }
+        }
+        return nullptr;
+    }
+    template <function_signature Signature, std::uint32_t Index, invokable_as_pre_fun<Signature> CallableT>
+    void set_type_pre(std::uint32_t entity_type, std::uint32_t callback_id, CallableT pre_fun)
+    {
+        MyHookInfos& hook_info = hook_type<Signature, Index>(entity_type);
+        hook_info.template get_pre<Signature>()[Index].push_back({callback_id, std::move(pre_fun)});
+    }
+    template <function_signature Signature, std::uint32_t Index, invokable_as_post_fun<Signature> CallableT>
+    void set_type_post(std::uint32_t entity_type, std::uint32_t callback_id, CallableT post_fun)
+    {
+        MyHookInfos& hook_info = hook_type<Signature, Index>(entity_type);
+        hook_info.template get_post<Signature>()[Index].push_back({callback_id, std::move(post_fun)});
+    }
+    void unhook_type(std::uint32_t callback_id)
+    {
+        // The vtables stay patched, the detours call the original right away once the lists are empty
+        for (auto& [entity_type, hook_info] : my_type_hooks)
+        {
+            hook_info.unhook(callback_id);
+        }
+    }
+
   private:
+    template <function_signature Signature, std::uint32_t Index>
+    MyHookInfos& hook_type(std::uint32_t entity_type)
+    {
+        MyHookInfos& hook_info = my_type_hooks[entity_type];
+        if (!hook_info.is_hooked(Index))
+        {
+            hook_vtable_impl<Signature, Index>::call_for_type(*this, entity_type);
+            hook_info.set_hooked(Index);
+        }
+        return hook_info;
+    }
+
     template <class Signature, std::uint32_t Index>
     struct hook_vtable_impl;
     template <class... ArgsT, std::uint32_t Index>
     struct hook_vtable_impl<void(SelfT*, ArgsT...), Index>
     {
+        using Signature = void(SelfT*, ArgsT...);
+
         static void call(HookableVTable& self, SelfT* obj)
         {
-            hook_vtable<void(SelfT*, ArgsT...), Index>(
+            hook_vtable<Signature, Index>(
                 obj,
                 [&self](SelfT* inner_obj, ArgsT... args, void (*original)(SelfT*, ArgsT...))
                 {
-                    MyHookInfos& hook_info = self.get_hooks(inner_obj);
+                    run(self, &self.get_hooks(inner_obj), inner_obj, args..., original);
 
-                    bool skip_orig = false;
-                    for (auto& [id, prefun] : hook_info.template get_pre<void(SelfT*, ArgsT...)>()[Index])
+                    // cleanup hooks, delayed until all other dtor hooks have run
+                    if constexpr (Index == dtor_index)
                     {
-                        skip_orig = prefun(inner_obj, args...);
+                        self.remove_hooks(inner_obj);
                     }
-                    if (!skip_orig)
+                });
+        }
+        static void call_for_type(HookableVTable& self, std::uint32_t entity_type)
+        {
+            // Entities that are hooked themselves go through `call` instead, which runs the hooks of their type too
+            VTableDetour<Signature, Index>::set_type_function(
+                entity_type,
+                [&self](SelfT* inner_obj, ArgsT... args, void (*original)(SelfT*, ArgsT...))
+                { run(self, nullptr, inner_obj, args..., original); });
+            patch_entity_type_vtable(
+                entity_type,
+                [](Entity* ent)
+                { patch_vtable<Signature, Index>((SelfT*)ent); });
+        }
+        static void run(HookableVTable& self, MyHookInfos* hook_info, SelfT* inner_obj, ArgsT... args, void (*original)(SelfT*, ArgsT...))
+        {
+            MyHookInfos* type_hook_info = self.find_type_hooks(inner_obj);
+            auto* pre_hooks = hook_info ? hook_info->template find_pre<Signature, Index>() : nullptr;
+            auto* post_hooks = hook_info ? hook_info->template find_post<Signature, Index>() : nullptr;
+            auto* type_pre_hooks = type_hook_info ? type_hook_info->template find_pre<Signature, Index>() : nullptr;
+            auto* type_post_hooks = type_hook_info ? type_hook_info->template find_post<Signature, Index>() : nullptr;
+
+            bool skip_orig = false;
+            for (auto* hooks : {pre_hooks, type_pre_hooks})
+            {
+                if (hooks)
+                {
+                    for (auto& [id, prefun] : *hooks)
                     {
-                        original(inner_obj, args...);
+                        skip_orig = prefun(inner_obj, args...);
                     }
-                    for (auto& [id, postfun] : hook_info.template get_post<void(SelfT*, ArgsT...)>()[Index])
+                }
+            }
+            if (!skip_orig)
+            {
+                original(inner_obj, args...);
+            }
+            for (auto* hooks : {post_hooks, type_post_hooks})
+            {
+                if (hooks)
+                {
+                    for (auto& [id, postfun] : *hooks)
                     {
                         postfun(inner_obj, args...);
                     }
-
-                    // cleanup hooks, delayed until all other dtor hooks have run
-                    if constexpr (Index == dtor_index)
-                    {
-                        self.remove_hooks(inner_obj);
-                    }
-                });
+                }
+            }
         }
     };
     template <class RetT, class... ArgsT, std::uint32_t Index>
     struct hook_vtable_impl<RetT(SelfT*, ArgsT...), Index>
     {
+        using Signature = RetT(SelfT*, ArgsT...);
+
         static void call(HookableVTable& self, SelfT* obj)
         {
-            hook_vtable<RetT(SelfT*, ArgsT...), Index>(
+            hook_vtable<Signature, Index>(
                 obj,
                 [&self](SelfT* inner_obj, ArgsT... args, RetT (*original)(SelfT*, ArgsT...))
                 {
-                    MyHookInfos& hook_info = self.get_hooks(inner_obj);
+                    // dtor should never have a return value, so shouldn't reach here
+                    assert(Index != dtor_index);
 
-                    std::optional<RetT> return_value;
-                    for (auto& [id, prefun] : hook_info.template get_pre<RetT(SelfT*, ArgsT...)>()[Index])
+                    return run(self, &self.get_hooks(inner_obj), inner_obj, args..., original);
+                });
+        }
+        static void call_for_type(HookableVTable& self, std::uint32_t entity_type)
+        {
+            VTableDetour<Signature, Index>::set_type_function(
+                entity_type,
+                [&self](SelfT* inner_obj, ArgsT... args, RetT (*original)(SelfT*, ArgsT...))
+                { return run(self, nullptr, inner_obj, args..., original); });
+            patch_entity_type_vtable(
+                entity_type,
+                [](Entity* ent)
+                { patch_vtable<Signature, Index>((SelfT*)ent); });
+        }
+        static RetT run(HookableVTable& self, MyHookInfos* hook_info, SelfT* inner_obj, ArgsT... args, RetT (*original)(SelfT*, ArgsT...))
+        {
+            MyHookInfos* type_hook_info = self.find_type_hooks(inner_obj);
+            auto* pre_hooks = hook_info ? hook_info->template find_pre<Signature, Index>() : nullptr;
+            auto* post_hooks = hook_info ? hook_info->template find_post<Signature, Index>() : nullptr;
+            auto* type_pre_hooks = type_hook_info ? type_hook_info->template find_pre<Signature, Index>() : nullptr;
+            auto* type_post_hooks = type_hook_info ? type_hook_info->template find_post<Signature, Index>() : nullptr;
+
+            // All callbacks for this function were cleared, nothing to do but call the original
+            if (!pre_hooks && !post_hooks && !type_pre_hooks && !type_post_hooks)
+            {
+                return original(inner_obj, args...);
+            }
+
+            std::optional<RetT> return_value;
+            for (auto* hooks : {pre_hooks, type_pre_hooks})
+            {
+                if (hooks)
+                {
+                    for (auto& [id, prefun] : *hooks)
                     {
                         auto ret = prefun(inner_obj, args...);
                         if (ret.has_value() && !return_value.has_value())
@@ -547,20 +744,24 @@ struct HookableVTable
                             return_value = ret.value();
                         }
                     }
-                    if (!return_value.has_value())
-                    {
-                        return_value = original(inner_obj, args...);
-                    }
-                    for (auto& [id, postfun] : hook_info.template get_post<RetT(SelfT*, ArgsT...)>()[Index])
+                }
+            }
+            if (!return_value.has_value())
+            {
+                return_value = original(inner_obj, args...);
+            }
+            for (auto* hooks : {post_hooks, type_post_hooks})
+            {
+                if (hooks)
+                {
+                    for (auto& [id, postfun] : *hooks)
                     {
                         postfun(inner_obj, args...);
                     }
+                }
+            }
 
-                    // dtor should never have a return value, so shouldn't reach here
-                    assert(Index != dtor_index);
-
-                    return return_value.value();
-                });
+            return return_value.value();
         }
     };
 
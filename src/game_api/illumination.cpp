@@ -1,12 +1,14 @@
 #include "illumination.hpp"
 
+#include <algorithm>     // for max, min
 #include <type_traits>
+#include <unordered_set> // for unordered_set
 
 #include "color.hpp"  // for Color
 #include "entity.hpp" // for Entity
 #include "math.hpp"   // for Vec2
 #include "search.hpp" // for get_address
-#include "state.hpp"  // for get_state_ptr
+#include "state.hpp"  // for get_state_ptr, API::click_position
 
 Illumination* create_illumination(Vec2 pos, Color col, LIGHT_TYPE type, float size, uint8_t light_flags, int32_t uid, LAYER layer)
 {
@@ -44,3 +46,137 @@ void refresh_illumination(Illumination* illumination)
 {
     illumination->timer = HeapBase::get().frame_count();
 }
+
+namespace
+{
+std::unordered_set<Illumination*> g_script_lights;
+bool g_light_culling{true};
+// In tiles, on top of the size of the light
+float g_light_culling_margin{4.0f};
+} // namespace
+
+void track_script_light(Illumination* illumination)
+{
+    if (illumination != nullptr)
+        g_script_lights.insert(illumination);
+}
+
+std::vector<Illumination*> create_illuminations(const std::vector<float>& xs, const std::vector<float>& ys, Color color, float size, LAYER layer)
+{
+    const size_t count = std::min(xs.size(), ys.size());
+    std::vector<Illumination*> illuminations;
+    illuminations.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Illumination* illumination = create_illumination(Vec2{xs[i], ys[i]}, color, LIGHT_TYPE::NONE, size, 0x20, -1, layer);
+        track_script_light(illumination);
+        illuminations.push_back(illumination);
+    }
+    return illuminations;
+}
+
+std::vector<Illumination*> create_illuminations_on_entities(const std::vector<int32_t>& uids, Color color, float size)
+{
+    std::vector<Illumination*> illuminations;
+    illuminations.reserve(uids.size());
+    for (int32_t uid : uids)
+    {
+        Illumination* illumination = create_illumination(color, size, uid);
+        track_script_light(illumination);
+        illuminations.push_back(illumination);
+    }
+    return illuminations;
+}
+
+void refresh_illuminations(const std::vector<Illumination*>& illuminations)
+{
+    const uint32_t frame = HeapBase::get().frame_count();
+    for (Illumination* illumination : illuminations)
+    {
+        if (illumination != nullptr)
+            illumination->timer = frame;
+    }
+}
+
+void move_illuminations(const std::vector<Illumination*>& illuminations, const std::vector<float>& xs, const std::vector<float>& ys)
+{
+    const uint32_t frame = HeapBase::get().frame_count();
+    const size_t count = std::min({illuminations.size(), xs.size(), ys.size()});
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (Illumination* illumination = illuminations[i])
+        {
+            illumination->light_pos_x = xs[i];
+            illumination->light_pos_y = ys[i];
+            illumination->timer = frame;
+        }
+    }
+}
+
+void destroy_illuminations(const std::vector<Illumination*>& illuminations)
+{
+    for (Illumination* illumination : illuminations)
+    {
+        if (illumination != nullptr)
+        {
+            illumination->enabled = false;
+            illumination->timer = 0;
+            g_script_lights.erase(illumination);
+        }
+    }
+}
+
+void set_light_culling(bool enabled, float margin)
+{
+    g_light_culling = enabled;
+    g_light_culling_margin = margin;
+}
+
+const std::vector<Illumination*>& cull_lightsources(const std::vector<Illumination*>& lightsources)
+{
+    if (g_script_lights.empty())
+        return lightsources;
+
+    static std::vector<Illumination*> visible;
+    static std::vector<Illumination*> still_alive;
+    visible.clear();
+    still_alive.clear();
+
+    const Vec2 top_left = API::click_position(-1.0f, 1.0f);
+    const Vec2 bottom_right = API::click_position(1.0f, -1.0f);
+    for (Illumination* illumination : lightsources)
+    {
+        if (!g_script_lights.contains(illumination))
+        {
+            visible.push_back(illumination);
+            continue;
+        }
+        still_alive.push_back(illumination);
+
+        // Lights that follow the camera or light a whole room are always on screen in some way
+        constexpr uint8_t always_visible = static_cast<uint8_t>(LIGHT_TYPE::FOLLOW_CAMERA) | static_cast<uint8_t>(LIGHT_TYPE::ROOM_LIGHT);
+        if (!g_light_culling || (static_cast<uint8_t>(illumination->type_flags) & always_visible) != 0)
+        {
+            visible.push_back(illumination);
+            continue;
+        }
+        float reach = 0.0f;
+        for (const LightParams& light : illumination->lights)
+        {
+            reach = std::max(reach, light.size);
+        }
+        reach += g_light_culling_margin;
+        const float x = illumination->light_pos_x + illumination->offset_x;
+        const float y = illumination->light_pos_y + illumination->offset_y;
+        if (x + reach >= top_left.x && x - reach <= bottom_right.x && y + reach >= bottom_right.y && y - reach <= top_left.y)
+            visible.push_back(illumination);
+    }
+
+    // The game frees lights on its own, forget the ones it doesn't render anymore
+    if (still_alive.size() != g_script_lights.size())
+        g_script_lights = std::unordered_set<Illumination*>{still_alive.begin(), still_alive.end()};
+
+    if (visible.size() == lightsources.size())
+        return lightsources;
+    return visible;
+}
@@ -2,6 +2,7 @@
 
 #include <array>
 #include <cstdint>
+#include <vector>
 
 #include "aliases.hpp"
 
@@ -73,3 +74,18 @@ struct Illumination
 [[nodiscard]] Illumination* create_illumination(Color color, float size, float x, float y);
 [[nodiscard]] Illumination* create_illumination(Color color, float size, int32_t uid);
 void refresh_illumination(Illumination* illumination);
+
+// Batch versions for scripts with a lot of lights, the lights are tracked for culling like the ones from `track_script_light`
+[[nodiscard]] std::vector<Illumination*> create_illuminations(const std::vector<float>& xs, const std::vector<float>& ys, Color color, float size, LAYER layer);
+[[nodiscard]] std::vector<Illumination*> create_illuminations_on_entities(const std::vector<int32_t>& uids, Color color, float size);
+void refresh_illuminations(const std::vector<Illumination*>& illuminations);
+// Moves the lights to the positions and refreshes them
+void move_illuminations(const std::vector<Illumination*>& illuminations, const std::vector<float>& xs, const std::vector<float>& ys);
+// Disables the lights and lets them expire, the game frees them like any light that isn't refreshed
+void destroy_illuminations(const std::vector<Illumination*>& illuminations);
+
+// Lights created by scripts, only these are ever culled since the game expects its own lights to be rendered
+void track_script_light(Illumination* illumination);
+void set_light_culling(bool enabled, float margin);
+// `lightsources` without the tracked lights that are too far outside of the screen, or `lightsources` itself when there is nothing to cull
+const std::vector<Illumination*>& cull_lightsources(const std::vector<Illumination*>& lightsources);
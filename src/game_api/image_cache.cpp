@@ -0,0 +1,96 @@
+#include "image_cache.hpp"
+
+#include <d3d11.h>       // for ID3D11ShaderResourceView
+#include <filesystem>    // for absolute, path
+#include <fmt/format.h>  // for format
+#include <system_error>  // for error_code
+#include <unordered_map> // for unordered_map
+#include <utility>       // for move
+
+#include "file_api.hpp" // for decode_image_file, create_d3d11_texture_from_pixels
+
+namespace
+{
+std::mutex g_images_lock;
+std::unordered_map<std::string, std::weak_ptr<CachedImage>> g_images;
+
+ID3D11ShaderResourceView* get_placeholder_texture()
+{
+    // Transparent, only drawn if the texture couldn't be created
+    static ID3D11ShaderResourceView* placeholder = []()
+    {
+        const uint8_t pixel[4]{0, 0, 0, 0};
+        ID3D11ShaderResourceView* srv{nullptr};
+        create_d3d11_texture_from_pixels(pixel, 1, 1, &srv);
+        return srv;
+    }();
+    return placeholder;
+}
+} // namespace
+
+CachedImage::~CachedImage()
+{
+    if (texture != nullptr)
+        texture->Release();
+}
+
+ID3D11ShaderResourceView* CachedImage::get_texture()
+{
+    switch (status.load(std::memory_order_acquire))
+    {
+    case Status::UPLOADED:
+        return texture;
+    case Status::DECODED:
+        if (create_d3d11_texture_from_pixels(pixels.data(), width, height, &texture))
+        {
+            pixels = {};
+            status.store(Status::UPLOADED, std::memory_order_release);
+            return texture;
+        }
+        pixels = {};
+        status.store(Status::FAILED, std::memory_order_release);
+        {
+            std::lock_guard lock{g_images_lock};
+            if (auto it = g_images.find(key); it != g_images.end() && it->second.lock().get() == this)
+                g_images.erase(it);
+        }
+        return get_placeholder_texture();
+    default:
+        return get_placeholder_texture();
+    }
+}
+
+std::shared_ptr<CachedImage> acquire_cached_image(const std::string& path, int crop_x, int crop_y, int crop_w, int crop_h)
+{
+    const bool crop = crop_w > 0 && crop_h > 0;
+    std::error_code ec;
+    std::string key = std::filesystem::absolute(path, ec).lexically_normal().string();
+    if (crop)
+        key += fmt::format("|{},{},{},{}", crop_x, crop_y, crop_w, crop_h);
+
+    {
+        std::lock_guard lock{g_images_lock};
+        if (auto it = g_images.find(key); it != g_images.end())
+        {
+            if (std::shared_ptr<CachedImage> image = it->second.lock())
+                return image;
+            g_images.erase(it);
+        }
+    }
+
+    // A header alone doesn't say the file decodes, so it's decoded right away and a failure is reported to the script
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    if (!decode_image_file(path.c_str(), pixels, &width, &height, crop_x, crop_y, crop_w, crop_h) || pixels.empty())
+        return nullptr;
+
+    std::lock_guard lock{g_images_lock};
+    // Another backend may have decoded the same image meanwhile, keep the one that is already shared
+    std::weak_ptr<CachedImage>& cached = g_images[key];
+    if (std::shared_ptr<CachedImage> image = cached.lock())
+        return image;
+    auto image = std::make_shared<CachedImage>(key, std::move(pixels), width, height);
+    cached = image;
+    return image;
+}
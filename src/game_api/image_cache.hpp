@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>  // for atomic
+#include <cstdint> // for uint8_t
+#include <memory>  // for shared_ptr
+#include <mutex>   // for mutex
+#include <string>  // for string
+#include <utility> // for move
+#include <vector>  // for vector
+
+struct ID3D11ShaderResourceView;
+
+// Image created by scripts, shared by every backend that creates one from the same file and crop and freed with the last of them
+// The pixels are decoded when it's created and only uploaded the first time the image is drawn
+class CachedImage
+{
+  public:
+    CachedImage(std::string key_, std::vector<uint8_t> pixels_, int width_, int height_)
+        : width{width_}, height{height_}, key{std::move(key_)}, pixels{std::move(pixels_)}
+    {
+    }
+    ~CachedImage();
+    CachedImage(const CachedImage&) = delete;
+    CachedImage& operator=(const CachedImage&) = delete;
+
+    // Only call from the render thread, uploads the pixels if they're decoded by now
+    ID3D11ShaderResourceView* get_texture();
+    bool is_ready() const
+    {
+        return status.load(std::memory_order_acquire) == Status::UPLOADED;
+    }
+
+    const int width;
+    const int height;
+
+  private:
+    enum class Status : uint8_t
+    {
+        DECODED,
+        UPLOADED,
+        // The texture couldn't be created, draws a placeholder and is taken out of the cache so the next create tries again
+        FAILED,
+    };
+
+    std::atomic<Status> status{Status::DECODED};
+    const std::string key;
+    std::vector<uint8_t> pixels;
+    ID3D11ShaderResourceView* texture{nullptr};
+};
+
+// Decodes the image on the calling thread unless another backend already has it
+// Returns nullptr if the file isn't an image that can be decoded
+std::shared_ptr<CachedImage> acquire_cached_image(const std::string& path, int crop_x = 0, int crop_y = 0, int crop_w = 0, int crop_h = 0);
@@ -0,0 +1,274 @@
+#include "input_replay.hpp"
+
+#include <algorithm> // for upper_bound
+#include <cstring>   // for memcpy
+#include <fstream>   // for ifstream, ofstream
+#include <iterator>  // for istreambuf_iterator
+
+#include "heap_base.hpp"      // for HeapBase
+#include "logger.h"           // for DEBUG
+#include "rpc.hpp"            // for get_adventure_seed
+#include "savestate_ring.hpp" // for SaveStateRing
+#include "state.hpp"          // for StateMemory
+#include "state_structs.hpp"  // for PlayerInputs, PlayerSlot
+#include "turbo.hpp"          // for Turbo
+
+namespace
+{
+constexpr char g_magic[4] = {'O', 'L', 'I', 'R'};
+// 2 added the frame count in front of the runs
+constexpr uint32_t g_version = 2;
+// A day at 60 fps, a longer run is more likely a broken file than a replay
+constexpr uint32_t g_max_frames = 60 * 60 * 60 * 24;
+// Covers 20 minutes of keyframes with the default interval
+constexpr uint32_t g_max_keyframes = 120;
+constexpr uint8_t g_level_screen = 12;
+
+template <class T>
+void write_raw(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+template <class T>
+bool read_raw(const std::string& in, size_t& pos, T& value)
+{
+    if (in.size() - pos < sizeof(T))
+        return false;
+    std::memcpy(&value, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+} // namespace
+
+InputReplay& InputReplay::get()
+{
+    static InputReplay replay;
+    return replay;
+}
+InputReplay::InputReplay() = default;
+InputReplay::~InputReplay() = default;
+
+void InputReplay::record()
+{
+    stop();
+    mode = INPUT_REPLAY_MODE::RECORD_ARMED;
+    armed_screen_counter = HeapBase::get().state()->screen_change_counter;
+}
+
+bool InputReplay::save(const std::string& path)
+{
+    if (mode == INPUT_REPLAY_MODE::RECORDING || mode == INPUT_REPLAY_MODE::RECORD_ARMED)
+        mode = INPUT_REPLAY_MODE::NONE;
+    if (inputs.empty() || inputs.size() > g_max_frames)
+        return false;
+
+    // Runs of equal inputs as a frame count and the inputs, most frames repeat the previous ones
+    std::string out;
+    out.append(g_magic, sizeof(g_magic));
+    write_raw(out, g_version);
+    write_raw(out, header);
+    write_raw(out, static_cast<uint32_t>(inputs.size()));
+    for (size_t i = 0; i < inputs.size();)
+    {
+        size_t end = i + 1;
+        while (end < inputs.size() && inputs[end] == inputs[i])
+            end++;
+        write_raw(out, static_cast<uint32_t>(end - i));
+        write_raw(out, inputs[i]);
+        i = end;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(out.data(), out.size());
+    return file.good();
+}
+
+std::optional<InputReplayHeader> InputReplay::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return std::nullopt;
+    const std::string in{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    size_t pos = 0;
+    char magic[4];
+    uint32_t version;
+    InputReplayHeader read_header;
+    if (!read_raw(in, pos, magic) || std::memcmp(magic, g_magic, sizeof(g_magic)) != 0 || !read_raw(in, pos, version) || version != g_version || !read_raw(in, pos, read_header))
+        return std::nullopt;
+
+    // The runs have to add up to the frame count, so a broken or crafted file can't make us allocate more than that
+    uint32_t total_frames;
+    if (!read_raw(in, pos, total_frames) || total_frames > g_max_frames)
+        return std::nullopt;
+
+    std::vector<FrameInputs> read_inputs;
+    read_inputs.reserve(total_frames);
+    while (pos < in.size())
+    {
+        uint32_t count;
+        FrameInputs frame_inputs;
+        if (!read_raw(in, pos, count) || !read_raw(in, pos, frame_inputs))
+            return std::nullopt;
+        if (count == 0 || count > total_frames - read_inputs.size())
+            return std::nullopt;
+        read_inputs.insert(read_inputs.end(), count, frame_inputs);
+    }
+    if (read_inputs.size() != total_frames)
+        return std::nullopt;
+
+    stop();
+    header = read_header;
+    inputs = std::move(read_inputs);
+    mode = INPUT_REPLAY_MODE::REPLAY_ARMED;
+    armed_screen_counter = HeapBase::get().state()->screen_change_counter;
+    return header;
+}
+
+std::optional<InputReplayHeader> InputReplay::get_header() const
+{
+    if (mode == INPUT_REPLAY_MODE::RECORD_ARMED || (mode == INPUT_REPLAY_MODE::NONE && inputs.empty()))
+        return std::nullopt;
+    return header;
+}
+
+void InputReplay::stop()
+{
+    set_fast_forward(false);
+    seek_target.reset();
+    // The inputs are kept, so a recording can still be saved after stopping it
+    mode = INPUT_REPLAY_MODE::NONE;
+    frame = 0;
+    keyframes.reset();
+    keyframe_frames.clear();
+}
+
+void InputReplay::set_fast_forward(bool enable)
+{
+    if (enable == fast_forward)
+        return;
+    fast_forward = enable;
+    auto& turbo = Turbo::get();
+    if (enable)
+    {
+        loops_before_fast_forward = turbo.get_loops_per_frame();
+        turbo.set(FAST_FORWARD_LOOPS);
+    }
+    else
+    {
+        turbo.set(loops_before_fast_forward);
+    }
+}
+
+bool InputReplay::seek(uint32_t target)
+{
+    if (mode != INPUT_REPLAY_MODE::REPLAYING || target >= inputs.size())
+        return false;
+
+    if (target < frame)
+    {
+        // Keyframe frames are ascending, take the last one at or before the target
+        auto it = std::upper_bound(keyframe_frames.begin(), keyframe_frames.end(), target);
+        if (it == keyframe_frames.begin())
+            return false;
+        --it;
+        const auto index = static_cast<uint32_t>(it - keyframe_frames.begin());
+        if (!keyframes->load(static_cast<uint32_t>(keyframe_frames.size()) - 1 - index))
+            return false;
+        frame = *it;
+        // The loaded keyframe stays in the ring, the newer ones were dropped
+        keyframe_frames.resize(index + 1);
+    }
+    if (target > frame)
+    {
+        seek_target = target;
+        set_fast_forward(true);
+    }
+    return true;
+}
+
+void InputReplay::start(StateMemory* state)
+{
+    frame = 0;
+    if (mode == INPUT_REPLAY_MODE::RECORD_ARMED)
+    {
+        const auto [seed_first, seed_second] = get_adventure_seed(true);
+        header.seed_first = seed_first;
+        header.seed_second = seed_second;
+        header.seed = state->seed;
+        header.world_start = state->world_start;
+        header.level_start = state->level_start;
+        header.theme_start = static_cast<uint8_t>(state->theme_start);
+        header.seeded = (static_cast<uint32_t>(state->quest_flags) & 0x40) != 0;
+        inputs.clear();
+        mode = INPUT_REPLAY_MODE::RECORDING;
+    }
+    else
+    {
+        keyframes = std::make_unique<SaveStateRing>(g_max_keyframes, std::nullopt);
+        keyframe_frames.clear();
+        mode = INPUT_REPLAY_MODE::REPLAYING;
+    }
+}
+
+void InputReplay::push_keyframe()
+{
+    // The ring drops the oldest states once it's full, so does the list
+    if (keyframe_frames.size() == g_max_keyframes)
+        keyframe_frames.erase(keyframe_frames.begin());
+    keyframes->push();
+    keyframe_frames.push_back(frame);
+}
+
+void InputReplay::on_process_input(StateMemory* state)
+{
+    if (mode == INPUT_REPLAY_MODE::NONE)
+        return;
+
+    if (mode == INPUT_REPLAY_MODE::RECORD_ARMED || mode == INPUT_REPLAY_MODE::REPLAY_ARMED)
+    {
+        if (state->screen != g_level_screen || state->screen_change_counter == armed_screen_counter)
+            return;
+        start(state);
+    }
+
+    auto& slots = state->player_inputs->player_slots;
+    static_assert(std::tuple_size_v<FrameInputs> == MAX_PLAYERS * 2);
+    if (mode == INPUT_REPLAY_MODE::RECORDING)
+    {
+        FrameInputs& frame_inputs = inputs.emplace_back();
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            frame_inputs[i * 2] = slots[i].buttons_gameplay;
+            frame_inputs[i * 2 + 1] = slots[i].buttons;
+        }
+        frame++;
+        return;
+    }
+
+    if (frame >= inputs.size())
+    {
+        DEBUG("Input replay finished after {} frames", frame);
+        set_fast_forward(false);
+        seek_target.reset();
+        mode = INPUT_REPLAY_MODE::NONE;
+        return;
+    }
+    // Keyframes are taken before the inputs of their frame are applied, so loading one continues with the same frame
+    if (frame % KEYFRAME_INTERVAL == 0 && (keyframe_frames.empty() || keyframe_frames.back() < frame))
+        push_keyframe();
+
+    const FrameInputs& frame_inputs = inputs[frame];
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        slots[i].buttons_gameplay = frame_inputs[i * 2];
+        slots[i].buttons = frame_inputs[i * 2 + 1];
+    }
+    frame++;
+
+    if (seek_target.has_value() && frame >= seek_target.value())
+    {
+        seek_target.reset();
+        set_fast_forward(false);
+    }
+}
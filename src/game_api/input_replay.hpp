@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>    // for array
+#include <cstdint>  // for uint32_t, uint16_t, int64_t, uint8_t
+#include <memory>   // for unique_ptr
+#include <optional> // for optional
+#include <string>   // for string
+#include <vector>   // for vector
+
+#include "aliases.hpp" // for INPUTS
+
+struct StateMemory;
+class SaveStateRing;
+
+// What a replay needs to start the same run again, apply it by restarting the run with this seed before the replay starts
+struct InputReplayHeader
+{
+    // Adventure seed at the start of the run, see get_adventure_seed
+    int64_t seed_first;
+    int64_t seed_second;
+    // Seed of a seeded run, `seeded` tells which kind of run it was
+    uint32_t seed;
+    uint8_t world_start;
+    uint8_t level_start;
+    uint8_t theme_start;
+    bool seeded;
+};
+
+enum class INPUT_REPLAY_MODE
+{
+    NONE,
+    // Waiting for the next level to start
+    RECORD_ARMED,
+    RECORDING,
+    REPLAY_ARMED,
+    REPLAYING,
+};
+
+// Records the inputs of all the players once per processed input into a run length encoded stream and feeds them back again later
+// Both start with the first input of the next level, so the caller restarts the run right after arming either one
+class InputReplay
+{
+  public:
+    // Frames between the SaveStates kept while replaying, which is what seeking backwards starts from
+    static constexpr uint32_t KEYFRAME_INTERVAL = 600;
+    // Turbo game loops per presented frame while fast forwarding
+    static constexpr uint32_t FAST_FORWARD_LOOPS = 20;
+
+    static InputReplay& get();
+
+    void record();
+    // Stops recording and writes the stream, false if there is nothing recorded or the file can't be written
+    bool save(const std::string& path);
+    // Reads a stream written by `save` and arms the replay, nullopt if it's not a valid stream
+    std::optional<InputReplayHeader> load(const std::string& path);
+    // The header of the current recording or replay
+    std::optional<InputReplayHeader> get_header() const;
+    void stop();
+
+    INPUT_REPLAY_MODE get_mode() const
+    {
+        return mode;
+    }
+    // Frames recorded or replayed so far
+    uint32_t get_frame() const
+    {
+        return frame;
+    }
+    // Frames in the loaded replay
+    uint32_t get_length() const
+    {
+        return static_cast<uint32_t>(inputs.size());
+    }
+
+    void set_fast_forward(bool enable);
+    bool is_fast_forwarding() const
+    {
+        return fast_forward;
+    }
+    // Fast forwards to `target` while replaying, starting from the closest keyframe if it's behind the current frame, false if not replaying or out of range
+    bool seek(uint32_t target);
+
+    // Called from the process_input hook after the game read the devices, records the inputs or replaces them
+    void on_process_input(StateMemory* state);
+
+  private:
+    InputReplay();
+    ~InputReplay();
+
+    // buttons_gameplay and buttons of each player slot
+    using FrameInputs = std::array<INPUTS, 8>;
+
+    void start(StateMemory* state);
+    void push_keyframe();
+
+    INPUT_REPLAY_MODE mode{INPUT_REPLAY_MODE::NONE};
+    InputReplayHeader header{};
+    std::vector<FrameInputs> inputs;
+    uint32_t frame{0};
+    uint16_t armed_screen_counter{0};
+
+    bool fast_forward{false};
+    uint32_t loops_before_fast_forward{1};
+    std::optional<uint32_t> seek_target;
+
+    std::unique_ptr<SaveStateRing> keyframes;
+    std::vector<uint32_t> keyframe_frames;
+};
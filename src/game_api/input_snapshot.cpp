@@ -0,0 +1,125 @@
+#include "input_snapshot.hpp"
+
+#include <imgui.h> // for GetIO, GetCurrentContext, ImGuiIO
+
+namespace
+{
+constexpr int g_key_ctrl = 0x100;
+constexpr int g_key_shift = 0x200;
+constexpr int g_key_alt = 0x800;
+} // namespace
+
+bool InputSnapshot::keydown(int64_t keycode) const
+{
+    const int chord = static_cast<int>(keycode);
+    const int vk = chord & 0xff;
+    if (!keys[vk])
+        return false;
+
+    // Same as NGui::modifierdown
+    int key = chord & 0x4ff;
+    if (key == VK_RMENU)
+    {
+        if (shift)
+            key |= g_key_shift;
+        return chord == key;
+    }
+    if (ctrl && key != VK_LCONTROL && key != VK_RCONTROL)
+        key |= g_key_ctrl;
+    if (shift && key != VK_LSHIFT && key != VK_RSHIFT)
+        key |= g_key_shift;
+    if (alt && key != VK_MENU && key != VK_RMENU)
+        key |= g_key_alt;
+    return chord == key;
+}
+
+InputSnapshots& InputSnapshots::get()
+{
+    static InputSnapshots snapshots;
+    return snapshots;
+}
+
+InputSnapshots::InputSnapshots()
+{
+    const char* xinput_dll_names[]{
+        "xinput1_4.dll",   // Windows 8+
+        "xinput1_3.dll",   // DirectX SDK
+        "xinput9_1_0.dll", // Windows Vista, Windows 7
+        "xinput1_2.dll",   // DirectX SDK
+        "xinput1_1.dll"    // DirectX SDK
+    };
+    for (const char* dll_name : xinput_dll_names)
+    {
+        if (HMODULE dll = LoadLibraryA(dll_name))
+        {
+            get_state = (XInputGetStateFun*)GetProcAddress(dll, "XInputGetState");
+            break;
+        }
+    }
+}
+
+void InputSnapshots::capture(uint64_t frame)
+{
+    // Only this thread writes, it can read the previous snapshot without the sequence
+    const uint64_t index = count.load(std::memory_order_relaxed);
+    const InputSnapshot& previous = history[(index + HISTORY - 1) % HISTORY].snapshot;
+    Slot& slot = history[index % HISTORY];
+    slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    InputSnapshot& snapshot = slot.snapshot;
+    snapshot.frame = frame;
+
+    for (DWORD i = 0; i < XUSER_MAX_COUNT; ++i)
+    {
+        Gamepad& gamepad = snapshot.gamepads[i];
+        if (!previous.gamepads[i].enabled && frame < next_poll[i])
+        {
+            gamepad = Gamepad{};
+            continue;
+        }
+        XINPUT_STATE state;
+        if (get_state != nullptr && get_state(i, &state) == ERROR_SUCCESS)
+        {
+            gamepad = {state.Gamepad, true};
+        }
+        else
+        {
+            gamepad = Gamepad{};
+            next_poll[i] = frame + RECONNECT_INTERVAL;
+        }
+    }
+
+    // The ImGui context only exists once the window was hooked
+    if (ImGui::GetCurrentContext() != nullptr)
+    {
+        const ImGuiIO& io = ImGui::GetIO();
+        for (size_t i = 0; i < snapshot.keys.size(); ++i)
+            snapshot.keys[i] = io.KeysDown[i];
+        snapshot.ctrl = io.KeyCtrl;
+        snapshot.shift = io.KeyShift;
+        snapshot.alt = io.KeyAlt;
+    }
+    slot.sequence.store(index * 2 + 2, std::memory_order_release);
+    count.store(index + 1, std::memory_order_release);
+}
+
+std::optional<InputSnapshot> InputSnapshots::at(uint32_t frames_back) const
+{
+    while (true)
+    {
+        const uint64_t written = count.load(std::memory_order_acquire);
+        if (frames_back >= HISTORY || frames_back >= written)
+            return std::nullopt;
+        const uint64_t index = written - 1 - frames_back;
+        const Slot& slot = history[index % HISTORY];
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != index * 2 + 2)
+            continue;
+        InputSnapshot snapshot = slot.snapshot;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Overwritten while copying, the writer went around the whole history, try again with the newer count
+        if (slot.sequence.load(std::memory_order_relaxed) == before)
+            return snapshot;
+    }
+}
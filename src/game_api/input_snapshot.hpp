@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Windows.h> // for DWORD
+#include <array>     // for array
+#include <atomic>    // for atomic
+#include <bitset>    // for bitset
+#include <cstdint>   // for uint32_t, uint64_t
+#include <optional>  // for optional
+#include <xinput.h>  // for XINPUT_GAMEPAD, XUSER_MAX_COUNT
+
+struct Gamepad : XINPUT_GAMEPAD
+{
+    /*
+    GAMEPAD wButtons; // just for the autodoc
+    */
+    bool enabled;
+};
+
+/// The gamepads and keyboard of one frame, taken once per frame before the game processes its input, see [get_input_snapshot](#get_input_snapshot)
+struct InputSnapshot
+{
+    /// Same as [get_global_update_count](#get_global_update_count) when this was taken
+    uint64_t frame{0};
+    std::array<Gamepad, XUSER_MAX_COUNT> gamepads{};
+    // Indexed by the virtual keycode
+    std::bitset<256> keys;
+    bool ctrl{false};
+    bool shift{false};
+    bool alt{false};
+
+    /// XInput index 1..4, a disabled Gamepad for anything else or if it's not connected
+    Gamepad get_gamepad(uint32_t index) const
+    {
+        return index >= 1 && index <= gamepads.size() ? gamepads[index - 1] : Gamepad{};
+    }
+    /// Whether a key or chord like `KEY.OL_MOD_CTRL | KEY.X` was down, with the same rules for the modifiers as ImGuiIO:keydown, doesn't know the mouse buttons
+    bool keydown(int64_t keycode) const;
+};
+
+// Polls XInput and copies the keyboard state once per ProcessInput, every input API reads from the last snapshot
+// Disconnected gamepads are only polled again every RECONNECT_INTERVAL frames, XInputGetState is slow for them
+// Captured on the game thread and read from the gui thread too, so the readers get copies that are checked against a seqlock
+class InputSnapshots
+{
+  public:
+    static constexpr uint32_t HISTORY = 64;
+    static constexpr uint32_t RECONNECT_INTERVAL = 60;
+
+    static InputSnapshots& get();
+
+    void capture(uint64_t frame);
+    // 0 is the last snapshot, nullopt if there are fewer snapshots than that
+    std::optional<InputSnapshot> at(uint32_t frames_back) const;
+    InputSnapshot current() const
+    {
+        return at(0).value_or(InputSnapshot{});
+    }
+
+  private:
+    InputSnapshots();
+
+    using XInputGetStateFun = DWORD WINAPI(DWORD, XINPUT_STATE*);
+    XInputGetStateFun* get_state{nullptr};
+    std::array<uint64_t, XUSER_MAX_COUNT> next_poll{};
+
+    struct Slot
+    {
+        // Odd while the slot is being written
+        std::atomic<uint64_t> sequence{0};
+        InputSnapshot snapshot;
+    };
+    std::array<Slot, HISTORY> history{};
+    std::atomic<uint64_t> count{0};
+};
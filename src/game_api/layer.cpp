@@ -9,6 +9,7 @@
 #include "entity.hpp"          // for Entity, to_id, EntityDB, entity_factory
 #include "logger.h"            // for DEBUG
 #include "movable.hpp"         // for Movable
+#include "navigation.hpp"      // for NavigationGrid
 #include "rpc.hpp"             // for update_liquid_collision_at
 #include "search.hpp"          // for get_address
 #include "state.hpp"           // for StateMemory, API
@@ -210,11 +211,15 @@ void Layer::move_grid_entity(Entity* ent, uint32_t x, uint32_t y, Layer* dest_la
         if (current_grid_x < g_level_max_x && current_grid_y < g_level_max_y)
         {
             if (grid_entities[current_grid_y][current_grid_x] == ent)
+            {
                 grid_entities[current_grid_y][current_grid_x] = nullptr;
+                NavigationGrid::get().on_grid_cell_changed(this, current_grid_x, current_grid_y);
+            }
         }
         if (x < g_level_max_x && y < g_level_max_y)
         {
             dest_layer->grid_entities[y][x] = ent;
+            NavigationGrid::get().on_grid_cell_changed(dest_layer, x, y);
         }
         for (auto item_ent : ent->items.entities())
         {
@@ -246,6 +251,7 @@ void Layer::destroy_grid_entity(Entity* ent)
             if (grid_entities[current_grid_y][current_grid_x] == ent)
             {
                 grid_entities[current_grid_y][current_grid_x] = nullptr;
+                NavigationGrid::get().on_grid_cell_changed(this, current_grid_x, current_grid_y);
                 update_liquid_collision_at(pos.x, pos.y, false);
             }
         }
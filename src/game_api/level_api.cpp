@@ -1,9 +1,10 @@
 #include "level_api.hpp"
 
 #include <Windows.h>     // for memchr, GetCurrentThread, LONG, NO_...
+#include <algorithm>     // for find_if
 #include <array>         // for array, _Array_iterator, _Array_cons...
 #include <assert.h>      // for assert
-#include <cmath>         // for ceil, abs
+#include <cmath>         // for ceil, abs, lround
 #include <cstddef>       // for byte
 #include <cstdlib>       // for size_t, abs
 #include <cstring>       // for memcpy, memchr
@@ -14,18 +15,22 @@
 #include <memory>        // for unique_ptr, make_unique
 #include <mutex>         // for lock_guard, mutex
 #include <numbers>       // for pi_v
+#include <numeric>       // for iota
 #include <string_view>   // for string_view
 #include <tuple>         // for tie, tuple
 #include <unordered_map> // for unordered_map, _Umap_traits<>::allo...
 
 #include "bucket.hpp"                // for Bucket
+#include "detour_transaction.hpp"    // for hook_transaction_begin, hook_transaction_commit
 #include "entities_activefloors.hpp" //
 #include "entities_items.hpp"        //
 #include "entities_monsters.hpp"     // for GHOST_BEHAVIOR, GHOST_BEHAVIOR::MED...
 #include "entity.hpp"                // for Entity, get_entity_ptr, Enti...
 #include "entity_db.hpp"             // for to_id
-#include "entity_lookup.hpp"         // for get_entities_overlapping_by_pointer ...
+#include "entity_lookup.hpp"         // for get_entities_overlapping_by_pointer, EntityCounter
 #include "layer.hpp"                 // for Layer, g_level_max_y, g_level_max_x
+#include "level_file_cache.hpp"      // for load_level_file_cached
+#include "level_gen_stats.hpp"       // for LevelGenPhaseScope, LEVEL_GEN_PHASE
 #include "logger.h"                  // for DEBUG
 #include "memory.hpp"                // for to_le_bytes, write_mem_prot, Execut...
 #include "movable.hpp"               // for Movable
@@ -51,6 +56,62 @@ std::unordered_map<std::string_view, std::uint32_t> g_name_to_tile_code_id;
 std::unordered_map<std::uint32_t, std::string_view> g_monster_chance_id_to_name;
 std::unordered_map<std::uint32_t, std::string_view> g_trap_chance_id_to_name;
 
+// Spawns waiting for a tile to be handled, grouped by the tile they are waiting for so that handling a tile only looks at its own cell
+template <class T>
+struct PendingTileSpawns
+{
+    std::vector<T> entries;
+    std::unordered_map<std::uint64_t, std::vector<size_t>> by_cell;
+
+    // Pending positions are always on the tile grid, rounding them gives the tile they are on
+    static std::uint64_t cell_key(float x, float y)
+    {
+        const auto ix = static_cast<std::uint32_t>(std::lround(x));
+        const auto iy = static_cast<std::uint32_t>(std::lround(y));
+        return static_cast<std::uint64_t>(ix) << 32 | iy;
+    }
+
+    bool empty() const
+    {
+        return entries.empty();
+    }
+    void push_back(T entry)
+    {
+        for (const auto& pos : entry.pos)
+        {
+            std::vector<size_t>& indices = by_cell[cell_key(pos.x, pos.y)];
+            if (indices.empty() || indices.back() != entries.size())
+                indices.push_back(entries.size());
+        }
+        entries.push_back(std::move(entry));
+    }
+    // Returns a copy, handling a pending spawn may add new ones
+    std::vector<size_t> find(float x, float y) const
+    {
+        auto it = by_cell.find(cell_key(x, y));
+        return it != by_cell.end() ? it->second : std::vector<size_t>{};
+    }
+    // Drops entries that don't need to wait anymore, done once per room instead of after every tile
+    template <class FunT>
+    void compact(FunT&& is_done)
+    {
+        if (std::erase_if(entries, is_done) == 0)
+            return;
+
+        std::vector<T> remaining = std::move(entries);
+        clear();
+        for (T& entry : remaining)
+        {
+            push_back(std::move(entry));
+        }
+    }
+    void clear()
+    {
+        entries.clear();
+        by_cell.clear();
+    }
+};
+
 struct FloorRequiringEntity
 {
     struct Position
@@ -63,7 +124,7 @@ struct FloorRequiringEntity
     std::int32_t uid;
     bool handled;
 };
-std::vector<FloorRequiringEntity> g_floor_requiring_entities;
+PendingTileSpawns<FloorRequiringEntity> g_floor_requiring_entities;
 struct PendingEntitySpawn
 {
     struct Position
@@ -76,7 +137,7 @@ struct PendingEntitySpawn
     std::function<void()> try_spawn;
     bool handled;
 };
-std::vector<PendingEntitySpawn> g_attachee_requiring_entities;
+PendingTileSpawns<PendingEntitySpawn> g_attachee_requiring_entities;
 
 struct CommunityTileCode;
 
@@ -737,6 +798,25 @@ std::unordered_map<std::string_view, std::string_view> g_community_tile_code_ali
     {"spikes_upsidedown", "upsidedown_spikes"},
 };
 
+// Id of the tile code each tile code id is handled as, so handling a tile doesn't need to look up any names
+std::vector<std::uint32_t> g_tile_code_alias_of;
+void update_tile_code_aliases()
+{
+    const size_t old_size = g_tile_code_alias_of.size();
+    g_tile_code_alias_of.resize(std::max<size_t>(g_current_tile_code_id, old_size));
+    std::iota(g_tile_code_alias_of.begin() + old_size, g_tile_code_alias_of.end(), static_cast<std::uint32_t>(old_size));
+
+    for (auto& [tile_code_name, tile_code_alias_name] : g_community_tile_code_aliases)
+    {
+        auto tile_code = g_name_to_tile_code_id.find(tile_code_name);
+        auto tile_code_alias = g_name_to_tile_code_id.find(tile_code_alias_name);
+        if (tile_code != g_name_to_tile_code_id.end() && tile_code_alias != g_name_to_tile_code_id.end() && tile_code->second < g_tile_code_alias_of.size())
+        {
+            g_tile_code_alias_of[tile_code->second] = tile_code_alias->second;
+        }
+    }
+}
+
 struct ChanceLogicProviderImpl
 {
     std::uint32_t id;
@@ -819,12 +899,19 @@ using LevelGenFun = void(LevelGenSystem*, float, size_t);
 LevelGenFun* g_level_gen_trampoline{nullptr};
 void level_gen(LevelGenSystem* level_gen_sys, float param_2, size_t param_3)
 {
+    LevelGenStats::get().reset();
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::LEVEL_GEN};
+
     push_spawn_type_flags(SPAWN_TYPE_LEVEL_GEN_GENERAL);
     OnScopeExit pop{[]
                     { pop_spawn_type_flags(SPAWN_TYPE_LEVEL_GEN_GENERAL); }};
 
     g_manual_room_datas.clear();
 
+    // Whatever is still waiting belongs to the previous level
+    g_floor_requiring_entities.clear();
+    g_attachee_requiring_entities.clear();
+
     g_CustomRoomShims[0] = {};
     g_CustomRoomShims[1] = {};
 
@@ -870,6 +957,7 @@ void unload_layer(Layer* layer)
     if (pre_unload_layer((LAYER)layer->is_back_layer))
         return;
     g_unload_layer_trampoline(layer);
+    EntityCounter::get().invalidate();
     post_unload_layer((LAYER)layer->is_back_layer);
     if (layer->is_back_layer)
         post_event(ON::POST_LEVEL_DESTRUCTION);
@@ -883,6 +971,7 @@ void load_layer(Layer* layer)
         pre_init_level();
     pre_init_layer((LAYER)layer->is_back_layer);
     g_init_layer_trampoline(layer);
+    EntityCounter::get().invalidate();
     post_init_layer((LAYER)layer->is_back_layer);
     if (layer->is_back_layer)
         post_event(ON::POST_LEVEL_CREATION);
@@ -892,25 +981,24 @@ using HandleTileCodeFun = void(LevelGenSystem*, std::uint32_t, std::uint64_t, fl
 HandleTileCodeFun* g_handle_tile_code_trampoline{nullptr};
 void handle_tile_code(LevelGenSystem* self, std::uint32_t tile_code, std::uint16_t room_template, float x, float y, std::uint8_t layer)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::HANDLE_TILE_CODE};
     push_spawn_type_flags(SPAWN_TYPE_LEVEL_GEN_TILE_CODE);
     OnScopeExit pop{[]
                     { pop_spawn_type_flags(SPAWN_TYPE_LEVEL_GEN_TILE_CODE); }};
 
-    std::string_view tile_code_name = g_tile_code_id_to_name[tile_code];
+    const std::uint32_t original_tile_code = tile_code;
 
     {
-        const bool block_spawn = pre_tile_code_spawn(tile_code_name, x, y, layer, room_template);
+        const bool block_spawn = pre_tile_code_spawn(original_tile_code, x, y, layer, room_template);
         if (block_spawn)
         {
             tile_code = g_last_tile_code_id;
         }
     }
 
-    if (g_community_tile_code_aliases.find(tile_code_name) != g_community_tile_code_aliases.end())
+    if (tile_code < g_tile_code_alias_of.size())
     {
-        std::string_view tile_code_alias_name = g_community_tile_code_aliases[tile_code_name];
-        std::uint32_t tile_code_alias = g_name_to_tile_code_id[tile_code_alias_name];
-        tile_code = tile_code_alias;
+        tile_code = g_tile_code_alias_of[tile_code];
     }
 
     if (tile_code > g_last_tile_code_id && tile_code < g_last_community_tile_code_id)
@@ -938,60 +1026,59 @@ void handle_tile_code(LevelGenSystem* self, std::uint32_t tile_code, std::uint16
         }
     }
 
-    post_tile_code_spawn(tile_code_name, x, y, layer, room_template);
+    post_tile_code_spawn(original_tile_code, x, y, layer, room_template);
 
     if (!g_floor_requiring_entities.empty())
     {
         Entity* floor{nullptr};
         auto state = HeapBase::get().state();
-        for (auto& pending_entity : g_floor_requiring_entities)
+        const std::uint64_t cell = g_floor_requiring_entities.cell_key(x, y);
+        for (size_t index : g_floor_requiring_entities.find(x, y))
         {
-            for (const auto& pos : pending_entity.pos)
+            // Attaching can run callbacks that add more pending entities, so nothing is kept pointing into the entries across it
+            const auto& pending_entity = g_floor_requiring_entities.entries[index];
+            if (pending_entity.handled)
+                continue;
+
+            auto pos = std::find_if(pending_entity.pos.begin(), pending_entity.pos.end(), [cell](const FloorRequiringEntity::Position& pending_pos)
+                                    { return g_floor_requiring_entities.cell_key(pending_pos.x, pending_pos.y) == cell; });
+            if (pos == pending_entity.pos.end())
+                continue;
+
+            const std::optional<float> angle = pos->angle;
+            if (auto* entity = get_entity_ptr(pending_entity.uid))
             {
-                if (std::abs(pos.x - x) < 0.01f && std::abs(pos.y - y) < 0.01f)
+                if (floor == nullptr)
                 {
-                    if (auto* entity = get_entity_ptr(pending_entity.uid))
-                    {
-                        if (floor == nullptr)
-                        {
-                            floor = state->layers[layer]->get_grid_entity_at(x, y);
-                        }
+                    floor = state->layers[layer]->get_grid_entity_at(x, y);
+                }
 
-                        if (floor != nullptr)
-                        {
-                            attach_entity(floor, entity);
-                            if (pos.angle)
-                            {
-                                entity->angle = pos.angle.value();
-                            }
-                            pending_entity.handled = true;
-                            break;
-                        }
+                if (floor != nullptr)
+                {
+                    attach_entity(floor, entity);
+                    if (angle)
+                    {
+                        entity->angle = angle.value();
                     }
+                    g_floor_requiring_entities.entries[index].handled = true;
                 }
             }
         }
-
-        std::erase_if(g_floor_requiring_entities, [](const FloorRequiringEntity& ent)
-                      { return ent.handled || get_entity_ptr(ent.uid) == nullptr; });
     }
 
     if (!g_attachee_requiring_entities.empty())
     {
-        for (auto& pending_spawn : g_attachee_requiring_entities)
+        for (size_t index : g_attachee_requiring_entities.find(x, y))
         {
-            for (const auto& pos : pending_spawn.pos)
-            {
-                if (std::abs(pos.x - x) < 0.01f && std::abs(pos.y - y) < 0.01f)
-                {
-                    pending_spawn.try_spawn();
-                    pending_spawn.handled = true;
-                }
-            }
-        }
+            auto& pending_spawn = g_attachee_requiring_entities.entries[index];
+            if (pending_spawn.handled)
+                continue;
 
-        std::erase_if(g_attachee_requiring_entities, [](const PendingEntitySpawn& ent)
-                      { return ent.handled; });
+            // Spawning may add more pending spawns and move the entries, so the function is taken out and the entry is done before it runs
+            std::function<void()> try_spawn = std::move(pending_spawn.try_spawn);
+            pending_spawn.handled = true;
+            try_spawn();
+        }
     }
 }
 
@@ -1074,7 +1161,7 @@ void load_level_file(LevelGenData* level_gen_data, const char* level_file_name)
     {
         for (const std::string& level_file : g_levels_to_load)
         {
-            g_load_level_file_trampoline(level_gen_data, level_file.c_str());
+            load_level_file_cached(level_gen_data, level_file.c_str(), g_load_level_file_trampoline);
         }
         g_levels_to_load.clear();
     }
@@ -1089,6 +1176,7 @@ using DoExtraSpawns = void(ThemeInfo*, std::uint32_t, std::uint32_t, std::uint32
 DoExtraSpawns* g_do_extra_spawns_trampoline{nullptr};
 void do_extra_spawns(ThemeInfo* theme, std::uint32_t border_size, std::uint32_t level_width, std::uint32_t level_height, std::uint8_t layer)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::DO_EXTRA_SPAWNS};
     g_do_extra_spawns_trampoline(theme, border_size, level_width, level_height, layer);
 
     std::lock_guard lock{g_extra_spawn_logic_providers_lock};
@@ -1139,6 +1227,7 @@ using GenerateRoom = void(LevelGenSystem*, int32_t, int32_t);
 GenerateRoom* g_generate_room_trampoline{nullptr};
 void generate_room(LevelGenSystem* level_gen, int32_t room_idx_x, int32_t room_idx_y)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::GENERATE_ROOM};
     const int32_t flat_room_idx = room_idx_x + room_idx_y * 8;
 
     const uint16_t room_templates[2]{
@@ -1185,6 +1274,7 @@ using GatherRoomData = void(LevelGenData*, byte, int room_x, int, bool, uint8_t*
 GatherRoomData* g_gather_room_data_trampoline{nullptr};
 void gather_room_data(LevelGenData* tile_storage, byte param_2, int room_idx_x, int room_idx_y, bool hard_level, uint8_t* param_6, uint8_t* param_7, size_t param_8, uint8_t* param_9, uint8_t* param_10, uint8_t* out_room_width, uint8_t* out_room_height)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::GATHER_ROOM_DATA};
     const auto* level_gen = HeapBase::get().level_gen();
     for (size_t j = 0; j < 2; j++)
     {
@@ -1201,6 +1291,7 @@ using GetRandomRoomData = RoomData*(LevelGenData*, uint16_t, bool, bool, bool, i
 GetRandomRoomData* g_get_random_room_data_trampoline{nullptr};
 RoomData* get_random_room_data(LevelGenData* tile_storage, uint16_t room_template, bool hard_level, bool can_not_have, uint8_t layer, int room_idx_x, int room_idx_y)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::GET_RANDOM_ROOM_DATA};
     std::string room_override = pre_get_random_room(room_idx_x, room_idx_y, layer, room_template);
     if (!room_override.empty())
     {
@@ -1231,6 +1322,7 @@ using SpawnRoomFromTileCodes = void(LevelGenData*, int, int, SingleRoomData*, Si
 SpawnRoomFromTileCodes* g_spawn_room_from_tile_codes_trampoline{nullptr};
 void spawn_room_from_tile_codes(LevelGenData* level_gen_data, int room_idx_x, int room_idx_y, SingleRoomData* front_room_data, SingleRoomData* back_room_data, uint16_t param_6, bool dual_room, uint16_t room_template)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::SPAWN_ROOM_FROM_TILE_CODES};
     auto level_gen = HeapBase::get().level_gen();
 
     std::optional<SHOP_TYPE> before[2];
@@ -1261,6 +1353,11 @@ void spawn_room_from_tile_codes(LevelGenData* level_gen_data, int room_idx_x, in
 
     g_spawn_room_from_tile_codes_trampoline(level_gen_data, room_idx_x, room_idx_y, front_room_data, back_room_data, param_6, dual_room, room_template);
 
+    g_floor_requiring_entities.compact([](const FloorRequiringEntity& ent)
+                                       { return ent.handled || get_entity_ptr(ent.uid) == nullptr; });
+    g_attachee_requiring_entities.compact([](const PendingEntitySpawn& ent)
+                                          { return ent.handled; });
+
     for (size_t i = 0; i < 2; i++)
     {
         const std::optional<SHOP_TYPE> before_type = before[i];
@@ -1276,6 +1373,7 @@ TestChance* g_test_chance{nullptr};
 
 bool handle_chance(SpawnInfo* spawn_info)
 {
+    LevelGenPhaseScope phase_scope{LEVEL_GEN_PHASE::HANDLE_CHANCE};
 
     const uint8_t layer = 0; // only handles the front layer, backlayer is hardcoded
     auto* layer_ptr = HeapBase::get().state()->layer(layer);
@@ -1425,6 +1523,7 @@ void LevelGenData::init()
 
     // Remember this for fast access later
     g_last_community_tile_code_id = g_current_tile_code_id;
+    update_tile_code_aliases();
     g_last_community_chance_id = g_current_chance_id;
 
     {
@@ -1504,8 +1603,7 @@ void LevelGenData::init()
         g_unload_layer_trampoline = (UnloadLayerFun*)get_address("unload_layer"sv);
         g_init_layer_trampoline = (InitLayerFun*)get_address("init_layer"sv);
 
-        DetourTransactionBegin();
-        DetourUpdateThread(GetCurrentThread());
+        hook_transaction_begin();
 
         DetourAttach((void**)&g_level_gen_trampoline, level_gen);
         DetourAttach((void**)&g_handle_tile_code_trampoline, handle_tile_code);
@@ -1521,7 +1619,7 @@ void LevelGenData::init()
         DetourAttach((void**)&g_unload_layer_trampoline, unload_layer);
         DetourAttach((void**)&g_init_layer_trampoline, load_layer);
 
-        const LONG error = DetourTransactionCommit();
+        const LONG error = hook_transaction_commit();
         if (error != NO_ERROR)
         {
             DEBUG("Failed hooking LevelGenData stuff: {}\n", error);
@@ -1531,6 +1629,21 @@ void LevelGenData::init()
     g_test_chance = (TestChance*)get_address("level_gen_test_spawn_chance");
 }
 
+std::optional<std::uint32_t> find_tile_code_id(std::string_view tile_code)
+{
+    auto it = g_name_to_tile_code_id.find(tile_code);
+    if (it != g_name_to_tile_code_id.end())
+    {
+        return it->second;
+    }
+    return std::nullopt;
+}
+std::uint32_t get_tile_code_generation()
+{
+    // Ids are handed out in order and never reused, so the next id works as a generation
+    return g_current_tile_code_id;
+}
+
 std::uint32_t LevelGenData::define_tile_code(std::string tile_code)
 {
     if (auto existing = get_tile_code(tile_code))
@@ -1543,6 +1656,7 @@ std::uint32_t LevelGenData::define_tile_code(std::string tile_code)
 
     g_tile_code_id_to_name[it->second.id] = it->first;
     g_name_to_tile_code_id[it->first] = it->second.id;
+    update_tile_code_aliases();
     return it->second.id;
 }
 
@@ -2043,6 +2157,20 @@ bool position_is_valid(float x, float y, LAYER layer, POS_TYPE flags)
 {
     return g_PositionTestFunc(x, y, HeapBase::get().state()->layer(layer), flags);
 }
+std::function<bool(float, float, uint8_t)> make_position_is_valid(POS_TYPE flags)
+{
+    if (flags == POS_TYPE::DEFAULT)
+    {
+        return [](float x, float y, uint8_t layer)
+        {
+            return g_DefaultTestFunc(x, y, HeapBase::get().state()->layers[layer]);
+        };
+    }
+    return [flags](float x, float y, uint8_t layer)
+    {
+        return g_PositionTestFunc(x, y, HeapBase::get().state()->layers[layer], flags);
+    };
+}
 
 void override_next_levels(std::vector<std::string> next_levels)
 {
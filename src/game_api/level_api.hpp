@@ -607,6 +607,15 @@ struct LevelGenSystem
 
 bool default_spawn_is_valid(float x, float y, LAYER layer);
 bool position_is_valid(float x, float y, LAYER layer, POS_TYPE flags);
+// Same check as position_is_valid for use as SpawnLogicProvider::is_valid, runs entirely in native code
+std::function<bool(float, float, uint8_t)> make_position_is_valid(POS_TYPE flags);
+
+// Id of a defined tile code, nullopt if no tile code with that name is defined (yet)
+std::optional<std::uint32_t> find_tile_code_id(std::string_view tile_code);
+// Changes whenever a new tile code gets defined
+std::uint32_t get_tile_code_generation();
+
+LevelChanceDef& get_or_emplace_level_chance(game_unordered_map<std::uint32_t, LevelChanceDef>& level_chances, uint32_t chance_id);
 
 void override_next_levels(std::vector<std::string> next_levels);
 void add_next_levels(std::vector<std::string> next_levels);
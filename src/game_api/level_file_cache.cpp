@@ -0,0 +1,314 @@
+#include "level_file_cache.hpp"
+
+#include <algorithm>     // for equal
+#include <array>         // for array
+#include <cstdint>       // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstring>       // for memcpy
+#include <string>        // for string
+#include <string_view>   // for string_view
+#include <unordered_map> // for unordered_map
+#include <utility>       // for pair
+#include <vector>        // for vector
+
+#include <fmt/format.h> // for format
+
+#include "containers/game_allocator.hpp" // for game_malloc, game_free
+#include "crc32.hpp"                     // for crc32str
+#include "file_api.hpp"                  // for read_game_file, FileInfo
+#include "game_heap_stats.hpp"           // for GameHeapTag
+#include "level_api.hpp"                 // for LevelGenData, RoomData, get_or_emplace_level_chance
+#include "logger.h"                      // for DEBUG
+
+namespace
+{
+uint64_t mix(uint64_t seed, uint64_t value)
+{
+    // splitmix64 finalizer, good enough to tell apart level gen states
+    value += 0x9e3779b97f4a7c15ull + seed;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+size_t room_data_length(const RoomData& room_data)
+{
+    return static_cast<size_t>(room_data.room_width) * room_data.room_height * (room_data.dual ? 2 : 1);
+}
+
+// Everything a level file load can change, as it was before the load
+struct LevelGenDataSnapshot
+{
+    std::array<uint32_t, 17> level_config;
+    std::unordered_map<uint8_t, ShortTileCodeDef> short_tile_codes;
+    size_t num_tile_codes;
+    size_t num_room_templates;
+    size_t num_monster_chances;
+    size_t num_trap_chances;
+    std::unordered_map<uint16_t, size_t> room_template_data_sizes;
+    std::array<uint32_t, 429> unknown;
+    std::array<size_t, 8 * 15> set_room_data_sizes;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> level_monster_chances;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> level_trap_chances;
+
+    explicit LevelGenDataSnapshot(const LevelGenData& data)
+        : level_config{data.level_config}, num_tile_codes{data.tile_codes.size()}, num_room_templates{data.room_templates.size()}, num_monster_chances{data.monster_chances.size()}, num_trap_chances{data.trap_chances.size()}, unknown{data.unknown}
+    {
+        short_tile_codes.insert(data.short_tile_codes.begin(), data.short_tile_codes.end());
+        for (const auto& [room_template, template_data] : data.room_template_datas)
+        {
+            room_template_data_sizes[room_template] = template_data.datas.size();
+        }
+        for (size_t i = 0; i < data.set_room_datas.size(); i++)
+        {
+            set_room_data_sizes[i] = data.set_room_datas[i].datas.size();
+        }
+        for (const auto& [chance_id, chances] : data.level_monster_chances)
+        {
+            level_monster_chances[chance_id] = {chances.chances.begin(), chances.chances.end()};
+        }
+        for (const auto& [chance_id, chances] : data.level_trap_chances)
+        {
+            level_trap_chances[chance_id] = {chances.chances.begin(), chances.chances.end()};
+        }
+    }
+};
+
+struct CachedRoomData
+{
+    // Template id for room template datas, index for set room datas
+    uint16_t room_template;
+    bool set_room;
+    RoomData room_data;
+    uint32_t chars_offset;
+};
+struct CachedLevelChance
+{
+    uint32_t chance_id;
+    bool trap;
+    uint32_t values_offset;
+    uint32_t num_values;
+};
+
+// What a single load of a level file did to the level gen data, room strings and chance values are stored back to back
+struct CachedLevelFile
+{
+    std::vector<std::pair<uint8_t, uint32_t>> level_config;
+    std::vector<std::pair<uint8_t, ShortTileCodeDef>> short_tile_codes;
+    std::vector<uint8_t> removed_short_tile_codes;
+    std::vector<std::pair<uint16_t, uint32_t>> unknown;
+    std::vector<CachedRoomData> room_datas;
+    std::vector<char> room_data_chars;
+    std::vector<CachedLevelChance> level_chances;
+    std::vector<uint32_t> level_chance_values;
+};
+
+std::unordered_map<uint64_t, CachedLevelFile> g_level_file_cache;
+
+// Loading the same file twice only does the same thing if the data it is loaded into looks the same, so the state before the load is part of the key
+uint64_t level_gen_data_fingerprint(const LevelGenData& data)
+{
+    uint64_t hash = mix(0, data.tile_codes.size());
+    hash = mix(hash, data.room_templates.size());
+    hash = mix(hash, data.monster_chances.size());
+    hash = mix(hash, data.trap_chances.size());
+    for (uint32_t config : data.level_config)
+    {
+        hash = mix(hash, config);
+    }
+
+    // Unordered containers are combined order independently
+    uint64_t containers_hash = 0;
+    for (const auto& [short_tile_code, def] : data.short_tile_codes)
+    {
+        containers_hash += mix(short_tile_code, (uint64_t(def.tile_code) << 32) | (uint64_t(def.alt_tile_code) << 8) | def.chance);
+    }
+    for (const auto& [room_template, template_data] : data.room_template_datas)
+    {
+        containers_hash += mix(room_template | (1ull << 32), template_data.datas.size());
+    }
+    for (const auto& [chance_id, chances] : data.level_monster_chances)
+    {
+        uint64_t chance_hash = mix(chance_id | (2ull << 32), chances.chances.size());
+        for (uint32_t value : chances.chances)
+        {
+            chance_hash = mix(chance_hash, value);
+        }
+        containers_hash += chance_hash;
+    }
+    for (const auto& [chance_id, chances] : data.level_trap_chances)
+    {
+        uint64_t chance_hash = mix(chance_id | (3ull << 32), chances.chances.size());
+        for (uint32_t value : chances.chances)
+        {
+            chance_hash = mix(chance_hash, value);
+        }
+        containers_hash += chance_hash;
+    }
+    hash = mix(hash, containers_hash);
+
+    for (const RoomTemplateData& set_room_data : data.set_room_datas)
+    {
+        hash = mix(hash, set_room_data.datas.size());
+    }
+    return hash;
+}
+
+void store_room_data(CachedLevelFile& cached, uint16_t room_template, bool set_room, const RoomData& room_data)
+{
+    const size_t length = room_data_length(room_data);
+    CachedRoomData& cached_room = cached.room_datas.emplace_back(CachedRoomData{room_template, set_room, room_data, static_cast<uint32_t>(cached.room_data_chars.size())});
+    cached_room.room_data.room_data = nullptr;
+    cached.room_data_chars.insert(cached.room_data_chars.end(), room_data.room_data, room_data.room_data + length);
+}
+
+void store_level_chances(CachedLevelFile& cached, const game_unordered_map<std::uint32_t, LevelChanceDef>& level_chances, const std::unordered_map<uint32_t, std::vector<uint32_t>>& before, bool trap)
+{
+    for (const auto& [chance_id, chances] : level_chances)
+    {
+        auto it = before.find(chance_id);
+        if (it != before.end() && std::equal(it->second.begin(), it->second.end(), chances.chances.begin(), chances.chances.end()))
+            continue;
+
+        cached.level_chances.push_back({chance_id, trap, static_cast<uint32_t>(cached.level_chance_values.size()), static_cast<uint32_t>(chances.chances.size())});
+        cached.level_chance_values.insert(cached.level_chance_values.end(), chances.chances.begin(), chances.chances.end());
+    }
+}
+
+// Returns false if the load did something that can't be replayed
+bool store_level_file(CachedLevelFile& cached, const LevelGenData& data, const LevelGenDataSnapshot& before)
+{
+    if (data.tile_codes.size() != before.num_tile_codes || data.room_templates.size() != before.num_room_templates || data.monster_chances.size() != before.num_monster_chances || data.trap_chances.size() != before.num_trap_chances)
+        return false;
+
+    for (uint8_t i = 0; i < data.level_config.size(); i++)
+    {
+        if (data.level_config[i] != before.level_config[i])
+            cached.level_config.push_back({i, data.level_config[i]});
+    }
+
+    for (const auto& [short_tile_code, def] : data.short_tile_codes)
+    {
+        auto it = before.short_tile_codes.find(short_tile_code);
+        if (it == before.short_tile_codes.end() || it->second != def)
+            cached.short_tile_codes.push_back({short_tile_code, def});
+    }
+    for (const auto& [short_tile_code, def] : before.short_tile_codes)
+    {
+        if (!data.short_tile_codes.contains(short_tile_code))
+            cached.removed_short_tile_codes.push_back(short_tile_code);
+    }
+
+    for (uint16_t i = 0; i < data.unknown.size(); i++)
+    {
+        if (data.unknown[i] != before.unknown[i])
+            cached.unknown.push_back({i, data.unknown[i]});
+    }
+
+    for (const auto& [room_template, template_data] : data.room_template_datas)
+    {
+        auto it = before.room_template_data_sizes.find(room_template);
+        const size_t old_size = it != before.room_template_data_sizes.end() ? it->second : 0;
+        if (template_data.datas.size() < old_size)
+            return false;
+        for (size_t i = old_size; i < template_data.datas.size(); i++)
+        {
+            store_room_data(cached, room_template, false, template_data.datas[i]);
+        }
+    }
+    for (uint16_t i = 0; i < data.set_room_datas.size(); i++)
+    {
+        const auto& datas = data.set_room_datas[i].datas;
+        if (datas.size() < before.set_room_data_sizes[i])
+            return false;
+        for (size_t j = before.set_room_data_sizes[i]; j < datas.size(); j++)
+        {
+            store_room_data(cached, i, true, datas[j]);
+        }
+    }
+
+    store_level_chances(cached, data.level_monster_chances, before.level_monster_chances, false);
+    store_level_chances(cached, data.level_trap_chances, before.level_trap_chances, true);
+    return true;
+}
+
+void replay_level_file(const CachedLevelFile& cached, LevelGenData& data)
+{
+    for (auto [i, config] : cached.level_config)
+    {
+        data.level_config[i] = config;
+    }
+
+    for (uint8_t short_tile_code : cached.removed_short_tile_codes)
+    {
+        data.short_tile_codes.erase(short_tile_code);
+    }
+    for (const auto& [short_tile_code, def] : cached.short_tile_codes)
+    {
+        data.short_tile_codes[short_tile_code] = def;
+    }
+
+    for (auto [i, value] : cached.unknown)
+    {
+        data.unknown[i] = value;
+    }
+
+    for (const CachedRoomData& cached_room : cached.room_datas)
+    {
+        // We can't tell whether the game frees these together with the level gen data, so hand it memory it could free
+        const size_t length = room_data_length(cached_room.room_data);
+        GameHeapTag tag{"level files"};
+        char* room_chars = static_cast<char*>(game_malloc(length + 1));
+        std::memcpy(room_chars, cached.room_data_chars.data() + cached_room.chars_offset, length);
+        room_chars[length] = '\0';
+
+        RoomData room_data = cached_room.room_data;
+        room_data.room_data = room_chars;
+        auto& datas = cached_room.set_room ? data.set_room_datas[cached_room.room_template].datas : data.room_template_datas[cached_room.room_template].datas;
+        datas.push_back(room_data);
+    }
+
+    for (const CachedLevelChance& level_chance : cached.level_chances)
+    {
+        LevelChanceDef& chances = get_or_emplace_level_chance(level_chance.trap ? data.level_trap_chances : data.level_monster_chances, level_chance.chance_id);
+        const uint32_t* values = cached.level_chance_values.data() + level_chance.values_offset;
+        chances.chances.assign(values, values + level_chance.num_values);
+    }
+}
+} // namespace
+
+void load_level_file_cached(LevelGenData* level_gen_data, const char* level_file_name, LoadLevelFileFun* load_level_file)
+{
+    const std::string file_path = fmt::format("Data/Levels/{}", level_file_name);
+    FileInfo* file = read_game_file(file_path.c_str());
+    if (file == nullptr)
+    {
+        // Let the game deal with it, whatever it does with missing files
+        load_level_file(level_gen_data, level_file_name);
+        return;
+    }
+
+    const std::string_view content{static_cast<const char*>(file->Data), static_cast<size_t>(file->DataSize)};
+    uint64_t key = mix(crc32str(level_file_name), crc32str(content));
+    key = mix(key, content.size());
+    key = mix(key, level_gen_data_fingerprint(*level_gen_data));
+    game_free(file);
+
+    if (auto it = g_level_file_cache.find(key); it != g_level_file_cache.end())
+    {
+        replay_level_file(it->second, *level_gen_data);
+        return;
+    }
+
+    const LevelGenDataSnapshot before{*level_gen_data};
+    load_level_file(level_gen_data, level_file_name);
+
+    CachedLevelFile cached;
+    if (store_level_file(cached, *level_gen_data, before))
+    {
+        g_level_file_cache.emplace(key, std::move(cached));
+    }
+    else
+    {
+        DEBUG("Not caching level file {}, loading it changed more than can be replayed", level_file_name);
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+struct LevelGenData;
+
+using LoadLevelFileFun = void(LevelGenData*, const char*);
+
+// Loads a `.lvl` file through `load_level_file`, or replays what the game did last time the same file content was loaded on the same level gen data.
+// The replayed changes are room template datas, set room datas, short tile codes, level config and level chances.
+// Loads that define new tile codes, room templates or chances are never cached, so `define_tile_code` and friends stay authoritative for ids.
+void load_level_file_cached(LevelGenData* level_gen_data, const char* level_file_name, LoadLevelFileFun* load_level_file);
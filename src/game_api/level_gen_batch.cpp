@@ -0,0 +1,115 @@
+#include "level_gen_batch.hpp"
+
+#include <chrono>        // for steady_clock, duration
+#include <fmt/format.h>  // for format_to, format
+#include <fstream>       // for ofstream
+#include <iterator>      // for back_inserter
+#include <map>           // for map
+#include <optional>      // for optional
+#include <string_view>   // for string_view
+#include <unordered_map> // for unordered_map
+
+#include "entity.hpp"       // for Entity, EntityDB
+#include "entity_db.hpp"    // for to_name
+#include "heap_base.hpp"    // for HeapBase
+#include "layer.hpp"        // for Layer, EntityList
+#include "level_api.hpp"    // for LevelGenSystem, do_load_screen
+#include "rpc.hpp"          // for init_seeded
+#include "settings_api.hpp" // for get_setting, set_setting, GAME_SETTING
+#include "state.hpp"        // for StateMemory
+#include "util.hpp"         // for ON_SCOPE_EXIT
+
+struct LevelGenBatchResult
+{
+    double generation_ms;
+    uint32_t width;
+    uint32_t height;
+    std::vector<std::string_view> room_templates;
+    // Ordered so the output is stable between runs
+    std::map<std::string_view, uint32_t> entity_counts;
+    uint32_t total_entities;
+};
+
+LevelGenBatchResult generate_batch_level(const LevelGenBatchJob& job)
+{
+    auto* state = HeapBase::get().state();
+
+    init_seeded(job.seed);
+    state->warp(job.world, job.level, job.theme);
+
+    const auto start = std::chrono::steady_clock::now();
+    do_load_screen();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    LevelGenBatchResult result{elapsed.count(), state->w, state->h};
+
+    auto* level_gen = HeapBase::get().level_gen();
+    for (uint32_t y = 0; y < state->h; ++y)
+    {
+        for (uint32_t x = 0; x < state->w; ++x)
+        {
+            const uint16_t room_template = level_gen->rooms_frontlayer->rooms[x + y * 8];
+            result.room_templates.push_back(level_gen->get_room_template_name(room_template));
+        }
+    }
+
+    std::unordered_map<uint32_t, uint32_t> counts_by_type;
+    for (Layer* layer : state->layers)
+    {
+        for (Entity* entity : layer->all_entities.entities())
+        {
+            counts_by_type[entity->type->id]++;
+        }
+        result.total_entities += layer->all_entities.size;
+    }
+    for (auto [entity_type, count] : counts_by_type)
+    {
+        result.entity_counts[to_name(entity_type)] = count;
+    }
+
+    return result;
+}
+
+bool run_level_gen_batch(const std::vector<LevelGenBatchJob>& jobs, const std::string& out_path)
+{
+    auto* state = HeapBase::get().state();
+    if (state->screen < 11 || state->screen > 20)
+        return false;
+
+    std::ofstream out(out_path, std::ios::trunc);
+    if (!out)
+        return false;
+
+    // Levels are generated without giving the game a frame in between, but spawning still plays sounds
+    const std::optional<uint32_t> master_enabled = get_setting(GAME_SETTING::MASTER_ENABLED);
+    set_setting(GAME_SETTING::MASTER_ENABLED, 0);
+    ON_SCOPE_EXIT(set_setting(GAME_SETTING::MASTER_ENABLED, master_enabled.value_or(1)));
+
+    std::string json{"[\n"};
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const LevelGenBatchJob& job = jobs[i];
+        const LevelGenBatchResult result = generate_batch_level(job);
+
+        auto out_it = std::back_inserter(json);
+        fmt::format_to(out_it, "  {{\"seed\": \"{:08X}\", \"world\": {}, \"level\": {}, \"theme\": {}, \"generation_ms\": {:.3f}, \"width\": {}, \"height\": {}, ", job.seed, job.world, job.level, job.theme, result.generation_ms, result.width, result.height);
+
+        json += "\"room_templates\": [";
+        for (size_t j = 0; j < result.room_templates.size(); ++j)
+        {
+            fmt::format_to(out_it, "{}\"{}\"", j == 0 ? "" : ", ", result.room_templates[j]);
+        }
+        json += "], \"entities\": {";
+        bool first = true;
+        for (auto [entity_name, count] : result.entity_counts)
+        {
+            fmt::format_to(out_it, "{}\"{}\": {}", first ? "" : ", ", entity_name, count);
+            first = false;
+        }
+        fmt::format_to(out_it, "}}, \"total_entities\": {}}}{}\n", result.total_entities, i + 1 < jobs.size() ? "," : "");
+    }
+    json += "]\n";
+
+    out << json;
+    return static_cast<bool>(out);
+}
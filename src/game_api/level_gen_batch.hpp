@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint> // for uint32_t, uint8_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+struct LevelGenBatchJob
+{
+    uint32_t seed;
+    uint8_t world;
+    uint8_t level;
+    uint8_t theme;
+};
+
+// Generates the level of every job back to back within a single call, so no frame is rendered in between, with the game audio disabled.
+// Writes a json array with room templates, entity counts and generation time of each level to `out_path`.
+// Returns false if the game isn't on a screen that can load levels or the file can't be written.
+bool run_level_gen_batch(const std::vector<LevelGenBatchJob>& jobs, const std::string& out_path);
@@ -0,0 +1,120 @@
+#include "level_gen_stats.hpp"
+
+#include "frame_telemetry.hpp" // for FrameTelemetry
+
+namespace
+{
+const char* level_gen_phase_name(LEVEL_GEN_PHASE phase)
+{
+    switch (phase)
+    {
+    case LEVEL_GEN_PHASE::LEVEL_GEN:
+        return "level_gen";
+    case LEVEL_GEN_PHASE::GENERATE_ROOM:
+        return "generate_room";
+    case LEVEL_GEN_PHASE::GATHER_ROOM_DATA:
+        return "gather_room_data";
+    case LEVEL_GEN_PHASE::GET_RANDOM_ROOM_DATA:
+        return "get_random_room_data";
+    case LEVEL_GEN_PHASE::SPAWN_ROOM_FROM_TILE_CODES:
+        return "spawn_room_from_tile_codes";
+    case LEVEL_GEN_PHASE::HANDLE_TILE_CODE:
+        return "handle_tile_code";
+    case LEVEL_GEN_PHASE::DO_EXTRA_SPAWNS:
+        return "do_extra_spawns";
+    case LEVEL_GEN_PHASE::HANDLE_CHANCE:
+        return "handle_chance";
+    default:
+        return "unknown";
+    }
+}
+} // namespace
+
+LevelGenStats& LevelGenStats::get()
+{
+    static LevelGenStats stats;
+    return stats;
+}
+
+void LevelGenStats::reset()
+{
+    calls.fill(0);
+    total_ticks.fill(0);
+    callback_ticks.fill(0);
+}
+void LevelGenStats::begin_phase(LEVEL_GEN_PHASE phase)
+{
+    active[(size_t)phase]++;
+}
+void LevelGenStats::end_phase(LEVEL_GEN_PHASE phase, int64_t ticks)
+{
+    const size_t i = (size_t)phase;
+    if (--active[i] == 0)
+    {
+        total_ticks[i] += ticks;
+    }
+    calls[i]++;
+}
+void LevelGenStats::begin_callback()
+{
+    active_callbacks++;
+}
+void LevelGenStats::end_callback(int64_t ticks)
+{
+    if (--active_callbacks != 0)
+        return;
+
+    // Callbacks count towards every phase they ran in, same as the phase totals include nested phases
+    for (size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        if (active[i] != 0)
+            callback_ticks[i] += ticks;
+    }
+}
+
+std::vector<LevelGenPhaseStats> LevelGenStats::stats() const
+{
+    std::vector<LevelGenPhaseStats> result;
+    result.reserve(PHASE_COUNT);
+    for (size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        const float total_ms = FrameTelemetry::ticks_to_ms(total_ticks[i]);
+        const float callback_ms = FrameTelemetry::ticks_to_ms(callback_ticks[i]);
+        result.push_back({level_gen_phase_name((LEVEL_GEN_PHASE)i), calls[i], total_ms, callback_ms, total_ms - callback_ms});
+    }
+    return result;
+}
+
+LevelGenPhaseScope::LevelGenPhaseScope(LEVEL_GEN_PHASE phase_)
+    : phase{phase_}, timed{LevelGenStats::enabled}
+{
+    if (timed)
+    {
+        LevelGenStats::get().begin_phase(phase);
+        start = FrameTelemetry::now();
+    }
+}
+LevelGenPhaseScope::~LevelGenPhaseScope()
+{
+    if (timed)
+    {
+        LevelGenStats::get().end_phase(phase, FrameTelemetry::now() - start);
+    }
+}
+
+LevelGenCallbackScope::LevelGenCallbackScope()
+    : timed{LevelGenStats::enabled}
+{
+    if (timed)
+    {
+        LevelGenStats::get().begin_callback();
+        start = FrameTelemetry::now();
+    }
+}
+LevelGenCallbackScope::~LevelGenCallbackScope()
+{
+    if (timed)
+    {
+        LevelGenStats::get().end_callback(FrameTelemetry::now() - start);
+    }
+}
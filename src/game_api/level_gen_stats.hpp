@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>   // for array
+#include <cstddef> // for size_t
+#include <cstdint> // for uint32_t, int64_t, uint8_t
+#include <vector>  // for vector
+
+enum class LEVEL_GEN_PHASE : uint8_t
+{
+    LEVEL_GEN,
+    GENERATE_ROOM,
+    GATHER_ROOM_DATA,
+    GET_RANDOM_ROOM_DATA,
+    SPAWN_ROOM_FROM_TILE_CODES,
+    HANDLE_TILE_CODE,
+    DO_EXTRA_SPAWNS,
+    HANDLE_CHANCE,
+    COUNT,
+};
+
+struct LevelGenPhaseStats
+{
+    /// Name of the level generation function
+    const char* name;
+    /// How often the function ran
+    uint32_t calls;
+    /// Time spent in the function, including other phases it calls
+    float total_ms;
+    /// Part of `total_ms` spent in script callbacks
+    float callback_ms;
+    /// Part of `total_ms` spent in the game itself, `total_ms - callback_ms`
+    float vanilla_ms;
+};
+
+// Time spent in each hooked level generation function during the last level generation, split into script callbacks and the rest
+class LevelGenStats
+{
+  public:
+    static LevelGenStats& get();
+
+    void reset();
+    void begin_phase(LEVEL_GEN_PHASE phase);
+    void end_phase(LEVEL_GEN_PHASE phase, int64_t ticks);
+    void begin_callback();
+    void end_callback(int64_t ticks);
+
+    std::vector<LevelGenPhaseStats> stats() const;
+
+    inline static bool enabled{false};
+
+  private:
+    LevelGenStats() = default;
+
+    static constexpr size_t PHASE_COUNT = (size_t)LEVEL_GEN_PHASE::COUNT;
+    std::array<uint32_t, PHASE_COUNT> calls{};
+    std::array<int64_t, PHASE_COUNT> total_ticks{};
+    std::array<int64_t, PHASE_COUNT> callback_ticks{};
+    // How many calls of each phase are on the stack right now, to not count recursive calls twice
+    std::array<uint32_t, PHASE_COUNT> active{};
+    uint32_t active_callbacks{0};
+};
+
+class LevelGenPhaseScope
+{
+  public:
+    LevelGenPhaseScope(LEVEL_GEN_PHASE phase_);
+    ~LevelGenPhaseScope();
+
+  private:
+    LEVEL_GEN_PHASE phase;
+    int64_t start{0};
+    bool timed;
+};
+
+// Put around script callbacks, they are only counted while inside a level generation phase
+class LevelGenCallbackScope
+{
+  public:
+    LevelGenCallbackScope();
+    ~LevelGenCallbackScope();
+
+  private:
+    int64_t start{0};
+    bool timed;
+};
@@ -0,0 +1,90 @@
+#include "liquid_budget.hpp"
+
+#include <algorithm> // for min
+
+#include "frame_telemetry.hpp" // for FrameTelemetry::ticks_to_ms
+#include "liquid_engine.hpp"   // for LiquidPhysics, LiquidPhysicsEngine
+#include "state.hpp"           // for StateMemory
+
+namespace
+{
+// Weight of the newest update in the average, so a single slow update (like a level load) doesn't start skipping
+constexpr float g_average_weight = 0.1f;
+// Skipping is relaxed again once the average is this far below the budget, so it doesn't flip every other frame
+constexpr float g_relax_ratio = 0.75f;
+// Skipping lowers the average only after a while, so the skip level is changed at most this often
+constexpr uint32_t g_adjust_interval = 30;
+} // namespace
+
+LiquidBudget& LiquidBudget::get()
+{
+    static LiquidBudget budget;
+    return budget;
+}
+
+void LiquidBudget::set_budget(float update_ms, uint32_t max_skip_)
+{
+    budget_ms = update_ms;
+    max_skip = max_skip_;
+    last_stats.skip_level = 0;
+    last_stats.skipped_updates = 0;
+    last_stats.average_update_ms = 0.0f;
+    skip_counter = 0;
+    updates_since_adjust = 0;
+}
+
+void LiquidBudget::before_update(StateMemory* state)
+{
+    paused_by_budget.fill({});
+    if (budget_ms <= 0.0f || last_stats.skip_level == 0 || state->liquid_physics == nullptr)
+        return;
+
+    // With skip level N the simulation runs on one update out of N + 1
+    skip_counter = (skip_counter + 1) % (last_stats.skip_level + 1);
+    if (skip_counter == 0)
+        return;
+
+    for (size_t i = 0; i < paused_by_budget.size(); ++i)
+    {
+        LiquidPhysicsEngine* engine = state->liquid_physics->pools[i].physics_engine;
+        // Engines paused by a script stay paused and are left alone
+        if (engine != nullptr && !engine->pause_physics)
+        {
+            paused_by_budget[i] = {engine, engine->pause_physics};
+            engine->pause_physics = true;
+        }
+    }
+    last_stats.skipped_updates++;
+}
+
+void LiquidBudget::after_update(StateMemory* state, int64_t update_ticks)
+{
+    LiquidStats& stats = last_stats;
+    stats.total_count = 0;
+    for (size_t i = 0; i < stats.engines.size(); ++i)
+    {
+        LiquidPhysicsEngine* engine = state->liquid_physics != nullptr ? state->liquid_physics->pools[i].physics_engine : nullptr;
+        if (engine == nullptr)
+        {
+            stats.engines[i] = {};
+            continue;
+        }
+        // The update can replace the engines (level change), a new engine at the same index isn't ours to unpause
+        if (paused_by_budget[i].engine == engine)
+            engine->pause_physics = paused_by_budget[i].pause_physics;
+        stats.engines[i] = {engine->entity_count, engine->allocated_size, engine->pause_physics};
+        stats.total_count += engine->entity_count;
+    }
+    paused_by_budget.fill({});
+
+    stats.update_ms = FrameTelemetry::ticks_to_ms(update_ticks);
+    stats.average_update_ms += (stats.update_ms - stats.average_update_ms) * g_average_weight;
+
+    if (budget_ms <= 0.0f || ++updates_since_adjust < g_adjust_interval)
+        return;
+    updates_since_adjust = 0;
+    if (stats.average_update_ms > budget_ms && stats.total_count > 0)
+        stats.skip_level = std::min(stats.skip_level + 1, max_skip);
+    else if (stats.average_update_ms < budget_ms * g_relax_ratio && stats.skip_level > 0)
+        stats.skip_level--;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>   // for array
+#include <cstddef> // for size_t
+#include <cstdint> // for uint32_t, int64_t
+
+struct StateMemory;
+struct LiquidPhysicsEngine;
+
+struct LiquidEngineStats
+{
+    /// Number of blobs the engine simulates
+    uint32_t count{0};
+    /// Number of blobs the engine has room for before it has to grow its arrays
+    uint32_t allocated{0};
+    bool paused{false};
+};
+
+/// Liquid simulation statistics of the last update, see [get_liquid_stats](#get_liquid_stats)
+struct LiquidStats
+{
+    /// Water, coarse water, lava, coarse lava and stagnant lava, same order as `LiquidPhysics.pools`
+    std::array<LiquidEngineStats, 5> engines;
+    uint32_t total_count{0};
+    /// Time the whole game update took, the liquid engines are a part of it
+    float update_ms{0.0f};
+    /// Moving average of `update_ms` that the budget is compared against
+    float average_update_ms{0.0f};
+    /// How many updates in a row the simulation is currently skipped for, 0 while within the budget
+    uint32_t skip_level{0};
+    /// Updates the simulation was skipped for since the budget was set
+    uint32_t skipped_updates{0};
+};
+
+// Samples the liquid engines around every game update and, when a budget is set, skips the liquid simulation on some updates while the update is too slow
+// The game's liquid step itself isn't hooked, skipping is done through the engines' own pause flag, which is restored right after the update
+class LiquidBudget
+{
+  public:
+    static LiquidBudget& get();
+
+    // 0 or less turns the budget off, either way the skipping starts over
+    void set_budget(float update_ms, uint32_t max_skip);
+
+    // Called around the original state update
+    void before_update(StateMemory* state);
+    void after_update(StateMemory* state, int64_t update_ticks);
+
+    const LiquidStats& stats() const
+    {
+        return last_stats;
+    }
+
+  private:
+    LiquidBudget() = default;
+
+    LiquidStats last_stats;
+    float budget_ms{0.0f};
+    uint32_t max_skip{0};
+    uint32_t skip_counter{0};
+    uint32_t updates_since_adjust{0};
+    // Engines that were paused by us for the current update, with the flag they had, restored only on the same engine
+    struct PausedEngine
+    {
+        LiquidPhysicsEngine* engine{nullptr};
+        bool pause_physics{false};
+    };
+    std::array<PausedEngine, 5> paused_by_budget{};
+};
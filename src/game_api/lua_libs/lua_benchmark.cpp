@@ -0,0 +1,101 @@
+#include "lua_libs.hpp"
+
+#include <Windows.h>    // for QueryPerformanceCounter, QueryPerformanceFrequency
+#include <algorithm>    // for sort, min, max
+#include <cstdint>      // for uint32_t, int64_t
+#include <fmt/format.h> // for format
+#include <lua.h>        // for lua_gc, LUA_GCCOLLECT, LUA_GCSTOP, LUA_GCRESTART
+#include <optional>     // for optional
+#include <sol/sol.hpp>  // for state, this_state, protected_function, table
+#include <stdexcept>    // for runtime_error
+#include <string>       // for string
+#include <vector>       // for vector
+
+namespace
+{
+// Calls per run, the collector is stopped for a run so it's never timed and then does a full collection before the next one
+constexpr uint32_t RUN_SIZE = 1000;
+
+int64_t qpc()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+int64_t lua_allocated_bytes(lua_State* L)
+{
+    return (int64_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+sol::table benchmark(sol::this_state L, std::string name, sol::protected_function fn, std::optional<uint32_t> iterations_opt)
+{
+    lua_State* state = L;
+    const uint32_t iterations = std::max(iterations_opt.value_or(10000), 1u);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double ticks_to_us = 1'000'000.0 / (double)frequency.QuadPart;
+
+    const auto call = [&]()
+    {
+        auto result = fn();
+        if (!result.valid())
+        {
+            lua_gc(state, LUA_GCRESTART, 0);
+            sol::error err = result;
+            throw std::runtime_error(fmt::format("benchmark '{}' failed: {}", name, err.what()));
+        }
+    };
+
+    // Warm up the caches before measuring
+    for (uint32_t i = 0; i < std::max(iterations / 10, 1u); ++i)
+        call();
+
+    std::vector<double> latencies;
+    latencies.reserve(iterations);
+    int64_t allocated = 0;
+    double total_us = 0.0;
+    for (uint32_t done = 0; done < iterations;)
+    {
+        const uint32_t run_size = std::min(RUN_SIZE, iterations - done);
+        lua_gc(state, LUA_GCCOLLECT, 0);
+        lua_gc(state, LUA_GCSTOP, 0);
+        const int64_t allocated_before = lua_allocated_bytes(state);
+        for (uint32_t i = 0; i < run_size; ++i)
+        {
+            const int64_t start = qpc();
+            call();
+            const double us = (double)(qpc() - start) * ticks_to_us;
+            total_us += us;
+            latencies.push_back(us);
+        }
+        allocated += lua_allocated_bytes(state) - allocated_before;
+        lua_gc(state, LUA_GCRESTART, 0);
+        done += run_size;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double p)
+    { return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+
+    sol::state_view lua{state};
+    sol::table result = lua.create_table();
+    result["name"] = name;
+    result["iterations"] = iterations;
+    result["median_us"] = percentile(0.5);
+    result["p99_us"] = percentile(0.99);
+    result["max_us"] = latencies.back();
+    result["ops_per_sec"] = total_us > 0.0 ? iterations / total_us * 1'000'000.0 : 0.0;
+    result["alloc_bytes_per_call"] = (double)allocated / iterations;
+    lua["print"](fmt::format("{}: median {:.3f}us, p99 {:.3f}us, {:.0f} ops/s, {:.1f} bytes allocated per call", name, percentile(0.5), percentile(0.99), result.get<double>("ops_per_sec"), (double)allocated / iterations));
+    return result;
+}
+} // namespace
+
+void require_benchmark_lua(sol::state& lua)
+{
+    /// Calls `fn` `iterations` times (10000 by default) after a short warm up and prints and returns the median and p99 time of one call in microseconds,
+    /// the calls per second and the bytes `fn` allocated per call. The garbage collector doesn't run while the calls are timed, it does a full collection every 1000 calls instead
+    lua["benchmark"] = &benchmark;
+}
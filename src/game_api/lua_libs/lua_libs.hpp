@@ -9,3 +9,7 @@ void require_json_lua(sol::state& lua);
 void require_inspect_lua(sol::state& lua);
 void require_format_lua(sol::state& lua);
 void require_serpent_lua(sol::state& lua);
+// Defined in lua_pack.cpp
+void require_binser_lua(sol::state& lua);
+// Defined in lua_benchmark.cpp
+void require_benchmark_lua(sol::state& lua);
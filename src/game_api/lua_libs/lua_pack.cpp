@@ -0,0 +1,521 @@
+#include "lua_pack.hpp"
+
+#include <algorithm>     // for min
+#include <cstdint>       // for uint8_t, uint32_t, uint64_t, int64_t
+#include <cstring>       // for memcpy
+#include <lauxlib.h>     // for luaL_error, luaL_checklstring
+#include <lua.h>         // for lua_State, lua_type, lua_next
+#include <optional>      // for optional
+#include <sol/sol.hpp>   // for state, create_table_with
+#include <stdexcept>     // for runtime_error
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+
+#include "lua_libs.hpp" // for require_binser_lua
+
+namespace
+{
+// Layout: MAGIC, flags, then either the value or the uncompressed size and the compressed value
+constexpr char MAGIC = 'L';
+constexpr uint8_t FLAG_COMPRESSED = 1;
+
+enum class Tag : uint8_t
+{
+    Nil,
+    False,
+    True,
+    Integer,
+    Number,
+    String,
+    // Varint array size, that many values, then key value pairs ended by Nil
+    Table,
+    // Index of a table that was already seen
+    TableRef,
+    // Index of a string that was already seen, only longer strings get an index
+    StringRef,
+};
+constexpr size_t MIN_INTERNED_STRING = 4;
+constexpr int MAX_DEPTH = 200;
+
+void write_varint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+struct Reader
+{
+    const uint8_t* pos;
+    const uint8_t* end;
+
+    void need(size_t size) const
+    {
+        if (static_cast<size_t>(end - pos) < size)
+            throw std::runtime_error("packed data is truncated");
+    }
+    uint8_t byte()
+    {
+        need(1);
+        return *pos++;
+    }
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return value;
+        }
+        throw std::runtime_error("packed data is corrupt");
+    }
+};
+
+class Packer
+{
+  public:
+    Packer(lua_State* L)
+        : L{L}
+    {
+    }
+
+    void pack(int index, int depth)
+    {
+        switch (lua_type(L, index))
+        {
+        case LUA_TNIL:
+            put(Tag::Nil);
+            break;
+        case LUA_TBOOLEAN:
+            put(lua_toboolean(L, index) ? Tag::True : Tag::False);
+            break;
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, index))
+            {
+                const int64_t value = lua_tointeger(L, index);
+                put(Tag::Integer);
+                // Zigzag, so small negative numbers stay short
+                write_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+            }
+            else
+            {
+                const double value = lua_tonumber(L, index);
+                put(Tag::Number);
+                char bytes[sizeof(double)];
+                std::memcpy(bytes, &value, sizeof(double));
+                out.append(bytes, sizeof(double));
+            }
+            break;
+        case LUA_TSTRING:
+        {
+            size_t size;
+            const char* str = lua_tolstring(L, index, &size);
+            const std::string_view view{str, size};
+            if (size >= MIN_INTERNED_STRING)
+            {
+                // The views point into strings that are reachable from the packed value, so they outlive the packer
+                auto [it, inserted] = strings.try_emplace(view, static_cast<uint32_t>(strings.size()));
+                if (!inserted)
+                {
+                    put(Tag::StringRef);
+                    write_varint(out, it->second);
+                    break;
+                }
+            }
+            put(Tag::String);
+            write_varint(out, size);
+            out.append(view);
+            break;
+        }
+        case LUA_TTABLE:
+            pack_table(index, depth);
+            break;
+        default:
+            throw std::runtime_error(std::string{"can't pack a "} + lua_typename(L, lua_type(L, index)));
+        }
+    }
+
+    std::string out;
+
+  private:
+    void put(Tag tag)
+    {
+        out.push_back(static_cast<char>(tag));
+    }
+
+    void pack_table(int index, int depth)
+    {
+        const void* table = lua_topointer(L, index);
+        auto [it, inserted] = tables.try_emplace(table, static_cast<uint32_t>(tables.size()));
+        if (!inserted)
+        {
+            put(Tag::TableRef);
+            write_varint(out, it->second);
+            return;
+        }
+        if (depth >= MAX_DEPTH)
+            throw std::runtime_error("table is nested too deep to pack");
+        if (!lua_checkstack(L, 4))
+            throw std::runtime_error("table is nested too deep to pack");
+
+        index = lua_absindex(L, index);
+        const lua_Integer array_size = static_cast<lua_Integer>(lua_rawlen(L, index));
+        put(Tag::Table);
+        write_varint(out, static_cast<uint64_t>(array_size));
+        for (lua_Integer i = 1; i <= array_size; ++i)
+        {
+            lua_rawgeti(L, index, i);
+            pack(-1, depth + 1);
+            lua_pop(L, 1);
+        }
+
+        lua_pushnil(L);
+        while (lua_next(L, index) != 0)
+        {
+            // Stack is now key, value
+            if (lua_isinteger(L, -2))
+            {
+                const lua_Integer key = lua_tointeger(L, -2);
+                if (key >= 1 && key <= array_size)
+                {
+                    lua_pop(L, 1);
+                    continue;
+                }
+            }
+            pack(-2, depth + 1);
+            pack(-1, depth + 1);
+            lua_pop(L, 1);
+        }
+        put(Tag::Nil);
+    }
+
+    lua_State* L;
+    std::unordered_map<const void*, uint32_t> tables;
+    std::unordered_map<std::string_view, uint32_t> strings;
+};
+
+class Unpacker
+{
+  public:
+    Unpacker(lua_State* L, Reader reader, int refs)
+        : reader{reader}, L{L}, refs{refs}
+    {
+    }
+
+    void unpack(int depth)
+    {
+        if (!lua_checkstack(L, 4))
+            throw std::runtime_error("packed data is nested too deep");
+
+        switch (static_cast<Tag>(reader.byte()))
+        {
+        case Tag::Nil:
+            lua_pushnil(L);
+            break;
+        case Tag::False:
+            lua_pushboolean(L, false);
+            break;
+        case Tag::True:
+            lua_pushboolean(L, true);
+            break;
+        case Tag::Integer:
+        {
+            const uint64_t zigzag = reader.varint();
+            lua_pushinteger(L, static_cast<lua_Integer>((zigzag >> 1) ^ (~(zigzag & 1) + 1)));
+            break;
+        }
+        case Tag::Number:
+        {
+            double value;
+            reader.need(sizeof(double));
+            std::memcpy(&value, reader.pos, sizeof(double));
+            reader.pos += sizeof(double);
+            lua_pushnumber(L, value);
+            break;
+        }
+        case Tag::String:
+        {
+            const uint64_t size = reader.varint();
+            reader.need(size);
+            lua_pushlstring(L, reinterpret_cast<const char*>(reader.pos), size);
+            reader.pos += size;
+            if (size >= MIN_INTERNED_STRING)
+            {
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, refs + 1, ++num_strings);
+            }
+            break;
+        }
+        case Tag::StringRef:
+            unpack_ref(refs + 1, num_strings);
+            break;
+        case Tag::TableRef:
+            unpack_ref(refs, num_tables);
+            break;
+        case Tag::Table:
+            unpack_table(depth);
+            break;
+        default:
+            throw std::runtime_error("packed data is corrupt");
+        }
+    }
+
+    Reader reader;
+
+  private:
+    void unpack_ref(int list, lua_Integer count)
+    {
+        const uint64_t ref = reader.varint();
+        if (ref >= static_cast<uint64_t>(count))
+            throw std::runtime_error("packed data is corrupt");
+        lua_rawgeti(L, list, static_cast<lua_Integer>(ref) + 1);
+    }
+
+    void unpack_table(int depth)
+    {
+        if (depth >= MAX_DEPTH)
+            throw std::runtime_error("packed data is nested too deep");
+
+        const uint64_t array_size = reader.varint();
+        // Every value takes at least a byte, stops bogus sizes from allocating huge tables
+        reader.need(array_size);
+        lua_createtable(L, static_cast<int>(array_size), 0);
+        const int table = lua_gettop(L);
+        lua_pushvalue(L, table);
+        lua_rawseti(L, refs, ++num_tables);
+
+        for (uint64_t i = 1; i <= array_size; ++i)
+        {
+            unpack(depth + 1);
+            lua_rawseti(L, table, static_cast<lua_Integer>(i));
+        }
+        while (true)
+        {
+            unpack(depth + 1);
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+                break;
+            }
+            unpack(depth + 1);
+            if (lua_type(L, -2) == LUA_TNUMBER && lua_tonumber(L, -2) != lua_tonumber(L, -2))
+                throw std::runtime_error("packed data is corrupt");
+            lua_rawset(L, table);
+        }
+    }
+
+    lua_State* L;
+    // Stack index of the list of tables, the list of strings is right after it
+    int refs;
+    lua_Integer num_tables{0};
+    lua_Integer num_strings{0};
+};
+
+// Byte oriented LZ77, sequences of varint literal count, literals, varint distance and varint match length - MIN_MATCH, the last one has no match
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t HASH_BITS = 14;
+
+uint32_t hash4(const uint8_t* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+std::string compress(std::string_view input)
+{
+    std::string out;
+    out.reserve(input.size() / 2);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(input.data());
+    const size_t size = input.size();
+    std::vector<uint32_t> table(size_t{1} << HASH_BITS, UINT32_MAX);
+
+    size_t literal_start = 0;
+    size_t pos = 0;
+    while (pos + MIN_MATCH <= size)
+    {
+        const uint32_t hash = hash4(data + pos);
+        const uint32_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(pos);
+        if (candidate == UINT32_MAX || std::memcmp(data + candidate, data + pos, MIN_MATCH) != 0)
+        {
+            pos++;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (pos + length < size && data[candidate + length] == data[pos + length])
+            length++;
+
+        write_varint(out, pos - literal_start);
+        out.append(input.substr(literal_start, pos - literal_start));
+        write_varint(out, pos - candidate);
+        write_varint(out, length - MIN_MATCH);
+        pos += length;
+        literal_start = pos;
+    }
+    write_varint(out, size - literal_start);
+    out.append(input.substr(literal_start));
+    return out;
+}
+
+std::string decompress(std::string_view input, uint64_t size)
+{
+    Reader reader{reinterpret_cast<const uint8_t*>(input.data()), reinterpret_cast<const uint8_t*>(input.data() + input.size())};
+    std::string out;
+    // The size is only trusted up to a sane ratio, it grows past that if the data really is that repetitive
+    out.reserve(static_cast<size_t>(std::min<uint64_t>(size, input.size() * 16)));
+    while (true)
+    {
+        const uint64_t literals = reader.varint();
+        reader.need(literals);
+        if (out.size() + literals > size)
+            throw std::runtime_error("packed data is corrupt");
+        out.append(reinterpret_cast<const char*>(reader.pos), literals);
+        reader.pos += literals;
+        if (reader.pos == reader.end)
+            break;
+
+        const uint64_t distance = reader.varint();
+        const uint64_t length = reader.varint() + MIN_MATCH;
+        if (distance == 0 || distance > out.size() || out.size() + length > size)
+            throw std::runtime_error("packed data is corrupt");
+        // Matches can overlap what they produce, so copied byte by byte
+        size_t from = out.size() - distance;
+        for (uint64_t i = 0; i < length; ++i)
+            out.push_back(out[from + i]);
+    }
+    if (out.size() != size)
+        throw std::runtime_error("packed data is corrupt");
+    return out;
+}
+
+int binser_pack(lua_State* L)
+{
+    luaL_checkany(L, 1);
+    const bool compress = lua_toboolean(L, 2);
+    std::optional<std::string> packed;
+    std::string error;
+    try
+    {
+        packed = pack_lua_value(L, 1, compress);
+    }
+    catch (const std::runtime_error& err)
+    {
+        error = err.what();
+    }
+    if (!packed)
+    {
+        lua_pushlstring(L, error.data(), error.size());
+        // Nothing that needs destruction is left in this frame
+        error = std::string{};
+        return lua_error(L);
+    }
+    lua_pushlstring(L, packed->data(), packed->size());
+    return 1;
+}
+int binser_unpack(lua_State* L)
+{
+    size_t size;
+    const char* data = luaL_checklstring(L, 1, &size);
+    bool ok = true;
+    std::string error;
+    try
+    {
+        unpack_lua_value(L, {data, size});
+    }
+    catch (const std::runtime_error& err)
+    {
+        ok = false;
+        error = err.what();
+    }
+    if (!ok)
+    {
+        lua_pushlstring(L, error.data(), error.size());
+        error = std::string{};
+        return lua_error(L);
+    }
+    return 1;
+}
+} // namespace
+
+std::string pack_lua_value(lua_State* L, int index, bool compress)
+{
+    const int top = lua_gettop(L);
+    index = lua_absindex(L, index);
+    Packer packer{L};
+    packer.out.push_back(MAGIC);
+    packer.out.push_back(0);
+    try
+    {
+        packer.pack(index, 0);
+    }
+    catch (...)
+    {
+        lua_settop(L, top);
+        throw;
+    }
+    if (!compress)
+        return std::move(packer.out);
+
+    const std::string_view value = std::string_view{packer.out}.substr(2);
+    std::string compressed;
+    compressed.push_back(MAGIC);
+    compressed.push_back(static_cast<char>(FLAG_COMPRESSED));
+    write_varint(compressed, value.size());
+    compressed.append(::compress(value));
+    return compressed.size() < packer.out.size() ? compressed : std::move(packer.out);
+}
+
+void unpack_lua_value(lua_State* L, std::string_view data)
+{
+    const int top = lua_gettop(L);
+    if (data.size() < 2 || data[0] != MAGIC || (static_cast<uint8_t>(data[1]) & ~FLAG_COMPRESSED) != 0)
+        throw std::runtime_error("not packed data");
+
+    std::string decompressed;
+    if (static_cast<uint8_t>(data[1]) & FLAG_COMPRESSED)
+    {
+        Reader header{reinterpret_cast<const uint8_t*>(data.data() + 2), reinterpret_cast<const uint8_t*>(data.data() + data.size())};
+        const uint64_t size = header.varint();
+        decompressed = decompress(data.substr(reinterpret_cast<const char*>(header.pos) - data.data()), size);
+        data = decompressed;
+    }
+    else
+    {
+        data.remove_prefix(2);
+    }
+
+    if (!lua_checkstack(L, 8))
+        throw std::runtime_error("packed data is nested too deep");
+    lua_newtable(L);
+    lua_newtable(L);
+    Unpacker unpacker{L, {reinterpret_cast<const uint8_t*>(data.data()), reinterpret_cast<const uint8_t*>(data.data() + data.size())}, top + 1};
+    try
+    {
+        unpacker.unpack(0);
+        if (unpacker.reader.pos != unpacker.reader.end)
+            throw std::runtime_error("packed data has trailing bytes");
+    }
+    catch (...)
+    {
+        lua_settop(L, top);
+        throw;
+    }
+    // Drops the ref lists below the value
+    lua_replace(L, top + 1);
+    lua_settop(L, top + 1);
+}
+
+void require_binser_lua(sol::state& lua)
+{
+    /// Native binary serializer for Lua values, a lot faster and smaller than `json` or `serpent` for big tables in save data or network messages
+    /// `binser.pack(value, compress)` returns a binary string, tables referenced multiple times or from themselves are kept as such, metatables are not
+    /// `binser.unpack(data)` returns the value, errors on data that wasn't made by `binser.pack`
+    lua["binser"] = lua.create_table_with("pack", &binser_pack, "unpack", &binser_unpack);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>      // for string
+#include <string_view> // for string_view
+
+struct lua_State;
+
+// Compact binary encoding of Lua values, much faster to produce and read than json or serpent output
+// Supports nil, booleans, numbers, strings and tables of those, also tables referenced more than once or from themselves, metatables are not kept
+// Both throw std::runtime_error on values that can't be packed or data that isn't valid
+
+// Packs the value at `index`, `compress` runs a fast LZ pass over the result and keeps it if it's smaller
+std::string pack_lua_value(lua_State* L, int index, bool compress = false);
+// Pushes the unpacked value, leaves the stack as it was on error
+void unpack_lua_value(lua_State* L, std::string_view data);
@@ -0,0 +1,52 @@
+#include "mapped_file.hpp"
+
+#include <Windows.h>  // for CreateFileW, CreateFileMappingW, MapViewOfFile
+#include <filesystem> // for path
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path)
+{
+    HANDLE file = CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || static_cast<unsigned long long>(file_size.QuadPart) > SIZE_MAX)
+    {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> mapped{new MappedFile()};
+    mapped->file = file;
+    // Zero length files can't be mapped
+    if (file_size.QuadPart == 0)
+        return mapped;
+
+    mapped->mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapped->mapping == nullptr)
+        return nullptr;
+    mapped->data = static_cast<const char*>(MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (mapped->data == nullptr)
+        return nullptr;
+    mapped->length = static_cast<size_t>(file_size.QuadPart);
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::close()
+{
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    if (file != nullptr)
+        CloseHandle(file);
+    data = nullptr;
+    mapping = nullptr;
+    file = nullptr;
+    length = 0;
+}
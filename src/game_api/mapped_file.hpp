@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <memory>      // for shared_ptr
+#include <string>      // for string
+#include <string_view> // for string_view
+
+// Read only view of a whole file, mapped into memory instead of being read, so only the pages that are touched are loaded
+class MappedFile
+{
+  public:
+    // nullptr if the file can't be opened or mapped, an empty file maps to an empty view
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // Empty once closed
+    std::string_view view() const
+    {
+        return {data, length};
+    }
+    size_t size() const
+    {
+        return length;
+    }
+    bool is_open() const
+    {
+        return file != nullptr;
+    }
+    // Unmaps the file and releases the handle, so it can be written or removed again before the object is collected
+    void close();
+
+  private:
+    MappedFile() = default;
+
+    void* file{nullptr};
+    void* mapping{nullptr};
+    const char* data{nullptr};
+    size_t length{0};
+};
@@ -0,0 +1,132 @@
+#include "math_batch.hpp"
+
+#include <cmath>       // for sin, cos
+#include <xmmintrin.h> // for _mm_loadu_ps, _MM_TRANSPOSE4_PS, _mm_movemask_ps
+
+static_assert(sizeof(AABB) == sizeof(float) * 4);
+static_assert(sizeof(Quad) == sizeof(float) * 8);
+static_assert(sizeof(Vec2) == sizeof(float) * 2);
+
+namespace
+{
+void push_lanes(std::vector<uint32_t>& result, int mask, size_t first)
+{
+    for (uint32_t lane = 0; lane < 4; ++lane)
+    {
+        if (mask & (1 << lane))
+            result.push_back((uint32_t)first + lane);
+    }
+}
+} // namespace
+
+std::vector<uint32_t> batch_overlapping(const AABB& box, const AABB* boxes, size_t count)
+{
+    std::vector<uint32_t> result;
+    const __m128 left = _mm_set1_ps(box.left);
+    const __m128 top = _mm_set1_ps(box.top);
+    const __m128 right = _mm_set1_ps(box.right);
+    const __m128 bottom = _mm_set1_ps(box.bottom);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // Rows are left, top, right, bottom of each box, transposed into one register per side
+        __m128 lefts = _mm_loadu_ps(&boxes[i].left);
+        __m128 tops = _mm_loadu_ps(&boxes[i + 1].left);
+        __m128 rights = _mm_loadu_ps(&boxes[i + 2].left);
+        __m128 bottoms = _mm_loadu_ps(&boxes[i + 3].left);
+        _MM_TRANSPOSE4_PS(lefts, tops, rights, bottoms);
+
+        const __m128 overlap = _mm_and_ps(
+            _mm_and_ps(_mm_cmplt_ps(left, rights), _mm_cmplt_ps(lefts, right)),
+            _mm_and_ps(_mm_cmplt_ps(bottom, tops), _mm_cmplt_ps(bottoms, top)));
+        push_lanes(result, _mm_movemask_ps(overlap), i);
+    }
+    for (; i < count; ++i)
+    {
+        if (box.overlaps_with(boxes[i]))
+            result.push_back((uint32_t)i);
+    }
+    return result;
+}
+
+void batch_transform(Quad* quads, size_t count, float angle, Vec2 pivot, Vec2 offset)
+{
+    const float sin_a{std::sin(angle)};
+    const float cos_a{std::cos(angle)};
+    // Two corners per register as x, y, x, y, the swapped copy gives the y, x terms of the rotation
+    const __m128 p = _mm_setr_ps(pivot.x, pivot.y, pivot.x, pivot.y);
+    const __m128 moved = _mm_add_ps(p, _mm_setr_ps(offset.x, offset.y, offset.x, offset.y));
+    const __m128 cos_v = _mm_set1_ps(cos_a);
+    const __m128 sin_v = _mm_setr_ps(-sin_a, sin_a, -sin_a, sin_a);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        float* corners = &quads[i].bottom_left_x;
+        for (size_t half = 0; half < 8; half += 4)
+        {
+            const __m128 d = _mm_sub_ps(_mm_loadu_ps(corners + half), p);
+            const __m128 swapped = _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1));
+            const __m128 rotated = _mm_add_ps(_mm_mul_ps(d, cos_v), _mm_mul_ps(swapped, sin_v));
+            _mm_storeu_ps(corners + half, _mm_add_ps(rotated, moved));
+        }
+    }
+}
+
+std::vector<uint32_t> batch_inside(const Triangle& triangle, const Vec2* points, size_t count)
+{
+    const Vec2& a = triangle.A;
+    const Vec2& b = triangle.B;
+    const Vec2& c = triangle.C;
+    // Inside if the point is on the same side of all three edges, signs of the cross products with each edge
+    const auto side = [](const Vec2& from, const Vec2& to, float px, float py)
+    {
+        return (to.x - from.x) * (py - from.y) - (to.y - from.y) * (px - from.x);
+    };
+    const auto is_inside = [&](float px, float py)
+    {
+        const float d1 = side(a, b, px, py);
+        const float d2 = side(b, c, px, py);
+        const float d3 = side(c, a, px, py);
+        const bool has_neg = d1 < 0 || d2 < 0 || d3 < 0;
+        const bool has_pos = d1 > 0 || d2 > 0 || d3 > 0;
+        return !(has_neg && has_pos);
+    };
+
+    struct Edge
+    {
+        __m128 from_x, from_y, dx, dy;
+    };
+    const auto edge = [](const Vec2& from, const Vec2& to)
+    {
+        return Edge{_mm_set1_ps(from.x), _mm_set1_ps(from.y), _mm_set1_ps(to.x - from.x), _mm_set1_ps(to.y - from.y)};
+    };
+    const Edge edges[3]{edge(a, b), edge(b, c), edge(c, a)};
+    const __m128 zero = _mm_setzero_ps();
+
+    std::vector<uint32_t> result;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 first = _mm_loadu_ps(&points[i].x);
+        const __m128 second = _mm_loadu_ps(&points[i + 2].x);
+        const __m128 xs = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 ys = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+
+        __m128 has_neg = zero;
+        __m128 has_pos = zero;
+        for (const Edge& e : edges)
+        {
+            const __m128 d = _mm_sub_ps(_mm_mul_ps(e.dx, _mm_sub_ps(ys, e.from_y)), _mm_mul_ps(e.dy, _mm_sub_ps(xs, e.from_x)));
+            has_neg = _mm_or_ps(has_neg, _mm_cmplt_ps(d, zero));
+            has_pos = _mm_or_ps(has_pos, _mm_cmpgt_ps(d, zero));
+        }
+        push_lanes(result, ~_mm_movemask_ps(_mm_and_ps(has_neg, has_pos)), i);
+    }
+    for (; i < count; ++i)
+    {
+        if (is_inside(points[i].x, points[i].y))
+            result.push_back((uint32_t)i);
+    }
+    return result;
+}
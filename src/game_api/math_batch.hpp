@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint32_t
+#include <vector>  // for vector
+
+#include "math.hpp" // for AABB, Quad, Triangle, Vec2
+
+// SSE versions of the AABB/Quad/Triangle methods over whole arrays, four at a time, for scripts that test or move
+// hundreds of shapes per frame and would otherwise pay for a Lua call per shape
+
+// Indices of the `boxes` that overlap `box`, same test as AABB::overlaps_with
+std::vector<uint32_t> batch_overlapping(const AABB& box, const AABB* boxes, size_t count);
+// Rotates every quad around the pivot like Quad::rotate, then offsets it
+void batch_transform(Quad* quads, size_t count, float angle, Vec2 pivot, Vec2 offset);
+// Indices of the `points` inside the triangle, points on an edge count as inside
+std::vector<uint32_t> batch_inside(const Triangle& triangle, const Vec2* points, size_t count);
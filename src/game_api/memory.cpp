@@ -1,9 +1,11 @@
 #include "memory.hpp"
 
+#include <algorithm>     // for sort, min
 #include <cstdlib>       // for exit
 #include <cstring>       // for memcpy
 #include <functional>    // for equal_to
 #include <minwindef.h>   // for LPVOID
+#include <mutex>         // for mutex, lock_guard
 #include <new>           // for operator new
 #include <unordered_map> // for unordered_map, _Umap_traits<>::allocator_type
 #include <utility>       // for min, max
@@ -62,8 +64,103 @@ inline size_t round_up(size_t i, size_t div)
     return ((i + div - 1) / div) * div;
 }
 
+namespace
+{
+thread_local PatchTransaction* g_patch_transaction{nullptr};
+}
+
+PatchTransaction::PatchTransaction()
+    : outer{g_patch_transaction}
+{
+    if (outer == nullptr)
+        g_patch_transaction = this;
+}
+PatchTransaction::~PatchTransaction()
+{
+    if (outer == nullptr)
+    {
+        g_patch_transaction = nullptr;
+        commit();
+    }
+}
+
+void PatchTransaction::write(size_t addr, std::string_view payload)
+{
+    if (outer != nullptr)
+        outer->write(addr, payload);
+    else
+        writes.push_back({addr, std::string{payload}});
+}
+
+void PatchTransaction::commit()
+{
+    if (writes.empty())
+        return;
+
+    // Touched pages, merged so pages shared by several writes are only protected once
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (const PendingWrite& write : writes)
+    {
+        ranges.emplace_back(write.address & ~0xFFF, round_up(write.address + write.data.size(), 0x1000));
+    }
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<std::pair<size_t, size_t>> merged;
+    for (auto [begin, end] : ranges)
+    {
+        if (!merged.empty() && begin <= merged.back().second)
+            merged.back().second = std::max(merged.back().second, end);
+        else
+            merged.emplace_back(begin, end);
+    }
+
+    // Split at region borders, VirtualProtect only reports the old protection of the first page
+    struct ProtectedRegion
+    {
+        size_t address;
+        size_t size;
+        DWORD old_protect;
+    };
+    std::vector<ProtectedRegion> regions;
+    for (auto [begin, end] : merged)
+    {
+        for (size_t addr = begin; addr < end;)
+        {
+            MEMORY_BASIC_INFORMATION info;
+            if (VirtualQuery(reinterpret_cast<LPCVOID>(addr), &info, sizeof(info)) == 0)
+                break;
+
+            const size_t region_end = std::min(end, reinterpret_cast<size_t>(info.BaseAddress) + info.RegionSize);
+            ProtectedRegion& region = regions.emplace_back(addr, region_end - addr, 0);
+            VirtualProtect(reinterpret_cast<LPVOID>(region.address), region.size, PAGE_EXECUTE_READWRITE, &region.old_protect);
+            addr = region_end;
+        }
+    }
+
+    for (const PendingWrite& write : writes)
+    {
+        memcpy(reinterpret_cast<void*>(write.address), write.data.data(), write.data.size());
+    }
+    writes.clear();
+
+    for (const ProtectedRegion& region : regions)
+    {
+        DWORD dummy;
+        VirtualProtect(reinterpret_cast<LPVOID>(region.address), region.size, region.old_protect, &dummy);
+    }
+    for (auto [begin, end] : merged)
+    {
+        FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<LPCVOID>(begin), end - begin);
+    }
+}
+
 void write_mem_prot(size_t addr, std::string_view payload, bool prot)
 {
+    if (prot && g_patch_transaction != nullptr)
+    {
+        g_patch_transaction->write(addr, payload);
+        return;
+    }
+
     DWORD old_protect = 0;
     auto page = addr & ~0xFFF;
     auto size = round_up((addr + payload.size() - page), 0x1000);
@@ -122,64 +219,156 @@ void* alloc_mem_rel32(size_t addr, size_t size)
     return new_array;
 }
 
-void save_mem_recoverable(std::string name, size_t addr, size_t size, bool prot)
+namespace
 {
-    static const auto bucket = Bucket::get();
-    auto map_it = bucket->original_memory.find(name);
-    if (map_it == bucket->original_memory.end())
+struct CodeRegion
+{
+    size_t begin;
+    size_t end;
+    size_t used;
+    size_t committed;
+};
+
+bool in_rel32_range(size_t from, size_t to)
+{
+    // Some slack, the jumps are relative to the end of the instruction and not its start
+    const int64_t distance = static_cast<int64_t>(to) - static_cast<int64_t>(from);
+    return distance > INT32_MIN + 0x10000 && distance < INT32_MAX - 0x10000;
+}
+} // namespace
+
+void* alloc_code_rel32(size_t addr, size_t size)
+{
+    static constexpr size_t region_size = 1024 * 1024;
+    static constexpr size_t granularity = 64 * 1024;
+    static std::mutex lock;
+    static std::vector<CodeRegion> regions;
+
+    std::lock_guard guard{lock};
+    size = (size + 0xF) & ~size_t{0xF};
+    if (size > region_size)
+        return nullptr;
+
+    auto take = [size](CodeRegion& region) -> void*
     {
-        char* old_data = static_cast<char*>(VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
-        if (old_data)
+        const size_t start = region.begin + region.used;
+        if (start + size > region.committed)
         {
-            std::memcpy(old_data, reinterpret_cast<char*>(addr), size);
-            bucket->original_memory.emplace(std::move(name), EditedMemory{{{addr, old_data, size, prot}}, true});
+            const size_t commit_end = std::min(region.end, round_up(start + size, 0x1000));
+            if (!VirtualAlloc(reinterpret_cast<LPVOID>(region.committed), commit_end - region.committed, MEM_COMMIT, PAGE_EXECUTE_READ))
+                return nullptr;
+            region.committed = commit_end;
         }
+        region.used += size;
+        return reinterpret_cast<void*>(start);
+    };
+
+    for (CodeRegion& region : regions)
+    {
+        const size_t start = region.begin + region.used;
+        if (start + size <= region.end && in_rel32_range(addr, start) && in_rel32_range(addr, start + size))
+            return take(region);
     }
-    else
+
+    // Reserve a new region as close below the exe as possible, the closer to the game code the better
+    const size_t exe = Memory::get().exe_address();
+    for (size_t test_addr = (exe - region_size) & ~(granularity - 1); test_addr > granularity && in_rel32_range(addr, test_addr); test_addr -= granularity)
     {
-        bool new_addr = true;
-        for (auto& it : map_it->second.mem)
+        if (VirtualAlloc(reinterpret_cast<LPVOID>(test_addr), region_size, MEM_RESERVE, PAGE_NOACCESS))
         {
-            if (it.address == addr)
-            {
-                new_addr = false;
-                break;
-            }
-        }
-        if (new_addr)
-        {
-            char* old_data = static_cast<char*>(VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
-            if (old_data)
-            {
-                std::memcpy(old_data, reinterpret_cast<char*>(addr), size);
-                map_it->second.mem.emplace_back(addr, old_data, size, prot);
-            }
+            CodeRegion& region = regions.emplace_back(test_addr, test_addr + region_size, 0, test_addr);
+            return take(region);
         }
     }
+    return nullptr;
 }
 
-void write_mem_recoverable(std::string name, size_t addr, std::string_view payload, bool prot)
+namespace
+{
+// Backups are usually a few bytes, so they are carved out of shared blocks instead of getting a 64 KiB reservation each
+// Nothing is ever freed, the backups have to stay valid for every API instance that shares the bucket
+char* alloc_recoverable(size_t size)
+{
+    static constexpr size_t block_size = 64 * 1024;
+    static std::mutex lock;
+    static char* block{nullptr};
+    static size_t used{block_size};
+
+    std::lock_guard guard{lock};
+    size = (size + 7) & ~size_t{7};
+    if (size > block_size / 4)
+        return static_cast<char*>(VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+    if (used + size > block_size)
+    {
+        char* new_block = static_cast<char*>(VirtualAlloc(0, block_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        if (!new_block)
+            return nullptr;
+        block = new_block;
+        used = 0;
+    }
+    char* data = block + used;
+    used += size;
+    return data;
+}
+
+EditedMemory* save_mem_recoverable_impl(std::string_view name, size_t addr, size_t size, bool prot)
 {
     static const auto bucket = Bucket::get();
-    save_mem_recoverable(name, addr, payload.size(), prot);
-    bucket->original_memory[name].dirty = true;
+    auto map_it = bucket->original_memory.find(name);
+    if (map_it == bucket->original_memory.end())
+    {
+        char* old_data = alloc_recoverable(size);
+        if (!old_data)
+            return nullptr;
+
+        std::memcpy(old_data, reinterpret_cast<char*>(addr), size);
+        return &bucket->original_memory.emplace(std::string{name}, EditedMemory{{{addr, old_data, size, prot}}, true}).first->second;
+    }
+
+    for (auto& it : map_it->second.mem)
+    {
+        if (it.address == addr)
+            return &map_it->second;
+    }
+
+    char* old_data = alloc_recoverable(size);
+    if (old_data)
+    {
+        std::memcpy(old_data, reinterpret_cast<char*>(addr), size);
+        map_it->second.mem.emplace_back(addr, old_data, size, prot);
+    }
+    return &map_it->second;
+}
+} // namespace
+
+void save_mem_recoverable(std::string_view name, size_t addr, size_t size, bool prot)
+{
+    save_mem_recoverable_impl(name, addr, size, prot);
+}
+
+void write_mem_recoverable(std::string_view name, size_t addr, std::string_view payload, bool prot)
+{
+    if (EditedMemory* edited = save_mem_recoverable_impl(name, addr, payload.size(), prot))
+        edited->dirty = true;
     write_mem_prot(addr, payload, prot);
 }
 
-void recover_mem(std::string name, size_t addr)
+void recover_mem(std::string_view name, size_t addr)
 {
     static const auto bucket = Bucket::get();
     auto it = bucket->original_memory.find(name);
     if (it != bucket->original_memory.end())
     {
+        PatchTransaction transaction;
         size_t fixed = 0;
         for (auto& mem : it->second.mem)
         {
             if (!addr || addr == mem.address)
             {
                 write_mem_prot(mem.address, std::string_view{mem.old_data, mem.size}, mem.prot_used);
-                if (++fixed == bucket->original_memory[name].mem.size())
-                    bucket->original_memory[name].dirty = false;
+                if (++fixed == it->second.mem.size())
+                    it->second.dirty = false;
             }
         }
     }
@@ -187,7 +376,7 @@ void recover_mem(std::string name, size_t addr)
     //     DEBUG("Warning: (recover_mem) tried to recover non existing memory named: {}", name);
 }
 
-bool mem_written(std::string name)
+bool mem_written(std::string_view name)
 {
     static const auto bucket = Bucket::get();
     auto it = bucket->original_memory.find(name);
@@ -209,30 +398,30 @@ size_t patch_and_redirect(size_t addr, size_t replace_size, const std::string_vi
     const size_t target = std::max(return_to_addr, addr);
     const auto new_memory_size = payload.size() + data_size_to_move + jump_size;
 
-    auto new_code = static_cast<char*>(alloc_mem_rel32(target, new_memory_size));
+    auto new_code = static_cast<char*>(alloc_code_rel32(target, new_memory_size));
     if (new_code == nullptr)
         return 0;
 
+    const std::string_view game_code{reinterpret_cast<const char*>(addr), data_size_to_move};
+    std::string code;
+    code.reserve(new_memory_size);
     if (game_code_first && !just_nop)
     {
-        std::memcpy(new_code, reinterpret_cast<void*>(addr), data_size_to_move);
-        std::memcpy(new_code + data_size_to_move, payload.data(), payload.size());
+        code += game_code;
+        code += payload;
     }
     else
     {
-        std::memcpy(new_code, payload.data(), payload.size());
+        code += payload;
 
         if (!just_nop)
-            std::memcpy(new_code + payload.size(), reinterpret_cast<void*>(addr), data_size_to_move);
+            code += game_code;
     }
 
     size_t return_addr = return_to_addr == 0 ? addr + replace_size : return_to_addr;
     int32_t rel_back = static_cast<int32_t>(return_addr - reinterpret_cast<size_t>(new_code + new_memory_size));
-    const std::string jump_back = fmt::format("\xE9{}"sv, to_le_bytes(rel_back));
-    std::memcpy(new_code + payload.size() + data_size_to_move, jump_back.data(), jump_size);
-
-    DWORD dummy;
-    VirtualProtect(new_code, new_memory_size, PAGE_EXECUTE_READ, &dummy);
+    code += fmt::format("\xE9{}"sv, to_le_bytes(rel_back));
+    write_mem_prot(reinterpret_cast<size_t>(new_code), code, true);
 
     int32_t rel = static_cast<int32_t>(reinterpret_cast<size_t>(new_code) - (addr + jump_size));
     const std::string redirect_code = fmt::format("\xE9{}{}"sv, to_le_bytes(rel), get_nop(replace_size - jump_size));
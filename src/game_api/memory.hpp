@@ -5,6 +5,7 @@
 #include <memory>      // for unique_ptr
 #include <string>      // for string, string_literals
 #include <string_view> // for string_view
+#include <vector>      // for vector
 
 class ExecutableMemory
 {
@@ -76,16 +77,44 @@ struct Memory
     ~Memory(){};
 };
 
+// While one is alive, protected writes made through write_mem_prot on this thread are collected instead of applied right away
+// They are applied together when the outermost transaction ends, changing the protection of each touched page range once
+// Writes land in order, but reading patched memory inside the transaction still sees the old bytes
+class PatchTransaction
+{
+  public:
+    PatchTransaction();
+    ~PatchTransaction();
+    PatchTransaction(const PatchTransaction&) = delete;
+    PatchTransaction& operator=(const PatchTransaction&) = delete;
+
+    void write(size_t addr, std::string_view payload);
+    // Applies the writes collected so far, the transaction stays open
+    void commit();
+
+  private:
+    struct PendingWrite
+    {
+        size_t address;
+        std::string data;
+    };
+    std::vector<PendingWrite> writes;
+    PatchTransaction* outer;
+};
+
 [[nodiscard]] void* alloc_mem_rel32(size_t addr, size_t size);
+// Executable memory within rel32 range of addr, carved out of pooled regions near the exe, write to it with write_mem_prot
+// Never free it, the regions are shared by every allocation
+[[nodiscard]] void* alloc_code_rel32(size_t addr, size_t size);
 void write_mem_prot(size_t addr, std::string_view payload, bool prot);
 void write_mem_prot(size_t addr, std::string payload, bool prot);
 void write_mem(size_t addr, std::string payload);
 size_t function_start(size_t off, uint8_t outside_byte = '\xcc');
 // save copy of the original memory so it can be later recovered via recover_mem
-void save_mem_recoverable(std::string name, size_t addr, size_t size, bool prot);
-void write_mem_recoverable(std::string name, size_t addr, std::string_view payload, bool prot);
-void recover_mem(std::string name, size_t addr = NULL);
-bool mem_written(std::string name);
+void save_mem_recoverable(std::string_view name, size_t addr, size_t size, bool prot);
+void write_mem_recoverable(std::string_view name, size_t addr, std::string_view payload, bool prot);
+void recover_mem(std::string_view name, size_t addr = NULL);
+bool mem_written(std::string_view name);
 std::string get_nop(size_t size, bool true_nop = false);
 
 // similar to ExecutableMemory but writes automatic jump from and back, moves the code it replaces etc.
@@ -102,7 +131,7 @@ std::string_view to_le_bytes(const T& payload)
 
 template <class T>
 requires(std::is_trivially_copyable_v<T> && !std::is_same_v<T, std::string_view>)
-void write_mem_recoverable(std::string name, size_t addr, const T& payload, bool prot)
+void write_mem_recoverable(std::string_view name, size_t addr, const T& payload, bool prot)
 {
     write_mem_recoverable(name, addr, to_le_bytes(payload), prot);
 }
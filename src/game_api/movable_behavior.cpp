@@ -1,13 +1,17 @@
 #include "movable_behavior.hpp"
 
+#include <algorithm> // for max, min
+#include <cmath>     // for sqrt
 #include <detours.h> // for DetourTransactionBegin, DetourUpdateThread, ...
 #include <list>      // for _List_iterator, _List_const_ite...
 #include <map>       // for _Tree_iterator, _Tree_const_ite...
+#include <optional>  // for optional, nullopt
 #include <string>    // for operator""sv
 #include <utility>   // for min, max, pair
 
 #include "containers/custom_map.hpp" // for custom_map
 #include "containers/custom_set.hpp" // for custom_set
+#include "detour_transaction.hpp"    // for hook_transaction_begin, hook_transaction_commit
 #include "memory.hpp"                // for Memory
 #include "movable.hpp"               // for Movable
 #include "search.hpp"                // for get_address
@@ -28,13 +32,13 @@ bool SortMovableBehavior::operator()(const MovableBehavior* lhs, const MovableBe
 
 CustomMovableBehavior::~CustomMovableBehavior()
 {
-    for (auto& [movable, hook] : using_movables)
+    for (auto& [movable, movable_state] : using_movables)
     {
         // Reset to default behaviors, as soon as one custom behavior is removed this
         // whole state machine can not possibly be valid anymore
         clear_behaviors(movable);
         movable->apply_db();
-        movable->clean_on_dtor(hook);
+        movable->clean_on_dtor(movable_state.dtor_hook);
     }
 }
 
@@ -88,6 +92,8 @@ bool CustomMovableBehavior::force_state(Movable* movable)
 }
 void CustomMovableBehavior::on_enter(Movable* movable)
 {
+    if (auto it = using_movables.find(movable); it != using_movables.end())
+        it->second.frames_in_state = 0;
     call_custom_or_original<&VanillaMovableBehavior::on_enter>(custom_on_enter, base_behavior, movable);
 }
 void CustomMovableBehavior::on_exit(Movable* movable)
@@ -96,22 +102,126 @@ void CustomMovableBehavior::on_exit(Movable* movable)
 }
 void CustomMovableBehavior::update_logic(Movable* movable)
 {
+    if (!custom_update_logic && !logic_steps.empty())
+        return run_steps(logic_steps, &VanillaMovableBehavior::update_logic, movable);
     call_custom_or_original<&VanillaMovableBehavior::update_logic>(custom_update_logic, base_behavior, movable);
 }
 void CustomMovableBehavior::update_world(Movable* movable)
 {
+    if (!custom_update_world && !world_steps.empty())
+        return run_steps(world_steps, &VanillaMovableBehavior::update_world, movable);
     call_custom_or_original<&VanillaMovableBehavior::update_world>(custom_update_world, base_behavior, movable);
 }
 uint8_t CustomMovableBehavior::get_next_state_id(Movable* movable)
 {
+    if (!custom_get_next_state_id && !transitions.empty())
+        return run_transitions(movable);
     return call_custom_or_original<&VanillaMovableBehavior::get_next_state_id>(custom_get_next_state_id, base_behavior, state_id, movable);
 }
 
 void CustomMovableBehavior::hook_movable(Movable* movable)
 {
-    using_movables[movable] =
+    using_movables[movable] = {
         movable->set_on_dtor([=, this](Entity*)
-                             { using_movables.erase(movable); });
+                             { using_movables.erase(movable); }),
+        0,
+    };
+}
+
+static std::optional<Vec2> offset_to_target(Movable* movable, int32_t target_uid)
+{
+    Entity* target = target_uid >= 0 ? get_entity_ptr(target_uid) : nullptr;
+    if (target == nullptr)
+        return std::nullopt;
+    return target->abs_position() - movable->abs_position();
+}
+
+void CustomMovableBehavior::run_steps(const std::vector<BehaviorStep>& steps, void (VanillaMovableBehavior::*base_fun)(Movable*), Movable* movable)
+{
+    for (const BehaviorStep& step : steps)
+    {
+        switch (step.type)
+        {
+        case BEHAVIOR_STEP::BASE:
+            if (base_behavior)
+                (base_behavior->*base_fun)(movable);
+            break;
+        case BEHAVIOR_STEP::GRAVITY:
+            movable->velocityy = std::max(movable->velocityy - step.x, -step.y);
+            break;
+        case BEHAVIOR_STEP::SET_VELOCITY:
+            movable->velocityx = step.x;
+            movable->velocityy = step.y;
+            break;
+        case BEHAVIOR_STEP::MOVE_TOWARDS:
+        {
+            const std::optional<Vec2> offset = offset_to_target(movable, step.target_uid);
+            const float distance = offset ? std::sqrt(offset->x * offset->x + offset->y * offset->y) : 0.0f;
+            if (distance > 0.0f)
+            {
+                // Don't overshoot the target on the last frame
+                const float speed = std::min(step.x, distance);
+                movable->velocityx = offset->x / distance * speed;
+                movable->velocityy = offset->y / distance * speed;
+            }
+            else
+            {
+                movable->velocityx = 0.0f;
+                movable->velocityy = 0.0f;
+            }
+            break;
+        }
+        case BEHAVIOR_STEP::SET_MOVE:
+            movable->movex = step.x;
+            movable->movey = step.y;
+            break;
+        case BEHAVIOR_STEP::UPDATE_MOVABLE:
+            update_movable(movable, movable->move, 1.0f, step.y > 0.0f, false);
+            break;
+        }
+    }
+}
+
+uint8_t CustomMovableBehavior::run_transitions(Movable* movable)
+{
+    uint32_t frames_in_state = 0;
+    if (auto it = using_movables.find(movable); it != using_movables.end())
+        frames_in_state = ++it->second.frames_in_state;
+
+    for (const BehaviorTransition& transition : transitions)
+    {
+        switch (transition.type)
+        {
+        case BEHAVIOR_TRANSITION::ALWAYS:
+            return transition.next_state;
+        case BEHAVIOR_TRANSITION::TIMER:
+            if (frames_in_state > transition.value)
+                return transition.next_state;
+            break;
+        case BEHAVIOR_TRANSITION::ON_GROUND:
+            if (movable->standing_on_uid != -1)
+                return transition.next_state;
+            break;
+        case BEHAVIOR_TRANSITION::TARGET_NEAR:
+        case BEHAVIOR_TRANSITION::TARGET_FAR:
+        {
+            const std::optional<Vec2> offset = offset_to_target(movable, transition.target_uid);
+            const bool is_near = offset && offset->x * offset->x + offset->y * offset->y < transition.value * transition.value;
+            if (is_near == (transition.type == BEHAVIOR_TRANSITION::TARGET_NEAR))
+                return transition.next_state;
+            break;
+        }
+        case BEHAVIOR_TRANSITION::BASE:
+            if (base_behavior)
+            {
+                const uint8_t next_state = base_behavior->get_next_state_id(movable);
+                if (next_state != base_behavior->get_state_id())
+                    return next_state;
+            }
+            break;
+        }
+    }
+    return state_id;
 }
 
 VanillaMovableBehavior* get_base_behavior(Movable* movable, uint32_t state_id)
@@ -239,8 +349,7 @@ void update_movable(Movable& movable, const Vec2& move_xy, float sprint_factor,
 
 void init_behavior_hooks()
 {
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
+    hook_transaction_begin();
 
     auto& memory = Memory::get();
 
@@ -252,7 +361,7 @@ void init_behavior_hooks()
     DetourAttach((void**)&g_update_movable_trampoline, &update_movable);
 #endif
 
-    const LONG error = DetourTransactionCommit();
+    const LONG error = hook_transaction_commit();
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking behavior hooks: {}\n", error);
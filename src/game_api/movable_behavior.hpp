@@ -6,6 +6,7 @@
 #include <new>           // for operator new
 #include <type_traits>   // for hash
 #include <unordered_map> // for _Umap_traits<>::allocator_type, unordered_map
+#include <vector>        // for vector
 
 #include "math.hpp" // for Vec2
 
@@ -36,6 +37,54 @@ struct VanillaMovableBehavior : MovableBehavior
 {
 };
 
+enum class BEHAVIOR_STEP : uint8_t
+{
+    // Calls the function of the base behavior
+    BASE,
+    // velocityy -= x, down to -y
+    GRAVITY,
+    // velocity = {x, y}
+    SET_VELOCITY,
+    // Sets the velocity towards the target entity with a speed of x, stops when there's no target
+    MOVE_TOWARDS,
+    // move = {x, y}
+    SET_MOVE,
+    // update_movable with the current move, y > 0 disables gravity
+    UPDATE_MOVABLE,
+};
+
+enum class BEHAVIOR_TRANSITION : uint8_t
+{
+    // Always taken, used as the last transition to fall back to a state
+    ALWAYS,
+    // After x frames in this state
+    TIMER,
+    // When standing on something
+    ON_GROUND,
+    // When the target entity is closer than x
+    TARGET_NEAR,
+    // When the target entity is further than x or gone
+    TARGET_FAR,
+    // When the base behavior's get_next_state_id wants to leave this state, next_state is ignored
+    BASE,
+};
+
+struct BehaviorStep
+{
+    BEHAVIOR_STEP type;
+    float x;
+    float y;
+    int32_t target_uid;
+};
+
+struct BehaviorTransition
+{
+    BEHAVIOR_TRANSITION type;
+    uint8_t next_state;
+    float value;
+    int32_t target_uid;
+};
+
 struct CustomMovableBehavior final : MovableBehavior
 {
     uint8_t state_id{};
@@ -47,7 +96,19 @@ struct CustomMovableBehavior final : MovableBehavior
     std::function<uint8_t(Movable*, std::function<uint8_t(Movable*)>)> custom_get_next_state_id;
     VanillaMovableBehavior* base_behavior;
 
-    std::unordered_map<Movable*, uint32_t> using_movables;
+    // Native replacements for the functions above, each list is only used while the corresponding custom function is not set,
+    // so a state machine built from these never calls into Lua outside of on_enter/on_exit
+    std::vector<BehaviorStep> logic_steps;
+    std::vector<BehaviorStep> world_steps;
+    // Checked in order, the first one that holds picks the next state, stays in this state if none holds
+    std::vector<BehaviorTransition> transitions;
+
+    struct MovableState
+    {
+        uint32_t dtor_hook;
+        uint32_t frames_in_state;
+    };
+    std::unordered_map<Movable*, MovableState> using_movables;
 
     ~CustomMovableBehavior();
 
@@ -67,6 +128,10 @@ struct CustomMovableBehavior final : MovableBehavior
     virtual uint8_t get_next_state_id(Movable* movable) override;
 
     void hook_movable(Movable* movable);
+
+  private:
+    void run_steps(const std::vector<BehaviorStep>& steps, void (VanillaMovableBehavior::*base_fun)(Movable*), Movable* movable);
+    uint8_t run_transitions(Movable* movable);
 };
 
 /// Gets a vanilla behavior from this movable, needs to be called before `clear_behaviors`
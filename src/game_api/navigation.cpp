@@ -0,0 +1,221 @@
+#include "navigation.hpp"
+
+#include <algorithm>  // for reverse
+#include <cmath>      // for round
+#include <cstdint>    // for INT32_MAX
+#include <cstdlib>    // for abs
+#include <cstring>    // for memcmp
+#include <deque>      // for deque
+#include <functional> // for greater
+#include <queue>      // for priority_queue
+#include <utility>    // for pair
+
+#include "entity.hpp" // for Entity
+#include "state.hpp"  // for StateMemory, get_state_ptr, API::get_global_update_count
+
+namespace
+{
+bool is_solid(const Entity* ent)
+{
+    return ent != nullptr && (ent->flags & (1 << 2)) != 0; // Solid
+}
+
+bool in_grid(int32_t x, int32_t y)
+{
+    return x >= 0 && y >= 0 && x < static_cast<int32_t>(g_level_max_x) && y < static_cast<int32_t>(g_level_max_y);
+}
+
+uint32_t cell_index(int32_t x, int32_t y)
+{
+    return static_cast<uint32_t>(y) * g_level_max_x + static_cast<uint32_t>(x);
+}
+
+constexpr std::pair<int32_t, int32_t> g_neighbours[]{{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+} // namespace
+
+int32_t GridFlowField::distance(float x, float y) const
+{
+    const int32_t ix = static_cast<int32_t>(std::round(x));
+    const int32_t iy = static_cast<int32_t>(std::round(y));
+    if (!in_grid(ix, iy) || distances.empty())
+        return -1;
+    return distances[cell_index(ix, iy)];
+}
+std::optional<Vec2> GridFlowField::next(float x, float y) const
+{
+    const int32_t ix = static_cast<int32_t>(std::round(x));
+    const int32_t iy = static_cast<int32_t>(std::round(y));
+    const int32_t current = distance(x, y);
+    if (current <= 0)
+        return std::nullopt;
+
+    for (auto [dx, dy] : g_neighbours)
+    {
+        const int32_t nx = ix + dx;
+        const int32_t ny = iy + dy;
+        if (in_grid(nx, ny) && distances[cell_index(nx, ny)] == current - 1)
+            return Vec2{static_cast<float>(nx), static_cast<float>(ny)};
+    }
+    return std::nullopt;
+}
+
+NavigationGrid& NavigationGrid::get()
+{
+    static NavigationGrid grid;
+    return grid;
+}
+
+NavigationGrid::LayerGrid& NavigationGrid::synced(uint8_t layer)
+{
+    LayerGrid& grid = layers[layer];
+    const uint64_t update = API::get_global_update_count();
+    if (grid.synced_frame == update)
+        return grid;
+    grid.synced_frame = update;
+
+    // Only the rows that changed since the last sync are looked at again, usually that's just a few of them
+    const Layer* layer_ptr = get_state_ptr()->layers[layer];
+    for (uint32_t y = 0; y < g_level_max_y; ++y)
+    {
+        Entity* const* row = layer_ptr->grid_entities[y];
+        Entity** cached_row = grid.entities.data() + y * g_level_max_x;
+        if (std::memcmp(row, cached_row, sizeof(Entity*) * g_level_max_x) == 0)
+            continue;
+
+        for (uint32_t x = 0; x < g_level_max_x; ++x)
+        {
+            cached_row[x] = row[x];
+            grid.solid[y * g_level_max_x + x] = is_solid(row[x]);
+        }
+    }
+    return grid;
+}
+
+void NavigationGrid::on_grid_cell_changed(const Layer* layer, uint32_t x, uint32_t y)
+{
+    LayerGrid& grid = layers[layer->is_back_layer ? 1 : 0];
+    if (!grid.synced_frame.has_value() || x >= g_level_max_x || y >= g_level_max_y)
+        return;
+
+    Entity* ent = layer->grid_entities[y][x];
+    grid.entities[y * g_level_max_x + x] = ent;
+    grid.solid[y * g_level_max_x + x] = is_solid(ent);
+}
+
+void NavigationGrid::invalidate()
+{
+    // An empty grid matches the empty cells, every other cell is looked at again on the next sync
+    layers = {};
+}
+
+bool NavigationGrid::is_passable(LAYER layer, int32_t x, int32_t y)
+{
+    if (!in_grid(x, y))
+        return false;
+    return !synced(enum_to_layer(layer)).solid[cell_index(x, y)];
+}
+
+std::vector<Vec2> NavigationGrid::find_path(LAYER layer, int32_t start_x, int32_t start_y, int32_t goal_x, int32_t goal_y)
+{
+    if (!in_grid(start_x, start_y) || !in_grid(goal_x, goal_y))
+        return {};
+
+    const LayerGrid& grid = synced(enum_to_layer(layer));
+    const uint32_t start = cell_index(start_x, start_y);
+    const uint32_t goal = cell_index(goal_x, goal_y);
+    if (grid.solid[start] || grid.solid[goal])
+        return {};
+
+    // A* with manhattan distance, the grid is small enough to keep the per cell state in flat arrays
+    static constexpr uint32_t no_cell = ~0u;
+    std::vector<uint32_t> came_from(num_cells, no_cell);
+    std::vector<int32_t> cost(num_cells, INT32_MAX);
+    using OpenEntry = std::pair<int32_t, uint32_t>;
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+
+    cost[start] = 0;
+    came_from[start] = start;
+    open.push({std::abs(goal_x - start_x) + std::abs(goal_y - start_y), start});
+    while (!open.empty())
+    {
+        const uint32_t current = open.top().second;
+        open.pop();
+        if (current == goal)
+            break;
+
+        const int32_t cx = static_cast<int32_t>(current % g_level_max_x);
+        const int32_t cy = static_cast<int32_t>(current / g_level_max_x);
+        for (auto [dx, dy] : g_neighbours)
+        {
+            const int32_t nx = cx + dx;
+            const int32_t ny = cy + dy;
+            if (!in_grid(nx, ny))
+                continue;
+
+            const uint32_t neighbour = cell_index(nx, ny);
+            const int32_t new_cost = cost[current] + 1;
+            if (grid.solid[neighbour] || new_cost >= cost[neighbour])
+                continue;
+
+            cost[neighbour] = new_cost;
+            came_from[neighbour] = current;
+            open.push({new_cost + std::abs(goal_x - nx) + std::abs(goal_y - ny), neighbour});
+        }
+    }
+
+    if (came_from[goal] == no_cell)
+        return {};
+
+    std::vector<Vec2> path;
+    for (uint32_t cell = goal; cell != start; cell = came_from[cell])
+    {
+        path.emplace_back(static_cast<float>(cell % g_level_max_x), static_cast<float>(cell / g_level_max_x));
+    }
+    path.emplace_back(static_cast<float>(start_x), static_cast<float>(start_y));
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+GridFlowField NavigationGrid::flow_field(LAYER layer, int32_t target_x, int32_t target_y, int32_t max_distance)
+{
+    GridFlowField field{target_x, target_y};
+    if (!in_grid(target_x, target_y))
+        return field;
+
+    const LayerGrid& grid = synced(enum_to_layer(layer));
+    field.distances.assign(num_cells, -1);
+
+    const uint32_t target = cell_index(target_x, target_y);
+    if (grid.solid[target])
+        return field;
+
+    std::deque<uint32_t> frontier{target};
+    field.distances[target] = 0;
+    while (!frontier.empty())
+    {
+        const uint32_t current = frontier.front();
+        frontier.pop_front();
+
+        const int16_t next_distance = static_cast<int16_t>(field.distances[current] + 1);
+        if (max_distance >= 0 && next_distance > max_distance)
+            continue;
+
+        const int32_t cx = static_cast<int32_t>(current % g_level_max_x);
+        const int32_t cy = static_cast<int32_t>(current / g_level_max_x);
+        for (auto [dx, dy] : g_neighbours)
+        {
+            const int32_t nx = cx + dx;
+            const int32_t ny = cy + dy;
+            if (!in_grid(nx, ny))
+                continue;
+
+            const uint32_t neighbour = cell_index(nx, ny);
+            if (!grid.solid[neighbour] && field.distances[neighbour] < 0)
+            {
+                field.distances[neighbour] = next_distance;
+                frontier.push_back(neighbour);
+            }
+        }
+    }
+    return field;
+}
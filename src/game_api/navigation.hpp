@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>    // for array
+#include <cstdint>  // for int32_t, uint32_t, uint8_t, int16_t
+#include <optional> // for optional
+#include <vector>   // for vector
+
+#include "aliases.hpp" // for LAYER
+#include "layer.hpp"   // for Layer, g_level_max_x, g_level_max_y
+#include "math.hpp"    // for Vec2
+
+class Entity;
+
+/// Distances to a target grid position, returned by [get_grid_flow_field](#get_grid_flow_field)
+struct GridFlowField
+{
+    /// Grid x of the target
+    int32_t target_x{0};
+    /// Grid y of the target
+    int32_t target_y{0};
+    // Per grid cell, row by row from y = 0, -1 where the target can't be reached
+    std::vector<int16_t> distances;
+
+    /// Number of steps from the grid position to the target, -1 if the target can't be reached from there
+    int32_t distance(float x, float y) const;
+    /// Neighbouring grid position one step closer to the target, nil if the target can't be reached or is already reached
+    std::optional<Vec2> next(float x, float y) const;
+};
+
+// Which cells of the level grid can be moved through, per layer, a cell is passable when there is no solid grid entity in it
+// Synced with Layer::grid_entities by diffing it at most once per frame, changes made through Layer::move_grid_entity and
+// Layer::destroy_grid_entity are applied right away so queries in the same frame see them
+class NavigationGrid
+{
+  public:
+    static NavigationGrid& get();
+
+    bool is_passable(LAYER layer, int32_t x, int32_t y);
+    // Grid positions from start to goal with 4-way movement, including both ends, empty if there is no path
+    std::vector<Vec2> find_path(LAYER layer, int32_t start_x, int32_t start_y, int32_t goal_x, int32_t goal_y);
+    // Breadth first search outwards from the target, stops at `max_distance` steps if it's not negative
+    GridFlowField flow_field(LAYER layer, int32_t target_x, int32_t target_y, int32_t max_distance);
+
+    // Has to be called after writing to `layer->grid_entities[y][x]`
+    void on_grid_cell_changed(const Layer* layer, uint32_t x, uint32_t y);
+    // Has to be called when a state is loaded, the same pointers in the grid can be different entities afterwards
+    void invalidate();
+
+  private:
+    static constexpr uint32_t num_cells = g_level_max_x * g_level_max_y;
+
+    struct LayerGrid
+    {
+        std::array<Entity*, num_cells> entities{};
+        // Empty cells are passable, so a grid that was never synced matches an empty level
+        std::array<bool, num_cells> solid{};
+        std::optional<uint64_t> synced_frame;
+    };
+
+    LayerGrid& synced(uint8_t layer);
+
+    std::array<LayerGrid, 2> layers;
+};
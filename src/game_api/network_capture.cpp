@@ -0,0 +1,216 @@
+#include "network_capture.hpp"
+
+#include <Windows.h>     // for GetSystemTimePreciseAsFileTime, VirtualAlloc
+#include <algorithm>     // for min
+#include <chrono>        // for milliseconds
+#include <cstdio>        // for FILE, fopen, fwrite, fflush, fclose
+#include <cstring>       // for memcpy
+#include <thread>        // for thread, sleep_for
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+#include <winsock2.h>    // for getsockname, sockaddr_in, htons
+
+#include "logger.h"          // for DEBUG
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+namespace
+{
+#pragma pack(push, 1)
+struct PcapHeader
+{
+    uint32_t magic{0xa1b2c3d4};
+    uint16_t version_major{2};
+    uint16_t version_minor{4};
+    int32_t thiszone{0};
+    uint32_t sigfigs{0};
+    uint32_t snaplen{65535};
+    // LINKTYPE_IPV4, every record starts with an IPv4 header
+    uint32_t network{228};
+};
+struct PcapRecord
+{
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+struct Ipv4UdpHeader
+{
+    uint8_t version_ihl{0x45};
+    uint8_t tos{0};
+    uint16_t total_length;
+    uint16_t identification{0};
+    uint16_t flags_fragment{0};
+    uint8_t ttl{64};
+    uint8_t protocol{17};
+    // Left at 0, Wireshark doesn't verify it by default
+    uint16_t checksum{0};
+    uint32_t source;
+    uint32_t destination;
+    uint16_t source_port;
+    uint16_t destination_port;
+    uint16_t udp_length;
+    uint16_t udp_checksum{0};
+};
+#pragma pack(pop)
+
+// FILETIME counts 100ns steps since 1601
+constexpr int64_t g_filetime_unix_epoch = 116444736000000000;
+} // namespace
+
+NetworkCapture& NetworkCapture::get()
+{
+    static NetworkCapture capture;
+    return capture;
+}
+
+bool NetworkCapture::start(const std::string& path)
+{
+    if (running.load(std::memory_order_acquire) || writing.load(std::memory_order_acquire))
+        return false;
+
+    FILE* out = nullptr;
+    if (fopen_s(&out, path.c_str(), "wb") != 0 || out == nullptr)
+        return false;
+    const PcapHeader header{};
+    fwrite(&header, sizeof(header), 1, out);
+    file = out;
+
+    if (slots == nullptr)
+    {
+        // Committed up front, so the hooks never touch a page for the first time
+        slots = static_cast<Slot*>(VirtualAlloc(nullptr, sizeof(Slot) * NUM_SLOTS, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        for (size_t i = 0; i < NUM_SLOTS; ++i)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    writing.store(true, std::memory_order_release);
+    running.store(true, std::memory_order_release);
+    std::thread(&NetworkCapture::write_loop, this).detach();
+    return true;
+}
+void NetworkCapture::stop()
+{
+    running.store(false, std::memory_order_release);
+}
+bool NetworkCapture::is_running() const
+{
+    return running.load(std::memory_order_acquire);
+}
+
+void NetworkCapture::record(bool sent, uint64_t socket, uint32_t peer_address, uint16_t peer_port, const char* data, int length)
+{
+    if (!running.load(std::memory_order_relaxed) || length <= 0)
+        return;
+
+    // Bounded multi producer queue, a slot is claimed by moving head past it once the writer has freed it
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true)
+    {
+        slot = &slots[pos % NUM_SLOTS];
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == pos)
+        {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (sequence < pos)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    slot->timestamp = (static_cast<int64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    slot->socket = socket;
+    slot->peer_address = peer_address;
+    slot->peer_port = peer_port;
+    slot->sent = sent;
+    slot->length = static_cast<uint32_t>(length);
+    std::memcpy(slot->data.data(), data, std::min<size_t>(length, SNAP_LENGTH));
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void NetworkCapture::write_loop()
+{
+    ServiceThreads::get().register_current("NetworkCapture", THREAD_POOL::IO);
+    FILE* out = static_cast<FILE*>(file);
+    std::unordered_map<uint64_t, sockaddr_in> local_addresses;
+    std::vector<char> buffer;
+    uint64_t reported_dropped{0};
+
+    // One more round after the capture is stopped, the hooks that claimed a slot before that have written it by then
+    bool last_round{false};
+    while (!last_round)
+    {
+        last_round = !running.load(std::memory_order_acquire);
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+        buffer.clear();
+        while (true)
+        {
+            Slot& slot = slots[tail % NUM_SLOTS];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+                break;
+
+            // The local side of the socket isn't known in the hook, looked up here once per socket instead
+            auto [it, inserted] = local_addresses.try_emplace(slot.socket);
+            if (inserted)
+            {
+                int size = sizeof(it->second);
+                if (getsockname(static_cast<SOCKET>(slot.socket), reinterpret_cast<sockaddr*>(&it->second), &size) != 0)
+                    it->second = sockaddr_in{};
+            }
+            const sockaddr_in& local = it->second;
+
+            const uint32_t captured = std::min<uint32_t>(slot.length, SNAP_LENGTH);
+            const int64_t unix_time = (slot.timestamp - g_filetime_unix_epoch) / 10;
+            const PcapRecord record{
+                static_cast<uint32_t>(unix_time / 1000000),
+                static_cast<uint32_t>(unix_time % 1000000),
+                static_cast<uint32_t>(sizeof(Ipv4UdpHeader) + captured),
+                static_cast<uint32_t>(sizeof(Ipv4UdpHeader) + slot.length),
+            };
+            Ipv4UdpHeader ip{};
+            ip.total_length = htons(static_cast<uint16_t>(sizeof(Ipv4UdpHeader) + slot.length));
+            ip.udp_length = htons(static_cast<uint16_t>(8 + slot.length));
+            ip.source = slot.sent ? local.sin_addr.s_addr : slot.peer_address;
+            ip.destination = slot.sent ? slot.peer_address : local.sin_addr.s_addr;
+            ip.source_port = slot.sent ? local.sin_port : slot.peer_port;
+            ip.destination_port = slot.sent ? slot.peer_port : local.sin_port;
+
+            buffer.insert(buffer.end(), reinterpret_cast<const char*>(&record), reinterpret_cast<const char*>(&record + 1));
+            buffer.insert(buffer.end(), reinterpret_cast<const char*>(&ip), reinterpret_cast<const char*>(&ip + 1));
+            buffer.insert(buffer.end(), slot.data.begin(), slot.data.begin() + captured);
+
+            slot.sequence.store(tail + NUM_SLOTS, std::memory_order_release);
+            tail++;
+        }
+
+        if (!buffer.empty())
+        {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+            fflush(out);
+        }
+
+        const uint64_t now_dropped = dropped.load(std::memory_order_relaxed);
+        if (now_dropped != reported_dropped)
+        {
+            DEBUG("Network capture ring was full, {} packets dropped so far", now_dropped);
+            reported_dropped = now_dropped;
+        }
+    }
+
+    fclose(out);
+    file = nullptr;
+    writing.store(false, std::memory_order_release);
+}
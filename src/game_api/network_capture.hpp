@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>   // for array
+#include <atomic>  // for atomic
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t, uint32_t, uint16_t, int64_t, uint8_t
+#include <string>  // for string
+
+// Captures the datagrams the game sends and receives into a pcap file without slowing down the thread that sends them
+// The hooks only copy the packet into a preallocated ring, a background thread turns the ring into pcap records and writes them
+class NetworkCapture
+{
+  public:
+    static NetworkCapture& get();
+
+    // Opens the file and starts the writer thread, false if the file can't be opened or a capture is already running
+    // or the previous one is still finishing its file
+    bool start(const std::string& path);
+    // The writer thread writes what's left in the ring, closes the file and exits, so the capture can be started again
+    void stop();
+    bool is_running() const;
+
+    // Called from the network hooks, on any thread, never blocks, drops the packet if the ring is full
+    void record(bool sent, uint64_t socket, uint32_t peer_address, uint16_t peer_port, const char* data, int length);
+
+  private:
+    NetworkCapture() = default;
+
+    // Most game packets are way smaller, longer ones are cut but keep their real length in the record
+    static constexpr size_t SNAP_LENGTH = 1472;
+    static constexpr size_t NUM_SLOTS = 4096;
+
+    struct Slot
+    {
+        // Equal to the write position the slot is free for, one more once it's written
+        std::atomic<uint64_t> sequence;
+        // FILETIME as from GetSystemTimePreciseAsFileTime
+        int64_t timestamp;
+        uint64_t socket;
+        // Network byte order, like in sockaddr_in
+        uint32_t peer_address;
+        uint16_t peer_port;
+        bool sent;
+        uint32_t length;
+        std::array<uint8_t, SNAP_LENGTH> data;
+    };
+
+    void write_loop();
+
+    Slot* slots{nullptr};
+    std::atomic<uint64_t> head{0};
+    uint64_t tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> running{false};
+    // Set from start until the writer thread closed the file
+    std::atomic<bool> writing{false};
+    void* file{nullptr};
+};
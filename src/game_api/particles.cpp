@@ -1,6 +1,6 @@
 #include "particles.hpp"
 
-#include <algorithm>     // for sort
+#include <algorithm>     // for sort, find
 #include <functional>    // for equal_to
 #include <list>          // for _List_iterator, _List_const_iterator
 #include <new>           // for operator new
@@ -155,3 +155,144 @@ void extinguish_particles(ParticleEmitterInfo* particle_emitter)
         generic_free(particle_emitter);
     }
 }
+
+void advance_and_render_screen_particles(const std::vector<ParticleEmitterInfo*>& particle_emitters)
+{
+    static size_t advance_offset = get_address("advance_screen_particles");
+    static size_t render_offset = get_address("render_screen_particles");
+    if (advance_offset == 0 || render_offset == 0)
+        return;
+
+    typedef void advance_particles_func(ParticleEmitterInfo*);
+    typedef void render_particles_func(ParticleEmitterInfo*, size_t, size_t, size_t);
+    static advance_particles_func* apf = (advance_particles_func*)(advance_offset);
+    static render_particles_func* rpf = (render_particles_func*)(render_offset);
+    for (ParticleEmitterInfo* particle_emitter : particle_emitters)
+    {
+        if (particle_emitter != nullptr)
+        {
+            apf(particle_emitter);
+            rpf(particle_emitter, 0, 0, 0);
+        }
+    }
+}
+
+ParticleEmitterPool::~ParticleEmitterPool()
+{
+    clear();
+}
+
+int32_t ParticleEmitterPool::generate_world(PARTICLEEMITTER particle_emitter_id, uint32_t uid)
+{
+    return add(generate_world_particles(particle_emitter_id, uid), true);
+}
+int32_t ParticleEmitterPool::generate_screen(PARTICLEEMITTER particle_emitter_id, float x, float y)
+{
+    return add(generate_screen_particles(particle_emitter_id, x, y), false);
+}
+
+int32_t ParticleEmitterPool::add(ParticleEmitterInfo* particle_emitter, bool world)
+{
+    if (particle_emitter == nullptr)
+        return -1;
+
+    if (cap > 0 && emitters.size() >= cap)
+    {
+        release(emitters.front());
+        emitters.erase(emitters.begin());
+    }
+    const int32_t id = next_id++;
+    emitters.push_back({id, particle_emitter, world, false});
+    return id;
+}
+
+ParticleEmitterInfo* ParticleEmitterPool::get(int32_t id) const
+{
+    auto it = std::find_if(emitters.begin(), emitters.end(), [id](const Entry& entry)
+                           { return entry.id == id; });
+    return it != emitters.end() ? it->emitter : nullptr;
+}
+
+bool ParticleEmitterPool::extinguish(int32_t id)
+{
+    auto it = std::find_if(emitters.begin(), emitters.end(), [id](const Entry& entry)
+                           { return entry.id == id; });
+    if (it == emitters.end())
+        return false;
+    release(*it);
+    emitters.erase(it);
+    return true;
+}
+bool ParticleEmitterPool::extinguish(ParticleEmitterInfo* particle_emitter)
+{
+    auto it = std::find_if(emitters.begin(), emitters.end(), [particle_emitter](const Entry& entry)
+                           { return entry.emitter == particle_emitter; });
+    if (it == emitters.end())
+        return false;
+    release(*it);
+    emitters.erase(it);
+    return true;
+}
+
+void ParticleEmitterPool::release(const Entry& entry)
+{
+    // The game frees the world emitters itself when the level unloads, the ones it doesn't know anymore are only forgotten
+    if (entry.world)
+    {
+        const auto& world_emitters = *get_state_ptr()->particle_emitters;
+        if (std::find(world_emitters.begin(), world_emitters.end(), entry.emitter) == world_emitters.end())
+            return;
+    }
+    extinguish_particles(entry.emitter);
+}
+
+void ParticleEmitterPool::collect_finished()
+{
+    std::erase_if(emitters, [this](Entry& entry)
+                  {
+                      ParticleEmitterInfo* particle_emitter = entry.emitter;
+                      if (entry.world)
+                      {
+                          const auto& world_emitters = *get_state_ptr()->particle_emitters;
+                          if (std::find(world_emitters.begin(), world_emitters.end(), particle_emitter) == world_emitters.end())
+                              return true;
+                      }
+                      if (particle_emitter->particle_type->permanent)
+                          return false;
+
+                      const uint32_t particle_count = particle_emitter->emitted_particles.particle_count + particle_emitter->emitted_particles_back_layer.particle_count;
+                      if (particle_count > 0)
+                      {
+                          entry.emitted = true;
+                          return false;
+                      }
+                      if (!entry.emitted)
+                          return false;
+                      extinguish_particles(particle_emitter);
+                      return true; });
+}
+
+void ParticleEmitterPool::forget_world()
+{
+    std::erase_if(emitters, [](const Entry& entry)
+                  { return entry.world; });
+}
+
+void ParticleEmitterPool::clear()
+{
+    for (const Entry& entry : emitters)
+    {
+        release(entry);
+    }
+    emitters.clear();
+}
+
+void ParticleEmitterPool::set_cap(uint32_t new_cap)
+{
+    cap = new_cap;
+    while (cap > 0 && emitters.size() > cap)
+    {
+        release(emitters.front());
+        emitters.erase(emitters.begin());
+    }
+}
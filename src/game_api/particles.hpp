@@ -273,3 +273,63 @@ ParticleEmitterInfo* generate_screen_particles(PARTICLEEMITTER particle_emitter_
 void advance_screen_particles(ParticleEmitterInfo* particle_emitter);
 void render_screen_particles(ParticleEmitterInfo* particle_emitter);
 void extinguish_particles(ParticleEmitterInfo* particle_emitter);
+// Advances and renders every screen emitter in the list, skipping null ones
+void advance_and_render_screen_particles(const std::vector<ParticleEmitterInfo*>& particle_emitters);
+
+// Owns the emitters created through it, they are all extinguished with the pool
+// Emitters that aren't permanent are extinguished on their own once all their particles are gone, and when the cap is reached the oldest one makes room for the new one
+// The emitters are handed out by id, since the pool may free one at any time and the game can allocate a new emitter at the same address
+class ParticleEmitterPool
+{
+  public:
+    static constexpr uint32_t DEFAULT_CAP = 64;
+
+    ParticleEmitterPool() = default;
+    ParticleEmitterPool(const ParticleEmitterPool&) = delete;
+    ParticleEmitterPool& operator=(const ParticleEmitterPool&) = delete;
+    ~ParticleEmitterPool();
+
+    // Id of the new emitter, -1 if the game didn't make one
+    int32_t generate_world(PARTICLEEMITTER particle_emitter_id, uint32_t uid);
+    int32_t generate_screen(PARTICLEEMITTER particle_emitter_id, float x, float y);
+
+    // The emitter while the pool still owns it, nullptr once it was extinguished
+    ParticleEmitterInfo* get(int32_t id) const;
+    // Extinguishes the emitter if the pool still owns it, false if it doesn't
+    bool extinguish(int32_t id);
+    bool extinguish(ParticleEmitterInfo* particle_emitter);
+
+    // Extinguishes the finished emitters, call once per frame
+    void collect_finished();
+    // Drops the world emitters without extinguishing them, the game frees them with the level
+    void forget_world();
+    void clear();
+
+    void set_cap(uint32_t new_cap);
+    uint32_t get_cap() const
+    {
+        return cap;
+    }
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(emitters.size());
+    }
+
+  private:
+    struct Entry
+    {
+        int32_t id;
+        ParticleEmitterInfo* emitter;
+        bool world;
+        // Whether the emitter had particles already, a new one can be empty for a few frames before it emits anything
+        bool emitted;
+    };
+
+    int32_t add(ParticleEmitterInfo* particle_emitter, bool world);
+    void release(const Entry& entry);
+
+    // Oldest first
+    std::vector<Entry> emitters;
+    uint32_t cap{DEFAULT_CAP};
+    int32_t next_id{0};
+};
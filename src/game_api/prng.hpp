@@ -1,10 +1,12 @@
 #pragma once
 
+#include <array>    // for array
 #include <cstddef>  // for size_t
 #include <cstdint>  // for int64_t, uint64_t
 #include <limits>   // for numeric_limits
 #include <optional> // for optional
 #include <utility>  // for pair
+#include <vector>   // for vector
 
 struct PRNG
 {
@@ -100,6 +102,10 @@ struct PRNG
     {
         return random_int(min, max, static_cast<PRNG_CLASS>(7));
     }
+    /// Generate `count` integers in the range `[min, max]`, gives the same numbers as calling `random_int` `count` times
+    std::vector<std::int64_t> random_ints(std::size_t count, std::int64_t min, std::int64_t max, PRNG_CLASS type);
+    /// Generate `count` floating point numbers in the range `[0, 1)`, gives the same numbers as calling `random_float` `count` times
+    std::vector<float> random_floats(std::size_t count, PRNG_CLASS type);
 
   private:
     /// Generate a random integer in the range `[min, size]`, returns `nil` if `min <= size`
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>   // for array
+#include <cstdint> // for uint64_t, int64_t
+#include <limits>  // for numeric_limits
+#include <utility> // for pair
+
+// The PRNG math on its own, doesn't touch game memory so it can also be used by tools that run without the game
+
+using prng_pair = std::pair<std::uint64_t, std::uint64_t>;
+using prng_pairs = std::array<prng_pair, 10>;
+
+inline prng_pairs seed_prng_pairs(std::int64_t seed)
+{
+    std::uint64_t useed = static_cast<std::uint64_t>(seed);
+
+    prng_pairs pairs;
+    for (prng_pair& pair : pairs)
+    {
+        // advance state
+        useed = (std::uint64_t((useed & 0xffffffff) == 0) - (useed & 0xffffffff)) * -0x61939c2f98956567;
+        useed = (((useed >> 0x1c) ^ useed) >> 0x17) ^ useed;
+
+        // generate next pair
+        pair.first = useed * -0x61939c2f98956567;
+        pair.second = (useed * -0x7cc4ab2b38000000 | pair.first >> 0x25) * -0x61939c2f98956567;
+        pair.first = (pair.first >> 0x1c ^ pair.first) >> 0x17 ^ pair.first;
+    }
+    return pairs;
+}
+
+inline void advance_prng_pair(prng_pair& pair)
+{
+    const std::uint64_t lower = pair.first;
+    const std::uint64_t upper = pair.second;
+
+    const std::uint64_t rest = upper - lower;
+
+    pair = {
+        static_cast<std::uint64_t>(static_cast<std::int64_t>(upper) * -0x2c7cc17fb0b3a8b5),
+        rest * 0x8000000 | rest >> 0x25,
+    };
+}
+
+/// Maps `val` to the range `[min, max)`
+inline std::int64_t wrap_prng_random(std::int64_t val, std::int64_t min, std::int64_t max)
+{
+    const auto diff = max - min;
+
+    if (val < min)
+        val += diff * ((min - val) / diff + 1);
+
+    return min + (val - min) % diff;
+}
+
+inline float prng_pair_to_float(const prng_pair& pair)
+{
+    return static_cast<float>(pair.first) / static_cast<float>(std::numeric_limits<std::uint64_t>::max());
+}
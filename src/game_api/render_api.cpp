@@ -6,13 +6,17 @@
 #include <detours.h>    // for DetourAttach, DetourTransactionBegin
 #include <fmt/format.h> // for check_format_string, format, vformat
 #include <list>         // for _List_iterator, _List_const_iterator
+#include <memory>       // for unique_ptr, make_unique
 #include <optional>     // for optional, nullopt
 #include <string>       // for operator""sv, string, wstring, all...
 #include <string_view>  // for string_view
 #include <vector>       // for vector
 
+#include "detour_transaction.hpp" // for hook_transaction_begin, hook_transaction_commit
 #include "entity.hpp"             // for Entity, EntityDB
 #include "game_api.hpp"           //
+#include "gpu_timing.hpp"         // for GpuSectionScope, GPU_SECTION
+#include "illumination.hpp"       // for cull_lightsources
 #include "level_api.hpp"          // for ThemeInfo
 #include "logger.h"               // for DEBUG
 #include "memory.hpp"             // for memory_read, to_le_bytes, write_mem_prot
@@ -20,9 +24,12 @@
 #include "script/events.hpp"      // for trigger_vanilla_render_journal_pag...
 #include "script/lua_backend.hpp" // for ON, ON::RENDER_POST_JOURNAL_PAGE
 #include "search.hpp"             // for get_address
+#include "settings_api.hpp"       // for get_setting, GAME_SETTING
+#include "shader_cache.hpp"       // for ShaderCache
 #include "state.hpp"              // for StateMemory
 #include "strings.hpp"            //
 #include "texture.hpp"            // for Texture, get_textures, get_texture
+#include "turbo.hpp"              // for Turbo
 
 class JournalPage;
 struct Camera;
@@ -67,11 +74,14 @@ float g_layer_zoom_offset[2]{0};
 
 using RenderLayer = void(const std::vector<Illumination*>&, uint8_t, const Camera&, const char**, const char**);
 RenderLayer* g_render_layer_trampoline{nullptr};
-void render_layer(const std::vector<Illumination*>& lightsources, uint8_t layer, const Camera& camera, const char** lut_lhs, const char** lut_rhs)
+void render_layer(const std::vector<Illumination*>& all_lightsources, uint8_t layer, const Camera& camera, const char** lut_lhs, const char** lut_rhs)
 {
     if (trigger_vanilla_render_layer_callbacks(ON::RENDER_PRE_LAYER, layer))
         return;
 
+    // The game's vector isn't touched, it owns the lights and frees them
+    const std::vector<Illumination*>& lightsources = cull_lightsources(all_lightsources);
+
     auto game_api = GameAPI::get();
     g_layer_zoom_offset[layer] = game_api->renderer->current_zoom_offset;
 
@@ -81,11 +91,15 @@ void render_layer(const std::vector<Illumination*>& lightsources, uint8_t layer,
     {
         if (Texture* lut = get_texture(g_forced_lut_textures[layer].value()))
         {
+            GpuSectionScope gpu_section{GPU_SECTION::RENDER_LAYER};
             g_render_layer_trampoline(lightsources, layer, camera, lut->name, lut->name);
             return;
         }
     }
-    g_render_layer_trampoline(lightsources, layer, camera, lut_lhs, lut_rhs);
+    {
+        GpuSectionScope gpu_section{GPU_SECTION::RENDER_LAYER};
+        g_render_layer_trampoline(lightsources, layer, camera, lut_lhs, lut_rhs);
+    }
     trigger_vanilla_render_layer_callbacks(ON::RENDER_POST_LAYER, layer);
 }
 
@@ -95,7 +109,10 @@ void render_level(StateMemory* state, uint8_t layer, uint8_t c)
 {
     if (trigger_vanilla_render_layer_callbacks(ON::RENDER_PRE_LEVEL, layer))
         return;
-    g_render_level_trampoline(state, layer, c);
+    {
+        GpuSectionScope gpu_section{GPU_SECTION::RENDER_LEVEL};
+        g_render_level_trampoline(state, layer, c);
+    }
     trigger_vanilla_render_layer_callbacks(ON::RENDER_POST_LEVEL, layer);
 }
 
@@ -103,6 +120,10 @@ using RenderGame = void(StateMemory*);
 RenderGame* g_render_game_trampoline{nullptr};
 void render_game(StateMemory* state)
 {
+    static const auto& turbo = Turbo::get();
+    // Nobody sees the frames turbo doesn't present anyway
+    if (!turbo.should_render())
+        return;
     if (trigger_vanilla_render_callbacks(ON::RENDER_PRE_GAME))
         return;
     g_render_game_trampoline(state);
@@ -135,7 +156,10 @@ void render_hud(size_t hud_data, float y, float opacity, size_t hud_data2)
     Hud hud{y, opacity, (HudData*)hud_data};
     if (trigger_vanilla_render_hud_callbacks(ON::RENDER_PRE_HUD, &hud))
         return;
-    g_render_hud_trampoline(hud_data, hud.y - g_advanced_hud * 0.004f, hud.opacity, hud_data2);
+    {
+        GpuSectionScope gpu_section{GPU_SECTION::RENDER_HUD};
+        g_render_hud_trampoline(hud_data, hud.y - g_advanced_hud * 0.004f, hud.opacity, hud_data2);
+    }
     trigger_vanilla_render_hud_callbacks(ON::RENDER_POST_HUD, &hud);
 }
 
@@ -165,7 +189,10 @@ void render_draw_depth(Layer* layer, uint8_t draw_depth, float bbox_left, float
 {
     if (trigger_vanilla_render_draw_depth_callbacks(ON::RENDER_PRE_DRAW_DEPTH, draw_depth, {bbox_left, bbox_top, bbox_right, bbox_bottom}))
         return;
-    g_render_draw_depth_trampoline(layer, draw_depth, bbox_left, bbox_bottom, bbox_right, bbox_top);
+    {
+        GpuSectionScope gpu_section{GPU_SECTION::RENDER_DRAW_DEPTH};
+        g_render_draw_depth_trampoline(layer, draw_depth, bbox_left, bbox_bottom, bbox_right, bbox_top);
+    }
     trigger_vanilla_render_draw_depth_callbacks(ON::RENDER_POST_DRAW_DEPTH, draw_depth, {bbox_left, bbox_top, bbox_right, bbox_bottom});
 }
 
@@ -393,11 +420,78 @@ void RenderAPI::draw_text(const TextRenderingInfo* tri, Color color)
     }
 }
 
+namespace
+{
+struct PreparedTextKey
+{
+    std::string text;
+    float scale_x;
+    float scale_y;
+    uint32_t alignment;
+    uint32_t fontstyle;
+    // Fonts change with the language
+    uint32_t language;
+
+    bool operator==(const PreparedTextKey&) const = default;
+};
+struct PreparedTextKeyHash
+{
+    size_t operator()(const PreparedTextKey& key) const
+    {
+        size_t hash = std::hash<std::string>{}(key.text);
+        const auto combine = [&](size_t value)
+        { hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2); };
+        combine(std::hash<float>{}(key.scale_x));
+        combine(std::hash<float>{}(key.scale_y));
+        combine(key.alignment | (size_t)key.fontstyle << 8 | (size_t)key.language << 16);
+        return hash;
+    }
+};
+struct PreparedText
+{
+    PreparedTextKey key;
+    std::unique_ptr<TextRenderingInfo> tri;
+};
+
+// Least recently used at the back
+constexpr size_t g_prepared_texts_capacity = 256;
+std::list<PreparedText> g_prepared_texts;
+std::unordered_map<PreparedTextKey, std::list<PreparedText>::iterator, PreparedTextKeyHash> g_prepared_text_lookup;
+} // namespace
+
+TextRenderingInfo* RenderAPI::get_prepared_text(const std::string& text, float x, float y, float scale_x, float scale_y, uint32_t alignment, uint32_t fontstyle)
+{
+    PreparedTextKey key{text, scale_x, scale_y, alignment, fontstyle, get_setting(GAME_SETTING::LANGUAGE).value_or(0)};
+    if (auto it = g_prepared_text_lookup.find(key); it != g_prepared_text_lookup.end())
+    {
+        g_prepared_texts.splice(g_prepared_texts.begin(), g_prepared_texts, it->second);
+        // Letters are relative to the text position, so only that has to change
+        TextRenderingInfo* tri = it->second->tri.get();
+        tri->x = x;
+        tri->y = y;
+        return tri;
+    }
+
+    if (g_prepared_texts.size() >= g_prepared_texts_capacity)
+    {
+        g_prepared_text_lookup.erase(g_prepared_texts.back().key);
+        g_prepared_texts.pop_back();
+    }
+    auto tri = std::make_unique<TextRenderingInfo>();
+    tri->set_text(text, x, y, scale_x, scale_y, alignment, fontstyle);
+    g_prepared_texts.push_front({key, std::move(tri)});
+    g_prepared_text_lookup.emplace(std::move(key), g_prepared_texts.begin());
+    return g_prepared_texts.front().tri.get();
+}
+void RenderAPI::clear_prepared_texts()
+{
+    g_prepared_text_lookup.clear();
+    g_prepared_texts.clear();
+}
+
 std::pair<float, float> RenderAPI::draw_text_size(const std::string& text, float scale_x, float scale_y, uint32_t fontstyle)
 {
-    TextRenderingInfo tri{};
-    tri.set_text(text, 0, 0, scale_x, scale_y, 1 /*center*/, fontstyle);
-    return tri.text_size();
+    return get_prepared_text(text, 0, 0, scale_x, scale_y, 1 /*center*/, fontstyle)->text_size();
 }
 
 void RenderAPI::draw_screen_texture(Texture* texture, Quad source, Quad dest, Color color, uint8_t shader)
@@ -481,6 +575,108 @@ void RenderAPI::draw_world_texture(Texture* texture, Quad source, Quad dest, Col
     }
 }
 
+namespace
+{
+size_t batch_size(const std::vector<Quad>& sources, const std::vector<Quad>& dests, const std::vector<Color>& colors)
+{
+    if (sources.empty() || colors.empty())
+        return 0;
+    if (sources.size() != 1 && sources.size() != dests.size())
+        return 0;
+    if (colors.size() != 1 && colors.size() != dests.size())
+        return 0;
+    return dests.size();
+}
+} // namespace
+
+void RenderAPI::draw_screen_textures(Texture* texture, const std::vector<Quad>& sources, const std::vector<Quad>& dests, const std::vector<Color>& colors, uint8_t shader)
+{
+    static size_t offset = get_address("draw_screen_texture");
+    const size_t count = batch_size(sources, dests, colors);
+    if (offset == 0 || count == 0)
+        return;
+
+    typedef void render_func(TextureRenderingInfo*, uint8_t, const char**, Color*);
+    static render_func* rf = (render_func*)(offset);
+    const char** texture_name = texture == nullptr ? nullptr : texture->name;
+
+    const bool single_source = sources.size() == 1;
+    const bool single_color = colors.size() == 1;
+    Color color;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Quad& source = sources[single_source ? 0 : i];
+        const Quad& dest = dests[i];
+        TextureRenderingInfo tri = {
+            0,
+            0,
+            // DESTINATION
+            dest.bottom_left_x,
+            dest.bottom_left_y,
+            dest.bottom_right_x,
+            dest.bottom_right_y,
+            dest.top_left_x,
+            dest.top_left_y,
+            dest.top_right_x,
+            dest.top_right_y,
+
+            // SOURCE
+            source.bottom_left_x,
+            source.bottom_left_y,
+            source.bottom_right_x,
+            source.bottom_right_y,
+            source.top_left_x,
+            source.top_left_y,
+            source.top_right_x,
+            source.top_right_y,
+        };
+        // the game may write to the color, so it's copied every time
+        color = colors[single_color ? 0 : i];
+        rf(&tri, shader, texture_name, &color);
+    }
+}
+
+void RenderAPI::draw_world_textures(Texture* texture, const std::vector<Quad>& sources, const std::vector<Quad>& dests, const std::vector<Color>& colors, WorldShader shader)
+{
+    static const size_t func_offset = get_address("draw_world_texture"sv);
+    static const size_t param_7 = get_address("draw_world_texture_param_7"sv);
+    const size_t count = batch_size(sources, dests, colors);
+    if (func_offset == 0 || count == 0)
+        return;
+
+    typedef void render_func(Renderer*, WorldShader, const char*** texture_name, uint32_t render_as_non_liquid, float* destination, Quad* source, void*, Color*, float*);
+    static render_func* rf = (render_func*)(func_offset);
+    Renderer* renderer_ptr = renderer();
+    auto texture_name = texture->name;
+
+    const bool single_source = sources.size() == 1;
+    const bool single_color = colors.size() == 1;
+    const float unknown = 21;
+    float destination[12];
+    Quad source;
+    Color color;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Quad& dest = dests[i];
+        destination[0] = dest.bottom_left_x;
+        destination[1] = dest.bottom_left_y;
+        destination[2] = unknown;
+        destination[3] = dest.bottom_right_x;
+        destination[4] = dest.bottom_right_y;
+        destination[5] = unknown;
+        destination[6] = dest.top_right_x;
+        destination[7] = dest.top_right_y;
+        destination[8] = unknown;
+        destination[9] = dest.top_left_x;
+        destination[10] = dest.top_left_y;
+        destination[11] = unknown;
+
+        source = sources[single_source ? 0 : i];
+        color = colors[single_color ? 0 : i];
+        rf(renderer_ptr, shader, &texture_name, 1, destination, &source, (void*)param_7, &color, nullptr);
+    }
+}
+
 void RenderAPI::set_post_render_game(void (*post_render_game)())
 {
     g_post_render_game = post_render_game;
@@ -620,8 +816,10 @@ void init_render_api_hooks()
 
     g_prepare_text_trampoline = (PrepareTextFun*)get_address("prepare_text_for_rendering");
 
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
+    // reload_shaders compiles through D3DCompile, which looks in the cache first
+    ShaderCache::get().init();
+
+    hook_transaction_begin();
 
     DetourAttach((void**)&g_render_loading_trampoline, &render_loading);
     DetourAttach((void**)&g_render_layer_trampoline, &render_layer);
@@ -650,7 +848,7 @@ void init_render_api_hooks()
 
     DetourAttach((void**)&g_prepare_text_trampoline, prepare_text);
 
-    const LONG error = DetourTransactionCommit();
+    const LONG error = hook_transaction_commit();
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking render_api: {}\n", error);
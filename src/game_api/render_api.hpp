@@ -10,6 +10,7 @@
 #include <type_traits>   // for hash
 #include <unordered_map> // for _Umap_traits<>::allocator_type, unordered_map
 #include <utility>       // for pair
+#include <vector>        // for vector
 
 #include "aliases.hpp"                       // for TEXTURE
 #include "color.hpp"                         // for Color
@@ -246,10 +247,18 @@ struct RenderAPI
     void reset_lut(uint8_t layer);
 
     void draw_text(const TextRenderingInfo* tri, Color color);
+    // Same as set_text on a new TextRenderingInfo, but keeps the last prepared texts around so drawing the same string again doesn't prepare it again
+    // The returned pointer is only valid until the next call
+    TextRenderingInfo* get_prepared_text(const std::string& text, float x, float y, float scale_x, float scale_y, uint32_t alignment, uint32_t fontstyle);
+    // Called when a script is reset
+    void clear_prepared_texts();
     std::pair<float, float> draw_text_size(const std::string& text, float scale_x, float scale_y, uint32_t fontstyle);
     void draw_screen_texture(Texture* texture, Quad source, Quad dest, Color color, uint8_t shader);
     void draw_screen_texture(Texture* texture, TextureRenderingInfo tri, Color color, uint8_t shader);
     void draw_world_texture(Texture* texture, Quad source, Quad dest, Color color, WorldShader shader);
+    // Draws `dests.size()` quads with the same texture, `sources` and `colors` can hold a single element that is used for all quads
+    void draw_screen_textures(Texture* texture, const std::vector<Quad>& sources, const std::vector<Quad>& dests, const std::vector<Color>& colors, uint8_t shader);
+    void draw_world_textures(Texture* texture, const std::vector<Quad>& sources, const std::vector<Quad>& dests, const std::vector<Color>& colors, WorldShader shader);
 
     void set_post_render_game(void (*post_render_game)());
     void set_advanced_hud();
@@ -349,6 +358,12 @@ struct RenderInfo
     // for supporting HookableVTable
     uint32_t get_aux_id() const;
 
+    /* for the autodoc
+    /// Pass this RenderInfo to a batch callback made with [set_render_batch_callback](#set_render_batch_callback) each time it's rendered, instead of giving it a render callback of its own.
+    /// Returns the id to remove it from the batch with `clear_virtual`, or `nil` if `batch_id` is not a render batch of this script
+    optional<CallbackId> add_to_render_batch(CallbackId batch_id);
+    */
+
     bool set_second_texture(TEXTURE texture_id);
     bool set_third_texture(TEXTURE texture_id);
     /// Set the number of textures that may be used, need to have them set before for it to work
@@ -1,8 +1,9 @@
 #include "rpc.hpp"
 
 #include <Windows.h>        // for VirtualFree, MEM_RELEASE, GetCurrent...
+#include <algorithm>        // for min, max
 #include <array>            // for array
-#include <cmath>            // for round, pow, sqrt
+#include <cmath>            // for round, pow, sqrt, floor
 #include <cstring>          // for size_t, memcpy
 #include <detours.h>        // for DetourAttach, DetourTransactionBegin
 #include <fmt/format.h>     // for check_format_string, format, vformat
@@ -37,7 +38,7 @@
 #include "illumination.hpp"             //
 #include "items.hpp"                    // for Items
 #include "layer.hpp"                    // for EntityList, EntityList::Range, Layer
-#include "liquid_engine.hpp"            // for LiquidPhysicsEngine
+#include "liquid_engine.hpp"            // for LiquidPhysicsEngine, LiquidAmounts
 #include "logger.h"                     // for DEBUG
 #include "math.hpp"                     // for AABB
 #include "memory.hpp"                   // for write_mem_prot, write_mem_recoverable
@@ -70,6 +71,7 @@ uint32_t flipflag(uint32_t flags, int bit)
 
 void attach_entity(Entity* overlay, Entity* attachee)
 {
+    AbsPositionScope::invalidate();
     if (attachee->overlay)
     {
         if (attachee->overlay == overlay)
@@ -159,6 +161,7 @@ void move_entity_abs(uint32_t uid, float x, float y, float vx, float vy)
         }
         else
         {
+            AbsPositionScope::invalidate();
             ent->detach(false);
             ent->x = x;
             ent->y = y;
@@ -172,6 +175,15 @@ void move_entity_abs(uint32_t uid, float x, float y, float vx, float vy)
     }
 }
 
+void move_entities_abs(const std::vector<uint32_t>& uids, const std::vector<float>& xs, const std::vector<float>& ys)
+{
+    const size_t count = std::min({uids.size(), xs.size(), ys.size()});
+    for (size_t i = 0; i < count; ++i)
+    {
+        move_entity_abs(uids[i], xs[i], ys[i], 0.0f, 0.0f);
+    }
+}
+
 void move_entity_abs(uint32_t uid, float x, float y, float vx, float vy, LAYER layer)
 {
     auto ent = get_entity_ptr(uid);
@@ -185,6 +197,7 @@ void move_entity_abs(uint32_t uid, float x, float y, float vx, float vy, LAYER l
         }
         else
         {
+            AbsPositionScope::invalidate();
             ent->detach(false);
             ent->x = offset.x + x;
             ent->y = offset.y + y;
@@ -239,9 +252,10 @@ float screen_distance(float x)
 std::vector<uint32_t> filter_entities(std::vector<uint32_t> entities, std::function<bool(Entity*)> predicate)
 {
     std::vector<uint32_t> filtered_entities{std::move(entities)};
+    const StateScope state;
     auto filter_fun = [&](uint32_t uid)
     {
-        if (Entity* entity = get_entity_ptr(uid))
+        if (Entity* entity = state.get_entity(uid))
         {
             return !predicate(entity);
         }
@@ -251,6 +265,27 @@ std::vector<uint32_t> filter_entities(std::vector<uint32_t> entities, std::funct
     return filtered_entities;
 }
 
+std::vector<uint32_t> filter_entities(std::vector<uint32_t> entities, const EntityFilter& filter)
+{
+    // The player layers depend on where the player is, looked up once instead of for every entity
+    EntityFilter resolved{filter};
+    if (resolved.layer != LAYER::BOTH)
+        resolved.layer = static_cast<LAYER>(enum_to_layer(filter.layer));
+
+    std::vector<uint32_t> filtered_entities{std::move(entities)};
+    const StateScope state;
+    auto filter_fun = [&](uint32_t uid)
+    {
+        if (Entity* entity = state.get_entity(uid))
+        {
+            return !resolved.matches(entity);
+        }
+        return true;
+    };
+    std::erase_if(filtered_entities, filter_fun);
+    return filtered_entities;
+}
+
 void set_contents(uint32_t uid, ENT_TYPE item_entity_type)
 {
     Entity* container = get_entity_ptr(uid);
@@ -572,39 +607,45 @@ std::pair<int64_t, int64_t> get_adventure_seed(std::optional<bool> run_start)
     }
 }
 
-void update_liquid_collision_at(float x, float y, bool add, std::optional<LAYER> layer)
+using UpdateLiquidCollision = void(LiquidPhysics*, int32_t, int32_t, uint8_t);
+static UpdateLiquidCollision* get_update_liquid_collision_fun(bool add)
 {
-    using UpdateLiquidCollision = void(LiquidPhysics*, int32_t, int32_t, uint8_t);
     static UpdateLiquidCollision* RemoveLiquidCollision_fun = (UpdateLiquidCollision*)get_address("remove_from_liquid_collision_map");
     static UpdateLiquidCollision* AddLiquidCollision_fun = (UpdateLiquidCollision*)get_address("add_to_liquid_collision_map");
+    return add ? AddLiquidCollision_fun : RemoveLiquidCollision_fun;
+}
+
+void update_liquid_collision_at(float x, float y, bool add, std::optional<LAYER> layer)
+{
     auto state = get_state_ptr();
     uint8_t actual_layer = enum_to_layer(layer.value_or(LAYER::FRONT));
+    get_update_liquid_collision_fun(add)(state->liquid_physics, static_cast<int32_t>(std::round(x)), static_cast<int32_t>(std::round(y)), actual_layer);
+}
 
-    if (add)
-        AddLiquidCollision_fun(state->liquid_physics, static_cast<int32_t>(std::round(x)), static_cast<int32_t>(std::round(y)), actual_layer);
-    else
-        RemoveLiquidCollision_fun(state->liquid_physics, static_cast<int32_t>(std::round(x)), static_cast<int32_t>(std::round(y)), actual_layer);
+void update_liquid_collisions_at(const std::vector<float>& xs, const std::vector<float>& ys, bool add, std::optional<LAYER> layer)
+{
+    // Everything that doesn't depend on the tile is looked up once for the whole list
+    UpdateLiquidCollision* update_fun = get_update_liquid_collision_fun(add);
+    LiquidPhysics* liquid_physics = get_state_ptr()->liquid_physics;
+    const uint8_t actual_layer = enum_to_layer(layer.value_or(LAYER::FRONT));
+    const size_t count = std::min(xs.size(), ys.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        update_fun(liquid_physics, static_cast<int32_t>(std::round(xs[i])), static_cast<int32_t>(std::round(ys[i])), actual_layer);
+    }
 }
 
-void add_entity_to_liquid_collision(uint32_t uid, bool add)
+using AddEntityLiquidCollision = void(LiquidPhysics*, Entity*, uint8_t);
+static void toggle_entity_liquid_collision(LiquidPhysics* liquid_physics, custom_map<uint32_t, size_t*>* map, Entity* entity, bool add)
 {
-    using AddEntityLiquidCollision = void(LiquidPhysics*, Entity*, uint8_t);
     static AddEntityLiquidCollision* add_entity_liquid_collision = (AddEntityLiquidCollision*)get_address("add_movable_to_liquid_collision_map");
-    auto state = get_state_ptr();
-    auto entity = get_entity_ptr(uid);
-    if (!entity)
-        return;
-
-    auto map = state->liquid_physics->push_blocks;
-    if (!map)
-        return;
-
+    const uint32_t uid = entity->uid;
     auto it = map->find(uid);
 
     // if it already exists we can't add it again, since it will create the collision struct anyway and just overwrite the pointer to it in the map
     // the actual collision struct is held somewhere else, unrelated to this map
     if (add && it == map->end())
-        add_entity_liquid_collision(state->liquid_physics, entity, entity->layer);
+        add_entity_liquid_collision(liquid_physics, entity, entity->layer);
     else if (!add && it != map->end())
     {
         // very illegal, don't do this, we can because we're professionals xd
@@ -615,6 +656,34 @@ void add_entity_to_liquid_collision(uint32_t uid, bool add)
     }
 }
 
+void add_entity_to_liquid_collision(uint32_t uid, bool add)
+{
+    auto state = get_state_ptr();
+    auto entity = get_entity_ptr(uid);
+    if (!entity)
+        return;
+
+    auto map = state->liquid_physics->push_blocks;
+    if (!map)
+        return;
+
+    toggle_entity_liquid_collision(state->liquid_physics, map, entity, add);
+}
+
+void add_entities_to_liquid_collision(const std::vector<uint32_t>& uids, bool add)
+{
+    auto state = get_state_ptr();
+    auto map = state->liquid_physics->push_blocks;
+    if (!map)
+        return;
+
+    for (uint32_t uid : uids)
+    {
+        if (auto entity = state->get_entity(uid))
+            toggle_entity_liquid_collision(state->liquid_physics, map, entity, add);
+    }
+}
+
 std::pair<uint8_t, uint8_t> get_liquids_at(float x, float y, LAYER layer)
 {
     uint8_t actual_layer = enum_to_layer(layer);
@@ -633,6 +702,111 @@ std::pair<uint8_t, uint8_t> get_liquids_at(float x, float y, LAYER layer)
     return {liquids_at.water, liquids_at.lava};
 }
 
+static int32_t liquid_cell(float pos)
+{
+    return static_cast<int32_t>(std::floor((pos + 0.5f) / 0.3333333f));
+}
+
+std::pair<uint8_t, uint8_t> LiquidGrid::get(float px, float py) const
+{
+    const int32_t cx = liquid_cell(px) - x;
+    const int32_t cy = liquid_cell(py) - y;
+    if (cx < 0 || cx >= width || cy < 0 || cy >= height)
+        return {0, 0};
+    const size_t i = static_cast<size_t>(cy) * stride + cx;
+    return {water[i], lava[i]};
+}
+
+std::pair<uint32_t, uint32_t> LiquidGrid::sum(float x1, float y1, float x2, float y2) const
+{
+    const int32_t left = std::max(liquid_cell(std::min(x1, x2)) - x, 0);
+    const int32_t right = std::min(liquid_cell(std::max(x1, x2)) - x, width - 1);
+    const int32_t bottom = std::max(liquid_cell(std::min(y1, y2)) - y, 0);
+    const int32_t top = std::min(liquid_cell(std::max(y1, y2)) - y, height - 1);
+    if (left > right || bottom > top)
+        return {0, 0};
+
+    if (!water_sums.empty())
+    {
+        const size_t sums_stride = static_cast<size_t>(width) + 1;
+        auto area = [&](const std::vector<uint32_t>& sums)
+        {
+            return sums[(top + 1) * sums_stride + right + 1] - sums[bottom * sums_stride + right + 1] - sums[(top + 1) * sums_stride + left] + sums[bottom * sums_stride + left];
+        };
+        return {area(water_sums), area(lava_sums)};
+    }
+
+    std::pair<uint32_t, uint32_t> total{0, 0};
+    for (int32_t cy = bottom; cy <= top; ++cy)
+    {
+        const size_t row = static_cast<size_t>(cy) * stride;
+        for (int32_t cx = left; cx <= right; ++cx)
+        {
+            total.first += water[row + cx];
+            total.second += lava[row + cx];
+        }
+    }
+    return total;
+}
+
+LiquidGrid get_liquids_in_rect(float x1, float y1, float x2, float y2, LAYER layer, bool summed_area)
+{
+    constexpr int32_t max_x = static_cast<int32_t>(g_level_max_x * 3);
+    constexpr int32_t max_y = static_cast<int32_t>(g_level_max_y * 3);
+    const int32_t left = std::max(liquid_cell(std::min(x1, x2)), 0);
+    const int32_t right = std::min(liquid_cell(std::max(x1, x2)), max_x - 1);
+    const int32_t bottom = std::max(liquid_cell(std::min(y1, y2)), 0);
+    const int32_t top = std::min(liquid_cell(std::max(y1, y2)), max_y - 1);
+
+    LiquidGrid grid;
+    if (left > right || bottom > top || enum_to_layer(layer) != get_liquid_layer())
+        return grid;
+
+    grid.x = left;
+    grid.y = bottom;
+    grid.width = right - left + 1;
+    grid.height = top - bottom + 1;
+    grid.stride = grid.width;
+    const size_t size = static_cast<size_t>(grid.width) * grid.height;
+    grid.water.resize(size);
+    grid.lava.resize(size);
+
+    // The game keeps both liquids interleaved, split into one plane each so a row of one liquid is contiguous
+    const auto& liquids = *HeapBase::get().liquid_physics()->liquids_by_third_of_tile;
+    size_t out = 0;
+    for (int32_t iy = bottom; iy <= top; ++iy)
+    {
+        const LiquidAmounts* row = liquids[iy];
+        for (int32_t ix = left; ix <= right; ++ix, ++out)
+        {
+            grid.water[out] = row[ix].water;
+            grid.lava[out] = row[ix].lava;
+        }
+    }
+
+    if (summed_area)
+    {
+        const size_t sums_stride = static_cast<size_t>(grid.width) + 1;
+        grid.water_sums.assign(sums_stride * (grid.height + 1), 0);
+        grid.lava_sums.assign(sums_stride * (grid.height + 1), 0);
+        for (int32_t cy = 0; cy < grid.height; ++cy)
+        {
+            uint32_t water_row = 0;
+            uint32_t lava_row = 0;
+            for (int32_t cx = 0; cx < grid.width; ++cx)
+            {
+                const size_t i = static_cast<size_t>(cy) * grid.stride + cx;
+                water_row += grid.water[i];
+                lava_row += grid.lava[i];
+                const size_t s = (cy + 1) * sums_stride + cx + 1;
+                grid.water_sums[s] = grid.water_sums[s - sums_stride] + water_row;
+                grid.lava_sums[s] = grid.lava_sums[s - sums_stride] + lava_row;
+            }
+        }
+    }
+    return grid;
+}
+
 void game_log(std::string message)
 {
     using GameLogFun = void(std::ofstream*, const char*, void*, LogLevel);
@@ -820,6 +994,7 @@ float g_speedhack_multiplier = 1.0;
 LARGE_INTEGER g_speedhack_prev;
 LARGE_INTEGER g_speedhack_current;
 LARGE_INTEGER g_speedhack_fake;
+bool g_speedhack_frozen = false;
 PVOID g_oldqpc;
 
 #define PtrFromRva(base, rva) (((PBYTE)base) + rva)
@@ -892,7 +1067,8 @@ BOOL HookIAT(const char* szModuleName, const char* szFuncName, PVOID pNewFunc, P
 bool __stdcall QueryPerformanceCounterHook(LARGE_INTEGER* counter)
 {
     QueryPerformanceCounter(&g_speedhack_current);
-    g_speedhack_fake.QuadPart += (long long)((g_speedhack_current.QuadPart - g_speedhack_prev.QuadPart) * g_speedhack_multiplier);
+    if (!g_speedhack_frozen)
+        g_speedhack_fake.QuadPart += (long long)((g_speedhack_current.QuadPart - g_speedhack_prev.QuadPart) * g_speedhack_multiplier);
     g_speedhack_prev = g_speedhack_current;
     *counter = g_speedhack_fake;
     return true;
@@ -915,6 +1091,24 @@ float get_speedhack()
     return g_speedhack_multiplier;
 }
 
+void freeze_speedhack_clock(bool freeze)
+{
+    // Hooks the clock if it isn't yet
+    set_speedhack(g_speedhack_multiplier);
+    g_speedhack_frozen = freeze;
+}
+
+void step_speedhack_clock(double seconds)
+{
+    static const long long frequency = []()
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        return freq.QuadPart;
+    }();
+    g_speedhack_fake.QuadPart += (long long)(seconds * frequency);
+}
+
 void init_adventure()
 {
     // TODO: I didn't check exactly what this does, but it fixes issues with character select being broken after quick start
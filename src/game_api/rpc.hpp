@@ -18,6 +18,7 @@ class Entity;
 struct AABB;
 struct Layer;
 struct StateMemory;
+struct EntityFilter;
 
 void attach_entity(Entity* overlay, Entity* attachee);
 void attach_entity_by_uid(uint32_t overlay_uid, uint32_t attachee_uid);
@@ -25,11 +26,13 @@ int32_t attach_ball_and_chain(uint32_t uid, float off_x, float off_y);
 void stack_entities(uint32_t bottom_uid, uint32_t top_uid, const float (&offset)[2]);
 void move_entity_abs(uint32_t uid, float x, float y, float vx, float vy);
 void move_entity_abs(uint32_t uid, float x, float y, float vx, float vy, LAYER layer);
+void move_entities_abs(const std::vector<uint32_t>& uids, const std::vector<float>& xs, const std::vector<float>& ys);
 void move_liquid_abs(uint32_t uid, float x, float y, float vx, float vy);
 ENT_TYPE get_entity_type(uint32_t uid);
 std::tuple<float, float, float, float> screen_aabb(float x1, float y1, float x2, float y2);
 float screen_distance(float x);
 std::vector<uint32_t> filter_entities(std::vector<uint32_t> entities, std::function<bool(Entity*)> predicate);
+std::vector<uint32_t> filter_entities(std::vector<uint32_t> entities, const EntityFilter& filter);
 void set_contents(uint32_t uid, ENT_TYPE item_entity_type);
 void entity_remove_item(uint32_t uid, uint32_t item_uid, std::optional<bool> check_autokill);
 void kill_entity(uint32_t uid, std::optional<bool> destroy_corpse = std::nullopt);
@@ -55,8 +58,34 @@ void add_item_to_shop(int32_t item_uid, int32_t shop_owner_uid);
 void set_adventure_seed(int64_t first, int64_t second);
 std::pair<int64_t, int64_t> get_adventure_seed(std::optional<bool> run_start);
 void update_liquid_collision_at(float x, float y, bool add, std::optional<LAYER> layer = std::nullopt);
+void update_liquid_collisions_at(const std::vector<float>& xs, const std::vector<float>& ys, bool add, std::optional<LAYER> layer = std::nullopt);
 void add_entity_to_liquid_collision(uint32_t uid, bool add);
+void add_entities_to_liquid_collision(const std::vector<uint32_t>& uids, bool add);
 std::pair<uint8_t, uint8_t> get_liquids_at(float x, float y, LAYER layer);
+
+/// Copy of the liquid amounts in a rectangle, returned by [get_liquids_in_rect](#get_liquids_in_rect). Same grid as [get_liquids_at](#get_liquids_at), each cell is a third of a tile
+struct LiquidGrid
+{
+    /// Column of the left edge in the liquid grid, the column of a position is `floor((x + 0.5) * 3)`
+    int32_t x{0};
+    /// Row of the bottom edge in the liquid grid
+    int32_t y{0};
+    int32_t width{0};
+    int32_t height{0};
+    /// Distance between two rows in `water` and `lava`, rows go from the bottom up so cell `cx, cy` (0-based from the bottom left) is at `cy * stride + cx + 1`
+    int32_t stride{0};
+    std::vector<uint8_t> water;
+    std::vector<uint8_t> lava;
+    /// Summed-area tables with `(width + 1) * (height + 1)` entries, only filled when requested
+    std::vector<uint32_t> water_sums;
+    std::vector<uint32_t> lava_sums;
+
+    /// Water and lava at the position, 0 outside of the rectangle
+    std::pair<uint8_t, uint8_t> get(float x, float y) const;
+    /// Total water and lava in the cells between two positions, clamped to the rectangle. Constant time when the summed-area tables were requested
+    std::pair<uint32_t, uint32_t> sum(float x1, float y1, float x2, float y2) const;
+};
+LiquidGrid get_liquids_in_rect(float x1, float y1, float x2, float y2, LAYER layer, bool summed_area);
 void game_log(std::string message);
 void load_death_screen();
 void save_progress();
@@ -77,6 +106,9 @@ void create_level();
 bool get_start_level_paused();
 void set_speedhack(std::optional<float> multiplier);
 float get_speedhack();
+// While frozen the hooked QueryPerformanceCounter only moves by what's passed to step_speedhack_clock
+void freeze_speedhack_clock(bool freeze);
+void step_speedhack_clock(double seconds);
 void init_adventure();
 void init_seeded(std::optional<uint32_t> seed);
 uint8_t get_liquid_layer();
@@ -1,9 +1,12 @@
 #include "savestate.hpp"
 
+#include <algorithm> // for max
+
 #include "memory.hpp"        // for write_mem_prot, write_mem_recoverable
 #include "online.hpp"        // for Online
 #include "script/events.hpp" // for pre_load_state
 #include "state.hpp"         // for StateMemory
+#include "state_hash.hpp"    // for StateHash, StateDiffChunk
 
 void SaveState::backup_main(int slot_to)
 {
@@ -51,7 +54,15 @@ void invalidate_save_slots()
     }
 }
 
-void SaveState::load()
+void copy_heap(HeapBase from, HeapBase to, std::optional<bool> incremental)
+{
+    if (incremental.value_or(false))
+        from.copy_changed_to(to);
+    else
+        from.copy_to(to);
+}
+
+void SaveState::load(std::optional<bool> incremental)
 {
     if (base.is_null())
         return;
@@ -62,11 +73,11 @@ void SaveState::load()
     auto state = base.state();
     if (pre_load_state(-1, state))
         return;
-    base.copy_to(HeapBase::get_main());
+    copy_heap(base, HeapBase::get_main(), incremental);
     post_load_state(-1, state);
 }
 
-void SaveState::save()
+void SaveState::save(std::optional<bool> incremental)
 {
     if (base.is_null())
         return;
@@ -74,6 +85,121 @@ void SaveState::save()
     auto state = base.state();
     if (pre_save_state(-1, state))
         return;
-    HeapBase::get_main().copy_to(base);
+    copy_heap(HeapBase::get_main(), base, incremental);
     post_save_state(-1, state);
 }
+
+uint32_t SaveState::hash(std::optional<std::vector<uint32_t>> chunks) const
+{
+    return StateHash::hash(base, chunks ? &chunks.value() : nullptr);
+}
+
+std::vector<uint32_t> SaveState::hash_chunks() const
+{
+    return StateHash::hash_chunks(base);
+}
+
+std::vector<StateDiffChunk> SaveState::diff(const SaveState& other) const
+{
+    return StateHash::diff(base, other.base);
+}
+
+SaveStatePool::SaveStatePool(uint32_t max_states_)
+    : max_states(std::max(max_states_, 1u))
+{
+}
+
+void SaveStatePool::touch(std::list<Entry>::iterator it)
+{
+    saved.splice(saved.begin(), saved, it);
+}
+
+void SaveStatePool::save(int64_t key, std::optional<bool> incremental)
+{
+    if (auto it = lookup.find(key); it != lookup.end())
+    {
+        touch(it->second);
+        it->second->second->save(incremental);
+        return;
+    }
+
+    std::unique_ptr<SaveState> save_state;
+    if (!free_states.empty())
+    {
+        save_state = std::move(free_states.back());
+        free_states.pop_back();
+        save_state->save(incremental);
+    }
+    else if (saved.size() >= max_states)
+    {
+        // reuse the least recently used state, its content is most likely not close to the current state
+        save_state = std::move(saved.back().second);
+        lookup.erase(saved.back().first);
+        saved.pop_back();
+        save_state->save(false);
+    }
+    else
+    {
+        save_state = std::make_unique<SaveState>();
+    }
+
+    saved.emplace_front(key, std::move(save_state));
+    lookup[key] = saved.begin();
+}
+
+bool SaveStatePool::load(int64_t key, std::optional<bool> incremental)
+{
+    auto it = lookup.find(key);
+    if (it == lookup.end())
+        return false;
+
+    touch(it->second);
+    it->second->second->load(incremental);
+    return true;
+}
+
+bool SaveStatePool::has(int64_t key) const
+{
+    return lookup.contains(key);
+}
+
+StateMemory* SaveStatePool::get_state(int64_t key) const
+{
+    auto it = lookup.find(key);
+    if (it == lookup.end())
+        return nullptr;
+
+    return it->second->second->get_state();
+}
+
+void SaveStatePool::remove(int64_t key)
+{
+    auto it = lookup.find(key);
+    if (it == lookup.end())
+        return;
+
+    free_states.push_back(std::move(it->second->second));
+    saved.erase(it->second);
+    lookup.erase(it);
+}
+
+void SaveStatePool::clear()
+{
+    lookup.clear();
+    saved.clear();
+    free_states.clear();
+}
+
+void SaveStatePool::set_capacity(uint32_t new_max_states)
+{
+    max_states = std::max(new_max_states, 1u);
+    while (saved.size() > max_states)
+    {
+        lookup.erase(saved.back().first);
+        saved.pop_back();
+    }
+    while (!free_states.empty() && saved.size() + free_states.size() > max_states)
+    {
+        free_states.pop_back();
+    }
+}
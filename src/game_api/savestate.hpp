@@ -1,11 +1,17 @@
 #pragma once
 
-#include <cstdint> // for uint32_t, int8_t
+#include <cstdint>       // for uint32_t, int8_t
+#include <list>          // for list
+#include <memory>        // for unique_ptr
+#include <optional>      // for optional
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
 
 #include "heap_base.hpp" // for HeapBase
 
 struct StateMemory;
 struct PRNG;
+struct StateDiffChunk;
 
 class SaveState
 {
@@ -14,7 +20,7 @@ class SaveState
     SaveState()
         : base(reinterpret_cast<uintptr_t>(malloc(8ull * 0x400000)))
     {
-        save();
+        save(false);
     }
     /// NoDoc
     SaveState(uint8_t index)
@@ -49,10 +55,20 @@ class SaveState
     }
 
     /// Load a SaveState
-    void load();
+    /// Set `incremental` to only write the parts of the state that differ, faster when loading a recent state (e.g. rollback), the result is the same
+    void load(std::optional<bool> incremental);
 
     /// Save over a previously allocated SaveState
-    void save();
+    /// Set `incremental` to only write the parts of the state that differ, faster when saving over a recent state (e.g. saving every frame), the result is the same
+    void save(std::optional<bool> incremental);
+
+    /// Hash the state, all of it or only the listed chunks (see `hash_chunks`). Pointers into the state are hashed relative to it, so copies of the same state hash the same,
+    /// also in other game processes as long as the game is loaded at the same address. Meant to be compared every frame with the hashes of the other players to detect desyncs
+    uint32_t hash(std::optional<std::vector<uint32_t>> chunks) const;
+    /// Get the hashes of all the 4KiB chunks of the state, exchange these once `hash` differs to find the chunks that diverged with `diff_state_hashes`
+    std::vector<uint32_t> hash_chunks() const;
+    /// Compare with another SaveState, returns the chunks that differ and the parts of the state they hold
+    std::vector<StateDiffChunk> diff(const SaveState& other) const;
 
     /// Delete the SaveState and free the memory. The SaveState can't be used after this.
     void clear()
@@ -70,5 +86,48 @@ class SaveState
     int8_t slot{-1};
 };
 
+class SaveStatePool
+{
+  public:
+    /// Create a pool that keeps up to `max_states` SaveStates, the memory (32MiB per state) is allocated once when needed and then reused, it's only freed on `clear` or when the pool is garbage collected.
+    SaveStatePool(uint32_t max_states);
+
+    /// Save the current state under `key` (e.g. the frame number), overwriting the least recently used state when the pool is full. Set `incremental` to only write the parts that changed, see SaveState.save
+    void save(int64_t key, std::optional<bool> incremental);
+    /// Load the state saved under `key`, returns false if there is no such state (never saved or already overwritten)
+    bool load(int64_t key, std::optional<bool> incremental);
+    /// Check if there is a state saved under `key`
+    bool has(int64_t key) const;
+    /// Access the StateMemory saved under `key`, returns nil if there is no such state
+    StateMemory* get_state(int64_t key) const;
+    /// Remove the state saved under `key`, its memory is kept for reuse
+    void remove(int64_t key);
+    /// Delete all the states and free their memory
+    void clear();
+    /// Get the amount of saved states
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(saved.size());
+    }
+    /// Get the maximum amount of states
+    uint32_t capacity() const
+    {
+        return max_states;
+    }
+    /// Change the maximum amount of states, least recently used states are deleted if there are too many
+    void set_capacity(uint32_t new_max_states);
+
+  private:
+    using Entry = std::pair<int64_t, std::unique_ptr<SaveState>>;
+
+    // most recently used at the front
+    std::list<Entry> saved;
+    std::unordered_map<int64_t, std::list<Entry>::iterator> lookup;
+    std::vector<std::unique_ptr<SaveState>> free_states;
+    uint32_t max_states;
+
+    void touch(std::list<Entry>::iterator it);
+};
+
 StateMemory* get_save_state(int slot);
 void invalidate_save_slots();
@@ -0,0 +1,296 @@
+#include "savestate_ring.hpp"
+
+#include <algorithm> // for max
+#include <cstring>   // for memcpy, memset
+#include <utility>   // for move
+
+#include "script/events.hpp" // for pre_load_state, post_load_state
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+constexpr size_t g_heap_words = 0x400000;
+constexpr size_t g_heap_size = g_heap_words * sizeof(uint64_t);
+
+// Run length coding of zero words, the difference of two consecutive states is mostly zero
+// Every run is a header word with the amount of zero words in the upper half and the amount of literal words in the lower half, followed by the literal words
+class ZeroRunEncoder
+{
+  public:
+    void add(uint64_t word)
+    {
+        if (word == 0)
+        {
+            if (literals != 0)
+                finish_run();
+            ++zeros;
+        }
+        else
+        {
+            if (literals == 0)
+            {
+                header = out.size();
+                out.push_back(0);
+            }
+            out.push_back(word);
+            ++literals;
+        }
+    }
+    std::shared_ptr<const std::vector<uint64_t>> finish()
+    {
+        if (literals != 0 || zeros != 0)
+        {
+            if (literals == 0)
+            {
+                header = out.size();
+                out.push_back(0);
+            }
+            finish_run();
+        }
+        out.shrink_to_fit();
+        return std::make_shared<const std::vector<uint64_t>>(std::move(out));
+    }
+
+  private:
+    std::vector<uint64_t> out;
+    size_t header{0};
+    uint64_t zeros{0};
+    uint64_t literals{0};
+
+    void finish_run()
+    {
+        out[header] = (zeros << 32) | literals;
+        zeros = 0;
+        literals = 0;
+    }
+};
+
+template <class FunT>
+void decode_zero_runs(const std::vector<uint64_t>& encoded, uint64_t* out, FunT&& apply_literal)
+{
+    size_t pos = 0;
+    for (size_t i = 0; i < encoded.size();)
+    {
+        const uint64_t header = encoded[i++];
+        const uint64_t zeros = header >> 32;
+        const uint64_t literals = header & 0xffffffff;
+        pos += zeros;
+        for (uint64_t j = 0; j < literals; ++j)
+            apply_literal(out[pos++], encoded[i++]);
+    }
+}
+
+size_t entry_memory(const auto& entry)
+{
+    const size_t delta_words = entry.delta ? entry.delta->size() : 0;
+    const size_t keyframe_words = entry.keyframe ? entry.keyframe->size() : 0;
+    return (delta_words + keyframe_words) * sizeof(uint64_t);
+}
+
+SaveStateRing::SaveStateRing(uint32_t max_states_, std::optional<uint32_t> keyframe_interval_)
+    : head(reinterpret_cast<uintptr_t>(malloc(g_heap_size))),
+      scratch(reinterpret_cast<uintptr_t>(malloc(g_heap_size))),
+      max_states(std::max(max_states_, 1u)),
+      keyframe_interval(std::max(keyframe_interval_.value_or(60), 1u))
+{
+    worker = std::thread(&SaveStateRing::worker_loop, this);
+}
+
+SaveStateRing::~SaveStateRing()
+{
+    {
+        std::lock_guard guard{lock};
+        stop_worker = true;
+    }
+    worker_signal.notify_all();
+    worker.join();
+
+    head.free();
+    scratch.free();
+}
+
+void SaveStateRing::push()
+{
+    if (head.is_null() || scratch.is_null())
+        return;
+
+    // the worker only works with its own copy of the entries, so this doesn't have to wait for it
+    std::lock_guard guard{lock};
+    const auto main = HeapBase::get_main();
+    const uintptr_t from_base = main.address();
+    const uintptr_t to_base = head.address();
+    const uint64_t* from = reinterpret_cast<const uint64_t*>(from_base);
+    uint64_t* to = reinterpret_cast<uint64_t*>(to_base);
+
+    const bool first = entries.empty();
+    const bool make_keyframe = first || since_keyframe + 1 >= keyframe_interval;
+    ZeroRunEncoder delta;
+    ZeroRunEncoder keyframe;
+    for (size_t i = 0; i < g_heap_words; ++i)
+    {
+        // same relocation as HeapBase::copy_to, the history is kept as if it was saved into `head`
+        const uint64_t value = from[i];
+        const uint64_t fixed = value >= from_base + 0x2000000 || value <= from_base ? value : value - from_base + to_base;
+        if (!first)
+            delta.add(fixed ^ to[i]);
+        if (make_keyframe)
+            keyframe.add(fixed);
+        to[i] = fixed;
+    }
+
+    Entry entry{next_sequence++, nullptr, nullptr};
+    if (!first)
+        entry.delta = delta.finish();
+    if (make_keyframe)
+    {
+        entry.keyframe = keyframe.finish();
+        since_keyframe = 0;
+    }
+    else
+    {
+        ++since_keyframe;
+    }
+    used_memory += entry_memory(entry);
+    entries.push_back(std::move(entry));
+
+    while (entries.size() > max_states)
+    {
+        // can only start at a keyframe
+        pop_front();
+        while (!entries.empty() && !entries.front().keyframe)
+            pop_front();
+    }
+}
+
+void SaveStateRing::pop_front()
+{
+    used_memory -= entry_memory(entries.front());
+    entries.pop_front();
+}
+
+std::optional<std::vector<SaveStateRing::Entry>> SaveStateRing::chain_to(uint64_t sequence) const
+{
+    if (entries.empty() || sequence < entries.front().sequence || sequence > entries.back().sequence)
+        return std::nullopt;
+
+    const size_t index = static_cast<size_t>(sequence - entries.front().sequence);
+    size_t start = index;
+    while (!entries[start].keyframe)
+        --start;
+    return std::vector<Entry>(entries.begin() + start, entries.begin() + index + 1);
+}
+
+void SaveStateRing::rebuild(const std::vector<Entry>& chain)
+{
+    uint64_t* out = reinterpret_cast<uint64_t*>(scratch.address());
+    memset(out, 0, g_heap_size);
+    decode_zero_runs(*chain.front().keyframe, out, [](uint64_t& word, uint64_t literal)
+                     { word = literal; });
+    for (size_t i = 1; i < chain.size(); ++i)
+    {
+        decode_zero_runs(*chain[i].delta, out, [](uint64_t& word, uint64_t literal)
+                         { word ^= literal; });
+    }
+}
+
+void SaveStateRing::worker_loop()
+{
+    ServiceThreads::get().register_current("SaveStateRing", THREAD_POOL::WORKER);
+    std::unique_lock guard{lock};
+    while (true)
+    {
+        worker_signal.wait(guard, [this]()
+                           { return stop_worker || requested.has_value(); });
+        if (stop_worker)
+            return;
+
+        const uint64_t sequence = requested.value();
+        requested.reset();
+        if (scratch_sequence == sequence)
+            continue;
+
+        auto chain = chain_to(sequence);
+        if (!chain)
+            continue;
+
+        working = true;
+        scratch_sequence.reset();
+        guard.unlock();
+        rebuild(chain.value());
+        guard.lock();
+        working = false;
+        scratch_sequence = sequence;
+        worker_signal.notify_all();
+    }
+}
+
+void SaveStateRing::prefetch(uint32_t states_back)
+{
+    {
+        std::lock_guard guard{lock};
+        if (states_back >= entries.size())
+            return;
+        requested = entries.back().sequence - states_back;
+    }
+    worker_signal.notify_all();
+}
+
+bool SaveStateRing::load(uint32_t states_back)
+{
+    if (head.is_null() || scratch.is_null())
+        return false;
+
+    std::unique_lock guard{lock};
+    if (states_back >= entries.size())
+        return false;
+
+    const uint64_t sequence = entries.back().sequence - states_back;
+    worker_signal.wait(guard, [this]()
+                       { return !working; });
+    if (scratch_sequence != sequence)
+    {
+        rebuild(chain_to(sequence).value());
+        scratch_sequence = sequence;
+    }
+
+    // the rebuilt state is relative to `head`, so after this `head` is a proper copy of that state again
+    memcpy(reinterpret_cast<void*>(head.address()), reinterpret_cast<const void*>(scratch.address()), g_heap_size);
+    while (entries.back().sequence != sequence)
+    {
+        used_memory -= entry_memory(entries.back());
+        entries.pop_back();
+    }
+    next_sequence = sequence + 1;
+    since_keyframe = 0;
+    for (auto it = entries.rbegin(); it != entries.rend() && !it->keyframe; ++it)
+        ++since_keyframe;
+    guard.unlock();
+
+    auto state = head.state();
+    if (pre_load_state(-1, state))
+        return false;
+    head.copy_to(HeapBase::get_main());
+    post_load_state(-1, state);
+    return true;
+}
+
+void SaveStateRing::clear()
+{
+    std::unique_lock guard{lock};
+    worker_signal.wait(guard, [this]()
+                       { return !working; });
+    entries.clear();
+    used_memory = 0;
+    since_keyframe = 0;
+    scratch_sequence.reset();
+}
+
+uint32_t SaveStateRing::size() const
+{
+    std::lock_guard guard{lock};
+    return static_cast<uint32_t>(entries.size());
+}
+
+size_t SaveStateRing::memory_usage() const
+{
+    std::lock_guard guard{lock};
+    return used_memory;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable> // for condition_variable
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint32_t, uint64_t, uintptr_t
+#include <deque>              // for deque
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <optional>           // for optional
+#include <thread>             // for thread
+#include <vector>             // for vector
+
+#include "heap_base.hpp" // for HeapBase
+
+class SaveStateRing
+{
+  public:
+    /// Create a rewind history that keeps the last `max_states` pushed states. Only the difference to the previous state is kept (compressed) for most of the states,
+    /// with a full compressed state every `keyframe_interval` (default 60) pushes, which bounds the amount of work `load` has to do. Uses 64MiB for the two working states on top of the history.
+    SaveStateRing(uint32_t max_states, std::optional<uint32_t> keyframe_interval);
+    ~SaveStateRing();
+
+    SaveStateRing(const SaveStateRing&) = delete;
+    SaveStateRing& operator=(const SaveStateRing&) = delete;
+
+    /// Add the current state to the history, the oldest states are dropped when the ring is full (up to `keyframe_interval` at once)
+    void push();
+    /// Start rebuilding the state from `states_back` pushes ago on a background thread, a following `load` with the same value can then skip that work
+    void prefetch(uint32_t states_back);
+    /// Load the state from `states_back` pushes ago (0 being the last pushed state), all the newer states are dropped from the history. Returns false if there is no such state
+    bool load(uint32_t states_back);
+    /// Drop all the states
+    void clear();
+    /// Amount of states in the history
+    uint32_t size() const;
+    /// Amount of memory used by the compressed history in bytes
+    size_t memory_usage() const;
+
+  private:
+    struct Entry
+    {
+        uint64_t sequence;
+        // xor with the previous state, missing on the first entry
+        std::shared_ptr<const std::vector<uint64_t>> delta;
+        // full state, only every keyframe_interval entries
+        std::shared_ptr<const std::vector<uint64_t>> keyframe;
+    };
+
+    HeapBase head;
+    HeapBase scratch;
+    std::deque<Entry> entries;
+    uint64_t next_sequence{0};
+    uint32_t max_states;
+    uint32_t keyframe_interval;
+    uint32_t since_keyframe{0};
+    size_t used_memory{0};
+
+    mutable std::mutex lock;
+    std::condition_variable worker_signal;
+    std::thread worker;
+    bool stop_worker{false};
+    std::optional<uint64_t> requested;
+    bool working{false};
+    std::optional<uint64_t> scratch_sequence;
+
+    void worker_loop();
+    std::optional<std::vector<Entry>> chain_to(uint64_t sequence) const;
+    void rebuild(const std::vector<Entry>& chain);
+    void pop_front();
+};
@@ -1,15 +1,17 @@
 #include "screen.hpp"
 
-#include <algorithm>   // for transform
-#include <cctype>      // for toupper
-#include <functional>  // for function, _Func_impl_no_alloc<>::_Mybase
-#include <new>         // for operator new
-#include <type_traits> // for move
-#include <utility>     // for find_if, min
-#include <vector>      // for vector, _Vector_iterator, allocator, era...
+#include <algorithm>     // for transform
+#include <cctype>        // for toupper
+#include <functional>    // for function, _Func_impl_no_alloc<>::_Mybase
+#include <new>           // for operator new
+#include <type_traits>   // for move
+#include <unordered_map> // for unordered_map
+#include <utility>       // for min, exchange
+#include <vector>        // for vector, _Vector_iterator, allocator, era...
 
 #include "containers/game_allocator.hpp" //
 #include "entity_hooks_info.hpp"         // for HookWithId
+#include "game_heap_stats.hpp"           // for GameHeapTag
 #include "game_manager.hpp"              // for GameManager, get_game_manager
 #include "logger.h"                      // for DEBUG
 #include "memory.hpp"
@@ -25,32 +27,61 @@ struct ScreenHooksInfo
     std::uint32_t cbcount;
     std::vector<HookWithId<bool(Screen*)>> pre_render;
     std::vector<HookWithId<void(Screen*)>> post_render;
+    // Callbacks added or removed by a callback while the screen renders are only applied after, so the running one
+    // isn't moved or destroyed by the vector under it
+    bool rendering{false};
+    std::vector<HookWithId<bool(Screen*)>> added_pre_render;
+    std::vector<HookWithId<void(Screen*)>> added_post_render;
+    std::vector<std::uint32_t> removed;
 };
 
-std::vector<ScreenHooksInfo> g_screen_hooks;
+using ScreenRenderDetour = VTableDetour<void(Screen*), 0x3>;
+
+// Node based, so the render detours can keep a pointer to the hooks of their screen
+std::unordered_map<Screen*, ScreenHooksInfo> g_screen_hooks;
 
 ScreenHooksInfo& Screen::get_hooks()
 {
-    auto it = std::find_if(g_screen_hooks.begin(), g_screen_hooks.end(), [this](auto& hook)
-                           { return hook.screen == this; });
-    if (it == g_screen_hooks.end())
+    return g_screen_hooks.try_emplace(this, ScreenHooksInfo{this}).first->second;
+}
+
+void unhook_screen(ScreenHooksInfo& hook_info, std::uint32_t id)
+{
+    std::erase_if(hook_info.pre_render, [id](auto& hook)
+                  { return hook.id == id; });
+    std::erase_if(hook_info.post_render, [id](auto& hook)
+                  { return hook.id == id; });
+    // Screens without callbacks go straight to the original render again, the info stays to keep the callback ids unique
+    if (hook_info.pre_render.empty() && hook_info.post_render.empty())
     {
-        g_screen_hooks.push_back({this});
-        return g_screen_hooks.back();
+        ScreenRenderDetour::erase_function(hook_info.screen);
     }
-    return *it;
+}
+
+void apply_screen_hook_changes(ScreenHooksInfo& hook_info)
+{
+    if (hook_info.removed.empty() && hook_info.added_pre_render.empty() && hook_info.added_post_render.empty())
+        return;
+
+    for (auto& hook : hook_info.added_pre_render)
+        hook_info.pre_render.push_back(std::move(hook));
+    for (auto& hook : hook_info.added_post_render)
+        hook_info.post_render.push_back(std::move(hook));
+    hook_info.added_pre_render.clear();
+    hook_info.added_post_render.clear();
+    for (std::uint32_t id : std::exchange(hook_info.removed, {}))
+        unhook_screen(hook_info, id);
 }
 
 void hook_screen_render(Screen* self)
 {
     hook_vtable_no_dtor<void(Screen*), 0x3>(
         self,
-        [](Screen* lmbd_self, void (*original)(Screen*))
+        [hook_info = &self->get_hooks()](Screen* lmbd_self, void (*original)(Screen*))
         {
-            ScreenHooksInfo& hook_info = lmbd_self->get_hooks();
-
+            hook_info->rendering = true;
             bool skip_orig = false;
-            for (auto& [id, pre] : hook_info.pre_render)
+            for (auto& [id, pre] : hook_info->pre_render)
             {
                 if (pre(lmbd_self))
                 {
@@ -63,10 +94,13 @@ void hook_screen_render(Screen* self)
                 original(lmbd_self);
             }
 
-            for (auto& [id, post] : hook_info.post_render)
+            for (auto& [id, post] : hook_info->post_render)
             {
                 post(lmbd_self);
             }
+            hook_info->rendering = false;
+            // May remove this detour, so nothing can be touched after
+            apply_screen_hook_changes(*hook_info);
         });
 }
 
@@ -79,6 +113,11 @@ std::uint32_t Screen::reserve_callback_id()
 void Screen::set_pre_render(std::uint32_t reserved_callback_id, std::function<bool(Screen*)> pre_render)
 {
     ScreenHooksInfo& hook_info = get_hooks();
+    if (hook_info.rendering)
+    {
+        hook_info.added_pre_render.push_back({reserved_callback_id, std::move(pre_render)});
+        return;
+    }
     if (hook_info.pre_render.empty() && hook_info.post_render.empty())
     {
         hook_screen_render(this);
@@ -89,6 +128,11 @@ void Screen::set_pre_render(std::uint32_t reserved_callback_id, std::function<bo
 void Screen::set_post_render(std::uint32_t reserved_callback_id, std::function<void(Screen*)> post_render)
 {
     ScreenHooksInfo& hook_info = get_hooks();
+    if (hook_info.rendering)
+    {
+        hook_info.added_post_render.push_back({reserved_callback_id, std::move(post_render)});
+        return;
+    }
     if (hook_info.pre_render.empty() && hook_info.post_render.empty())
     {
         hook_screen_render(this);
@@ -98,14 +142,20 @@ void Screen::set_post_render(std::uint32_t reserved_callback_id, std::function<v
 
 void Screen::unhook(std::uint32_t id)
 {
-    auto it = std::find_if(g_screen_hooks.begin(), g_screen_hooks.end(), [this](auto& hook)
-                           { return hook.screen == this; });
+    auto it = g_screen_hooks.find(this);
     if (it != g_screen_hooks.end())
     {
-        std::erase_if(it->pre_render, [id](auto& hook)
-                      { return hook.id == id; });
-        std::erase_if(it->post_render, [id](auto& hook)
-                      { return hook.id == id; });
+        ScreenHooksInfo& hook_info = it->second;
+        if (hook_info.rendering)
+        {
+            std::erase_if(hook_info.added_pre_render, [id](auto& hook)
+                          { return hook.id == id; });
+            std::erase_if(hook_info.added_post_render, [id](auto& hook)
+                          { return hook.id == id; });
+            hook_info.removed.push_back(id);
+            return;
+        }
+        unhook_screen(hook_info, id);
     }
 }
 
@@ -241,6 +291,7 @@ JournalPageStory* JournalPageStory::construct(bool right_side, uint32_t pn)
 {
     static auto journal_storypage_vtable = get_address("vftable_JournalPages") + JOURNAL_VFTABLE::STORY;
 
+    GameHeapTag tag{"journal pages"};
     size_t* mem = (size_t*)game_malloc(0x58);
     *mem = journal_storypage_vtable;
     JournalPageStory* page = (JournalPageStory*)mem;
@@ -0,0 +1,49 @@
+#include "screen_transform.hpp"
+
+#include "game_api.hpp"      // for GameAPI
+#include "state.hpp"         // for ZF
+#include "state_structs.hpp" // for Camera
+
+namespace
+{
+constexpr float g_zoom_factor_y = ZF / 16.0f * 9.0f;
+
+ScreenTransform g_transform{};
+bool g_in_frame{false};
+bool g_valid{false};
+} // namespace
+
+Vec2 ScreenTransform::to_screen(float x, float y) const
+{
+    return {(x - camera_x) / zoom / ZF, (y - camera_y) / zoom / g_zoom_factor_y};
+}
+Vec2 ScreenTransform::to_world(float x, float y) const
+{
+    return {camera_x + ZF * zoom * x, camera_y + g_zoom_factor_y * zoom * y};
+}
+
+const ScreenTransform& ScreenTransform::get()
+{
+    if (!g_in_frame || !g_valid)
+    {
+        const Vec2 camera = Camera::get_position();
+        g_transform = {camera.x, camera.y, GameAPI::get()->get_current_zoom()};
+        g_valid = g_in_frame;
+    }
+    return g_transform;
+}
+
+void ScreenTransform::begin_frame()
+{
+    g_in_frame = true;
+    g_valid = false;
+}
+void ScreenTransform::end_frame()
+{
+    g_in_frame = false;
+    g_valid = false;
+}
+void ScreenTransform::invalidate()
+{
+    g_valid = false;
+}
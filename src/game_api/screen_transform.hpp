@@ -0,0 +1,22 @@
+#pragma once
+
+#include "math.hpp" // for Vec2
+
+// Camera transform between game coordinates and the normalized screen coordinates of screen_position/game_position
+// The draw callbacks of scripts convert thousands of positions per frame, so while the UI is drawn it's taken once and reused
+struct ScreenTransform
+{
+    float camera_x;
+    float camera_y;
+    float zoom;
+
+    Vec2 to_screen(float x, float y) const;
+    Vec2 to_world(float x, float y) const;
+
+    // The cached transform while a frame is drawn, else a fresh one
+    static const ScreenTransform& get();
+    static void begin_frame();
+    static void end_frame();
+    // Called when the camera or zoom changes, so a script moving the camera in a draw callback sees it right away
+    static void invalidate();
+};
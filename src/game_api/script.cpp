@@ -3,6 +3,7 @@
 #include <type_traits> // for move
 
 #include "console.hpp"            // for SpelunkyConsole
+#include "script/lua_memory.hpp"  // for LuaMemoryAccount
 #include "script/script_impl.hpp" // for ScriptImpl
 
 SpelunkyScript::SpelunkyScript(std::string script, std::string file, SoundManager* sound_manager, class SpelunkyConsole* console, bool enable)
@@ -11,17 +12,18 @@ SpelunkyScript::SpelunkyScript(std::string script, std::string file, SoundManage
 }
 SpelunkyScript::~SpelunkyScript() = default;
 
+// The message ring can be read without locking the backend, so this doesn't wait for a script that is running
 void SpelunkyScript::loop_messages(std::function<void(const ScriptMessage&)> message_fun) const
 {
-    auto impl = m_Impl->Lock();
-    for (const ScriptMessage& message : impl->messages)
-    {
-        message_fun(message);
-    }
+    m_Impl->messages.for_each(message_fun);
+}
+uint64_t SpelunkyScript::loop_messages_since(uint64_t sequence, std::function<void(const ScriptMessage&)> message_fun) const
+{
+    return m_Impl->messages.for_each_since(sequence, message_fun);
 }
 std::deque<ScriptMessage> SpelunkyScript::consume_messages()
 {
-    return std::move(m_Impl->Lock()->messages);
+    return m_Impl->messages.consume();
 }
 std::vector<std::string> SpelunkyScript::consume_requires()
 {
@@ -96,6 +98,17 @@ void SpelunkyScript::update_code(std::string code)
 #endif
     impl->changed = true;
 }
+void SpelunkyScript::hot_reload(std::string code)
+{
+    auto impl = m_Impl->Lock();
+#ifdef SPEL2_EDITABLE_SCRIPTS
+    impl->code = code;
+#else
+    impl->code = std::move(code);
+#endif
+    impl->changed = true;
+    impl->hot_reload_requested = true;
+}
 
 std::string SpelunkyScript::get_result()
 {
@@ -120,6 +133,23 @@ void SpelunkyScript::set_changed(bool changed)
     m_Impl->Lock()->changed = changed;
 }
 
+std::size_t SpelunkyScript::get_memory_used() const
+{
+    return m_Impl->Lock()->get_memory_account().used.load(std::memory_order_relaxed);
+}
+std::size_t SpelunkyScript::get_memory_peak() const
+{
+    return m_Impl->Lock()->get_memory_account().peak.load(std::memory_order_relaxed);
+}
+std::size_t SpelunkyScript::get_memory_limit() const
+{
+    return m_Impl->Lock()->get_memory_account().limit.load(std::memory_order_relaxed);
+}
+void SpelunkyScript::set_memory_limit(std::size_t limit)
+{
+    m_Impl->Lock()->get_memory_account().limit.store(limit, std::memory_order_relaxed);
+}
+
 void SpelunkyScript::draw(ImDrawList* dl)
 {
     m_Impl->Lock()->draw(dl);
@@ -2,7 +2,7 @@
 
 #include <chrono>     // for system_clock, time_point
 #include <cstddef>    // for size_t
-#include <cstdint>    // for uint16_t
+#include <cstdint>    // for uint16_t, uint64_t
 #include <deque>      // for deque
 #include <functional> // for function
 #include <imgui.h>    // for ImVec2, ImDrawList (ptr only), ImVec4
@@ -63,6 +63,8 @@ class SpelunkyScript
     ~SpelunkyScript();
 
     void loop_messages(std::function<void(const ScriptMessage&)> message_fun) const;
+    // Messages from `sequence` on, regardless of what was consumed, returns where to continue from next time, start with 0
+    uint64_t loop_messages_since(uint64_t sequence, std::function<void(const ScriptMessage&)> message_fun) const;
     std::deque<ScriptMessage> consume_messages();
     std::vector<std::string> consume_requires();
 
@@ -86,6 +88,8 @@ class SpelunkyScript
 #endif
 
     void update_code(std::string code);
+    // Same as update_code, but keeps the entity hooks and user data and only reloads the required modules that changed
+    void hot_reload(std::string code);
 
     std::string get_result();
 
@@ -95,6 +99,12 @@ class SpelunkyScript
     bool is_changed() const;
     void set_changed(bool changed);
 
+    // Lua memory charged to this script, in bytes, a limit of 0 means unlimited
+    std::size_t get_memory_used() const;
+    std::size_t get_memory_peak() const;
+    std::size_t get_memory_limit() const;
+    void set_memory_limit(std::size_t limit);
+
     void draw(ImDrawList* dl);
     void render_options();
 
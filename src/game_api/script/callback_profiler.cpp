@@ -0,0 +1,96 @@
+#include "callback_profiler.hpp"
+
+#include <Windows.h> // for QueryPerformanceCounter, QueryPerformanceFrequency
+#include <algorithm> // for max, min
+#include <numeric>   // for accumulate
+
+#include "lua_backend.hpp" // for LuaBackend
+
+void CallbackProfiler::record(int32_t aux_id, int32_t id, CallbackType type, int64_t ticks)
+{
+    const std::tuple<CallbackType, int32_t, int32_t> key{type, aux_id, id};
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        if (entries.size() >= MAX_ENTRIES)
+            return;
+        it = entries.emplace(key, Entry{}).first;
+    }
+    Entry& entry = it->second;
+    entry.calls++;
+    entry.total_ticks += ticks;
+    entry.max_ticks = std::max(entry.max_ticks, ticks);
+    entry.frame_ticks[frame % FRAME_HISTORY] += ticks;
+}
+void CallbackProfiler::next_frame()
+{
+    frame++;
+    for (auto& [key, entry] : entries)
+    {
+        entry.frame_ticks[frame % FRAME_HISTORY] = 0;
+    }
+}
+void CallbackProfiler::reset()
+{
+    entries.clear();
+    frame = 0;
+}
+void CallbackProfiler::append_stats(std::string_view script, std::vector<CallbackStats>& stats) const
+{
+    const size_t frames = std::max<size_t>(std::min(frame + 1, FRAME_HISTORY), 1);
+    for (const auto& [key, entry] : entries)
+    {
+        const auto& [type, aux_id, id] = key;
+        const int64_t history_ticks = std::accumulate(entry.frame_ticks.begin(), entry.frame_ticks.end(), int64_t{0});
+        stats.push_back(CallbackStats{
+            std::string{script},
+            id,
+            aux_id,
+            type,
+            entry.calls,
+            ticks_to_ms(entry.total_ticks),
+            ticks_to_ms(entry.max_ticks),
+            ticks_to_ms(history_ticks) / frames,
+        });
+    }
+}
+
+int64_t CallbackProfiler::now()
+{
+    LARGE_INTEGER ret;
+    QueryPerformanceCounter(&ret);
+    return ret.QuadPart;
+}
+double CallbackProfiler::ticks_to_ms(int64_t ticks)
+{
+    static const double ms_per_tick = []()
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        return 1000.0 / (double)freq.QuadPart;
+    }();
+    return (double)ticks * ms_per_tick;
+}
+
+std::vector<CallbackStats> get_callback_stats()
+{
+    std::vector<CallbackStats> stats;
+    LuaBackend::for_each_backend(
+        [&](LuaBackend::LockedBackend backend)
+        {
+            backend->profiler.append_stats(backend->get_name(), stats);
+            return true;
+        },
+        false);
+    return stats;
+}
+void reset_callback_stats()
+{
+    LuaBackend::for_each_backend(
+        [](LuaBackend::LockedBackend backend)
+        {
+            backend->profiler.reset();
+            return true;
+        },
+        false);
+}
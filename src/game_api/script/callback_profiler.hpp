@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>       // for array
+#include <cstddef>     // for size_t
+#include <cstdint>     // for int64_t, int32_t, uint64_t
+#include <map>         // for map
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <tuple>       // for tuple
+#include <vector>      // for vector
+
+#include "hook_handler.hpp" // for CallbackType
+
+struct CallbackStats
+{
+    /// Name of the script the callback belongs to
+    std::string script;
+    /// The callback id, as returned when setting the callback
+    int32_t id;
+    /// Entity uid for entity hooks, screen id for screen hooks, -1 otherwise
+    int32_t aux_id;
+    CallbackType type;
+    uint64_t calls;
+    /// Total time spent in the callback since the profiler was reset, including callbacks that ran from inside it
+    double total_ms;
+    /// Longest single call
+    double max_ms;
+    /// Average time spent in the callback per frame over the last 120 frames
+    double frame_ms;
+};
+
+// Per backend timing of every callback ran through handle_function, kept as totals plus a ring buffer of per frame times
+// Off until turned on from the ui, the entries go away with the callbacks when the script is reset
+class CallbackProfiler
+{
+  public:
+    static constexpr size_t FRAME_HISTORY = 120;
+    // Callbacks per backend, a script making new ones all the time only has its first ones profiled
+    static constexpr size_t MAX_ENTRIES = 1024;
+
+    void record(int32_t aux_id, int32_t id, CallbackType type, int64_t ticks);
+    void next_frame();
+    void reset();
+    void append_stats(std::string_view script, std::vector<CallbackStats>& stats) const;
+
+    static int64_t now();
+    static double ticks_to_ms(int64_t ticks);
+
+    inline static bool enabled{false};
+
+  private:
+    struct Entry
+    {
+        uint64_t calls{0};
+        int64_t total_ticks{0};
+        int64_t max_ticks{0};
+        std::array<int64_t, FRAME_HISTORY> frame_ticks{};
+    };
+    std::map<std::tuple<CallbackType, int32_t, int32_t>, Entry> entries;
+    size_t frame{0};
+};
+
+std::vector<CallbackStats> get_callback_stats();
+void reset_callback_stats();
@@ -0,0 +1,182 @@
+#include "entity_delta.hpp"
+
+#include <algorithm> // for sort
+#include <mutex>     // for lock_guard
+#include <utility>   // for move, exchange
+#include <vector>    // for vector, erase
+
+#include "entity.hpp"    // for Entity
+#include "entity_db.hpp" // for EntityDB
+#include "heap_base.hpp" // for HeapBase
+#include "layer.hpp"     // for Layer, EntityList
+#include "lua_vm.hpp"    // for global_lua_lock
+#include "state.hpp"     // for StateMemory, get_state_ptr
+
+EntityDeltaStream::EntityDeltaStream(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask_)
+    : types{entity_types}, mask{mask_}
+{
+    EntityDeltaTracker::get().streams.push_back(this);
+}
+EntityDeltaStream::~EntityDeltaStream()
+{
+    unsubscribe();
+}
+void EntityDeltaStream::unsubscribe()
+{
+    if (!std::exchange(subscribed, false))
+        return;
+    std::erase(EntityDeltaTracker::get().streams, this);
+    spawned = {};
+    destroyed = {};
+    moved = {};
+}
+
+EntityDeltaTracker& EntityDeltaTracker::get()
+{
+    // Never destroyed, the streams go away with their backends which can outlive the static destructors at exit
+    static EntityDeltaTracker* tracker = new EntityDeltaTracker();
+    return *tracker;
+}
+
+void EntityDeltaTracker::track_spawned(uint32_t first_uid)
+{
+    auto state = get_state_ptr();
+    for (uint8_t layer = 0; layer < 2; ++layer)
+    {
+        const EntityList& entities = state->layers[layer]->all_entities;
+        for (uint32_t i = 0; i < entities.size; ++i)
+        {
+            if (entities.uid_list[i] < first_uid)
+                continue;
+            const Entity* entity = entities.ent_list[i];
+            const Tracked entry{entity->uid, entity->type->id, entity->type->search_flags, layer};
+            tracked.push_back(entry);
+            spawned.push_back(entry);
+        }
+    }
+    next_uid = state->next_entity_uid;
+}
+
+void EntityDeltaTracker::resync()
+{
+    auto state = get_state_ptr();
+    std::vector<Tracked> current;
+    for (uint8_t layer = 0; layer < 2; ++layer)
+    {
+        const EntityList& entities = state->layers[layer]->all_entities;
+        for (uint32_t i = 0; i < entities.size; ++i)
+        {
+            const Entity* entity = entities.ent_list[i];
+            current.push_back({entity->uid, entity->type->id, entity->type->search_flags, layer});
+        }
+    }
+
+    auto by_uid = [](const Tracked& lhs, const Tracked& rhs)
+    { return lhs.uid < rhs.uid; };
+    std::sort(tracked.begin(), tracked.end(), by_uid);
+    std::sort(current.begin(), current.end(), by_uid);
+
+    // Only what actually differs is reported, a rollback of a few frames only brings back the few entities that changed in them
+    size_t i = 0;
+    size_t j = 0;
+    while (i < tracked.size() || j < current.size())
+    {
+        if (j == current.size() || (i < tracked.size() && tracked[i].uid < current[j].uid))
+        {
+            destroyed.push_back(tracked[i++]);
+        }
+        else if (i == tracked.size() || current[j].uid < tracked[i].uid)
+        {
+            spawned.push_back(current[j++]);
+        }
+        else
+        {
+            if (tracked[i].type != current[j].type)
+            {
+                destroyed.push_back(tracked[i]);
+                spawned.push_back(current[j]);
+            }
+            else if (tracked[i].layer != current[j].layer)
+            {
+                moved.push_back(current[j]);
+            }
+            ++i;
+            ++j;
+        }
+    }
+    tracked = std::move(current);
+    next_uid = state->next_entity_uid;
+}
+
+void EntityDeltaTracker::update()
+{
+    // The streams are created and collected by the scripts
+    std::lock_guard lock{global_lua_lock};
+    if (streams.empty())
+    {
+        // Nobody listens, so nothing is kept up to date either
+        if (active)
+        {
+            tracked = {};
+            active = false;
+        }
+        return;
+    }
+
+    spawned.clear();
+    destroyed.clear();
+    moved.clear();
+    auto state = get_state_ptr();
+    const uint32_t frame = HeapBase::get().frame_count();
+    const bool skipped = std::exchange(last_frame, frame) + 1 != frame;
+    if (!active)
+    {
+        // The first stream starts from the entities as they are now
+        tracked.clear();
+        track_spawned(0);
+        spawned.clear();
+        active = true;
+    }
+    else if (skipped || state->next_entity_uid < next_uid)
+    {
+        // The state was replaced (rollback, loaded state, reset), entities below the last next uid may be back and the ones above can be reused for others
+        resync();
+    }
+    else
+    {
+        size_t kept = 0;
+        for (Tracked& entry : tracked)
+        {
+            const Entity* entity = state->get_entity(entry.uid);
+            if (entity == nullptr || entity->type->id != entry.type)
+            {
+                destroyed.push_back(entry);
+                continue;
+            }
+            if (entity->layer != entry.layer)
+            {
+                entry.layer = entity->layer;
+                moved.push_back(entry);
+            }
+            tracked[kept++] = entry;
+        }
+        tracked.resize(kept);
+        track_spawned(next_uid);
+    }
+
+    for (EntityDeltaStream* stream : streams)
+    {
+        auto fill = [stream](std::vector<uint32_t>& out, const std::vector<Tracked>& entries)
+        {
+            out.clear();
+            for (const Tracked& entry : entries)
+            {
+                if ((stream->mask == ENTITY_MASK::ANY || !!(entry.mask & stream->mask)) && stream->types.contains(entry.type))
+                    out.push_back(entry.uid);
+            }
+        };
+        fill(stream->spawned, spawned);
+        fill(stream->destroyed, destroyed);
+        fill(stream->moved, moved);
+    }
+}
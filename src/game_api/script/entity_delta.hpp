@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint> // for uint32_t, uint8_t
+#include <vector>  // for vector
+
+#include "aliases.hpp"       // for ENT_TYPE, ENTITY_MASK
+#include "entity_lookup.hpp" // for EntityTypeSet
+
+class EntityDeltaTracker;
+
+// The uids of the matching entities that spawned, were destroyed or changed layers during the last state update
+// Everything also counts that scripts did between two updates, an entity spawned and destroyed in between shows up in neither
+// Owned by the backend of the script that subscribed, so it lives until unsubscribed or the script is unloaded instead of until the GC gets to it
+class EntityDeltaStream
+{
+  public:
+    // Registers with the tracker, there's nothing to track while no stream exists
+    EntityDeltaStream(std::vector<ENT_TYPE> entity_types, ENTITY_MASK mask_);
+    ~EntityDeltaStream();
+    EntityDeltaStream(const EntityDeltaStream&) = delete;
+    EntityDeltaStream& operator=(const EntityDeltaStream&) = delete;
+
+    const std::vector<uint32_t>& get_spawned() const
+    {
+        return spawned;
+    }
+    const std::vector<uint32_t>& get_destroyed() const
+    {
+        return destroyed;
+    }
+    const std::vector<uint32_t>& get_moved() const
+    {
+        return moved;
+    }
+
+    // Stops receiving deltas and empties the lists, the tracker stops once no stream is subscribed
+    void unsubscribe();
+    bool is_subscribed() const
+    {
+        return subscribed;
+    }
+
+  private:
+    friend class EntityDeltaTracker;
+
+    EntityTypeSet types;
+    ENTITY_MASK mask;
+    std::vector<uint32_t> spawned;
+    std::vector<uint32_t> destroyed;
+    std::vector<uint32_t> moved;
+    bool subscribed{true};
+};
+
+// Keeps the uid, type and layer of every entity while a stream exists and compares them with the state after each update,
+// the game destroys entities without a hook to catch it with and uids only increase, so comparing is exact
+// When the state is replaced (rollback, loaded state, reset) the tracked entities are matched against the whole state instead
+class EntityDeltaTracker
+{
+  public:
+    static EntityDeltaTracker& get();
+
+    // Called right after the state update, before ON.POST_UPDATE
+    void update();
+
+  private:
+    friend class EntityDeltaStream;
+
+    struct Tracked
+    {
+        uint32_t uid;
+        ENT_TYPE type;
+        ENTITY_MASK mask;
+        uint8_t layer;
+    };
+
+    EntityDeltaTracker() = default;
+
+    // Tracks and reports every entity from `first_uid` on
+    void track_spawned(uint32_t first_uid);
+    // Matches the tracked entities with every entity in the state, for when the uids can't be trusted to only increase
+    void resync();
+
+    std::vector<EntityDeltaStream*> streams;
+    std::vector<Tracked> tracked;
+    std::vector<Tracked> spawned;
+    std::vector<Tracked> destroyed;
+    std::vector<Tracked> moved;
+    uint32_t next_uid{0};
+    uint32_t last_frame{0};
+    bool active{false};
+};
@@ -6,14 +6,16 @@
 #include <type_traits>  // for move
 #include <utility>      // for max, pair, min
 
-#include "bucket.hpp"
-#include "constants.hpp"          // for no_return_str
-#include "level_api_types.hpp"    // for LevelGenRoomData
-#include "rpc.hpp"                // for game_log, get_adventure_seed
-#include "savestate.hpp"          // for invalidate_save_slots
-#include "script/lua_backend.hpp" // for LuaBackend, ON, LuaBackend::PreHan...
-#include "settings_api.hpp"       // for restore_original_settings
-#include "state.hpp"              // for StateMemory
+#include "bucket.hpp"                     // for Bucket, PauseAPI
+#include "entity.hpp"                     // for Entity
+#include "frame_telemetry.hpp"            // for FrameTelemetry
+#include "level_api_types.hpp"            // for LevelGenRoomData
+#include "rpc.hpp"                        // for game_log, get_adventure_seed
+#include "savestate.hpp"                  // for invalidate_save_slots
+#include "script/lua_backend.hpp"         // for LuaBackend, ON
+#include "script/usertypes/level_lua.hpp" // for PreHandleRoomTilesContext
+#include "settings_api.hpp"               // for restore_original_settings
+#include "state.hpp"                      // for StateMemory
 
 class JournalPage;
 struct AABB;
@@ -82,6 +84,13 @@ bool pre_unload_level()
     {
         g_level_loaded = false;
         invalidate_save_slots();
+        // The game frees the world emitters with the level, a new one can get the address of an old one
+        LuaBackend::for_each_backend(
+            [](LuaBackend::LockedBackend backend)
+            {
+                backend->particle_pool.forget_world();
+                return true;
+            });
     }
     return block;
 }
@@ -234,49 +243,74 @@ std::string pre_get_random_room(int x, int y, uint8_t layer, uint16_t room_templ
         });
     return manual_room_data;
 }
-std::optional<LevelGenRoomData> pre_handle_room_tiles(LevelGenRoomData room_data, int x, int y, uint16_t room_template)
+std::optional<LevelGenRoomData> pre_handle_room_tiles(const LevelGenRoomData& room_data, int x, int y, uint16_t room_template)
 {
-    std::optional<LevelGenRoomData> modded_room_data{std::nullopt};
+    // One context for all backends, the room is only copied once the first callback changes it
+    PreHandleRoomTilesContext ctx{room_data};
     LuaBackend::for_each_backend(
-        [=, &room_data, &modded_room_data](LuaBackend::LockedBackend backend)
+        [=, &ctx](LuaBackend::LockedBackend backend)
         {
-            auto [stop_callback, this_modded_room_data] = backend->pre_handle_room_tiles(room_data, x, y, room_template);
-            if (this_modded_room_data)
-            {
-                room_data = this_modded_room_data.value();
-                modded_room_data = this_modded_room_data;
-            }
-            return !stop_callback;
+            return !backend->pre_handle_room_tiles(ctx, x, y, room_template);
         });
-    return modded_room_data;
+    return std::move(ctx.modded_room_data);
 }
 
-bool pre_tile_code_spawn(std::string_view tile_code, float x, float y, int layer, uint16_t room_template)
+bool pre_tile_code_spawn(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template)
 {
     bool block_spawn{false};
-    LuaBackend::for_each_backend(
+    LuaBackend::for_each_subscriber(
+        BackendEvent::PRE_TILE_CODE,
         [&](LuaBackend::LockedBackend backend)
         {
-            block_spawn = backend->pre_tile_code(tile_code, x, y, layer, room_template);
+            block_spawn = backend->pre_tile_code(tile_code_id, x, y, layer, room_template);
             return !block_spawn;
         });
     return block_spawn;
 }
-void post_tile_code_spawn(std::string_view tile_code, float x, float y, int layer, uint16_t room_template)
+void post_tile_code_spawn(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template)
 {
 
-    LuaBackend::for_each_backend(
+    LuaBackend::for_each_subscriber(
+        BackendEvent::POST_TILE_CODE,
         [&](LuaBackend::LockedBackend backend)
         {
-            backend->post_tile_code(tile_code, x, y, layer, room_template);
+            backend->post_tile_code(tile_code_id, x, y, layer, room_template);
             return true;
         });
 }
 
+thread_local EntitySpawnDispatchBatch* g_entity_spawn_dispatch_batch{nullptr};
+
+EntitySpawnDispatchBatch::EntitySpawnDispatchBatch()
+    : outer{g_entity_spawn_dispatch_batch}, lock{global_lua_lock}, subscribers_generation{LuaBackend::get_subscribers_generation()}, pre_spawn_backends{LuaBackend::lock_subscribers(BackendEvent::PRE_ENTITY_SPAWN)}, post_spawn_backends{LuaBackend::lock_subscribers(BackendEvent::POST_ENTITY_SPAWN)}
+{
+    g_entity_spawn_dispatch_batch = this;
+}
+EntitySpawnDispatchBatch::~EntitySpawnDispatchBatch()
+{
+    g_entity_spawn_dispatch_batch = outer;
+}
+bool EntitySpawnDispatchBatch::is_current() const
+{
+    return subscribers_generation == LuaBackend::get_subscribers_generation();
+}
+
 Entity* pre_entity_spawn(std::uint32_t entity_type, float x, float y, int layer, Entity* overlay, int spawn_type_flags)
 {
     Entity* spawned_ent{nullptr};
-    LuaBackend::for_each_backend(
+    if (EntitySpawnDispatchBatch* batch = g_entity_spawn_dispatch_batch; batch != nullptr && batch->is_current())
+    {
+        for (LuaBackend::LockedBackend& backend : batch->pre_spawn_backends)
+        {
+            spawned_ent = backend->pre_entity_spawn(entity_type, x, y, layer, overlay, spawn_type_flags);
+            if (spawned_ent != nullptr)
+                break;
+        }
+        return spawned_ent;
+    }
+
+    LuaBackend::for_each_subscriber(
+        BackendEvent::PRE_ENTITY_SPAWN,
         [=, &spawned_ent](LuaBackend::LockedBackend backend)
         {
             spawned_ent = backend->pre_entity_spawn(entity_type, x, y, layer, overlay, spawn_type_flags);
@@ -286,7 +320,20 @@ Entity* pre_entity_spawn(std::uint32_t entity_type, float x, float y, int layer,
 }
 void post_entity_spawn(Entity* entity, int spawn_type_flags)
 {
-    LuaBackend::for_each_backend(
+    static const auto pause_api = Bucket::get()->pause_api;
+    pause_api->on_spawn(entity->type->id, entity->uid);
+
+    if (EntitySpawnDispatchBatch* batch = g_entity_spawn_dispatch_batch; batch != nullptr && batch->is_current())
+    {
+        for (LuaBackend::LockedBackend& backend : batch->post_spawn_backends)
+        {
+            backend->post_entity_spawn(entity, spawn_type_flags);
+        }
+        return;
+    }
+
+    LuaBackend::for_each_subscriber(
+        BackendEvent::POST_ENTITY_SPAWN,
         [=](LuaBackend::LockedBackend backend)
         {
             backend->post_entity_spawn(entity, spawn_type_flags);
@@ -297,7 +344,8 @@ void post_entity_spawn(Entity* entity, int spawn_type_flags)
 bool pre_entity_instagib(Entity* victim)
 {
     bool skip{false};
-    LuaBackend::for_each_backend(
+    LuaBackend::for_each_subscriber(
+        BackendEvent::PRE_ENTITY_INSTAGIB,
         [&](LuaBackend::LockedBackend backend)
         {
             skip |= backend->pre_entity_instagib(victim);
@@ -356,8 +404,13 @@ bool trigger_vanilla_render_layer_callbacks(ON event, uint8_t layer)
 
 bool trigger_vanilla_render_draw_depth_callbacks(ON event, uint8_t draw_depth, const AABB& bbox)
 {
+    // Runs for every draw depth of both layers, most of them have no listeners at all
+    if (!LuaBackend::has_draw_depth_subscribers(event, draw_depth))
+        return false;
+
     bool skip{false};
-    LuaBackend::for_each_backend(
+    LuaBackend::for_each_subscriber(
+        event == ON::RENDER_PRE_DRAW_DEPTH ? BackendEvent::RENDER_PRE_DRAW_DEPTH : BackendEvent::RENDER_POST_DRAW_DEPTH,
         [&](LuaBackend::LockedBackend backend)
         {
             skip |= backend->process_vanilla_render_draw_depth_callbacks(event, draw_depth, bbox);
@@ -378,44 +431,35 @@ bool trigger_vanilla_render_journal_page_callbacks(ON event, JournalPageType pag
     return skip;
 }
 
-std::u16string pre_speach_bubble(Entity* entity, char16_t* buffer)
+std::optional<std::u16string> pre_speach_bubble(Entity* entity, std::u16string_view text)
 {
-    std::u16string new_string{no_return_str};
-    bool return_empty_str = false;
-    LuaBackend::for_each_backend(
-        [=, &new_string, &return_empty_str](LuaBackend::LockedBackend backend)
+    std::optional<std::u16string> new_string;
+    LuaBackend::for_each_subscriber(
+        BackendEvent::SPEECH_BUBBLE,
+        [&](LuaBackend::LockedBackend backend)
         {
-            auto this_data = backend->pre_speach_bubble(entity, buffer);
-            if (this_data.empty() && new_string == no_return_str)
-                return_empty_str = true;
-
-            if (new_string == no_return_str)
-            {
+            // Every callback still runs, but the first string returned is the one shown
+            auto this_data = backend->pre_speach_bubble(entity, text);
+            if (!new_string)
                 new_string = std::move(this_data);
-            }
             return true;
         });
-    return return_empty_str ? u"" : new_string;
+    return new_string;
 }
 
-std::u16string pre_toast(char16_t* buffer)
+std::optional<std::u16string> pre_toast(std::u16string_view text)
 {
-    std::u16string new_string{no_return_str};
-    bool return_empty_str = false;
-    LuaBackend::for_each_backend(
-        [=, &new_string, &return_empty_str](LuaBackend::LockedBackend backend)
+    std::optional<std::u16string> new_string;
+    LuaBackend::for_each_subscriber(
+        BackendEvent::TOAST,
+        [&](LuaBackend::LockedBackend backend)
         {
-            auto this_data = backend->pre_toast(buffer);
-            if (this_data.empty() && new_string == no_return_str)
-                return_empty_str = true;
-
-            if (new_string == no_return_str)
-            {
+            auto this_data = backend->pre_toast(text);
+            if (!new_string)
                 new_string = std::move(this_data);
-            }
             return true;
         });
-    return return_empty_str ? u"" : new_string;
+    return new_string;
 }
 
 void update_backends()
@@ -465,7 +509,8 @@ std::optional<bool> pre_get_feat(FEAT feat)
 {
     std::optional<bool> got;
     bool block{false};
-    LuaBackend::for_each_backend(
+    LuaBackend::for_each_subscriber(
+        BackendEvent::PRE_GET_FEAT,
         [&](LuaBackend::LockedBackend backend)
         {
             std::optional<bool> ret = backend->pre_get_feat(feat);
@@ -482,7 +527,8 @@ std::optional<bool> pre_get_feat(FEAT feat)
 bool pre_set_feat(FEAT feat)
 {
     bool block{false};
-    LuaBackend::for_each_backend(
+    LuaBackend::for_each_subscriber(
+        BackendEvent::PRE_SET_FEAT,
         [&](LuaBackend::LockedBackend backend)
         {
             block = backend->pre_set_feat(feat);
@@ -520,10 +566,14 @@ void post_event(ON event)
 
 void pre_copy_state_event(HeapBase from, HeapBase to)
 {
+    const int64_t start = FrameTelemetry::now();
     LuaBackend::for_each_backend(
         [&](LuaBackend::LockedBackend backend)
         {
             backend->pre_copy_state(from, to);
             return true;
         });
+    CopyStateStats& stats = get_copy_state_stats();
+    stats.copies.fetch_add(1, std::memory_order_relaxed);
+    stats.copy_ticks.fetch_add(FrameTelemetry::now() - start, std::memory_order_relaxed);
 }
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <cstdint>     // for uint16_t, uint8_t, uint32_t
+#include <mutex>       // for unique_lock, recursive_mutex
 #include <optional>    // for optional
 #include <string>      // for u16string, string
 #include <string_view> // for string_view
+#include <vector>      // for vector
 
 #include "aliases.hpp"     // for JournalPageType
 #include "heap_base.hpp"   // for HeapBase
@@ -42,14 +44,38 @@ std::optional<bool> pre_get_feat(FEAT feat);
 bool pre_set_feat(FEAT feat);
 
 std::string pre_get_random_room(int x, int y, uint8_t layer, uint16_t room_template);
-std::optional<LevelGenRoomData> pre_handle_room_tiles(LevelGenRoomData room_data, int x, int y, uint16_t room_template);
+std::optional<LevelGenRoomData> pre_handle_room_tiles(const LevelGenRoomData& room_data, int x, int y, uint16_t room_template);
 
-bool pre_tile_code_spawn(std::string_view tile_code, float x, float y, int layer, uint16_t room_template);
-void post_tile_code_spawn(std::string_view tile_code, float x, float y, int layer, uint16_t room_template);
+bool pre_tile_code_spawn(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template);
+void post_tile_code_spawn(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template);
 
 Entity* pre_entity_spawn(std::uint32_t entity_type, float x, float y, int layer, Entity* overlay, int spawn_type_flags);
 void post_entity_spawn(Entity* entity, int spawn_type_flags);
 
+// While alive, pre_entity_spawn and post_entity_spawn on this thread dispatch to backends locked once when the batch was opened
+// Falls back to the regular dispatch if callbacks get added or removed during the batch
+class EntitySpawnDispatchBatch
+{
+  public:
+    EntitySpawnDispatchBatch();
+    ~EntitySpawnDispatchBatch();
+
+    EntitySpawnDispatchBatch(const EntitySpawnDispatchBatch&) = delete;
+    EntitySpawnDispatchBatch& operator=(const EntitySpawnDispatchBatch&) = delete;
+
+  private:
+    friend Entity* pre_entity_spawn(std::uint32_t, float, float, int, Entity*, int);
+    friend void post_entity_spawn(Entity*, int);
+
+    bool is_current() const;
+
+    EntitySpawnDispatchBatch* outer;
+    std::unique_lock<std::recursive_mutex> lock;
+    std::uint32_t subscribers_generation;
+    std::vector<LuaBackend::LockedBackend> pre_spawn_backends;
+    std::vector<LuaBackend::LockedBackend> post_spawn_backends;
+};
+
 bool pre_entity_instagib(Entity* victim);
 
 bool trigger_vanilla_render_callbacks(ON event);
@@ -59,8 +85,9 @@ bool trigger_vanilla_render_layer_callbacks(ON event, uint8_t layer);
 bool trigger_vanilla_render_draw_depth_callbacks(ON event, uint8_t draw_depth, const AABB& bbox);
 bool trigger_vanilla_render_journal_page_callbacks(ON event, JournalPageType page_type, JournalPage* page);
 
-std::u16string pre_speach_bubble(Entity* entity, char16_t* buffer);
-std::u16string pre_toast(char16_t* buffer);
+// Return nullopt when no callback changed the text, `text` has to be null terminated
+std::optional<std::u16string> pre_speach_bubble(Entity* entity, std::u16string_view text);
+std::optional<std::u16string> pre_toast(std::u16string_view text);
 
 void update_backends();
 
@@ -7,7 +7,7 @@
 #include "script/lua_backend.hpp" // for LuaBackend
 
 // Helper to cast an entity to its real type as a Lua userdata
-inline auto cast_entity(class Entity* ent);
+inline auto cast_entity(LuaBackend* calling_backend, class Entity* ent);
 
 template <class T>
 using optional_function_result = std::conditional_t<
@@ -7,9 +7,11 @@
 
 #include <sol/sol.hpp> // for state
 
-#include "entity.hpp"        // for Entity
-#include "script/lua_vm.hpp" // for get_lua_vm
-#include "util.hpp"          // for ON_SCOPE_EXIT
+#include "bucket.hpp"                   // for Bucket, PauseAPI
+#include "entity.hpp"                   // for Entity
+#include "level_gen_stats.hpp"          // for LevelGenCallbackScope
+#include "script/callback_profiler.hpp" // for CallbackProfiler
+#include "util.hpp"                     // for ON_SCOPE_EXIT
 
 template <class... ArgsT>
 auto handle_function_raw(LuaBackend* calling_backend, sol::function fun, ArgsT&&... args)
@@ -17,12 +19,26 @@ auto handle_function_raw(LuaBackend* calling_backend, sol::function fun, ArgsT&&
     LuaBackend::push_calling_backend(calling_backend);
     ON_SCOPE_EXIT(LuaBackend::pop_calling_backend(calling_backend));
 
+    LevelGenCallbackScope level_gen_scope;
+
+    if (calling_backend->rebound_functions.valid())
+        fun = calling_backend->resolve_rebound_function(std::move(fun));
+
+    const bool profile = CallbackProfiler::enabled;
+    const int64_t start = profile ? CallbackProfiler::now() : 0;
     auto lua_result = fun(std::forward<ArgsT>(args)...);
+    if (profile)
+    {
+        const CurrentCallback callback = calling_backend->get_current_callback();
+        calling_backend->profiler.record(callback.aux_id, callback.id, callback.type, CallbackProfiler::now() - start);
+    }
 
     if (!lua_result.valid())
     {
         sol::error e = lua_result;
         calling_backend->set_error(e.what());
+        static const auto pause_api = Bucket::get()->pause_api;
+        pause_api->on_error(e.what());
     }
 
     return lua_result;
@@ -82,20 +98,19 @@ auto handle_function_with_cast_entities(LuaBackend* calling_backend, sol::functi
 
 template <class T>
 concept entity_ptr = std::derived_from<std::remove_pointer_t<std::remove_reference_t<T>>, Entity>;
-inline auto cast_entity(Entity* ent)
+inline auto cast_entity(LuaBackend* calling_backend, Entity* ent)
 {
-    static auto& lua{get_lua_vm()};
-    return lua["cast_entity"](ent);
+    return calling_backend->get_entity_object(ent);
 }
 
 template <class T>
 struct forward_or_cast_entity_impl
 {
-    static T&& call(std::remove_reference_t<T>& val) noexcept
+    static T&& call(LuaBackend*, std::remove_reference_t<T>& val) noexcept
     {
         return static_cast<T&&>(val);
     }
-    static T&& call(std::remove_reference_t<T>&& val) noexcept
+    static T&& call(LuaBackend*, std::remove_reference_t<T>&& val) noexcept
     {
         static_assert(!std::is_lvalue_reference_v<T>, "bad forward call");
         return static_cast<T&&>(val);
@@ -104,20 +119,20 @@ struct forward_or_cast_entity_impl
 template <entity_ptr T>
 struct forward_or_cast_entity_impl<T>
 {
-    static auto call(Entity* val) noexcept
+    static auto call(LuaBackend* calling_backend, Entity* val) noexcept
     {
-        return cast_entity(val);
+        return cast_entity(calling_backend, val);
     }
 };
 
 template <class T>
-auto forward_or_cast_entity(T&& val) noexcept
+auto forward_or_cast_entity(LuaBackend* calling_backend, T&& val) noexcept
 {
-    return forward_or_cast_entity_impl<T>::call(val);
+    return forward_or_cast_entity_impl<T>::call(calling_backend, val);
 }
 
 template <class RetT, class... ArgsT>
 optional_function_result<RetT> handle_function(LuaBackend* calling_backend, sol::function fun, ArgsT&&... args)
 {
-    return handle_function_with_cast_entities<RetT>(calling_backend, std::move(fun), forward_or_cast_entity(std::forward<ArgsT>(args))...);
+    return handle_function_with_cast_entities<RetT>(calling_backend, std::move(fun), forward_or_cast_entity(calling_backend, std::forward<ArgsT>(args))...);
 }
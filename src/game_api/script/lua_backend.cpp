@@ -1,8 +1,12 @@
 #include "lua_backend.hpp"
 
+#include <algorithm>    // for any_of
+#include <array>        // for array
 #include <assert.h>     // for assert
+#include <cmath>        // for isnan
 #include <cstddef>      // for size_t
 #include <exception>    // for exception
+#include <filesystem>   // for last_write_time
 #include <fmt/format.h> // for format_error
 #include <list>         // for _List_iterator, _List_co...
 #include <sol/sol.hpp>  // for table_proxy, optional
@@ -13,30 +17,52 @@
 
 #include "aliases.hpp"                // for IMAGE, JournalPageType
 #include "bucket.hpp"                 // for Bucket
-#include "constants.hpp"              // for no_return_str
+#include "demand_hook.hpp"            // for attach_demand_hooks
 #include "entities_chars.hpp"         // for Player
 #include "entity.hpp"                 // for Entity, get_entity_ptr
+#include "entity_delta.hpp"           // for EntityDeltaStream
+#include "entity_fields.hpp"          // for EntityField, read_entity_field
+#include "file_api.hpp"               // for set_async_game_writes
+#include "frame_limiter.hpp"          // for FrameLimiter
+#include "frame_telemetry.hpp"        // for FrameTelemetry
+#include "game_heap_stats.hpp"        // for GameHeapStats, GameHeapTag
 #include "handle_lua_function.hpp"    // for handle_function
 #include "items.hpp"                  // for Inventory
 #include "level_api.hpp"              // for LevelGenData, LevelGenSy...
 #include "level_api_types.hpp"        // for LevelGenRoomData
+#include "liquid_budget.hpp"          // for LiquidBudget
 #include "lua_console.hpp"            // for LuaConsole
+#include "lua_lazy.hpp"               // for lazy_global_index
+#include "lua_libs/lua_pack.hpp"      // for unpack_lua_value
+#include "lua_memory.hpp"             // for LuaMemoryAccount, set_current_lua...
+#include "lua_sampler.hpp"            // for install_lua_hook
 #include "lua_vm.hpp"                 // for acquire_lua_vm, get_lua_vm
+#include "lua_watchdog.hpp"           // for LuaWatchdog
 #include "math.hpp"                   // for AABB
 #include "movable_behavior.hpp"       // for CustomMovableBehavior
 #include "overloaded.hpp"             // for overloaded
+#include "render_api.hpp"             // for RenderInfo, RenderAPI
 #include "rpc.hpp"                    // for set_level_string
 #include "screen.hpp"                 // for get_screen_ptr, Screen
 #include "script_util.hpp"            // for InputString
 #include "sound_manager.hpp"          // for SoundManager
 #include "state.hpp"                  // for StateMemory, get_...
 #include "strings.hpp"                // for clear_custom_shopitem_names
+#include "turbo.hpp"                  // for Turbo
 #include "usertypes/gui_lua.hpp"      // for GuiDrawContext
 #include "usertypes/level_lua.hpp"    // for PreHandleRoomTilesContext
 #include "usertypes/save_context.hpp" // for LoadContext, SaveContext
+#include "usertypes/socket_lua.hpp"   // for deliver_udp_packets
 #include "window_api.hpp"             // for get_window
 
 std::vector<std::unique_ptr<LuaBackend::ProtectedBackend>> g_all_backends;
+// Both guarded by global_lua_lock, the lists are rebuilt lazily on the next dispatch after being invalidated
+std::array<std::vector<LuaBackend::ProtectedBackend*>, (size_t)BackendEvent::COUNT> g_event_subscribers;
+bool g_event_subscribers_dirty{true};
+std::uint32_t g_event_subscribers_generation{0};
+int g_event_dispatch_depth{0};
+// Union over all backends for ON.RENDER_PRE_DRAW_DEPTH and ON.RENDER_POST_DRAW_DEPTH, rebuilt with the subscriber lists
+std::array<uint64_t, 2> g_draw_depth_interest{};
 std::unordered_map<int, HotKey> g_hotkeys;
 int g_hotkey_count = 0;
 
@@ -57,9 +83,27 @@ LuaBackend::LuaBackend(SoundManager* sound_mgr, LuaConsole* con)
 
     populate_lua_env(lua);
 
+    // Watch for deprecated handlers being defined, so update doesn't have to look them up for every script every frame
+    // Only new keys reach __newindex, clear_all_callbacks removes the handlers again so redefining them is noticed
+    sol::table env_meta = vm->create_table();
+    env_meta["__newindex"] = [assigned = deprecated_callbacks_assigned](sol::table env, sol::object key, sol::object value)
+    {
+        if (value != sol::lua_nil && key.get_type() == sol::type::string)
+        {
+            using namespace std::string_view_literals;
+            static constexpr std::array deprecated_handlers{"on_frame"sv, "on_camp"sv, "on_level"sv, "on_start"sv, "on_transition"sv, "on_death"sv, "on_win"sv, "on_screen"sv};
+            const auto name = key.as<std::string_view>();
+            *assigned = *assigned || std::find(deprecated_handlers.begin(), deprecated_handlers.end(), name) != deprecated_handlers.end();
+        }
+        env.raw_set(key, value);
+    };
+    env_meta["__index"] = &lazy_global_index;
+    lua[sol::metatable_key] = env_meta;
+
     std::lock_guard lock{global_lua_lock};
     g_all_backends.emplace_back(new ProtectedBackend{this});
     self = g_all_backends.back().get();
+    g_event_subscribers_dirty = true;
 }
 LuaBackend::~LuaBackend()
 {
@@ -67,7 +111,7 @@ LuaBackend::~LuaBackend()
         auto self_lock = self->Lock();
 
         auto& global_vm = *vm;
-        for (const std::string& module : loaded_modules)
+        for (const auto& [module, loaded] : loaded_modules)
         {
             global_vm["package"]["loaded"][module] = sol::nil;
             global_vm["_G"][module] = sol::nil;
@@ -80,29 +124,139 @@ LuaBackend::~LuaBackend()
         std::lock_guard lock{global_lua_lock};
         std::erase_if(g_all_backends, [this](const std::unique_ptr<ProtectedBackend>& protected_backend)
                       { return protected_backend.get() == self; });
+        g_event_subscribers_dirty = true;
+    }
+}
+
+void TimerStorage::add(int id, TimerCallback timer)
+{
+    const int due = std::visit(
+        overloaded{
+            [](const IntervalCallback& cb)
+            { return cb.lastRan + cb.interval; },
+            [](const TimeoutCallback& cb)
+            { return cb.timeout; },
+        },
+        timer);
+    timers[id] = std::move(timer);
+    schedule(id, due);
+}
+void TimerStorage::erase(int id)
+{
+    // Stale timeline entries are skipped in pop_due
+    timers.erase(id);
+    due_frames.erase(id);
+}
+void TimerStorage::clear()
+{
+    timers.clear();
+    due_frames.clear();
+    timeline.clear();
+}
+void TimerStorage::schedule(int id, int frame)
+{
+    due_frames[id] = frame;
+    timeline[frame].push_back(id);
+}
+std::vector<int> TimerStorage::pop_due(int now)
+{
+    std::vector<int> due;
+    auto it = timeline.begin();
+    for (; it != timeline.end() && it->first <= now; ++it)
+    {
+        for (int id : it->second)
+        {
+            auto due_it = due_frames.find(id);
+            if (due_it != due_frames.end() && due_it->second == it->first)
+            {
+                due_frames.erase(due_it);
+                due.push_back(id);
+            }
+        }
     }
+    timeline.erase(timeline.begin(), it);
+    return due;
+}
+
+void CoroutineScheduler::add(int id, sol::function func)
+{
+    // Every coroutine needs its own thread, resuming it from the main one wouldn't let it yield
+    sol::thread thread = sol::thread::create(get_lua_vm().lua_state());
+    sol::coroutine coroutine{thread.thread_state(), func};
+    coroutines.push_back({id, std::move(thread), std::move(coroutine)});
+}
+void CoroutineScheduler::erase(int id)
+{
+    auto it = std::find_if(coroutines.begin(), coroutines.end(), [id](const ScheduledCoroutine& co)
+                           { return co.id == id; });
+    if (it == coroutines.end())
+        return;
+
+    if (static_cast<size_t>(it - coroutines.begin()) < next)
+        next--;
+    coroutines.erase(it);
+}
+void CoroutineScheduler::clear()
+{
+    coroutines.clear();
+    next = 0;
 }
 
 LocalStateData& LuaBackend::get_locals()
 {
     return local_state_datas[HeapBase::get().state()];
 }
+LuaMemoryAccount& LuaBackend::get_memory_account()
+{
+    if (memory_account == nullptr)
+        memory_account = &get_lua_memory_account(get_path());
+    return *memory_account;
+}
+
+sol::object LuaBackend::get_entity_object(Entity* entity)
+{
+    if (entity == nullptr)
+        return sol::lua_nil;
+
+    StateMemory* state = HeapBase::get().state();
+    auto it = entity_objects.entries.find(entity->uid);
+    if (it != entity_objects.entries.end())
+    {
+        const EntityObjectCache::Entry& entry = it->second;
+        if (entry.entity == entity && entry.state == state && entry.type == entity->type->id)
+            return entry.object;
+    }
+
+    // Dead entities are only replaced when their uid is looked up again, keep the cache from growing over a long run
+    static constexpr size_t max_cached_entities = 4096;
+    if (entity_objects.entries.size() >= max_cached_entities)
+        entity_objects.entries.clear();
+
+    sol::object object = (*vm)["cast_entity"](entity);
+    entity_objects.entries[entity->uid] = {entity, state, entity->type->id, object};
+    return object;
+}
 
 void LuaBackend::clear()
 {
     clear_all_callbacks();
+    entity_objects.entries.clear();
+    // Nothing from before is left to call the old functions
+    rebound_functions = sol::table{};
 
     (get_unsafe()
          ? expose_unsafe_libraries
          : hide_unsafe_libraries)(lua);
 }
-void LuaBackend::clear_all_callbacks()
+void LuaBackend::clear_all_callbacks(bool keep_entity_hooks)
 {
     // Clear all callbacks on script reload to avoid running them
     // multiple times.
     level_timers.clear();
     global_timers.clear();
+    scheduled_coroutines.clear();
     callbacks.clear();
+    render_batch_callbacks.clear();
     for (auto id : vanilla_sound_callbacks)
     {
         sound_manager->clear_callback(id);
@@ -110,11 +264,38 @@ void LuaBackend::clear_all_callbacks()
     load_callbacks.clear();
     save_callbacks.clear();
     vanilla_sound_callbacks.clear();
+    sound_callback_queue->clear();
+    sound_voices.clear();
     pre_tile_code_callbacks.clear();
     post_tile_code_callbacks.clear();
+    pre_tile_code_index.clear();
+    post_tile_code_index.clear();
     pre_entity_spawn_callbacks.clear();
     post_entity_spawn_callbacks.clear();
+    pre_entity_spawn_index.clear();
+    post_entity_spawn_index.clear();
     pre_entity_instagib_callbacks.clear();
+    field_watch_callbacks.clear();
+    asset_preload_callbacks.clear();
+    async_save_callbacks.clear();
+    for (auto& job : job_callbacks)
+        job.cancel->store(true, std::memory_order_relaxed);
+    job_callbacks.clear();
+    udp_listeners.clear();
+    entity_delta_streams.clear();
+    particle_pool.clear();
+    // The texts the script drew are unlikely to be drawn again by the next one
+    RenderAPI::get().clear_prepared_texts();
+    profiler.reset();
+    if (std::exchange(async_savegame, false))
+        set_async_game_writes(false);
+    if (std::exchange(frame_limiter, false))
+        FrameLimiter::get().set(std::nullopt);
+    if (std::exchange(liquid_budget, false))
+        LiquidBudget::get().set_budget(0.0f, 0);
+    if (std::exchange(turbo, false))
+        Turbo::get().set(std::nullopt);
+    invalidate_subscribers();
     for (auto id : chance_callbacks)
     {
         g_state->level_gen->data->unregister_chance_logic_provider(id);
@@ -137,9 +318,14 @@ void LuaBackend::clear_all_callbacks()
     }
     hotkey_callbacks.clear();
 
-    HookHandler<Entity, CallbackType::Entity>::clear_all_hooks();
-    HookHandler<RenderInfo, CallbackType::Entity>::clear_all_hooks();
+    if (!keep_entity_hooks)
+    {
+        HookHandler<Entity, CallbackType::Entity>::clear_all_hooks();
+        HookHandler<RenderInfo, CallbackType::Entity>::clear_all_hooks();
+        user_datas.clear();
+    }
     HookHandler<ThemeInfo, CallbackType::Theme>::clear_all_hooks();
+    clear_all_type_hooks();
 
     for (auto& [screen_id, id] : screen_hooks)
     {
@@ -155,13 +341,6 @@ void LuaBackend::clear_all_callbacks()
     screen_hooks.clear();
     clear_screen_hooks.clear();
     options.clear();
-    for (auto& [uid, user_data] : user_datas)
-    {
-        if (Entity* entity = get_entity_ptr(uid))
-        {
-            entity->clean_on_dtor(user_data.dtor_hook_id);
-        }
-    }
     required_scripts.clear();
     console_commands.clear();
     lua["on_guiframe"] = sol::lua_nil;
@@ -173,6 +352,79 @@ void LuaBackend::clear_all_callbacks()
     lua["on_death"] = sol::lua_nil;
     lua["on_win"] = sol::lua_nil;
     lua["on_screen"] = sol::lua_nil;
+    *deprecated_callbacks_assigned = false;
+}
+
+void LuaBackend::invalidate_changed_modules()
+{
+    auto& global_vm = *vm;
+    std::erase_if(loaded_modules, [&](const auto& module)
+                  {
+                      std::error_code ec;
+                      if (std::filesystem::last_write_time(module.second.file, ec) == module.second.write_time)
+                          return false;
+                      global_vm["package"]["loaded"][module.first] = sol::nil;
+                      return true; });
+}
+std::unordered_map<std::string, sol::function> LuaBackend::collect_named_functions()
+{
+    std::unordered_map<std::string, sol::function> functions;
+    auto collect = [&](const std::string& prefix, sol::table table)
+    {
+        table.for_each([&](const sol::object& key, const sol::object& value)
+                       {
+                           if (key.get_type() == sol::type::string && value.get_type() == sol::type::function)
+                               functions[prefix + key.as<std::string>()] = value.as<sol::function>(); });
+    };
+
+    // Only one level deep, that's where the functions handed to hooks usually live
+    lua.for_each([&](const sol::object& key, const sol::object& value)
+                 {
+                     if (key.get_type() != sol::type::string)
+                         return;
+                     if (value.get_type() == sol::type::function)
+                         functions[key.as<std::string>()] = value.as<sol::function>();
+                     else if (value.get_type() == sol::type::table)
+                         collect(key.as<std::string>() + ".", value.as<sol::table>()); });
+
+    sol::table package_loaded = (*vm)["package"]["loaded"];
+    for (const auto& [module, loaded] : loaded_modules)
+    {
+        if (sol::object result = package_loaded[module]; result.get_type() == sol::type::table)
+            collect("require:" + module + ".", result.as<sol::table>());
+    }
+    return functions;
+}
+void LuaBackend::rebind_named_functions(const std::unordered_map<std::string, sol::function>& before)
+{
+    const std::unordered_map<std::string, sol::function> after = collect_named_functions();
+    for (const auto& [name, old_function] : before)
+    {
+        auto it = after.find(name);
+        if (it == after.end() || it->second == old_function)
+            continue;
+        // Would loop forever if the old function is what the new one already leads back to
+        if (rebound_functions.valid() && resolve_rebound_function(it->second) == old_function)
+            continue;
+
+        if (!rebound_functions.valid())
+        {
+            rebound_functions = vm->create_table();
+            rebound_functions[sol::metatable_key] = vm->create_table_with("__mode", "k");
+        }
+        rebound_functions[old_function] = it->second;
+    }
+}
+sol::function LuaBackend::resolve_rebound_function(sol::function func)
+{
+    // Rebound again by every later hot reload, so follow it to the newest
+    while (true)
+    {
+        sol::object next = rebound_functions.raw_get<sol::object>(func);
+        if (next.get_type() != sol::type::function)
+            return func;
+        func = next.as<sol::function>();
+    }
 }
 
 CustomMovableBehavior* LuaBackend::get_custom_movable_behavior(std::string_view name)
@@ -197,41 +449,21 @@ CustomMovableBehavior* LuaBackend::make_custom_movable_behavior(std::string_view
 
 sol::object LuaBackend::get_user_data(Entity& entity)
 {
-    if (user_datas.contains(entity.uid))
-    {
-        return user_datas[entity.uid].data;
-    }
-    return sol::nil;
+    return user_datas.get(entity);
 }
 sol::object LuaBackend::get_user_data(uint32_t uid)
 {
-    if (user_datas.contains(uid))
-    {
-        return user_datas[uid].data;
-    }
-    return sol::nil;
+    return user_datas.get(uid);
 }
 void LuaBackend::set_user_data(Entity& entity, sol::object user_data)
 {
-    if (!user_datas.contains(entity.uid))
-    {
-        uint32_t dtor_hook_id = entity.set_on_dtor(
-            [this, uid = entity.uid](Entity*)
-            {
-                user_datas.erase(uid);
-            });
-        user_datas[entity.uid].dtor_hook_id = dtor_hook_id;
-    }
-    if (user_data == sol::nil)
-        user_datas.erase(entity.uid);
-    else
-        user_datas[entity.uid].data = user_data;
+    user_datas.set(entity, std::move(user_data));
     on_set_user_data(&entity);
 }
 void LuaBackend::set_user_data(uint32_t uid, sol::object user_data)
 {
-    auto ent = get_entity_ptr(uid);
-    set_user_data(*ent, user_data);
+    if (auto ent = get_entity_ptr(uid))
+        set_user_data(*ent, std::move(user_data));
 }
 
 bool LuaBackend::update()
@@ -239,6 +471,11 @@ bool LuaBackend::update()
     if (!get_enabled())
         return true;
 
+    profiler.next_frame();
+    messages.flush();
+    // Stands in for the dtor hooks, the data of destroyed entities is let go of a few slots at a time
+    user_datas.sweep(256);
+
     if (!pre_update())
     {
         return false;
@@ -246,28 +483,35 @@ bool LuaBackend::update()
 
     try
     {
+        // Sound callbacks that FMOD fired since the last update, before anything else so scripts see them in the order they happened
+        sound_callback_queue->run();
+
         // Deprecated =======
 
+        const bool check_deprecated = *deprecated_callbacks_assigned;
+        auto get_deprecated = [&](const char* name) -> sol::optional<sol::function>
+        { return check_deprecated ? lua[name].get<sol::optional<sol::function>>() : sol::nullopt; };
+
         /// Use `set_callback(function, ON.FRAME)` instead
-        sol::optional<sol::function> on_frame = lua["on_frame"];
+        sol::optional<sol::function> on_frame = get_deprecated("on_frame");
         /// Use `set_callback(function, ON.CAMP)` instead
-        sol::optional<sol::function> on_camp = lua["on_camp"];
+        sol::optional<sol::function> on_camp = get_deprecated("on_camp");
         /// Use `set_callback(function, ON.LEVEL)` instead
-        sol::optional<sol::function> on_level = lua["on_level"];
+        sol::optional<sol::function> on_level = get_deprecated("on_level");
         /// Use `set_callback(function, ON.START)` instead
-        sol::optional<sol::function> on_start = lua["on_start"];
+        sol::optional<sol::function> on_start = get_deprecated("on_start");
         /// Use `set_callback(function, ON.TRANSITION)` instead
-        sol::optional<sol::function> on_transition = lua["on_transition"];
+        sol::optional<sol::function> on_transition = get_deprecated("on_transition");
         /// Use `set_callback(function, ON.DEATH)` instead
-        sol::optional<sol::function> on_death = lua["on_death"];
+        sol::optional<sol::function> on_death = get_deprecated("on_death");
         /// Use `set_callback(function, ON.WIN)` instead
-        sol::optional<sol::function> on_win = lua["on_win"];
+        sol::optional<sol::function> on_win = get_deprecated("on_win");
         /// Use `set_callback(function, ON.SCREEN)` instead
-        sol::optional<sol::function> on_screen = lua["on_screen"];
+        sol::optional<sol::function> on_screen = get_deprecated("on_screen");
 
         // ==========
 
-        if (LuaConsole* is_console = dynamic_cast<LuaConsole*>(this))
+        if (console == this)
         {
             /// NoDoc
             lua["P"] = lua["get_player"](1);
@@ -327,7 +571,9 @@ bool LuaBackend::update()
         {
             level_timers.erase(id);
             global_timers.erase(id);
+            scheduled_coroutines.erase(id);
             callbacks.erase(id);
+            render_batch_callbacks.erase(id);
             load_callbacks.erase(id);
             save_callbacks.erase(id);
             if (hotkey_callbacks.contains(id))
@@ -340,17 +586,25 @@ bool LuaBackend::update()
                 }
             }
             hotkey_callbacks.erase(id);
-
-            std::erase_if(pre_tile_code_callbacks, [id](auto& cb)
-                          { return cb.id == id; });
-            std::erase_if(post_tile_code_callbacks, [id](auto& cb)
-                          { return cb.id == id; });
-            std::erase_if(pre_entity_spawn_callbacks, [id](auto& cb)
-                          { return cb.id == id; });
-            std::erase_if(post_entity_spawn_callbacks, [id](auto& cb)
-                          { return cb.id == id; });
-            std::erase_if(pre_entity_instagib_callbacks, [id](auto& cb)
-                          { return cb.id == id; });
+        }
+        if (!clear_callbacks.empty())
+        {
+            // One sweep per vector instead of one per cleared callback
+            const auto is_cleared = [this](auto& cb)
+            { return clear_callbacks.contains(cb.id); };
+            std::erase_if(pre_tile_code_callbacks, is_cleared);
+            std::erase_if(post_tile_code_callbacks, is_cleared);
+            std::erase_if(pre_entity_spawn_callbacks, is_cleared);
+            std::erase_if(post_entity_spawn_callbacks, is_cleared);
+            std::erase_if(pre_entity_instagib_callbacks, is_cleared);
+            std::erase_if(field_watch_callbacks, is_cleared);
+            clear_pending_type_hooks(clear_callbacks);
+
+            pre_tile_code_index.rebuild(pre_tile_code_callbacks);
+            post_tile_code_index.rebuild(post_tile_code_callbacks);
+            pre_entity_spawn_index.rebuild(pre_entity_spawn_callbacks);
+            post_entity_spawn_index.rebuild(post_entity_spawn_callbacks);
+            invalidate_subscribers();
         }
         clear_callbacks.clear();
 
@@ -360,54 +614,24 @@ bool LuaBackend::update()
 
         for (auto& [screen_id, id] : clear_screen_hooks)
         {
-            auto it = std::find(screen_hooks.begin(), screen_hooks.end(), std::pair{screen_id, id});
-            if (it != screen_hooks.end())
+            if (screen_hooks.erase({screen_id, id}) != 0)
             {
                 auto screen = get_screen_ptr(screen_id);
                 if (screen != nullptr)
                 {
                     screen->unhook(id);
                 }
-                screen_hooks.erase(it);
             }
         }
         clear_screen_hooks.clear();
 
-        for (auto it = global_timers.begin(); it != global_timers.end();)
-        {
-            int now = heap.frame_count();
-            if (auto cb = std::get_if<IntervalCallback>(&it->second))
-            {
-                if (now >= cb->lastRan + cb->interval && !is_callback_cleared(it->first))
-                {
-                    auto _scope = set_current_callback(-1, it->first, CallbackType::Normal);
-                    std::optional<bool> keep_going = handle_function<bool>(this, cb->func);
-                    cb->lastRan = now;
-                    if (!keep_going.value_or(true))
-                    {
-                        it = global_timers.erase(it);
-                        continue;
-                    }
-                }
-                ++it;
-            }
-            else if (auto cbt = std::get_if<TimeoutCallback>(&it->second))
-            {
-                if (now >= cbt->timeout && !is_callback_cleared(it->first))
-                {
-                    auto _scope = set_current_callback(-1, it->first, CallbackType::Normal);
-                    handle_function<void>(this, cbt->func);
-                    it = global_timers.erase(it);
-                }
-                else
-                {
-                    ++it;
-                }
-            }
-            else
-            {
-                ++it;
-            }
+        run_due_timers(global_timers, heap.frame_count());
+        run_scheduled_coroutines();
+        run_finished_preloads();
+        run_finished_saves();
+        run_finished_jobs();
+        NSocket::deliver_udp_packets(*this);
+        particle_pool.collect_finished();
         }
 
         auto now = heap.frame_count();
@@ -507,40 +731,7 @@ bool LuaBackend::update()
             }
         }
         const int now_l = state->time_level;
-        for (auto it = level_timers.begin(); it != level_timers.end();)
-        {
-            if (auto cb = std::get_if<IntervalCallback>(&it->second))
-            {
-                if (now_l >= cb->lastRan + cb->interval && !is_callback_cleared(it->first))
-                {
-                    auto _scope = set_current_callback(-1, it->first, CallbackType::Normal);
-                    std::optional<bool> keep_going = handle_function<bool>(this, cb->func);
-                    cb->lastRan = now_l;
-                    if (!keep_going.value_or(true))
-                    {
-                        it = level_timers.erase(it);
-                        continue;
-                    }
-                }
-                ++it;
-            }
-            else if (auto cbt = std::get_if<TimeoutCallback>(&it->second))
-            {
-                if (now_l >= cbt->timeout && !is_callback_cleared(it->first))
-                {
-                    auto _scope = set_current_callback(-1, it->first, CallbackType::Normal);
-                    handle_function<void>(this, cbt->func);
-                    it = level_timers.erase(it);
-                }
-                else
-                {
-                    ++it;
-                }
-            }
-            else
-            {
-                ++it;
-            }
+        run_due_timers(level_timers, now_l);
         }
 
         // Save callbacks have to run after all other callbacks or manual saves that happen after
@@ -579,6 +770,29 @@ bool LuaBackend::update()
     return true;
 }
 
+bool CallbackThrottle::should_run(const ScriptState& state) const
+{
+    if (!ran)
+        return true;
+    if (on_change && state.screen == screen && state.time_level == time_level)
+        return false;
+    return std::chrono::steady_clock::now() - last_run >= interval;
+}
+ImDrawList* CallbackThrottle::begin_run(const ScriptState& state)
+{
+    if (!output)
+        output = std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData());
+    output->_ResetForNewFrame();
+    output->PushClipRectFullScreen();
+    output->PushTextureID(ImGui::GetIO().Fonts->TexID);
+
+    ran = true;
+    last_run = std::chrono::steady_clock::now();
+    screen = state.screen;
+    time_level = state.time_level;
+    return output.get();
+}
+
 void LuaBackend::draw(ImDrawList* dl)
 {
     static const auto bucket = Bucket::get();
@@ -600,18 +814,30 @@ void LuaBackend::draw(ImDrawList* dl)
             on_guiframe.value()(draw_ctx);
         }
 
-        for (auto& [id, callback] : callbacks)
+        for (auto& [id, callback] : callbacks.of(ON::GUIFRAME))
         {
             if (is_callback_cleared(id))
                 continue;
 
             auto now = HeapBase::get().frame_count();
-            if (callback.screen == ON::GUIFRAME)
+
+            if (callback.throttle)
             {
-                auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-                handle_function<void>(this, callback.func, draw_ctx);
-                callback.lastRan = now;
+                CallbackThrottle& throttle = *callback.throttle;
+                if (throttle.should_run(script_state))
+                {
+                    auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+                    draw_list = throttle.begin_run(script_state);
+                    handle_function<void>(this, callback.func, draw_ctx);
+                    draw_list = dl;
+                    callback.lastRan = now;
+                }
+                append_draw_list(*throttle.output, dl, {0.0f, 0.0f});
+                continue;
             }
+            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+            handle_function<void>(this, callback.func, draw_ctx);
+            callback.lastRan = now;
         }
 
         for (auto& [id, callback] : hotkey_callbacks)
@@ -724,49 +950,51 @@ void LuaBackend::render_options()
 
 bool LuaBackend::is_callback_cleared(int32_t callback_id) const
 {
-    return std::find(clear_callbacks.begin(), clear_callbacks.end(), callback_id) != clear_callbacks.end();
+    return clear_callbacks.contains(callback_id);
 }
 bool LuaBackend::is_screen_callback_cleared(std::pair<int32_t, uint32_t> callback_id) const
 {
-    return std::find(clear_screen_hooks.begin(), clear_screen_hooks.end(), callback_id) != clear_screen_hooks.end();
+    return clear_screen_hooks.contains(callback_id);
 }
 
-bool LuaBackend::pre_tile_code(std::string_view tile_code, float x, float y, int layer, uint16_t room_template)
+bool LuaBackend::pre_tile_code(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template)
 {
     if (!get_enabled())
         return false;
 
-    for (auto& callback : pre_tile_code_callbacks)
-    {
-        if (is_callback_cleared(callback.id))
-            continue;
-
-        if (callback.tile_code == tile_code)
+    bool block_spawn{false};
+    pre_tile_code_index.refresh(pre_tile_code_callbacks);
+    pre_tile_code_index.for_each_candidate(
+        tile_code_id,
+        [&](size_t index)
         {
-            if (handle_function<bool>(this, callback.func, x, y, layer, room_template).value_or(false))
-            {
+            auto& callback = pre_tile_code_callbacks[index];
+            if (is_callback_cleared(callback.id))
                 return true;
-            }
-        }
-    }
-    return false;
+
+            block_spawn = handle_function<bool>(this, callback.func, x, y, layer, room_template).value_or(false);
+            return !block_spawn;
+        });
+    return block_spawn;
 }
-void LuaBackend::post_tile_code(std::string_view tile_code, float x, float y, int layer, uint16_t room_template)
+void LuaBackend::post_tile_code(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template)
 {
     if (!get_enabled())
         return;
 
-    for (auto& callback : post_tile_code_callbacks)
-    {
-        if (is_callback_cleared(callback.id))
-            continue;
-
-        if (callback.tile_code == tile_code)
+    post_tile_code_index.refresh(post_tile_code_callbacks);
+    post_tile_code_index.for_each_candidate(
+        tile_code_id,
+        [&](size_t index)
         {
+            auto& callback = post_tile_code_callbacks[index];
+            if (is_callback_cleared(callback.id))
+                return true;
+
             auto _scope = set_current_callback(-1, callback.id, CallbackType::Normal);
             handle_function<void>(this, callback.func, x, y, layer, room_template);
-        }
-    }
+            return true;
+        });
 }
 
 void LuaBackend::pre_load_level_files()
@@ -776,17 +1004,14 @@ void LuaBackend::pre_load_level_files()
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LOAD_LEVEL_FILES))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LOAD_LEVEL_FILES)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, PreLoadLevelFilesContext{});
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, PreLoadLevelFilesContext{});
+        callback.lastRan = now;
     }
 }
 bool LuaBackend::pre_init_level()
@@ -796,19 +1021,16 @@ bool LuaBackend::pre_init_level()
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LEVEL_CREATION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LEVEL_CREATION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
     return false;
 }
@@ -819,19 +1041,16 @@ bool LuaBackend::pre_init_layer(LAYER layer)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LAYER_CREATION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LAYER_CREATION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func, layer).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func, layer).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
     return false;
 }
@@ -849,19 +1068,16 @@ bool LuaBackend::pre_load_screen()
         set_level_string(u"%d-%d"sv);
     }
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LOAD_SCREEN))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LOAD_SCREEN)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
 
     if ((ON)state_ptr->screen == ON::LEVEL && (ON)state_ptr->screen_next != ON::DEATH && (state_ptr->quest_flags & 1) == 0)
@@ -942,19 +1158,16 @@ bool LuaBackend::pre_unload_level()
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LEVEL_DESTRUCTION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LEVEL_DESTRUCTION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
 
     return false;
@@ -966,19 +1179,16 @@ bool LuaBackend::pre_unload_layer(LAYER layer)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LAYER_DESTRUCTION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LAYER_DESTRUCTION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func, layer).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func, layer).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
 
     return false;
@@ -991,17 +1201,14 @@ void LuaBackend::post_room_generation()
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_ROOM_GENERATION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_ROOM_GENERATION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, PostRoomGenerationContext{});
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, PostRoomGenerationContext{});
+        callback.lastRan = now;
     }
 }
 
@@ -1067,17 +1274,14 @@ void LuaBackend::post_level_generation()
         saved_user_datas.clear();
     }
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_LEVEL_GENERATION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_LEVEL_GENERATION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func);
+        callback.lastRan = now;
     }
 }
 void LuaBackend::post_init_layer(LAYER layer)
@@ -1087,17 +1291,14 @@ void LuaBackend::post_init_layer(LAYER layer)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_LAYER_CREATION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_LAYER_CREATION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, layer);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, layer);
+        callback.lastRan = now;
     }
 }
 void LuaBackend::post_load_screen()
@@ -1113,17 +1314,14 @@ void LuaBackend::post_load_screen()
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_LOAD_SCREEN))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_LOAD_SCREEN)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func);
+        callback.lastRan = now;
     }
 }
 void LuaBackend::post_unload_layer(LAYER layer)
@@ -1133,17 +1331,14 @@ void LuaBackend::post_unload_layer(LAYER layer)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_LAYER_DESTRUCTION))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_LAYER_DESTRUCTION)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, layer);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, layer);
+        callback.lastRan = now;
     }
 }
 
@@ -1154,17 +1349,14 @@ void LuaBackend::on_death_message(STRINGID stringid)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::DEATH_MESSAGE))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::DEATH_MESSAGE)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, stringid);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, stringid);
+        callback.lastRan = now;
     }
 }
 
@@ -1175,49 +1367,41 @@ std::string LuaBackend::pre_get_random_room(int x, int y, uint8_t layer, uint16_
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_GET_RANDOM_ROOM))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_GET_RANDOM_ROOM)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        std::string return_value = handle_function<std::string>(this, callback.func, x, y, layer, room_template).value_or(std::string{});
+        if (!return_value.empty())
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            std::string return_value = handle_function<std::string>(this, callback.func, x, y, layer, room_template).value_or(std::string{});
-            if (!return_value.empty())
-            {
-                return return_value;
-            }
+            return return_value;
         }
     }
     return std::string{};
 }
-LuaBackend::PreHandleRoomTilesResult LuaBackend::pre_handle_room_tiles(LevelGenRoomData room_data, int x, int y, uint16_t room_template)
+bool LuaBackend::pre_handle_room_tiles(PreHandleRoomTilesContext& ctx, int x, int y, uint16_t room_template)
 {
     if (!get_enabled())
-        return {false, std::nullopt};
+        return false;
 
     auto now = HeapBase::get().frame_count();
 
-    PreHandleRoomTilesContext ctx{room_data};
-
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_HANDLE_ROOM_TILES))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_HANDLE_ROOM_TILES)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (handle_function<bool>(this, callback.func, x, y, room_template, ctx).value_or(false))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (handle_function<bool>(this, callback.func, x, y, room_template, ctx).value_or(false))
-            {
-                return {true, ctx.modded_room_data};
-            }
+            return true;
         }
     }
-    return {false, ctx.modded_room_data};
+    return false;
 }
 
 Entity* LuaBackend::pre_entity_spawn(std::uint32_t entity_type, float x, float y, int layer, Entity* overlay, int spawn_type_flags)
@@ -1225,77 +1409,240 @@ Entity* LuaBackend::pre_entity_spawn(std::uint32_t entity_type, float x, float y
     if (!get_enabled())
         return nullptr;
 
-    for (auto& callback : pre_entity_spawn_callbacks)
-    {
-        if (is_callback_cleared(callback.id))
-            continue;
-
-        bool mask_match = callback.entity_mask == ENTITY_MASK::ANY || !!(get_type(entity_type)->search_flags & callback.entity_mask);
-        bool flags_match = callback.spawn_type_flags & spawn_type_flags;
-        if (mask_match && flags_match)
+    Entity* spawned_ent{nullptr};
+    pre_entity_spawn_index.for_each_candidate(
+        entity_type,
+        [&](size_t index)
         {
-            bool type_match = callback.entity_types.empty() || std::count(callback.entity_types.begin(), callback.entity_types.end(), entity_type) > 0;
-            if (type_match)
+            auto& callback = pre_entity_spawn_callbacks[index];
+            if (is_callback_cleared(callback.id))
+                return true;
+
+            bool mask_match = callback.entity_mask == ENTITY_MASK::ANY || !!(get_type(entity_type)->search_flags & callback.entity_mask);
+            bool flags_match = callback.spawn_type_flags & spawn_type_flags;
+            if (mask_match && flags_match)
             {
                 auto _scope = set_current_callback(-1, callback.id, CallbackType::Normal);
                 if (auto spawn_replacement = handle_function<std::uint32_t>(this, callback.func, entity_type, x, y, layer, overlay, spawn_type_flags))
                 {
-                    return get_entity_ptr(spawn_replacement.value()); // TODO: this assumes that the entity is valid, which will crash if it's not
+                    spawned_ent = get_entity_ptr(spawn_replacement.value()); // TODO: this assumes that the entity is valid, which will crash if it's not
+                    return false;
                 }
             }
-        }
-    }
-    return nullptr;
+            return true;
+        });
+    return spawned_ent;
 }
 void LuaBackend::post_entity_spawn(Entity* entity, int spawn_type_flags)
 {
     if (!get_enabled())
         return;
 
-    for (auto& callback : post_entity_spawn_callbacks)
-    {
-        if (is_callback_cleared(callback.id))
-            continue;
-
-        bool mask_match = callback.entity_mask == ENTITY_MASK::ANY || !!(entity->type->search_flags & callback.entity_mask);
-        bool flags_match = callback.spawn_type_flags & spawn_type_flags;
-        if (mask_match && flags_match)
+    post_entity_spawn_index.for_each_candidate(
+        entity->type->id,
+        [&](size_t index)
         {
-            bool type_match = callback.entity_types.empty() || std::count(callback.entity_types.begin(), callback.entity_types.end(), entity->type->id) > 0;
-            if (type_match)
+            auto& callback = post_entity_spawn_callbacks[index];
+            if (is_callback_cleared(callback.id))
+                return true;
+
+            bool mask_match = callback.entity_mask == ENTITY_MASK::ANY || !!(entity->type->search_flags & callback.entity_mask);
+            bool flags_match = callback.spawn_type_flags & spawn_type_flags;
+            if (mask_match && flags_match)
             {
                 auto _scope = set_current_callback(-1, callback.id, CallbackType::Normal);
                 handle_function<void>(this, callback.func, entity, spawn_type_flags);
             }
-        }
-    }
+            return true;
+        });
 }
 
-bool LuaBackend::pre_entity_instagib(Entity* victim)
+void ScreenCallbackStorage::add(int id, ScreenCallback callback)
 {
-    bool skip{false};
-    if (!get_enabled())
-        return skip;
+    const size_t index = static_cast<size_t>(callback.screen);
+    auto [it, inserted] = callbacks.emplace(id, std::move(callback));
+    // Values that aren't an event never run, they're only kept so clear_callback finds them
+    if (!inserted || index >= by_screen.size())
+        return;
+    // Ids only grow, so appending keeps the lists in registration order, and the map nodes don't move on rehash
+    by_screen[index].push_back(&*it);
+}
+void ScreenCallbackStorage::erase(int id)
+{
+    auto it = callbacks.find(id);
+    if (it == callbacks.end())
+        return;
+    const size_t index = static_cast<size_t>(it->second.screen);
+    if (index < by_screen.size())
+        std::erase(by_screen[index], &*it);
+    callbacks.erase(it);
+}
+void ScreenCallbackStorage::clear()
+{
+    callbacks.clear();
+    for (auto& list : by_screen)
+        list.clear();
+}
 
-    for (auto& callback : pre_entity_instagib_callbacks)
+void EntitySpawnCallbackIndex::add(const EntitySpawnCallback& callback, size_t index)
+{
+    if (callback.entity_types.empty())
     {
-        if (is_callback_cleared(callback.id))
-            continue;
-
-        if (callback.uid == victim->uid)
-        {
-            auto _scope = set_current_callback(-1, callback.id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func, victim).value_or(false);
-        }
+        any_type.push_back(index);
+        return;
+    }
+    for (uint32_t entity_type : callback.entity_types)
+    {
+        std::vector<size_t>& indices = by_type[entity_type];
+        if (indices.empty() || indices.back() != index)
+            indices.push_back(index);
     }
-
-    return skip;
 }
-
-bool LuaBackend::process_vanilla_render_callbacks(ON event)
+void EntitySpawnCallbackIndex::rebuild(const std::vector<EntitySpawnCallback>& callbacks)
 {
-    bool skip{false};
-    if (!get_enabled())
+    clear();
+    for (size_t i = 0; i < callbacks.size(); ++i)
+    {
+        add(callbacks[i], i);
+    }
+}
+void EntitySpawnCallbackIndex::clear()
+{
+    by_type.clear();
+    any_type.clear();
+}
+
+void TileCodeCallbackIndex::add(const LevelGenCallback& callback, size_t index)
+{
+    if (auto tile_code_id = find_tile_code_id(callback.tile_code))
+    {
+        if (*tile_code_id >= by_id.size())
+            by_id.resize(*tile_code_id + 1);
+        by_id[*tile_code_id].push_back(index);
+    }
+    else
+    {
+        unresolved.push_back(index);
+    }
+}
+void TileCodeCallbackIndex::rebuild(const std::vector<LevelGenCallback>& callbacks)
+{
+    clear();
+    tile_code_generation = get_tile_code_generation();
+    for (size_t i = 0; i < callbacks.size(); ++i)
+    {
+        add(callbacks[i], i);
+    }
+}
+void TileCodeCallbackIndex::clear()
+{
+    by_id.clear();
+    unresolved.clear();
+}
+void TileCodeCallbackIndex::refresh(const std::vector<LevelGenCallback>& callbacks)
+{
+    if (!unresolved.empty() && tile_code_generation != get_tile_code_generation())
+        rebuild(callbacks);
+}
+
+bool LuaBackend::has_callbacks(BackendEvent event) const
+{
+    switch (event)
+    {
+    case BackendEvent::PRE_TILE_CODE:
+        return !pre_tile_code_callbacks.empty();
+    case BackendEvent::POST_TILE_CODE:
+        return !post_tile_code_callbacks.empty();
+    case BackendEvent::PRE_ENTITY_SPAWN:
+        return !pre_entity_spawn_callbacks.empty();
+    case BackendEvent::POST_ENTITY_SPAWN:
+        return !post_entity_spawn_callbacks.empty();
+    case BackendEvent::PRE_ENTITY_INSTAGIB:
+        return !pre_entity_instagib_callbacks.empty();
+    case BackendEvent::RENDER_PRE_DRAW_DEPTH:
+        return get_draw_depth_interest(ON::RENDER_PRE_DRAW_DEPTH) != 0;
+    case BackendEvent::RENDER_POST_DRAW_DEPTH:
+        return get_draw_depth_interest(ON::RENDER_POST_DRAW_DEPTH) != 0;
+    case BackendEvent::PRE_GET_FEAT:
+        return has_callbacks(ON::PRE_GET_FEAT);
+    case BackendEvent::PRE_SET_FEAT:
+        return has_callbacks(ON::PRE_SET_FEAT);
+    case BackendEvent::SPEECH_BUBBLE:
+        return has_callbacks(ON::SPEECH_BUBBLE);
+    case BackendEvent::TOAST:
+        return has_callbacks(ON::TOAST);
+    case BackendEvent::IDLE:
+        return has_callbacks(ON::IDLE);
+    default:
+        return true;
+    }
+}
+bool LuaBackend::has_callbacks(ON event) const
+{
+    return !callbacks.of(event).empty();
+}
+uint64_t LuaBackend::get_draw_depth_interest(ON event) const
+{
+    uint64_t interest{0};
+    for (auto& [id, callback] : callbacks.of(event))
+        interest |= callback.draw_depths;
+    return interest;
+}
+
+bool LuaBackend::pre_entity_instagib(Entity* victim)
+{
+    bool skip{false};
+    if (!get_enabled())
+        return skip;
+
+    for (auto& callback : pre_entity_instagib_callbacks)
+    {
+        if (is_callback_cleared(callback.id))
+            continue;
+
+        if (callback.uid == victim->uid)
+        {
+            auto _scope = set_current_callback(-1, callback.id, CallbackType::Normal);
+            skip |= handle_function<bool>(this, callback.func, victim).value_or(false);
+        }
+    }
+
+    return skip;
+}
+
+void LuaBackend::check_field_watchers()
+{
+    // Indexed, a callback may add watchers
+    for (size_t i = 0; i < field_watch_callbacks.size(); ++i)
+    {
+        FieldWatchCallback& callback = field_watch_callbacks[i];
+        if (is_callback_cleared(callback.id))
+            continue;
+
+        Entity* entity = get_entity_ptr(callback.uid);
+        if (entity != callback.entity)
+        {
+            clear_callbacks.insert(callback.id);
+            continue;
+        }
+        const double value = read_entity_field(entity, *callback.field);
+        // NaN never compares equal, a float field that stays NaN would call the watcher every frame
+        if (value == callback.value || (std::isnan(value) && std::isnan(callback.value)))
+            continue;
+
+        const double old_value = callback.value;
+        callback.value = value;
+        const int id = callback.id;
+        sol::function func = callback.func;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, func, entity, value, old_value);
+    }
+}
+
+bool LuaBackend::process_vanilla_render_callbacks(ON event)
+{
+    bool skip{false};
+    if (!get_enabled())
         return skip;
 
     // used in infinite loop detection to see if game is hanging because a script is hanging
@@ -1303,17 +1650,14 @@ bool LuaBackend::process_vanilla_render_callbacks(ON event)
 
     auto now = HeapBase::get().frame_count();
     VanillaRenderContext render_ctx;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func, render_ctx).value_or(false);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        skip |= handle_function<bool>(this, callback.func, render_ctx).value_or(false);
+        callback.lastRan = now;
     }
 
     return skip;
@@ -1327,17 +1671,14 @@ bool LuaBackend::process_vanilla_render_blur_callbacks(ON event, float blur_amou
 
     auto now = HeapBase::get().frame_count();
     VanillaRenderContext render_ctx;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func, render_ctx, blur_amount).value_or(false);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        skip |= handle_function<bool>(this, callback.func, render_ctx, blur_amount).value_or(false);
+        callback.lastRan = now;
     }
 
     return skip;
@@ -1351,17 +1692,14 @@ bool LuaBackend::process_vanilla_render_hud_callbacks(ON event, Hud* hud)
 
     auto now = HeapBase::get().frame_count();
     VanillaRenderContext render_ctx;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func, render_ctx, hud).value_or(false);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        skip |= handle_function<bool>(this, callback.func, render_ctx, hud).value_or(false);
+        callback.lastRan = now;
     }
 
     return skip;
@@ -1370,25 +1708,54 @@ bool LuaBackend::process_vanilla_render_hud_callbacks(ON event, Hud* hud)
 bool LuaBackend::process_vanilla_render_layer_callbacks(ON event, uint8_t layer)
 {
     bool skip{false};
+    if (event == ON::RENDER_POST_LAYER)
+    {
+        process_render_batch_callbacks(layer);
+    }
+    else if (event == ON::RENDER_PRE_LAYER)
+    {
+        for (auto& [id, batch] : render_batch_callbacks)
+            batch.rendered->clear();
+    }
     if (!get_enabled())
         return skip;
 
     auto now = HeapBase::get().frame_count();
     VanillaRenderContext render_ctx;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        skip |= handle_function<bool>(this, callback.func, render_ctx, layer).value_or(false);
+        callback.lastRan = now;
+    }
+
+    return skip;
+}
+
+void LuaBackend::process_render_batch_callbacks(uint8_t layer)
+{
+    const bool enabled = get_enabled();
+    std::vector<RenderInfo*> render_infos;
+    for (auto& [id, batch] : render_batch_callbacks)
+    {
+        if (batch.rendered->empty())
+            continue;
+        if (enabled && !is_callback_cleared(id))
         {
+            render_infos.clear();
+            for (uint32_t uid : *batch.rendered)
+            {
+                if (Entity* entity = get_entity_ptr(uid))
+                    render_infos.push_back(entity->rendering_info);
+            }
             auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func, render_ctx, layer).value_or(false);
-            callback.lastRan = now;
+            handle_function<void>(this, batch.func, VanillaRenderContext{}, render_infos, layer);
         }
+        batch.rendered->clear();
     }
-
-    return skip;
 }
 
 bool LuaBackend::process_vanilla_render_draw_depth_callbacks(ON event, uint8_t draw_depth, const AABB& bbox)
@@ -1400,12 +1767,12 @@ bool LuaBackend::process_vanilla_render_draw_depth_callbacks(ON event, uint8_t d
     auto now = HeapBase::get().frame_count();
     VanillaRenderContext render_ctx;
     render_ctx.bounding_box = bbox;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
+        if (draw_depth >= 64 || (callback.draw_depths & (1ull << draw_depth)) != 0)
         {
             auto _scope = set_current_callback(-1, id, CallbackType::Normal);
             skip |= handle_function<bool>(this, callback.func, render_ctx, draw_depth).value_or(false);
@@ -1424,80 +1791,91 @@ bool LuaBackend::process_vanilla_render_journal_page_callbacks(ON event, Journal
 
     auto now = HeapBase::get().frame_count();
     VanillaRenderContext render_ctx;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func, render_ctx, page_type, page).value_or(false);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        skip |= handle_function<bool>(this, callback.func, render_ctx, page_type, page).value_or(false);
+        callback.lastRan = now;
     }
 
     return skip;
 }
 
-std::u16string LuaBackend::pre_speach_bubble(Entity* entity, char16_t* buffer)
+std::optional<std::u16string> LuaBackend::pre_speach_bubble(Entity* entity, std::u16string_view text)
 {
     if (!get_enabled())
-        return std::u16string{no_return_str};
+        return std::nullopt;
 
     auto now = HeapBase::get().frame_count();
 
     std::optional<std::u16string> return_value = std::nullopt;
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::SPEECH_BUBBLE))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::SPEECH_BUBBLE)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (auto speech_value = handle_function<std::u16string>(this, callback.func, entity, text.data()))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (auto speech_value = handle_function<std::u16string>(this, callback.func, entity, buffer))
+            if (!return_value)
             {
-                if (!return_value)
-                {
-                    return_value = speech_value;
-                }
+                return_value = std::move(speech_value);
             }
         }
     }
-    return return_value.value_or(std::u16string{no_return_str});
+    return return_value;
 }
 
-std::u16string LuaBackend::pre_toast(char16_t* buffer)
+std::optional<std::u16string> LuaBackend::pre_toast(std::u16string_view text)
 {
     if (!get_enabled())
-        return std::u16string{no_return_str};
+        return std::nullopt;
 
     auto now = HeapBase::get().frame_count();
 
     std::optional<std::u16string> return_value = std::nullopt;
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::TOAST))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::TOAST)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (auto toast_value = handle_function<std::u16string>(this, callback.func, text.data()))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (auto toast_value = handle_function<std::u16string>(this, callback.func, buffer))
+            if (!return_value)
             {
-                if (!return_value)
-                {
-                    return_value = toast_value;
-                }
+                return_value = std::move(toast_value);
             }
         }
     }
-    return return_value.value_or(std::u16string{no_return_str});
+    return return_value;
+}
+
+void LuaBackend::process_idle_callbacks(int64_t deadline)
+{
+    if (!get_enabled())
+        return;
+
+    auto now = HeapBase::get().frame_count();
+    for (auto& [id, callback] : callbacks.of(ON::IDLE))
+    {
+        if (is_callback_cleared(id))
+            continue;
+
+        const int64_t remaining = deadline - FrameTelemetry::now();
+        if (remaining <= 0)
+            break;
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, FrameTelemetry::ticks_to_ms(remaining) * 1000.0f);
+    }
 }
 
 bool LuaBackend::pre_load_journal_chapter(uint8_t chapter)
@@ -1506,21 +1884,18 @@ bool LuaBackend::pre_load_journal_chapter(uint8_t chapter)
         return false;
 
     auto now = HeapBase::get().frame_count();
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LOAD_JOURNAL_CHAPTER))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LOAD_JOURNAL_CHAPTER)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (auto return_value = handle_function<bool>(this, callback.func, chapter))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (auto return_value = handle_function<bool>(this, callback.func, chapter))
+            if (return_value.value())
             {
-                if (return_value.value())
-                {
-                    return true;
-                }
+                return true;
             }
         }
     }
@@ -1534,27 +1909,24 @@ std::vector<uint32_t> LuaBackend::post_load_journal_chapter(uint8_t chapter, con
 
     auto now = HeapBase::get().frame_count();
     std::vector<uint32_t> new_pages;
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_LOAD_JOURNAL_CHAPTER))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_LOAD_JOURNAL_CHAPTER)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (auto returned_pages = handle_function<sol::object>(this, callback.func, chapter, sol::as_table(pages)).value_or<sol::object>({}))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (auto returned_pages = handle_function<sol::object>(this, callback.func, chapter, sol::as_table(pages)).value_or<sol::object>({}))
+            if (returned_pages.get_type() == sol::type::table || returned_pages.get_type() == sol::type::userdata)
             {
-                if (returned_pages.get_type() == sol::type::table || returned_pages.get_type() == sol::type::userdata)
+                new_pages.clear();
+                const auto table = returned_pages.as<sol::table>();
+                for (auto& something : table)
                 {
-                    new_pages.clear();
-                    const auto table = returned_pages.as<sol::table>();
-                    for (auto& something : table)
+                    if (something.second.get_type() == sol::type::number)
                     {
-                        if (something.second.get_type() == sol::type::number)
-                        {
-                            new_pages.push_back(static_cast<uint32_t>(something.second.as<double>()));
-                        }
+                        new_pages.push_back(static_cast<uint32_t>(something.second.as<double>()));
                     }
                 }
             }
@@ -1569,21 +1941,18 @@ std::optional<bool> LuaBackend::pre_get_feat(FEAT feat)
         return std::nullopt;
 
     auto now = HeapBase::get().frame_count();
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_GET_FEAT))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_GET_FEAT)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (auto return_value = handle_function<bool>(this, callback.func, feat))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (auto return_value = handle_function<bool>(this, callback.func, feat))
+            if (return_value.has_value())
             {
-                if (return_value.has_value())
-                {
-                    return return_value.value();
-                }
+                return return_value.value();
             }
         }
     }
@@ -1596,21 +1965,18 @@ bool LuaBackend::pre_set_feat(FEAT feat)
         return false;
 
     auto now = HeapBase::get().frame_count();
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_SET_FEAT))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_SET_FEAT)
+        callback.lastRan = now;
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        if (auto return_value = handle_function<bool>(this, callback.func, feat))
         {
-            callback.lastRan = now;
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            if (auto return_value = handle_function<bool>(this, callback.func, feat))
+            if (return_value.has_value() && return_value.value())
             {
-                if (return_value.has_value() && return_value.value())
-                {
-                    return return_value.value();
-                }
+                return return_value.value();
             }
         }
     }
@@ -1623,22 +1989,190 @@ void LuaBackend::set_error(std::string err)
 
 #ifdef SPEL2_EXTRA_ANNOYING_SCRIPT_ERRORS
     std::istringstream errors{result};
-    const auto now{std::chrono::system_clock::now()};
     while (!errors.eof())
     {
         std::string err_line;
         getline(errors, err_line);
-        messages.push_back({err_line, now, ImVec4(1.0f, 0.2f, 0.2f, 1.0f)});
-        if (messages.size() > 30)
-        {
-            messages.pop_front();
-        }
+        messages.push(err_line, ImVec4(1.0f, 0.2f, 0.2f, 1.0f));
         std::replace(err_line.begin(), err_line.end(), '\r', ' ');
         DEBUG("[{}] {}", get_name(), err_line);
     }
 #endif
 }
 
+void LuaBackend::run_finished_saves()
+{
+    if (async_save_callbacks.empty())
+        return;
+
+    std::vector<std::pair<sol::function, bool>> finished;
+    std::erase_if(async_save_callbacks, [&finished](AsyncSaveCallback& save)
+                  {
+                      if (save.done.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+                          return false;
+                      const bool success = save.done.get();
+                      if (save.func)
+                          finished.emplace_back(std::move(save.func), success);
+                      return true; });
+    for (auto& [func, success] : finished)
+    {
+        handle_function<void>(this, func, success);
+    }
+}
+
+void LuaBackend::run_finished_jobs()
+{
+    if (job_callbacks.empty())
+        return;
+
+    std::vector<std::pair<sol::function, LuaJobResult>> finished;
+    std::erase_if(job_callbacks, [&finished](ScriptJobCallback& job)
+                  {
+                      if (job.done.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+                          return false;
+                      LuaJobResult result = job.done.get();
+                      if (job.func)
+                          finished.emplace_back(std::move(job.func), std::move(result));
+                      return true; });
+    lua_State* L = lua.lua_state();
+    for (auto& [func, result] : finished)
+    {
+        if (!result.success)
+        {
+            handle_function<void>(this, func, sol::lua_nil, result.data);
+            continue;
+        }
+        sol::object value;
+        try
+        {
+            unpack_lua_value(L, result.data);
+            value = sol::stack::pop<sol::object>(L);
+        }
+        catch (const std::runtime_error& err)
+        {
+            handle_function<void>(this, func, sol::lua_nil, std::string{err.what()});
+            continue;
+        }
+        handle_function<void>(this, func, value, sol::lua_nil);
+    }
+}
+
+void LuaBackend::run_finished_preloads()
+{
+    if (asset_preload_callbacks.empty())
+        return;
+
+    // Moved out first, the callbacks may queue more preloads
+    std::vector<sol::function> finished;
+    std::erase_if(asset_preload_callbacks, [&finished](AssetPreloadCallback& preload)
+                  {
+                      if (preload.done.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+                          return false;
+                      if (preload.func)
+                          finished.push_back(std::move(preload.func));
+                      return true; });
+    for (sol::function& func : finished)
+    {
+        handle_function<void>(this, func);
+    }
+}
+
+void LuaBackend::run_due_timers(TimerStorage& timers, int now)
+{
+    for (int id : timers.pop_due(now))
+    {
+        auto it = timers.timers.find(id);
+        if (it == timers.timers.end() || is_callback_cleared(id))
+            continue;
+
+        // Copy the function, the callback may add timers and invalidate `it`
+        if (auto cb = std::get_if<IntervalCallback>(&it->second))
+        {
+            sol::function func = cb->func;
+            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+            std::optional<bool> keep_going = handle_function<bool>(this, func);
+
+            it = timers.timers.find(id);
+            if (it == timers.timers.end())
+                continue;
+
+            cb = std::get_if<IntervalCallback>(&it->second);
+            cb->lastRan = now;
+            if (!keep_going.value_or(true))
+                timers.erase(id);
+            else
+                timers.schedule(id, now + std::max(cb->interval, 1));
+        }
+        else if (auto cbt = std::get_if<TimeoutCallback>(&it->second))
+        {
+            sol::function func = cbt->func;
+            timers.erase(id);
+            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+            handle_function<void>(this, func);
+        }
+    }
+}
+
+void LuaBackend::run_scheduled_coroutines()
+{
+    CoroutineScheduler& scheduler = scheduled_coroutines;
+    if (scheduler.coroutines.empty())
+        return;
+
+    const int64_t start = CallbackProfiler::now();
+    const double budget_ms = static_cast<double>(scheduler.budget_us) / 1000.0;
+
+    // Every coroutine is resumed at most once per frame, even if there is budget left
+    for (size_t remaining = scheduler.coroutines.size(); remaining > 0 && !scheduler.coroutines.empty(); --remaining)
+    {
+        if (CallbackProfiler::ticks_to_ms(CallbackProfiler::now() - start) >= budget_ms)
+            break;
+
+        const size_t index = scheduler.next % scheduler.coroutines.size();
+        const int id = scheduler.coroutines[index].id;
+        if (is_callback_cleared(id))
+        {
+            scheduler.next = index + 1;
+            continue;
+        }
+
+        // Copy the coroutine, it may schedule more of them and move the vector
+        sol::coroutine coroutine = scheduler.coroutines[index].coroutine;
+        sol::protected_function_result result;
+        {
+            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+            push_calling_backend(this);
+            ON_SCOPE_EXIT(pop_calling_backend(this));
+            // Made from the thread of the backend, which should have given it the hook already
+            install_lua_hook(coroutine.lua_state());
+
+            const bool profile = CallbackProfiler::enabled;
+            const int64_t resume_start = profile ? CallbackProfiler::now() : 0;
+            result = coroutine();
+            if (profile)
+                profiler.record(-1, id, CallbackType::Normal, CallbackProfiler::now() - resume_start);
+        }
+
+        if (!result.valid())
+        {
+            sol::error e = result;
+            set_error(e.what());
+            scheduler.erase(id);
+        }
+        else if (result.status() != sol::call_status::yielded)
+        {
+            scheduler.erase(id);
+        }
+        else
+        {
+            scheduler.next = index + 1;
+        }
+    }
+
+    if (CallbackProfiler::ticks_to_ms(CallbackProfiler::now() - start) > budget_ms)
+        scheduler.overruns++;
+}
+
 /**
  * static functions begin
  */
@@ -1653,6 +2187,115 @@ void LuaBackend::for_each_backend(std::function<bool(LockedBackend)> fun, bool s
         }
     }
 }
+void rebuild_event_subscribers()
+{
+    for (auto& subscribers : g_event_subscribers)
+    {
+        subscribers.clear();
+    }
+    g_draw_depth_interest.fill(0);
+    for (std::unique_ptr<LuaBackend::ProtectedBackend>& backend : g_all_backends)
+    {
+        LuaBackend::LockedBackend locked = backend->Lock();
+        for (size_t i = 0; i < g_event_subscribers.size(); ++i)
+        {
+            if (locked->has_callbacks((BackendEvent)i))
+                g_event_subscribers[i].push_back(backend.get());
+        }
+        g_draw_depth_interest[0] |= locked->get_draw_depth_interest(ON::RENDER_PRE_DRAW_DEPTH);
+        g_draw_depth_interest[1] |= locked->get_draw_depth_interest(ON::RENDER_POST_DRAW_DEPTH);
+    }
+    g_event_subscribers_dirty = false;
+}
+void LuaBackend::for_each_subscriber(BackendEvent event, std::function<bool(LockedBackend)> fun, bool stop_propagation)
+{
+    std::lock_guard lock{global_lua_lock};
+    if (g_event_subscribers_dirty)
+    {
+        // A nested dispatch can't rebuild the lists while an outer one is still iterating them
+        if (g_event_dispatch_depth > 0)
+        {
+            for_each_backend(
+                [&](LockedBackend backend)
+                { return !backend->has_callbacks(event) || fun(std::move(backend)) || !stop_propagation; });
+            return;
+        }
+        rebuild_event_subscribers();
+    }
+
+    ++g_event_dispatch_depth;
+    ON_SCOPE_EXIT(--g_event_dispatch_depth);
+    for (ProtectedBackend* backend : g_event_subscribers[(size_t)event])
+    {
+        if (!fun(backend->Lock()) && stop_propagation)
+        {
+            break;
+        }
+    }
+}
+std::vector<LuaBackend::LockedBackend> LuaBackend::lock_subscribers(BackendEvent event)
+{
+    std::lock_guard lock{global_lua_lock};
+    std::vector<LockedBackend> locked;
+    if (g_event_subscribers_dirty && g_event_dispatch_depth > 0)
+    {
+        locked.reserve(g_all_backends.size());
+        for (std::unique_ptr<ProtectedBackend>& backend : g_all_backends)
+        {
+            LockedBackend locked_backend = backend->Lock();
+            if (locked_backend->has_callbacks(event))
+                locked.push_back(std::move(locked_backend));
+        }
+        return locked;
+    }
+
+    if (g_event_subscribers_dirty)
+        rebuild_event_subscribers();
+
+    locked.reserve(g_event_subscribers[(size_t)event].size());
+    for (ProtectedBackend* backend : g_event_subscribers[(size_t)event])
+    {
+        locked.push_back(backend->Lock());
+    }
+    return locked;
+}
+std::uint32_t LuaBackend::get_subscribers_generation()
+{
+    return g_event_subscribers_generation;
+}
+void LuaBackend::invalidate_subscribers()
+{
+    std::lock_guard lock{global_lua_lock};
+    g_event_subscribers_dirty = true;
+    g_event_subscribers_generation++;
+    attach_demand_hooks();
+}
+bool LuaBackend::has_subscribers(BackendEvent event)
+{
+    std::lock_guard lock{global_lua_lock};
+    if (g_event_subscribers_dirty)
+    {
+        if (g_event_dispatch_depth > 0)
+        {
+            return std::any_of(g_all_backends.begin(), g_all_backends.end(), [event](std::unique_ptr<ProtectedBackend>& backend)
+                               { return backend->Lock()->has_callbacks(event); });
+        }
+        rebuild_event_subscribers();
+    }
+    return !g_event_subscribers[(size_t)event].empty();
+}
+bool LuaBackend::has_draw_depth_subscribers(ON event, uint8_t draw_depth)
+{
+    std::lock_guard lock{global_lua_lock};
+    if (g_event_subscribers_dirty)
+    {
+        if (g_event_dispatch_depth > 0)
+            return true;
+        rebuild_event_subscribers();
+    }
+    const uint64_t interest = g_draw_depth_interest[event == ON::RENDER_PRE_DRAW_DEPTH ? 0 : 1];
+    return draw_depth >= 64 || (interest & (1ull << draw_depth)) != 0;
+}
 LuaBackend::LockedBackend LuaBackend::get_backend(std::string_view id)
 {
     return get_backend_safe(id).value();
@@ -1698,6 +2341,10 @@ std::optional<LuaBackend::LockedBackend> LuaBackend::get_backend_by_id_safe(std:
 //      if we were not using a stack here the error
 //      would propagate to script0 instead of script1
 std::stack<LuaBackend*, std::vector<LuaBackend*>> g_CallingBackend{};
+// Game heap tag from before each calling backend was pushed, put back when it's popped
+std::stack<const char*, std::vector<const char*>> g_PreviousHeapTags{};
+// Same for the Lua memory account
+std::stack<LuaMemoryAccount*, std::vector<LuaMemoryAccount*>> g_PreviousMemoryAccounts{};
 LuaBackend::LockedBackend LuaBackend::get_calling_backend()
 {
     return LuaBackend::get_backend(get_calling_backend_id());
@@ -1733,11 +2380,23 @@ void LuaBackend::push_calling_backend(LuaBackend* calling_backend)
 {
     std::lock_guard global_lock{global_lua_lock};
     g_CallingBackend.push(calling_backend);
+    g_PreviousMemoryAccounts.push(get_current_lua_memory_account());
+    set_current_lua_memory_account(&calling_backend->get_memory_account());
+    g_PreviousHeapTags.push(GameHeapTag::current());
+    if (GameHeapStats::get().is_enabled())
+        GameHeapTag::set_current(GameHeapTag::intern(calling_backend->get_id()));
+    LuaWatchdog::get().enter();
 }
 void LuaBackend::pop_calling_backend([[maybe_unused]] LuaBackend* calling_backend)
 {
     std::lock_guard global_lock{global_lua_lock};
     g_CallingBackend.pop();
+    // Not the account of the backend below, a LuaMemoryScope may have set another one in between
+    set_current_lua_memory_account(g_PreviousMemoryAccounts.top());
+    g_PreviousMemoryAccounts.pop();
+    GameHeapTag::set_current(g_PreviousHeapTags.top());
+    g_PreviousHeapTags.pop();
+    LuaWatchdog::get().leave();
 }
 
 /**
@@ -1750,17 +2409,14 @@ void LuaBackend::on_set_user_data(Entity* ent)
         return;
 
     auto now = HeapBase::get().frame_count();
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::USER_DATA))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::USER_DATA)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, ent);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, ent);
+        callback.lastRan = now;
     }
 }
 
@@ -1771,17 +2427,14 @@ bool LuaBackend::on_pre(ON event)
         return skip;
 
     auto now = HeapBase::get().frame_count();
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            skip |= handle_function<bool>(this, callback.func).value_or(false);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        skip |= handle_function<bool>(this, callback.func).value_or(false);
+        callback.lastRan = now;
     }
 
     return skip;
@@ -1791,61 +2444,78 @@ void LuaBackend::on_post(ON event)
 {
     if (!get_enabled())
         return;
+    if (event == ON::POST_UPDATE)
+        check_field_watchers();
 
     auto now = HeapBase::get().frame_count();
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(event))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == event)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func);
+        callback.lastRan = now;
     }
 }
 
-sol::table deepcopy_lua_table(sol::state& sol_state, sol::table& from_r)
+// Pushes a copy of the table on top of the stack, works on the raw stack so copying a big table doesn't create a registry reference per value
+void deepcopy_lua_table(lua_State* L)
 {
-    sol::table new_table(sol_state, sol::create);
-    for (auto& [k, v] : from_r.as<sol::table>())
+    luaL_checkstack(L, 6, "user_data is nested too deep to copy");
+
+    const int from = lua_gettop(L);
+    lua_createtable(L, static_cast<int>(lua_rawlen(L, from)), 0);
+    const int to = from + 1;
+
+    lua_pushnil(L);
+    while (lua_next(L, from) != 0)
     {
-        if (v.is<sol::table>())
-        {
-            sol::table v_table = v.as<sol::table>();
-            new_table.raw_set(k, deepcopy_lua_table(sol_state, v_table));
-        }
-        else
+        // Stack is now key, value
+        if (lua_type(L, -1) == LUA_TTABLE)
         {
-            new_table.raw_set(k, v);
+            deepcopy_lua_table(L);
+            lua_remove(L, -2);
         }
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, to);
     }
-    auto maybe_metatable = from_r.raw_get<sol::optional<sol::table>>(sol::metatable_key);
-    if (maybe_metatable)
+
+    // Metatables are shared with the original, same as before
+    if (lua_getmetatable(L, from))
     {
-        new_table.raw_set(sol::metatable_key, maybe_metatable.value());
+        lua_setmetatable(L, to);
     }
-    return new_table;
 }
 
 inline sol::object deepcopy_lua(sol::state& sol_state, sol::object& from)
 {
-    if (from.is<sol::table>())
-    {
-        auto from_t = from.as<sol::table>();
-        return deepcopy_lua_table(sol_state, from_t);
-    }
-    else
+    if (from.get_type() != sol::type::table)
     {
         return from;
     }
+
+    lua_State* L = sol_state.lua_state();
+    from.push(L);
+    deepcopy_lua_table(L);
+    sol::object copy(L, -1);
+    lua_pop(L, 2);
+    return copy;
+}
+
+inline bool is_same_lua_object(lua_State* L, const sol::object& lhs, const sol::object& rhs)
+{
+    lhs.push(L);
+    rhs.push(L);
+    const bool same = lua_rawequal(L, -1, -2) != 0;
+    lua_pop(L, 2);
+    return same;
 }
 
 void LuaBackend::copy_locals(StateMemory* from, StateMemory* to)
 {
-    if (!local_state_datas.contains(from))
+    if (from == to || !local_state_datas.contains(from))
         return;
 
     auto& to_data = local_state_datas[to];
@@ -1854,8 +2524,61 @@ void LuaBackend::copy_locals(StateMemory* from, StateMemory* to)
     sol::object from_user_data = from_data.user_data;
     if (from_user_data != sol::lua_nil)
     {
-        to_data.user_data = deepcopy_lua(*vm, from_user_data);
+        CopyStateStats& stats = get_copy_state_stats();
+        if (!from_data.dirty && from_user_data.get_type() == sol::type::table)
+        {
+            // Nothing got at the table since the last copy, rollback clones the same state over and over while the script isn't looking
+            to_data.user_data = std::move(from_user_data);
+            to_data.borrowed = true;
+            stats.shared_user_datas.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            to_data.user_data = deepcopy_lua(*vm, from_user_data);
+            to_data.borrowed = false;
+            stats.copied_user_datas.fetch_add(1, std::memory_order_relaxed);
+        }
+        // The source keeps its dirty flag, a table the script has seen could still be changed through a reference kept anywhere
+        to_data.dirty = false;
+    }
+}
+
+sol::object LuaBackend::get_state_user_data(StateMemory* state)
+{
+    auto it = local_state_datas.find(state);
+    if (it == local_state_datas.end())
+        return sol::lua_nil;
+
+    LocalStateData& data = it->second;
+    data.dirty = true;
+    if (data.user_data.get_type() != sol::type::table)
+        return data.user_data;
+
+    if (data.borrowed)
+    {
+        data.user_data = deepcopy_lua(*vm, data.user_data);
+        data.borrowed = false;
+        return data.user_data;
+    }
+    // The copies still sharing this table get its contents as they are before the script can change them
+    lua_State* L = vm->lua_state();
+    for (auto& [other_state, other_data] : local_state_datas)
+    {
+        if (other_data.borrowed && is_same_lua_object(L, other_data.user_data, data.user_data))
+        {
+            other_data.user_data = deepcopy_lua(*vm, other_data.user_data);
+            other_data.borrowed = false;
+        }
     }
+    return data.user_data;
+}
+void LuaBackend::set_state_user_data(StateMemory* state, sol::object user_data)
+{
+    // Copies that shared the old table keep it to themselves
+    LocalStateData& data = local_state_datas[state];
+    data.user_data = std::move(user_data);
+    data.dirty = true;
+    data.borrowed = false;
 }
 
 void LuaBackend::pre_copy_state(HeapBase from, HeapBase to)
@@ -1885,19 +2608,16 @@ bool LuaBackend::pre_save_state(int slot, StateMemory* saved)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_SAVE_STATE))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_SAVE_STATE)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func, slot, saved).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func, slot, saved).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
 
     return false;
@@ -1910,19 +2630,16 @@ bool LuaBackend::pre_load_state(int slot, StateMemory* loaded)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::PRE_LOAD_STATE))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::PRE_LOAD_STATE)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            auto return_value = handle_function<bool>(this, callback.func, slot, loaded).value_or(false);
-            callback.lastRan = now;
-            if (return_value)
-                return return_value;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        auto return_value = handle_function<bool>(this, callback.func, slot, loaded).value_or(false);
+        callback.lastRan = now;
+        if (return_value)
+            return return_value;
     }
 
     return false;
@@ -1935,38 +2652,35 @@ void LuaBackend::post_save_state(int slot, StateMemory* saved)
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_SAVE_STATE))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_SAVE_STATE)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, slot, saved);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, slot, saved);
+        callback.lastRan = now;
     }
 }
 
 void LuaBackend::post_load_state(int slot, StateMemory* loaded)
 {
+    // The loaded state reuses the entity memory, cached userdata may now point at different entities
+    entity_objects.entries.clear();
+
     if (!get_enabled())
         return;
 
     auto now = HeapBase::get().frame_count();
 
-    for (auto& [id, callback] : callbacks)
+    for (auto& [id, callback] : callbacks.of(ON::POST_LOAD_STATE))
     {
         if (is_callback_cleared(id))
             continue;
 
-        if (callback.screen == ON::POST_LOAD_STATE)
-        {
-            auto _scope = set_current_callback(-1, id, CallbackType::Normal);
-            handle_function<void>(this, callback.func, slot, loaded);
-            callback.lastRan = now;
-        }
+        auto _scope = set_current_callback(-1, id, CallbackType::Normal);
+        handle_function<void>(this, callback.func, slot, loaded);
+        callback.lastRan = now;
     }
 }
 
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <algorithm>     // for max
+#include <array>         // for array
 #include <chrono>        // for system_clock
 #include <cstdint>       // for uint32_t, uint16_t, uint8_t, int32_t
 #include <deque>         // for deque
 #include <filesystem>    // for path
 #include <functional>    // for equal_to, function, less
+#include <future>        // for future
 #include <imgui.h>       // for ImDrawList (ptr only), ImVec4
 #include <locale>        // for num_get, num_put
 #include <map>           // for map
@@ -26,11 +28,18 @@
 #include <vector>        // for vector
 
 #include "aliases.hpp"                      // for IMAGE, JournalPageType, SPAWN_TYPE
+#include "callback_profiler.hpp"            // for CallbackProfiler
 #include "heap_base.hpp"                    // for HeapBase
-#include "hook_handler.hpp"                 // for HookHandler
+#include "hook_handler.hpp"                 // for HookHandler, TypeHookHandler
 #include "level_api.hpp"                    // IWYU pragma: keep
 #include "logger.h"                         // for DEBUG
-#include "script.hpp"                       // for ScriptMessage, ScriptImage (ptr only), Scri...
+#include "lua_jobs.hpp"                     // for LuaJobResult
+#include "particles.hpp"                    // for ParticleEmitterPool
+#include "script.hpp"                       // for ScriptMessage, Scri...
+#include "script_message_ring.hpp"          // for ScriptMessageRing
+#include "sound_callback_queue.hpp"         // for SoundCallbackQueue
+#include "sound_voices.hpp"                 // for SoundVoices
+#include "user_data_storage.hpp"            // for UserDataStorage
 #include "usertypes/vanilla_render_lua.hpp" // for VanillaRenderContext, CORNER_FINISH
 #include "util.hpp"                         // for GlobalMutexProtectedResource, ON_SCOPE_EXIT
 
@@ -39,10 +48,14 @@ extern std::recursive_mutex global_lua_lock;
 class Player;
 class JournalPage;
 class Entity;
+class CachedImage;
+struct EntityField;
 struct LevelGenRoomData;
+struct PreHandleRoomTilesContext;
 struct AABB;
 struct HudData;
 struct Hud;
+struct ScriptState;
 
 enum class ON
 {
@@ -142,6 +155,7 @@ enum class ON
     BLOCKED_UPDATE,
     BLOCKED_GAME_LOOP,
     BLOCKED_PROCESS_INPUT,
+    IDLE,
     // PRE_COPY_STATE,
 };
 
@@ -198,11 +212,133 @@ struct TimeoutCallback
     int timeout;
 };
 
+// Limits how often an ON.GUIFRAME callback runs, the frames in between get what it drew on the background the last time it ran
+struct CallbackThrottle
+{
+    // 0 to not limit the rate
+    std::chrono::steady_clock::duration interval{};
+    // Only run again once the screen or time_level changed
+    bool on_change{false};
+
+    bool ran{false};
+    std::chrono::steady_clock::time_point last_run;
+    uint32_t screen{0};
+    uint32_t time_level{0};
+    std::unique_ptr<ImDrawList> output;
+
+    bool should_run(const ScriptState& state) const;
+    // Clears the output and records the state, the callback draws into the returned list
+    ImDrawList* begin_run(const ScriptState& state);
+};
+
 struct ScreenCallback
 {
     sol::function func;
     ON screen;
     int lastRan; // TODO should probably be uint32_t ?
+    // Bit per draw depth for ON.RENDER_PRE/POST_DRAW_DEPTH, all of them unless registered with a set of depths
+    uint64_t draw_depths{~0ull};
+    std::shared_ptr<CallbackThrottle> throttle;
+};
+
+// The ON callbacks by id, with a list per event in registration order so an event only goes over its own callbacks
+struct ScreenCallbackStorage
+{
+    using Map = std::unordered_map<int, ScreenCallback>;
+    using Entry = Map::value_type;
+
+    // Iterates the callbacks of one event as `auto& [id, callback]`, callbacks added while iterating run the next time
+    template <class EntryT>
+    struct Range
+    {
+        struct Sentinel
+        {
+        };
+        struct Iterator
+        {
+            const std::vector<Entry*>* list;
+            size_t index;
+            size_t count;
+
+            EntryT& operator*() const
+            {
+                return *(*list)[index];
+            }
+            Iterator& operator++()
+            {
+                ++index;
+                return *this;
+            }
+            // Checked against the list again, the callbacks may be cleared by a script reload while iterating
+            bool operator!=(Sentinel) const
+            {
+                return index < count && index < list->size();
+            }
+        };
+
+        const std::vector<Entry*>* list;
+
+        Iterator begin() const
+        {
+            return Iterator{list, 0, list->size()};
+        }
+        Sentinel end() const
+        {
+            return {};
+        }
+        bool empty() const
+        {
+            return list->empty();
+        }
+    };
+
+    // ON::IDLE is the last event, the lists are never reallocated so a Range stays valid while callbacks are added
+    static constexpr size_t SCREEN_COUNT = static_cast<size_t>(ON::IDLE) + 1;
+
+    Map callbacks;
+    // Indexed by the ON value, which are small enough to not bother with a map
+    std::array<std::vector<Entry*>, SCREEN_COUNT> by_screen;
+
+    void add(int id, ScreenCallback callback);
+    void erase(int id);
+    void clear();
+
+    Range<Entry> of(ON screen)
+    {
+        return Range<Entry>{&list_of(screen)};
+    }
+    Range<const Entry> of(ON screen) const
+    {
+        return Range<const Entry>{&list_of(screen)};
+    }
+    Map::iterator find(int id)
+    {
+        return callbacks.find(id);
+    }
+    Map::iterator begin()
+    {
+        return callbacks.begin();
+    }
+    Map::iterator end()
+    {
+        return callbacks.end();
+    }
+
+  private:
+    const std::vector<Entry*>& list_of(ON screen) const
+    {
+        static const std::vector<Entry*> no_callbacks;
+        const size_t index = static_cast<size_t>(screen);
+        return index < by_screen.size() ? by_screen[index] : no_callbacks;
+    }
+};
+
+// Called once after each layer is drawn with all the entities added to it with RenderInfo:add_to_render_batch that were rendered in the layer
+struct RenderBatchCallback
+{
+    sol::function func;
+    // Filled by the render hooks, which only hold a weak_ptr so they stop collecting once the callback is cleared
+    std::shared_ptr<std::vector<uint32_t>> rendered;
 };
 
 struct LevelGenCallback
@@ -221,6 +357,64 @@ struct EntitySpawnCallback
     sol::function func;
 };
 
+// Indices into a vector of EntitySpawnCallback, grouped by the types they filter on
+struct EntitySpawnCallbackIndex
+{
+    std::unordered_map<uint32_t, std::vector<size_t>> by_type;
+    std::vector<size_t> any_type;
+
+    void add(const EntitySpawnCallback& callback, size_t index);
+    void rebuild(const std::vector<EntitySpawnCallback>& callbacks);
+    void clear();
+
+    // Calls `fun(index)` in registration order for every callback that could match `entity_type`, stops when `fun` returns false
+    template <class FunT>
+    void for_each_candidate(uint32_t entity_type, FunT&& fun) const
+    {
+        static const std::vector<size_t> no_callbacks;
+        auto it = by_type.find(entity_type);
+        const std::vector<size_t>& typed = it != by_type.end() ? it->second : no_callbacks;
+
+        // Indexed loops since callbacks may register new callbacks, which appends to these lists
+        size_t i = 0;
+        size_t j = 0;
+        while (i < typed.size() || j < any_type.size())
+        {
+            const bool take_typed = j >= any_type.size() || (i < typed.size() && typed[i] < any_type[j]);
+            const size_t index = take_typed ? typed[i++] : any_type[j++];
+            if (!fun(index))
+                return;
+        }
+    }
+};
+
+// Indices into a vector of LevelGenCallback, grouped by the id of their tile code
+struct TileCodeCallbackIndex
+{
+    std::vector<std::vector<size_t>> by_id;
+    // Callbacks for tile codes that weren't defined when they were added, looked up again once new tile codes are defined
+    std::vector<size_t> unresolved;
+    std::uint32_t tile_code_generation{0};
+
+    void add(const LevelGenCallback& callback, size_t index);
+    void rebuild(const std::vector<LevelGenCallback>& callbacks);
+    void clear();
+    // Rebuilds if any callback is unresolved and tile codes were defined since the last build
+    void refresh(const std::vector<LevelGenCallback>& callbacks);
+
+    // Calls `fun(index)` in registration order for every callback of `tile_code_id`, stops when `fun` returns false
+    template <class FunT>
+    void for_each_candidate(std::uint32_t tile_code_id, FunT&& fun) const
+    {
+        // Indexed loop and lookup since callbacks may register new callbacks, which can grow these lists
+        for (size_t i = 0; tile_code_id < by_id.size() && i < by_id[tile_code_id].size(); ++i)
+        {
+            if (!fun(by_id[tile_code_id][i]))
+                return;
+        }
+    }
+};
+
 struct EntityInstagibCallback
 {
     int id;
@@ -228,8 +422,88 @@ struct EntityInstagibCallback
     sol::function func;
 };
 
+// The field is read and compared natively after every update, Lua is only called when the value changed
+struct FieldWatchCallback
+{
+    int id;
+    uint32_t uid;
+    // The uid may be reused once the entity is gone, so the watcher is dropped when it doesn't resolve to this one anymore
+    const Entity* entity;
+    const EntityField* field;
+    double value;
+    sol::function func;
+};
+
+struct AssetPreloadCallback
+{
+    std::future<void> done;
+    sol::function func;
+};
+
+struct AsyncSaveCallback
+{
+    std::future<bool> done;
+    sol::function func;
+};
+
+struct ScriptJobCallback
+{
+    std::future<LuaJobResult> done;
+    sol::function func;
+    // Set when the script unloads, the worker drops the job or stops it where it is
+    std::shared_ptr<std::atomic_bool> cancel;
+};
+
+class UdpServer;
+class EntityDeltaStream;
+struct UdpListenerCallback
+{
+    // Owned by the handle returned to Lua, the callback goes away with it
+    std::weak_ptr<UdpServer> server;
+    sol::function func;
+    // Called with all datagrams of the frame at once instead of once per datagram with a reply
+    bool batched;
+};
+
 using TimerCallback = std::variant<IntervalCallback, TimeoutCallback>; // NoAlias
 
+// Timers together with a timeline of the frames they are due on, so an update only visits the timers that are due
+struct TimerStorage
+{
+    std::unordered_map<int, TimerCallback> timers;
+    std::unordered_map<int, int> due_frames;
+    std::map<int, std::vector<int>> timeline;
+
+    void add(int id, TimerCallback timer);
+    void erase(int id);
+    void clear();
+    void schedule(int id, int frame);
+    // Unschedules and returns all timers due on or before `now`
+    std::vector<int> pop_due(int now);
+};
+
+struct ScheduledCoroutine
+{
+    int id;
+    sol::thread thread;
+    sol::coroutine coroutine;
+};
+
+// Coroutines resumed round robin once per frame until the time budget of their backend is used up
+struct CoroutineScheduler
+{
+    std::vector<ScheduledCoroutine> coroutines;
+    // Where the next frame continues, so the coroutines that didn't fit in the budget go first
+    size_t next{0};
+    int64_t budget_us{2000};
+    // Frames where resuming went over the budget
+    uint64_t overruns{0};
+
+    void add(int id, sol::function func);
+    void erase(int id);
+    void clear();
+};
+
 struct CurrentCallback
 {
     int32_t aux_id;
@@ -248,6 +522,16 @@ struct CustomMovableBehaviorStorage
     std::shared_ptr<void> behavior;
 };
 
+// Screen id and callback id of a screen callback
+using ScreenHookId = std::pair<int, std::uint32_t>;
+struct ScreenHookIdHash
+{
+    size_t operator()(const ScreenHookId& hook_id) const
+    {
+        return std::hash<std::uint64_t>{}(static_cast<std::uint64_t>(static_cast<std::uint32_t>(hook_id.first)) << 32 | hook_id.second);
+    }
+};
+
 struct ScriptState
 {
     uint32_t screen;
@@ -260,12 +544,6 @@ struct ScriptState
     uint32_t quest_flags;
 };
 
-struct UserData
-{
-    sol::object data;
-    std::uint32_t dtor_hook_id;
-};
-
 struct SavedUserData
 {
     sol::optional<sol::object> self;
@@ -287,17 +565,61 @@ struct StateMemory;
 class SoundManager;
 class LuaConsole;
 struct RenderInfo;
+struct LuaMemoryAccount;
+
+// Events that keep a list of subscribed backends, so dispatching them skips every backend without a callback for it
+enum class BackendEvent
+{
+    PRE_TILE_CODE,
+    POST_TILE_CODE,
+    PRE_ENTITY_SPAWN,
+    POST_ENTITY_SPAWN,
+    PRE_ENTITY_INSTAGIB,
+    RENDER_PRE_DRAW_DEPTH,
+    RENDER_POST_DRAW_DEPTH,
+    PRE_GET_FEAT,
+    PRE_SET_FEAT,
+    SPEECH_BUBBLE,
+    TOAST,
+    IDLE,
+    COUNT,
+};
+
+// Casted entity userdata handed out to scripts, reused as long as the uid still resolves to the same entity of the same type in the same state
+struct EntityObjectCache
+{
+    struct Entry
+    {
+        Entity* entity;
+        StateMemory* state;
+        ENT_TYPE type;
+        sol::object object;
+    };
+    std::unordered_map<uint32_t, Entry> entries;
+};
+
+// Module required by a backend, by its name in package.loaded, a hot reload only loads it again if the file changed
+struct LoadedModule
+{
+    std::filesystem::path file;
+    std::filesystem::file_time_type write_time;
+};
 
 struct LocalStateData
 {
     sol::object user_data;
     ScriptState state = {0, 0, 0, 0, 0, 0, 0, 0};
+    // Set once the script got at this user_data table, it may be holding on to it from then on so it's never shared again, only a fresh copy the script hasn't seen starts clean
+    bool dirty{true};
+    // user_data is a table shared with the state it was copied from, it's only copied once either of them gets to it again
+    bool borrowed{false};
 };
 
 class LuaBackend
     : public HookHandler<Entity, CallbackType::Entity>,
       public HookHandler<RenderInfo, CallbackType::Entity>,
-      public HookHandler<ThemeInfo, CallbackType::Theme>
+      public HookHandler<ThemeInfo, CallbackType::Theme>,
+      public TypeHookHandler
 {
   public:
     using ProtectedBackend = GlobalMutexProtectedResource<LuaBackend*, &global_lua_lock>;
@@ -307,7 +629,10 @@ class LuaBackend
 
     sol::environment lua;
     std::shared_ptr<sol::state> vm;
-    std::unordered_set<std::string> loaded_modules;
+    std::unordered_map<std::string, LoadedModule> loaded_modules;
+    // Old functions a hot reload replaced to the functions defined under the same name since, with weak keys,
+    // hooks that outlived the reload call the new function through this, unset until the first hot reload
+    sol::table rebound_functions;
 
     std::string result;
 
@@ -315,34 +640,59 @@ class LuaBackend
     std::stack<CurrentCallback, std::vector<CurrentCallback>> current_cb;
 
     std::map<std::string, ScriptOption> options;
-    std::deque<ScriptMessage> messages;
-    std::unordered_map<int, TimerCallback> level_timers;
-    std::unordered_map<int, TimerCallback> global_timers;
-    std::unordered_map<int, ScreenCallback> callbacks;
+    ScriptMessageRing messages;
+    TimerStorage level_timers;
+    TimerStorage global_timers;
+    CoroutineScheduler scheduled_coroutines;
+    ScreenCallbackStorage callbacks;
     std::unordered_map<int, ScreenCallback> load_callbacks;
     std::unordered_map<int, ScreenCallback> save_callbacks;
     std::unordered_map<int, HotKeyCallback> hotkey_callbacks;
+    std::unordered_map<int, RenderBatchCallback> render_batch_callbacks;
     std::vector<std::uint32_t> vanilla_sound_callbacks;
+    // Shared with the sound callbacks, which may still be called by FMOD after the backend is gone
+    std::shared_ptr<SoundCallbackQueue> sound_callback_queue{std::make_shared<SoundCallbackQueue>()};
+    SoundVoices sound_voices;
     std::vector<LevelGenCallback> pre_tile_code_callbacks;
     std::vector<LevelGenCallback> post_tile_code_callbacks;
+    TileCodeCallbackIndex pre_tile_code_index;
+    TileCodeCallbackIndex post_tile_code_index;
     std::vector<EntitySpawnCallback> pre_entity_spawn_callbacks;
     std::vector<EntitySpawnCallback> post_entity_spawn_callbacks;
+    EntitySpawnCallbackIndex pre_entity_spawn_index;
+    EntitySpawnCallbackIndex post_entity_spawn_index;
     std::vector<EntityInstagibCallback> pre_entity_instagib_callbacks;
+    std::vector<FieldWatchCallback> field_watch_callbacks;
+    std::vector<AssetPreloadCallback> asset_preload_callbacks;
+    std::vector<AsyncSaveCallback> async_save_callbacks;
+    std::vector<ScriptJobCallback> job_callbacks;
+    std::vector<UdpListenerCallback> udp_listeners;
+    std::vector<std::unique_ptr<EntityDeltaStream>> entity_delta_streams;
+    ParticleEmitterPool particle_pool;
     std::vector<std::uint32_t> chance_callbacks;
     std::vector<std::uint32_t> extra_spawn_callbacks;
-    std::vector<int> clear_callbacks;
-    std::vector<std::pair<int, std::uint32_t>> screen_hooks;
-    std::vector<std::pair<int, std::uint32_t>> clear_screen_hooks;
+    std::unordered_set<int> clear_callbacks;
+    std::unordered_set<ScreenHookId, ScreenHookIdHash> screen_hooks;
+    std::unordered_set<ScreenHookId, ScreenHookIdHash> clear_screen_hooks;
     std::vector<CustomMovableBehaviorStorage> custom_movable_behaviors;
-    std::unordered_map<std::uint32_t, UserData> user_datas;
+    UserDataStorage user_datas;
     std::unordered_map<int, SavedUserData> saved_user_datas;
     std::vector<std::string> required_scripts;
     std::unordered_map<int, ScriptInput*> script_input;
     std::unordered_set<std::string> windows;
     std::unordered_set<std::string> console_commands;
     std::unordered_map<StateMemory*, LocalStateData> local_state_datas;
+    EntityObjectCache entity_objects;
     bool manual_save{false};
     uint64_t last_save{0};
+    // Whether this script turned on set_async_savegame, turned off again with the script
+    bool async_savegame{false};
+    // Whether this script turned on the frame limiter, turned off again with the script
+    bool frame_limiter{false};
+    // Whether this script set a liquid budget, turned off again with the script
+    bool liquid_budget{false};
+    // Whether this script turned on turbo, turned off again with the script
+    bool turbo{false};
 
     ImDrawList* draw_list{nullptr};
 
@@ -351,20 +701,48 @@ class LuaBackend
     SoundManager* sound_manager;
     LuaConsole* console;
 
-    std::map<IMAGE, ScriptImage*> images;
+    std::map<IMAGE, std::shared_ptr<CachedImage>> images;
+
+    // Set by the environments __newindex when a script defines one of the deprecated on_* handlers, shared with that closure
+    std::shared_ptr<bool> deprecated_callbacks_assigned{std::make_shared<bool>(false)};
 
     size_t frame_counter{0};
+    CallbackProfiler profiler;
+    // Lua memory allocated while this backend runs, looked up by path on first use so a reloaded script keeps its account
+    LuaMemoryAccount* memory_account{nullptr};
     bool infinite_loop_detection{true};
+    // Moving average of how long the ON.IDLE callbacks take, in microseconds, used by LuaIdleScheduler to skip them when they wouldn't fit
+    float idle_average_us{0.0f};
     CORNER_FINISH vanilla_render_corner_finish = CORNER_FINISH::ADAPTIVE;
 
     LuaBackend(SoundManager* sound_manager, LuaConsole* console);
     virtual ~LuaBackend();
 
     LocalStateData& get_locals();
+    LuaMemoryAccount& get_memory_account();
+    // Same as calling `cast_entity` in Lua, but returns the cached userdata when the entity was already handed out
+    sol::object get_entity_object(Entity* entity);
     void copy_locals(StateMemory* from, StateMemory* to);
+    // StateMemory.user_data of `state` for the script to read or change, nil if it was never set
+    // Marks it dirty and makes sure no other state shares the table anymore before the script can change it
+    sol::object get_state_user_data(StateMemory* state);
+    void set_state_user_data(StateMemory* state, sol::object user_data);
     void clear();
-    void clear_all_callbacks();
+    // Keeps the hooks on single entities and their user data when `keep_entity_hooks` is set, for a hot reload
+    void clear_all_callbacks(bool keep_entity_hooks = false);
+    // Drops the modules that changed on disk from package.loaded so the next require loads them again
+    void invalidate_changed_modules();
+    // Functions defined in the environment and in the tables it holds, by `name` and `table.name`, and in the modules required
+    std::unordered_map<std::string, sol::function> collect_named_functions();
+    // Points every function of `before` at the function now defined under the same name, if it changed
+    void rebind_named_functions(const std::unordered_map<std::string, sol::function>& before);
+    sol::function resolve_rebound_function(sol::function func);
     bool update();
+    void run_due_timers(TimerStorage& timers, int now);
+    void run_scheduled_coroutines();
+    void run_finished_preloads();
+    void run_finished_saves();
+    void run_finished_jobs();
 
     virtual bool reset()
     {
@@ -405,8 +783,8 @@ class LuaBackend
     bool is_callback_cleared(int32_t callback_id) const;
     bool is_screen_callback_cleared(std::pair<int32_t, uint32_t> callback_id) const;
 
-    bool pre_tile_code(std::string_view tile_code, float x, float y, int layer, uint16_t room_template);
-    void post_tile_code(std::string_view tile_code, float x, float y, int layer, uint16_t room_template);
+    bool pre_tile_code(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template);
+    void post_tile_code(std::uint32_t tile_code_id, float x, float y, int layer, uint16_t room_template);
 
     void pre_load_level_files();
     bool pre_load_screen();
@@ -430,27 +808,29 @@ class LuaBackend
     bool pre_set_feat(FEAT feat);
 
     std::string pre_get_random_room(int x, int y, uint8_t layer, uint16_t room_template);
-    struct PreHandleRoomTilesResult
-    {
-        bool stop_callback;
-        std::optional<LevelGenRoomData> modded_room_data;
-    };
-    PreHandleRoomTilesResult pre_handle_room_tiles(LevelGenRoomData room_data, int x, int y, uint16_t room_template);
+    // The context is shared by all backends, returns true to stop the callbacks of the backends after this one
+    bool pre_handle_room_tiles(PreHandleRoomTilesContext& ctx, int x, int y, uint16_t room_template);
 
     Entity* pre_entity_spawn(std::uint32_t entity_type, float x, float y, int layer, Entity* overlay, int spawn_type_flags);
     void post_entity_spawn(Entity* entity, int spawn_type_flags);
 
     bool pre_entity_instagib(Entity* victim);
+    // Called first thing in ON.POST_UPDATE
+    void check_field_watchers();
 
     bool process_vanilla_render_callbacks(ON event);
     bool process_vanilla_render_blur_callbacks(ON event, float blur_amount);
     bool process_vanilla_render_hud_callbacks(ON event, Hud* hud);
     bool process_vanilla_render_layer_callbacks(ON event, uint8_t layer);
+    void process_render_batch_callbacks(uint8_t layer);
     bool process_vanilla_render_draw_depth_callbacks(ON event, uint8_t draw_depth, const AABB& bbox);
     bool process_vanilla_render_journal_page_callbacks(ON event, JournalPageType page_type, JournalPage* page);
 
-    std::u16string pre_speach_bubble(Entity* entity, char16_t* buffer);
-    std::u16string pre_toast(char16_t* buffer);
+    // `text` is the game's own buffer, it has to be null terminated, nothing is allocated unless a callback returns a string
+    std::optional<std::u16string> pre_speach_bubble(Entity* entity, std::u16string_view text);
+    std::optional<std::u16string> pre_toast(std::u16string_view text);
+    // Calls the ON.IDLE callbacks with the time left until `deadline` in microseconds, the ones after it are left for the next frame
+    void process_idle_callbacks(int64_t deadline);
 
     bool pre_load_journal_chapter(uint8_t chapter);
     std::vector<uint32_t> post_load_journal_chapter(uint8_t chapter, const std::vector<uint32_t>& pages);
@@ -472,7 +852,24 @@ class LuaBackend
 
     void set_error(std::string err);
 
+    bool has_callbacks(BackendEvent event) const;
+    bool has_callbacks(ON event) const;
+    // Union of the draw depths the callbacks for `event` are interested in
+    uint64_t get_draw_depth_interest(ON event) const;
+
     static void for_each_backend(std::function<bool(LockedBackend)> fun, bool stop_propagation = true);
+    // Like for_each_backend but only visits backends that have a callback for `event`
+    static void for_each_subscriber(BackendEvent event, std::function<bool(LockedBackend)> fun, bool stop_propagation = true);
+    // Locks the backends that have a callback for `event` once, for dispatching many events in a row
+    // The list is outdated as soon as `get_subscribers_generation` returns something else
+    static std::vector<LockedBackend> lock_subscribers(BackendEvent event);
+    // Doesn't lock, so only call it while holding global_lua_lock
+    static std::uint32_t get_subscribers_generation();
+    // Has to be called whenever callbacks for any BackendEvent are added or removed, it also attaches the game hooks the new callbacks need
+    static void invalidate_subscribers();
+    static bool has_subscribers(BackendEvent event);
+    // Whether any backend has a callback for ON.RENDER_PRE/POST_DRAW_DEPTH at this draw depth
+    static bool has_draw_depth_subscribers(ON event, uint8_t draw_depth);
     static LockedBackend get_backend(std::string_view id);
     static std::optional<LockedBackend> get_backend_safe(std::string_view id);
     static LockedBackend get_backend_by_id(std::string_view id, std::string_view ver = "");
@@ -0,0 +1,223 @@
+#include "lua_bytecode_cache.hpp"
+
+#include <algorithm>  // for min, clamp
+#include <atomic>     // for atomic
+#include <cstdint>    // for uint32_t, uint64_t
+#include <cstring>    // for memcpy
+#include <filesystem> // for path, last_write_time, file_size
+#include <fstream>    // for ifstream
+#include <iterator>   // for istreambuf_iterator
+#include <lauxlib.h>  // for luaL_loadbufferx, luaL_loadfilex, luaL_newstate
+#include <lua.h>      // for lua_dump, lua_pop, lua_settop, lua_close, LUA_OK, LUA_SIGNATURE
+#include <thread>     // for thread, hardware_concurrency
+#include <vector>     // for vector
+
+#include "file_api.hpp" // for get_bytecode_cache_path, write_cache_file
+
+namespace
+{
+constexpr uint32_t cache_magic{0x434C4C4F}; // "OLLC"
+constexpr uint32_t cache_version{1};
+
+struct CacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;
+    int64_t source_write_time;
+    uint64_t content_hash;
+};
+
+uint64_t hash_content(std::string_view content)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : content)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool read_file(const std::filesystem::path& path, std::vector<char>& out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool read_cache(const std::filesystem::path& cache_path, CacheHeader& header, std::vector<char>& bytecode)
+{
+    if (!read_file(cache_path, bytecode) || bytecode.size() <= sizeof(CacheHeader))
+        return false;
+    std::memcpy(&header, bytecode.data(), sizeof(CacheHeader));
+    if (header.magic != cache_magic || header.version != cache_version)
+        return false;
+    bytecode.erase(bytecode.begin(), bytecode.begin() + sizeof(CacheHeader));
+    return true;
+}
+
+int dump_writer(lua_State*, const void* data, size_t size, void* user_data)
+{
+    auto& out = *static_cast<std::vector<char>*>(user_data);
+    const char* bytes = static_cast<const char*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+    return 0;
+}
+
+// Compiles the source and writes the chunk on top of the stack to the cache, keeps the chunk on the stack
+int compile_and_cache(lua_State* L, std::string_view code, const char* chunkname, const std::filesystem::path& cache_path, CacheHeader header)
+{
+    const int res = luaL_loadbufferx(L, code.data(), code.size(), chunkname, "t");
+    if (res != LUA_OK)
+        return res;
+
+    std::vector<char> cache_file(sizeof(CacheHeader));
+    std::memcpy(cache_file.data(), &header, sizeof(CacheHeader));
+    // Not stripped, so error messages and the debug library still see the source name and line numbers
+    if (lua_dump(L, dump_writer, &cache_file, 0) == 0)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(cache_path.parent_path(), ec);
+        write_cache_file(cache_path, cache_file);
+    }
+    return LUA_OK;
+}
+
+int load_bytecode(lua_State* L, const std::vector<char>& bytecode, const char* chunkname)
+{
+    const int res = luaL_loadbufferx(L, bytecode.data(), bytecode.size(), chunkname, "b");
+    if (res != LUA_OK)
+    {
+        // Most likely made by a different Lua version, recompile
+        lua_pop(L, 1);
+    }
+    return res;
+}
+
+std::string make_chunk_name(std::string_view code)
+{
+    // Not a file name, like what sol uses for code loaded from a string, which lua_require relies on to find the script root
+    return std::string{code.substr(0, std::min<size_t>(code.find_first_of("\r\n"), 32))};
+}
+} // namespace
+
+int load_cached_lua_file(lua_State* L, const std::string& path)
+{
+    std::error_code ec;
+    const uint64_t source_size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return luaL_loadfilex(L, path.c_str(), "bt");
+    const int64_t source_write_time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if (ec)
+        return luaL_loadfilex(L, path.c_str(), "bt");
+
+    const std::string chunkname = "@" + path;
+    const auto cache_path = get_bytecode_cache_path(path);
+
+    CacheHeader cached;
+    std::vector<char> bytecode;
+    const bool has_cache = read_cache(cache_path, cached, bytecode);
+    if (has_cache && cached.source_size == source_size && cached.source_write_time == source_write_time)
+    {
+        if (load_bytecode(L, bytecode, chunkname.c_str()) == LUA_OK)
+            return LUA_OK;
+    }
+
+    std::vector<char> source;
+    if (!read_file(path, source))
+        return luaL_loadfilex(L, path.c_str(), "bt");
+
+    std::string_view code{source.data(), source.size()};
+    // luaL_loadfilex skips a UTF-8 BOM before anything else
+    if (code.starts_with("\xEF\xBB\xBF"))
+        code.remove_prefix(3);
+    if (code.starts_with(LUA_SIGNATURE[0]))
+    {
+        // Already precompiled, nothing to cache
+        return luaL_loadbufferx(L, code.data(), code.size(), chunkname.c_str(), "b");
+    }
+    if (code.starts_with('#'))
+    {
+        // luaL_loadfilex skips a shebang line, keep the newline so line numbers stay the same
+        code.remove_prefix(std::min(code.find('\n'), code.size()));
+    }
+
+    const uint64_t content_hash = hash_content(code);
+    if (has_cache && cached.content_hash == content_hash)
+    {
+        // Only touched, refresh the header so the next load doesn't have to read the source
+        if (load_bytecode(L, bytecode, chunkname.c_str()) == LUA_OK)
+        {
+            std::vector<char> cache_file(sizeof(CacheHeader));
+            const CacheHeader header{cache_magic, cache_version, source_size, source_write_time, content_hash};
+            std::memcpy(cache_file.data(), &header, sizeof(CacheHeader));
+            cache_file.insert(cache_file.end(), bytecode.begin(), bytecode.end());
+            write_cache_file(cache_path, cache_file);
+            return LUA_OK;
+        }
+    }
+
+    return compile_and_cache(L, code, chunkname.c_str(), cache_path, {cache_magic, cache_version, source_size, source_write_time, content_hash});
+}
+
+int load_cached_lua_chunk(lua_State* L, std::string_view code, std::string_view path)
+{
+    const std::string chunkname = make_chunk_name(code);
+    const auto cache_path = get_bytecode_cache_path(path, ".chunk.luac");
+    const uint64_t content_hash = hash_content(code);
+
+    CacheHeader cached;
+    std::vector<char> bytecode;
+    if (read_cache(cache_path, cached, bytecode) && cached.source_size == code.size() && cached.content_hash == content_hash)
+    {
+        if (load_bytecode(L, bytecode, chunkname.c_str()) == LUA_OK)
+            return LUA_OK;
+    }
+
+    return compile_and_cache(L, code, chunkname.c_str(), cache_path, {cache_magic, cache_version, code.size(), 0, content_hash});
+}
+
+void precompile_lua_scripts(const std::vector<std::filesystem::path>& files)
+{
+    if (files.empty())
+        return;
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        lua_State* L = luaL_newstate();
+        if (L == nullptr)
+            return;
+        std::vector<char> source;
+        for (size_t i = next++; i < files.size(); i = next++)
+        {
+            // Read the same way the ui loads scripts, so the content hash matches
+            if (!read_file(files[i], source))
+                continue;
+
+            // Same path the ui gives the script, utf-8 with forward slashes
+            const auto u8path = files[i].u8string();
+            std::string path{u8path.begin(), u8path.end()};
+            std::replace(path.begin(), path.end(), '\\', '/');
+            load_cached_lua_chunk(L, std::string_view{source.data(), source.size()}, path);
+            lua_settop(L, 0);
+        }
+        lua_close(L);
+    };
+
+    const size_t num_threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(num_threads, files.size()); ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <filesystem>  // for path
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+struct lua_State;
+
+// Compiled chunks are kept as string.dump output in the cache folder, next to the converted textures
+// Both functions push the loaded chunk and return the same status codes as luaL_loadbufferx, the chunk still has the global _ENV
+
+// Replacement for luaL_loadfilex, the cache entry is looked up by path and used directly while the file's size and write time are unchanged
+int load_cached_lua_file(lua_State* L, const std::string& path);
+// Loads `code` as if it came from `path`, for sources that are already in memory, the cache entry is used when the content hash matches
+int load_cached_lua_chunk(lua_State* L, std::string_view code, std::string_view path);
+
+// Compiles the main chunks of all the scripts into the cache in parallel, each worker thread with its own bare lua_State
+// Only compiles, running the chunks needs the shared vm and stays serial, but afterwards loading the scripts finds them in the cache
+void precompile_lua_scripts(const std::vector<std::filesystem::path>& files);
@@ -1,6 +1,8 @@
 #include "lua_console.hpp"
 
+#include <algorithm>    // for lower_bound, sort, unique
 #include <array>        // for array, _Array_const_iterator
+#include <cmath>        // for ceil, floor
 #include <compare>      // for operator<
 #include <cstdlib>      // for exit, free
 #include <cstring>      // for memchr, memset
@@ -19,12 +21,77 @@
 #include <utility>      // for min, max, tuple_element<>::type
 
 #include "lua_libs/lua_libs.hpp"  // for require_serpent_lua
+#include "lua_sampler.hpp"        // for start_lua_sampling, stop_lua_sampling
 #include "lua_vm.hpp"             // for execute_lua, expose_unsafe_libraries
 #include "script/lua_backend.hpp" // for LuaBackend
 #include "util.hpp"               // for ON_SCOPE_EXIT
 
 class SoundManager;
 
+namespace
+{
+// All entries of a sorted list that start with prefix, names starting with `__` only if the prefix does as well
+std::vector<std::string_view> find_completions(const std::vector<std::string>& sorted, std::string_view prefix)
+{
+    std::vector<std::string_view> found;
+    const bool show_hidden = prefix.starts_with("__");
+    for (auto it = std::lower_bound(sorted.begin(), sorted.end(), prefix); it != sorted.end() && it->starts_with(prefix); ++it)
+    {
+        if (show_hidden || !it->starts_with("__"))
+        {
+            found.push_back(*it);
+        }
+    }
+    return found;
+}
+
+// Count hooks may yield, this suspends an async command once its budget for the frame is used up
+void async_budget_hook(lua_State* L, lua_Debug*)
+{
+    if (lua_isyieldable(L))
+    {
+        lua_yield(L, 0);
+    }
+}
+
+std::string json_string(std::string_view str)
+{
+    std::string out{"\""};
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            out += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+void sort_completions(std::vector<std::string>& names)
+{
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+size_t message_bytes(const std::vector<ScriptMessage>& messages)
+{
+    size_t bytes = 0;
+    for (const ScriptMessage& message : messages)
+        bytes += message.message.size();
+    return bytes;
+}
+} // namespace
+
 LuaConsole::LuaConsole(SoundManager* soundmanager)
     : LockableLuaBackend<LuaConsole>(soundmanager, this)
 {
@@ -32,6 +99,17 @@ LuaConsole::LuaConsole(SoundManager* soundmanager)
 
     expose_unsafe_libraries(lua);
 
+    /// Start sampling the Lua call stack of all scripts every `instructions` instructions (default 1000)
+    lua["start_sampling_profiler"] = [](std::optional<int> instructions)
+    {
+        start_lua_sampling(get_lua_vm().lua_state(), instructions.value_or(1000));
+    };
+    /// Stop the sampling profiler and write a flamegraph compatible folded stack file (default `lua_profile.folded`), returns the number of samples
+    lua["stop_sampling_profiler"] = [](std::optional<std::string> file) -> size_t
+    {
+        return stop_lua_sampling(get_lua_vm().lua_state(), file.value_or("lua_profile.folded"));
+    };
+
     // THIS LIST IS AUTO GENERATED
     // To recreate it, run the entity_casting.py script
     // It will dump the list to stdout, and overwrite docs/entities-hierarchy.md
@@ -459,63 +537,53 @@ bool LuaConsole::on_completion(ImGuiInputTextCallbackData* data)
         std::vector<std::string_view> possible_options;
         try
         {
-            possible_options = [this](std::string_view _to_complete_end, std::string_view _to_complete_base)
+            possible_options = [this](std::string_view _to_complete_end, std::string_view _to_complete_base) -> std::vector<std::string_view>
             {
                 if (_to_complete_base.empty())
                 {
-                    using namespace std::string_view_literals;
-                    static constexpr std::array additional_options{
-                        "cls"sv,
-                        "and"sv,
-                        "break"sv,
-                        "do"sv,
-                        "else"sv,
-                        "elseif"sv,
-                        "end"sv,
-                        "false"sv,
-                        "for"sv,
-                        "function"sv,
-                        "if"sv,
-                        "in"sv,
-                        "local"sv,
-                        "nil"sv,
-                        "not"sv,
-                        "or"sv,
-                        "repeat"sv,
-                        "return"sv,
-                        "then"sv,
-                        "true"sv,
-                        "until"sv,
-                        "while"sv,
-                    };
-
-                    std::vector<std::string_view> possibleoptions;
-
-                    for (std::string_view opt : additional_options)
-                    {
-                        if (opt.starts_with(_to_complete_end))
-                        {
-                            possibleoptions.push_back(opt);
-                        }
-                    }
-
-                    for (const auto& [k, v] : lua)
+                    if (global_completions_dirty)
                     {
-                        if (k.get_type() == sol::type::string)
+                        using namespace std::string_view_literals;
+                        static constexpr std::array additional_options{
+                            "cls"sv,
+                            "and"sv,
+                            "break"sv,
+                            "do"sv,
+                            "else"sv,
+                            "elseif"sv,
+                            "end"sv,
+                            "false"sv,
+                            "for"sv,
+                            "function"sv,
+                            "if"sv,
+                            "in"sv,
+                            "local"sv,
+                            "nil"sv,
+                            "not"sv,
+                            "or"sv,
+                            "repeat"sv,
+                            "return"sv,
+                            "then"sv,
+                            "true"sv,
+                            "until"sv,
+                            "while"sv,
+                        };
+
+                        global_completions.assign(additional_options.begin(), additional_options.end());
+                        for (const auto& [k, v] : lua)
                         {
-                            const std::string_view str = k.as<std::string_view>();
-                            if (str.starts_with(_to_complete_end) && (!str.starts_with("__") || _to_complete_end.starts_with("__")))
+                            if (k.get_type() == sol::type::string)
                             {
-                                possibleoptions.push_back(str);
+                                global_completions.push_back(k.as<std::string>());
                             }
                         }
+                        sort_completions(global_completions);
+                        global_completions_dirty = false;
                     }
-                    return possibleoptions;
+                    return find_completions(global_completions, _to_complete_end);
                 }
                 else
                 {
-                    std::vector<std::string_view> possibleoptions;
-
                     // Need to collect these in a vector, otherwise the state somehow breaks
                     std::vector<sol::userdata> source_obj{};
                     std::vector<sol::table> source{};
@@ -534,22 +602,28 @@ bool LuaConsole::on_completion(ImGuiInputTextCallbackData* data)
                         }
                         else
                         {
-                            return possibleoptions;
+                            return {};
+                        }
+                    }
+
+                    // Members of a usertype only depend on its metatable, so the down cast chain is only walked once per type
+                    const void* metatable = source_obj.empty() ? nullptr : source.back().pointer();
+                    if (metatable != nullptr)
+                    {
+                        if (auto it = member_completions.find(metatable); it != member_completions.end())
+                        {
+                            return find_completions(it->second, _to_complete_end);
                         }
                     }
 
-                    const bool grab_all = _to_complete_end.empty();
+                    std::vector<std::string> members;
                     while (true)
                     {
                         for (const auto& [k, v] : source.back())
                         {
                             if (k.get_type() == sol::type::string)
                             {
-                                const std::string_view str = k.as<std::string_view>();
-                                if ((grab_all || str.starts_with(_to_complete_end)) && (!str.starts_with("__") || _to_complete_end.starts_with("__")))
-                                {
-                                    possibleoptions.push_back(str);
-                                }
+                                members.push_back(k.as<std::string>());
                             }
                         }
 
@@ -584,7 +658,12 @@ bool LuaConsole::on_completion(ImGuiInputTextCallbackData* data)
                             break;
                         }
                     }
-                    return possibleoptions;
+                    sort_completions(members);
+
+                    // Plain tables can change at any time, their names are only kept for this completion
+                    std::vector<std::string>& completions = metatable != nullptr ? member_completions[metatable] : table_completions;
+                    completions = std::move(members);
+                    return find_completions(completions, _to_complete_end);
                 }
             }(to_complete_end, to_complete_base);
         }
@@ -707,75 +786,70 @@ bool LuaConsole::pre_draw()
 
         static const ImVec4 trans{0.0f, 0.0f, 0.0f, 0.0f};
 
-        for (size_t i = 0; i < history.size(); i++)
+        // The copy button and the spacing after it come before the text
+        layout_history(std::max(std::floor(ImGui::GetContentRegionAvail().x - 16.0f - ImGui::GetStyle().ItemSpacing.x), 1.0f));
+
+        if (highlight_history && set_scroll_to_history_item.has_value())
         {
-            auto& item = history[i];
+            auto row = std::find_if(history_rows.begin(), history_rows.end(), [this](const ConsoleHistoryRow& r)
+                                    { return r.item == set_scroll_to_history_item.value(); });
+            if (row != history_rows.end())
+                ImGui::SetScrollFromPosY(ImGui::GetCursorPosY() - ImGui::GetScrollY() + row->top, 0.0f);
+            last_force_scroll = set_scroll_to_history_item;
+            set_scroll_to_history_item = std::nullopt;
+        }
 
+        auto render_row = [this](const ConsoleHistoryRow& row)
+        {
+            const ConsoleHistoryItem& item = history[row.item];
+            const bool is_command = row.message == ConsoleHistoryRow::COMMAND;
+            const std::string& text = is_command ? item.command : item.messages[row.message].message;
+            ImVec4 color = is_command ? ImVec4{0.7f, 0.7f, 0.7f, 1.0f} : item.messages[row.message].color;
+            if (is_command && history_pos == row.item)
             {
-                ImVec4 color{0.7f, 0.7f, 0.7f, 1.0f};
-                if (history_pos == i)
-                {
-                    color = ImVec4{0.4f, 0.8f, 0.4f, 1.0f};
-                }
-
-                int num = 1;
-                const char* str;
-                for (str = item.command.c_str(); *str; ++str)
-                    num += *str == '\n';
-
-                ImGui::PushStyleColor(ImGuiCol_Button, trans);
-                ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
-                ImGui::PushStyleVar(ImGuiStyleVar_ButtonTextAlign, ImVec2(0, 0));
-                ImGui::PushID((int)i);
-                ImGui::PushID(item.command.c_str());
-                if (ImGui::Button("> ##CopyCommandToClipboard", {16.0f, ImGui::GetTextLineHeight() * num}))
-                    ImGui::SetClipboardText(item.command.c_str());
-                if (ImGui::IsItemHovered())
-                    ImGui::SetTooltip("Copy command to clipboard!");
-                ImGui::PopID();
-                ImGui::PopID();
-                ImGui::PopStyleVar();
-                ImGui::PopStyleVar();
-                ImGui::PopStyleColor();
-                ImGui::SameLine();
-                ImGui::PushStyleColor(ImGuiCol_Text, color);
-                ImGui::TextWrapped("%s", item.command.c_str());
-                ImGui::PopStyleColor();
+                color = ImVec4{0.4f, 0.8f, 0.4f, 1.0f};
             }
 
-            if (highlight_history && i == set_scroll_to_history_item)
-            {
-                ImGui::SetScrollHereY(0.0f);
-                last_force_scroll = set_scroll_to_history_item;
-                set_scroll_to_history_item = std::nullopt;
-            }
-            for (const auto& results : item.messages)
-            {
-                int num = 1;
-                const char* str;
-                for (str = results.message.c_str(); *str; ++str)
-                    num += *str == '\n';
-
-                ImGui::PushStyleColor(ImGuiCol_Button, trans);
-                ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
-                ImGui::PushStyleVar(ImGuiStyleVar_ButtonTextAlign, ImVec2(0, 0));
-                ImGui::PushID((int)i);
-                ImGui::PushID(results.message.c_str());
-                if (ImGui::Button("< ##CopyResultToClipboard", {16.0f, ImGui::GetTextLineHeight() * num}))
-                    ImGui::SetClipboardText(results.message.c_str());
-                if (ImGui::IsItemHovered())
-                    ImGui::SetTooltip("Copy result to clipboard!");
-                ImGui::PopID();
-                ImGui::PopID();
-                ImGui::PopStyleVar();
-                ImGui::PopStyleVar();
-                ImGui::PopStyleColor();
-                ImGui::SameLine();
-                ImGui::PushStyleColor(ImGuiCol_Text, results.color);
-                ImGui::TextWrapped("%s", results.message.c_str());
-                ImGui::PopStyleColor();
-            }
+            ImGui::PushStyleColor(ImGuiCol_Button, trans);
+            ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
+            ImGui::PushStyleVar(ImGuiStyleVar_ButtonTextAlign, ImVec2(0, 0));
+            ImGui::PushID((int)row.item);
+            ImGui::PushID((int)row.message);
+            if (ImGui::Button(is_command ? "> ##CopyCommandToClipboard" : "< ##CopyResultToClipboard", {16.0f, row.height - ImGui::GetStyle().ItemSpacing.y}))
+                ImGui::SetClipboardText(text.c_str());
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip(is_command ? "Copy command to clipboard!" : "Copy result to clipboard!");
+            ImGui::PopID();
+            ImGui::PopID();
+            ImGui::PopStyleVar();
+            ImGui::PopStyleVar();
+            ImGui::PopStyleColor();
+            ImGui::SameLine();
+            ImGui::PushStyleColor(ImGuiCol_Text, color);
+            // Same as TextWrapped, without formatting the whole text into a buffer every frame
+            ImGui::PushTextWrapPos(0.0f);
+            ImGui::TextUnformatted(text.data(), text.data() + text.size());
+            ImGui::PopTextWrapPos();
+            ImGui::PopStyleColor();
+        };
+
+        // Rows differ in height, so the clipper steps over pixels and the rows covering them are looked up by their offsets
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(std::ceil(history_height)), 1.0f);
+        auto next_row = history_rows.begin();
+        while (clipper.Step())
+        {
+            const float display_start = static_cast<float>(clipper.DisplayStart);
+            const float display_end = static_cast<float>(clipper.DisplayEnd);
+            auto row = std::partition_point(next_row, history_rows.end(), [display_start](const ConsoleHistoryRow& r)
+                                            { return r.top + r.height <= display_start; });
+            if (row != history_rows.end())
+                ImGui::SetCursorScreenPos({ImGui::GetCursorScreenPos().x, clipper.StartPosY + row->top});
+            for (; row != history_rows.end() && row->top < display_end; ++row)
+                render_row(*row);
+            next_row = row;
         }
+        clipper.End();
 
         if (scroll_to_bottom)
         {
@@ -893,11 +967,13 @@ bool LuaConsole::pre_draw()
                 if (console_input == "cls"sv || console_input == "clr"sv || console_input == "clear"sv)
                 {
                     history_pos = std::nullopt;
-                    history.clear();
+                    clear_history();
                 }
                 else if (console_input == "reset"sv || console_input == "reload"sv)
                 {
+                    stop_async();
                     LuaBackend::clear();
+                    global_completions_dirty = true;
                 }
                 else if (console_input == "quit"sv)
                 {
@@ -921,15 +997,24 @@ bool LuaConsole::pre_draw()
                     expose_unsafe_libraries(lua);
                     unsafe = true;
                 }
+                else if (console_input == "stop"sv)
+                {
+                    stop_async();
+                }
+                else if (std::string_view{console_input}.starts_with("async "))
+                {
+                    history_pos = std::nullopt;
+                    if (!execute_async(console_input + 6))
+                    {
+                        push_history(console_input, {{"Another async command is still running, 'stop' it first", {}, ImVec4(1.0f, 0.4f, 0.4f, 1.0f)}});
+                    }
+                }
                 else
                 {
-                    std::size_t messages_before = messages.size();
-
-                    auto results = execute(console_input);
-
                     std::vector<ScriptMessage> result_message;
-                    std::move(messages.begin() + messages_before, messages.end(), std::back_inserter(result_message));
-                    messages.erase(messages.begin() + messages_before, messages.end());
+                    messages.capture(&result_message);
+                    auto results = execute(console_input);
+                    messages.capture(nullptr);
 
                     if (!results.str.empty())
                     {
@@ -1033,9 +1118,134 @@ ConsoleResult LuaConsole::execute(std::string str, bool raw)
 
 sol::protected_function_result LuaConsole::execute_raw(std::string str)
 {
+    global_completions_dirty = true;
     return execute_lua(lua, str, true);
 }
 
+bool LuaConsole::execute_async(std::string str)
+{
+    if (async_command.has_value())
+        return false;
+
+    global_completions_dirty = true;
+    std::string command = "async " + str;
+
+    sol::state& vm = get_lua_vm();
+    sol::load_result chunk = vm.load("return " + str, "=console");
+    if (!chunk.valid())
+        chunk = vm.load(str, "=console");
+    if (!chunk.valid())
+    {
+        sol::error err = chunk;
+        set_error(err.what());
+        push_history(std::move(command), {{err.what(), {}, ImVec4(1.0f, 0.4f, 0.4f, 1.0f)}});
+        return true;
+    }
+
+    sol::protected_function function = chunk;
+    sol::set_environment(lua, function);
+
+    sol::thread thread = sol::thread::create(vm.lua_state());
+    lua_sethook(thread.thread_state(), &async_budget_hook, LUA_MASKCOUNT, async_instruction_budget);
+    sol::coroutine coroutine{thread.thread_state(), function};
+    async_command = AsyncCommand{std::move(thread), std::move(coroutine)};
+
+    push_history(std::move(command), {});
+    if (!history.empty())
+        history.back().running = true;
+    return true;
+}
+
+void LuaConsole::resume_async()
+{
+    if (!async_command.has_value())
+        return;
+
+    LuaBackend::push_calling_backend(this);
+    ON_SCOPE_EXIT(LuaBackend::pop_calling_backend(this));
+
+    std::vector<ScriptMessage> output;
+    messages.capture(&output);
+    sol::protected_function_result res = async_command->coroutine();
+    messages.capture(nullptr);
+    const bool finished = res.status() != sol::call_status::yielded;
+
+    if (finished)
+    {
+        if (!res.valid())
+        {
+            sol::error err = res;
+            set_error(err.what());
+            output.push_back({err.what(), {}, ImVec4(1.0f, 0.4f, 0.4f, 1.0f)});
+        }
+        else if (res.return_count() > 0)
+        {
+            // Results live on the coroutine stack, so take the value out before dumping it on the main one
+            sol::object value = res.get<sol::object>();
+            if (value.get_type() != sol::type::nil)
+            {
+                sol::protected_function dump_string = lua["dump_string"];
+                sol::protected_function_result out = dump_string(value, 2);
+                if (out.valid())
+                {
+                    output.push_back({out.get<std::string>(), {}, ImVec4(1.0f, 1.0f, 1.0f, 1.0f)});
+                }
+                else
+                {
+                    sol::error err = out;
+                    output.push_back({err.what(), {}, ImVec4(1.0f, 0.4f, 0.4f, 1.0f)});
+                }
+            }
+        }
+    }
+
+    // The item is gone if the history was cleared or scrolled out in the meantime, the output is dropped then
+    auto item = std::find_if(history.rbegin(), history.rend(), [](const ConsoleHistoryItem& it)
+                             { return it.running; });
+    if (item != history.rend())
+    {
+        if (finished)
+            item->running = false;
+        if (!output.empty())
+        {
+            const size_t bytes = message_bytes(output);
+            item->bytes += bytes;
+            history_bytes += bytes;
+            std::move(output.begin(), output.end(), std::back_inserter(item->messages));
+            has_new_history = true;
+            scroll_to_bottom = true;
+            trim_history();
+        }
+    }
+
+    if (finished)
+        async_command.reset();
+}
+
+void LuaConsole::stop_async()
+{
+    if (!async_command.has_value())
+        return;
+
+    for (ConsoleHistoryItem& item : history)
+    {
+        if (item.running)
+        {
+            item.messages.push_back({"Stopped", {}, ImVec4(1.0f, 0.4f, 0.4f, 1.0f)});
+            item.bytes += item.messages.back().message.size();
+            history_bytes += item.messages.back().message.size();
+            item.running = false;
+        }
+    }
+    async_command.reset();
+}
+
+bool LuaConsole::pre_update()
+{
+    resume_async();
+    return true;
+}
+
 void LuaConsole::toggle()
 {
     toggled = !toggled;
@@ -1054,12 +1264,119 @@ void LuaConsole::push_history(std::string history_item, std::vector<ScriptMessag
     {
         has_new_history = true;
         scroll_to_bottom = true;
+        const size_t bytes = history_item.size() + message_bytes(result_item);
         history.push_back(ConsoleHistoryItem{
             std::move(history_item),
             std::move(result_item)});
-        if (history.size() > max_history)
+        history.back().bytes = bytes;
+        history_bytes += bytes;
+        history_rows_dirty = true;
+        trim_history();
+    }
+}
+
+void LuaConsole::clear_history()
+{
+    history.clear();
+    history_bytes = 0;
+    history_rows_dirty = true;
+}
+
+void LuaConsole::trim_history()
+{
+    size_t dropped = 0;
+    while (history.size() - dropped > 1 && (history.size() - dropped > max_history || history_bytes > max_history_bytes))
+    {
+        history_bytes -= history[dropped].bytes;
+        ++dropped;
+    }
+
+    if (dropped > 0)
+    {
+        history.erase(history.begin(), history.begin() + dropped);
+        history_rows_dirty = true;
+
+        // Indices into the history move down with it, the ones pointing at dropped items are forgotten
+        auto shift = [dropped](std::optional<size_t>& index)
         {
-            history.erase(history.begin());
+            if (!index.has_value() || index.value() == static_cast<size_t>(-1))
+                return;
+            if (index.value() < dropped)
+                index = std::nullopt;
+            else
+                index.value() -= dropped;
+        };
+        shift(history_pos);
+        shift(set_scroll_to_history_item);
+        shift(last_force_scroll);
+    }
+
+    if (history.size() == 1 && history_bytes > max_history_bytes)
+    {
+        // Cut the messages where they go over the limit, the command is kept either way
+        ConsoleHistoryItem& item = history.front();
+        size_t budget = max_history_bytes > item.command.size() ? max_history_bytes - item.command.size() : 0;
+        size_t kept = 0;
+        for (; kept < item.messages.size(); ++kept)
+        {
+            std::string& message = item.messages[kept].message;
+            if (message.size() > budget)
+            {
+                // Back up to the start of a character so the cut doesn't leave half a UTF-8 sequence
+                while (budget > 0 && (static_cast<unsigned char>(message[budget]) & 0xC0) == 0x80)
+                    --budget;
+                message.resize(budget);
+                message += "\n... (truncated)";
+                ++kept;
+                break;
+            }
+            budget -= message.size();
+        }
+        item.messages.resize(kept);
+        item.bytes = item.command.size() + message_bytes(item.messages);
+        item.heights.clear();
+        history_bytes = item.bytes;
+        history_rows_dirty = true;
+    }
+}
+
+void LuaConsole::layout_history(float wrap_width)
+{
+    auto measure = [wrap_width](const std::string& text)
+    {
+        return ImGui::CalcTextSize(text.data(), text.data() + text.size(), false, wrap_width).y + ImGui::GetStyle().ItemSpacing.y;
+    };
+
+    for (ConsoleHistoryItem& item : history)
+    {
+        if (item.wrap_width != wrap_width)
+        {
+            item.wrap_width = wrap_width;
+            item.heights.clear();
+        }
+        if (item.heights.size() == item.messages.size() + 1)
+            continue;
+
+        history_rows_dirty = true;
+        if (item.heights.empty())
+            item.heights.push_back(measure(item.command));
+        for (size_t i = item.heights.size() - 1; i < item.messages.size(); ++i)
+            item.heights.push_back(measure(item.messages[i].message));
+    }
+
+    if (!history_rows_dirty)
+        return;
+    history_rows_dirty = false;
+    history_rows.clear();
+    history_height = 0.0f;
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        const ConsoleHistoryItem& item = history[i];
+        for (size_t j = 0; j < item.heights.size(); ++j)
+        {
+            const size_t message = j == 0 ? ConsoleHistoryRow::COMMAND : j - 1;
+            history_rows.push_back({i, message, history_height, item.heights[j]});
+            history_height += item.heights[j];
         }
     }
 }
@@ -1129,6 +1446,122 @@ std::string LuaConsole::dump_api()
     return api;
 }
 
+std::string LuaConsole::dump_api_json()
+{
+    std::set<std::string> excluded_keys{"meta", "__require", "__script_id", "TYPE_MAP", "get_script_id"};
+    {
+        sol::state dummy_state;
+        dummy_state.open_libraries(sol::lib::math, sol::lib::base, sol::lib::string, sol::lib::table, sol::lib::coroutine, sol::lib::package, sol::lib::debug);
+        for (auto& [key, value] : dummy_state["_G"].get<sol::table>())
+        {
+            excluded_keys.insert(key.as<std::string>());
+        }
+    }
+
+    std::set<std::string> functions;
+    std::map<std::string, std::map<std::string, std::string>> enums;
+    for (auto& [key, value] : lua)
+    {
+        if (key.get_type() != sol::type::string)
+            continue;
+        std::string key_str = key.as<std::string>();
+        if (key_str.starts_with("sol.") || excluded_keys.contains(key_str))
+            continue;
+
+        if (value.get_type() == sol::type::function)
+        {
+            functions.insert(std::move(key_str));
+        }
+        else if (value.get_type() == sol::type::table && key_str.find_first_of("abcdefghijklmnopqrstuvwxyz") == std::string::npos)
+        {
+            // Enums are upper case tables of numbers, same as what dump_api writes
+            std::map<std::string, std::string> entries;
+            bool is_enum{true};
+            for (auto& [name, number] : value.as<sol::table>())
+            {
+                if (name.get_type() != sol::type::string || number.get_type() != sol::type::number)
+                {
+                    is_enum = false;
+                    break;
+                }
+                const double num = number.as<double>();
+                entries[name.as<std::string>()] = num == static_cast<double>(static_cast<int64_t>(num)) ? fmt::format("{}", static_cast<int64_t>(num)) : fmt::format("{}", num);
+            }
+            if (is_enum && !entries.empty())
+                enums[std::move(key_str)] = std::move(entries);
+        }
+    }
+
+    // Every usertype registers its metatables as e.g. "sol.Player", "sol.Player*" and "sol.const Player*", they are merged by type name
+    std::map<std::string, std::set<std::string>> types;
+    for (auto& [key, value] : get_lua_vm().registry())
+    {
+        if (key.get_type() != sol::type::string || value.get_type() != sol::type::table)
+            continue;
+        std::string_view name = key.as<std::string_view>();
+        if (!name.starts_with("sol."))
+            continue;
+        name.remove_prefix(4);
+        if (name.starts_with("const "))
+            name.remove_prefix(6);
+        while (name.ends_with("*") || name.ends_with(" "))
+            name.remove_suffix(1);
+        // Internal sol types and containers
+        if (name.empty() || name.find_first_of(":<>") != std::string_view::npos)
+            continue;
+
+        std::set<std::string>& members = types[std::string{name}];
+        for (auto& [member, member_value] : value.as<sol::table>())
+        {
+            if (member.get_type() == sol::type::string)
+            {
+                std::string member_str = member.as<std::string>();
+                if (!member_str.starts_with("__") && member_str != "class_check" && member_str != "class_cast")
+                    members.insert(std::move(member_str));
+            }
+        }
+    }
+
+    std::string json{"{\n  \"types\": {"};
+    auto out_it = std::back_inserter(json);
+    bool first{true};
+    for (auto& [name, members] : types)
+    {
+        fmt::format_to(out_it, "{}\n    {}: [", first ? "" : ",", json_string(name));
+        bool first_member{true};
+        for (const std::string& member : members)
+        {
+            fmt::format_to(out_it, "{}{}", first_member ? "" : ", ", json_string(member));
+            first_member = false;
+        }
+        json += "]";
+        first = false;
+    }
+    json += "\n  },\n  \"functions\": [";
+    first = true;
+    for (const std::string& name : functions)
+    {
+        fmt::format_to(out_it, "{}\n    {}", first ? "" : ",", json_string(name));
+        first = false;
+    }
+    json += "\n  ],\n  \"enums\": {";
+    first = true;
+    for (auto& [name, entries] : enums)
+    {
+        fmt::format_to(out_it, "{}\n    {}: {{", first ? "" : ",", json_string(name));
+        bool first_entry{true};
+        for (auto& [entry, number] : entries)
+        {
+            fmt::format_to(out_it, "{}{}: {}", first_entry ? "" : ", ", json_string(entry), number);
+            first_entry = false;
+        }
+        json += "}";
+        first = false;
+    }
+    json += "\n  }\n}\n";
+    return json;
+}
+
 unsigned int LuaConsole::get_input_lines() const
 {
     int num = 1;
@@ -5,7 +5,7 @@
 #include <functional>      // for equal_to
 #include <imgui.h>         // for ImVec2
 #include <optional>        // for optional
-#include <sol/forward.hpp> // for function
+#include <sol/forward.hpp> // for function, coroutine, thread
 #include <string>          // for string, allocator, hash, basic_string
 #include <string_view>     // for string_view
 #include <type_traits>     // for move, declval
@@ -21,6 +21,25 @@ struct ConsoleHistoryItem
 {
     std::string command;
     std::vector<ScriptMessage> messages;
+    // Output of an async command still streams into this item
+    bool running{false};
+
+    // Size of the command and all messages
+    size_t bytes{0};
+    // Heights of the command and then of every message wrapped at `wrap_width`, messages added later are measured when they come in
+    float wrap_width{0.0f};
+    std::vector<float> heights;
+};
+
+// The command or one message of a history item, at its offset from the top of the results
+struct ConsoleHistoryRow
+{
+    static constexpr size_t COMMAND = static_cast<size_t>(-1);
+
+    size_t item;
+    size_t message;
+    float top;
+    float height;
 };
 
 struct ConsoleResult
@@ -52,24 +71,47 @@ class LuaConsole : public LockableLuaBackend<LuaConsole>
 
     bool has_new_history{false};
     size_t max_history{30};
+    // Old items are dropped when the history holds more than this, the newest one is cut short if it's bigger on its own
+    size_t max_history_bytes{8 * 1024 * 1024};
+    size_t history_bytes{0};
     bool highlight_history{false};
     std::optional<std::size_t> history_pos;
     std::vector<ConsoleHistoryItem> history;
+    // Only the rows in view are drawn, they are laid out again when items come or go or the width changes
+    std::vector<ConsoleHistoryRow> history_rows;
+    float history_height{0.0f};
+    bool history_rows_dirty{true};
 
     std::unordered_map<std::string_view, std::string_view> entity_down_cast_map;
 
+    // Sorted tab-completion candidates, globals are gathered again after a command ran and
+    // usertype members are keyed by their metatable, which never changes once registered
+    std::vector<std::string> global_completions;
+    bool global_completions_dirty{true};
+    std::unordered_map<const void*, std::vector<std::string>> member_completions;
+    std::vector<std::string> table_completions;
+
     std::string completion_options;
     std::string completion_error;
 
+    struct AsyncCommand
+    {
+        sol::thread thread;
+        sol::coroutine coroutine;
+    };
+    std::optional<AsyncCommand> async_command;
+    // Instructions an async command runs per frame before it's suspended until the next one
+    int async_instruction_budget{100000};
+
     ImVec2 pos{0, 0};
     ImVec2 size{0, 0};
 
     void on_history_request(struct ImGuiInputTextCallbackData* data);
     bool on_completion(struct ImGuiInputTextCallbackData* data);
 
-    using LuaBackend::pre_update;
     using LuaBackend::reset;
     virtual bool pre_draw() override;
+    virtual bool pre_update() override;
 
     virtual void set_enabled(bool enable) override
     {
@@ -111,12 +153,23 @@ class LuaConsole : public LockableLuaBackend<LuaConsole>
 
     ConsoleResult execute(std::string str, bool raw = false);
     sol::protected_function_result execute_raw(std::string str);
+    // Runs the code as a coroutine that is resumed once per update, its output streams into a new history item
+    // Returns false if another async command is still running
+    bool execute_async(std::string str);
+    void resume_async();
+    void stop_async();
 
     void toggle();
 
     void push_history(std::string history_item, std::vector<ScriptMessage> result_item);
+    void clear_history();
+    // Drops the oldest items until the history fits both `max_history` and `max_history_bytes`
+    void trim_history();
+    void layout_history(float wrap_width);
 
     std::string dump_api();
+    // All usertypes with their members, global functions and enums of the console environment as one JSON object
+    std::string dump_api_json();
     unsigned int get_input_lines() const;
     void set_geometry(float x, float y, float w, float h)
     {
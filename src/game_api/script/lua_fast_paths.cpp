@@ -0,0 +1,135 @@
+#include "lua_fast_paths.hpp"
+
+#include <cstdint>     // for uint32_t, int32_t
+#include <lua.h>       // for lua_State, lua_gettop, lua_type, lua_pushcclosure
+#include <sol/sol.hpp> // for state, object
+#include <vector>      // for vector
+
+#include "aliases.hpp"            // for ENT_TYPE, LAYER
+#include "entity.hpp"             // for Entity, get_entity_ptr
+#include "entity_lookup.hpp"      // for get_entities_by, get_entities_at, ENTITY_MASK
+#include "render_api.hpp"         // for RenderInfo
+#include "script/lua_backend.hpp" // for LuaBackend
+
+namespace
+{
+// Calls the checked binding this fast path replaced, it's the first upvalue, with all the arguments
+int call_checked(lua_State* L)
+{
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
+bool is_integer(lua_State* L, int index)
+{
+    return lua_type(L, index) == LUA_TNUMBER && lua_tonumber(L, index) == (lua_Number)lua_tointeger(L, index);
+}
+
+void push_uids(lua_State* L, const std::vector<uint32_t>& uids)
+{
+    lua_createtable(L, (int)uids.size(), 0);
+    for (size_t i = 0; i < uids.size(); ++i)
+    {
+        lua_pushinteger(L, uids[i]);
+        lua_rawseti(L, -2, (int)i + 1);
+    }
+}
+
+// A single entity type or a table of them, false for anything sol would have converted differently
+bool read_entity_types(lua_State* L, int index, std::vector<ENT_TYPE>& types)
+{
+    if (is_integer(L, index))
+    {
+        types.push_back((ENT_TYPE)lua_tointeger(L, index));
+        return true;
+    }
+    if (lua_type(L, index) != LUA_TTABLE)
+        return false;
+    const size_t size = static_cast<size_t>(lua_rawlen(L, index));
+    types.reserve(size);
+    for (size_t i = 1; i <= size; ++i)
+    {
+        lua_rawgeti(L, index, (int)i);
+        const bool valid = is_integer(L, -1);
+        types.push_back((ENT_TYPE)lua_tointeger(L, -1));
+        lua_pop(L, 1);
+        if (!valid)
+            return false;
+    }
+    return true;
+}
+
+int get_entity(lua_State* L)
+{
+    if (lua_gettop(L) != 1 || !is_integer(L, 1))
+        return call_checked(L);
+    const sol::object entity = LuaBackend::get_calling_backend()->get_entity_object(get_entity_ptr((uint32_t)lua_tointeger(L, 1)));
+    return entity.push(L);
+}
+
+template <bool Render>
+int get_position(lua_State* L)
+{
+    if (lua_gettop(L) != 1 || !is_integer(L, 1))
+        return call_checked(L);
+    float x{0.0f};
+    float y{0.0f};
+    uint8_t layer{0};
+    if (Entity* ent = get_entity_ptr((int32_t)lua_tointeger(L, 1)))
+    {
+        if (Render && ent->rendering_info != nullptr && !ent->rendering_info->render_inactive)
+        {
+            x = ent->rendering_info->x;
+            y = ent->rendering_info->y;
+        }
+        else
+        {
+            const Vec2 pos = ent->abs_position();
+            x = pos.x;
+            y = pos.y;
+        }
+        layer = ent->layer;
+    }
+    lua_pushnumber(L, x);
+    lua_pushnumber(L, y);
+    lua_pushinteger(L, layer);
+    return 3;
+}
+
+int get_entities_by(lua_State* L)
+{
+    std::vector<ENT_TYPE> types;
+    if (lua_gettop(L) != 3 || !read_entity_types(L, 1, types) || !is_integer(L, 2) || !is_integer(L, 3))
+        return call_checked(L);
+    push_uids(L, ::get_entities_by(std::move(types), (ENTITY_MASK)lua_tointeger(L, 2), (LAYER)lua_tointeger(L, 3)));
+    return 1;
+}
+
+int get_entities_at(lua_State* L)
+{
+    std::vector<ENT_TYPE> types;
+    if (lua_gettop(L) != 6 || !read_entity_types(L, 1, types) || !is_integer(L, 2) || lua_type(L, 3) != LUA_TNUMBER || lua_type(L, 4) != LUA_TNUMBER || !is_integer(L, 5) || lua_type(L, 6) != LUA_TNUMBER)
+        return call_checked(L);
+    push_uids(L, ::get_entities_at(std::move(types), (ENTITY_MASK)lua_tointeger(L, 2), (float)lua_tonumber(L, 3), (float)lua_tonumber(L, 4), (LAYER)lua_tointeger(L, 5), (float)lua_tonumber(L, 6)));
+    return 1;
+}
+
+void replace_global(lua_State* L, const char* name, lua_CFunction fast_path)
+{
+    lua_getglobal(L, name);
+    lua_pushcclosure(L, fast_path, 1);
+    lua_setglobal(L, name);
+}
+} // namespace
+
+void register_fast_paths(sol::state& lua)
+{
+    lua_State* L = lua.lua_state();
+    replace_global(L, "get_entity", &get_entity);
+    replace_global(L, "get_position", &get_position<false>);
+    replace_global(L, "get_render_position", &get_position<true>);
+    replace_global(L, "get_entities_by", &get_entities_by);
+    replace_global(L, "get_entities_at", &get_entities_at);
+}
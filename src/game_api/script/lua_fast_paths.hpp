@@ -0,0 +1,11 @@
+#pragma once
+
+namespace sol
+{
+class state;
+} // namespace sol
+
+// Replaces a few of the most called globals with plain lua_CFunctions that skip the sol2 argument checks and conversions,
+// each one only handles the exact argument types it expects and passes every other call on to the checked binding it replaces
+// Has to be called after everything else is registered, only used when built with SPEL2_LUA_FAST_PATHS
+void register_fast_paths(sol::state& lua);
@@ -0,0 +1,89 @@
+#include "lua_gc.hpp"
+
+#include <algorithm> // for min, max
+#include <lua.h>     // for lua_gc, LUA_GCSTEP, LUA_GCGEN, LUA_GCSTOP, LUA_GCRESTART
+#include <mutex>     // for unique_lock, try_to_lock
+
+#include "frame_telemetry.hpp" // for FrameTelemetry, FramePhaseScope
+#include "lua_idle.hpp"        // for LuaIdleScheduler
+#include "lua_vm.hpp"          // for global_lua_lock
+
+namespace
+{
+// Below this the heap is small enough to not bother stepping every time it grows
+constexpr size_t g_min_base_kb = 4 * 1024;
+
+size_t get_heap_kb(lua_State* L)
+{
+    return static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0));
+}
+} // namespace
+
+LuaGcScheduler& LuaGcScheduler::get()
+{
+    static LuaGcScheduler scheduler;
+    return scheduler;
+}
+
+void LuaGcScheduler::init(lua_State* L)
+{
+    state = L;
+    lua_gc(L, LUA_GCGEN, 0, 0);
+    set_automatic(false);
+    base_kb = get_heap_kb(L);
+}
+
+void LuaGcScheduler::set_automatic(bool enable)
+{
+    // Checked against the vm every time, scripts and the benchmarks can stop and restart the collector themselves
+    if (enable != (lua_gc(state, LUA_GCISRUNNING, 0) != 0))
+        lua_gc(state, enable ? LUA_GCRESTART : LUA_GCSTOP, 0);
+}
+
+void LuaGcScheduler::after_present()
+{
+    if (state == nullptr)
+        return;
+    // Don't wait on a script that is running on another thread, the heap is checked again after the next present
+    std::unique_lock lock{global_lua_lock, std::try_to_lock};
+    if (!lock.owns_lock())
+        return;
+
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        set_automatic(true);
+        last_stats.last_ms = 0.0f;
+        last_stats.last_steps = 0;
+        return;
+    }
+
+    FramePhaseScope phase{FRAME_PHASE::LUA_GC};
+    const size_t heap_kb = get_heap_kb(state);
+    const size_t base = std::max(base_kb, g_min_base_kb);
+    const size_t growth = heap_kb > base ? (heap_kb - base) * 100 / base : 0;
+    const float budget_ms = std::min(LuaIdleScheduler::get().get_slack_us() / 1000.0f, MAX_BUDGET_MS);
+
+    last_stats.last_ms = 0.0f;
+    last_stats.last_steps = 0;
+    // The first step has no average yet, it only runs once there is the whole budget
+    const float expected_ms = average_step_ms == 0.0f ? MAX_BUDGET_MS : average_step_ms;
+    if (growth >= STEP_GROWTH && expected_ms <= budget_ms)
+    {
+        const int64_t start = FrameTelemetry::now();
+        lua_gc(state, LUA_GCSTEP, 0);
+        const float step_ms = FrameTelemetry::ticks_to_ms(FrameTelemetry::now() - start);
+        average_step_ms = average_step_ms == 0.0f ? step_ms : average_step_ms * 0.9f + step_ms * 0.1f;
+
+        base_kb = get_heap_kb(state);
+        last_stats.last_ms = step_ms;
+        last_stats.last_steps = 1;
+        last_stats.total_steps++;
+    }
+    last_stats.heap_kb = get_heap_kb(state);
+
+    // The frames are too busy for the steps to keep up, let the callbacks collect until there is slack again
+    const bool fall_back = growth >= FALLBACK_GROWTH && last_stats.last_steps == 0;
+    if (fall_back)
+        last_stats.fallback_frames++;
+    set_automatic(fall_back);
+}
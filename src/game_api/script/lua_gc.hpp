@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>  // for atomic
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t, uint32_t, uint64_t
+
+struct lua_State;
+
+struct LuaGcStats
+{
+    // Time the steps after the last present took
+    float last_ms{0.0f};
+    uint32_t last_steps{0};
+    // Heap of the shared vm after the last step, in KB
+    size_t heap_kb{0};
+    uint64_t total_steps{0};
+    // Frames the automatic collection had to be turned back on for, callbacks could collect during those
+    uint64_t fallback_frames{0};
+};
+
+// Keeps the collector of the shared vm from running in the middle of callbacks, it's stopped and stepped right after
+// the frame was presented instead, as long as a step fits into the time left until the next frame is due
+// The vm runs in generational mode, where a step is a whole young collection, so the steps are spread out by heap growth
+// If the heap outgrows the steps anyway the automatic collection is turned on again until the steps catch up
+class LuaGcScheduler
+{
+  public:
+    // Most time spent stepping after a single present
+    static constexpr float MAX_BUDGET_MS = 2.0f;
+    // Growth since the last step, in percent of the heap, a step is taken at
+    static constexpr size_t STEP_GROWTH = 20;
+    // Growth at which the automatic collection is turned back on, the frames didn't leave enough slack for the steps
+    static constexpr size_t FALLBACK_GROWTH = 100;
+
+    static LuaGcScheduler& get();
+
+    // Switches the vm to generational mode and stops its automatic collection
+    void init(lua_State* L);
+    // Runs before ON.IDLE, which gets whatever slack the step left over
+    void after_present();
+
+    const LuaGcStats& stats() const
+    {
+        return last_stats;
+    }
+
+    std::atomic<bool> enabled{true};
+
+  private:
+    LuaGcScheduler() = default;
+
+    void set_automatic(bool enable);
+
+    lua_State* state{nullptr};
+    LuaGcStats last_stats;
+    size_t base_kb{0};
+    // Moving average of a single step, so no step is started that won't fit the slack
+    float average_step_ms{0.0f};
+};
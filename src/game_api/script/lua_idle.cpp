@@ -0,0 +1,83 @@
+#include "lua_idle.hpp"
+
+#include <algorithm> // for max
+#include <mutex>     // for unique_lock, try_to_lock
+#include <vector>    // for vector
+
+#include "frame_limiter.hpp"   // for FrameLimiter
+#include "frame_telemetry.hpp" // for FrameTelemetry
+#include "lua_backend.hpp"     // for LuaBackend, BackendEvent
+#include "lua_vm.hpp"          // for global_lua_lock
+#include "rpc.hpp"             // for get_frametime
+
+LuaIdleScheduler& LuaIdleScheduler::get()
+{
+    static LuaIdleScheduler scheduler;
+    return scheduler;
+}
+
+void LuaIdleScheduler::frame_started()
+{
+    frame_start = FrameTelemetry::now();
+}
+
+float LuaIdleScheduler::get_slack_us() const
+{
+    const double target = FrameLimiter::get().get_target().value_or(get_frametime());
+    if (frame_start == 0 || target <= 0.0)
+        return 0.0f;
+    const float frame_us = FrameTelemetry::ticks_to_ms(FrameTelemetry::now() - frame_start) * 1000.0f;
+    return std::max(static_cast<float>(target * 1000000.0) - frame_us - RESERVE_US, 0.0f);
+}
+
+void LuaIdleScheduler::after_present()
+{
+    last_stats.slack_us = 0.0f;
+    last_stats.used_us = 0.0f;
+    last_stats.backends_run = 0;
+    last_stats.backends_skipped = 0;
+    const double target = FrameLimiter::get().get_target().value_or(get_frametime());
+    if (frame_start == 0 || target <= 0.0)
+        return;
+
+    // Like the collector, don't wait on a script that is running on another thread
+    std::unique_lock lock{global_lua_lock, std::try_to_lock};
+    if (!lock.owns_lock())
+        return;
+    std::vector<LuaBackend::LockedBackend> backends = LuaBackend::lock_subscribers(BackendEvent::IDLE);
+    if (backends.empty())
+        return;
+
+    const int64_t now = FrameTelemetry::now();
+    const float frame_us = FrameTelemetry::ticks_to_ms(now - frame_start) * 1000.0f;
+    const float slack_us = static_cast<float>(target * 1000000.0) - frame_us;
+    last_stats.slack_us = std::max(slack_us, 0.0f);
+    if (slack_us - RESERVE_US < MIN_SLACK_US)
+    {
+        last_stats.busy_frames++;
+        return;
+    }
+
+    const int64_t deadline = now + FrameTelemetry::ms_to_ticks((slack_us - RESERVE_US) / 1000.0f);
+    const size_t first = first_backend++ % backends.size();
+    for (size_t i = 0; i < backends.size(); ++i)
+    {
+        LuaBackend::LockedBackend& backend = backends[(first + i) % backends.size()];
+        const float remaining_us = FrameTelemetry::ticks_to_ms(deadline - FrameTelemetry::now()) * 1000.0f;
+        if (remaining_us < MIN_SLACK_US)
+            break;
+        if (backend->idle_average_us > remaining_us)
+        {
+            backend->idle_average_us *= SKIP_DECAY;
+            last_stats.backends_skipped++;
+            continue;
+        }
+
+        const int64_t start = FrameTelemetry::now();
+        backend->process_idle_callbacks(deadline);
+        const float used_us = FrameTelemetry::ticks_to_ms(FrameTelemetry::now() - start) * 1000.0f;
+        backend->idle_average_us = backend->idle_average_us == 0.0f ? used_us : backend->idle_average_us * 0.9f + used_us * 0.1f;
+        last_stats.used_us += used_us;
+        last_stats.backends_run++;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t, uint32_t, uint64_t
+
+struct LuaIdleStats
+{
+    // Time left until the next frame is due when present returned, in microseconds, 0 if the frame was late
+    float slack_us{0.0f};
+    // Time the ON.IDLE callbacks took after the last present
+    float used_us{0.0f};
+    uint32_t backends_run{0};
+    // Backends passed over after the last present, their callbacks usually take longer than what was left of the slack
+    uint32_t backends_skipped{0};
+    // Frames that had no slack left for any callback
+    uint64_t busy_frames{0};
+};
+
+// Drives ON.IDLE after the frame was presented, with the time left until the next frame is due as measured from the start
+// of the game loop and the frame target of the frame limiter or get_frametime, nothing runs while the frame rate is uncapped
+// The backends take turns going first, and one is only called if its callbacks usually fit into what's left of the slack
+class LuaIdleScheduler
+{
+  public:
+    // Kept free of every slack, so the wait for the next frame still wakes up in time
+    static constexpr float RESERVE_US = 1000.0f;
+    // Slack below which the callbacks aren't worth calling
+    static constexpr float MIN_SLACK_US = 250.0f;
+    // A skipped backend isn't measured, so its average shrinks by this on every skip until it fits a frame again
+    static constexpr float SKIP_DECAY = 0.9f;
+
+    static LuaIdleScheduler& get();
+
+    // Called when the game loop starts working on a frame, right after it waited for it
+    void frame_started();
+    void after_present();
+    // Time left until the next frame is due, not counting the reserve, 0 while there is no frame target or the frame is late
+    float get_slack_us() const;
+
+    const LuaIdleStats& stats() const
+    {
+        return last_stats;
+    }
+
+  private:
+    LuaIdleScheduler() = default;
+
+    int64_t frame_start{0};
+    // Which subscriber goes first after the next present
+    size_t first_backend{0};
+    LuaIdleStats last_stats;
+};
@@ -0,0 +1,166 @@
+#include "lua_jobs.hpp"
+
+#include <algorithm>     // for clamp
+#include <chrono>        // for steady_clock
+#include <exception>     // for exception
+#include <stdexcept>     // for runtime_error
+#include <lauxlib.h>     // for luaL_error
+#include <lua.h>         // for lua_State, lua_settop, lua_gettop, lua_sethook
+#include <sol/sol.hpp>   // for state, protected_function, table
+#include <system_error>  // for error_code
+#include <thread>        // for thread
+#include <unordered_map> // for unordered_map
+#include <utility>       // for move
+
+#include "lua_libs/lua_libs.hpp" // for require_json_lua, require_binser_lua
+#include "lua_libs/lua_pack.hpp" // for pack_lua_value, unpack_lua_value
+#include "thread_policy.hpp"     // for ServiceThreads, THREAD_POOL
+
+namespace
+{
+// Every worker runs one job at a time on its own state, so the limits of the running one can live with the thread
+thread_local std::chrono::steady_clock::time_point g_job_deadline;
+thread_local const std::atomic_bool* g_job_cancel{nullptr};
+
+// Jobs are stopped from the count hook, a pure Lua loop can't keep the worker past its deadline
+void job_limit_hook(lua_State* L, lua_Debug*)
+{
+    if (g_job_cancel != nullptr && g_job_cancel->load(std::memory_order_relaxed))
+        luaL_error(L, "job was cancelled");
+    if (std::chrono::steady_clock::now() > g_job_deadline)
+        luaL_error(L, "job timed out");
+}
+
+// The Lua state of a worker thread with the modules it loaded
+class JobState
+{
+  public:
+    JobState()
+    {
+        lua.open_libraries(sol::lib::base, sol::lib::math, sol::lib::string, sol::lib::table, sol::lib::utf8);
+        // Base opens files too
+        lua["dofile"] = sol::lua_nil;
+        lua["loadfile"] = sol::lua_nil;
+        require_json_lua(lua);
+        require_binser_lua(lua);
+        lua_sethook(lua.lua_state(), &job_limit_hook, LUA_MASKCOUNT, 10000);
+    }
+
+    LuaJobResult run(const std::filesystem::path& module, const std::string& fun, const std::string& data)
+    {
+        lua_State* L = lua.lua_state();
+        const int top = lua_gettop(L);
+        try
+        {
+            sol::protected_function function = load(module)[fun];
+            if (!function.valid())
+                return {false, "module '" + module.string() + "' has no function '" + fun + "'"};
+
+            unpack_lua_value(L, data);
+            sol::object argument = sol::stack::pop<sol::object>(L);
+            sol::protected_function_result result = function(argument);
+            if (!result.valid())
+            {
+                sol::error error = result;
+                lua_settop(L, top);
+                return {false, error.what()};
+            }
+            sol::object value = result;
+            value.push(L);
+            std::string packed = pack_lua_value(L, -1);
+            lua_settop(L, top);
+            return {true, std::move(packed)};
+        }
+        catch (const std::exception& err)
+        {
+            lua_settop(L, top);
+            return {false, err.what()};
+        }
+    }
+
+  private:
+    struct Module
+    {
+        std::filesystem::file_time_type write_time;
+        sol::table exports;
+    };
+
+    sol::table load(const std::filesystem::path& path)
+    {
+        std::error_code ec;
+        const auto write_time = std::filesystem::last_write_time(path, ec);
+        const std::string key = path.string();
+        auto it = modules.find(key);
+        if (it != modules.end() && it->second.write_time == write_time)
+            return it->second.exports;
+
+        sol::protected_function_result result = lua.safe_script_file(key, sol::script_pass_on_error);
+        if (!result.valid())
+        {
+            sol::error error = result;
+            throw std::runtime_error{error.what()};
+        }
+        sol::object exports = result;
+        if (!exports.is<sol::table>())
+            throw std::runtime_error{"module '" + key + "' doesn't return a table"};
+        modules[key] = Module{write_time, exports.as<sol::table>()};
+        return modules[key].exports;
+    }
+
+    sol::state lua;
+    std::unordered_map<std::string, Module> modules;
+};
+} // namespace
+
+LuaJobPool& LuaJobPool::get()
+{
+    // Never destroyed, the detached workers may still be waiting on it while statics are torn down
+    static LuaJobPool* pool = new LuaJobPool();
+    return *pool;
+}
+
+std::future<LuaJobResult> LuaJobPool::submit(std::filesystem::path module, std::string fun, std::string data, std::chrono::milliseconds timeout, std::shared_ptr<std::atomic_bool> cancel)
+{
+    std::future<LuaJobResult> result;
+    {
+        std::lock_guard guard{lock};
+        Job& queued = jobs.emplace_back(Job{std::move(module), std::move(fun), std::move(data), timeout, std::move(cancel), {}});
+        result = queued.result.get_future();
+        if (!started)
+        {
+            started = true;
+            // Leaves cores for the game and the other workers
+            const unsigned num_workers = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MAX_WORKERS);
+            for (unsigned i = 0; i < num_workers; ++i)
+                std::thread(&LuaJobPool::work, this).detach();
+        }
+    }
+    wake.notify_one();
+    return result;
+}
+
+void LuaJobPool::work()
+{
+    ServiceThreads::get().register_current("LuaJobWorker", THREAD_POOL::WORKER);
+    JobState state;
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock guard{lock};
+            wake.wait(guard, [this]
+                      { return !jobs.empty(); });
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        if (job.cancel->load(std::memory_order_relaxed))
+        {
+            job.result.set_value({false, "job was cancelled"});
+            continue;
+        }
+        g_job_deadline = std::chrono::steady_clock::now() + job.timeout;
+        g_job_cancel = job.cancel.get();
+        job.result.set_value(state.run(job.module, job.fun, job.data));
+        g_job_cancel = nullptr;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>             // for atomic_bool
+#include <chrono>             // for milliseconds
+#include <condition_variable> // for condition_variable
+#include <deque>              // for deque
+#include <filesystem>         // for path
+#include <future>             // for future, promise
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <string>             // for string
+
+struct LuaJobResult
+{
+    bool success{false};
+    // Packed return value of the job function, or the error message
+    std::string data;
+};
+
+// Worker threads for scripts, each one with its own Lua state that only has the pure libraries, no game API and no files or os,
+// so a job can't touch anything the game thread uses. Arguments and results cross over in the binser format
+class LuaJobPool
+{
+  public:
+    static constexpr unsigned MAX_WORKERS = 4;
+    // How long a job may run when the script doesn't say, so a job that never returns can't hold a worker forever
+    static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT{10000};
+
+    static LuaJobPool& get();
+
+    LuaJobPool(const LuaJobPool&) = delete;
+    LuaJobPool& operator=(const LuaJobPool&) = delete;
+
+    // Calls `fun` of the table returned by the module file with the unpacked `data`, the module is loaded once per worker
+    // and again when the file changed. The job fails once it ran longer than `timeout` or when `cancel` is set, queued or running
+    std::future<LuaJobResult> submit(std::filesystem::path module, std::string fun, std::string data, std::chrono::milliseconds timeout, std::shared_ptr<std::atomic_bool> cancel);
+
+  private:
+    LuaJobPool() = default;
+
+    struct Job
+    {
+        std::filesystem::path module;
+        std::string fun;
+        std::string data;
+        std::chrono::milliseconds timeout;
+        std::shared_ptr<std::atomic_bool> cancel;
+        std::promise<LuaJobResult> result;
+    };
+
+    void work();
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    bool started{false};
+};
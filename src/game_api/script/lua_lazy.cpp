@@ -0,0 +1,68 @@
+#include "lua_lazy.hpp"
+
+#include <functional>    // for equal_to, hash
+#include <sol/sol.hpp>   // for state, table, object, metatable_key
+#include <string_view>   // for string_view
+#include <unordered_map> // for unordered_map
+#include <utility>       // for move
+
+namespace
+{
+struct LazyModule
+{
+    std::function<void(sol::state&)> register_fun;
+    bool registered{false};
+};
+
+// Lets `lazy_global_index` look up the key as a view into the lua string, every undefined global read goes through it
+struct LazyNameHash
+{
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const
+    {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+std::vector<LazyModule> g_lazy_modules;
+std::unordered_map<std::string, size_t, LazyNameHash, std::equal_to<>> g_lazy_lookup;
+sol::state* g_lazy_vm{nullptr};
+} // namespace
+
+void register_lazy_globals(sol::state& lua, std::vector<std::string> globals, std::function<void(sol::state&)> register_fun)
+{
+    if (g_lazy_vm == nullptr)
+    {
+        g_lazy_vm = &lua;
+        sol::table globals_meta = lua.create_table();
+        globals_meta["__index"] = &lazy_global_index;
+        lua.globals()[sol::metatable_key] = globals_meta;
+    }
+
+    const size_t index = g_lazy_modules.size();
+    g_lazy_modules.push_back({std::move(register_fun)});
+    for (std::string& name : globals)
+        g_lazy_lookup[std::move(name)] = index;
+}
+
+sol::object lazy_global_index(sol::table env, sol::object key)
+{
+    if (key.get_type() != sol::type::string)
+        return sol::lua_nil;
+    auto it = g_lazy_lookup.find(key.as<std::string_view>());
+    if (it == g_lazy_lookup.end())
+        return sol::lua_nil;
+
+    sol::state& lua = *g_lazy_vm;
+    LazyModule& module = g_lazy_modules[it->second];
+    if (!module.registered)
+    {
+        // Set first so reading another of its globals while registering doesn't run it again
+        module.registered = true;
+        module.register_fun(lua);
+    }
+
+    sol::object value = lua.globals().raw_get<sol::object>(key);
+    env.raw_set(key, value);
+    return value;
+}
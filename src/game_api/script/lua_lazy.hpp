@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>      // for function
+#include <sol/forward.hpp> // for object, table
+#include <string>          // for string
+#include <vector>          // for vector
+
+namespace sol
+{
+class state;
+} // namespace sol
+
+// Runs `register_fun` the first time one of `globals` is read, instead of when the vm is created
+// Only for modules that define nothing but these globals and whose usertypes can only be reached through them,
+// an object of a usertype that isn't registered yet would get pushed without its methods
+void register_lazy_globals(sol::state& lua, std::vector<std::string> globals, std::function<void(sol::state&)> register_fun);
+// __index of _G and the script environments, registers the module of `key` if it's a lazy global and copies the value into `env`
+sol::object lazy_global_index(sol::table env, sol::object key);
@@ -0,0 +1,206 @@
+#include "lua_memory.hpp"
+
+#include <algorithm>     // for min
+#include <array>         // for array
+#include <cstdlib>       // for malloc, free, realloc
+#include <cstring>       // for memcpy
+#include <lauxlib.h>     // for luaL_error
+#include <lua.h>         // for lua_sethook, LUA_MASKCOUNT
+#include <memory>        // for unique_ptr, make_unique
+#include <mutex>         // for mutex, lock_guard
+#include <unordered_map> // for unordered_map
+
+#include "lua_sampler.hpp" // for lua_instruction_hook
+
+namespace
+{
+// Every block starts with the account it's charged to, so frees and reallocs from any other script credit the right one
+struct alignas(16) BlockHeader
+{
+    LuaMemoryAccount* account;
+    size_t size;
+};
+static_assert(sizeof(BlockHeader) == 16);
+
+constexpr size_t g_class_step = 16;
+// Blocks up to this size including the header come from the pools, most Lua objects are a lot smaller
+constexpr size_t g_max_pooled = 256;
+constexpr size_t g_num_classes = g_max_pooled / g_class_step;
+constexpr size_t g_chunk_size = 64 * 1024;
+
+struct FreeBlock
+{
+    FreeBlock* next;
+};
+// The vm is only used by one thread at a time, so the pools aren't locked
+std::array<FreeBlock*, g_num_classes> g_free_blocks{};
+
+LuaMemoryAccount g_shared_account;
+LuaMemoryAccount* g_current_account{nullptr};
+lua_State* g_vm{nullptr};
+bool g_limit_check_requested{false};
+
+void request_limit_check()
+{
+    if (g_limit_check_requested || g_vm == nullptr)
+        return;
+    g_limit_check_requested = true;
+    // Safe to set from anywhere, it's what the standalone interpreter does from its signal handler
+    lua_sethook(g_vm, lua_instruction_hook, LUA_MASKCOUNT, 1);
+}
+
+size_t block_size(size_t size)
+{
+    const size_t total = size + sizeof(BlockHeader);
+    return total <= g_max_pooled ? (total + g_class_step - 1) / g_class_step * g_class_step : total;
+}
+bool is_pooled(size_t block)
+{
+    return block <= g_max_pooled;
+}
+
+BlockHeader* allocate_block(size_t block)
+{
+    if (!is_pooled(block))
+        return static_cast<BlockHeader*>(std::malloc(block));
+
+    FreeBlock*& free_list = g_free_blocks[block / g_class_step - 1];
+    if (free_list == nullptr)
+    {
+        // Chunks are never given back, the pools only grow to the most the vm has used at once
+        char* chunk = static_cast<char*>(std::malloc(g_chunk_size));
+        if (chunk == nullptr)
+            return nullptr;
+        for (size_t offset = 0; offset + block <= g_chunk_size; offset += block)
+        {
+            FreeBlock* free_block = reinterpret_cast<FreeBlock*>(chunk + offset);
+            free_block->next = free_list;
+            free_list = free_block;
+        }
+    }
+    FreeBlock* free_block = free_list;
+    free_list = free_block->next;
+    return reinterpret_cast<BlockHeader*>(free_block);
+}
+void free_block(BlockHeader* header, size_t block)
+{
+    if (!is_pooled(block))
+    {
+        std::free(header);
+        return;
+    }
+    FreeBlock*& free_list = g_free_blocks[block / g_class_step - 1];
+    FreeBlock* freed = reinterpret_cast<FreeBlock*>(header);
+    freed->next = free_list;
+    free_list = freed;
+}
+} // namespace
+
+bool LuaMemoryAccount::charge(size_t bytes)
+{
+    const size_t now = used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (now > peak.load(std::memory_order_relaxed))
+        peak.store(now, std::memory_order_relaxed);
+    const size_t max = limit.load(std::memory_order_relaxed);
+    return max == 0 || now <= max;
+}
+
+void* lua_memory_alloc(void*, void* ptr, size_t, size_t new_size)
+{
+    if (ptr == nullptr)
+    {
+        if (new_size == 0)
+            return nullptr;
+        LuaMemoryAccount* account = g_current_account != nullptr ? g_current_account : &g_shared_account;
+        if (!account->charge(new_size))
+            request_limit_check();
+        BlockHeader* header = allocate_block(block_size(new_size));
+        if (header == nullptr)
+        {
+            account->release(new_size);
+            return nullptr;
+        }
+        header->account = account;
+        header->size = new_size;
+        return header + 1;
+    }
+
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    LuaMemoryAccount* account = header->account;
+    const size_t old_size = header->size;
+    const size_t old_block = block_size(old_size);
+    if (new_size == 0)
+    {
+        account->release(old_size);
+        free_block(header, old_block);
+        return nullptr;
+    }
+
+    // Lua expects shrinking to never fail, so those keep the block if a smaller one can't be had
+    if (new_size > old_size && !account->charge(new_size - old_size))
+        request_limit_check();
+    const size_t new_block = block_size(new_size);
+    if (new_block != old_block)
+    {
+        BlockHeader* moved = nullptr;
+        if (!is_pooled(old_block) && !is_pooled(new_block))
+        {
+            moved = static_cast<BlockHeader*>(std::realloc(header, new_block));
+        }
+        else if ((moved = allocate_block(new_block)) != nullptr)
+        {
+            std::memcpy(moved + 1, header + 1, std::min(old_size, new_size));
+            free_block(header, old_block);
+        }
+
+        if (moved == nullptr && new_size > old_size)
+        {
+            account->release(new_size - old_size);
+            return nullptr;
+        }
+        if (moved != nullptr)
+            header = moved;
+    }
+    if (new_size < old_size)
+        account->release(old_size - new_size);
+    header->account = account;
+    header->size = new_size;
+    return header + 1;
+}
+
+LuaMemoryAccount& get_lua_memory_account(const std::string& script_path)
+{
+    static std::mutex accounts_mutex;
+    static std::unordered_map<std::string, std::unique_ptr<LuaMemoryAccount>> accounts;
+    std::lock_guard lock{accounts_mutex};
+    auto& account = accounts[script_path];
+    if (!account)
+        account = std::make_unique<LuaMemoryAccount>();
+    return *account;
+}
+LuaMemoryAccount& get_shared_lua_memory_account()
+{
+    return g_shared_account;
+}
+void set_current_lua_memory_account(LuaMemoryAccount* account)
+{
+    g_current_account = account;
+}
+LuaMemoryAccount* get_current_lua_memory_account()
+{
+    return g_current_account;
+}
+
+void set_lua_memory_vm(lua_State* L)
+{
+    g_vm = L;
+}
+void check_lua_memory_limit(lua_State* L)
+{
+    g_limit_check_requested = false;
+    LuaMemoryAccount* account = g_current_account;
+    if (account == nullptr || !account->over_limit())
+        return;
+    account->denied.fetch_add(1, std::memory_order_relaxed);
+    luaL_error(L, "not enough memory, the script is over its limit of %d KB", static_cast<int>(account->limit.load(std::memory_order_relaxed) / 1024));
+}
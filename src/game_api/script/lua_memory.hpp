@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>  // for atomic, memory_order_relaxed
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <string>  // for string
+
+struct lua_State;
+
+// Bytes of Lua memory allocated while a script was running, written by the vm's thread and read by the ui
+struct LuaMemoryAccount
+{
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> peak{0};
+    // 0 for no limit, a script that goes over it gets a Lua memory error at its next instruction
+    std::atomic<size_t> limit{0};
+    // Memory errors raised because of the limit
+    std::atomic<uint64_t> denied{0};
+
+    // Returns false if this went over the limit, the allocation still succeeds
+    bool charge(size_t bytes);
+    void release(size_t bytes)
+    {
+        used.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    bool over_limit() const
+    {
+        const size_t max = limit.load(std::memory_order_relaxed);
+        return max != 0 && used.load(std::memory_order_relaxed) > max;
+    }
+};
+
+// Allocator of the shared vm, charges new allocations to the current account and keeps small blocks in size-class pools
+// It never fails because of a limit, an allocation can come from C++ pushing to the stack outside of any protected call where
+// a memory error would be a panic, so going over only makes the count hook run on the next instruction and raise the error there
+void* lua_memory_alloc(void* user_data, void* ptr, size_t old_size, size_t new_size);
+// The main thread of the vm, where the allocator asks for the limit to be checked, coroutines check at their next regular hook
+void set_lua_memory_vm(lua_State* L);
+// Called from the count hook, raises the memory error if the current account is over its limit
+void check_lua_memory_limit(lua_State* L);
+
+// Accounts are never destroyed, objects a script allocated can be freed by the garbage collector long after it was unloaded
+LuaMemoryAccount& get_lua_memory_account(const std::string& script_path);
+// Everything allocated while no script is running, like the usertypes and shared modules
+LuaMemoryAccount& get_shared_lua_memory_account();
+// Set while a backend runs, nullptr for the shared account
+void set_current_lua_memory_account(LuaMemoryAccount* account);
+LuaMemoryAccount* get_current_lua_memory_account();
+
+// Charges everything allocated in its scope to `account`
+struct LuaMemoryScope
+{
+    LuaMemoryScope(LuaMemoryAccount* account)
+        : previous{get_current_lua_memory_account()}
+    {
+        set_current_lua_memory_account(account);
+    }
+    ~LuaMemoryScope()
+    {
+        set_current_lua_memory_account(previous);
+    }
+
+    LuaMemoryAccount* previous;
+};
@@ -5,19 +5,21 @@
 #include <filesystem>    // for path, operator==, exists, operator/, _Pat...
 #include <fmt/format.h>  // for check_format_string, format, vformat
 #include <fstream>       // for filesystem
-#include <lauxlib.h>     // for luaL_loadfilex
-#include <lua.h>         // for lua_setupvalue, lua_State, LUA_OK
+#include <lua.h>         // for lua_setupvalue, lua_State, LUA_OK, lua_pop
 #include <new>           // for operator new
 #include <optional>      // for optional, nullopt
 #include <sol/sol.hpp>   // for proxy_key_t, table_proxy, state, protecte...
 #include <string_view>   // for string_view
 #include <tuple>         // for get
 #include <type_traits>   // for move, declval, conditional_t, forward
+#include <unordered_map> // for unordered_map
 #include <unordered_set> // for unordered_set
 #include <utility>       // for min, max, pair, tuple_element<>::type
 
-#include "lua_backend.hpp" // for LuaBackend
-#include "lua_vm.hpp"      // for get_lua_vm
+#include "lua_backend.hpp"        // for LuaBackend
+#include "lua_bytecode_cache.hpp" // for load_cached_lua_file
+#include "lua_lazy.hpp"           // for lazy_global_index
+#include "lua_vm.hpp"             // for get_lua_vm, populate_lua_env, expose_unsafe_libraries
 
 void register_custom_require(sol::state& lua)
 {
@@ -28,8 +30,90 @@ void register_custom_require(sol::state& lua)
 
     /// Custom implementation to trick Lua into allowing to `require 'lib.module'` more than once given it was called from a different source
     lua["require"] = custom_require;
+    /// Same as `require`, but the module is only loaded once for all scripts and every script gets a read-only view of the same result
+    /// Only for modules that don't depend on the script requiring them, they see the global environment instead of the script's
+    lua["require_shared"] = custom_require_shared;
+
+    lua["__make_read_only"] = lua.safe_script(R"(
+return function(name, t)
+    if type(t) ~= "table" then
+        return t
+    end
+    return setmetatable({}, {
+        __index = t,
+        __newindex = function()
+            error("Module '" .. name .. "' is shared between scripts and can't be modified", 2)
+        end,
+        __pairs = function()
+            return next, t, nil
+        end,
+        __len = function()
+            return #t
+        end,
+        __metatable = false,
+    })
+end
+)");
 }
-sol::object custom_require(std::string path)
+
+namespace
+{
+struct SharedModule
+{
+    std::filesystem::file_time_type write_time;
+    sol::object result;
+};
+
+sol::object load_shared_module(const std::filesystem::path& file, const std::string& name, bool unsafe)
+{
+    static sol::state& lua = get_lua_vm();
+    static std::unordered_map<std::string, SharedModule> shared_modules;
+
+    // Safe and unsafe scripts get separate copies, a module loaded for an unsafe script can see the unsafe libraries
+    std::error_code ec;
+    const std::string key = std::filesystem::absolute(file, ec).lexically_normal().string() + (unsafe ? "|unsafe" : "");
+    const auto write_time = std::filesystem::last_write_time(file, ec);
+    if (auto it = shared_modules.find(key); it != shared_modules.end() && it->second.write_time == write_time)
+    {
+        return it->second.result;
+    }
+
+    lua_State* L = lua.lua_state();
+    if (load_cached_lua_file(L, file.string()) != LUA_OK)
+    {
+        std::string error = sol::stack::pop<std::string>(L);
+        throw sol::error(error);
+    }
+    sol::protected_function chunk(L, -1);
+    lua_pop(L, 1);
+
+    // Same environment a script gets, globals the module defines stay in there so they can't leak into any script
+    sol::environment env(lua, sol::create);
+    populate_lua_env(env);
+    sol::table env_meta = lua.create_table();
+    env_meta["__index"] = &lazy_global_index;
+    env[sol::metatable_key] = env_meta;
+    if (unsafe)
+    {
+        expose_unsafe_libraries(env);
+    }
+    sol::set_environment(env, chunk);
+    sol::protected_function_result result = chunk(name);
+    if (!result.valid())
+    {
+        sol::error e = result;
+        throw e;
+    }
+
+    sol::object module = result.get_type() == sol::type::none || result.get_type() == sol::type::nil
+                             ? sol::make_object(lua, true)
+                             : result.get<sol::object>();
+    sol::object read_only = lua["__make_read_only"](name, module);
+    shared_modules[key] = {write_time, read_only};
+    return read_only;
+}
+
+sol::object require_impl(std::string path, bool shared)
 {
     // Turn module into a real path
     {
@@ -111,6 +195,7 @@ return info.short_src, info.source
 
     auto require = [&](std::string _path)
     {
+        const fs::path file{_path};
         if (_path.ends_with(".lua") || _path.ends_with(".dll"))
         {
             _path = _path.substr(0, _path.size() - 4);
@@ -118,9 +203,15 @@ return info.short_src, info.source
         std::replace(_path.begin(), _path.end(), '.', ':'); // Need to be able to recover periods in folder names, curses garebear
         std::replace(_path.begin(), _path.end(), '/', '.');
         std::replace(_path.begin(), _path.end(), '\\', '.');
-        backend->loaded_modules.insert(_path);
+        // Keeps the time of the first load, that's the version package.loaded still holds
+        std::error_code ec;
+        backend->loaded_modules.try_emplace(_path, LoadedModule{file, fs::last_write_time(file, ec)});
         return lua["__require"](_path);
     };
+    auto require_shared = [&](const fs::path& _path)
+    {
+        return load_shared_module(_path, _path.stem().string(), unsafe);
+    };
     auto require_if_exists = [&](fs::path _path) -> std::optional<sol::object>
     {
         if (!unsafe && !is_sub_path(backend_root, _path))
@@ -130,9 +221,11 @@ return info.short_src, info.source
 
         if (fs::exists(_path.replace_extension(".lua")))
         {
+            if (shared)
+                return require_shared(_path);
             return require(_path.string());
         }
-        else if (unsafe && fs::exists(_path.replace_extension(".dll")))
+        else if (!shared && unsafe && fs::exists(_path.replace_extension(".dll")))
         {
             return require(_path.string());
         }
@@ -141,6 +234,8 @@ return info.short_src, info.source
             _path.replace_extension() /= "init";
             if (fs::exists(_path.replace_extension(".lua")))
             {
+                if (shared)
+                    return require_shared(_path);
                 return require(_path.string());
             }
         }
@@ -174,6 +269,16 @@ return info.short_src, info.source
 
     return std::move(res).value_or(sol::nil);
 }
+} // namespace
+
+sol::object custom_require(std::string path)
+{
+    return require_impl(std::move(path), false);
+}
+sol::object custom_require_shared(std::string path)
+{
+    return require_impl(std::move(path), true);
+}
 int custom_loader(lua_State* L)
 {
     std::string path = sol::stack::get<std::string>(L, 1);
@@ -184,7 +289,7 @@ int custom_loader(lua_State* L)
     auto try_load = [&](std::string& _path, std::string_view ext)
     {
         _path += ext;
-        const auto res = luaL_loadfilex(L, _path.c_str(), "bt");
+        const auto res = load_cached_lua_file(L, _path);
         if (res == LUA_OK)
         {
             backend->lua.push();
@@ -11,4 +11,6 @@ class state;
 // This implementation makes the loaded chunk inherit the env from the loading chunk
 void register_custom_require(sol::state& lua);
 sol::object custom_require(std::string path);
+// Loads the module once into the shared vm and returns a read-only view of its result to every backend
+sol::object custom_require_shared(std::string path);
 int custom_loader(struct lua_State* L);
@@ -0,0 +1,96 @@
+#include "lua_sampler.hpp"
+
+#include <algorithm>     // for replace
+#include <cstdint>       // for uint64_t
+#include <fmt/format.h>  // for format
+#include <fstream>       // for ofstream
+#include <lua.h>         // for lua_Debug, lua_getstack, lua_getinfo, lua_sethook
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+
+#include "lua_backend.hpp"  // for LuaBackend
+#include "lua_memory.hpp"   // for check_lua_memory_limit
+#include "lua_watchdog.hpp" // for LuaWatchdog
+
+constexpr int MAX_SAMPLE_DEPTH = 64;
+
+struct LuaSampler
+{
+    bool active{false};
+    int instruction_interval{0};
+    size_t samples{0};
+    std::unordered_map<std::string, uint64_t> stacks;
+};
+LuaSampler g_lua_sampler;
+
+void take_sample(lua_State* L, std::string_view script)
+{
+    lua_Debug frames[MAX_SAMPLE_DEPTH];
+    int depth = 0;
+    while (depth < MAX_SAMPLE_DEPTH && lua_getstack(L, depth, &frames[depth]))
+    {
+        lua_getinfo(L, "Snl", &frames[depth]);
+        depth++;
+    }
+
+    // Folded stacks go from the root to the leaf, separated by ';'
+    std::string stack{script};
+    for (int i = depth - 1; i >= 0; --i)
+    {
+        const lua_Debug& frame = frames[i];
+        stack += fmt::format(";{}:{}:{}", frame.short_src, frame.name ? frame.name : "?", frame.currentline);
+    }
+    std::replace(stack.begin() + script.size(), stack.end(), ' ', '_');
+
+    g_lua_sampler.stacks[std::move(stack)]++;
+    g_lua_sampler.samples++;
+}
+
+void lua_instruction_hook(lua_State* L, [[maybe_unused]] lua_Debug* ar)
+{
+    const int instructions = lua_gethookcount(L);
+    const int interval = g_lua_sampler.active ? g_lua_sampler.instruction_interval : LuaWatchdog::HOOK_INSTRUCTIONS;
+    if (instructions != interval)
+    {
+        // Asked for by the allocator to check the memory limit, or a coroutine made while sampling inherited the short interval
+        install_lua_hook(L);
+    }
+    else if (g_lua_sampler.active)
+    {
+        take_sample(L, LuaBackend::get_calling_backend()->get_name());
+    }
+    LuaWatchdog::get().count(L, instructions);
+    check_lua_memory_limit(L);
+}
+void install_lua_hook(lua_State* L)
+{
+    lua_sethook(L, lua_instruction_hook, LUA_MASKCOUNT, g_lua_sampler.active ? g_lua_sampler.instruction_interval : LuaWatchdog::HOOK_INSTRUCTIONS);
+}
+
+void start_lua_sampling(lua_State* L, int instruction_interval)
+{
+    g_lua_sampler.active = true;
+    g_lua_sampler.instruction_interval = std::max(instruction_interval, 1);
+    g_lua_sampler.samples = 0;
+    g_lua_sampler.stacks.clear();
+    install_lua_hook(L);
+}
+size_t stop_lua_sampling(lua_State* L, std::string_view file)
+{
+    g_lua_sampler.active = false;
+    install_lua_hook(L);
+
+    if (std::ofstream folded{std::string{file}})
+    {
+        for (const auto& [stack, count] : g_lua_sampler.stacks)
+        {
+            folded << stack << ' ' << count << '\n';
+        }
+    }
+    g_lua_sampler.stacks.clear();
+    return g_lua_sampler.samples;
+}
+bool is_lua_sampling()
+{
+    return g_lua_sampler.active;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <string_view> // for string_view
+
+struct lua_State;
+struct lua_Debug;
+
+// Count hook installed on every thread of the shared vm, runs the infinite loop detection and takes samples while sampling is active
+void lua_instruction_hook(lua_State* L, lua_Debug* ar);
+void install_lua_hook(lua_State* L);
+
+// Sample the Lua call stack every `instruction_interval` instructions
+void start_lua_sampling(lua_State* L, int instruction_interval);
+// Stops sampling and writes the samples to `file` as folded stacks (one `root;...;leaf count` line per stack), returns the number of samples
+size_t stop_lua_sampling(lua_State* L, std::string_view file);
+bool is_lua_sampling();
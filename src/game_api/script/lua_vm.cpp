@@ -2,6 +2,7 @@
 
 #include <algorithm>     // for max, transform
 #include <cctype>        // for toupper
+#include <charconv>      // for from_chars
 #include <chrono>        // for milliseconds, sys...
 #include <cmath>         // for pow, sqrt
 #include <compare>       // for operator<
@@ -18,6 +19,7 @@
 #include <list>          // for _List_const_iterator
 #include <lua.h>         // for lua_Debug, lua_State
 #include <map>           // for map, map<>::mappe...
+#include <memory>        // for shared_ptr
 #include <new>           // for operator new
 #include <optional>      // for nullopt, optional
 #include <sol/sol.hpp>   // for global_table, pro...
@@ -30,11 +32,17 @@
 #include <vector>        // for vector, _Vector_i...
 
 #include "aliases.hpp"                             // for CallbackId, ENT_TYPE
+#include "asset_preloader.hpp"                     // for AssetPreloadList, preload_assets
+#include "benchmark.hpp"                           // for BenchmarkSuite, BenchmarkResult
+#include "callback_profiler.hpp"                   // for CallbackStats, get_callback_stats
 #include "color.hpp"                               // for Color
 #include "entities_chars.hpp"                      // for Player
 #include "entities_items.hpp"                      // for Container, Player...
 #include "entity.hpp"                              // for get_entity_ptr
+#include "entity_fields.hpp"                       // for find_entity_field, read_entity_field, EntityField
 #include "entity_lookup.hpp"                       //
+#include "file_api.hpp"                            // for get_image_file_path
+#include "frame_limiter.hpp"                       // for FrameLimiter, FrameLimiterStats
 #include "game_api.hpp"                            //
 #include "game_manager.hpp"                        // for get_game_manager
 #include "heap_base.hpp"                           // for OnHeapPointer, HeapBase
@@ -42,9 +50,18 @@
 #include "items.hpp"                               // for Inventory
 #include "layer.hpp"                               // for g_level_max_x
 #include "lua_backend.hpp"                         // for LuaBackend, ON
+#include "lua_bytecode_cache.hpp"                  // for load_cached_lua_chunk
 #include "lua_console.hpp"                         // for LuaConsole
+#include "lua_fast_paths.hpp"                      // for register_fast_paths
+#include "lua_gc.hpp"                              // for LuaGcScheduler
+#include "lua_jobs.hpp"                            // for LuaJobPool
+#include "lua_lazy.hpp"                            // for register_lazy_globals
 #include "lua_libs/lua_libs.hpp"                   // for require_format_lua
+#include "lua_libs/lua_pack.hpp"                   // for pack_lua_value
+#include "lua_memory.hpp"                          // for lua_memory_alloc, set_lua_memory_vm
 #include "lua_require.hpp"                         // for register_custom_r...
+#include "lua_sampler.hpp"                         // for install_lua_hook
+#include "mapped_file.hpp"                         // for MappedFile
 #include "math.hpp"                                // for AABB
 #include "memory.hpp"                              // for Memory
 #include "movable.hpp"                             // for Movable
@@ -54,12 +71,15 @@
 #include "safe_cb.hpp"                             // for make_safe_clearable_cb
 #include "savedata.hpp"                            // IWYU pragma: keep
 #include "screen.hpp"                              // for get_screen_ptr
+#include "screen_transform.hpp"                    // for ScreenTransform
 #include "script.hpp"                              // for ScriptMessage
 #include "script_util.hpp"                         // for sanitize, get_say
 #include "search.hpp"                              // for get_address
 #include "settings_api.hpp"                        // for get_settings_name...
 #include "state.hpp"                               // for StateMemory
+#include "state_feed.hpp"                          // for StateFeed
 #include "strings.hpp"                             // for change_string
+#include "turbo.hpp"                               // for Turbo
 #include "usertypes/behavior_lua.hpp"              // for register_usertypes
 #include "usertypes/bucket_lua.hpp"                // for register_usertypes
 #include "usertypes/char_state_lua.hpp"            // for register_usertypes
@@ -78,6 +98,7 @@
 #include "usertypes/entities_monsters_lua.hpp"     // for register_usertypes
 #include "usertypes/entities_mounts_lua.hpp"       // for register_usertypes
 #include "usertypes/entity_casting_lua.hpp"        // for register_usertypes
+#include "usertypes/entity_lookup_lua.hpp"         // for register_usertypes, make_entity_filter
 #include "usertypes/entity_lua.hpp"                // for register_usertypes
 #include "usertypes/flags_lua.hpp"                 // for register_usertypes
 #include "usertypes/game_manager_lua.hpp"          // for register_usertypes
@@ -86,10 +107,13 @@
 #include "usertypes/gui_lua.hpp"                   // for register_usertypes
 #include "usertypes/hitbox_lua.hpp"                // for register_usertypes
 #include "usertypes/level_lua.hpp"                 // for register_usertypes
+#include "usertypes/mapped_file_lua.hpp"           // for register_usertypes
 #include "usertypes/logic_lua.hpp"                 // for register_usertypes
+#include "usertypes/navigation_lua.hpp"            // for register_usertypes
 #include "usertypes/options_lua.hpp"               // for register_usertypes
 #include "usertypes/particles_lua.hpp"             // for register_usertypes
 #include "usertypes/player_lua.hpp"                // for register_usertypes
+#include "usertypes/point_buffer_lua.hpp"          // for register_usertypes
 #include "usertypes/prng_lua.hpp"                  // for register_usertypes
 #include "usertypes/save_context.hpp"              // for register_usertypes
 #include "usertypes/screen_arena_lua.hpp"          // for register_usertypes
@@ -103,6 +127,7 @@
 #include "usertypes/vanilla_render_lua.hpp"        // for VanillaRenderContext
 #include "usertypes/vtables_lua.hpp"               // for register_usertypes
 #include "virtual_table.hpp"                       //
+#include "window_api.hpp"                          // for set_low_latency_mode
 
 struct Illumination;
 
@@ -112,6 +137,8 @@ void load_libraries(sol::state& lua)
     require_json_lua(lua);
     require_inspect_lua(lua);
     require_format_lua(lua);
+    require_binser_lua(lua);
+    require_benchmark_lua(lua);
 
     register_custom_require(lua);
 }
@@ -123,17 +150,7 @@ void load_unsafe_libraries(sol::state& lua)
 }
 void populate_lua_state(sol::state& lua, SoundManager* sound_manager)
 {
-    auto infinite_loop = [](lua_State* argst, [[maybe_unused]] lua_Debug* argdb)
-    {
-        static size_t last_frame = 0;
-        auto backend = LuaBackend::get_calling_backend();
-        if (last_frame == backend->frame_counter && backend->infinite_loop_detection)
-            luaL_error(argst, "Hit Infinite Loop Detection of 420 million instructions");
-        last_frame = backend->frame_counter;
-    };
-
-    lua_sethook(lua.lua_state(), NULL, 0, 0);
-    lua_sethook(lua.lua_state(), infinite_loop, LUA_MASKCOUNT, 420000000);
+    install_lua_hook(lua.lua_state());
 
     lua.safe_script(R"(
 -- This function walks up the stack until it finds an _ENV that is not _G
@@ -162,6 +179,8 @@ end
 )");
 
     NHitbox::register_usertypes(lua);
+    NMappedFile::register_usertypes(lua);
+    NPointBuffer::register_usertypes(lua);
     NSound::register_usertypes(lua, sound_manager);
     NLevel::register_usertypes(lua);
     NGui::register_usertypes(lua);
@@ -192,7 +211,8 @@ end
     NEntityFlags::register_usertypes(lua);
     NEntityCasting::register_usertypes(lua);
     NBehavior::register_usertypes(lua);
-    NSteam::register_usertypes(lua);
+    // Modules that only define globals of their own are registered the first time a script uses one of them
+    register_lazy_globals(lua, {"get_feat", "get_feat_hidden", "set_feat_hidden", "change_feat", "FEAT"}, &NSteam::register_usertypes);
     NVTables::register_usertypes(lua);
     NLogic::register_usertypes(lua);
     NBucket::register_usertypes(lua);
@@ -200,8 +220,18 @@ end
     NDeprecated::register_usertypes(lua);
     NGPlayers::register_usertypes(lua);
     NSpawn::register_usertypes(lua);
-    NGamePatches::register_usertypes(lua);
+    register_lazy_globals(
+        lua,
+        {"set_kapala_blood_threshold", "set_kapala_hud_icon", "modify_sparktraps", "activate_sparktraps_hack", "set_storage_layer", "set_olmec_phase_y_level",
+         "set_ghost_spawn_times", "set_cursepot_ghost_enabled", "set_time_ghost_enabled", "set_time_jelly_enabled", "set_camp_camera_bounds_enabled",
+         "set_explosion_mask", "set_max_rope_length", "change_sunchallenge_spawns", "change_diceshop_prizes", "change_altar_damage_spawns",
+         "change_waddler_drop", "modify_ankh_health_gain", "change_poison_timer", "disable_floor_embeds", "set_ending_unlock", "set_olmec_cutscene_enabled",
+         "set_tiamat_cutscene_enabled", "activate_tiamat_position_hack", "activate_crush_elevator_hack", "activate_hundun_hack",
+         "set_boss_door_control_enabled", "set_level_logic_enabled", "set_start_level_paused", "set_camera_layer_control_enabled", "set_liquid_layer"},
+        &NGamePatches::register_usertypes);
     NOptions::register_usertypes(lua);
+    NEntityLookup::register_usertypes(lua);
+    register_lazy_globals(lua, {"GridFlowField", "is_grid_passable", "find_grid_path", "get_grid_flow_field"}, &NNavigation::register_usertypes);
 
     /// A bunch of [game state](#StateMemory) variables. Your ticket to almost anything that is not an Entity.
     lua["state"] = HeapBase::get_main().state();
@@ -266,10 +296,7 @@ end
     lua["print"] = [](std::string message) -> void
     {
         auto backend = LuaBackend::get_calling_backend();
-        bool is_console = !strcmp(backend->get_id(), "dev/lua_console");
-        backend->messages.push_back({message, std::chrono::system_clock::now(), ImVec4(1.0f, 1.0f, 1.0f, 1.0f)});
-        if (backend->messages.size() > 40 && !is_console)
-            backend->messages.pop_front();
+        backend->messages.push(message, ImVec4(1.0f, 1.0f, 1.0f, 1.0f));
         backend->lua["lua_print"](message);
     };
 
@@ -360,7 +387,7 @@ end
         auto backend = LuaBackend::get_calling_backend();
         int now = HeapBase::get().state()->time_level;
         auto luaCb = IntervalCallback{cb, frames, now};
-        backend->level_timers[backend->cbcount] = luaCb;
+        backend->level_timers.add(backend->cbcount, std::move(luaCb));
         return backend->cbcount++;
     };
     /// Returns unique id for the callback to be used in [clear_callback](#clear_callback).
@@ -370,7 +397,7 @@ end
         auto backend = LuaBackend::get_calling_backend();
         int now = backend->g_state->time_level;
         auto luaCb = TimeoutCallback{cb, now + frames};
-        backend->level_timers[backend->cbcount] = luaCb;
+        backend->level_timers.add(backend->cbcount, std::move(luaCb));
         return backend->cbcount++;
     };
     /// Returns unique id for the callback to be used in [clear_callback](#clear_callback). You can also return `false` from your function to clear the callback.
@@ -379,7 +406,7 @@ end
     {
         auto backend = LuaBackend::get_calling_backend();
         auto luaCb = IntervalCallback{cb, frames, -1};
-        backend->global_timers[backend->cbcount] = luaCb;
+        backend->global_timers.add(backend->cbcount, std::move(luaCb));
         return backend->cbcount++;
     };
     /// Returns unique id for the callback to be used in [clear_callback](#clear_callback).
@@ -389,30 +416,110 @@ end
         auto backend = LuaBackend::get_calling_backend();
         int now = HeapBase::get().frame_count();
         auto luaCb = TimeoutCallback{cb, now + frames};
-        backend->global_timers[backend->cbcount] = luaCb;
+        backend->global_timers.add(backend->cbcount, std::move(luaCb));
         return backend->cbcount++;
     };
     /// Returns unique id for the callback to be used in [clear_callback](#clear_callback).
-    /// Add global callback function to be called on an [event](#Events).
-    lua["set_callback"] = [](sol::function cb, ON event) -> CallbackId
+    /// Run `fun` as a coroutine that is resumed once per frame, call `coroutine.yield()` in it to continue on the next frame. The coroutines of a script share a time budget per frame, set with [set_coroutine_budget](#set_coroutine_budget),
+    /// the ones that don't fit are resumed first on the next frame. The coroutine is removed when it returns or errors, or with [clear_callback](#clear_callback) like any other callback.
+    lua["schedule_coroutine"] = [](sol::function fun) -> CallbackId
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        backend->scheduled_coroutines.add(backend->cbcount, std::move(fun));
+        return backend->cbcount++;
+    };
+    /// Set how many microseconds the coroutines of this script may take per frame, default is 2000
+    lua["set_coroutine_budget"] = [](int64_t microseconds)
+    {
+        LuaBackend::get_calling_backend()->scheduled_coroutines.budget_us = std::max<int64_t>(microseconds, 0);
+    };
+    /// Get the number of frames the coroutines of this script went over their budget, a single resume that takes too long can't be cut short
+    lua["get_coroutine_overruns"] = []() -> uint64_t
+    {
+        return LuaBackend::get_calling_backend()->scheduled_coroutines.overruns;
+    };
+    auto add_callback = [](ScreenCallback luaCb) -> CallbackId
     {
         auto backend = LuaBackend::get_calling_backend();
-        auto luaCb = ScreenCallback{cb, event, -1};
         if (luaCb.screen == ON::LOAD)
             backend->load_callbacks[backend->cbcount] = luaCb; // Make sure load always runs before other callbacks
         else if (luaCb.screen == ON::SAVE)
             backend->save_callbacks[backend->cbcount] = luaCb; // Make sure save always runs after other callbacks
         else
-            backend->callbacks[backend->cbcount] = luaCb;
+            backend->callbacks.add(backend->cbcount, luaCb);
+        switch (luaCb.screen)
+        {
+        case ON::RENDER_PRE_DRAW_DEPTH:
+        case ON::RENDER_POST_DRAW_DEPTH:
+        case ON::PRE_GET_FEAT:
+        case ON::PRE_SET_FEAT:
+        case ON::SPEECH_BUBBLE:
+        case ON::TOAST:
+        case ON::IDLE:
+            LuaBackend::invalidate_subscribers();
+            break;
+        default:
+            break;
+        }
         return backend->cbcount++;
     };
+    /// Returns unique id for the callback to be used in [clear_callback](#clear_callback).
+    /// Add global callback function to be called on an [event](#Events).
+    /// For ON.RENDER_PRE_DRAW_DEPTH and ON.RENDER_POST_DRAW_DEPTH you can pass a table of draw depths as the third parameter to only get called for those, which is much cheaper than checking the depth in the callback.
+    lua["set_callback"] = sol::overload(
+        [add_callback](sol::function cb, ON event) -> CallbackId
+        {
+            return add_callback(ScreenCallback{std::move(cb), event, -1});
+        },
+        [add_callback](sol::function cb, ON event, std::vector<uint8_t> draw_depths) -> CallbackId
+        {
+            uint64_t depths{0};
+            for (uint8_t draw_depth : draw_depths)
+            {
+                if (draw_depth < 64)
+                    depths |= 1ull << draw_depth;
+            }
+            return add_callback(ScreenCallback{std::move(cb), event, -1, depths});
+        });
+    /// Returns unique id for the callback to be used in [clear_callback](#clear_callback).
+    /// Add a callback for many custom rendered entities at once: add their render infos with [RenderInfo](#RenderInfo)`:add_to_render_batch(id)` and `fun` is called once after each layer is drawn with the ones that were rendered in it,
+    /// instead of one `set_post_render` callback per entity per frame.
+    /// <br/>The callback signature is nil render_batch(VanillaRenderContext render_ctx, array<RenderInfo> render_infos, int layer)
+    lua["set_render_batch_callback"] = [](sol::function fun) -> CallbackId
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        backend->render_batch_callbacks[backend->cbcount] = RenderBatchCallback{std::move(fun), std::make_shared<std::vector<uint32_t>>()};
+        return backend->cbcount++;
+    };
+    /// Limit how often the ON.GUIFRAME callback `id` runs to `max_hz` times per second, or to only when `state.screen` or `state.time_level` changed if `only_on_change` is set, or both.
+    /// On the frames in between, what the callback drew on the default background layer the last time it ran is drawn again, at a fraction of the cost of running the callback.
+    /// Windows, widgets and the foreground layer are only drawn on the frames it runs, so this is meant for overlays. Call with `max_hz` 0 and no `only_on_change` to run it every frame again.
+    /// Returns false if `id` is not an ON.GUIFRAME callback
+    lua["set_callback_throttle"] = [](CallbackId id, float max_hz, std::optional<bool> only_on_change) -> bool
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        auto it = backend->callbacks.find(id);
+        if (it == backend->callbacks.end() || it->second.screen != ON::GUIFRAME)
+            return false;
+        ScreenCallback& callback = it->second;
+        if (max_hz <= 0.0f && !only_on_change.value_or(false))
+        {
+            callback.throttle.reset();
+            return true;
+        }
+        if (!callback.throttle)
+            callback.throttle = std::make_shared<CallbackThrottle>();
+        callback.throttle->interval = max_hz > 0.0f ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(1.0f / max_hz)) : std::chrono::steady_clock::duration{};
+        callback.throttle->on_change = only_on_change.value_or(false);
+        return true;
+    };
     /// Clear previously added callback `id` or call without arguments inside any callback to clear that callback after it returns.
     // lua["clear_callback"] = [](sol::optional<CallbackId> id) -> void {};
     lua["clear_callback"] = sol::overload(
         [](CallbackId id)
         {
             auto backend = LuaBackend::get_calling_backend();
-            backend->clear_callbacks.push_back(id);
+            backend->clear_callbacks.insert(id);
         },
         []()
         {
@@ -422,13 +529,13 @@ end
             {
             case CallbackType::Normal:
             case CallbackType::HotKey:
-                backend->clear_callbacks.push_back(caller.id);
+                backend->clear_callbacks.insert(caller.id);
                 break;
             case CallbackType::Entity:
                 backend->HookHandler<Entity, CallbackType::Entity>::clear_hook(caller.id, caller.aux_id);
                 break;
             case CallbackType::Screen:
-                backend->clear_screen_hooks.push_back({caller.aux_id, caller.id});
+                backend->clear_screen_hooks.insert({caller.aux_id, caller.id});
                 break;
             case CallbackType::Theme:
                 backend->HookHandler<ThemeInfo, CallbackType::Theme>::clear_hook(caller.id, caller.aux_id);
@@ -607,12 +714,19 @@ end
     lua["get_grid_entity_at"] = get_grid_entity_at;
     /// Get uids of static entities overlapping this grid position (decorations, backgrounds etc.)
     lua["get_entities_overlapping_grid"] = get_entities_overlapping_grid;
+    auto filter_entities_lua = sol::overload(
+        [&lua](std::vector<uint32_t> entities, sol::function predicate) -> std::vector<uint32_t>
+        {
+            return filter_entities(std::move(entities), [&lua, pred = std::move(predicate)](Entity* entity) -> bool
+                                   { return pred(lua["cast_entity"](entity)); });
+        },
+        [](std::vector<uint32_t> entities, const EntityFilter& filter) -> std::vector<uint32_t>
+        { return filter_entities(std::move(entities), filter); },
+        [](std::vector<uint32_t> entities, sol::table conditions) -> std::vector<uint32_t>
+        { return filter_entities(std::move(entities), NEntityLookup::make_entity_filter(conditions)); });
     /// Returns a list of all uids in `entities` for which `predicate(get_entity(uid))` returns true
-    lua["filter_entities"] = [&lua](std::vector<uint32_t> entities, sol::function predicate) -> std::vector<uint32_t>
-    {
-        return filter_entities(std::move(entities), [&lua, pred = std::move(predicate)](Entity* entity) -> bool
-                               { return pred(lua["cast_entity"](entity)); });
-    };
+    /// Instead of a function you can pass an [EntityFilter](#EntityFilter) or a table of its conditions, those are tested without calling into Lua and drop the uids of entities that don't exist
+    lua["filter_entities"] = filter_entities_lua;
 
     auto get_entities_by = sol::overload(
         static_cast<std::vector<uint32_t> (*)(ENT_TYPE, ENTITY_MASK, LAYER)>(::get_entities_by),
@@ -640,6 +754,12 @@ end
         }
         return std::vector<uint32_t>({});
     };
+    auto get_entity_count = sol::overload(
+        static_cast<uint32_t (*)(ENT_TYPE, ENTITY_MASK, LAYER)>(::get_entity_count),
+        static_cast<uint32_t (*)(std::vector<ENT_TYPE>, ENTITY_MASK, LAYER)>(::get_entity_count));
+    /// Same as `#get_entities_by(...)` without building the list of uids. Counting types is fast, the counts are kept up to date when entities spawn
+    /// and only counted again after the level updated or when entities were destroyed or moved to the other layer
+    lua["get_entity_count"] = get_entity_count;
 
     auto get_entities_at = sol::overload(
         static_cast<std::vector<uint32_t> (*)(ENT_TYPE, ENTITY_MASK, float, float, LAYER, float)>(::get_entities_at),
@@ -666,6 +786,21 @@ end
     /// Translate an entity position to screen position to be used in drawing functions
     lua["screen_position"] = [](float x, float y) -> std::pair<float, float>
     { return API::screen_position(x, y); };
+    /// Translate many entity positions to screen positions at once, returns the screen `xs` and `ys`. Faster than calling `screen_position` for each one
+    lua["screen_positions"] = [](std::vector<float> xs, std::vector<float> ys) -> std::pair<std::vector<float>, std::vector<float>>
+    {
+        const ScreenTransform& transform = ScreenTransform::get();
+        const size_t count = std::min(xs.size(), ys.size());
+        xs.resize(count);
+        ys.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Vec2 screen = transform.to_screen(xs[i], ys[i]);
+            xs[i] = screen.x;
+            ys[i] = screen.y;
+        }
+        return {std::move(xs), std::move(ys)};
+    };
     /// Translate a distance of `x` tiles to screen distance to be be used in drawing functions
     lua["screen_distance"] = screen_distance;
     /// Get the current frame count since the game was started*. You can use this to make some timers yourself, the engine runs at 60fps. This counter is paused if the pause is set with flags PAUSE.FADE or PAUSE.ANKH.
@@ -746,7 +881,7 @@ end
     lua["clear_screen_callback"] = [](int screen_id, CallbackId cb_id)
     {
         auto backend = LuaBackend::get_calling_backend();
-        backend->clear_screen_hooks.push_back({screen_id, cb_id});
+        backend->clear_screen_hooks.insert({screen_id, cb_id});
     };
     /// Returns unique id for the callback to be used in [clear_screen_callback](#clear_screen_callback) or `nil` if screen_id is not valid.
     /// Sets a callback that is called right before the screen is drawn, return `true` to skip the default rendering.
@@ -767,7 +902,7 @@ end
                                { return VanillaRenderContext{}; }}));
 
             auto backend = LuaBackend::get_calling_backend();
-            backend->screen_hooks.push_back({screen_id, id});
+            backend->screen_hooks.insert({screen_id, id});
             return id;
         }
         return sol::nullopt;
@@ -791,7 +926,7 @@ end
                                { return VanillaRenderContext{}; }}));
 
             auto backend = LuaBackend::get_calling_backend();
-            backend->screen_hooks.push_back({screen_id, id});
+            backend->screen_hooks.insert({screen_id, id});
             return id;
         }
         return sol::nullopt;
@@ -808,6 +943,29 @@ end
         {
             auto backend = LuaBackend::get_calling_backend();
             backend->pre_entity_instagib_callbacks.push_back(EntityInstagibCallback{backend->cbcount, uid, std::move(fun)});
+            LuaBackend::invalidate_subscribers();
+            return backend->cbcount++;
+        }
+        return sol::nullopt;
+    };
+
+    /// Returns unique id for the callback to be used in [clear_callback](#clear_callback) or `nil` if uid is not valid.
+    /// Calls `fun` right before the ON.POST_UPDATE callbacks when the field `field` (a name like in `Entity:get_fields`, e.g. `"health"`, `"state"` or `"flags"`) of the entity changed during the update.
+    /// The field is compared natively every frame so nothing runs in Lua while it stays the same, use this instead of checking the field in ON.POST_UPDATE yourself.
+    /// The callback is cleared when the entity is destroyed. Fields of Movable can only be watched on movable entities, it returns `nil` for the others.
+    /// <br/>The callback signature is nil on_field_changed(Entity self, number new_value, number old_value)
+    lua["watch_field"] = [](int uid, std::string_view field, sol::function fun) -> sol::optional<CallbackId>
+    {
+        const EntityField* entity_field = find_entity_field(field);
+        if (entity_field == nullptr)
+            throw sol::error{fmt::format("Unknown entity field '{}'", field)};
+        if (Entity* ent = get_entity_ptr(uid))
+        {
+            if (entity_field->movable && !ent->is_movable())
+                return sol::nullopt;
+            auto backend = LuaBackend::get_calling_backend();
+            const double value = read_entity_field(ent, *entity_field);
+            backend->field_watch_callbacks.push_back(FieldWatchCallback{backend->cbcount, static_cast<uint32_t>(uid), ent, entity_field, value, std::move(fun)});
             return backend->cbcount++;
         }
         return sol::nullopt;
@@ -840,14 +998,43 @@ end
     lua["add_item_to_shop"] = add_item_to_shop;
 
     auto create_illumination = sol::overload(
-        static_cast<Illumination* (*)(Color, float, float, float)>(::create_illumination),
-        static_cast<Illumination* (*)(Color, float, int32_t)>(::create_illumination),
-        static_cast<Illumination* (*)(Vec2, Color, LIGHT_TYPE, float, uint8_t, int32_t, LAYER)>(::create_illumination));
+        [](Color color, float size, float x, float y) -> Illumination*
+        {
+            Illumination* illumination = ::create_illumination(std::move(color), size, x, y);
+            track_script_light(illumination);
+            return illumination;
+        },
+        [](Color color, float size, int32_t uid) -> Illumination*
+        {
+            Illumination* illumination = ::create_illumination(std::move(color), size, uid);
+            track_script_light(illumination);
+            return illumination;
+        },
+        [](Vec2 pos, Color color, LIGHT_TYPE type, float size, uint8_t flags, int32_t uid, LAYER layer) -> Illumination*
+        {
+            Illumination* illumination = ::create_illumination(pos, std::move(color), type, size, flags, uid, layer);
+            track_script_light(illumination);
+            return illumination;
+        });
     /// Creates a new Illumination. Don't forget to continuously call [refresh_illumination](#refresh_illumination), otherwise your light emitter fades out! Check out the [illumination.lua](https://github.com/spelunky-fyi/overlunky/blob/main/examples/illumination.lua) script for an example.
     /// Warning: this is only valid for current level!
     lua["create_illumination"] = create_illumination;
     /// Refreshes an Illumination, keeps it from fading out, short for `illumination.timer = get_frame()`
     lua["refresh_illumination"] = refresh_illumination;
+    /// Creates a light at every position in `xs` and `ys` in one call, returns them in the same order. Refresh them with [refresh_illuminations](#refresh_illuminations) or [move_illuminations](#move_illuminations)
+    lua["create_illuminations"] = [](std::vector<float> xs, std::vector<float> ys, Color color, float size, std::optional<LAYER> layer) -> std::vector<Illumination*>
+    { return create_illuminations(xs, ys, std::move(color), size, layer.value_or(LAYER::FRONT)); };
+    /// Creates a light following every entity in `uids` in one call, returns them in the same order, `nil` for the uids that don't exist
+    lua["create_illuminations_on_entities"] = create_illuminations_on_entities;
+    /// Refreshes all the lights in the list, see [refresh_illumination](#refresh_illumination)
+    lua["refresh_illuminations"] = refresh_illuminations;
+    /// Moves every light in the list to the position at the same index in `xs` and `ys` and refreshes it
+    lua["move_illuminations"] = move_illuminations;
+    /// Turns off all the lights in the list, they can't be used anymore afterwards
+    lua["destroy_illuminations"] = destroy_illuminations;
+    /// Lights created by scripts are not passed to the game's lighting pass while they are further than their size plus `margin` tiles (default 4) outside of the screen.
+    /// Lights that follow the camera and room lights are never culled, and neither are lights the game made itself. Enabled by default
+    lua["set_light_culling"] = set_light_culling;
 
     /// Return the name of the first matching number in an enum table
     // lua["enum_get_name"] = [](table enum, int value) -> string
@@ -919,6 +1106,8 @@ end
     /// Updates the floor collisions used by the liquids, set add to false to remove tile of collision, set to true to add one
     /// optional `layer` parameter to be used when liquid was moved to back layer using [set_liquid_layer](#set_liquid_layer)
     lua["update_liquid_collision_at"] = update_liquid_collision_at;
+    /// Same as [update_liquid_collision_at](#update_liquid_collision_at) for every position in `xs` and `ys`, much faster than calling it for each tile when removing or adding a lot of floor at once
+    lua["update_liquid_collisions_at"] = update_liquid_collisions_at;
 
     /// Optimized function to check for the amount of liquids at a certain position, by accessing a 2d array of liquids by third of a tile. Try the `liquids.lua` example to know better how it works.
     /// Returns a pair of water and lava, in that order.
@@ -926,10 +1115,52 @@ end
     /// Coarse water increase the number by 3, coarse and stagnant lava by 6. Combinations of both normal and coarse can make the number higher than 6.
     lua["get_liquids_at"] = get_liquids_at;
 
+    /// Liquid amounts of a rectangle, returned by [get_liquids_in_rect](#get_liquids_in_rect)
+    lua.new_usertype<LiquidGrid>(
+        "LiquidGrid",
+        sol::no_constructor,
+        "x",
+        sol::readonly(&LiquidGrid::x),
+        "y",
+        sol::readonly(&LiquidGrid::y),
+        "width",
+        sol::readonly(&LiquidGrid::width),
+        "height",
+        sol::readonly(&LiquidGrid::height),
+        "stride",
+        sol::readonly(&LiquidGrid::stride),
+        "water",
+        sol::readonly(&LiquidGrid::water),
+        "lava",
+        sol::readonly(&LiquidGrid::lava),
+        "water_sums",
+        sol::readonly(&LiquidGrid::water_sums),
+        "lava_sums",
+        sol::readonly(&LiquidGrid::lava_sums),
+        "get",
+        &LiquidGrid::get,
+        "sum",
+        &LiquidGrid::sum);
+    /// Get the liquid amounts of every cell in the rectangle between two positions in one call, see [LiquidGrid](#LiquidGrid). Same values as [get_liquids_at](#get_liquids_at) for each cell.
+    /// Set `summed_area` to also build summed-area tables, then `LiquidGrid:sum` takes constant time for any smaller rectangle. Empty if `layer` is not the one with the liquids.
+    lua["get_liquids_in_rect"] = [](float x1, float y1, float x2, float y2, LAYER layer, std::optional<bool> summed_area) -> LiquidGrid
+    { return get_liquids_in_rect(x1, y1, x2, y2, layer, summed_area.value_or(false)); };
+
     /// Get the rva for a pattern name, used for debugging.
     lua["get_rva"] = [](std::string_view address_name) -> std::string
     { return fmt::format("{:X}", get_address(address_name) - Memory::get().at_exe(0)); };
 
+    /// Get the pattern name for an rva like the ones from [get_rva](#get_rva), or the closest one before it in the same function, used for debugging.
+    /// Returns nil if `rva` isn't a hex number
+    lua["get_rva_name"] = [](std::string_view rva) -> std::optional<std::string>
+    {
+        size_t offset{0};
+        auto [end, error] = std::from_chars(rva.data(), rva.data() + rva.size(), offset, 16);
+        if (error != std::errc{} || end != rva.data() + rva.size())
+            return std::nullopt;
+        return symbolicate_address(Memory::get().at_exe(offset));
+    };
+
     /// Get the rva for a vtable offset and index, used for debugging.
     lua["get_virtual_rva"] = [](VTABLE_OFFSET offset, uint32_t index) -> std::string
     { return fmt::format("{:X}", get_virtual_function_address(offset, index)); };
@@ -956,6 +1187,24 @@ end
         }
         return false;
     };
+    /// Writes savegame.sav on a background thread from now on, so [save_progress](#save_progress) and the game's own saves don't hitch the game.
+    /// The game thread only copies the save data, the file is written in the order the saves were made. Turned off again when the script is unloaded.
+    lua["set_async_savegame"] = [](bool enable)
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        if (std::exchange(backend->async_savegame, enable) != enable)
+            set_async_game_writes(enable);
+    };
+    /// Publishes the game state to the shared memory `Local\\OverlunkyStateFeed` after every update, for overlays and trackers in other processes.
+    /// Every frame has the screen, world, level, theme and timers, the players and the entities of `entity_types` if given (1024 at most).
+    /// The layout is in state_feed.hpp, it's double-buffered and each buffer has a sequence number that is odd while it's written. Returns false if the shared memory couldn't be created
+    lua["set_state_feed"] = [](bool enable, std::optional<std::vector<ENT_TYPE>> entity_types) -> bool
+    {
+        auto& feed = StateFeed::get();
+        if (entity_types)
+            feed.set_entity_types(std::move(entity_types.value()));
+        return feed.set_enabled(enable);
+    };
 
     /// Runs the ON.SAVE callback. Fails and returns false, if you're trying to save too often (2s).
     lua["save_script"] = []() -> bool
@@ -1089,6 +1338,12 @@ end
     /// Get engine target frametime when game is unfocused (1/framerate, default 1/33).
     lua["get_frametime_unfocused"] = get_frametime_inactive;
 
+    /// Limit the GPU to one queued frame to reduce input latency, at the cost of some throughput. Also waits on the swap chain before input is processed if the game uses a waitable flip model swap chain.
+    lua["set_low_latency_mode"] = set_low_latency_mode;
+
+    /// Get whether the low latency mode is enabled
+    lua["get_low_latency_mode"] = get_low_latency_mode;
+
     auto add_custom_type = sol::overload(
         static_cast<ENT_TYPE (*)(std::vector<ENT_TYPE>)>(::add_custom_type),
         static_cast<ENT_TYPE (*)()>(::add_custom_type));
@@ -1164,7 +1419,7 @@ end
         return inputs;
     };
 
-    /// Disable the Infinite Loop Detection of 420 million instructions per frame, if you know what you're doing and need to perform some serious calculations that hang the game updates for several seconds.
+    /// Disable the Infinite Loop Detection that stops a callback after it ran 420 million instructions, if you know what you're doing and need to perform some serious calculations that hang the game updates for several seconds.
     lua["set_infinite_loop_detection_enabled"] = [](bool enable)
     {
         auto backend = LuaBackend::get_calling_backend();
@@ -1177,6 +1432,97 @@ end
     /// Get the current speedhack multiplier
     lua["get_speedhack"] = get_speedhack;
 
+    /// Run `loops_per_frame` game loops for every presented frame, each one exactly one engine frame long no matter how long it actually took, so the game simulates that many times faster without skipping updates. Only the last loop of a frame is rendered and the frame limiter is skipped, the game loop events fire for every loop. Call without arguments or with 1 to turn it off, it's also turned off when the script is unloaded. Also see [set_speedhack](#set_speedhack)
+    lua["set_turbo"] = [](std::optional<uint32_t> loops_per_frame)
+    {
+        LuaBackend::get_calling_backend()->turbo = loops_per_frame.value_or(1) > 1;
+        Turbo::get().set(loops_per_frame);
+    };
+
+    /// Get the game loops per presented frame, 1 when turbo is off
+    lua["get_turbo"] = []() -> uint32_t
+    {
+        return Turbo::get().get_loops_per_frame();
+    };
+
+    lua.new_usertype<FrameLimiterStats>(
+        "FrameLimiterStats",
+        sol::no_constructor,
+        "frames",
+        sol::readonly(&FrameLimiterStats::frames),
+        "last_ms",
+        sol::readonly(&FrameLimiterStats::last_ms),
+        "average_ms",
+        sol::readonly(&FrameLimiterStats::average_ms),
+        "min_ms",
+        sol::readonly(&FrameLimiterStats::min_ms),
+        "max_ms",
+        sol::readonly(&FrameLimiterStats::max_ms),
+        "deviation_ms",
+        sol::readonly(&FrameLimiterStats::deviation_ms),
+        "late",
+        sol::readonly(&FrameLimiterStats::late));
+
+    /// Pace the game with a high resolution waitable timer and a short spin right before input is processed, instead of the coarse sleep of the game, for steady frame times. `target` is the time between game loops in seconds,
+    /// call without arguments to turn it off. The engine frametime is set to 0 while it's on, so every loop does exactly one update, and restored to what it was before when turned off. Only paces the game while it has focus and turbo is off.
+    /// `spin` is how long before the deadline the timer wakes up to spin the rest of the wait, 0.5 ms by default. Turned off again when the script is unloaded
+    lua["set_frame_limiter"] = [](std::optional<double> target, std::optional<double> spin)
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        backend->frame_limiter = target.has_value();
+        auto& limiter = FrameLimiter::get();
+        if (spin.has_value())
+            limiter.set_spin(spin.value());
+        limiter.set(target);
+    };
+
+    /// Get the target time between game loops of the frame limiter in seconds, nil when it's off
+    lua["get_frame_limiter"] = []() -> std::optional<double>
+    {
+        return FrameLimiter::get().get_target();
+    };
+
+    /// Get the frame pacing stats of the frame limiter since it was turned on or the stats were reset, see [FrameLimiterStats](#FrameLimiterStats)
+    lua["get_frame_limiter_stats"] = []() -> FrameLimiterStats
+    {
+        return FrameLimiter::get().get_stats();
+    };
+
+    /// Reset the frame limiter stats
+    lua["reset_frame_limiter_stats"] = []()
+    {
+        FrameLimiter::get().reset_stats();
+    };
+
+    /// Time the API hot paths (`get_entities_by`, `get_entity`, save states, pattern search, event dispatch and a call through the Lua bindings) in the current level, meant to be called from the console.
+    /// Prints and returns one json line per case with the ops/s and the latency percentiles in microseconds. `iterations` defaults to 10000, the inputs are picked with `seed` (0x5EED by default)
+    /// so runs in the same level state are comparable, `filter` only runs the cases with this in their name. Runs nothing outside of a level
+    lua["run_benchmarks"] = [&lua](std::optional<uint32_t> iterations, std::optional<uint32_t> seed, std::optional<std::string> filter) -> std::string
+    {
+        BenchmarkSuite suite{iterations.value_or(10000), seed.value_or(0x5EED), filter.value_or("")};
+        suite.run_api_cases();
+
+        const std::vector<uint32_t> uids = get_entities_by({}, ENTITY_MASK::ANY, LAYER::BOTH);
+        sol::protected_function get_entity = lua["get_entity"];
+        if (!uids.empty())
+        {
+            suite.run(
+                "sol2 get_entity", [&](std::mt19937& rng)
+                { get_entity(uids[rng() % uids.size()]); },
+                1, 16);
+        }
+
+        std::string out;
+        for (const BenchmarkResult& result : suite.get_results())
+        {
+            std::string line = result.to_json();
+            lua["print"](line);
+            out += line;
+            out += '\n';
+        }
+        return out;
+    };
+
     /// Retrieves the current value of the performance counter, which is a high resolution (<1us) time stamp that can be used for time-interval measurements.
     lua["get_performance_counter"] = []() -> int64_t
     {
@@ -1195,6 +1541,94 @@ end
         return 0;
     };
 
+    lua.new_usertype<CallbackStats>(
+        "CallbackStats",
+        sol::no_constructor,
+        "script",
+        &CallbackStats::script,
+        "id",
+        &CallbackStats::id,
+        "aux_id",
+        &CallbackStats::aux_id,
+        "calls",
+        &CallbackStats::calls,
+        "total_ms",
+        &CallbackStats::total_ms,
+        "max_ms",
+        &CallbackStats::max_ms,
+        "frame_ms",
+        &CallbackStats::frame_ms);
+
+    /// Get timing stats of every callback that ran in every loaded script, including the console. Times include any callbacks ran from inside the callback.
+    /// Only collected while profiling is on, see [set_callback_profiling_enabled](#set_callback_profiling_enabled), and cleared when a script is reset.
+    lua["get_callback_stats"] = get_callback_stats;
+
+    /// Turn the timing of every callback in every script on or off, off by default. The same as the checkbox in the Overlunky debug tools.
+    lua["set_callback_profiling_enabled"] = [](bool enable)
+    { CallbackProfiler::enabled = enable; };
+
+    /// Reset the timing stats returned by [get_callback_stats](#get_callback_stats) for all scripts.
+    lua["reset_callback_stats"] = reset_callback_stats;
+
+    /// Loads assets on worker threads so the script doesn't have to wait for them while it starts. `assets` is a table with the optional fields `images`, `sounds` and `files`, each an array of paths relative to the script.
+    /// Images are converted to the texture cache for [define_texture](#define_texture), sounds are decoded for [create_sound](#create_sound) and files are read once so the game loads them faster, for example level files.
+    /// `callback` runs on the first update after every asset finished loading, its signature is nil callback()
+    lua["preload_assets"] = [](sol::table assets, sol::optional<sol::function> callback)
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        const auto resolve_paths = [&](const char* name, auto&& resolve)
+        {
+            std::vector<std::string> paths;
+            if (sol::optional<std::vector<std::string>> relative_paths = assets[name])
+            {
+                for (std::string& path : relative_paths.value())
+                    paths.push_back(resolve(std::move(path)));
+            }
+            return paths;
+        };
+
+        AssetPreloadList preload_list;
+        preload_list.images = resolve_paths("images", [&](std::string path)
+                                            { return get_image_file_path(backend->get_root(), std::move(path)); });
+        preload_list.sounds = resolve_paths("sounds", [&](std::string path)
+                                            { return (backend->get_root_path() / path).string(); });
+        preload_list.files = resolve_paths("files", [&](std::string path)
+                                           { return (backend->get_root_path() / path).string(); });
+
+        backend->asset_preload_callbacks.push_back({preload_assets(std::move(preload_list), backend->sound_manager), callback.value_or(sol::function{})});
+    };
+
+    /// Runs `fun` of the table returned by the Lua file `module` (relative to the script) on a worker thread with `data` as its argument, for heavy work like pathfinding or generating levels that would stall the game.
+    /// The workers have their own Lua states with only the `base`, `math`, `string`, `table`, `utf8`, `json` and `binser` libraries: no game functions, no files and nothing shared with your script,
+    /// `data` and the return value are copied over with `binser`, so they can't contain functions or userdata. The module is loaded once per worker and again when the file changes.
+    /// `callback` runs on the first update after the job finished, its signature is nil callback(result, error), `error` is a string if the job failed.
+    /// A job that runs longer than `timeout` seconds (default 10) fails, and the jobs of a script are cancelled when it's unloaded. `module` has to be inside the script folder
+    lua["submit_job"] = [](std::string module, std::string fun, sol::object data, sol::optional<sol::function> callback, sol::optional<float> timeout, sol::this_state L)
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        std::filesystem::path path = (backend->get_root_path() / module).lexically_normal();
+        if (!path.has_extension())
+            path.replace_extension(".lua");
+        if (!check_safe_io_path(path.string(), backend->get_root_path().string()))
+            throw sol::error{"Job module '" + module + "' is outside of the script folder"};
+
+        std::string packed;
+        data.push(L);
+        try
+        {
+            packed = pack_lua_value(L, -1);
+        }
+        catch (const std::runtime_error& err)
+        {
+            lua_pop(L, 1);
+            throw sol::error{std::string{"Job data can't be sent to the worker: "} + err.what()};
+        }
+        lua_pop(L, 1);
+        const auto job_timeout = timeout ? std::chrono::milliseconds{static_cast<int64_t>(std::max(timeout.value(), 0.0f) * 1000.0f)} : LuaJobPool::DEFAULT_TIMEOUT;
+        auto cancel = std::make_shared<std::atomic_bool>(false);
+        backend->job_callbacks.push_back({LuaJobPool::get().submit(std::move(path), std::move(fun), std::move(packed), job_timeout, cancel), callback.value_or(sol::function{}), std::move(cancel)});
+    };
+
     /// Initializes some adventure run related values and loads the character select screen, as if starting a new adventure run from the Play menu. Character select can be skipped by changing `state.screen_next` right after calling this function, maybe with `warp()`. If player isn't already selected, make sure to set `state.items.player_select` and `state.items.player_count` appropriately too.
     lua["play_adventure"] = init_adventure;
 
@@ -1209,6 +1643,8 @@ end
     /// Use only for entities that can move around, (for static prefer [update_liquid_collision_at](#update_liquid_collision_at) )
     /// If entity is in back layer and liquid in the front, there will be no collision created, also collision is not destroyed when entity changes layers, so you have to handle that yourself
     lua["add_entity_to_liquid_collision"] = add_entity_to_liquid_collision;
+    /// Same as [add_entity_to_liquid_collision](#add_entity_to_liquid_collision) for every uid in the list
+    lua["add_entities_to_liquid_collision"] = add_entities_to_liquid_collision;
 
     lua.create_named_table("INPUTS", "NONE", 0x0, "JUMP", 0x1, "WHIP", 0x2, "BOMB", 0x4, "ROPE", 0x8, "RUN", 0x10, "DOOR", 0x20, "MENU", 0x40, "JOURNAL", 0x80, "LEFT", 0x100, "RIGHT", 0x200, "UP", 0x400, "DOWN", 0x800);
 
@@ -1404,7 +1840,9 @@ end
         "BLOCKED_GAME_LOOP",
         ON::BLOCKED_GAME_LOOP,
         "BLOCKED_PROCESS_INPUT",
-        ON::BLOCKED_PROCESS_INPUT);
+        ON::BLOCKED_PROCESS_INPUT,
+        "IDLE",
+        ON::IDLE);
 
     /* ON
     // LOGO
@@ -1661,6 +2099,10 @@ end
     // Runs instead of POST_GAME_LOOP when anything blocks a PRE_GAME_LOOP. Even runs in Playlunky when Overlunky blocks a PRE_GAME_LOOP.
     // BLOCKED_PROCESS_INPUT
     // Runs instead of POST_PROCESS_INPUT when anything blocks a PRE_PROCESS_INPUT. Even runs in Playlunky when Overlunky blocks a PRE_PROCESS_INPUT.
+    // IDLE
+    // Params: float slack_us
+    // Runs after the frame was presented, only when the frame finished early enough that there is time left before the next one is due. `slack_us` is that time in microseconds, stop working before it runs out and continue in the next IDLE.
+    // Meant for work that can wait, like warming caches or compacting saves. Never runs while the frame rate is uncapped, and the scripts take turns going first, scripts whose callbacks usually take longer than what's left are skipped for the frame.
     */
 
     /// Some arbitrary constants of the engine
@@ -1747,6 +2189,10 @@ end
     // ANKH
     // Ankh: Pauses all timers, physics and music, but not camera. Used by the ankh cutscene.
     */
+
+#ifdef SPEL2_LUA_FAST_PATHS
+    register_fast_paths(lua);
+#endif
 }
 
 std::recursive_mutex global_lua_lock;
@@ -1759,8 +2205,10 @@ std::shared_ptr<sol::state> acquire_lua_vm(class SoundManager* sound_manager)
     static std::shared_ptr<sol::state> global_vm = [sound_manager]()
     {
         std::unique_lock lock{global_lua_lock};
-        std::shared_ptr<sol::state> global_vms = std::make_shared<sol::state>();
+        // Everything allocated while no script runs is charged to the shared account, see push_calling_backend
+        std::shared_ptr<sol::state> global_vms = std::make_shared<sol::state>(sol::default_at_panic, &lua_memory_alloc);
         sol::state& lua_vm = *global_vms;
+        set_lua_memory_vm(lua_vm.lua_state());
         load_libraries(lua_vm);
         populate_lua_state(lua_vm, sound_manager);
 
@@ -1792,6 +2240,7 @@ std::shared_ptr<sol::state> acquire_lua_vm(class SoundManager* sound_manager)
             }
         }
 
+        LuaGcScheduler::get().init(lua_vm.lua_state());
         return global_vms;
     }();
     return global_vm;
@@ -1807,6 +2256,27 @@ sol::protected_function_result execute_lua(sol::environment& env, std::string_vi
     static sol::state& global_vm = get_lua_vm();
     return global_vm.safe_script(code, env, pass ? &sol::script_pass_on_error : &sol::script_default_on_error);
 }
+sol::protected_function_result execute_lua_cached(sol::environment& env, std::string_view code, std::string_view path)
+{
+    static sol::state& global_vm = get_lua_vm();
+    lua_State* L = global_vm.lua_state();
+    if (load_cached_lua_chunk(L, code, path) != LUA_OK)
+    {
+        // Compile it again through sol so the syntax error is reported like before
+        lua_pop(L, 1);
+        return execute_lua(env, code);
+    }
+
+    sol::protected_function chunk(L, -1);
+    lua_pop(L, 1);
+    sol::set_environment(env, chunk);
+    auto result = chunk();
+    if (!result.valid())
+    {
+        return sol::script_default_on_error(L, std::move(result));
+    }
+    return result;
+}
 
 bool check_safe_io_path(const std::string& filepath, const std::string& basepath)
 {
@@ -1883,6 +2353,39 @@ void add_partial_safe_libraries(sol::environment& env)
         return global_vm["io"]["open"](fullpath, mode);
     };
 
+    // Mapping is read only, so unlike open_mod this doesn't need a pack
+    auto map_data = [](std::string filename) -> std::shared_ptr<MappedFile>
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        auto is_pack = check_safe_io_path(backend->get_path(), "Mods/Packs");
+        auto is_safe = !backend->get_unsafe();
+        std::string moddir = backend->get_root_path().filename().string();
+        std::string luafile = std::filesystem::path(backend->get_path()).filename().string();
+        std::string datadir = "Mods/Data/" + (is_pack ? moddir : luafile);
+        std::string fullpath = datadir + "/" + filename;
+        auto is_based = check_safe_io_path(fullpath, datadir);
+        if (is_safe && !is_based)
+        {
+            luaL_error(global_vm, "Attempted to map data file outside data directory");
+            return nullptr;
+        }
+        return MappedFile::open(fullpath);
+    };
+
+    auto map_mod = [](std::string filename) -> std::shared_ptr<MappedFile>
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        auto is_safe = !backend->get_unsafe();
+        std::string fullpath = std::string(backend->get_root()) + "/" + filename;
+        auto is_based = check_safe_io_path(fullpath, backend->get_root());
+        if (is_safe && !is_based)
+        {
+            luaL_error(global_vm, "Attempted to map mod file outside mod directory");
+            return nullptr;
+        }
+        return MappedFile::open(fullpath);
+    };
+
     auto remove_data = [](std::string filename) -> sol::object
     {
         auto backend = LuaBackend::get_calling_backend();
@@ -1949,12 +2452,16 @@ void add_partial_safe_libraries(sol::environment& env)
         io["type"] = global_vm["io"]["type"];
         io["open_data"] = open_data;
         io["open_mod"] = open_mod;
+        io["map_data"] = map_data;
+        io["map_mod"] = map_mod;
         env["io"] = io;
     }
     else if (env["io"].get_type() == sol::type::table)
     {
         env["io"]["open_data"] = open_data;
         env["io"]["open_mod"] = open_mod;
+        env["io"]["map_data"] = map_data;
+        env["io"]["map_mod"] = map_mod;
     }
 }
 void hide_unsafe_libraries(sol::environment& env)
@@ -11,6 +11,8 @@ std::shared_ptr<sol::state> acquire_lua_vm(class SoundManager* sound_manager = n
 sol::state& get_lua_vm(class SoundManager* sound_manager = nullptr);
 
 sol::protected_function_result execute_lua(sol::environment& env, std::string_view code, bool pass = false);
+// Same as execute_lua, but reuses the compiled chunk from the bytecode cache when `code` didn't change since it was last run from `path`
+sol::protected_function_result execute_lua_cached(sol::environment& env, std::string_view code, std::string_view path);
 
 void populate_lua_env(sol::environment& env);
 void hide_unsafe_libraries(sol::environment& env);
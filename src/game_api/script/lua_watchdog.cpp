@@ -0,0 +1,50 @@
+#include "lua_watchdog.hpp"
+
+#include <lauxlib.h> // for luaL_error
+
+#include "lua_backend.hpp" // for LuaBackend
+
+LuaWatchdog& LuaWatchdog::get()
+{
+    static LuaWatchdog watchdog;
+    return watchdog;
+}
+
+void LuaWatchdog::enter()
+{
+    if (depth++ == 0)
+        executed = 0;
+}
+void LuaWatchdog::leave()
+{
+    if (depth > 0)
+        --depth;
+}
+
+void LuaWatchdog::count(lua_State* L, int instructions)
+{
+    // The hook also fires for code that runs outside of any callback, like the console, that has no budget
+    if (depth == 0)
+        return;
+    executed += instructions;
+    if (executed < BUDGET_INSTRUCTIONS)
+        return;
+
+    if (!LuaBackend::get_calling_backend()->infinite_loop_detection)
+    {
+        // Checked again after another budget, in case the script turns the detection back on
+        executed = 0;
+        return;
+    }
+    // Not reset, a pcall in the loop catching this only gets to run until the next check
+    luaL_error(L, "Hit Infinite Loop Detection of %d million instructions", static_cast<int>(BUDGET_INSTRUCTIONS / 1000000));
+}
+
+LuaWatchdog::Scope::Scope()
+{
+    get().enter();
+}
+LuaWatchdog::Scope::~Scope()
+{
+    get().leave();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint> // for uint32_t, uint64_t
+
+struct lua_State;
+
+// Infinite loop detection: every Lua thread of the vm has a rare count hook that adds up the instructions run by the outermost
+// callback, or the main chunk of a script, and errors out of it once it goes over the budget. Coroutines inherit the hook from
+// the thread that made them, time spent in C calls doesn't count so a callback waiting on the game is never taken for a loop
+class LuaWatchdog
+{
+  public:
+    static constexpr uint64_t BUDGET_INSTRUCTIONS = 420000000;
+    // Instructions between the checks, this rarely the hook costs next to nothing
+    static constexpr int HOOK_INSTRUCTIONS = 1000000;
+
+    static LuaWatchdog& get();
+
+    // Called by push_calling_backend, pop_calling_backend and around the main chunk, only the outermost one starts the count
+    void enter();
+    void leave();
+
+    // Called by the count hook with the instructions since it last ran on `L`
+    void count(lua_State* L, int instructions);
+
+    // Watches the main chunk of a script, that runs without a calling backend
+    class Scope
+    {
+      public:
+        Scope();
+        ~Scope();
+    };
+
+  private:
+    LuaWatchdog() = default;
+
+    uint32_t depth{0};
+    uint64_t executed{0};
+};
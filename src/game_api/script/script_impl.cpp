@@ -13,16 +13,21 @@
 #include <regex>         // for regex_search, regex
 #include <sol/sol.hpp>   // for table_proxy, optional, basic_envir...
 #include <sstream>       // for basic_istringstream, istringstream
+#include <string_view>   // for string_view
 #include <tuple>         // for get
 #include <type_traits>   // for move, conditional_t
 #include <unordered_map> // for unordered_map
 #include <utility>       // for max, min
+#include <vector>        // for vector
 
+#include "file_api.hpp"                   // for get_image_file_path, prewarm_image_cache
 #include "heap_base.hpp"                  // for HeapBase
 #include "logger.h"                       // for DEBUG
-#include "lua_vm.hpp"                     // for execute_lua, get_lua_vm
+#include "lua_vm.hpp"                     // for execute_lua, execute_lua_cached, get_lua_vm
 #include "script/handle_lua_function.hpp" // for handle_function
 #include "script/lua_backend.hpp"         // for LuaBackend, ON, ON::SCRIPT_DISABLE
+#include "script/lua_memory.hpp"          // for LuaMemoryScope
+#include "script/lua_watchdog.hpp"        // for LuaWatchdog
 #include "script_util.hpp"                // for sanitize
 
 class LuaConsole;
@@ -107,6 +112,30 @@ ScriptImpl::ScriptImpl(std::string script, std::string file, SoundManager* sound
     }
 }
 
+// Collects every string literal in the script that looks like an image path, resolved the same way define_texture does
+std::vector<std::string> find_referenced_images(std::string_view code, const char* root)
+{
+    std::vector<std::string> images;
+    size_t pos = 0;
+    while ((pos = code.find_first_of("\"'", pos)) != std::string_view::npos)
+    {
+        const char quote = code[pos];
+        const size_t end = code.find_first_of(quote == '"' ? "\"\n" : "'\n", pos + 1);
+        if (end == std::string_view::npos)
+            break;
+        if (code[end] == quote)
+        {
+            const std::string_view literal = code.substr(pos + 1, end - pos - 1);
+            if (literal.ends_with(".png") || literal.ends_with(".jpeg") || literal.ends_with(".bmp") || literal.ends_with(".tga"))
+            {
+                images.push_back(get_image_file_path(root, std::string{literal}));
+            }
+        }
+        pos = end + 1;
+    }
+    return images;
+}
+
 std::string ScriptImpl::script_id()
 {
     std::string newid = sanitize(meta.author) + "/" + sanitize(meta.name);
@@ -116,11 +145,36 @@ std::string ScriptImpl::script_id()
 bool ScriptImpl::reset()
 {
     LuaBackend::reset();
+    return run_code();
+}
+
+bool ScriptImpl::hot_reload()
+{
+    const std::unordered_map<std::string, sol::function> named_functions = collect_named_functions();
+    invalidate_changed_modules();
+    clear_all_callbacks(true);
+    entity_objects.entries.clear();
+
+    if (!run_code())
+        return false;
+    rebind_named_functions(named_functions);
+    return true;
+}
+
+bool ScriptImpl::run_code()
+{
+    // Start converting the images the script uses while it runs, so define_texture can load them from the cache
+    prewarm_image_cache(find_referenced_images(code, get_root()));
 
     // Compile & Evaluate the script if the script is changed
     try
     {
-        auto lua_result = execute_lua(lua, code);
+        auto lua_result = [this]()
+        {
+            LuaMemoryScope memory_scope{&get_memory_account()};
+            LuaWatchdog::Scope watchdog_scope;
+            return execute_lua_cached(lua, code, meta.file);
+        }();
 
         sol::optional<std::string> meta_name = lua["meta"]["name"];
         sol::optional<std::string> meta_version = lua["meta"]["version"];
@@ -150,13 +204,10 @@ void ScriptImpl::set_enabled(bool enbl)
     {
         auto cb_type = enbl ? ON::SCRIPT_ENABLE : ON::SCRIPT_DISABLE;
         auto now = HeapBase::get().frame_count();
-        for (auto& [id, callback] : callbacks)
+        for (auto& [id, callback] : callbacks.of(cb_type))
         {
-            if (callback.screen == cb_type)
-            {
-                handle_function<void>(this, callback.func);
-                callback.lastRan = now;
-            }
+            handle_function<void>(this, callback.func);
+            callback.lastRan = now;
         }
     }
     enabled = enbl;
@@ -2,6 +2,7 @@
 
 #include <filesystem> // for path
 #include <string>     // for string
+#include <utility>    // for exchange
 
 #include "lua_backend.hpp" // for LuaBackend
 #include "script.hpp"      // for ScriptMeta
@@ -19,6 +20,8 @@ class ScriptImpl : public LockableLuaBackend<ScriptImpl>
 #endif
 
     bool changed = true;
+    // The next reset for `changed` is a hot reload instead
+    bool hot_reload_requested = false;
     bool enabled = true;
     ScriptMeta meta = {"", "", "", "", "", "", "", "", "", false};
     std::filesystem::path script_folder;
@@ -32,13 +35,17 @@ class ScriptImpl : public LockableLuaBackend<ScriptImpl>
     std::string script_id();
 
     virtual bool reset() override;
+    // Runs the code again in the same environment without touching the hooks on single entities or their user data,
+    // modules that didn't change are not loaded again and the hooks call the functions defined under the same names now
+    bool hot_reload();
     virtual bool pre_update() override
     {
         if (changed)
         {
             result = "";
             changed = false;
-            if (!reset())
+            const bool hot = std::exchange(hot_reload_requested, false);
+            if (!(hot ? hot_reload() : reset()))
             {
                 return false;
             }
@@ -82,4 +89,7 @@ class ScriptImpl : public LockableLuaBackend<ScriptImpl>
 
     std::string execute(std::string str, bool raw = false);
     sol::protected_function_result execute_raw(std::string str);
+
+  private:
+    bool run_code();
 };
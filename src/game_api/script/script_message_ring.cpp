@@ -0,0 +1,133 @@
+#include "script_message_ring.hpp"
+
+#include <algorithm>    // for max
+#include <fmt/format.h> // for format
+#include <utility>      // for move, pair
+
+namespace
+{
+using namespace std::chrono_literals;
+
+// Same message again within this time only bumps a counter, the counter is published at most this often
+constexpr auto g_repeat_window = 1s;
+
+bool same_color(ImVec4 a, ImVec4 b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+} // namespace
+
+void ScriptMessageRing::push(std::string message, ImVec4 color)
+{
+    const auto now = std::chrono::system_clock::now();
+    if (capture_out != nullptr)
+    {
+        capture_out->push_back({std::move(message), now, color});
+        return;
+    }
+
+    if (now - last_time < g_repeat_window && same_color(color, last_color) && message == last_message)
+    {
+        repeats++;
+        return;
+    }
+    publish_repeats();
+
+    if (now - rate_window >= 1s)
+    {
+        rate_window = now;
+        rate_count = 0;
+    }
+    if (rate_count >= MAX_PER_SECOND)
+    {
+        dropped++;
+        return;
+    }
+    rate_count++;
+
+    last_message = message;
+    last_color = color;
+    last_time = now;
+    publish(std::move(message), now, color);
+}
+
+void ScriptMessageRing::flush()
+{
+    const auto now = std::chrono::system_clock::now();
+    if (repeats > 0 && now - last_time >= g_repeat_window)
+    {
+        publish_repeats();
+        // Keeps folding if the message is still spammed, so there's one summary per window
+        last_time = now;
+    }
+    if (dropped > 0 && now - rate_window >= 1s)
+    {
+        publish(fmt::format("({} more messages were dropped)", dropped), now, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+        dropped = 0;
+    }
+}
+
+void ScriptMessageRing::capture(std::vector<ScriptMessage>* out)
+{
+    capture_out = out;
+}
+
+void ScriptMessageRing::publish_repeats()
+{
+    if (repeats == 0)
+        return;
+    publish(fmt::format("(last message repeated {} times)", repeats), std::chrono::system_clock::now(), last_color);
+    repeats = 0;
+}
+
+void ScriptMessageRing::publish(std::string message, std::chrono::system_clock::time_point time, ImVec4 color)
+{
+    const uint64_t sequence = head.load(std::memory_order_relaxed);
+    slots[sequence % CAPACITY].store(std::make_shared<const Entry>(Entry{sequence, {std::move(message), time, color}}), std::memory_order_release);
+    head.store(sequence + 1, std::memory_order_release);
+}
+
+std::pair<uint64_t, uint64_t> ScriptMessageRing::readable() const
+{
+    const uint64_t end = head.load(std::memory_order_acquire);
+    const uint64_t begin = std::max(tail.load(std::memory_order_relaxed), end > CAPACITY ? end - CAPACITY : 0);
+    return {begin, end};
+}
+
+void ScriptMessageRing::for_each(const std::function<void(const ScriptMessage&)>& fun) const
+{
+    const auto [begin, end] = readable();
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        // The producer may have lapped the reader already, the entry keeps the old message alive but it's skipped since it was overwritten
+        const std::shared_ptr<const Entry> entry = slots[i % CAPACITY].load(std::memory_order_acquire);
+        if (entry != nullptr && entry->sequence == i)
+            fun(entry->message);
+    }
+}
+
+uint64_t ScriptMessageRing::for_each_since(uint64_t sequence, const std::function<void(const ScriptMessage&)>& fun) const
+{
+    const uint64_t end = head.load(std::memory_order_acquire);
+    for (uint64_t i = std::max(sequence, end > CAPACITY ? end - CAPACITY : 0); i < end; ++i)
+    {
+        const std::shared_ptr<const Entry> entry = slots[i % CAPACITY].load(std::memory_order_acquire);
+        if (entry != nullptr && entry->sequence == i)
+            fun(entry->message);
+    }
+    return end;
+}
+
+std::deque<ScriptMessage> ScriptMessageRing::consume()
+{
+    std::deque<ScriptMessage> messages;
+    const auto [begin, end] = readable();
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        const std::shared_ptr<const Entry> entry = slots[i % CAPACITY].load(std::memory_order_acquire);
+        if (entry != nullptr && entry->sequence == i)
+            messages.push_back(entry->message);
+    }
+    tail.store(end, std::memory_order_relaxed);
+    return messages;
+}
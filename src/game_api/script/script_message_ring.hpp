@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>      // for array
+#include <atomic>     // for atomic
+#include <chrono>     // for system_clock, time_point
+#include <cstddef>    // for size_t
+#include <cstdint>    // for uint32_t, uint64_t
+#include <deque>      // for deque
+#include <functional> // for function
+#include <imgui.h>    // for ImVec4
+#include <memory>     // for shared_ptr
+#include <string>     // for string
+#include <utility>    // for pair
+#include <vector>     // for vector
+
+#include "script.hpp" // for ScriptMessage
+
+// Bounded log of the messages printed by a backend, the oldest ones are overwritten once it's full
+// Written by the backend while it's locked and read by the UI and the spel2 dll without taking that lock, which is fine as long as
+// only one thread at a time consumes. Repeats of the last message and bursts of messages are folded into short summary lines
+class ScriptMessageRing
+{
+  public:
+    static constexpr size_t CAPACITY = 64;
+    // Messages over this per second are dropped and counted
+    static constexpr uint32_t MAX_PER_SECOND = 30;
+
+    // Producer side, backend has to be locked
+    void push(std::string message, ImVec4 color);
+    // Publishes the summaries of suppressed messages that are due, call once per frame
+    void flush();
+    // While set, messages are appended to `out` instead, unfiltered and in order (console command output)
+    void capture(std::vector<ScriptMessage>* out);
+
+    // Consumer side, calls `fun` for every message that is still in the ring and wasn't consumed yet, oldest first
+    void for_each(const std::function<void(const ScriptMessage&)>& fun) const;
+    // Calls `fun` for every message from `sequence` on that is still in the ring, consumed or not, returns the sequence to continue from
+    // Has its own cursor, so it doesn't interfere with consume
+    uint64_t for_each_since(uint64_t sequence, const std::function<void(const ScriptMessage&)>& fun) const;
+    // Returns every message that wasn't consumed yet and marks them consumed
+    std::deque<ScriptMessage> consume();
+
+  private:
+    struct Entry
+    {
+        uint64_t sequence;
+        ScriptMessage message;
+    };
+
+    void publish(std::string message, std::chrono::system_clock::time_point time, ImVec4 color);
+    void publish_repeats();
+    // Range of sequence numbers that can still be read
+    std::pair<uint64_t, uint64_t> readable() const;
+
+    std::array<std::atomic<std::shared_ptr<const Entry>>, CAPACITY> slots;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+
+    // Only touched by the producer
+    std::vector<ScriptMessage>* capture_out{nullptr};
+    std::string last_message;
+    ImVec4 last_color;
+    std::chrono::system_clock::time_point last_time;
+    uint32_t repeats{0};
+    std::chrono::system_clock::time_point rate_window;
+    uint32_t rate_count{0};
+    uint32_t dropped{0};
+};
@@ -18,42 +18,48 @@ float screenify(float dis)
     return dis / (1.0f / (res.x / 2));
 }
 
-ImVec2 screenify(ImVec2 pos)
+struct Letterbox
 {
-    ImGuiIO& io = ImGui::GetIO();
-    ImVec2 res = io.DisplaySize;
-    ImVec2 bar = {0.0, 0.0};
-    if (res.x / res.y > 1.78)
-    {
-        bar.x = (res.x - res.y / 9 * 16) / 2;
-        res.x = res.y / 9 * 16;
-    }
-    else if (res.x / res.y < 1.77)
+    ImVec2 display;
+    // The 16:9 game area and the bars around it
+    ImVec2 res;
+    ImVec2 bar;
+};
+// Only changes with the display size, so it's not worked out again for every position drawn in a frame
+static const Letterbox& get_letterbox()
+{
+    static Letterbox letterbox{{-1.0f, -1.0f}};
+    const ImVec2 display = ImGui::GetIO().DisplaySize;
+    if (display.x != letterbox.display.x || display.y != letterbox.display.y)
     {
-        bar.y = (res.y - res.x / 16 * 9) / 2;
-        res.y = res.x / 16 * 9;
+        ImVec2 res = display;
+        ImVec2 bar = {0.0, 0.0};
+        if (res.x / res.y > 1.78)
+        {
+            bar.x = (res.x - res.y / 9 * 16) / 2;
+            res.x = res.y / 9 * 16;
+        }
+        else if (res.x / res.y < 1.77)
+        {
+            bar.y = (res.y - res.x / 16 * 9) / 2;
+            res.y = res.x / 16 * 9;
+        }
+        letterbox = {display, res, bar};
     }
+    return letterbox;
+}
+
+ImVec2 screenify(ImVec2 pos)
+{
+    const auto& [display, res, bar] = get_letterbox();
     ImVec2 screened = ImVec2(pos.x / (1.0f / (res.x / 2)) + res.x / 2 + bar.x, res.y - (res.y / 2 * pos.y) - res.y / 2 + bar.y);
     return screened;
 }
 
 ImVec2 screenify_fix(ImVec2 pos)
 {
-    ImGuiIO& io = ImGui::GetIO();
     auto base = ImGui::GetMainViewport();
-
-    ImVec2 res = io.DisplaySize;
-    ImVec2 bar = {0.0, 0.0};
-    if (res.x / res.y > 1.78)
-    {
-        bar.x = (res.x - res.y / 9 * 16) / 2;
-        res.x = res.y / 9 * 16;
-    }
-    else if (res.x / res.y < 1.77)
-    {
-        bar.y = (res.y - res.x / 16 * 9) / 2;
-        res.y = res.x / 16 * 9;
-    }
+    const auto& [display, res, bar] = get_letterbox();
     ImVec2 screened = ImVec2(pos.x / (1.0f / (res.x / 2)) + res.x / 2 + bar.x + base->Pos.x, res.y - (res.y / 2 * pos.y) - res.y / 2 + bar.y + base->Pos.y);
     return screened;
 }
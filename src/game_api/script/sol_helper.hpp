@@ -6,6 +6,8 @@
 #include <span>
 #include <stdexcept>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include "member_function.hpp"
 
@@ -66,12 +68,90 @@ struct ZeroIndexArray
     size_t data_size{0};
 };
 
+template <class C, class = void>
+struct ContainerViewKeys
+{
+};
+template <class C>
+struct ContainerViewKeys<C, std::void_t<typename C::mapped_type>>
+{
+    using key_type = typename C::key_type;
+    using mapped_type = typename C::mapped_type;
+};
+
+// Containers are pushed to Lua as a copy, return one of these instead to give out a game owned container, like a
+// game_vector or game_unordered_map, without copying it. Indexing, # and pairs read it in place, and adding, replacing
+// or removing elements goes to the container the view points to, same as with a member pointer
+template <class C>
+struct ContainerView : ContainerViewKeys<C>
+{
+    using value_type = typename C::value_type;
+    using iterator = typename C::iterator;
+    using size_type = typename C::size_type;
+
+    explicit ContainerView(C& container)
+        : container{&container} {};
+
+    iterator begin() const
+    {
+        return container->begin();
+    }
+    iterator end() const
+    {
+        return container->end();
+    }
+    size_type size() const
+    {
+        return container->size();
+    }
+    bool empty() const
+    {
+        return container->empty();
+    }
+    template <class K>
+    iterator find(const K& key) const
+    {
+        return container->find(key);
+    }
+
+    template <class... Args>
+    auto insert(Args&&... args) const -> decltype(std::declval<C&>().insert(std::forward<Args>(args)...))
+    {
+        return container->insert(std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    auto emplace(Args&&... args) const -> decltype(std::declval<C&>().emplace(std::forward<Args>(args)...))
+    {
+        return container->emplace(std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    auto push_back(Args&&... args) const -> decltype(std::declval<C&>().push_back(std::forward<Args>(args)...))
+    {
+        return container->push_back(std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    auto erase(Args&&... args) const -> decltype(std::declval<C&>().erase(std::forward<Args>(args)...))
+    {
+        return container->erase(std::forward<Args>(args)...);
+    }
+    void clear() const
+    {
+        container->clear();
+    }
+
+    C* container;
+};
+
 namespace sol
 {
 template <class T>
 struct is_container<ZeroIndexArray<T>> : std::true_type
 {
 };
+template <class C>
+struct is_container<ContainerView<C>> : std::true_type
+{
+};
 
 template <class T>
 struct usertype_container<ZeroIndexArray<T>>
@@ -97,6 +177,16 @@ struct usertype_container<ZeroIndexArray<T>>
 };
 } // namespace sol
 
+// Binds a container member as a ContainerView, assigning to the field still replaces the whole container
+template <class T, class C>
+auto container_view_property(C T::*member)
+{
+    return sol::property([member](T& self)
+                         { return ContainerView{self.*member}; },
+                         [member](T& self, C value)
+                         { self.*member = std::move(value); });
+}
+
 namespace
 {
 template <typename, typename, auto>
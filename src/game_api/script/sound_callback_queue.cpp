@@ -0,0 +1,53 @@
+#include "sound_callback_queue.hpp"
+
+#include <utility> // for move
+
+SoundCallbackQueue::~SoundCallbackQueue()
+{
+    clear();
+}
+
+void SoundCallbackQueue::push(std::function<void()> callback)
+{
+    Node* node = new Node{std::move(callback), head.load(std::memory_order_relaxed)};
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+}
+
+SoundCallbackQueue::Node* SoundCallbackQueue::take()
+{
+    Node* node = head.exchange(nullptr, std::memory_order_acquire);
+    Node* oldest_first = nullptr;
+    while (node != nullptr)
+    {
+        Node* next = node->next;
+        node->next = oldest_first;
+        oldest_first = node;
+        node = next;
+    }
+    return oldest_first;
+}
+
+void SoundCallbackQueue::run()
+{
+    Node* node = take();
+    while (node != nullptr)
+    {
+        Node* next = node->next;
+        node->callback();
+        delete node;
+        node = next;
+    }
+}
+
+void SoundCallbackQueue::clear()
+{
+    Node* node = take();
+    while (node != nullptr)
+    {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>     // for atomic
+#include <functional> // for function
+
+// Callbacks pushed by FMOD's threads and run by the backend on the game thread, pushing never blocks so audio doesn't wait on scripts
+// Multiple producers, a single consumer, the callbacks run in the order they were pushed
+class SoundCallbackQueue
+{
+  public:
+    SoundCallbackQueue() = default;
+    SoundCallbackQueue(const SoundCallbackQueue&) = delete;
+    SoundCallbackQueue& operator=(const SoundCallbackQueue&) = delete;
+    ~SoundCallbackQueue();
+
+    // Any thread
+    void push(std::function<void()> callback);
+    // Consumer only, runs everything pushed so far
+    void run();
+    // Consumer only, drops everything pushed so far without running it
+    void clear();
+
+  private:
+    struct Node
+    {
+        std::function<void()> callback;
+        Node* next;
+    };
+    // Takes everything pushed so far, oldest first
+    Node* take();
+
+    // Newest first
+    std::atomic<Node*> head{nullptr};
+};
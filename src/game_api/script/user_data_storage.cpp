@@ -0,0 +1,150 @@
+#include "user_data_storage.hpp"
+
+#include <bit>     // for countr_zero
+#include <utility> // for move
+
+#include "entity.hpp" // for Entity, get_entity_ptr
+
+const UserDataStorage::Slot* UserDataStorage::find(uint32_t uid) const
+{
+    if (slots.empty())
+        return nullptr;
+    const size_t mask = slots.size() - 1;
+    for (size_t i = index(uid);; i = (i + 1) & mask)
+    {
+        const Slot& slot = slots[i];
+        if (slot.entity == nullptr && !slot.removed)
+            return nullptr;
+        if (slot.entity != nullptr && slot.uid == uid)
+            return &slot;
+    }
+}
+
+bool UserDataStorage::is_alive(const Slot& slot)
+{
+    return slot.entity != nullptr && get_entity_ptr(slot.uid) == slot.entity;
+}
+
+sol::object UserDataStorage::get(const Entity& entity) const
+{
+    // The entity passed in is alive, it only has to be the one the data was set on
+    const Slot* slot = find(entity.uid);
+    if (slot != nullptr && slot->entity == &entity)
+        return slot->data;
+    return sol::lua_nil;
+}
+sol::object UserDataStorage::get(uint32_t uid) const
+{
+    const Slot* slot = find(uid);
+    if (slot != nullptr && is_alive(*slot))
+        return slot->data;
+    return sol::lua_nil;
+}
+bool UserDataStorage::contains(uint32_t uid) const
+{
+    const Slot* slot = find(uid);
+    return slot != nullptr && is_alive(*slot);
+}
+
+void UserDataStorage::set(Entity& entity, sol::object data)
+{
+    if (data == sol::lua_nil)
+    {
+        if (Slot* slot = const_cast<Slot*>(find(entity.uid)))
+            remove_slot(*slot);
+        return;
+    }
+
+    // A new entry may take one more slot, keep the used and removed ones at half the capacity at most
+    if ((count + removed + 1) * 2 > slots.size())
+        rehash(count + 1);
+
+    const size_t mask = slots.size() - 1;
+    Slot* reuse = nullptr;
+    for (size_t i = index(entity.uid);; i = (i + 1) & mask)
+    {
+        Slot& slot = slots[i];
+        if (slot.entity != nullptr && slot.uid == entity.uid)
+        {
+            slot.entity = &entity;
+            slot.data = std::move(data);
+            return;
+        }
+        const bool empty = slot.entity == nullptr && !slot.removed;
+        if (reuse == nullptr && (slot.removed || (slot.entity != nullptr && !is_alive(slot))))
+            reuse = &slot;
+        if (empty)
+        {
+            if (reuse == nullptr)
+                reuse = &slot;
+            break;
+        }
+    }
+
+    // The uid isn't further down the chain, so the first removed or dead slot on the way can take it
+    if (reuse->removed)
+        removed--;
+    if (reuse->entity == nullptr)
+        count++;
+    reuse->uid = entity.uid;
+    reuse->removed = false;
+    reuse->entity = &entity;
+    reuse->data = std::move(data);
+}
+
+void UserDataStorage::remove_slot(Slot& slot)
+{
+    slot = Slot{};
+    slot.removed = true;
+    count--;
+    removed++;
+}
+
+void UserDataStorage::clear()
+{
+    slots.clear();
+    shift = 64;
+    count = 0;
+    removed = 0;
+    sweep_cursor = 0;
+}
+
+void UserDataStorage::sweep(size_t budget)
+{
+    if (count == 0)
+        return;
+    for (size_t i = 0; i < budget && i < slots.size(); ++i)
+    {
+        sweep_cursor = (sweep_cursor + 1) & (slots.size() - 1);
+        Slot& slot = slots[sweep_cursor];
+        if (slot.entity != nullptr && !is_alive(slot))
+            remove_slot(slot);
+    }
+}
+
+void UserDataStorage::rehash(size_t entries)
+{
+    size_t capacity = INITIAL_CAPACITY;
+    while ((entries + 1) * 2 > capacity)
+        capacity *= 2;
+
+    std::vector<Slot> old_slots = std::move(slots);
+    slots.clear();
+    slots.resize(capacity);
+    shift = 64 - static_cast<uint32_t>(std::countr_zero(capacity));
+    count = 0;
+    removed = 0;
+    sweep_cursor = 0;
+
+    const size_t mask = capacity - 1;
+    for (Slot& old_slot : old_slots)
+    {
+        if (!is_alive(old_slot))
+            continue;
+        size_t i = index(old_slot.uid);
+        while (slots[i].entity != nullptr)
+            i = (i + 1) & mask;
+        slots[i] = std::move(old_slot);
+        count++;
+    }
+}
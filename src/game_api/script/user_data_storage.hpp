@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint32_t
+#include <sol/sol.hpp> // for object
+#include <vector>      // for vector
+
+class Entity;
+
+// The user data a backend set on entities, in an open addressed slot array with linear probing from a hash of the uid
+// A slot also keeps the full uid and the entity it was set on, so it only counts while the uid still resolves to that entity,
+// with that nothing has to hook the dtors of the entities, the slots of destroyed ones are dropped by sweep or reused
+// Used and removed slots stay below half the capacity, so the size follows the amount of entries and not the range of the uids
+class UserDataStorage
+{
+  public:
+    static constexpr size_t INITIAL_CAPACITY = 1024;
+
+    // nil for entities without user data
+    sol::object get(const Entity& entity) const;
+    sol::object get(uint32_t uid) const;
+    bool contains(uint32_t uid) const;
+    // Setting nil removes it
+    void set(Entity& entity, sol::object data);
+    void clear();
+
+    // Drops the slots of destroyed entities among the next `budget` slots, called once per update
+    void sweep(size_t budget);
+
+    size_t size() const
+    {
+        return count;
+    }
+
+  private:
+    struct Slot
+    {
+        uint32_t uid{0};
+        // Removed slots keep the probe chains going past them until the next rehash
+        bool removed{false};
+        const Entity* entity{nullptr};
+        sol::object data;
+    };
+
+    size_t index(uint32_t uid) const
+    {
+        // Fibonacci hashing, uids are handed out in order and would otherwise fill one long run of slots
+        return static_cast<size_t>((uid * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+    const Slot* find(uint32_t uid) const;
+    static bool is_alive(const Slot& slot);
+    void remove_slot(Slot& slot);
+    // Rebuilds the array sized for `entries` live entries, dropping the removed and dead slots
+    void rehash(size_t entries);
+
+    std::vector<Slot> slots;
+    uint32_t shift{64};
+    size_t count{0};
+    size_t removed{0};
+    size_t sweep_cursor{0};
+};
@@ -16,7 +16,7 @@
 
 #include "math.hpp"                       // for Vec2
 #include "movable.hpp"                    // IWYU pragma: keep
-#include "movable_behavior.hpp"           // for CustomMovableBehavior, update_movable
+#include "movable_behavior.hpp"           // for CustomMovableBehavior, update_movable, BEHAVIOR_STEP
 #include "script/handle_lua_function.hpp" // for handle_function
 #include "script/lua_backend.hpp"         // for LuaBackend
 
@@ -152,5 +152,50 @@ void register_usertypes(sol::state& lua)
             return handle_function<uint8_t>(backend.get(), get_next_state_id, movable, std::move(base_fun)).value_or(behavior->state_id);
         };
     };
+
+    /// Add a native step to the `update_logic` of a `CustomMovableBehavior`, the steps run in the order they were added every frame
+    /// without calling into Lua, but only while no `update_logic` function is set. See `BEHAVIOR_STEP` for the meaning of `x`, `y` and `target_uid`
+    lua["CustomMovableBehavior"]["add_logic_step"] = [](CustomMovableBehavior* behavior, BEHAVIOR_STEP step, sol::optional<float> x, sol::optional<float> y, sol::optional<int32_t> target_uid) -> void
+    {
+        behavior->logic_steps.push_back({step, x.value_or(0.0f), y.value_or(0.0f), target_uid.value_or(-1)});
+    };
+    /// Add a native step to the `update_world` of a `CustomMovableBehavior`, the steps run in the order they were added every frame
+    /// without calling into Lua, but only while no `update_world` function is set. See `BEHAVIOR_STEP` for the meaning of `x`, `y` and `target_uid`
+    lua["CustomMovableBehavior"]["add_world_step"] = [](CustomMovableBehavior* behavior, BEHAVIOR_STEP step, sol::optional<float> x, sol::optional<float> y, sol::optional<int32_t> target_uid) -> void
+    {
+        behavior->world_steps.push_back({step, x.value_or(0.0f), y.value_or(0.0f), target_uid.value_or(-1)});
+    };
+    /// Add a native transition to `next_state`, checked every frame in the order they were added instead of calling `get_next_state_id`,
+    /// but only while no `get_next_state_id` function is set. The first transition that holds picks the next state, the movable stays in this
+    /// state when none does. Together with the steps and `set_on_enter`/`set_on_exit` Lua is only called when the state changes
+    lua["CustomMovableBehavior"]["add_transition"] = [](CustomMovableBehavior* behavior, BEHAVIOR_TRANSITION transition, uint8_t next_state, sol::optional<float> value, sol::optional<int32_t> target_uid) -> void
+    {
+        behavior->transitions.push_back({transition, next_state, value.value_or(0.0f), target_uid.value_or(-1)});
+    };
+    /// Remove all the native steps and transitions of a `CustomMovableBehavior`
+    lua["CustomMovableBehavior"]["clear_steps"] = [](CustomMovableBehavior* behavior) -> void
+    {
+        behavior->logic_steps.clear();
+        behavior->world_steps.clear();
+        behavior->transitions.clear();
+    };
+
+    /// Steps for `CustomMovableBehavior:add_logic_step` and `add_world_step`
+    /// BASE: call the function of the base behavior
+    /// GRAVITY: `velocityy -= x`, down to `-y`
+    /// SET_VELOCITY: set the velocity to `x, y`
+    /// MOVE_TOWARDS: set the velocity towards `target_uid` with a speed of `x`, stops when the target is gone
+    /// SET_MOVE: set `move` to `x, y`
+    /// UPDATE_MOVABLE: `generic_update_world` with the current `move`, gravity is disabled if `y > 0`
+    lua.create_named_table("BEHAVIOR_STEP", "BASE", BEHAVIOR_STEP::BASE, "GRAVITY", BEHAVIOR_STEP::GRAVITY, "SET_VELOCITY", BEHAVIOR_STEP::SET_VELOCITY, "MOVE_TOWARDS", BEHAVIOR_STEP::MOVE_TOWARDS, "SET_MOVE", BEHAVIOR_STEP::SET_MOVE, "UPDATE_MOVABLE", BEHAVIOR_STEP::UPDATE_MOVABLE);
+
+    /// Transitions for `CustomMovableBehavior:add_transition`
+    /// ALWAYS: always taken, add it last to fall back to a state
+    /// TIMER: after `value` frames in this state
+    /// ON_GROUND: when standing on something
+    /// TARGET_NEAR: when `target_uid` is closer than `value`
+    /// TARGET_FAR: when `target_uid` is further than `value` or gone
+    /// BASE: when the `get_next_state_id` of the base behavior leaves this state, `next_state` is ignored
+    lua.create_named_table("BEHAVIOR_TRANSITION", "ALWAYS", BEHAVIOR_TRANSITION::ALWAYS, "TIMER", BEHAVIOR_TRANSITION::TIMER, "ON_GROUND", BEHAVIOR_TRANSITION::ON_GROUND, "TARGET_NEAR", BEHAVIOR_TRANSITION::TARGET_NEAR, "TARGET_FAR", BEHAVIOR_TRANSITION::TARGET_FAR, "BASE", BEHAVIOR_TRANSITION::BASE);
 }
 }; // namespace NBehavior
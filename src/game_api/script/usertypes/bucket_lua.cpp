@@ -49,6 +49,11 @@ void register_usertypes(sol::state& lua)
     pauseapi_type["modifiers_down"] = &PauseAPI::modifiers_down;
     pauseapi_type["modifiers_block"] = &PauseAPI::modifiers_block;
     pauseapi_type["modifiers_clear_input"] = &PauseAPI::modifiers_clear_input;
+    pauseapi_type["trigger_spawn_types"] = &PauseAPI::trigger_spawn_types;
+    pauseapi_type["trigger_time_level"] = &PauseAPI::trigger_time_level;
+    pauseapi_type["last_trigger"] = &PauseAPI::last_trigger;
+    pauseapi_type["last_spawn_uid"] = &PauseAPI::last_spawn_uid;
+    pauseapi_type["last_error"] = &PauseAPI::last_error;
 
     /// Access the PauseAPI, or directly call `pause(true)` to enable current `pause.pause_type`
     // lua["pause"] = PauseAPI;
@@ -185,7 +190,7 @@ void register_usertypes(sol::state& lua)
     lua.create_named_table("PAUSE_TYPE", "NONE", PAUSE_TYPE::NONE, "MENU", PAUSE_TYPE::MENU, "FADE", PAUSE_TYPE::FADE, "CUTSCENE", PAUSE_TYPE::CUTSCENE, "FLAG4", PAUSE_TYPE::FLAG4, "FLAG5", PAUSE_TYPE::FLAG5, "ANKH", PAUSE_TYPE::ANKH, "PRE_UPDATE", PAUSE_TYPE::PRE_UPDATE, "PRE_GAME_LOOP", PAUSE_TYPE::PRE_GAME_LOOP, "PRE_PROCESS_INPUT", PAUSE_TYPE::PRE_PROCESS_INPUT, "FORCE_STATE", PAUSE_TYPE::FORCE_STATE);
 
     /// Used in PauseAPI
-    lua.create_named_table("PAUSE_TRIGGER", "NONE", PAUSE_TRIGGER::NONE, "FADE_START", PAUSE_TRIGGER::FADE_START, "FADE_END", PAUSE_TRIGGER::FADE_END, "SCREEN", PAUSE_TRIGGER::SCREEN, "ONCE", PAUSE_TRIGGER::ONCE, "EXIT", PAUSE_TRIGGER::EXIT);
+    lua.create_named_table("PAUSE_TRIGGER", "NONE", PAUSE_TRIGGER::NONE, "FADE_START", PAUSE_TRIGGER::FADE_START, "FADE_END", PAUSE_TRIGGER::FADE_END, "SCREEN", PAUSE_TRIGGER::SCREEN, "ONCE", PAUSE_TRIGGER::ONCE, "EXIT", PAUSE_TRIGGER::EXIT, "SPAWN", PAUSE_TRIGGER::SPAWN, "TIME_LEVEL", PAUSE_TRIGGER::TIME_LEVEL, "SCRIPT_ERROR", PAUSE_TRIGGER::SCRIPT_ERROR);
 
     /// Used in PauseAPI
     lua.create_named_table("PAUSE_SCREEN", "NONE", PAUSE_SCREEN::NONE, "LOGO", PAUSE_SCREEN::LOGO, "INTRO", PAUSE_SCREEN::INTRO, "PROLOGUE", PAUSE_SCREEN::PROLOGUE, "TITLE", PAUSE_SCREEN::TITLE, "MENU", PAUSE_SCREEN::MENU, "OPTIONS", PAUSE_SCREEN::OPTIONS, "PLAYER_PROFILE", PAUSE_SCREEN::PLAYER_PROFILE, "LEADERBOARD", PAUSE_SCREEN::LEADERBOARD, "SEED_INPUT", PAUSE_SCREEN::SEED_INPUT, "CHARACTER_SELECT", PAUSE_SCREEN::CHARACTER_SELECT, "TEAM_SELECT", PAUSE_SCREEN::TEAM_SELECT, "CAMP", PAUSE_SCREEN::CAMP, "LEVEL", PAUSE_SCREEN::LEVEL, "TRANSITION", PAUSE_SCREEN::TRANSITION, "DEATH", PAUSE_SCREEN::DEATH, "SPACESHIP", PAUSE_SCREEN::SPACESHIP, "WIN", PAUSE_SCREEN::WIN, "CREDITS", PAUSE_SCREEN::CREDITS, "SCORES", PAUSE_SCREEN::SCORES, "CONSTELLATION", PAUSE_SCREEN::CONSTELLATION, "RECAP", PAUSE_SCREEN::RECAP, "ARENA_MENU", PAUSE_SCREEN::ARENA_MENU, "ARENA_STAGES", PAUSE_SCREEN::ARENA_STAGES, "ARENA_ITEMS", PAUSE_SCREEN::ARENA_ITEMS, "ARENA_SELECT", PAUSE_SCREEN::ARENA_SELECT, "ARENA_INTRO", PAUSE_SCREEN::ARENA_INTRO, "ARENA_LEVEL", PAUSE_SCREEN::ARENA_LEVEL, "ARENA_SCORE", PAUSE_SCREEN::ARENA_SCORE, "ONLINE_LOADING", PAUSE_SCREEN::ONLINE_LOADING, "ONLINE_LOBBY", PAUSE_SCREEN::ONLINE_LOBBY, "LOADING", PAUSE_SCREEN::LOADING, "EXIT", PAUSE_SCREEN::EXIT);
@@ -1,14 +1,16 @@
 #include "drops_lua.hpp"
 
-#include <cstddef>     // for size_t
-#include <new>         // for operator new
-#include <sol/sol.hpp> // for proxy_key_t, global_table, state, table_proxy
-#include <tuple>       // for get
-#include <type_traits> // for move
-#include <utility>     // for max, min
-#include <vector>      // for vector
+#include <cstddef>       // for size_t
+#include <new>           // for operator new
+#include <sol/sol.hpp>   // for proxy_key_t, global_table, state, table_proxy
+#include <tuple>         // for get
+#include <type_traits>   // for move
+#include <unordered_map> // for unordered_map
+#include <utility>       // for max, min
+#include <vector>        // for vector
 
-#include "drops.hpp" // for drop_entries, dropchance_entries, replace_drop
+#include "drops.hpp"              // for drop_entries, dropchance_entries, replace_drop
+#include "script/lua_backend.hpp" // for LuaBackend
 
 namespace NDrops
 {
@@ -21,6 +23,23 @@ void register_usertypes(sol::state& lua)
     /// Use `0` as type to reset this drop to default, use `-1` as drop_id to reset all to default
     /// Check all the available drops [here](https://github.com/spelunky-fyi/overlunky/blob/main/src/game_api/drops.cpp)
     lua["replace_drop"] = replace_drop;
+    /// Same as calling set_drop_chance for every couple in the table, but all of them are applied at once (use e.g. set_drop_chances({[DROPCHANCE.MOLE_MATTOCK] = 10, [DROPCHANCE.YETI_PITCHERSMITT] = 2}))
+    /// The changes are remembered for your script, so reset_drops can put back just those. Returns the amount of drop chances that were changed
+    lua["set_drop_chances"] = [](std::unordered_map<DROPCHANCE, uint32_t> chances) -> size_t
+    {
+        return set_drop_chances({chances.begin(), chances.end()}, LuaBackend::get_calling_backend()->get_id());
+    };
+    /// Same as calling replace_drop for every couple in the table, but all of them are applied at once (use e.g. replace_drops({[DROP.VAN_HORSING_DIAMOND] = ENT_TYPE.ITEM_PLASMACANNON}))
+    /// The changes are remembered for your script, so reset_drops can put back just those. Returns the amount of drops that were replaced
+    lua["replace_drops"] = [](std::unordered_map<DROP, ENT_TYPE> drops) -> size_t
+    {
+        return replace_drops({drops.begin(), drops.end()}, LuaBackend::get_calling_backend()->get_id());
+    };
+    /// Resets the drop chances and drops your script changed with set_drop_chances and replace_drops to default
+    lua["reset_drops"] = []()
+    {
+        reset_drop_group(LuaBackend::get_calling_backend()->get_id());
+    };
 
     lua.create_named_table("DROPCHANCE"
                            //, "BONEBLOCK_SKELETONKEY", 0
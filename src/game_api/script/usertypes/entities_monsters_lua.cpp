@@ -11,6 +11,7 @@
 #include "entities_monsters.hpp" // for CritterSlime, Hundun, Tiamat, Critt...
 #include "entity.hpp"            // for Entity
 #include "illumination.hpp"      // IWYU pragma: keep
+#include "script/sol_helper.hpp" // for container_view_property
 #include "sound_manager.hpp"     // IWYU pragma: keep
 
 class Movable;
@@ -546,7 +547,7 @@ void register_usertypes(sol::state& lua)
         "jump_trigger",
         &Leprechaun::jump_trigger,
         "collected_treasure",
-        &Leprechaun::collected_treasure,
+        container_view_property(&Leprechaun::collected_treasure),
         sol::base_classes,
         sol::bases<Entity, Movable, PowerupCapable, Monster, WalkingMonster>());
 
@@ -0,0 +1,248 @@
+#include "entity_lookup_lua.hpp"
+
+#include <cmath>       // for round
+#include <cstdint>     // for uint32_t
+#include <memory>      // for unique_ptr, make_unique
+#include <new>         // for operator new
+#include <sol/sol.hpp> // for table, optional, state, constructors
+#include <string>      // for string
+#include <type_traits> // for move
+#include <vector>      // for vector
+
+#include "aliases.hpp"             // for ENT_TYPE, LAYER
+#include "entity_fields.hpp"       // for EntitySnapshot
+#include "entity_lookup.hpp"       // for EntityQuery, EntityListView, GridEntities, EntityFilter
+#include "layer.hpp"               // for g_level_max_x, g_level_max_y
+#include "math.hpp"                // for AABB
+#include "script/entity_delta.hpp" // for EntityDeltaStream
+#include "script/lua_backend.hpp"  // for LuaBackend
+
+namespace NEntityLookup
+{
+// Writes the results into `out` (removing leftovers from previous use) or a new table if not provided
+sol::table fill_table(sol::state& lua, const std::vector<uint32_t>& uids, sol::optional<sol::table> out)
+{
+    sol::table table = out ? std::move(out.value()) : lua.create_table(static_cast<int>(uids.size()), 0);
+    const size_t old_size = table.size();
+    for (size_t i = 0; i < uids.size(); ++i)
+    {
+        table.raw_set(i + 1, uids[i]);
+    }
+    for (size_t i = uids.size(); i < old_size; ++i)
+    {
+        table.raw_set(i + 1, sol::lua_nil);
+    }
+    return table;
+}
+
+EntityFilter make_entity_filter(const sol::table& conditions)
+{
+    EntityFilter filter;
+    for (const auto& [key, value] : conditions)
+    {
+        const std::string name = key.as<std::string>();
+        if (name == "types")
+        {
+            if (value.is<ENT_TYPE>())
+                filter.set_types({value.as<ENT_TYPE>()});
+            else
+                filter.set_types(value.as<std::vector<ENT_TYPE>>());
+        }
+        else if (name == "mask")
+            filter.mask = value.as<ENTITY_MASK>();
+        else if (name == "layer")
+            filter.layer = value.as<LAYER>();
+        else if (name == "flags")
+            filter.flags = value.as<uint32_t>();
+        else if (name == "not_flags")
+            filter.not_flags = value.as<uint32_t>();
+        else if (name == "more_flags")
+            filter.more_flags = value.as<uint32_t>();
+        else if (name == "not_more_flags")
+            filter.not_more_flags = value.as<uint32_t>();
+        else if (name == "state")
+            filter.state = value.as<uint8_t>();
+        else if (name == "min_health")
+            filter.min_health = value.as<uint8_t>();
+        else if (name == "max_health")
+            filter.max_health = value.as<uint8_t>();
+        else if (name == "owner_uid")
+            filter.owner_uid = value.as<int32_t>();
+        else if (name == "overlay_uid")
+            filter.overlay_uid = value.as<int32_t>();
+        else
+            // Silently ignoring a typo would make the filter pass everything
+            throw sol::error{"Unknown entity filter condition '" + name + "'"};
+    }
+    return filter;
+}
+
+void register_usertypes(sol::state& lua)
+{
+    /// Conditions for [filter_entities](#filter_entities) that are tested without calling into Lua for every entity, much faster than a predicate function for simple field tests.
+    /// Create it with `EntityFilter.new{ types = {...}, mask = MASK.MONSTER, min_health = 1 }` and reuse it, or pass the table to `filter_entities` directly. An entity passes when it passes every condition that is set:
+    /// `types` (ENT_TYPE or table of them), `mask`, `layer`, `flags`/`more_flags` (all these bits set), `not_flags`/`not_more_flags` (none of these bits set),
+    /// `state`, `min_health`, `max_health`, `owner_uid` (-1 for no owner) and `overlay_uid` (-1 for not attached). The conditions on `state`, `health` and `owner_uid` only pass movable entities.
+    lua.new_usertype<EntityFilter>(
+        "EntityFilter",
+        sol::factories([]()
+                       { return EntityFilter{}; },
+                       [](const sol::table& conditions)
+                       { return make_entity_filter(conditions); }),
+        "mask",
+        &EntityFilter::mask,
+        "layer",
+        &EntityFilter::layer,
+        "flags",
+        &EntityFilter::flags,
+        "not_flags",
+        &EntityFilter::not_flags,
+        "more_flags",
+        &EntityFilter::more_flags,
+        "not_more_flags",
+        &EntityFilter::not_more_flags,
+        "state",
+        &EntityFilter::state,
+        "min_health",
+        &EntityFilter::min_health,
+        "max_health",
+        &EntityFilter::max_health,
+        "owner_uid",
+        &EntityFilter::owner_uid,
+        "overlay_uid",
+        &EntityFilter::overlay_uid,
+        "set_types",
+        &EntityFilter::set_types);
+
+    /// Reusable version of the `get_entities_*` functions. The types are resolved once on creation and all the functions accept a table
+    /// that will be filled with the results instead of creating a new one each call, which avoids creating garbage in callbacks that run every frame.
+    lua.new_usertype<EntityQuery>(
+        "EntityQuery",
+        sol::constructors<EntityQuery(std::vector<ENT_TYPE>, ENTITY_MASK, LAYER), EntityQuery(ENT_TYPE, ENTITY_MASK, LAYER)>(),
+        "mask",
+        &EntityQuery::mask,
+        "layer",
+        &EntityQuery::layer,
+        "set_types",
+        &EntityQuery::set_types,
+        "get_entities",
+        [&lua](EntityQuery& query, sol::optional<sol::table> out) -> sol::table
+        { return fill_table(lua, query.get_entities(), std::move(out)); },
+        "get_entities_at",
+        [&lua](EntityQuery& query, float x, float y, float radius, sol::optional<sol::table> out) -> sol::table
+        { return fill_table(lua, query.get_entities_at(x, y, radius), std::move(out)); },
+        "get_entities_overlapping_hitbox",
+        [&lua](EntityQuery& query, AABB hitbox, sol::optional<sol::table> out) -> sol::table
+        { return fill_table(lua, query.get_entities_overlapping_hitbox(hitbox), std::move(out)); });
+
+    /// Read-only view of one of the entity lists the game keeps per layer. Index it with `view[i]` (1-based) and get the length with `#view`, both read the game's list directly
+    /// so nothing is copied into a table. The list changes while entities spawn and die, so don't hold on to indexes across frames.
+    lua.new_usertype<EntityListView>(
+        "EntityListView",
+        sol::no_constructor,
+        "size",
+        &EntityListView::size,
+        "contains",
+        &EntityListView::contains,
+        sol::meta_function::length,
+        &EntityListView::size,
+        sol::meta_function::index,
+        [](const EntityListView& view, uint32_t index) -> sol::optional<uint32_t>
+        {
+            if (index == 0)
+                return sol::nullopt;
+            if (auto uid = view.uid_at(index - 1))
+                return uid.value();
+            return sol::nullopt;
+        });
+
+    /// The entities that spawned, were destroyed or moved to the other layer during the last update, made with [subscribe_entity_deltas](#subscribe_entity_deltas).
+    /// Read it in `ON.POST_UPDATE`, the lists are replaced after every update. Like the `get_entities_*` functions they fill the `out` table if you pass one
+    lua.new_usertype<EntityDeltaStream>(
+        "EntityDeltaStream",
+        sol::no_constructor,
+        "get_spawned",
+        [&lua](const EntityDeltaStream& stream, sol::optional<sol::table> out) -> sol::table
+        { return fill_table(lua, stream.get_spawned(), std::move(out)); },
+        "get_destroyed",
+        [&lua](const EntityDeltaStream& stream, sol::optional<sol::table> out) -> sol::table
+        { return fill_table(lua, stream.get_destroyed(), std::move(out)); },
+        "get_moved",
+        [&lua](const EntityDeltaStream& stream, sol::optional<sol::table> out) -> sol::table
+        { return fill_table(lua, stream.get_moved(), std::move(out)); },
+        "unsubscribe",
+        &EntityDeltaStream::unsubscribe,
+        "is_subscribed",
+        &EntityDeltaStream::is_subscribed);
+
+    /// Start collecting the uids of the entities matching `mask` and `entity_types` (both optional) that spawn, get destroyed or change layers, see [EntityDeltaStream](#EntityDeltaStream).
+    /// Replaces diffing `get_entities()` every frame, the first lists are filled after the next update. Entities are only tracked while a stream is subscribed, call `unsubscribe` when you don't need it anymore, the script unloading does it too
+    lua["subscribe_entity_deltas"] = [](sol::optional<ENTITY_MASK> mask, sol::optional<std::vector<ENT_TYPE>> entity_types) -> EntityDeltaStream*
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        auto& stream = backend->entity_delta_streams.emplace_back(std::make_unique<EntityDeltaStream>(entity_types.value_or(std::vector<ENT_TYPE>{}), mask.value_or(ENTITY_MASK::ANY)));
+        return stream.get();
+    };
+
+    lua.new_usertype<EntitySnapshot>(
+        "EntitySnapshot",
+        sol::no_constructor,
+        "size",
+        &EntitySnapshot::size,
+        sol::meta_function::length,
+        &EntitySnapshot::size,
+        "get",
+        &EntitySnapshot::get,
+        "column",
+        &EntitySnapshot::column,
+        "serialize",
+        &EntitySnapshot::serialize);
+
+    /// Take the `fields` (names like in `Entity:get_fields`) of every entity matching `mask` in one pass over the entity lists, instead of reading them through the Entity of each uid.
+    /// Add `"uid"` to the fields to know which entity each row belongs to. `layer` is LAYER.BOTH by default, see [EntitySnapshot](#EntitySnapshot)
+    lua["snapshot_entities"] = [](ENTITY_MASK mask, std::vector<std::string> fields, sol::optional<LAYER> layer) -> EntitySnapshot
+    { return EntitySnapshot{mask, layer.value_or(LAYER::BOTH), fields}; };
+
+    /// Grid entities of a rectangle, returned by [get_grid_entities_in_rect](#get_grid_entities_in_rect)
+    lua.new_usertype<GridEntities>(
+        "GridEntities",
+        sol::no_constructor,
+        "x",
+        sol::readonly(&GridEntities::x),
+        "y",
+        sol::readonly(&GridEntities::y),
+        "width",
+        sol::readonly(&GridEntities::width),
+        "height",
+        sol::readonly(&GridEntities::height),
+        "uids",
+        sol::readonly(&GridEntities::uids),
+        "get",
+        &GridEntities::get);
+
+    /// Get the uids of all grid entities, such as floor or spikes, in the rectangle between two positions in one call, see [GridEntities](#GridEntities)
+    /// Same as calling [get_grid_entity_at](#get_grid_entity_at) for every tile, but reads a whole room at once.
+    lua["get_grid_entities_in_rect"] = get_grid_entities_in_rect;
+
+    /// Get a view of all entities in a layer, see [EntityListView](#EntityListView)
+    lua["get_entity_list_view"] = [](LAYER layer) -> EntityListView
+    { return EntityListView{EntityListView::Source::ALL, layer}; };
+    /// Get a view of the entities in a layer that belong to a single `mask`, see [EntityListView](#EntityListView)
+    lua["get_entity_list_view_by_mask"] = [](ENTITY_MASK mask, LAYER layer) -> EntityListView
+    { return EntityListView{EntityListView::Source::MASK, layer, static_cast<uint32_t>(mask)}; };
+    /// Get a view of the entities in a layer at draw depth `draw_depth`, see [EntityListView](#EntityListView)
+    lua["get_entity_list_view_by_draw_depth"] = [](uint8_t draw_depth, LAYER layer) -> EntityListView
+    { return EntityListView{EntityListView::Source::DRAW_DEPTH, layer, draw_depth}; };
+    /// Get a view of the static entities overlapping a grid position, like [get_entities_overlapping_grid](#get_entities_overlapping_grid) but without copying, see [EntityListView](#EntityListView)
+    lua["get_entity_list_view_overlapping_grid"] = [](float x, float y, LAYER layer) -> EntityListView
+    {
+        // Checked as floats first, converting a negative or huge float to an unsigned int is undefined
+        const float rx = std::round(x);
+        const float ry = std::round(y);
+        if (!(rx >= 0.0f && rx < g_level_max_x && ry >= 0.0f && ry < g_level_max_y))
+            return EntityListView{EntityListView::Source::GRID, layer, UINT32_MAX};
+        const uint32_t key = static_cast<uint32_t>(ry) * g_level_max_x + static_cast<uint32_t>(rx);
+        return EntityListView{EntityListView::Source::GRID, layer, key};
+    };
+}
+} // namespace NEntityLookup
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <sol/forward.hpp> // for table
+
+struct EntityFilter;
+
+namespace sol
+{
+class state;
+} // namespace sol
+
+namespace NEntityLookup
+{
+void register_usertypes(sol::state& lua);
+// Builds a filter from a table of conditions, see the `EntityFilter` docs for the keys
+EntityFilter make_entity_filter(const sol::table& conditions);
+}
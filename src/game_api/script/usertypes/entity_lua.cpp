@@ -1,22 +1,26 @@
 #include "entity_lua.hpp"
 
-#include <algorithm>   // for max
-#include <cstdint>     // for uint16_t, int8_t, uint32_t, uint8_t
-#include <exception>   // for exception
-#include <map>         // for map, _Tree_const_iterator
-#include <new>         // for operator new
-#include <sol/sol.hpp> // for proxy_key_t, data_t, state, property
-#include <string>      // for operator==, allocator, string
-#include <tuple>       // for get
-#include <type_traits> // for move, declval
-#include <utility>     // for min, max, swap, pair
-#include <vector>      // for _Vector_iterator, vector, _Vector_...
+#include <algorithm>    // for max
+#include <cstdint>      // for uint16_t, int8_t, uint32_t, uint8_t
+#include <exception>    // for exception
+#include <fmt/format.h> // for format
+#include <map>          // for map, _Tree_const_iterator
+#include <new>          // for operator new
+#include <sol/sol.hpp>  // for proxy_key_t, data_t, state, property
+#include <stdexcept>    // for runtime_error
+#include <string>       // for operator==, allocator, string
+#include <string_view>  // for string_view
+#include <tuple>        // for get
+#include <type_traits>  // for move, declval
+#include <utility>      // for min, max, swap, pair
+#include <vector>       // for _Vector_iterator, vector, _Vector_...
 
 #include "color.hpp"                     // for Color, Color::a, Color::b, Color::g
 #include "containers/game_allocator.hpp" // for game_allocator
 #include "custom_types.hpp"              // for get_custom_types_vector
 #include "entities_chars.hpp"            // for Player
 #include "entity.hpp"                    // for Entity, EntityDB, Animation, Rect
+#include "entity_fields.hpp"             // for find_entity_field, read_entity_field
 #include "entity_lookup.hpp"             // for entity_has_item_type
 #include "items.hpp"                     // for Inventory
 #include "math.hpp"                      // for Quad, AABB
@@ -181,6 +185,30 @@ void register_usertypes(sol::state& lua)
     { ent.set_draw_depth(draw_depth, unknown.value_or(0)); }; // for backward compatibility
 
     entity_type["reset_draw_depth"] = &Entity::reset_draw_depth;
+    entity_type["get_fields"] = [](Entity& ent, sol::table names, sol::this_state L) -> sol::table
+    {
+        const bool is_movable = ent.is_movable();
+        sol::state_view lua{L};
+        sol::table result = lua.create_table(0, (int)names.size());
+        for (size_t i = 1; i <= names.size(); ++i)
+        {
+            const std::string_view name = names.get<std::string_view>(i);
+            const EntityField* field = find_entity_field(name);
+            if (field == nullptr)
+                throw std::runtime_error(fmt::format("get_fields: no field '{}'", name));
+            if (field->movable && !is_movable)
+                continue;
+
+            const double value = read_entity_field(&ent, *field);
+            if (is_integer_field(*field))
+                result[name] = (int64_t)value;
+            else if (field->type == ENTITY_FIELD_TYPE::BOOL)
+                result[name] = value != 0.0;
+            else
+                result[name] = value;
+        }
+        return result;
+    };
     entity_type["friction"] = &Entity::friction;
     entity_type["set_enable_turning"] = &Entity::set_enable_turning;
 
@@ -327,8 +355,6 @@ void register_usertypes(sol::state& lua)
 
     lua.new_usertype<CutsceneBehavior>("CutsceneBehavior", sol::no_constructor);
 
-    /// Get the Entity behind an uid, converted to the correct type. To see what type you will get, consult the [entity hierarchy list](https://github.com/spelunky-fyi/overlunky/blob/main/docs/entities-hierarchy.md)
-    // lua["get_entity"] = [](uint32_t uid) -> Entity*{};
     /// NoDoc
     /// Get the [Entity](#Entity) behind an uid, without converting to the correct type (do not use, use `get_entity` instead)
     lua["get_entity_raw"] = get_entity_ptr;
@@ -345,19 +371,29 @@ void register_usertypes(sol::state& lua)
                 return entity_raw
             end
         end
-        function get_entity(ent_uid)
-            if ent_uid == nil then
-                return nil
-            end
-
-            local entity_raw = get_entity_raw(ent_uid)
-            if entity_raw == nil then
-                return nil
-            end
-
-            return cast_entity(entity_raw)
-        end
         )##");
+    /// Get the Entity behind an uid, converted to the correct type. To see what type you will get, consult the [entity hierarchy list](https://github.com/spelunky-fyi/overlunky/blob/main/docs/entities-hierarchy.md)
+    /// Returns the same userdata for the same entity until it's destroyed or a state is loaded
+    // lua["get_entity"] = [](uint32_t uid) -> Entity*{};
+    lua["get_entity"] = [](sol::optional<uint32_t> uid) -> sol::object
+    {
+        if (!uid.has_value())
+            return sol::lua_nil;
+        return LuaBackend::get_calling_backend()->get_entity_object(get_entity_ptr(uid.value()));
+    };
+    /// Get the Entities behind a list of uids, same as calling [get_entity](#get_entity) for each one but faster for long lists. Uids that don't exist are `nil` in the result
+    lua["get_entities_from_uids"] = [](std::vector<uint32_t> uids) -> sol::table
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        const std::vector<Entity*> entities = get_entities_ptr(uids);
+        sol::table result = backend->vm->create_table(static_cast<int>(entities.size()), 0);
+        for (size_t i = 0; i < entities.size(); ++i)
+        {
+            if (entities[i] != nullptr)
+                result[i + 1] = backend->get_entity_object(entities[i]);
+        }
+        return result;
+    };
     /// Get the [EntityDB](#EntityDB) behind an ENT_TYPE...
     lua["get_type"] = get_type;
     /// Get the ENT_TYPE... of the entity by uid
@@ -371,6 +407,8 @@ void register_usertypes(sol::state& lua)
         static_cast<void (*)(uint32_t, float, float, float, float, LAYER)>(::move_entity_abs));
     /// Teleport entity to coordinates with optional velocity
     lua["move_entity"] = move_entity_abs;
+    /// Teleport many entities at once, same as calling [move_entity](#move_entity) with zero velocity for each uid but without paying the call overhead for each one
+    lua["move_entities"] = ::move_entities_abs;
     /// Teleport grid entity, the destination should be whole number, this ensures that the collisions will work properly
     lua["move_grid_entity"] = move_grid_entity;
     auto destroy_grid = sol::overload(
@@ -467,6 +505,22 @@ void register_usertypes(sol::state& lua)
         static_cast<std::vector<uint32_t> (*)(uint32_t, std::vector<ENT_TYPE>, ENTITY_MASK)>(::entity_get_items_by));
     /// Gets uids of entities attached to given entity uid. Use `entity_type` and `mask` ([MASK](#MASK)) to filter, set them to 0 to return all attached entities.
     lua["entity_get_items_by"] = entity_get_items_by;
+    auto for_each_descendant_lua = [](uint32_t uid, ENTITY_MASK mask, std::vector<ENT_TYPE> entity_types, sol::function fun)
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        ::for_each_descendant(uid, mask, std::move(entity_types), [&](Entity* ent)
+                              {
+                                  sol::object stop = fun(backend->get_entity_object(ent));
+                                  return stop.is<bool>() && stop.as<bool>(); });
+    };
+    auto for_each_descendant = sol::overload(
+        [for_each_descendant_lua](uint32_t uid, ENTITY_MASK mask, ENT_TYPE entity_type, sol::function fun)
+        { for_each_descendant_lua(uid, mask, {entity_type}, std::move(fun)); },
+        for_each_descendant_lua);
+    /// Calls `fun` with every entity attached to the given entity uid, including the ones attached to its items and so on, if it matches `entity_type` and `mask` ([MASK](#MASK)). Set them to 0 to get all of them, can also use table of entity_types.
+    /// Entities come before the entity they are attached to, return `true` from `fun` to stop early. Faster than walking the items with [entity_get_items_by](#entity_get_items_by).
+    /// The callback signature is bool fun(Entity ent)
+    lua["for_each_descendant"] = for_each_descendant;
     /// Kills an entity by uid. `destroy_corpse` defaults to `true`, if you are killing for example a caveman and want the corpse to stay make sure to pass `false`.
     lua["kill_entity"] = kill_entity;
     /// Pick up another entity by uid. Make sure you're not already holding something, or weird stuff will happen.
@@ -13,7 +13,7 @@
 #include "memory.hpp"                    // for memory_read TODO:temp
 #include "savedata.hpp"                  // for SaveData
 #include "screen.hpp"                    // IWYU pragma: keep
-#include "script/sol_helper.hpp"         // for ZeroIndexArray
+#include "script/sol_helper.hpp"         // for ZeroIndexArray, container_view_property
 
 namespace NGM
 {
@@ -86,23 +86,23 @@ void register_usertypes(sol::state& lua)
         "journal_popup_ui",
         &SaveRelated::journal_popup_ui,
         "places_data",
-        &SaveRelated::places_data,
+        container_view_property(&SaveRelated::places_data),
         "bestiary_data",
-        &SaveRelated::bestiary_data,
+        container_view_property(&SaveRelated::bestiary_data),
         "monster_part_to_main",
-        &SaveRelated::monster_part_to_main,
+        container_view_property(&SaveRelated::monster_part_to_main),
         "people_info",
-        &SaveRelated::people_info,
+        container_view_property(&SaveRelated::people_info),
         "people_part_to_main",
-        &SaveRelated::people_part_to_main,
+        container_view_property(&SaveRelated::people_part_to_main),
         "item_info",
-        &SaveRelated::item_info,
+        container_view_property(&SaveRelated::item_info),
         "trap_info",
-        &SaveRelated::trap_info,
+        container_view_property(&SaveRelated::trap_info),
         "trap_part_to_main",
-        &SaveRelated::trap_part_to_main,
+        container_view_property(&SaveRelated::trap_part_to_main),
         "stickers_data",
-        &SaveRelated::stickers_data,
+        container_view_property(&SaveRelated::stickers_data),
         "get_savegame",
         &SaveRelated::get_savegame);
 
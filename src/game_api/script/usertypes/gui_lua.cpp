@@ -1,10 +1,11 @@
 #include "gui_lua.hpp"
 
-#include <Windows.h>        // for GetProcAddress, DWORD, LoadLibraryA
+#include <Windows.h>        // for VK_RMENU, VK_LCONTROL
 #include <algorithm>        // for max
 #include <chrono>           // for system_clock
 #include <cmath>            // for isnan, floor
 #include <cstddef>          // for NULL
+#include <cstring>          // for memcpy
 #include <deque>            // for deque
 #include <exception>        // for exception
 #include <filesystem>       // for operator/, path
@@ -13,31 +14,27 @@
 #include <imgui_internal.h> // for GImGui
 #include <map>              // for map
 #include <new>              // for operator new
+#include <optional>         // for optional, nullopt
 #include <sol/sol.hpp>      // for proxy_key_t, data_t, state, property
 #include <tuple>            // for get, tuple, make_tuple
 #include <type_traits>      // for move, declval, reference_wrapper, ref
 #include <unordered_set>    // for unordered_set
 #include <utility>          // for max, min, pair, get, make_pair
-#include <xinput.h>         // for XINPUT_STATE, XINPUT_CAPABILITIES
 
 #include "bucket.hpp"
-#include "file_api.hpp"                   // for create_d3d11_texture_from_file
+#include "file_api.hpp"                   // for get_image_size_from_file
+#include "image_cache.hpp"                // for acquire_cached_image, CachedImage
+#include "input_snapshot.hpp"             // for InputSnapshots, InputSnapshot, Gamepad
 #include "math.hpp"                       // for Vec2
-#include "script.hpp"                     // for ScriptMessage, ScriptImage
+#include "point_buffer_lua.hpp"           // for get_poly_points
+#include "screen_transform.hpp"           // for ScreenTransform
+#include "script.hpp"                     // for ScriptMessage
 #include "script/handle_lua_function.hpp" // for handle_function
 #include "script/lua_backend.hpp"         // for LuaBackend
 #include "script/script_util.hpp"         // for screenify_fix, screenify, normalize
 #include "script/sol_helper.hpp"          //
 #include "window_api.hpp"                 // for hide_cursor, show_cursor
 
-typedef DWORD(WINAPI* PFN_XInputGetCapabilities)(DWORD, DWORD, XINPUT_CAPABILITIES*);
-typedef DWORD(WINAPI* PFN_XInputGetState)(DWORD, XINPUT_STATE*);
-static bool g_HasGamepad = false;
-static bool g_WantUpdateHasGamepad = false;
-static HMODULE g_XInputDLL = NULL;
-static PFN_XInputGetCapabilities g_XInputGetCapabilities = NULL;
-static PFN_XInputGetState g_XInputGetState = NULL;
-
 const int OL_KEY_CTRL = 0x100;
 const int OL_KEY_SHIFT = 0x200;
 const int OL_KEY_ALT = 0x800;
@@ -49,29 +46,9 @@ const int OL_WHEEL_UP = 0x12;
 Vec2::Vec2(const ImVec2& p) noexcept
     : x(p.x), y(p.y){};
 
-struct Gamepad : XINPUT_GAMEPAD
-{
-    /*
-    GAMEPAD wButtons; // just for the autodoc
-    */
-    bool enabled;
-};
-
 Gamepad get_gamepad(unsigned int index = 1)
 {
-    if (g_WantUpdateHasGamepad)
-    {
-        XINPUT_CAPABILITIES caps;
-        g_HasGamepad = g_XInputGetCapabilities ? (g_XInputGetCapabilities(index - 1, XINPUT_FLAG_GAMEPAD, &caps) == ERROR_SUCCESS) : false;
-        // g_WantUpdateHasGamepad = false;
-    }
-
-    XINPUT_STATE xinput_state;
-    if (g_HasGamepad && g_XInputGetState && g_XInputGetState(index - 1, &xinput_state) == ERROR_SUCCESS)
-    {
-        return {xinput_state.Gamepad, true};
-    }
-    return Gamepad{{0}};
+    return InputSnapshots::get().current().get_gamepad(index);
 }
 
 [[maybe_unused]] const ImVec4 error_color{1.0f, 0.2f, 0.2f, 1.0f};
@@ -86,6 +63,171 @@ Gamepad get_gamepad(unsigned int index = 1)
     return ImVec2(lhs.x - rhs.x, lhs.y - rhs.y);
 }
 
+GuiDrawList::GuiDrawList() = default;
+GuiDrawList::~GuiDrawList() = default;
+
+void GuiDrawList::add(std::function<void(ImDrawList*)> shape)
+{
+    shapes.push_back(std::move(shape));
+    dirty = true;
+}
+void GuiDrawList::add_line(float x1, float y1, float x2, float y2, float thickness, uColor color)
+{
+    add([=](ImDrawList* dl)
+        { dl->AddLine(screenify_fix({x1, y1}), screenify_fix({x2, y2}), color, thickness); });
+}
+void GuiDrawList::add_rect(AABB rect, float thickness, float rounding, uColor color)
+{
+    // check for nan in the vectors because this will cause a crash in ImGui
+    if (isnan(rect.left) || isnan(rect.top) || isnan(rect.right) || isnan(rect.bottom))
+        return;
+    add([=](ImDrawList* dl)
+        { dl->AddRect(screenify_fix({rect.left, rect.top}), screenify_fix({rect.right, rect.bottom}), color, rounding, ImDrawCornerFlags_All, thickness); });
+}
+void GuiDrawList::add_rect_filled(AABB rect, float rounding, uColor color)
+{
+    if (isnan(rect.left) || isnan(rect.top) || isnan(rect.right) || isnan(rect.bottom))
+        return;
+    add([=](ImDrawList* dl)
+        { dl->AddRectFilled(screenify_fix({rect.left, rect.top}), screenify_fix({rect.right, rect.bottom}), color, rounding, ImDrawCornerFlags_All); });
+}
+void GuiDrawList::add_triangle(Vec2 p1, Vec2 p2, Vec2 p3, float thickness, uColor color)
+{
+    add([=](ImDrawList* dl)
+        { dl->AddTriangle(screenify_fix({p1.x, p1.y}), screenify_fix({p2.x, p2.y}), screenify_fix({p3.x, p3.y}), color, thickness); });
+}
+void GuiDrawList::add_triangle_filled(Vec2 p1, Vec2 p2, Vec2 p3, uColor color)
+{
+    add([=](ImDrawList* dl)
+        { dl->AddTriangleFilled(screenify_fix({p1.x, p1.y}), screenify_fix({p2.x, p2.y}), screenify_fix({p3.x, p3.y}), color); });
+}
+void GuiDrawList::add_poly(std::vector<Vec2> points, float thickness, uColor color)
+{
+    add([=, points = std::move(points)](ImDrawList* dl)
+        {
+            dl->PathClear();
+            for (auto& point : points)
+                dl->PathLineToMergeDuplicate(screenify_fix({point.x, point.y}));
+            dl->PathStroke(color, 0, thickness); });
+}
+void GuiDrawList::add_poly_filled(std::vector<Vec2> points, uColor color)
+{
+    add([=, points = std::move(points)](ImDrawList* dl)
+        {
+            dl->PathClear();
+            for (auto& point : points)
+                dl->PathLineToMergeDuplicate(screenify_fix({point.x, point.y}));
+            dl->PathFillConvex(color); });
+}
+void GuiDrawList::add_circle(float x, float y, float radius, float thickness, uColor color)
+{
+    // check for nan in the vectors and radius because this will cause a crash in ImGui
+    if (isnan(x) || isnan(y) || isnan(radius))
+        return;
+    add([=](ImDrawList* dl)
+        { dl->AddCircle(screenify_fix({x, y}), screenify(radius), color, 0, thickness); });
+}
+void GuiDrawList::add_circle_filled(float x, float y, float radius, uColor color)
+{
+    if (isnan(x) || isnan(y) || isnan(radius))
+        return;
+    add([=](ImDrawList* dl)
+        { dl->AddCircleFilled(screenify_fix({x, y}), screenify(radius), color, 0); });
+}
+void GuiDrawList::clear()
+{
+    shapes.clear();
+    dirty = true;
+}
+size_t GuiDrawList::size() const
+{
+    return shapes.size();
+}
+void GuiDrawList::rebuild()
+{
+    if (!cache)
+        cache = std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData());
+
+    cache->_ResetForNewFrame();
+    cache->PushClipRectFullScreen();
+    cache->PushTextureID(ImGui::GetIO().Fonts->TexID);
+    for (auto& shape : shapes)
+        shape(cache.get());
+
+    built_top_left = screenify_fix({-1.0f, 1.0f});
+    built_bottom_right = screenify_fix({1.0f, -1.0f});
+    dirty = false;
+}
+void GuiDrawList::submit(ImDrawList* target, ImVec2 offset)
+{
+    if (shapes.empty())
+        return;
+    // screenify_fix depends on the display size and main viewport position, the vertices are only valid for the ones they were built with
+    const Vec2 top_left = screenify_fix({-1.0f, 1.0f});
+    const Vec2 bottom_right = screenify_fix({1.0f, -1.0f});
+    if (dirty || !(built_top_left == top_left) || !(built_bottom_right == bottom_right))
+        rebuild();
+    append_draw_list(*cache, target, offset);
+}
+
+void append_draw_list(const ImDrawList& source, ImDrawList* target, ImVec2 offset)
+{
+    // Each cmd matches a range of vertices starting at its VtxOffset, a new range only starts when the 16 bit indices ran out
+    // or the texture changed, in which case the vertices up to the next cmd's range may be shared by both cmds
+    const ImVector<ImDrawCmd>& cmds = source.CmdBuffer;
+    for (int i = 0; i < cmds.Size; ++i)
+    {
+        const ImDrawCmd& cmd = cmds[i];
+        if (cmd.ElemCount == 0 || cmd.UserCallback != nullptr)
+            continue;
+        int next = i + 1;
+        while (next < cmds.Size && cmds[next].VtxOffset == cmd.VtxOffset)
+            next++;
+        const int vtx_begin = static_cast<int>(cmd.VtxOffset);
+        const int vtx_end = next < cmds.Size ? static_cast<int>(cmds[next].VtxOffset) : source.VtxBuffer.Size;
+        const ImDrawIdx* src_idx = source.IdxBuffer.Data + cmd.IdxOffset;
+        const int idx_count = static_cast<int>(cmd.ElemCount);
+        // Only copy the vertices this cmd uses when the range is shared with cmds of other textures
+        int used_begin = vtx_begin;
+        int used_end = vtx_end;
+        if (next != i + 1 || (i > 0 && cmds[i - 1].VtxOffset == cmd.VtxOffset))
+        {
+            used_begin = vtx_end;
+            used_end = vtx_begin;
+            for (int n = 0; n < idx_count; ++n)
+            {
+                used_begin = std::min(used_begin, vtx_begin + src_idx[n]);
+                used_end = std::max(used_end, vtx_begin + src_idx[n] + 1);
+            }
+        }
+        const int vtx_count = used_end - used_begin;
+
+        const bool push_texture_id = cmd.TextureId != target->_CmdHeader.TextureId;
+        if (push_texture_id)
+            target->PushTextureID(cmd.TextureId);
+        target->PrimReserve(idx_count, vtx_count);
+        const ImDrawIdx base = static_cast<ImDrawIdx>(target->_VtxCurrentIdx);
+        const int rebase = vtx_begin - used_begin;
+        std::memcpy(target->_VtxWritePtr, source.VtxBuffer.Data + used_begin, sizeof(ImDrawVert) * vtx_count);
+        if (offset.x != 0.0f || offset.y != 0.0f)
+        {
+            for (int v = 0; v < vtx_count; ++v)
+            {
+                target->_VtxWritePtr[v].pos.x += offset.x;
+                target->_VtxWritePtr[v].pos.y += offset.y;
+            }
+        }
+        for (int n = 0; n < idx_count; ++n)
+            target->_IdxWritePtr[n] = static_cast<ImDrawIdx>(src_idx[n] + rebase + base);
+
+        target->_VtxWritePtr += vtx_count;
+        target->_IdxWritePtr += idx_count;
+        target->_VtxCurrentIdx += vtx_count;
+        if (push_texture_id)
+            target->PopTextureID();
+    }
+}
+
 GuiDrawContext::GuiDrawContext(LuaBackend* _backend)
     : backend(_backend), g(*GImGui)
 {
@@ -110,7 +252,7 @@ void GuiDrawContext::draw_rect(float left, float top, float right, float bottom,
     if (isnan(left) || isnan(top) || isnan(right) || isnan(bottom))
     {
 #ifdef SPEL2_EXTRA_ANNOYING_SCRIPT_ERRORS
-        backend->messages.push_back({fmt::format("An argument passed to draw_rect was not a number: {} {} {} {}", left, top, right, bottom), std::chrono::system_clock::now(), error_color});
+        backend->messages.push(fmt::format("An argument passed to draw_rect was not a number: {} {} {} {}", left, top, right, bottom), error_color);
 #endif
         return;
     }
@@ -135,7 +277,7 @@ void GuiDrawContext::draw_rect_filled(float left, float top, float right, float
     if (isnan(left) || isnan(top) || isnan(right) || isnan(bottom))
     {
 #ifdef SPEL2_EXTRA_ANNOYING_SCRIPT_ERRORS
-        backend->messages.push_back({fmt::format("An argument passed to draw_rect_filled was not a number: {} {} {} {}", left, top, right, bottom), std::chrono::system_clock::now(), error_color});
+        backend->messages.push(fmt::format("An argument passed to draw_rect_filled was not a number: {} {} {} {}", left, top, right, bottom), error_color);
 #endif
         return;
     }
@@ -154,7 +296,7 @@ void GuiDrawContext::draw_rect_filled(AABB rect, float rounding, uColor color)
 {
     draw_rect_filled(rect.left, rect.top, rect.right, rect.bottom, rounding, color);
 }
-void GuiDrawContext::draw_poly(std::vector<Vec2> points, float thickness, uColor color)
+void GuiDrawContext::draw_poly(std::span<const Vec2> points, float thickness, uColor color)
 {
     auto draw = [&](ImDrawList* dl)
     {
@@ -175,7 +317,7 @@ void GuiDrawContext::draw_poly(std::vector<Vec2> points, float thickness, uColor
     auto list = drawlist == DRAW_LAYER::WINDOW ? ImGui::GetWindowDrawList() : backend->draw_list;
     draw(list);
 }
-void GuiDrawContext::draw_poly_filled(std::vector<Vec2> points, uColor color)
+void GuiDrawContext::draw_poly_filled(std::span<const Vec2> points, uColor color)
 {
     auto draw = [&](ImDrawList* dl)
     {
@@ -261,7 +403,7 @@ void GuiDrawContext::draw_circle(float x, float y, float radius, float thickness
     if (isnan(a.x) || isnan(a.y) || isnan(r))
     {
 #ifdef SPEL2_EXTRA_ANNOYING_SCRIPT_ERRORS
-        backend->messages.push_back({fmt::format("An argument passed to draw_circle was not a number: {} {} {}", a.x, a.y, r), std::chrono::system_clock::now(), error_color});
+        backend->messages.push(fmt::format("An argument passed to draw_circle was not a number: {} {} {}", a.x, a.y, r), error_color);
 #endif
         return;
     }
@@ -320,11 +462,11 @@ void GuiDrawContext::draw_image(IMAGE image, float left, float top, float right,
     if (drawlist == DRAW_LAYER::FOREGROUND)
     {
         for (auto vp : g.Viewports)
-            ImGui::GetForegroundDrawList(vp)->AddImage(backend->images[image]->texture, a, b, uva, uvb, color);
+            ImGui::GetForegroundDrawList(vp)->AddImage(backend->images[image]->get_texture(), a, b, uva, uvb, color);
         return;
     }
     auto list = drawlist == DRAW_LAYER::WINDOW ? ImGui::GetWindowDrawList() : backend->draw_list;
-    list->AddImage(backend->images[image]->texture, a, b, uva, uvb, color);
+    list->AddImage(backend->images[image]->get_texture(), a, b, uva, uvb, color);
 };
 void GuiDrawContext::draw_image(IMAGE image, AABB rect, AABB uv_rect, uColor color)
 {
@@ -342,11 +484,11 @@ void GuiDrawContext::draw_image_rotated(IMAGE image, float left, float top, floa
     if (drawlist == DRAW_LAYER::FOREGROUND)
     {
         for (auto vp : g.Viewports)
-            AddImageRotated(ImGui::GetForegroundDrawList(vp), backend->images[image]->texture, a, b, uva, uvb, color, angle, pivot);
+            AddImageRotated(ImGui::GetForegroundDrawList(vp), backend->images[image]->get_texture(), a, b, uva, uvb, color, angle, pivot);
         return;
     }
     auto list = drawlist == DRAW_LAYER::WINDOW ? ImGui::GetWindowDrawList() : backend->draw_list;
-    AddImageRotated(list, backend->images[image]->texture, a, b, uva, uvb, color, angle, pivot);
+    AddImageRotated(list, backend->images[image]->get_texture(), a, b, uva, uvb, color, angle, pivot);
 };
 void GuiDrawContext::draw_image_rotated(IMAGE image, AABB rect, AABB uv_rect, uColor color, float angle, float px, float py)
 {
@@ -517,7 +659,7 @@ void GuiDrawContext::win_image(IMAGE image, float width, float height)
     if (im_size.y <= 0)
         im_size.y = static_cast<float>(image_ptr->height);
 
-    ImGui::Image(image_ptr->texture, im_size);
+    ImGui::Image(image_ptr->get_texture(), im_size);
 };
 bool GuiDrawContext::win_imagebutton(std::string label, IMAGE image, float width, float height, float uvx1, float uvy1, float uvx2, float uvy2)
 {
@@ -539,7 +681,7 @@ bool GuiDrawContext::win_imagebutton(std::string label, IMAGE image, float width
     if (im_size.y <= 0)
         im_size.y = static_cast<float>(image_ptr->height);
 
-    return ImGui::ImageButton(label.c_str(), image_ptr->texture, im_size, ImVec2(uvx1, uvy1), ImVec2(uvx2, uvy2));
+    return ImGui::ImageButton(label.c_str(), image_ptr->get_texture(), im_size, ImVec2(uvx1, uvy1), ImVec2(uvx2, uvy2));
 };
 void GuiDrawContext::win_section(std::string title, sol::function callback)
 {
@@ -565,6 +707,63 @@ void GuiDrawContext::win_width(float width)
         width += ImGui::GetStyle().ItemInnerSpacing.x;
     ImGui::SetNextItemWidth(width);
 }
+// The transform is the one cached for the frame, so converting here costs the same as a screen_position call in Lua less the call
+void GuiDrawContext::draw_world_line(float x1, float y1, float x2, float y2, float thickness, uColor color)
+{
+    const ScreenTransform& transform = ScreenTransform::get();
+    const Vec2 a = transform.to_screen(x1, y1);
+    const Vec2 b = transform.to_screen(x2, y2);
+    draw_line(a.x, a.y, b.x, b.y, thickness, color);
+}
+void GuiDrawContext::draw_world_rect(AABB rect, float thickness, float rounding, uColor color)
+{
+    const ScreenTransform& transform = ScreenTransform::get();
+    const Vec2 a = transform.to_screen(rect.left, rect.top);
+    const Vec2 b = transform.to_screen(rect.right, rect.bottom);
+    draw_rect(a.x, a.y, b.x, b.y, thickness, rounding, color);
+}
+void GuiDrawContext::draw_world_rect_filled(AABB rect, float rounding, uColor color)
+{
+    const ScreenTransform& transform = ScreenTransform::get();
+    const Vec2 a = transform.to_screen(rect.left, rect.top);
+    const Vec2 b = transform.to_screen(rect.right, rect.bottom);
+    draw_rect_filled(a.x, a.y, b.x, b.y, rounding, color);
+}
+void GuiDrawContext::draw_world_circle(float x, float y, float radius, float thickness, uColor color)
+{
+    const ScreenTransform& transform = ScreenTransform::get();
+    const Vec2 center = transform.to_screen(x, y);
+    draw_circle(center.x, center.y, transform.to_screen(x + radius, y).x - center.x, thickness, color);
+}
+void GuiDrawContext::draw_world_circle_filled(float x, float y, float radius, uColor color)
+{
+    const ScreenTransform& transform = ScreenTransform::get();
+    const Vec2 center = transform.to_screen(x, y);
+    draw_circle_filled(center.x, center.y, transform.to_screen(x + radius, y).x - center.x, color);
+}
+void GuiDrawContext::draw_world_text(float x, float y, float size, std::string text, uColor color)
+{
+    const Vec2 a = ScreenTransform::get().to_screen(x, y);
+    draw_text(a.x, a.y, size, std::move(text), color);
+}
+void GuiDrawContext::draw_list(GuiDrawList& list, std::optional<Vec2> offset)
+{
+    ImVec2 delta{0.0f, 0.0f};
+    if (offset.has_value())
+    {
+        ImVec2 origin = screenify_fix({0.0f, 0.0f});
+        ImVec2 moved = screenify_fix({offset->x, offset->y});
+        delta = moved - origin;
+    }
+    if (drawlist == DRAW_LAYER::FOREGROUND)
+    {
+        for (auto vp : g.Viewports)
+            list.submit(ImGui::GetForegroundDrawList(vp), delta);
+        return;
+    }
+    auto dl = drawlist == DRAW_LAYER::WINDOW ? ImGui::GetWindowDrawList() : backend->draw_list;
+    list.submit(dl, delta);
+}
 void GuiDrawContext::draw_layer(DRAW_LAYER layer)
 {
     drawlist = layer;
@@ -778,31 +977,29 @@ std::string key_name(int64_t keycode)
     return name;
 }
 
-void register_usertypes(sol::state& lua)
+// The id the backend already has for the image, so creating it again when a script is hot reloaded hands out the same id
+static IMAGE find_image_id(LuaBackend& backend, const std::shared_ptr<CachedImage>& image)
 {
-    const char* xinput_dll_names[] =
-        {
-            "xinput1_4.dll",   // Windows 8+
-            "xinput1_3.dll",   // DirectX SDK
-            "xinput9_1_0.dll", // Windows Vista, Windows 7
-            "xinput1_2.dll",   // DirectX SDK
-            "xinput1_1.dll"    // DirectX SDK
-        };
-    for (int n = 0; n < IM_ARRAYSIZE(xinput_dll_names); n++)
-        if (HMODULE dll = ::LoadLibraryA(xinput_dll_names[n]))
-        {
-            g_XInputDLL = dll;
-            g_XInputGetCapabilities = (PFN_XInputGetCapabilities)::GetProcAddress(dll, "XInputGetCapabilities");
-            g_XInputGetState = (PFN_XInputGetState)::GetProcAddress(dll, "XInputGetState");
-            break;
-        }
+    for (const auto& [id, existing] : backend.images)
+    {
+        if (existing == image)
+            return id;
+    }
+    return static_cast<IMAGE>(backend.images.size());
+}
 
+void register_usertypes(sol::state& lua)
+{
     auto draw_rect = sol::overload(
         static_cast<void (GuiDrawContext::*)(float, float, float, float, float, float, uColor)>(&GuiDrawContext::draw_rect),
         static_cast<void (GuiDrawContext::*)(AABB, float, float, uColor)>(&GuiDrawContext::draw_rect));
     auto draw_rect_filled = sol::overload(
         static_cast<void (GuiDrawContext::*)(float, float, float, float, float, uColor)>(&GuiDrawContext::draw_rect_filled),
         static_cast<void (GuiDrawContext::*)(AABB, float, uColor)>(&GuiDrawContext::draw_rect_filled));
+    auto draw_poly = [](GuiDrawContext& draw_ctx, sol::stack_object points, float thickness, uColor color)
+    { draw_ctx.draw_poly(get_poly_points(points.lua_state(), points.stack_index()), thickness, color); };
+    auto draw_poly_filled = [](GuiDrawContext& draw_ctx, sol::stack_object points, uColor color)
+    { draw_ctx.draw_poly_filled(get_poly_points(points.lua_state(), points.stack_index()), color); };
     auto draw_image = sol::overload(
         static_cast<void (GuiDrawContext::*)(IMAGE, float, float, float, float, float, float, float, float, uColor)>(&GuiDrawContext::draw_image),
         static_cast<void (GuiDrawContext::*)(IMAGE, AABB, AABB, uColor)>(&GuiDrawContext::draw_image));
@@ -813,6 +1010,32 @@ void register_usertypes(sol::state& lua)
         static_cast<void (GuiDrawContext::*)(int)>(&GuiDrawContext::win_pushid),
         static_cast<void (GuiDrawContext::*)(std::string)>(&GuiDrawContext::win_pushid));
 
+    lua.new_usertype<GuiDrawList>(
+        "GuiDrawList",
+        sol::constructors<GuiDrawList()>{},
+        "add_line",
+        &GuiDrawList::add_line,
+        "add_rect",
+        &GuiDrawList::add_rect,
+        "add_rect_filled",
+        &GuiDrawList::add_rect_filled,
+        "add_triangle",
+        &GuiDrawList::add_triangle,
+        "add_triangle_filled",
+        &GuiDrawList::add_triangle_filled,
+        "add_poly",
+        &GuiDrawList::add_poly,
+        "add_poly_filled",
+        &GuiDrawList::add_poly_filled,
+        "add_circle",
+        &GuiDrawList::add_circle,
+        "add_circle_filled",
+        &GuiDrawList::add_circle_filled,
+        "clear",
+        &GuiDrawList::clear,
+        "size",
+        &GuiDrawList::size);
+
     /// Used in [register_option_callback](#register_option_callback) and [set_callback](#set_callback) with ON.GUIFRAME
     auto guidrawcontext_type = lua.new_usertype<GuiDrawContext>("GuiDrawContext");
     guidrawcontext_type["draw_line"] = &GuiDrawContext::draw_line;
@@ -820,8 +1043,8 @@ void register_usertypes(sol::state& lua)
     guidrawcontext_type["draw_rect_filled"] = draw_rect_filled;
     guidrawcontext_type["draw_triangle"] = &GuiDrawContext::draw_triangle;
     guidrawcontext_type["draw_triangle_filled"] = &GuiDrawContext::draw_triangle_filled;
-    guidrawcontext_type["draw_poly"] = &GuiDrawContext::draw_poly;
-    guidrawcontext_type["draw_poly_filled"] = &GuiDrawContext::draw_poly_filled;
+    guidrawcontext_type["draw_poly"] = draw_poly;
+    guidrawcontext_type["draw_poly_filled"] = draw_poly_filled;
     guidrawcontext_type["draw_bezier_cubic"] = &GuiDrawContext::draw_bezier_cubic;
     guidrawcontext_type["draw_bezier_quadratic"] = &GuiDrawContext::draw_bezier_quadratic;
     guidrawcontext_type["draw_circle"] = &GuiDrawContext::draw_circle;
@@ -829,6 +1052,13 @@ void register_usertypes(sol::state& lua)
     guidrawcontext_type["draw_text"] = &GuiDrawContext::draw_text;
     guidrawcontext_type["draw_image"] = draw_image;
     guidrawcontext_type["draw_image_rotated"] = draw_image_rotated;
+    guidrawcontext_type["draw_list"] = &GuiDrawContext::draw_list;
+    guidrawcontext_type["draw_world_line"] = &GuiDrawContext::draw_world_line;
+    guidrawcontext_type["draw_world_rect"] = &GuiDrawContext::draw_world_rect;
+    guidrawcontext_type["draw_world_rect_filled"] = &GuiDrawContext::draw_world_rect_filled;
+    guidrawcontext_type["draw_world_circle"] = &GuiDrawContext::draw_world_circle;
+    guidrawcontext_type["draw_world_circle_filled"] = &GuiDrawContext::draw_world_circle_filled;
+    guidrawcontext_type["draw_world_text"] = &GuiDrawContext::draw_world_text;
     guidrawcontext_type["draw_layer"] = &GuiDrawContext::draw_layer;
     guidrawcontext_type["window"] = &GuiDrawContext::window;
     guidrawcontext_type["win_text"] = &GuiDrawContext::win_text;
@@ -884,14 +1114,9 @@ void register_usertypes(sol::state& lua)
         }
     };
     /// Create image from file. Returns a tuple containing id, width and height.
-    /// Depending on the image size, this can take a moment, preferably don't create them dynamically, rather create all you need in global scope so it will load them as soon as the game starts
+    /// Images created from the same file by other scripts are shared, creating it again returns the same id. Returns -1 if the file can't be decoded
     lua["create_image"] = [](std::string path) -> std::tuple<IMAGE, int, int>
     {
-        ScriptImage* image = new ScriptImage;
-        image->width = 0;
-        image->height = 0;
-        image->texture = NULL;
-
         auto backend = LuaBackend::get_calling_backend();
         std::string real_path;
         if (path.starts_with("/"))
@@ -899,9 +1124,9 @@ void register_usertypes(sol::state& lua)
         else
             real_path = (std::filesystem::path(backend->get_root_path()) / path).string();
 
-        if (create_d3d11_texture_from_file(real_path.c_str(), &image->texture, &image->width, &image->height))
+        if (auto image = acquire_cached_image(real_path))
         {
-            IMAGE id = static_cast<IMAGE>(backend->images.size());
+            IMAGE id = find_image_id(*backend, image);
             backend->images[id] = image;
             return std::make_tuple(id, image->width, image->height);
         }
@@ -909,14 +1134,9 @@ void register_usertypes(sol::state& lua)
     };
 
     /// Create image from file, cropped to the geometry provided. Returns a tuple containing id, width and height.
-    /// Depending on the image size, this can take a moment, preferably don't create them dynamically, rather create all you need in global scope so it will load them as soon as the game starts
+    /// Images created from the same file and geometry by other scripts are shared, creating it again returns the same id. Returns -1 if the file can't be decoded
     lua["create_image_crop"] = [](std::string path, int x, int y, int w, int h) -> std::tuple<IMAGE, int, int>
     {
-        ScriptImage* image = new ScriptImage;
-        image->width = 0;
-        image->height = 0;
-        image->texture = NULL;
-
         auto backend = LuaBackend::get_calling_backend();
         std::string real_path;
         if (path.starts_with("/"))
@@ -924,9 +1144,9 @@ void register_usertypes(sol::state& lua)
         else
             real_path = (std::filesystem::path(backend->get_root_path()) / path).string();
 
-        if (create_d3d11_texture_from_file(real_path.c_str(), &image->texture, &image->width, &image->height, x, y, w, h))
+        if (auto image = acquire_cached_image(real_path, x, y, w, h))
         {
-            IMAGE id = static_cast<IMAGE>(backend->images.size());
+            IMAGE id = find_image_id(*backend, image);
             backend->images[id] = image;
             return std::make_tuple(id, image->width, image->height);
         }
@@ -1130,12 +1350,9 @@ void register_usertypes(sol::state& lua)
                                                   { return std::ref(io.MouseReleased); });
     imguiio_type["mousewheel"] = &ImGuiIO::MouseWheel;
     imguiio_type["gamepad"] = sol::property([]() -> Gamepad
-                                            {
-        g_WantUpdateHasGamepad = true;
-        return get_gamepad(1); });
+                                            { return get_gamepad(1); });
     imguiio_type["gamepads"] = [](unsigned int index) -> Gamepad
     {
-        g_WantUpdateHasGamepad = true;
         return get_gamepad(index);
     };
     imguiio_type["showcursor"] = &ImGuiIO::MouseDrawCursor;
@@ -1161,6 +1378,7 @@ void register_usertypes(sol::state& lua)
     // gamepads
     // Gamepad gamepads(int index)
     // This is the XInput index 1..4, might not be the same as the player slot.
+    // The gamepads are polled once per frame before the game processes its input, see [get_input_snapshot](#get_input_snapshot)
     // wantkeyboard
     // True if anyone else (i.e. some input box, OL hotkey) is already capturing keyboard or reacted to this keypress and you probably shouldn't.
     // Set this to true every GUIFRAME while you want to capture keyboard and disable UI key bindings and game keys. Won't affect UI or game keys on this frame though, that train has already sailed. Also see Bucket::Overlunky for other ways to override key bindings.
@@ -1185,6 +1403,29 @@ void register_usertypes(sol::state& lua)
 
     lua.create_named_table("INPUT_FLAG", "JUMP", 1, "WHIP", 2, "BOMB", 3, "ROPE", 4, "RUN", 5, "DOOR", 6, "MENU", 7, "JOURNAL", 8, "LEFT", 9, "RIGHT", 10, "UP", 11, "DOWN", 12);
 
+    lua.new_usertype<InputSnapshot>(
+        "InputSnapshot",
+        sol::no_constructor,
+        "frame",
+        sol::readonly(&InputSnapshot::frame),
+        "get_gamepad",
+        &InputSnapshot::get_gamepad,
+        "keydown",
+        &InputSnapshot::keydown,
+        "keyctrl",
+        sol::readonly(&InputSnapshot::ctrl),
+        "keyshift",
+        sol::readonly(&InputSnapshot::shift),
+        "keyalt",
+        sol::readonly(&InputSnapshot::alt));
+
+    /// Get the gamepads and keyboard as they were `frames_back` frames ago (0 by default, up to 63), for detecting combos without keeping a history yourself.
+    /// The snapshots are taken once per frame before ON.PRE_PROCESS_INPUT, returns nil if there aren't that many yet
+    lua["get_input_snapshot"] = [](std::optional<uint32_t> frames_back) -> std::optional<InputSnapshot>
+    {
+        return InputSnapshots::get().at(frames_back.value_or(0));
+    };
+
     /// Returns: [ImGuiIO](#ImGuiIO) for raw keyboard, mouse and xinput gamepad stuff.
     // lua["get_io"] = []() -> ImGuiIO
     lua["get_io"] = ImGui::GetIO;
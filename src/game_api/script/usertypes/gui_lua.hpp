@@ -1,6 +1,10 @@
 #pragma once
 
+#include <functional>      // for function
+#include <memory>          // for unique_ptr
+#include <optional>        // for optional
 #include <sol/forward.hpp> // for function
+#include <span>            // for span
 #include <string>          // for string
 #include <vector>          // for vector
 
@@ -15,12 +19,62 @@ enum class DRAW_LAYER
 };
 
 struct ImGuiContext;
+struct ImDrawList;
 
 namespace sol
 {
 class state;
 } // namespace sol
 
+/// Retained list of shapes, built once and drawn every frame with [GuiDrawContext](#GuiDrawContext)`:draw_list`. Much faster than calling the `draw_` functions for static overlays.
+/// The shapes are only tessellated again when the screen size changes or the list is modified, otherwise the stored vertices are copied as is.
+/// Coordinates are in screen space, same as the `GuiDrawContext` functions.
+class GuiDrawList
+{
+  public:
+    GuiDrawList();
+    ~GuiDrawList();
+
+    /// Adds a line
+    void add_line(float x1, float y1, float x2, float y2, float thickness, uColor color);
+    /// Adds a rectangle from top-left to bottom-right
+    void add_rect(AABB rect, float thickness, float rounding, uColor color);
+    /// Adds a filled rectangle from top-left to bottom-right
+    void add_rect_filled(AABB rect, float rounding, uColor color);
+    /// Adds a triangle
+    void add_triangle(Vec2 p1, Vec2 p2, Vec2 p3, float thickness, uColor color);
+    /// Adds a filled triangle
+    void add_triangle_filled(Vec2 p1, Vec2 p2, Vec2 p3, uColor color);
+    /// Adds a polyline
+    void add_poly(std::vector<Vec2> points, float thickness, uColor color);
+    /// Adds a filled convex polyline
+    void add_poly_filled(std::vector<Vec2> points, uColor color);
+    /// Adds a circle
+    void add_circle(float x, float y, float radius, float thickness, uColor color);
+    /// Adds a filled circle
+    void add_circle_filled(float x, float y, float radius, uColor color);
+    /// Removes all shapes
+    void clear();
+    /// Number of shapes in the list
+    size_t size() const;
+
+    // Appends the cached vertices to `target`, moved by `offset` pixels, tessellates them first if needed
+    void submit(ImDrawList* target, ImVec2 offset);
+
+  private:
+    void add(std::function<void(ImDrawList*)> shape);
+    void rebuild();
+
+    std::vector<std::function<void(ImDrawList*)>> shapes;
+    std::unique_ptr<ImDrawList> cache;
+    bool dirty{true};
+    Vec2 built_top_left;
+    Vec2 built_bottom_right;
+};
+
+// Copies the vertices of `source` to `target`, moved by `offset` pixels. Clip rects are not kept, callbacks in `source` are skipped
+void append_draw_list(const ImDrawList& source, ImDrawList* target, ImVec2 offset);
+
 class GuiDrawContext
 {
   public:
@@ -40,10 +94,10 @@ class GuiDrawContext
     void draw_triangle(Vec2 p1, Vec2 p2, Vec2 p3, float thickness, uColor color);
     /// Draws a filled triangle on screen.
     void draw_triangle_filled(Vec2 p1, Vec2 p2, Vec2 p3, uColor color);
-    /// Draws a polyline on screen.
-    void draw_poly(std::vector<Vec2> points, float thickness, uColor color);
-    /// Draws a filled convex polyline on screen.
-    void draw_poly_filled(std::vector<Vec2> points, uColor color);
+    /// Draws a polyline on screen. The points can also be a flat array of coordinates `{x1, y1, x2, y2, ...}` or a PointBuffer, which are read without making a Vec2 of every point.
+    void draw_poly(std::span<const Vec2> points, float thickness, uColor color);
+    /// Draws a filled convex polyline on screen. The points can also be a flat array of coordinates `{x1, y1, x2, y2, ...}` or a PointBuffer, which are read without making a Vec2 of every point.
+    void draw_poly_filled(std::span<const Vec2> points, uColor color);
     /// Draws a cubic bezier curve on screen.
     void draw_bezier_cubic(Vec2 p1, Vec2 p2, Vec2 p3, Vec2 p4, float thickness, uColor color);
     /// Draws a quadratic bezier curve on screen.
@@ -62,6 +116,20 @@ class GuiDrawContext
     void draw_image_rotated(IMAGE image, float left, float top, float right, float bottom, float uvx1, float uvy1, float uvx2, float uvy2, uColor color, float angle, float px, float py);
     /// Same as `draw_image` but rotates the image by angle in radians around the pivot offset from the center of the rect (meaning `px=py=0` rotates around the center)
     void draw_image_rotated(IMAGE image, AABB rect, AABB uv_rect, uColor color, float angle, float px, float py);
+    /// Draws all shapes in a [GuiDrawList](#GuiDrawList), optionally moved by `offset` in screen coordinates
+    void draw_list(GuiDrawList& list, std::optional<Vec2> offset);
+    /// Same as `draw_line` but in game coordinates, converted with the camera of this frame
+    void draw_world_line(float x1, float y1, float x2, float y2, float thickness, uColor color);
+    /// Same as `draw_rect` but in game coordinates, converted with the camera of this frame
+    void draw_world_rect(AABB rect, float thickness, float rounding, uColor color);
+    /// Same as `draw_rect_filled` but in game coordinates, converted with the camera of this frame
+    void draw_world_rect_filled(AABB rect, float rounding, uColor color);
+    /// Same as `draw_circle` but in game coordinates, the radius in tiles, converted with the camera of this frame
+    void draw_world_circle(float x, float y, float radius, float thickness, uColor color);
+    /// Same as `draw_circle_filled` but in game coordinates, the radius in tiles, converted with the camera of this frame
+    void draw_world_circle_filled(float x, float y, float radius, uColor color);
+    /// Same as `draw_text` but anchored at game coordinates `x`, `y`, converted with the camera of this frame
+    void draw_world_text(float x, float y, float size, std::string text, uColor color);
     /// Draw on top of UI windows, including platform windows that may be outside the game area, or only in current widget window. Defaults to main viewport background.
     void draw_layer(DRAW_LAYER layer);
 
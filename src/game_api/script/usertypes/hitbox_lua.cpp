@@ -8,9 +8,11 @@
 #include <tuple>       // for get
 #include <type_traits> // for move, declval
 #include <utility>     // for min, max, get, pair
+#include <vector>      // for vector
 
 #include "entity.hpp"            // for get_hitbox
 #include "math.hpp"              // for AABB, Vec2, Quad, AABB::bottom, AABB::left
+#include "math_batch.hpp"        // for batch_overlapping, batch_transform, batch_inside
 #include "rpc.hpp"               // for screen_aabb
 #include "script/sol_helper.hpp" // for self_return
 
@@ -217,5 +219,63 @@ void register_usertypes(sol::state& lua)
         static_cast<float (*)(const Vec2, const Vec2, const Vec2, const Vec2)>(::two_lines_angle));
     lua["intersection"] = intersection;
     lua["two_lines_angle"] = two_lines_angle;
+
+    // The batch functions return 1-based indices into the given array, so they can be used on the same table
+    static auto to_lua_indices = [](std::vector<uint32_t> indices)
+    {
+        for (uint32_t& index : indices)
+            index++;
+        return indices;
+    };
+    /// Returns the indices of the `boxes` that overlap `box`, faster than calling `overlaps_with` for every box in a loop
+    lua["get_overlapping_aabbs"] = [](AABB box, std::vector<AABB> boxes) -> std::vector<uint32_t>
+    {
+        return to_lua_indices(batch_overlapping(box, boxes.data(), boxes.size()));
+    };
+    /// Returns the uids whose hitbox overlaps `box`, e.g. to filter the result of `get_entities_by` without getting every hitbox in Lua. Uids of entities that don't exist are left out
+    lua["filter_uids_overlapping"] = [](AABB box, std::vector<uint32_t> uids) -> std::vector<uint32_t>
+    {
+        // Missing entities have no hitbox at all, an empty box at 0, 0 could still overlap
+        std::vector<AABB> hitboxes;
+        std::vector<uint32_t> found;
+        hitboxes.reserve(uids.size());
+        found.reserve(uids.size());
+        for (uint32_t uid : uids)
+        {
+            if (auto ent = get_entity_ptr(uid))
+            {
+                hitboxes.push_back(ent->get_hitbox(false));
+                found.push_back(uid);
+            }
+        }
+        std::vector<uint32_t> result;
+        for (uint32_t index : batch_overlapping(box, hitboxes.data(), hitboxes.size()))
+            result.push_back(found[index]);
+        return result;
+    };
+    /// Rotates every Quad in the array around the pivot like `Quad:rotate` and then offsets it, the quads are changed in place
+    lua["transform_quads"] = [](sol::table quads, float angle, float px, float py, sol::optional<float> offsetx, sol::optional<float> offsety)
+    {
+        std::vector<Quad*> targets;
+        std::vector<Quad> transformed;
+        const size_t size = quads.size();
+        targets.reserve(size);
+        transformed.reserve(size);
+        for (size_t i = 1; i <= size; ++i)
+        {
+            Quad* quad = quads.get<Quad*>(i);
+            targets.push_back(quad);
+            transformed.push_back(*quad);
+        }
+        batch_transform(transformed.data(), transformed.size(), angle, {px, py}, {offsetx.value_or(0), offsety.value_or(0)});
+        for (size_t i = 0; i < size; ++i)
+            *targets[i] = transformed[i];
+    };
+    /// Returns the indices of the `points` inside the triangle, faster than calling `is_point_inside` for every point in a loop
+    /// Points on an edge count as inside, there's no epsilon like in `Triangle:is_point_inside`
+    lua["points_inside_triangle"] = [](Triangle triangle, std::vector<Vec2> points) -> std::vector<uint32_t>
+    {
+        return to_lua_indices(batch_inside(triangle, points.data(), points.size()));
+    };
 }
 } // namespace NHitbox
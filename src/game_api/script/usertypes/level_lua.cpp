@@ -24,6 +24,7 @@
 #include "containers/game_unordered_map.hpp" // for game_unordered_map
 #include "entity_db.hpp"                     // for to_id
 #include "level_api.hpp"                     // for THEME_OVERRIDE, ThemeInfo
+#include "level_gen_stats.hpp"               // for LevelGenStats, LevelGenPhaseStats
 #include "math.hpp"                          // for AABB
 #include "savedata.hpp"                      // for SaveData, Constellation...
 #include "script/handle_lua_function.hpp"    // for handle_function
@@ -1003,6 +1004,8 @@ void register_usertypes(sol::state& lua)
     {
         auto backend = LuaBackend::get_calling_backend();
         backend->pre_tile_code_callbacks.push_back(LevelGenCallback{backend->cbcount, std::move(tile_code), std::move(cb)});
+        backend->pre_tile_code_index.add(backend->pre_tile_code_callbacks.back(), backend->pre_tile_code_callbacks.size() - 1);
+        LuaBackend::invalidate_subscribers();
         return backend->cbcount++;
     };
     /// Add a callback for a specific tile code that is called after the game handles the tile code.
@@ -1013,6 +1016,8 @@ void register_usertypes(sol::state& lua)
     {
         auto backend = LuaBackend::get_calling_backend();
         backend->post_tile_code_callbacks.push_back(LevelGenCallback{backend->cbcount, std::move(tile_code), std::move(cb)});
+        backend->post_tile_code_index.add(backend->post_tile_code_callbacks.back(), backend->post_tile_code_callbacks.size() - 1);
+        LuaBackend::invalidate_subscribers();
         return backend->cbcount++;
     };
     /// Define a new tile code, to make this tile code do anything you have to use either [set_pre_tile_code_callback](#set_pre_tile_code_callback) or [set_post_tile_code_callback](#set_post_tile_code_callback).
@@ -1034,18 +1039,55 @@ void register_usertypes(sol::state& lua)
         return HeapBase::get().level_gen()->data->get_short_tile_code_def(short_tile_code);
     };
 
+    lua.new_usertype<LevelGenPhaseStats>(
+        "LevelGenPhaseStats",
+        sol::no_constructor,
+        "name",
+        &LevelGenPhaseStats::name,
+        "calls",
+        &LevelGenPhaseStats::calls,
+        "total_ms",
+        &LevelGenPhaseStats::total_ms,
+        "callback_ms",
+        &LevelGenPhaseStats::callback_ms,
+        "vanilla_ms",
+        &LevelGenPhaseStats::vanilla_ms);
+
+    /// Enable or disable timing the level generation phases for [get_levelgen_stats](#get_levelgen_stats), disabled by default.
+    lua["set_levelgen_stats_enabled"] = [](bool enabled)
+    {
+        LevelGenStats::enabled = enabled;
+    };
+    /// Get the time spent in each level generation phase during the last level generation, split into time spent in script callbacks and in the game. Phases include the time of phases they call, e.g. `level_gen` contains all of them.
+    /// Only recorded while enabled with [set_levelgen_stats_enabled](#set_levelgen_stats_enabled).
+    lua["get_levelgen_stats"] = []() -> std::vector<LevelGenPhaseStats>
+    {
+        return LevelGenStats::get().stats();
+    };
+
+    // Lua functions become callbacks, POS_TYPE flags are checked natively for every candidate position without calling into Lua
+    auto make_spawn_is_valid = [](sol::object is_valid) -> std::function<bool(float, float, uint8_t)>
+    {
+        if (is_valid.is<sol::function>())
+        {
+            return make_safe_cb<bool(float, float, int)>(is_valid.as<sol::function>());
+        }
+        if (is_valid.get_type() == sol::type::number)
+        {
+            return make_position_is_valid(static_cast<POS_TYPE>(is_valid.as<uint32_t>()));
+        }
+        return nullptr;
+    };
+
     /// Define a new procedural spawn, the function `nil do_spawn(float x, float y, LAYER layer)` contains your code to spawn the thing, whatever it is.
     /// The function `bool is_valid(float x, float y, LAYER layer)` determines whether the spawn is legal in the given position and layer.
     /// Use for example when you can spawn only on the ceiling, under water or inside a shop.
+    /// Instead of a function `is_valid` can also be [POS_TYPE](#POS_TYPE) flags, those are checked the same as with [position_is_valid](#position_is_valid) but without calling into Lua for every position, which is a lot faster on big levels.
     /// Set `is_valid` to `nil` in order to use the default rule (aka. on top of floor and not obstructed).
     /// If a user disables your script but still uses your level mod nothing will be spawned in place of your procedural spawn.
-    lua["define_procedural_spawn"] = [](std::string procedural_spawn, sol::function do_spawn, sol::function is_valid) -> PROCEDURAL_CHANCE
+    lua["define_procedural_spawn"] = [make_spawn_is_valid](std::string procedural_spawn, sol::function do_spawn, sol::object is_valid) -> PROCEDURAL_CHANCE
     {
-        std::function<bool(float, float, int)> is_valid_call{nullptr};
-        if (is_valid)
-        {
-            is_valid_call = make_safe_cb<bool(float, float, int)>(std::move(is_valid));
-        }
+        std::function<bool(float, float, uint8_t)> is_valid_call = make_spawn_is_valid(std::move(is_valid));
         std::function<void(float, float, int)> do_spawn_call = make_safe_cb<void(float, float, int)>(std::move(do_spawn));
 
         auto backend = LuaBackend::get_calling_backend();
@@ -1060,16 +1102,13 @@ void register_usertypes(sol::state& lua)
     /// The function `nil do_spawn(float x, float y, LAYER layer)` contains your code to spawn the thing, whatever it is.
     /// The function `bool is_valid(float x, float y, LAYER layer)` determines whether the spawn is legal in the given position and layer.
     /// Use for example when you can spawn only on the ceiling, under water or inside a shop.
+    /// Instead of a function `is_valid` can also be [POS_TYPE](#POS_TYPE) flags, those are checked natively without calling into Lua for every position.
     /// Set `is_valid` to `nil` in order to use the default rule (aka. on top of floor and not obstructed).
     /// To change the number of spawns use `PostRoomGenerationContext:set_num_extra_spawns` during `ON.POST_ROOM_GENERATION`
     /// No name is attached to the extra spawn since it is not modified from level files, instead every call to this function will return a new unique id.
-    lua["define_extra_spawn"] = [](sol::function do_spawn, sol::function is_valid, std::uint32_t num_spawns_frontlayer, std::uint32_t num_spawns_backlayer) -> std::uint32_t
+    lua["define_extra_spawn"] = [make_spawn_is_valid](sol::function do_spawn, sol::object is_valid, std::uint32_t num_spawns_frontlayer, std::uint32_t num_spawns_backlayer) -> std::uint32_t
     {
-        std::function<bool(float, float, int)> is_valid_call{nullptr};
-        if (is_valid)
-        {
-            is_valid_call = make_safe_cb<bool(float, float, int)>(std::move(is_valid));
-        }
+        std::function<bool(float, float, uint8_t)> is_valid_call = make_spawn_is_valid(std::move(is_valid));
         std::function<void(float, float, int)> do_spawn_call = make_safe_cb<void(float, float, int)>(std::move(do_spawn));
 
         auto backend = LuaBackend::get_calling_backend();
@@ -77,7 +77,8 @@ struct PreHandleRoomTilesContext
     const LevelGenRoomData& get_room_data() const;
     LevelGenRoomData& get_mutable_room_data();
 
-    const LevelGenRoomData room_data;
+    // The room as the game generated it, copied into `modded_room_data` when a callback first changes it
+    const LevelGenRoomData& room_data;
     std::optional<LevelGenRoomData> modded_room_data;
 };
 
@@ -5,6 +5,7 @@
 #include <sol/usertype.hpp> // for basic_usertype
 
 #include "entity.hpp"
+#include "script/sol_helper.hpp"
 #include "sound_manager.hpp"
 #include "state.hpp"
 #include "state_structs.hpp"
@@ -302,7 +303,7 @@ void register_usertypes(sol::state& lua)
     lua.new_usertype<LogicMagmamanSpawn>(
         "LogicMagmamanSpawn",
         "magmaman_positions",
-        &LogicMagmamanSpawn::magmaman_positions,
+        container_view_property(&LogicMagmamanSpawn::magmaman_positions),
         "add_spawn",
         add_spawn,
         "remove_spawn",
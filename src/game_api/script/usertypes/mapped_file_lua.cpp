@@ -0,0 +1,133 @@
+#include "mapped_file_lua.hpp"
+
+#include <algorithm>   // for min
+#include <cstdint>     // for int64_t
+#include <functional>  // for function
+#include <lauxlib.h>   // for luaL_error
+#include <memory>      // for shared_ptr
+#include <optional>    // for optional
+#include <sol/sol.hpp> // for state, no_constructor, variadic_results
+#include <string>      // for string
+#include <string_view> // for string_view
+
+#include "mapped_file.hpp" // for MappedFile
+
+namespace
+{
+// Same as string.sub, 1 based and negative positions count from the end
+std::string_view sub_view(std::string_view view, int64_t i, int64_t j)
+{
+    const int64_t size = static_cast<int64_t>(view.size());
+    if (i < 0)
+        i = std::max<int64_t>(size + i + 1, 1);
+    else if (i == 0)
+        i = 1;
+    if (j < 0)
+        j = size + j + 1;
+    else if (j > size)
+        j = size;
+    if (i > j)
+        return {};
+    return view.substr(static_cast<size_t>(i - 1), static_cast<size_t>(j - i + 1));
+}
+} // namespace
+
+namespace NMappedFile
+{
+void register_usertypes(sol::state& lua)
+{
+    auto sub = [](const MappedFile& file, int64_t i, std::optional<int64_t> j) -> std::string
+    {
+        return std::string{sub_view(file.view(), i, j.value_or(-1))};
+    };
+    auto unpack = [](const MappedFile& file, std::string fmt, std::optional<int64_t> pos, sol::this_state L) -> sol::variadic_results
+    {
+        const std::string_view view = file.view();
+        int64_t start = pos.value_or(1);
+        if (start < 0)
+            start = static_cast<int64_t>(view.size()) + start + 1;
+        if (start < 1 || start > static_cast<int64_t>(view.size()) + 1)
+            luaL_error(L, "initial position out of file");
+        const size_t offset = static_cast<size_t>(start - 1);
+        const size_t available = view.size() - offset;
+
+        sol::state_view state(L);
+        sol::protected_function string_unpack = state["string"]["unpack"];
+        sol::protected_function string_packsize = state["string"]["packsize"];
+
+        // Only the bytes the format reads are copied, formats with strings of unknown length start small and grow until they fit
+        size_t window = 256;
+        if (sol::protected_function_result packsize = string_packsize(fmt); packsize.valid())
+            window = packsize.get<size_t>();
+        while (true)
+        {
+            window = std::min(window, available);
+            sol::protected_function_result result = string_unpack(std::string{view.substr(offset, window)}, fmt);
+            if (result.valid())
+            {
+                sol::variadic_results values;
+                for (int i = 0; i < result.return_count(); ++i)
+                    values.push_back(result.get<sol::object>(i));
+                // The last value is the position after what was read, relative to the slice
+                values.back() = sol::make_object(state, values.back().as<int64_t>() + static_cast<int64_t>(offset));
+                return values;
+            }
+            if (window == available)
+            {
+                sol::error err = result;
+                luaL_error(L, "%s", err.what());
+            }
+            window *= 4;
+        }
+    };
+    auto lines = [](std::shared_ptr<MappedFile> file) -> std::function<std::optional<std::string>()>
+    {
+        return [file = std::move(file), offset = size_t{0}]() mutable -> std::optional<std::string>
+        {
+            const std::string_view view = file->view();
+            if (offset >= view.size())
+                return std::nullopt;
+            size_t end = view.find('\n', offset);
+            if (end == std::string_view::npos)
+                end = view.size();
+            std::string_view line = view.substr(offset, end - offset);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            offset = end + 1;
+            return std::string{line};
+        };
+    };
+
+    /// Read only file mapped into memory, get one with `io.map_data` or `io.map_mod`
+    /// Nothing is read until it's accessed, so large data files can be looked up without loading them into a string first
+    /// Positions are 1 based and negative ones count from the end, like for strings
+    lua.new_usertype<MappedFile>(
+        "MappedFile",
+        sol::no_constructor,
+        "size",
+        &MappedFile::size,
+        "sub",
+        sub,
+        "unpack",
+        unpack,
+        "lines",
+        lines,
+        "is_open",
+        &MappedFile::is_open,
+        "close",
+        &MappedFile::close);
+    /* MappedFile
+    // sub
+    // Like `string.sub`, copies only the bytes from `i` to `j`
+    // string sub(int i, optional<int> j)
+    // unpack
+    // Like `string.unpack` on the file from `pos`, returns the values and the position after them, alignment is relative to `pos`
+    // any unpack(string fmt, optional<int> pos)
+    // lines
+    // Iterator over the lines of the file without the line ending, one line is copied at a time: `for line in file:lines() do ... end`
+    // function lines()
+    // close
+    // Unmaps the file, it's also unmapped once the object is collected
+    */
+}
+}; // namespace NMappedFile
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <sol/forward.hpp> // for state
+
+namespace NMappedFile
+{
+void register_usertypes(sol::state& lua);
+};
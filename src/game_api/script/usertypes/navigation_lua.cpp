@@ -0,0 +1,49 @@
+#include "navigation_lua.hpp"
+
+#include <cmath>       // for round
+#include <cstdint>     // for int32_t
+#include <optional>    // for optional
+#include <sol/sol.hpp> // for state, no_constructor, readonly
+#include <vector>      // for vector
+
+#include "aliases.hpp"    // for LAYER
+#include "math.hpp"       // for Vec2
+#include "navigation.hpp" // for NavigationGrid, GridFlowField
+
+namespace NNavigation
+{
+void register_usertypes(sol::state& lua)
+{
+    /// Distances from every grid position to a target, for steering many entities towards the same place. Returned by [get_grid_flow_field](#get_grid_flow_field)
+    lua.new_usertype<GridFlowField>(
+        "GridFlowField",
+        sol::no_constructor,
+        "target_x",
+        sol::readonly(&GridFlowField::target_x),
+        "target_y",
+        sol::readonly(&GridFlowField::target_y),
+        "distance",
+        &GridFlowField::distance,
+        "next",
+        &GridFlowField::next);
+
+    /// Check whether a grid position can be moved through by [find_grid_path](#find_grid_path) and [get_grid_flow_field](#get_grid_flow_field), that is it has no solid grid entity
+    lua["is_grid_passable"] = [](float x, float y, LAYER layer) -> bool
+    {
+        return NavigationGrid::get().is_passable(layer, static_cast<int32_t>(std::round(x)), static_cast<int32_t>(std::round(y)));
+    };
+    /// Find the shortest path between two grid positions through positions without a solid grid entity, moving only horizontally and vertically.
+    /// Returns the grid positions of the path including start and goal, or an empty array if there is no path. Doesn't know about gravity, ladders or entities that aren't grid entities.
+    /// The grid is kept natively and only updated where it changed, so this is a lot faster than searching with [get_grid_entity_at](#get_grid_entity_at) from Lua.
+    lua["find_grid_path"] = [](float start_x, float start_y, float goal_x, float goal_y, LAYER layer) -> std::vector<Vec2>
+    {
+        return NavigationGrid::get().find_path(layer, static_cast<int32_t>(std::round(start_x)), static_cast<int32_t>(std::round(start_y)), static_cast<int32_t>(std::round(goal_x)), static_cast<int32_t>(std::round(goal_y)));
+    };
+    /// Get the number of steps from every grid position to the target with the same rules as [find_grid_path](#find_grid_path), see [GridFlowField](#GridFlowField).
+    /// Searches at most `max_distance` steps away from the target, or the whole level if not set.
+    lua["get_grid_flow_field"] = [](float target_x, float target_y, LAYER layer, std::optional<int32_t> max_distance) -> GridFlowField
+    {
+        return NavigationGrid::get().flow_field(layer, static_cast<int32_t>(std::round(target_x)), static_cast<int32_t>(std::round(target_y)), max_distance.value_or(-1));
+    };
+}
+} // namespace NNavigation
@@ -9,8 +9,9 @@
 #include <utility>     // for min, max
 #include <vector>      // for _Vector_const_iterator, vector
 
-#include "particles.hpp" // for ParticleDB, ParticleEmitterInfo, ParticleEm...
-#include "rpc.hpp"       // for generate_world_particles, advance_screen_pa...
+#include "particles.hpp"          // for ParticleDB, ParticleEmitterInfo, ParticleEm...
+#include "rpc.hpp"                // for generate_world_particles, advance_screen_pa...
+#include "script/lua_backend.hpp" // for LuaBackend
 
 template <auto MemberT>
 auto MakeParticleMemberAccess()
@@ -37,7 +38,32 @@ void register_usertypes(sol::state& lua)
     /// Renders the particles to the screen. Only used with screen particle emitters. See the `particles.lua` example script for more details.
     lua["render_screen_particles"] = render_screen_particles;
     /// Extinguish a particle emitter (use the return value of `generate_world_particles` or `generate_screen_particles` as the parameter in this function)
-    lua["extinguish_particles"] = extinguish_particles;
+    lua["extinguish_particles"] = [](ParticleEmitterInfo* particle_emitter)
+    {
+        // A pooled emitter from get_pooled_particles goes through the pool, so the pool doesn't extinguish it again
+        if (!LuaBackend::get_calling_backend()->particle_pool.extinguish(particle_emitter))
+            extinguish_particles(particle_emitter);
+    };
+    /// Advances and renders all the screen particle emitters in the list, same as calling [advance_screen_particles](#advance_screen_particles) and [render_screen_particles](#render_screen_particles) for each of them
+    lua["advance_and_render_screen_particles"] = advance_and_render_screen_particles;
+    /// Same as [generate_world_particles](#generate_world_particles), but the emitter belongs to the script: it's extinguished automatically once all its particles are gone (unless the particle type is permanent)
+    /// or when the script is unloaded, world emitters also go away with the level. Once the script has more pooled emitters than the cap (see [set_particle_pool_cap](#set_particle_pool_cap)) the oldest one is extinguished to make room.
+    /// Returns the id of the pooled emitter, -1 if it couldn't be made, get the emitter from it with [get_pooled_particles](#get_pooled_particles)
+    lua["generate_pooled_world_particles"] = [](PARTICLEEMITTER particle_emitter_id, uint32_t uid) -> int32_t
+    { return LuaBackend::get_calling_backend()->particle_pool.generate_world(particle_emitter_id, uid); };
+    /// Same as [generate_screen_particles](#generate_screen_particles), but pooled like [generate_pooled_world_particles](#generate_pooled_world_particles)
+    lua["generate_pooled_screen_particles"] = [](PARTICLEEMITTER particle_emitter_id, float x, float y) -> int32_t
+    { return LuaBackend::get_calling_backend()->particle_pool.generate_screen(particle_emitter_id, x, y); };
+    /// Get the pooled emitter with the id from [generate_pooled_world_particles](#generate_pooled_world_particles) or [generate_pooled_screen_particles](#generate_pooled_screen_particles),
+    /// `nil` once the pool extinguished it. Get it again every frame instead of keeping it, the pool can free it at any time.
+    lua["get_pooled_particles"] = [](int32_t id) -> ParticleEmitterInfo*
+    { return LuaBackend::get_calling_backend()->particle_pool.get(id); };
+    /// Extinguish a pooled emitter by id, returns `false` if the pool doesn't have it anymore
+    lua["extinguish_pooled_particles"] = [](int32_t id) -> bool
+    { return LuaBackend::get_calling_backend()->particle_pool.extinguish(id); };
+    /// Set how many pooled particle emitters this script can have at once, default is 64, 0 for no limit
+    lua["set_particle_pool_cap"] = [](uint32_t cap)
+    { LuaBackend::get_calling_backend()->particle_pool.set_cap(cap); };
 
     /// Deprecated
     /// Use `generate_world_particles`
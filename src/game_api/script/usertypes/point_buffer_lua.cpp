@@ -0,0 +1,91 @@
+#include "point_buffer_lua.hpp"
+
+#include <lua.h>       // for lua_rawgeti, lua_rawlen, lua_tonumber, lua_type, lua_pop
+#include <sol/sol.hpp> // for state, constructors, stack
+
+PointBuffer::PointBuffer(size_t capacity)
+{
+    points.reserve(capacity);
+}
+
+void PointBuffer::add(float x, float y)
+{
+    points.emplace_back(x, y);
+}
+void PointBuffer::set(size_t index, float x, float y)
+{
+    if (index == 0)
+        return;
+    if (index > points.size())
+        points.resize(index, Vec2{0.0f, 0.0f});
+    points[index - 1] = Vec2{x, y};
+}
+Vec2 PointBuffer::get(size_t index) const
+{
+    if (index == 0 || index > points.size())
+        return Vec2{0.0f, 0.0f};
+    return points[index - 1];
+}
+
+std::span<const Vec2> get_poly_points(lua_State* L, int index)
+{
+    if (PointBuffer* buffer = sol::stack::check_get<PointBuffer*>(L, index).value_or(nullptr))
+        return buffer->points;
+    if (lua_type(L, index) != LUA_TTABLE)
+        return {};
+
+    // Only the draw functions use this and they don't call back into Lua before they are done with the points
+    static std::vector<Vec2> scratch;
+    scratch.clear();
+
+    const lua_Integer size = static_cast<lua_Integer>(lua_rawlen(L, index));
+    lua_rawgeti(L, index, 1);
+    const bool flat = lua_type(L, -1) == LUA_TNUMBER;
+    lua_pop(L, 1);
+    if (flat)
+    {
+        scratch.reserve(static_cast<size_t>(size / 2));
+        for (lua_Integer i = 1; i < size; i += 2)
+        {
+            lua_rawgeti(L, index, i);
+            lua_rawgeti(L, index, i + 1);
+            scratch.emplace_back(static_cast<float>(lua_tonumber(L, -2)), static_cast<float>(lua_tonumber(L, -1)));
+            lua_pop(L, 2);
+        }
+    }
+    else
+    {
+        scratch.reserve(static_cast<size_t>(size));
+        for (lua_Integer i = 1; i <= size; ++i)
+        {
+            lua_rawgeti(L, index, i);
+            if (auto point = sol::stack::check_get<Vec2*>(L, -1); point && *point)
+                scratch.push_back(**point);
+            lua_pop(L, 1);
+        }
+    }
+    return scratch;
+}
+
+namespace NPointBuffer
+{
+void register_usertypes(sol::state& lua)
+{
+    /// Reusable list of points for the poly drawing functions, they draw it as it is instead of reading a new array of Vec2 every call
+    lua.new_usertype<PointBuffer>(
+        "PointBuffer",
+        sol::constructors<PointBuffer(), PointBuffer(size_t)>{},
+        "add",
+        &PointBuffer::add,
+        "set",
+        &PointBuffer::set,
+        "get",
+        &PointBuffer::get,
+        "size",
+        &PointBuffer::size,
+        "clear",
+        &PointBuffer::clear,
+        sol::meta_function::length,
+        &PointBuffer::size);
+}
+}; // namespace NPointBuffer
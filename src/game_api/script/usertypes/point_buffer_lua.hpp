@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>         // for size_t
+#include <sol/forward.hpp> // for state
+#include <span>            // for span
+#include <vector>          // for vector
+
+#include "math.hpp" // for Vec2
+
+struct lua_State;
+
+// Points the poly drawing functions read as they are, filled once and drawn every frame without building an array of Vec2 for each call
+class PointBuffer
+{
+  public:
+    std::vector<Vec2> points;
+
+    PointBuffer() = default;
+    PointBuffer(size_t capacity);
+
+    /// Adds a point to the end
+    void add(float x, float y);
+    /// Sets the point at `index`, starting at 1, the buffer grows to fit it with points at 0, 0
+    void set(size_t index, float x, float y);
+    /// Point at `index`, starting at 1, 0, 0 if there is none
+    Vec2 get(size_t index) const;
+    size_t size() const
+    {
+        return points.size();
+    }
+    void clear()
+    {
+        points.clear();
+    }
+};
+
+// The points of a PointBuffer, a flat array of coordinates `{x1, y1, x2, y2, ...}` or an array of Vec2 at `index` on the stack
+// Arrays are read straight from the stack into a buffer reused by every call, the span is only valid until the next one
+std::span<const Vec2> get_poly_points(lua_State* L, int index);
+
+namespace NPointBuffer
+{
+void register_usertypes(sol::state& lua);
+};
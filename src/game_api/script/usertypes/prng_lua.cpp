@@ -1,6 +1,7 @@
 #include "prng_lua.hpp"
 
 #include <algorithm>   // for max
+#include <cstddef>     // for size_t
 #include <cstdint>     // for int64_t
 #include <new>         // for operator new
 #include <optional>    // for optional
@@ -15,6 +16,14 @@
 
 namespace NPRNG
 {
+// A negative count would turn into a huge size and try to allocate it
+std::size_t checked_count(std::int64_t count)
+{
+    if (count < 0)
+        throw sol::error{"count can't be negative"};
+    return static_cast<std::size_t>(count);
+}
+
 void register_usertypes(sol::state& lua)
 {
     auto random = sol::overload(static_cast<float (PRNG::*)()>(&PRNG::random), static_cast<std::optional<std::int64_t> (PRNG::*)(std::int64_t)>(&PRNG::random), static_cast<std::int64_t (PRNG::*)(std::int64_t, std::int64_t)>(&PRNG::random));
@@ -41,6 +50,12 @@ void register_usertypes(sol::state& lua)
         &PRNG::random_index,
         "random_int",
         &PRNG::random_int,
+        "random_ints",
+        [](PRNG& prng, std::int64_t count, std::int64_t min, std::int64_t max, PRNG::PRNG_CLASS type)
+        { return prng.random_ints(checked_count(count), min, max, type); },
+        "random_floats",
+        [](PRNG& prng, std::int64_t count, PRNG::PRNG_CLASS type)
+        { return prng.random_floats(checked_count(count), type); },
         "random",
         random,
         "get_pair",
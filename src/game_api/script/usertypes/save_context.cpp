@@ -10,7 +10,9 @@
 #include <type_traits> // for move, declval
 #include <utility>     // for min, max, swap
 
-#include "file_api.hpp" // for MakeSavePathCallback
+#include "async_file_writer.hpp"  // for AsyncFileWriter
+#include "file_api.hpp"           // for MakeSavePathCallback
+#include "script/lua_backend.hpp" // for LuaBackend
 
 extern MakeSavePathCallback g_MakeSavePathCallback;
 
@@ -21,6 +23,8 @@ SaveContext::SaveContext(std::string_view _script_path, std::string_view _script
 bool SaveContext::Save(std::string data) const
 {
     const auto save_file_path = g_MakeSavePathCallback(script_path, script_name);
+    // An older async save of the same file must not land after this one
+    AsyncFileWriter::get().flush();
     if (auto data_file = std::ofstream{save_file_path})
     {
         data_file << data << std::flush;
@@ -28,6 +32,13 @@ bool SaveContext::Save(std::string data) const
     }
     return false;
 }
+void SaveContext::SaveAsync(std::string data, sol::optional<sol::function> callback) const
+{
+    // Text mode like Save, so Load reads back the same either way
+    auto done = AsyncFileWriter::get().write(g_MakeSavePathCallback(script_path, script_name), std::move(data), std::ios_base::out);
+    auto backend = LuaBackend::get_calling_backend();
+    backend->async_save_callbacks.push_back({std::move(done), callback.value_or(sol::function{})});
+}
 
 LoadContext::LoadContext(std::string_view _script_path, std::string_view _script_name)
     : script_path{_script_path}, script_name{_script_name}
@@ -38,6 +49,7 @@ std::string LoadContext::Load() const
     std::string data;
 
     const auto save_file_path = g_MakeSavePathCallback(script_path, script_name);
+    AsyncFileWriter::get().flush();
     if (auto data_file = std::ifstream{save_file_path})
     {
         data_file.seekg(0, std::ios::end);
@@ -57,9 +69,11 @@ void register_usertypes(sol::state& lua)
     /// Context received in ON.SAVE
     /// Used to save a string to some form of save_{}.dat
     /// Future calls to this will override the save
-    lua.new_usertype<SaveContext>("SaveContext", sol::no_constructor, "save", &SaveContext::Save);
+    /// `save_async` writes on a background thread instead, the file is replaced atomically once it's written and `callback(success)` is called in a later frame
+    lua.new_usertype<SaveContext>("SaveContext", sol::no_constructor, "save", &SaveContext::Save, "save_async", &SaveContext::SaveAsync);
     /* SaveContext
         bool save(string data)
+        nil save_async(string data, optional<function> callback)
         */
 
     /// Context received in ON.LOAD
@@ -1,12 +1,8 @@
 #pragma once
 
-#include <string>      // for string
-#include <string_view> // for string_view
-
-namespace sol
-{
-class state;
-} // namespace sol
+#include <sol/forward.hpp> // for state, function, optional
+#include <string>          // for string
+#include <string_view>     // for string_view
 
 class SaveContext
 {
@@ -14,6 +10,8 @@ class SaveContext
     SaveContext(std::string_view script_path, std::string_view script_name);
 
     bool Save(std::string data) const;
+    // Hands the write to the async file writer, `callback(success)` runs in a later update of the calling script
+    void SaveAsync(std::string data, sol::optional<sol::function> callback) const;
 
   private:
     std::string_view script_path;
@@ -10,12 +10,13 @@
 #include <type_traits> // for move, declval
 #include <utility>     // for min, max
 
-#include "aliases.hpp"       // for JournalPageType, JournalPageType::Bestiary
-#include "entity.hpp"        // IWYU pragma: keep
-#include "particles.hpp"     // IWYU pragma: keep
-#include "screen.hpp"        // for ScreenCharacterSelect, ScreenOnlineLobby
-#include "screen_arena.hpp"  // for ScreenArenaStagesSelect, ScreenArenaIntro
-#include "sound_manager.hpp" //
+#include "aliases.hpp"           // for JournalPageType, JournalPageType::Bestiary
+#include "entity.hpp"            // IWYU pragma: keep
+#include "particles.hpp"         // IWYU pragma: keep
+#include "screen.hpp"            // for ScreenCharacterSelect, ScreenOnlineLobby
+#include "screen_arena.hpp"      // for ScreenArenaStagesSelect, ScreenArenaIntro
+#include "script/sol_helper.hpp" // for ContainerView
+#include "sound_manager.hpp"     //
 
 namespace NScreen
 {
@@ -684,7 +685,8 @@ void register_usertypes(sol::state& lua)
                     return 1.0f;
                 } }),
         "pages",
-        sol::readonly(&JournalUI::pages));
+        sol::property([](JournalUI& ui)
+                      { return ContainerView{ui.pages}; }));
 
     /// Used in [set_callback](#set_callback) with ON.RENDER_POST_JOURNAL_PAGE
     lua.new_usertype<JournalPage>(
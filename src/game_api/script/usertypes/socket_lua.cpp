@@ -1,12 +1,17 @@
 #include "socket_lua.hpp"
 #include "socket.hpp"
 
+#include <memory>      // for shared_ptr, make_shared
+#include <optional>    // for optional
 #include <sol/sol.hpp> // for global_table, proxy_key_t, function
 #include <sys/types.h> // for ssize_t
+#include <vector>      // for vector
 
-#include "logger.h"               // for DEBUG, ByteStr
-#include "script/lua_backend.hpp" // for LuaBackend
-#include "script/safe_cb.hpp"     // for make_safe_cb
+#include "entity_stream.hpp"              // for EntityStream
+#include "logger.h"                       // for DEBUG, ByteStr
+#include "script/handle_lua_function.hpp" // for handle_function
+#include "script/lua_backend.hpp"         // for LuaBackend, UdpListenerCallback
+#include "script/safe_cb.hpp"             // for make_safe_cb
 
 namespace NSocket
 {
@@ -14,15 +19,63 @@ void register_usertypes(sol::state& lua)
 {
     lua.new_usertype<UdpServer>(
         "UdpServer",
-        sol::no_constructor);
-    /// Start an UDP server on specified address and run callback when data arrives. Return a string from the callback to reply. Requires unsafe mode.
-    /// The server will be closed once the handle is released.
-    lua["udp_listen"] = [](std::string host, in_port_t port, sol::function cb) -> UdpServer*
+        sol::no_constructor,
+        "close",
+        &UdpServer::clear,
+        "send",
+        &UdpServer::send,
+        "get_dropped",
+        &UdpServer::get_dropped);
+    lua.new_usertype<UdpPacket>(
+        "UdpPacket",
+        sol::no_constructor,
+        "data",
+        sol::readonly(&UdpPacket::data),
+        "host",
+        sol::readonly(&UdpPacket::host),
+        "port",
+        sol::readonly(&UdpPacket::port));
+
+    auto listen = [](std::string host, in_port_t port, sol::function cb, bool batched) -> std::shared_ptr<UdpServer>
     {
-        // TODO: change the return to std::unique_ptr after fixing the dead lock with the destructor
-        UdpServer* server = new UdpServer(std::move(host), std::move(port), make_safe_cb<UdpServer::SocketCb>(std::move(cb)));
+        auto backend = LuaBackend::get_calling_backend();
+        auto server = std::make_shared<UdpServer>(std::move(host), port);
+        backend->udp_listeners.push_back({server, std::move(cb), batched});
         return server;
     };
+    /// Start an UDP server on specified address and run callback when data arrives. Return a string from the callback to reply. Requires unsafe mode.
+    /// Datagrams are received on a separate thread and the callback is called for each of them at the start of the next frame.
+    /// The server will be closed once the handle is released or closed.
+    /// The callback signature is optional<string> cb(string data)
+    lua["udp_listen"] = [listen](std::string host, in_port_t port, sol::function cb) -> std::shared_ptr<UdpServer>
+    {
+        return listen(std::move(host), port, std::move(cb), false);
+    };
+    /// Same as [udp_listen](#udp_listen), but the callback is called once per frame with all datagrams that arrived since the last frame, oldest first.
+    /// Reply with UdpServer:send.
+    /// The callback signature is nil cb(array<UdpPacket> packets)
+    lua["udp_listen_batch"] = [listen](std::string host, in_port_t port, sol::function cb) -> std::shared_ptr<UdpServer>
+    {
+        return listen(std::move(host), port, std::move(cb), true);
+    };
+
+    lua.new_usertype<EntityStream>(
+        "EntityStream",
+        sol::no_constructor,
+        "close",
+        &EntityStream::close,
+        "get_viewers",
+        &EntityStream::get_viewers,
+        "get_bytes_sent",
+        &EntityStream::get_bytes_sent);
+    /// Stream the positions, types and states of the entities matching `mask` (ENTITY_MASK.ANY by default) to remote viewers, after every update. Requires unsafe mode.
+    /// Viewers subscribe by sending any datagram to the port and have to keep sending one at least every 10 seconds, "bye" unsubscribes.
+    /// Every frame only has what changed since the last one, quantized to 1/256 tiles, with all the entities every `keyframe_interval` frames (default 60) and whenever a viewer joins.
+    /// The format is described in entity_stream.hpp. The stream is closed once the handle is released or closed
+    lua["start_entity_stream"] = [](std::string host, in_port_t port, std::optional<ENTITY_MASK> mask, std::optional<uint32_t> keyframe_interval) -> std::shared_ptr<EntityStream>
+    {
+        return std::make_shared<EntityStream>(std::move(host), port, mask.value_or(ENTITY_MASK::ANY), keyframe_interval.value_or(60));
+    };
 
     /// Send data to specified UDP address. Requires unsafe mode.
     lua["udp_send"] = [](std::string host, in_port_t port, std::string msg)
@@ -32,8 +85,17 @@ void register_usertypes(sol::state& lua)
         sock.send_to(msg, addr);
     };
 
-    /// Hook the sendto and recvfrom functions and start dumping network data to terminal
-    lua["dump_network"] = dump_network;
+    /// Hook the sendto and recvfrom functions and start capturing network data to a pcap file that can be opened with Wireshark, `network.pcap` in the game folder by default.
+    /// Packets are copied into a buffer by the hooks and written to the file in the background, returns false if the file couldn't be opened or a capture is already running.
+    lua["dump_network"] = [](std::optional<std::string> path) -> bool
+    {
+        return dump_network(path.value_or("network.pcap"));
+    };
+    /// Stop the capture started with [dump_network](#dump_network), the rest of the packets are written and the file is closed in the background
+    lua["stop_dump_network"] = []()
+    {
+        stop_dump_network();
+    };
 
     /// Send a synchronous HTTP GET request and return response as a string or nil on an error
     lua["http_get"] = [&lua](std::string url) -> sol::optional<std::string>
@@ -57,5 +119,42 @@ void register_usertypes(sol::state& lua)
     {
         new HttpRequest(std::move(url), make_safe_cb<HttpRequest::HttpCb>(std::move(on_data)));
     };
+
+    /// Send an asynchronous HTTP GET request and write the response to a file as it arrives, without keeping it in memory. The file is removed again if the request fails.
+    /// The callback signature is nil on_done(string error), error is nil if the download succeeded
+    lua["http_download_async"] = [](std::string url, std::string path, sol::function on_done)
+    {
+        http_download_async(std::move(url), std::move(path), make_safe_cb<HttpDownloadCb>(std::move(on_done)));
+    };
+}
+
+void deliver_udp_packets(LuaBackend& backend)
+{
+    std::erase_if(backend.udp_listeners, [](const UdpListenerCallback& listener)
+                  { return listener.server.expired(); });
+
+    // Copied, the callbacks may start or stop servers
+    std::vector<UdpListenerCallback> listeners = backend.udp_listeners;
+    for (UdpListenerCallback& listener : listeners)
+    {
+        std::shared_ptr<UdpServer> server = listener.server.lock();
+        if (server == nullptr)
+            continue;
+
+        std::vector<UdpPacket> packets = server->take_packets();
+        if (packets.empty())
+            continue;
+
+        if (listener.batched)
+        {
+            handle_function<void>(&backend, listener.func, sol::as_table(std::move(packets)));
+            continue;
+        }
+        for (UdpPacket& packet : packets)
+        {
+            if (std::optional<std::string> reply = handle_function<std::string>(&backend, listener.func, std::move(packet.data)))
+                server->send(reply.value(), packet.host, packet.port);
+        }
+    }
 }
 }; // namespace NSocket
@@ -2,7 +2,11 @@
 
 #include <sol/sol.hpp> // for state, optional
 
+class LuaBackend;
+
 namespace NSocket
 {
 void register_usertypes(sol::state& lua);
+// Hands the datagrams the servers of this backend received to its Lua callbacks, called once per frame
+void deliver_udp_packets(LuaBackend& backend);
 };
@@ -9,7 +9,7 @@
 #include <fmt/format.h>  // for format_error
 #include <functional>    // for _Func_impl_no_alloc<>::_Mybase
 #include <locale>        // for num_put
-#include <memory>        // for allocator, make_unique
+#include <memory>        // for allocator, make_unique, make_shared
 #include <mutex>         // for lock_guard
 #include <new>           // for operator new
 #include <optional>      // for nullopt
@@ -33,6 +33,21 @@
 
 namespace NSound
 {
+// FMOD calls the sound callbacks on its own threads, there they are only queued and the backend runs them at the start of its next update,
+// so audio never waits until the game thread lets go of the Lua lock
+template <class... ArgsT, class CallbackT>
+std::function<void(ArgsT...)> queue_sound_callback(CallbackT callback)
+{
+    auto queue = LuaBackend::get_calling_backend()->sound_callback_queue;
+    // Shared so FMOD's thread never copies the Lua function itself
+    auto shared_callback = std::make_shared<CallbackT>(std::move(callback));
+    return [queue = std::move(queue), shared_callback = std::move(shared_callback)](ArgsT... args)
+    {
+        queue->push([shared_callback, ... args = std::move(args)]() mutable
+                    { (*shared_callback)(std::move(args)...); });
+    };
+}
+
 void register_usertypes(sol::state& lua, SoundManager* sound_manager)
 {
     assert(sound_manager != nullptr && sound_manager->is_init());
@@ -48,10 +63,11 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
     }
 
     /// Loads a sound from disk relative to this script, ownership might be shared with other code that loads the same file. Returns nil if file can't be found
-    lua["create_sound"] = [](std::string path) -> sol::optional<CustomSound>
+    /// Set `stream` for long music tracks, the file is then read and decoded while it plays instead of being loaded into memory at once. A streamed sound can only be played once at a time.
+    lua["create_sound"] = [](std::string path, std::optional<bool> stream) -> sol::optional<CustomSound>
     {
         auto backend = LuaBackend::get_calling_backend();
-        if (CustomSound sound = backend->sound_manager->get_sound((backend->get_root_path() / path).string()))
+        if (CustomSound sound = backend->sound_manager->get_sound((backend->get_root_path() / path).string(), stream.value_or(false)))
         {
             return sound;
         }
@@ -75,8 +91,8 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
 
     /// Returns unique id for the callback to be used in [clear_vanilla_sound_callback](#clear_vanilla_sound_callback).
     /// Sets a callback for a vanilla sound which lets you hook creation or playing events of that sound
-    /// Callbacks are executed on another thread, so avoid touching any global state, only the local Lua state is protected
-    /// If you set such a callback and then play the same sound yourself you have to wait until receiving the STARTED event before changing any properties on the sound. Otherwise you may cause a deadlock.
+    /// The events happen on the audio thread, the callbacks are queued and run at the start of the script's next update in the order they happened, so the sound may have changed or stopped by then
+    /// If you set such a callback and then play the same sound yourself you have to wait until receiving the STARTED event before changing any properties on the sound.
     /// <br/>The callback signature is nil on_vanilla_sound(PlayingSound sound)
     lua["set_vanilla_sound_callback"] = [](VANILLA_SOUND name, VANILLA_SOUND_CALLBACK_TYPE types, sol::function cb) -> CallbackId
     {
@@ -84,10 +100,10 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
         {
             return std::make_unique<PlayingSound>(sound);
         };
-        auto safe_cb = make_safe_cb<void(PlayingSound)>(
+        auto safe_cb = queue_sound_callback<PlayingSound>(make_safe_cb<void(PlayingSound)>(
             std::move(cb),
             FrontBinder{},
-            BackBinder{clone_sound});
+            BackBinder{clone_sound}));
 
         auto backend = LuaBackend::get_calling_backend();
         std::uint32_t id = backend->sound_manager->set_callback(name, std::move(safe_cb), static_cast<FMODStudio::EventCallbackType>(types));
@@ -107,10 +123,12 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
     };
 
     {
-        auto play = sol::overload(
-            static_cast<PlayingSound (CustomSound::*)()>(&CustomSound::play),
-            static_cast<PlayingSound (CustomSound::*)(bool)>(&CustomSound::play),
-            static_cast<PlayingSound (CustomSound::*)(bool, SOUND_TYPE)>(&CustomSound::play));
+        // Goes through the voices of the calling script, nil if its limits don't leave room for the sound
+        auto play = [](CustomSound& self, std::optional<bool> paused, std::optional<SOUND_TYPE> sound_type) -> std::optional<PlayingSound>
+        {
+            auto backend = LuaBackend::get_calling_backend();
+            return backend->sound_voices.play(self, paused.value_or(false), sound_type.value_or(SOUND_TYPE::Sfx));
+        };
         auto get_parameters = [](CustomSound& self)
         {
             return sol::as_table(self.get_parameters());
@@ -127,7 +145,11 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
 
     auto set_callback = [](PlayingSound* sound, sol::function callback)
     {
-        sound->set_callback(make_safe_cb<void()>(std::move(callback)));
+        sound->set_callback(queue_sound_callback<>(make_safe_cb<void()>(std::move(callback))));
+    };
+    auto set_volume = [](PlayingSound& self, float volume)
+    {
+        return LuaBackend::get_calling_backend()->sound_voices.set_volume(self, volume);
     };
     auto get_parameters = [](PlayingSound& self)
     {
@@ -150,7 +172,7 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
         "set_pan",
         &PlayingSound::set_pan,
         "set_volume",
-        &PlayingSound::set_volume,
+        set_volume,
         "set_looping",
         &PlayingSound::set_looping,
         "set_callback",
@@ -198,12 +220,53 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
         sol::property([](SoundInfo& si)                 // -> VANILLA_SOUND
                       { return si.sound_name /**/; })); // return copy, so it's read only
 
-    auto play_sound = sol::overload(static_cast<SoundMeta* (*)(SOUNDID, uint32_t)>(::play_sound), static_cast<SoundMeta* (*)(VANILLA_SOUND, uint32_t)>(::play_sound));
+    auto play_sound = sol::overload(
+        [](SOUNDID sound_id, uint32_t source_uid) -> SoundMeta*
+        {
+            if (LuaBackend::get_calling_backend()->sound_voices.is_culled(source_uid))
+                return nullptr;
+            return ::play_sound(sound_id, source_uid);
+        },
+        [](VANILLA_SOUND sound, uint32_t source_uid) -> SoundMeta*
+        {
+            if (LuaBackend::get_calling_backend()->sound_voices.is_culled(source_uid))
+                return nullptr;
+            return ::play_sound(std::move(sound), source_uid);
+        });
 
     /// Use source_uid to make the sound be played at the location of that entity, set it -1 to just play it "everywhere"
     /// Returns SoundMeta, beware that the sound can't be stopped (`start_over` and `playing` are unavailable). Should only be used for sfx.
+    /// Returns nil if the source entity is further from the camera than the distance set with `set_sound_cull_distance`
     lua["play_sound"] = play_sound;
 
+    /// Limits how many instances of `sound` played by this script with `CustomSound:play()` can play at once, 0 removes the limit
+    /// When the limit is hit a playing instance is stopped to make room, or the new one isn't played, see `set_sound_steal_policy`
+    lua["set_sound_voice_limit"] = [](CustomSound& sound, uint32_t max_instances)
+    {
+        LuaBackend::get_calling_backend()->sound_voices.set_sound_limit(sound, max_instances);
+    };
+    /// Limits how many sounds played by this script with `CustomSound:play()` can play at once, 0 removes the limit
+    lua["set_sound_voice_budget"] = [](uint32_t max_voices)
+    {
+        LuaBackend::get_calling_backend()->sound_voices.set_budget(max_voices);
+    };
+    /// Sets which sound is stopped when a voice limit or the voice budget is hit, defaults to `VOICE_STEAL.OLDEST`
+    /// `VOICE_STEAL.QUIETEST` goes by the volume set with `PlayingSound:set_volume()`, sounds it wasn't called on count as full volume
+    lua["set_sound_steal_policy"] = [](VOICE_STEAL policy)
+    {
+        LuaBackend::get_calling_backend()->sound_voices.set_policy(policy);
+    };
+    /// Makes `play_sound` skip sounds whose source entity is further than `distance` from the camera, 0 disables it
+    lua["set_sound_cull_distance"] = [](float distance)
+    {
+        LuaBackend::get_calling_backend()->sound_voices.set_cull_distance(distance);
+    };
+    /// Returns how many sounds played by this script with `CustomSound:play()` are still playing, only counted while a limit or budget is set
+    lua["get_sound_voice_count"] = []() -> uint32_t
+    {
+        return LuaBackend::get_calling_backend()->sound_voices.count();
+    };
+
     // lua["convert_sound_id"] = convert_sound_id;
     /// NoDoc
     lua["convert_sound_id"] = sol::overload([](SOUNDID id) -> const VANILLA_SOUND&
@@ -217,6 +280,9 @@ void register_usertypes(sol::state& lua, SoundManager* sound_manager)
     lua.create_named_table("SOUND_TYPE", "SFX", 0, "MUSIC", 1);
     /// Paramater to `PlayingSound:set_looping()`, specifies what type of looping this sound should do
     lua.create_named_table("SOUND_LOOP_MODE", "OFF", 0, "LOOP", 1, "BIDIRECTIONAL", 2);
+    /// Parameter to `set_sound_steal_policy()`
+    /// NONE: the new sound isn't played, OLDEST: the sound that started first is stopped, QUIETEST: the sound with the lowest volume is stopped
+    lua.create_named_table("VOICE_STEAL", "NONE", VOICE_STEAL::NONE, "OLDEST", VOICE_STEAL::OLDEST, "QUIETEST", VOICE_STEAL::QUIETEST);
     /// Paramater to `get_sound()`, which returns a handle to a vanilla sound, and `set_vanilla_sound_callback()`,
     lua.create_named_table("VANILLA_SOUND"
                            //, "BGM_BGM_TITLE", BGM/BGM_title
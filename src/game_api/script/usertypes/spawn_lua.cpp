@@ -28,6 +28,23 @@ void register_usertypes(sol::state& lua)
     lua["spawn_entity"] = spawn_entity_abs;
     /// Short for [spawn_entity](#spawn_entity).
     lua["spawn"] = spawn_entity_abs;
+    /// Spawn many entities at once in the same layer and return their uids, `entity_types` can hold a single type used for every position or one type per position.
+    /// Same as calling [spawn_entity](#spawn_entity) for each position without velocity, but a lot cheaper when spawning hundreds of entities.
+    lua["spawn_entities"] = spawn_entities_abs;
+    /// Create an empty [SpawnBatch](#SpawnBatch), queue spawns with `add` and run them all with `spawn`.
+    /// Spawn callbacks still run for every entity, but the batch sets them up once instead of once per entity, which adds up when spawning hundreds of entities in `ON.POST_LEVEL_GENERATION`.
+    lua.new_usertype<SpawnBatch>(
+        "SpawnBatch",
+        sol::constructors<SpawnBatch()>{},
+        "add",
+        &SpawnBatch::add,
+        "size",
+        &SpawnBatch::size,
+        "clear",
+        &SpawnBatch::clear,
+        "spawn",
+        &SpawnBatch::spawn);
+
     /// Spawns an entity directly on the floor below the tile at the given position.
     /// Use this to avoid the little fall that some entities do when spawned during level gen callbacks.
     lua["spawn_entity_snapped_to_floor"] = spawn_entity_snap_to_floor;
@@ -105,6 +122,8 @@ void register_usertypes(sol::state& lua)
 
         auto backend = LuaBackend::get_calling_backend();
         backend->pre_entity_spawn_callbacks.push_back(EntitySpawnCallback{backend->cbcount, mask, std::move(proper_types), flags, std::move(cb)});
+        backend->pre_entity_spawn_index.add(backend->pre_entity_spawn_callbacks.back(), backend->pre_entity_spawn_callbacks.size() - 1);
+        LuaBackend::invalidate_subscribers();
         return backend->cbcount++;
     };
     /// Add a callback for a spawn of specific entity types or mask. Set `mask` to `MASK.ANY` to ignore that.
@@ -126,6 +145,8 @@ void register_usertypes(sol::state& lua)
 
         auto backend = LuaBackend::get_calling_backend();
         backend->post_entity_spawn_callbacks.push_back(EntitySpawnCallback{backend->cbcount, mask, std::move(proper_types), flags, std::move(cb)});
+        backend->post_entity_spawn_index.add(backend->post_entity_spawn_callbacks.back(), backend->post_entity_spawn_callbacks.size() - 1);
+        LuaBackend::invalidate_subscribers();
         return backend->cbcount++;
     };
 
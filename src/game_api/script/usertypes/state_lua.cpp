@@ -4,6 +4,7 @@
 #include <cstdint>                // for uint8_t
 #include <locale>                 // for num_put
 #include <new>                    // for operator new
+#include <optional>               // for optional
 #include <sol/sol.hpp>            // for data_t, global_table, state, proxy...
 #include <sol/usertype.hpp>       // for basic_usertype
 #include <sol/usertype_proxy.hpp> // for usertype_proxy
@@ -17,20 +18,39 @@
 #include "illumination.hpp"       // IWYU pragma: keep
 #include "items.hpp"              // for Items, SelectPlayerSlot, Items::is...
 #include "level_api.hpp"          // IWYU pragma: keep
+#include "liquid_budget.hpp"      // for LiquidBudget, LiquidStats, LiquidEngineStats
 #include "liquid_engine.hpp"      // for LiquidPhysicsEngine
 #include "online.hpp"             // for OnlinePlayer, OnlineLobby, Online
 #include "prng.hpp"               // IWYU pragma: keep
 #include "rpc.hpp"                // for waddler_count_entity ...
-#include "savestate.hpp"          // for SaveState
+#include "savestate.hpp"          // for SaveState, SaveStatePool
+#include "savestate_ring.hpp"     // for SaveStateRing
 #include "screen.hpp"             // IWYU pragma: keep
 #include "screen_arena.hpp"       // IWYU pragma: keep
+#include "screen_transform.hpp"   // for ScreenTransform
 #include "script/events.hpp"      // for pre_load_state
 #include "script/lua_backend.hpp" // for LuaBackend
 #include "state.hpp"              // for StateMemory, StateMemory::a...
+#include "state_hash.hpp"         // for StateHash, StateDiffChunk
 #include "state_structs.hpp"      // for ArenaConfigArenas, ArenaConfigItems
+#include "state_tree.hpp"         // for StateTree
 
 namespace NState
 {
+// Fields that move the camera drop the cached screen transform, so positions converted later in the same frame see the write
+template <class T>
+auto camera_property(T Camera::*member)
+{
+    return sol::property(
+        [member](const Camera& camera) -> T
+        { return camera.*member; },
+        [member](Camera& camera, T value)
+        {
+            camera.*member = value;
+            ScreenTransform::invalidate();
+        });
+}
+
 void register_usertypes(sol::state& lua)
 {
     /// Used in ArenaState
@@ -235,6 +255,43 @@ void register_usertypes(sol::state& lua)
         "players",
         &Items::players);
 
+    lua.new_usertype<LiquidEngineStats>(
+        "LiquidEngineStats",
+        sol::no_constructor,
+        "count",
+        sol::readonly(&LiquidEngineStats::count),
+        "allocated",
+        sol::readonly(&LiquidEngineStats::allocated),
+        "paused",
+        sol::readonly(&LiquidEngineStats::paused));
+    lua.new_usertype<LiquidStats>(
+        "LiquidStats",
+        sol::no_constructor,
+        "engines",
+        sol::readonly(&LiquidStats::engines),
+        "total_count",
+        sol::readonly(&LiquidStats::total_count),
+        "update_ms",
+        sol::readonly(&LiquidStats::update_ms),
+        "average_update_ms",
+        sol::readonly(&LiquidStats::average_update_ms),
+        "skip_level",
+        sol::readonly(&LiquidStats::skip_level),
+        "skipped_updates",
+        sol::readonly(&LiquidStats::skipped_updates));
+
+    /// Get the blob counts of every liquid engine and how long the last game update took, see [LiquidStats](#LiquidStats)
+    lua["get_liquid_stats"] = []() -> LiquidStats
+    { return LiquidBudget::get().stats(); };
+    /// Limit how much of the game update the liquids may take. While the average game update takes longer than `update_ms` and there are liquids,
+    /// the liquid simulation is skipped on up to `max_skip` (default 3) updates in a row, so the liquids move slower instead of the whole game.
+    /// Engines paused by a script are left alone. Set `update_ms` to 0 to turn it off, it's also turned off when the script is unloaded
+    lua["set_liquid_budget"] = [](float update_ms, std::optional<uint32_t> max_skip)
+    {
+        LuaBackend::get_calling_backend()->liquid_budget = update_ms > 0.0f;
+        LiquidBudget::get().set_budget(update_ms, max_skip.value_or(3));
+    };
+
     /// Used in LiquidPool
     lua.new_usertype<LiquidPhysicsEngine>(
         "LiquidPhysicsEngine",
@@ -420,19 +477,12 @@ void register_usertypes(sol::state& lua)
 
     auto state_get_user_data = [](StateMemory& state) -> sol::object
     {
-        auto backend = LuaBackend::get_calling_backend();
-        auto local_datas = backend->local_state_datas;
-        if (local_datas.contains(&state))
-        {
-            return local_datas[&state].user_data;
-        }
-        return sol::nil;
+        return LuaBackend::get_calling_backend()->get_state_user_data(&state);
     };
 
     auto state_set_user_data = [](StateMemory& state, sol::object user_data) -> void
     {
-        auto backend = LuaBackend::get_calling_backend();
-        backend->local_state_datas[&state].user_data = user_data;
+        LuaBackend::get_calling_backend()->set_state_user_data(&state, std::move(user_data));
     };
     auto user_data = sol::property(state_get_user_data, state_set_user_data);
 
@@ -441,6 +491,7 @@ void register_usertypes(sol::state& lua)
     // user_data
     // You can store a table (or lua primitive) here and it will store data correctly in online multiplayer, by having a different copy on each state and being copied over when the game does.
     // Doesn't support recursive tables / cyclic references. Metatables will be transferred by reference instead of being copied
+    // Copies are made lazily, a table that was never handed to the script is shared between copies until it's read from either of them
     */
 
     lua.create_named_table("FADE", "NONE", 0, "OUT", 1, "LOAD", 2, "IN", 3);
@@ -501,19 +552,19 @@ void register_usertypes(sol::state& lua)
     */
 
     auto camera_type = lua.new_usertype<Camera>("Camera");
-    camera_type["bounds_left"] = &Camera::bounds_left;
-    camera_type["bounds_right"] = &Camera::bounds_right;
-    camera_type["bounds_bottom"] = &Camera::bounds_bottom;
-    camera_type["bounds_top"] = &Camera::bounds_top;
-    camera_type["calculated_focus_x"] = &Camera::calculated_focus_x;
-    camera_type["calculated_focus_y"] = &Camera::calculated_focus_y;
-    camera_type["adjusted_focus_x"] = &Camera::adjusted_focus_x;
-    camera_type["adjusted_focus_y"] = &Camera::adjusted_focus_y;
-    camera_type["focus_offset_x"] = &Camera::focus_offset_x;
-    camera_type["focus_offset_y"] = &Camera::focus_offset_y;
-    camera_type["focus_x"] = &Camera::focus_x;
-    camera_type["focus_y"] = &Camera::focus_y;
-    camera_type["vertical_pan"] = &Camera::vertical_pan;
+    camera_type["bounds_left"] = camera_property(&Camera::bounds_left);
+    camera_type["bounds_right"] = camera_property(&Camera::bounds_right);
+    camera_type["bounds_bottom"] = camera_property(&Camera::bounds_bottom);
+    camera_type["bounds_top"] = camera_property(&Camera::bounds_top);
+    camera_type["calculated_focus_x"] = camera_property(&Camera::calculated_focus_x);
+    camera_type["calculated_focus_y"] = camera_property(&Camera::calculated_focus_y);
+    camera_type["adjusted_focus_x"] = camera_property(&Camera::adjusted_focus_x);
+    camera_type["adjusted_focus_y"] = camera_property(&Camera::adjusted_focus_y);
+    camera_type["focus_offset_x"] = camera_property(&Camera::focus_offset_x);
+    camera_type["focus_offset_y"] = camera_property(&Camera::focus_offset_y);
+    camera_type["focus_x"] = camera_property(&Camera::focus_x);
+    camera_type["focus_y"] = camera_property(&Camera::focus_y);
+    camera_type["vertical_pan"] = camera_property(&Camera::vertical_pan);
     camera_type["shake_countdown_start"] = &Camera::shake_countdown_start;
     camera_type["shake_countdown"] = &Camera::shake_countdown;
     camera_type["shake_amplitude"] = &Camera::shake_amplitude;
@@ -525,7 +576,11 @@ void register_usertypes(sol::state& lua)
     camera_type["peek_timer"] = &Camera::peek_timer;
     camera_type["peek_layer"] = &Camera::peek_layer;
     camera_type["get_bounds"] = &Camera::get_bounds;
-    camera_type["set_bounds"] = &Camera::set_bounds;
+    camera_type["set_bounds"] = [](Camera& camera, AABB bounds)
+    {
+        camera.set_bounds(bounds);
+        ScreenTransform::invalidate();
+    };
 
     /// Can be accessed via global [online](#online)
     lua.new_usertype<Online>(
@@ -648,9 +703,119 @@ void register_usertypes(sol::state& lua)
         &SaveState::get_frame,
         "get_prng",
         &SaveState::get_prng,
+        "hash",
+        &SaveState::hash,
+        "hash_chunks",
+        &SaveState::hash_chunks,
+        "diff",
+        &SaveState::diff,
         "get",
         get);
 
+    lua.new_usertype<StateDiffChunk>(
+        "StateDiffChunk",
+        sol::no_constructor,
+        "chunk",
+        sol::readonly(&StateDiffChunk::chunk),
+        "offset",
+        sol::readonly(&StateDiffChunk::offset),
+        "region",
+        sol::readonly(&StateDiffChunk::region),
+        "fields",
+        sol::readonly(&StateDiffChunk::fields));
+
+    /// Hash the current state, all of it or only the listed chunks, same as SaveState:hash
+    lua["get_state_hash"] = [](std::optional<std::vector<uint32_t>> chunks) -> uint32_t
+    {
+        return StateHash::hash(HeapBase::get(), chunks ? &chunks.value() : nullptr);
+    };
+    /// Get the hashes of all the 4KiB chunks of the current state, same as SaveState:hash_chunks
+    lua["get_state_chunk_hashes"] = []() -> std::vector<uint32_t>
+    {
+        return StateHash::hash_chunks(HeapBase::get());
+    };
+    /// Compare two lists of chunk hashes, e.g. your own and the ones sent by another player, returns the chunks that differ and the parts of the state they hold
+    lua["diff_state_hashes"] = [](std::vector<uint32_t> hashes, std::vector<uint32_t> other_hashes) -> std::vector<StateDiffChunk>
+    {
+        return StateHash::diff_hashes(hashes, other_hashes);
+    };
+
+    lua.new_usertype<SaveStatePool>(
+        "SaveStatePool",
+        sol::constructors<SaveStatePool(uint32_t)>(),
+        "save",
+        &SaveStatePool::save,
+        "load",
+        &SaveStatePool::load,
+        "has",
+        &SaveStatePool::has,
+        "get_state",
+        &SaveStatePool::get_state,
+        "remove",
+        &SaveStatePool::remove,
+        "clear",
+        &SaveStatePool::clear,
+        "size",
+        &SaveStatePool::size,
+        "capacity",
+        &SaveStatePool::capacity,
+        "set_capacity",
+        &SaveStatePool::set_capacity);
+
+    lua.new_usertype<SaveStateRing>(
+        "SaveStateRing",
+        sol::constructors<SaveStateRing(uint32_t, std::optional<uint32_t>)>(),
+        "push",
+        &SaveStateRing::push,
+        "prefetch",
+        &SaveStateRing::prefetch,
+        "load",
+        &SaveStateRing::load,
+        "clear",
+        &SaveStateRing::clear,
+        "size",
+        &SaveStateRing::size,
+        "memory_usage",
+        &SaveStateRing::memory_usage);
+
+    auto set_scorer = [](StateTree& tree, sol::optional<sol::function> scorer)
+    {
+        if (scorer)
+            tree.set_scorer([scorer = std::move(scorer.value())](StateMemory* state) -> double
+                            { return scorer.call<double>(state); });
+        else
+            tree.set_scorer(nullptr);
+    };
+    lua.new_usertype<StateTree>(
+        "StateTree",
+        sol::constructors<StateTree(uint32_t)>(),
+        "snapshot",
+        &StateTree::snapshot,
+        "branch",
+        &StateTree::branch,
+        "restore",
+        &StateTree::restore,
+        "set_scorer",
+        set_scorer,
+        "has_state",
+        &StateTree::has_state,
+        "get_score",
+        &StateTree::get_score,
+        "get_parent",
+        &StateTree::get_parent,
+        "get_depth",
+        &StateTree::get_depth,
+        "get_inputs",
+        &StateTree::get_inputs,
+        "best",
+        &StateTree::best,
+        "remove",
+        &StateTree::remove,
+        "clear",
+        &StateTree::clear,
+        "size",
+        &StateTree::size);
+
     /// Get the thread-local version of state
     lua["get_local_state"] = []() -> StateMemory*
     { return HeapBase::get().state(); };
@@ -15,11 +15,13 @@
 #include <type_traits>   // for move, declval
 #include <unordered_map> // for _Umap_traits<>::allocator_type
 #include <utility>       // for min, max
+#include <vector>        // for vector
 
 #include "aliases.hpp"            // for TEXTURE
 #include "file_api.hpp"           // for get_image_file_path
 #include "script/lua_backend.hpp" // for LuaBackend
 #include "texture.hpp"            // for TextureDefinition, get_texture
+#include "texture_atlas.hpp"      // for pack_texture_atlas
 
 namespace NTexture
 {
@@ -56,6 +58,19 @@ void register_usertypes(sol::state& lua)
         resolve_path(texture_data.texture_path);
         return define_texture(std::move(texture_data));
     };
+    /// Defines many small textures at once by packing their images into shared atlas pages in the texture cache, returns the textures in the same order as `texture_datas`.
+    /// The sub image offsets are moved to where each image ended up, so the textures work like ones from [define_texture](#define_texture).
+    /// Images larger than 512x512 or that can't be loaded are defined as separate textures. Set `generate_mipmaps` to give the pages a mip chain, which looks better when zoomed out.
+    lua["define_texture_atlas"] = [](std::vector<TextureDefinition> texture_datas, std::optional<bool> generate_mipmaps) -> std::vector<TEXTURE>
+    {
+        for (TextureDefinition& texture_data : texture_datas)
+            resolve_path(texture_data.texture_path);
+
+        std::vector<TEXTURE> textures;
+        for (TextureDefinition& texture_data : pack_texture_atlas(std::move(texture_datas), generate_mipmaps.value_or(false)))
+            textures.push_back(define_texture(std::move(texture_data)));
+        return textures;
+    };
     /// Gets a texture with the same definition as the given, if none exists returns `nil`
     lua["get_texture"] = [](TextureDefinition texture_data) -> std::optional<TEXTURE>
     {
@@ -81,6 +96,14 @@ void register_usertypes(sol::state& lua)
     lua["reset_texture"] = reset_texture;
     /// Replace a vanilla texture definition with a custom texture definition and reload the texture. Set corresponding character heart color to the pixel in the center of the player indicator arrow in that texture. (448,1472)
     lua["replace_texture_and_heart_color"] = replace_texture_and_heart_color;
+    /// Replace many vanilla texture definitions at once, `replacements` maps vanilla textures to the custom textures replacing them, map a texture to itself to reset it.
+    /// Much faster than calling [replace_texture](#replace_texture) for each of them, the images are converted in parallel and each texture is reloaded once. Also sets the heart colors like [replace_texture_and_heart_color](#replace_texture_and_heart_color) if `heart_colors` is true.
+    /// Returns false if any of the textures couldn't be replaced, the others are still replaced
+    lua["replace_textures"] = [](std::unordered_map<TEXTURE, TEXTURE> replacements, std::optional<bool> heart_colors) -> bool
+    {
+        std::vector<std::pair<TEXTURE, TEXTURE>> pairs{replacements.begin(), replacements.end()};
+        return replace_textures(pairs, heart_colors.value_or(false));
+    };
     /// Clear cache for a file path or the whole directory
     lua["clear_cache"] = sol::overload(
         []()
@@ -1,6 +1,7 @@
 #include "vanilla_render_lua.hpp"
 
 #include <algorithm>   // for max
+#include <array>       // for array
 #include <cstdlib>     // for abs
 #include <locale>      // for num_put
 #include <new>         // for operator new
@@ -10,7 +11,9 @@
 #include <type_traits> // for move, declval
 
 #include "entity.hpp"             // for Entity
+#include "gpu_timing.hpp"         // for GpuTiming, GpuSectionTiming
 #include "particles.hpp"          // for ParticleEmitterInfo
+#include "point_buffer_lua.hpp"   // for get_poly_points
 #include "render_api.hpp"         // for TextureRenderingInfo, WorldShader, TextRen...
 #include "script/lua_backend.hpp" // for get_calling_backend
 #include "state.hpp"              // for enum_to_layer
@@ -18,9 +21,8 @@
 
 void VanillaRenderContext::draw_text(const std::string& text, float x, float y, float scale_x, float scale_y, Color color, VANILLA_TEXT_ALIGNMENT alignment, VANILLA_FONT_STYLE fontstyle)
 {
-    TextRenderingInfo tri{};
-    tri.set_text(text, x, y, scale_x, scale_y, alignment, fontstyle);
-    RenderAPI::get().draw_text(&tri, std::move(color));
+    auto& render_api = RenderAPI::get();
+    render_api.draw_text(render_api.get_prepared_text(text, x, y, scale_x, scale_y, alignment, fontstyle), std::move(color));
 }
 
 void VanillaRenderContext::draw_text(const TextRenderingInfo* tri, Color color)
@@ -136,6 +138,16 @@ void VanillaRenderContext::draw_screen_texture(TEXTURE texture_id, TextureRender
     RenderAPI::get().draw_screen_texture(texture, std::move(tri), std::move(color), 0x29);
 }
 
+void VanillaRenderContext::draw_screen_textures(TEXTURE texture_id, std::vector<Quad> sources, std::vector<Quad> dests, std::vector<Color> colors)
+{
+    auto texture = get_texture(texture_id);
+    if (texture == nullptr)
+    {
+        return;
+    }
+    RenderAPI::get().draw_screen_textures(texture, sources, dests, colors, 0x29);
+}
+
 void VanillaRenderContext::set_corner_finish(CORNER_FINISH c)
 {
     auto backend = LuaBackend::get_calling_backend();
@@ -293,11 +305,11 @@ void VanillaRenderContext::draw_screen_rect_filled(const AABB& rect, Color color
 
 void VanillaRenderContext::draw_screen_triangle(const Triangle& triangle, float thickness, Color color)
 {
-    draw_screen_poly({triangle.A, triangle.B, triangle.C}, thickness, std::move(color), true);
+    draw_screen_poly(std::array{triangle.A, triangle.B, triangle.C}, thickness, std::move(color), true);
 }
 void VanillaRenderContext::draw_screen_triangle_filled(const Triangle& triangle, Color color)
 {
-    draw_screen_poly_filled({triangle.A, triangle.B, triangle.C}, std::move(color));
+    draw_screen_poly_filled(std::array{triangle.A, triangle.B, triangle.C}, std::move(color));
 }
 
 void VanillaRenderContext::draw_screen_line(const Vec2& A, const Vec2& B, float thickness, Color color)
@@ -313,9 +325,9 @@ void VanillaRenderContext::draw_screen_line(const Vec2& A, const Vec2& B, float
 void VanillaRenderContext::draw_screen_poly(const Quad& points, float thickness, Color color, bool closed)
 {
     auto [A, B, C, D] = points.operator std::tuple<Vec2, Vec2, Vec2, Vec2>();
-    draw_screen_poly(std::vector<Vec2>{A, B, C, D}, thickness, color, closed);
+    draw_screen_poly(std::array{A, B, C, D}, thickness, color, closed);
 }
-void VanillaRenderContext::draw_screen_poly(std::vector<Vec2> points, float thickness, Color color, bool closed)
+void VanillaRenderContext::draw_screen_poly(std::span<const Vec2> points, float thickness, Color color, bool closed)
 {
     constexpr float ratio = 16.0f / 9.0f;
 
@@ -362,7 +374,7 @@ void VanillaRenderContext::draw_screen_poly_filled(const Quad& dest, Color color
     auto texture = get_texture(0);                                                       // any texture works
     RenderAPI::get().draw_screen_texture(texture, Quad{}, dest, std::move(color), 0x27); // 0x27 funky shader, 2C also works
 }
-void VanillaRenderContext::draw_screen_poly_filled(std::vector<Vec2> points, Color color)
+void VanillaRenderContext::draw_screen_poly_filled(std::span<const Vec2> points, Color color)
 {
     if (points.size() < 3)
         return;
@@ -461,6 +473,21 @@ void VanillaRenderContext::draw_world_texture(TEXTURE texture_id, const Quad& so
     draw_world_texture(texture_id, source, dest, std::move(color), (WORLD_SHADER)WorldShader::TextureColor);
 }
 
+void VanillaRenderContext::draw_world_textures(TEXTURE texture_id, std::vector<Quad> sources, std::vector<Quad> dests, std::vector<Color> colors, WORLD_SHADER shader)
+{
+    auto texture = get_texture(texture_id);
+    if (texture == nullptr)
+    {
+        return;
+    }
+    RenderAPI::get().draw_world_textures(texture, sources, dests, colors, (WorldShader)shader);
+}
+
+void VanillaRenderContext::draw_world_textures(TEXTURE texture_id, std::vector<Quad> sources, std::vector<Quad> dests, std::vector<Color> colors)
+{
+    draw_world_textures(texture_id, sources, dests, colors, (WORLD_SHADER)WorldShader::TextureColor);
+}
+
 void VanillaRenderContext::draw_world_rect(const AABB& rect, float thickness, Color color, std::optional<float> angle, std::optional<float> px, std::optional<float> py)
 {
     Quad dest{rect};
@@ -495,12 +522,12 @@ void VanillaRenderContext::draw_world_rect_filled(const AABB& rect, Color color,
 
 void VanillaRenderContext::draw_world_triangle(const Triangle& triangle, float thickness, Color color)
 {
-    draw_world_poly({triangle.A, triangle.B, triangle.C}, thickness, std::move(color), true);
+    draw_world_poly(std::array{triangle.A, triangle.B, triangle.C}, thickness, std::move(color), true);
 }
 
 void VanillaRenderContext::draw_world_triangle_filled(const Triangle& triangle, Color color)
 {
-    draw_world_poly_filled({triangle.A, triangle.B, triangle.C}, std::move(color));
+    draw_world_poly_filled(std::array{triangle.A, triangle.B, triangle.C}, std::move(color));
 }
 
 void VanillaRenderContext::draw_world_line(const Vec2& A, const Vec2& B, float thickness, Color color)
@@ -512,10 +539,10 @@ void VanillaRenderContext::draw_world_line(const Vec2& A, const Vec2& B, float t
 void VanillaRenderContext::draw_world_poly(const Quad& points, float thickness, Color color, bool closed)
 {
     auto [A, B, C, D] = points.operator std::tuple<Vec2, Vec2, Vec2, Vec2>();
-    draw_world_poly(std::vector<Vec2>{A, B, C, D}, thickness, color, closed);
+    draw_world_poly(std::array{A, B, C, D}, thickness, color, closed);
 }
 
-void VanillaRenderContext::draw_world_poly(std::vector<Vec2> points, float thickness, Color color, bool closed)
+void VanillaRenderContext::draw_world_poly(std::span<const Vec2> points, float thickness, Color color, bool closed)
 {
     if (points.size() < 2)
         return;
@@ -560,7 +587,7 @@ void VanillaRenderContext::draw_world_poly_filled(const Quad& dest, Color color)
     RenderAPI::get().draw_world_texture(texture, Quad{}, dest, std::move(color), WorldShader::DeferredColorTransparent);
 }
 
-void VanillaRenderContext::draw_world_poly_filled(std::vector<Vec2> points, Color color)
+void VanillaRenderContext::draw_world_poly_filled(std::span<const Vec2> points, Color color)
 {
     if (points.size() < 3)
         return;
@@ -643,6 +670,28 @@ void register_usertypes(sol::state& lua)
         RenderAPI::get().reload_shaders();
     };
 
+    lua.new_usertype<GpuSectionTiming>(
+        "GpuSectionTiming",
+        sol::no_constructor,
+        "name",
+        &GpuSectionTiming::name,
+        "calls",
+        &GpuSectionTiming::calls,
+        "ms",
+        &GpuSectionTiming::ms);
+
+    /// Enable or disable measuring GPU time of the vanilla render functions for [get_gpu_timings](#get_gpu_timings), disabled by default.
+    lua["set_gpu_timing_enabled"] = [](bool enabled)
+    {
+        GpuTiming::get().enabled = enabled;
+    };
+    /// Get the GPU time spent in each vanilla render function, the ImGui draw and the whole frame, for the newest frame the GPU has finished.
+    /// Results lag a few frames behind. Only recorded while enabled with [set_gpu_timing_enabled](#set_gpu_timing_enabled).
+    lua["get_gpu_timings"] = []() -> std::vector<GpuSectionTiming>
+    {
+        return GpuTiming::get().last_frame();
+    };
+
     auto draw_screen_texture = sol::overload(
         static_cast<void (VanillaRenderContext::*)(TEXTURE, uint8_t, uint8_t, float, float, float, float, Color)>(&VanillaRenderContext::draw_screen_texture),
         static_cast<void (VanillaRenderContext::*)(TEXTURE, uint8_t, uint8_t, const AABB&, Color)>(&VanillaRenderContext::draw_screen_texture),
@@ -658,21 +707,28 @@ void register_usertypes(sol::state& lua)
         static_cast<void (VanillaRenderContext::*)(TEXTURE, uint8_t, uint8_t, const Quad&, Color, WORLD_SHADER)>(&VanillaRenderContext::draw_world_texture),
         static_cast<void (VanillaRenderContext::*)(TEXTURE, const Quad&, const Quad&, Color)>(&VanillaRenderContext::draw_world_texture),
         static_cast<void (VanillaRenderContext::*)(TEXTURE, const Quad&, const Quad&, Color, WORLD_SHADER)>(&VanillaRenderContext::draw_world_texture));
+    auto draw_world_textures = sol::overload(
+        static_cast<void (VanillaRenderContext::*)(TEXTURE, std::vector<Quad>, std::vector<Quad>, std::vector<Color>)>(&VanillaRenderContext::draw_world_textures),
+        static_cast<void (VanillaRenderContext::*)(TEXTURE, std::vector<Quad>, std::vector<Quad>, std::vector<Color>, WORLD_SHADER)>(&VanillaRenderContext::draw_world_textures));
     auto draw_text = sol::overload(
         static_cast<void (VanillaRenderContext::*)(const std::string&, float, float, float, float, Color, uint32_t, uint32_t)>(&VanillaRenderContext::draw_text),
         static_cast<void (VanillaRenderContext::*)(const TextRenderingInfo*, Color)>(&VanillaRenderContext::draw_text));
     auto draw_screen_poly = sol::overload(
         static_cast<void (VanillaRenderContext::*)(const Quad&, float, Color, bool)>(&VanillaRenderContext::draw_screen_poly),
-        static_cast<void (VanillaRenderContext::*)(const std::vector<Vec2>, float, Color, bool)>(&VanillaRenderContext::draw_screen_poly));
+        [](VanillaRenderContext& render_ctx, sol::stack_object points, float thickness, Color color, bool closed)
+        { render_ctx.draw_screen_poly(get_poly_points(points.lua_state(), points.stack_index()), thickness, std::move(color), closed); });
     auto draw_screen_poly_filled = sol::overload(
         static_cast<void (VanillaRenderContext::*)(const Quad&, Color)>(&VanillaRenderContext::draw_screen_poly_filled),
-        static_cast<void (VanillaRenderContext::*)(const std::vector<Vec2>, Color)>(&VanillaRenderContext::draw_screen_poly_filled));
+        [](VanillaRenderContext& render_ctx, sol::stack_object points, Color color)
+        { render_ctx.draw_screen_poly_filled(get_poly_points(points.lua_state(), points.stack_index()), std::move(color)); });
     auto draw_world_poly = sol::overload(
         static_cast<void (VanillaRenderContext::*)(const Quad&, float, Color, bool)>(&VanillaRenderContext::draw_world_poly),
-        static_cast<void (VanillaRenderContext::*)(const std::vector<Vec2>, float, Color, bool)>(&VanillaRenderContext::draw_world_poly));
+        [](VanillaRenderContext& render_ctx, sol::stack_object points, float thickness, Color color, bool closed)
+        { render_ctx.draw_world_poly(get_poly_points(points.lua_state(), points.stack_index()), thickness, std::move(color), closed); });
     auto draw_world_poly_filled = sol::overload(
         static_cast<void (VanillaRenderContext::*)(const Quad&, Color)>(&VanillaRenderContext::draw_world_poly_filled),
-        static_cast<void (VanillaRenderContext::*)(const std::vector<Vec2>, Color)>(&VanillaRenderContext::draw_world_poly_filled));
+        [](VanillaRenderContext& render_ctx, sol::stack_object points, Color color)
+        { render_ctx.draw_world_poly_filled(get_poly_points(points.lua_state(), points.stack_index()), std::move(color)); });
 
     auto render_draw_depth_lua = [](VanillaRenderContext&, LAYER layer, uint8_t draw_depth, AABB bbox)
     {
@@ -689,6 +745,8 @@ void register_usertypes(sol::state& lua)
         &VanillaRenderContext::draw_text_size,
         "draw_screen_texture",
         draw_screen_texture,
+        "draw_screen_textures",
+        &VanillaRenderContext::draw_screen_textures,
         "set_corner_finish",
         &VanillaRenderContext::set_corner_finish,
         "draw_screen_line",
@@ -707,6 +765,8 @@ void register_usertypes(sol::state& lua)
         draw_screen_poly_filled,
         "draw_world_texture",
         draw_world_texture,
+        "draw_world_textures",
+        draw_world_textures,
         "draw_world_line",
         &VanillaRenderContext::draw_world_line,
         "draw_world_rect",
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstdint> // for uint8_t, uint32_t
+#include <span>    // for span
 #include <string>  // for string
 #include <utility> // for pair
+#include <vector>  // for vector
 
 #include "aliases.hpp" // for TEXTURE, WORLD_SHADER
 #include "color.hpp"   // for Color
@@ -68,6 +70,11 @@ class VanillaRenderContext
     /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
     void draw_screen_texture(TEXTURE texture_id, TextureRenderingInfo tri, Color color);
 
+    /// Draw many quads of the same texture in screen coordinates in one call, much faster than calling `draw_screen_texture` for each of them. `sources` - the coordinates in the texture, `dests` - the coordinates on the screen
+    /// `sources` and `colors` can either have one element that is used for every quad, or one element per quad in `dests`, nothing is drawn otherwise
+    /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
+    void draw_screen_textures(TEXTURE texture_id, std::vector<Quad> sources, std::vector<Quad> dests, std::vector<Color> colors);
+
     /// Draws a line on screen using the built-in renderer from point `A` to point `B`.
     /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
     void draw_screen_line(const Vec2& A, const Vec2& B, float thickness, Color color);
@@ -93,7 +100,8 @@ class VanillaRenderContext
     /// Draw a polyline on screen from points using the built-in renderer
     /// Draws from the first to the last point, use `closed` to connect first and last as well
     /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
-    void draw_screen_poly(std::vector<Vec2> points, float thickness, Color color, bool closed);
+    /// The points can also be a flat array of coordinates `{x1, y1, x2, y2, ...}` or a PointBuffer, which are read without making a Vec2 of every point
+    void draw_screen_poly(std::span<const Vec2> points, float thickness, Color color, bool closed);
 
     /// Draw quadrilateral in screen coordinates from top-left to bottom-right using the built-in renderer.
     /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
@@ -102,7 +110,8 @@ class VanillaRenderContext
     /// Draw a convex polygon on screen from points using the built-in renderer
     /// Can probably draw almost any polygon, but the convex one is guaranteed to look correct
     /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
-    void draw_screen_poly_filled(std::vector<Vec2> points, Color color);
+    /// The points can also be a flat array of coordinates `{x1, y1, x2, y2, ...}` or a PointBuffer, which are read without making a Vec2 of every point
+    void draw_screen_poly_filled(std::span<const Vec2> points, Color color);
 
     /// Draw filled quadrilateral in screen coordinates from top-left to bottom-right using the built-in renderer.
     /// Use in combination with ON.RENDER_✱_HUD/PAUSE_MENU/JOURNAL_PAGE events
@@ -141,6 +150,17 @@ class VanillaRenderContext
     /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
     void draw_world_texture(TEXTURE texture_id, const Quad& source, const Quad& dest, Color color);
 
+    /// Draw many quads of the same texture in world coordinates in one call, much faster than calling `draw_world_texture` for each of them. `sources` - the coordinates in the texture, `dests` - the coordinates in the world
+    /// `sources` and `colors` can either have one element that is used for every quad, or one element per quad in `dests`, nothing is drawn otherwise
+    /// The `shader` parameter controls how to render the textures
+    /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
+    void draw_world_textures(TEXTURE texture_id, std::vector<Quad> sources, std::vector<Quad> dests, std::vector<Color> colors, WORLD_SHADER shader);
+
+    /// Draw many quads of the same texture in world coordinates in one call, much faster than calling `draw_world_texture` for each of them. `sources` - the coordinates in the texture, `dests` - the coordinates in the world
+    /// `sources` and `colors` can either have one element that is used for every quad, or one element per quad in `dests`, nothing is drawn otherwise
+    /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
+    void draw_world_textures(TEXTURE texture_id, std::vector<Quad> sources, std::vector<Quad> dests, std::vector<Color> colors);
+
     /// Draws a line in world coordinates using the built-in renderer from point `A` to point `B`.
     /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
     void draw_world_line(const Vec2& A, const Vec2& B, float thickness, Color color);
@@ -166,7 +186,8 @@ class VanillaRenderContext
     /// Draw a polyline in world coordinates from points using the built-in renderer
     /// Draws from the first to the last point, use `closed` to connect first and last as well
     /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
-    void draw_world_poly(std::vector<Vec2> points, float thickness, Color color, bool closed);
+    /// The points can also be a flat array of coordinates `{x1, y1, x2, y2, ...}` or a PointBuffer, which are read without making a Vec2 of every point
+    void draw_world_poly(std::span<const Vec2> points, float thickness, Color color, bool closed);
 
     /// Draw quadrilateral in world coordinates from top-left to bottom-right using the built-in renderer.
     /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
@@ -175,7 +196,8 @@ class VanillaRenderContext
     /// Draw a convex polygon in world coordinates from points using the built-in renderer
     /// Can probably draw almost any polygon, but the convex one is guaranteed to look correct
     /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
-    void draw_world_poly_filled(std::vector<Vec2> points, Color color);
+    /// The points can also be a flat array of coordinates `{x1, y1, x2, y2, ...}` or a PointBuffer, which are read without making a Vec2 of every point
+    void draw_world_poly_filled(std::span<const Vec2> points, Color color);
 
     /// Draw filled quadrilateral in world coordinates from top-left to bottom-right using the built-in renderer.
     /// Use in combination with ON.RENDER_PRE_DRAW_DEPTH event
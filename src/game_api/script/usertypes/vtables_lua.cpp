@@ -9,6 +9,7 @@
 #include "member_function.hpp"                     // for MemberFun
 #include "movable.hpp"                             // for Movable
 #include "render_api.hpp"                          // for RenderInfo
+#include "script/lua_backend.hpp"                  // for LuaBackend, RenderBatchCallback
 #include "script/usertypes/theme_vtable_lua.hpp"   // for NThemeVTables
 #include "script/usertypes/vanilla_render_lua.hpp" // for VanillaRenderContext
 #include "sound_manager.hpp"                       // for SoundMeta
@@ -158,6 +159,32 @@ void register_usertypes(sol::state& lua)
         VTableEntry<"draw", 0x1, void()>,
         VTableEntry<"render", 0x3, void(Vec2*), BackBinder<VanillaRenderContext>>>;
     static RenderInfoVTable render_info_vtable(lua, lua["RenderInfo"], "RENDER_INFO_OVERRIDE");
+    // Only collects the entity, the batch callback gets all of them in one call once the layer is drawn
+    lua["RenderInfo"]["add_to_render_batch"] = [](RenderInfo* self, CallbackId batch_id) -> sol::optional<std::uint32_t>
+    {
+        auto backend = LuaBackend::get_calling_backend();
+        auto it = backend->render_batch_callbacks.find(batch_id);
+        if (it == backend->render_batch_callbacks.end())
+            return sol::nullopt;
+
+        std::uint32_t callback_id = render_info_vtable.reserve_callback_id(self);
+        std::uint32_t aux_id = self->get_aux_id();
+        render_info_vtable.set_post<void(RenderInfo*, Vec2*), 0x3>(
+            self,
+            callback_id,
+            [rendered = std::weak_ptr{it->second.rendered}](RenderInfo* render_info, Vec2*)
+            {
+                if (auto list = rendered.lock())
+                {
+                    // Rendered twice in a row when the level wraps around
+                    const uint32_t uid = render_info->get_aux_id();
+                    if (list->empty() || list->back() != uid)
+                        list->push_back(uid);
+                }
+            });
+        backend->HookHandler<RenderInfo, CallbackType::Entity>::add_hook(callback_id, aux_id);
+        return callback_id;
+    };
 
     using PowerupCapableVTable = HookableVTable<
         Entity,
@@ -257,6 +284,23 @@ void register_usertypes(sol::state& lua)
             door_vtable.unhook(ent, callback_id);
         });
 
+    TypeHookHandler::set_type_unhook_impl(
+        [](std::uint32_t callback_id)
+        {
+            entity_vtable.unhook_type(callback_id);
+            movable_vtable.unhook_type(callback_id);
+            floor_vtable.unhook_type(callback_id);
+            door_vtable.unhook_type(callback_id);
+            powerup_capable_vtable.unhook_type(callback_id);
+            powerup_vtable.unhook_type(callback_id);
+            backpack_vtable.unhook_type(callback_id);
+            jetpack_vtable.unhook_type(callback_id);
+            purchasable_vtable.unhook_type(callback_id);
+            dummy_purchasable_entity_vtable.unhook_type(callback_id);
+            olmec_cannon_vtable.unhook_type(callback_id);
+            rolling_item_vtable.unhook_type(callback_id);
+        });
+
     HookHandler<RenderInfo, CallbackType::Entity>::set_hook_dtor_impl(
         [](std::uint32_t uid, std::function<void(std::uint32_t)> fun)
         {
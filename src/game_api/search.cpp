@@ -3,15 +3,25 @@
 // clang-format off
 #include <Windows.h>          // for IMAGE_SECTION_HEADER, GetModuleHandleA
 #include <fmt/format.h>       // for check_format_string, format_to, vformat_to
+#include <emmintrin.h>        // for _mm_cmpeq_epi8, _mm_loadu_si128, _mm_movemask_epi8
+#include <algorithm>          // for max, min, sort, lower_bound, upper_bound
+#include <atomic>             // for atomic_size_t
+#include <bit>                // for countr_zero
+#include <cstdint>            // for SIZE_MAX
 #include <cstring>            // for memcmp
 #include <exception>          // for terminate
+#include <filesystem>         // for path, create_directories
+#include <fstream>            // for ifstream, ofstream
 #include <functional>         // for _Func_impl_no_alloc<>::_Mybase, equal_to
+#include <iterator>           // for prev
 #include <list>               // for _List_iterator, _List_const_iterator
 #include <locale>             // for num_put
+#include <mutex>              // for lock_guard, mutex
 #include <new>                // for operator new
 #include <span>               // for span
 #include <sstream>            // for basic_ostream, basic_streambuf, basic_s...
 #include <stdexcept>          // for logic_error
+#include <thread>             // for thread
 #include <tuple>              // for get, apply, tuple
 #include <type_traits>        // for move
 #include <unordered_map>      // for unordered_map, _Umap_traits<>::allocato...
@@ -19,9 +29,10 @@
 #include <vector>             // for vector, _Vector_const_iterator, _Vector...
 // clang-format on
 
+#include "crc32.hpp"              // for crc32str
 #include "ghidra_byte_string.hpp" // for operator""_gh
 #include "logger.h"               // for ByteStr, DEBUG
-#include "memory.hpp"             // for Memory, function_start
+#include "memory.hpp"             // for Memory, function_start, memory_read
 #include "virtual_table.hpp"      // for VIRT_FUNC, VTABLE_OFFSET, VIRT_FUNC::LO...
 
 // Decodes the program counter inside an instruction
@@ -152,6 +163,51 @@ std::string get_error_information()
     return fmt::format("\n\nRunning Spelunky 2: {}\nSupported Spelunky 2: 1.28\n\n{}", current_spelunky_version(), application_versions());
 }
 
+bool pattern_matches(const char* at, std::string_view needle)
+{
+    for (std::size_t k = 0; k < needle.size(); k++)
+    {
+        if (needle[k] != '*' && needle[k] != at[k])
+            return false;
+    }
+    return true;
+}
+
+const char* find_pattern(const char* begin, const char* end, std::string_view needle)
+{
+    // Use the first two non-wildcard bytes as an anchor, the full pattern is only compared where both of them match
+    const std::size_t first = needle.find_first_not_of('*');
+    if (first == std::string_view::npos)
+        return begin;
+    const std::size_t second = std::max(needle.find_first_not_of('*', first + 1), first);
+
+    const std::size_t count = end - begin;
+    const __m128i first_byte = _mm_set1_epi8(needle[first]);
+    const __m128i second_byte = _mm_set1_epi8(needle[second]);
+
+    // SSE2 only, as AVX can't be assumed on the players machines
+    std::size_t j = 0;
+    for (; j + 16 <= count; j += 16)
+    {
+        const __m128i first_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + j + first));
+        const __m128i second_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + j + second));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first_block, first_byte), _mm_cmpeq_epi8(second_block, second_byte)));
+        while (mask != 0)
+        {
+            const char* candidate = begin + j + std::countr_zero(mask);
+            if (pattern_matches(candidate, needle))
+                return candidate;
+            mask &= mask - 1;
+        }
+    }
+    for (; j < count; j++)
+    {
+        if (pattern_matches(begin + j, needle))
+            return begin + j;
+    }
+    return nullptr;
+}
+
 size_t find_inst(const char* exe, std::string_view needle, size_t start, std::optional<size_t> end, std::string_view pattern_name, bool is_required)
 {
     static const std::size_t exe_size = [exe]()
@@ -166,17 +222,11 @@ size_t find_inst(const char* exe, std::string_view needle, size_t start, std::op
     const std::size_t needle_length = needle.size();
     const std::size_t search_end = end.value_or(exe_size);
 
-    for (std::size_t j = start; j < search_end - needle_length; j++)
+    if (start + needle_length < search_end)
     {
-        bool found = true;
-        for (std::size_t k = 0; k < needle_length && found; k++)
+        if (const char* found = find_pattern(exe + start, exe + search_end - needle_length, needle))
         {
-            found = needle[k] == '*' || needle[k] == *(exe + j + k);
-        }
-
-        if (found)
-        {
-            return j;
+            return found - exe;
         }
     }
 
@@ -2341,24 +2391,240 @@ std::unordered_map<std::string_view, AddressRule> g_address_rules{
     //
 };
 std::unordered_map<std::string_view, size_t> g_cached_addresses;
+// Bumped on every change of g_cached_addresses, so the reverse index knows when to rebuild
+size_t g_cached_addresses_generation{0};
+std::mutex g_cached_addresses_lock;
 
-void preload_addresses()
+void cache_address(std::string_view address_name, size_t address)
 {
+    std::lock_guard lock{g_cached_addresses_lock};
+    g_cached_addresses[address_name] = address;
+    g_cached_addresses_generation++;
+}
+
+// Cached addresses sorted by address, rebuilt the first time it's used after an address was added
+struct AddressIndex
+{
+    std::vector<std::pair<size_t, std::string_view>> sorted;
+    size_t generation{SIZE_MAX};
+    size_t exe_begin{0};
+    size_t exe_end{0};
+};
+AddressIndex g_address_index;
+
+// Only called with g_cached_addresses_lock held
+const AddressIndex& get_address_index()
+{
+    AddressIndex& index = g_address_index;
+    if (index.generation == g_cached_addresses_generation)
+        return index;
+
+    index.sorted.assign(g_cached_addresses.begin(), g_cached_addresses.end());
+    for (auto& entry : index.sorted)
+        entry = {entry.second, entry.first};
+    std::sort(index.sorted.begin(), index.sorted.end());
+    index.generation = g_cached_addresses_generation;
+
     Memory& mem = Memory::get();
-    const char* exe = mem.exe();
+    index.exe_begin = mem.exe_address();
+    if (PIMAGE_NT_HEADERS nt_header = RtlImageNtHeader((PVOID)mem.exe()))
+        index.exe_end = index.exe_begin + nt_header->OptionalHeader.SizeOfImage;
+    return index;
+}
+
+void report_duplicate_addresses()
+{
+    std::unordered_map<size_t, std::string_view> address_names;
+    for (auto& [k, v] : g_cached_addresses)
+    {
+        auto [it, inserted] = address_names.emplace(v, k);
+        if (!inserted)
+        {
+            DEBUG("Two patterns refer to the same address: {} & {}", it->second, k);
+        }
+    }
+}
+
+struct AddressCacheHeader
+{
+    static constexpr uint32_t MAGIC = 0x4341534f; // "OSAC"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic{MAGIC};
+    uint32_t version{VERSION};
+    uint32_t exe_timestamp;
+    uint32_t exe_image_size;
+    uint32_t exe_crc;
+    uint32_t rules_crc;
+    uint32_t count;
+
+    bool operator==(const AddressCacheHeader&) const = default;
+};
+struct AddressCacheEntry
+{
+    uint32_t name_crc;
+    bool exe_relative;
+    uint64_t value;
+};
+
+AddressCacheHeader make_address_cache_header(Memory& mem)
+{
+    AddressCacheHeader header{};
+    if (PIMAGE_NT_HEADERS nt_header = RtlImageNtHeader((PVOID)mem.exe()))
+    {
+        header.exe_timestamp = nt_header->FileHeader.TimeDateStamp;
+        header.exe_image_size = nt_header->OptionalHeader.SizeOfImage;
+        header.exe_crc = crc32str({mem.exe(), nt_header->OptionalHeader.SizeOfHeaders});
+    }
+
+    // Rules are part of the key as well, Overlunky updates usually come with changed patterns
+    uint32_t rules_crc = crc32str(application_versions());
+    for (auto& [address_name, rule] : g_address_rules)
+        rules_crc ^= crc32str(address_name);
+    header.rules_crc = rules_crc;
+    return header;
+}
+
+bool load_address_cache(Memory& mem, std::string_view cache_file)
+{
+    std::ifstream file(std::filesystem::path{cache_file}, std::ios::binary);
+    if (!file)
+        return false;
+
+    AddressCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    AddressCacheHeader expected = make_address_cache_header(mem);
+    expected.count = header.count;
+    if (header != expected)
+        return false;
+
+    std::unordered_map<uint32_t, std::string_view> names;
     for (auto& [address_name, rule] : g_address_rules)
+        names[crc32str(address_name)] = address_name;
+
+    std::vector<std::pair<std::string_view, size_t>> addresses;
+    addresses.reserve(header.count);
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        AddressCacheEntry entry;
+        if (!file.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+            return false;
+
+        auto it = names.find(entry.name_crc);
+        if (it == names.end())
+            return false;
+        addresses.emplace_back(it->second, entry.exe_relative ? mem.at_exe(entry.value) : entry.value);
+    }
+
+    // Re-run a handful of rules spread through the cache, a mismatch means the cache can't be trusted
+    constexpr size_t validation_samples = 8;
+    const size_t stride = std::max<size_t>(addresses.size() / validation_samples, 1);
+    for (size_t i = 0; i < addresses.size(); i += stride)
+    {
+        auto& [address_name, address] = addresses[i];
+        auto found = g_address_rules[address_name](mem, mem.exe(), address_name);
+        if (found.value_or(0) != address)
+        {
+            DEBUG("Address cache mismatch on '{}', rescanning...", address_name);
+            return false;
+        }
+    }
+
+    std::lock_guard lock{g_cached_addresses_lock};
+    for (auto& [address_name, address] : addresses)
+        g_cached_addresses[address_name] = address;
+    g_cached_addresses_generation++;
+    return true;
+}
+
+void save_address_cache(Memory& mem, std::string_view cache_file)
+{
+    std::filesystem::path cache_path{cache_file};
+    if (cache_path.has_parent_path())
+        std::filesystem::create_directories(cache_path.parent_path());
+
+    std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return;
+
+    std::lock_guard lock{g_cached_addresses_lock};
+    AddressCacheHeader header = make_address_cache_header(mem);
+    header.count = static_cast<uint32_t>(g_cached_addresses.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const size_t exe_begin = mem.exe_address();
+    const size_t exe_end = exe_begin + header.exe_image_size;
+    for (auto& [address_name, address] : g_cached_addresses)
+    {
+        // Addresses inside the exe are stored relative to it, to not depend on the image base
+        const bool exe_relative = address >= exe_begin && address < exe_end;
+        const AddressCacheEntry entry{crc32str(address_name), exe_relative, exe_relative ? address - exe_begin : address};
+        file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+}
+
+void preload_addresses(bool parallel, std::string_view cache_file)
+{
+    Memory& mem = Memory::get();
+    const char* exe = mem.exe();
+    if (!cache_file.empty() && load_address_cache(mem, cache_file))
+    {
+        DEBUG("Loaded {} addresses from cache", g_cached_addresses.size());
+        return;
+    }
+
+    if (!parallel)
     {
-        if (auto address = rule(mem, exe, address_name))
+        for (auto& [address_name, rule] : g_address_rules)
         {
-            for (auto& [k, v] : g_cached_addresses)
+            if (auto address = rule(mem, exe, address_name))
             {
-                if (v == address.value() && k != address_name)
+                cache_address(address_name, address.value());
+            }
+        }
+    }
+    else
+    {
+        // Rules that depend on other addresses resolve them through get_address, so the worst case is the same rule
+        // being evaluated by two threads at the same time, with both producing the same result
+        std::vector<std::pair<const std::string_view, AddressRule>*> rules;
+        rules.reserve(g_address_rules.size());
+        for (auto& entry : g_address_rules)
+            rules.push_back(&entry);
+
+        std::atomic_size_t next_rule{0};
+        auto worker = [&]()
+        {
+            for (size_t i = next_rule++; i < rules.size(); i = next_rule++)
+            {
+                auto& [address_name, rule] = *rules[i];
+                {
+                    std::lock_guard lock{g_cached_addresses_lock};
+                    if (g_cached_addresses.contains(address_name))
+                        continue;
+                }
+                if (auto address = rule(mem, exe, address_name))
                 {
-                    DEBUG("Two patterns refer to the same address: {} & {}", k, address_name);
+                    cache_address(address_name, address.value());
                 }
             }
-            g_cached_addresses[address_name] = address.value();
-        }
+        };
+
+        const size_t thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 16);
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < thread_count; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+    }
+    report_duplicate_addresses();
+
+    if (!cache_file.empty())
+    {
+        save_address_cache(mem, cache_file);
     }
 }
 size_t load_address(std::string_view address_name)
@@ -2369,7 +2635,7 @@ size_t load_address(std::string_view address_name)
         Memory& mem = Memory::get();
         if (auto address = it->second(mem, mem.exe(), address_name))
         {
-            g_cached_addresses[address_name] = address.value();
+            cache_address(address_name, address.value());
             return address.value();
         }
     }
@@ -2377,12 +2643,52 @@ size_t load_address(std::string_view address_name)
     MessageBox(NULL, message.c_str(), NULL, MB_OK);
     return 0ull;
 }
+std::optional<std::string_view> get_address_name(size_t address)
+{
+    std::lock_guard lock{g_cached_addresses_lock};
+    const AddressIndex& index = get_address_index();
+    auto it = std::lower_bound(index.sorted.begin(), index.sorted.end(), std::pair{address, std::string_view{}});
+    if (it != index.sorted.end() && it->first == address)
+        return it->second;
+    return std::nullopt;
+}
+std::string symbolicate_address(size_t address)
+{
+    std::lock_guard lock{g_cached_addresses_lock};
+    const AddressIndex& index = get_address_index();
+    if (address < index.exe_begin || address >= index.exe_end)
+        return fmt::format("{:#x}", address);
+
+    // Closest named address at or before `address`, several names on the same address sort by name
+    auto it = std::upper_bound(index.sorted.begin(), index.sorted.end(), address, [](size_t value, const auto& entry)
+                               { return value < entry.first; });
+    if (it != index.sorted.begin())
+    {
+        --it;
+        while (it != index.sorted.begin() && std::prev(it)->first == it->first)
+            --it;
+        if (it->first == address)
+            return std::string{it->second};
+        // Only name it after the address if that's in the same function, same as function_start the padding between functions
+        // marks where it starts, but this never looks further back than the named address
+        size_t start = address & ~0xf;
+        while (start > it->first && memory_read<uint8_t>(start - 1) != 0xcc)
+            start -= 0x10;
+        if (start <= it->first)
+            return fmt::format("{}+{:#x}", it->second, address - it->first);
+    }
+    return fmt::format("Spel2.exe+{:#x}", address - index.exe_begin);
+}
+
 size_t get_address(std::string_view address_name)
 {
-    auto it = g_cached_addresses.find(address_name);
-    if (it != g_cached_addresses.end())
     {
-        return it->second;
+        std::lock_guard lock{g_cached_addresses_lock};
+        auto it = g_cached_addresses.find(address_name);
+        if (it != g_cached_addresses.end())
+        {
+            return it->second;
+        }
     }
     return load_address(address_name);
 }
@@ -19,7 +19,14 @@ size_t find_inst(const char* exe, std::string_view needle, size_t start, std::op
 
 size_t find_after_bundle(size_t exe);
 
-void preload_addresses();
+// With parallel set, the rules are evaluated on a pool of worker threads
+// With cache_file set, addresses are loaded from that file if it was written for the same Spel2.exe and application versions,
+// otherwise the file is rewritten after the scan
+void preload_addresses(bool parallel = false, std::string_view cache_file = ""sv);
 size_t get_address(std::string_view address_name);
+// Name of the pattern that resolved to exactly `address`, if any
+std::optional<std::string_view> get_address_name(size_t address);
+// "name+0x10" if `address` is in the same function as or at a named address of Spel2.exe, "Spel2.exe+0x1234" if it's in the exe, else just the hex address
+std::string symbolicate_address(size_t address);
 
 void register_application_version(std::string s);
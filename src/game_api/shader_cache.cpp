@@ -0,0 +1,173 @@
+#include "shader_cache.hpp"
+
+#include <Windows.h>     // for LoadLibraryA, GetProcAddress, HMODULE
+#include <cstring>       // for memcpy, strlen
+#include <d3dcompiler.h> // for D3D_SHADER_MACRO, ID3DInclude, ID3DBlob
+#include <detours.h>     // for DetourAttach
+#include <string_view>   // for string_view
+#include <utility>       // for move
+
+#include "async_file_writer.hpp"  // for AsyncFileWriter
+#include "detour_transaction.hpp" // for hook_transaction_begin, hook_transaction_commit
+#include "file_api.hpp"           // for get_shader_cache_path
+#include "logger.h"               // for DEBUG
+#include "mapped_file.hpp"        // for MappedFile
+
+namespace
+{
+// Header of a .cso cache file, the bytecode follows it
+struct ShaderCacheHeader
+{
+    // "OCSO" in the file
+    static constexpr uint32_t MAGIC = 0x4F53434F;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+};
+static_assert(sizeof(ShaderCacheHeader) == 24);
+
+// FNV-1a, the pieces are separated so moving bytes from one to the next changes the key
+struct KeyHasher
+{
+    uint64_t value{0xcbf29ce484222325};
+
+    void add(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            value ^= bytes[i];
+            value *= 0x100000001b3;
+        }
+        value ^= 0xff;
+        value *= 0x100000001b3;
+    }
+    void add(const char* str)
+    {
+        if (str != nullptr)
+            add(str, strlen(str));
+        else
+            add(nullptr, 0);
+    }
+};
+
+using D3DCompileFun = HRESULT WINAPI(LPCVOID, SIZE_T, LPCSTR, const D3D_SHADER_MACRO*, ID3DInclude*, LPCSTR, LPCSTR, UINT, UINT, ID3DBlob**, ID3DBlob**);
+using D3DCreateBlobFun = HRESULT WINAPI(SIZE_T, ID3DBlob**);
+D3DCompileFun* g_d3d_compile_trampoline{nullptr};
+D3DCreateBlobFun* g_d3d_create_blob{nullptr};
+
+HRESULT WINAPI d3d_compile(LPCVOID src_data, SIZE_T src_data_size, LPCSTR source_name, const D3D_SHADER_MACRO* defines, ID3DInclude* include, LPCSTR entry_point, LPCSTR target, UINT flags1, UINT flags2, ID3DBlob** code, ID3DBlob** error_msgs)
+{
+    if (include != nullptr || code == nullptr)
+        return g_d3d_compile_trampoline(src_data, src_data_size, source_name, defines, include, entry_point, target, flags1, flags2, code, error_msgs);
+
+    KeyHasher hasher;
+    hasher.add(&ShaderCache::VERSION, sizeof(ShaderCache::VERSION));
+    hasher.add(src_data, src_data_size);
+    for (const D3D_SHADER_MACRO* define = defines; define != nullptr && define->Name != nullptr; ++define)
+    {
+        hasher.add(define->Name);
+        hasher.add(define->Definition);
+    }
+    hasher.add(entry_point);
+    hasher.add(target);
+    hasher.add(&flags1, sizeof(flags1));
+    hasher.add(&flags2, sizeof(flags2));
+    const uint64_t key = hasher.value;
+
+    ShaderCache& cache = ShaderCache::get();
+    std::string bytecode;
+    if (cache.find(key, bytecode))
+    {
+        ID3DBlob* blob{nullptr};
+        if (SUCCEEDED(g_d3d_create_blob(bytecode.size(), &blob)))
+        {
+            memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
+            *code = blob;
+            if (error_msgs != nullptr)
+                *error_msgs = nullptr;
+            return S_OK;
+        }
+    }
+
+    const HRESULT result = g_d3d_compile_trampoline(src_data, src_data_size, source_name, defines, include, entry_point, target, flags1, flags2, code, error_msgs);
+    if (SUCCEEDED(result) && *code != nullptr)
+    {
+        ID3DBlob* blob = *code;
+        cache.store(key, std::string{static_cast<const char*>(blob->GetBufferPointer()), blob->GetBufferSize()});
+    }
+    return result;
+}
+} // namespace
+
+ShaderCache& ShaderCache::get()
+{
+    static ShaderCache cache;
+    return cache;
+}
+
+void ShaderCache::init()
+{
+    // The game may not have loaded it yet when the hooks go in
+    HMODULE compiler = LoadLibraryA("d3dcompiler_47.dll");
+    if (compiler == nullptr)
+        return;
+    g_d3d_compile_trampoline = (D3DCompileFun*)GetProcAddress(compiler, "D3DCompile");
+    g_d3d_create_blob = (D3DCreateBlobFun*)GetProcAddress(compiler, "D3DCreateBlob");
+    if (g_d3d_compile_trampoline == nullptr || g_d3d_create_blob == nullptr)
+        return;
+
+    hook_transaction_begin();
+    DetourAttach((void**)&g_d3d_compile_trampoline, &d3d_compile);
+    const LONG error = hook_transaction_commit();
+    if (error != NO_ERROR)
+    {
+        DEBUG("Failed hooking D3DCompile: {}\n", error);
+    }
+}
+
+bool ShaderCache::find(uint64_t key, std::string& out_bytecode)
+{
+    {
+        std::lock_guard guard{lock};
+        if (auto it = compiled.find(key); it != compiled.end())
+        {
+            out_bytecode = it->second;
+            hit_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    if (auto file = MappedFile::open(get_shader_cache_path(key).string()); file && file->size() > sizeof(ShaderCacheHeader))
+    {
+        ShaderCacheHeader header;
+        memcpy(&header, file->view().data(), sizeof(header));
+        if (header.magic == ShaderCacheHeader::MAGIC && header.version == VERSION && header.key == key && file->size() - sizeof(header) == header.size)
+        {
+            out_bytecode = std::string{file->view().substr(sizeof(header))};
+            file->close();
+
+            std::lock_guard guard{lock};
+            compiled.emplace(key, out_bytecode);
+            hit_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    miss_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ShaderCache::store(uint64_t key, std::string bytecode)
+{
+    const ShaderCacheHeader header{ShaderCacheHeader::MAGIC, VERSION, key, bytecode.size()};
+    std::string data(sizeof(header), '\0');
+    memcpy(data.data(), &header, sizeof(header));
+    data += bytecode;
+    AsyncFileWriter::get().write(get_shader_cache_path(key).string(), std::move(data));
+
+    std::lock_guard guard{lock};
+    compiled.insert_or_assign(key, std::move(bytecode));
+}
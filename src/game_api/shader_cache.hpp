@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>        // for atomic
+#include <cstdint>       // for uint64_t
+#include <mutex>         // for mutex
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+
+// Keeps the bytecode of the shaders the game compiles through D3DCompile, keyed by a hash of the source, the defines,
+// the entry point, the target and the flags, so reloading unchanged shaders doesn't compile them again
+// Compiled shaders are kept for the session and written to the Shaders folder of the texture cache for the next one
+// Shaders compiled with an include handler aren't cached, the included files aren't part of the key
+class ShaderCache
+{
+  public:
+    static constexpr uint32_t VERSION = 1;
+
+    static ShaderCache& get();
+
+    // Hooks D3DCompile, does nothing if d3dcompiler_47.dll can't be loaded
+    void init();
+
+    uint64_t hits() const
+    {
+        return hit_count.load(std::memory_order_relaxed);
+    }
+    uint64_t misses() const
+    {
+        return miss_count.load(std::memory_order_relaxed);
+    }
+
+    // Checks the shaders compiled this session first and then the cache folder
+    bool find(uint64_t key, std::string& out_bytecode);
+    void store(uint64_t key, std::string bytecode);
+
+  private:
+    ShaderCache() = default;
+
+    std::mutex lock;
+    std::unordered_map<uint64_t, std::string> compiled;
+    std::atomic<uint64_t> hit_count{0};
+    std::atomic<uint64_t> miss_count{0};
+};
@@ -1,19 +1,28 @@
 #include "socket.hpp"
 
 #include <Windows.h>             // for GetModuleHandleA, GetProcAddress
-#include <algorithm>             // for max
+#include <algorithm>             // for max, min
+#include <condition_variable>    // for condition_variable
+#include <deque>                 // for deque
 #include <detours.h>             // for DetourAttach, DetourTransactionBegin
 #include <exception>             // for exception
+#include <filesystem>            // for remove
+#include <fmt/format.h>          // for format
+#include <fstream>               // for ofstream
+#include <iterator>              // for back_inserter
 #include <new>                   // for operator new
 #include <sockpp/inet_address.h> // for inet_address
 #include <sockpp/udp_socket.h>   // for udp_socket
 #include <thread>                // for thread
 #include <tuple>                 // for get
 #include <type_traits>           // for move
-#include <utility>               // for max, min
+#include <utility>               // for max, min, exchange
 #include <wininet.h>             // for InternetCloseHandle, InternetOpenA, InternetG...
-#include <winsock2.h>            // for sockaddr_in, SOCKET
-#include <ws2tcpip.h>            // for inet_ntop
+#include <winsock2.h>            // for sockaddr_in, SOCKET, WSAEventSelect
+
+#include "network_capture.hpp" // for NetworkCapture
+#include "thread_policy.hpp"   // for ServiceThreads, THREAD_POOL
+#include "util.hpp"            // for ON_SCOPE_EXIT
 
 #pragma comment(lib, "wininet.lib")
 
@@ -23,23 +32,33 @@ NetFun* g_recvfrom_trampoline{nullptr};
 int mySendto(SOCKET s, char* buf, int len, int flags, sockaddr_in* addr, int* tolen)
 {
     auto ret = g_sendto_trampoline(s, buf, len, flags, addr, tolen);
-    char ip[16] = "";
-    inet_ntop(addr->sin_family, &addr->sin_addr, ip, sizeof(ip));
-    DEBUG("SEND: {}:{} | {}", ip, addr->sin_port, ByteStr{buf});
+    if (ret > 0 && addr != nullptr)
+        NetworkCapture::get().record(true, s, addr->sin_addr.s_addr, addr->sin_port, buf, ret);
     return ret;
 }
 
 int myRecvfrom(SOCKET s, char* buf, int len, int flags, sockaddr_in* addr, int* fromlen)
 {
     auto ret = g_recvfrom_trampoline(s, buf, len, flags, addr, fromlen);
-    char ip[16] = "";
-    inet_ntop(addr->sin_family, &addr->sin_addr, ip, sizeof(ip));
-    DEBUG("RECV: {}:{} | {}", ip, addr->sin_port, ByteStr{buf});
+    if (ret > 0 && addr != nullptr)
+        NetworkCapture::get().record(false, s, addr->sin_addr.s_addr, addr->sin_port, buf, ret);
     return ret;
 }
 
-void dump_network()
+bool dump_network(std::string path)
 {
+    if (!NetworkCapture::get().start(path))
+    {
+        DEBUG("Failed to start network capture to '{}'", path);
+        return false;
+    }
+    DEBUG("Capturing network traffic to '{}'", path);
+
+    static bool hooked{false};
+    if (hooked)
+        return true;
+    hooked = true;
+
     g_sendto_trampoline = (NetFun*)GetProcAddress(GetModuleHandleA("ws2_32.dll"), "sendto");
     g_recvfrom_trampoline = (NetFun*)GetProcAddress(GetModuleHandleA("ws2_32.dll"), "recvfrom");
     DetourTransactionBegin();
@@ -50,57 +69,197 @@ void dump_network()
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking network: {}\n", error);
+        return false;
     }
+    return true;
+}
+void stop_dump_network()
+{
+    NetworkCapture::get().stop();
 }
 
-void udp_data(sockpp::udp_socket socket, UdpServer* server)
+namespace
 {
-    ssize_t n;
-    char buf[500];
-    sockpp::inet_address src;
-    while (server->kill_thr.test(std::memory_order_acquire) && (n = socket.recv_from(buf, sizeof(buf), &src)) > 0)
-    {
-        std::optional<std::string> ret = server->cb(std::string(buf, n));
-        if (ret)
-        {
-            socket.send_to(ret.value(), src);
-        }
-    }
+// Largest payload an IPv4 datagram can carry
+constexpr size_t g_max_datagram_size = 65507;
+// Read per wakeup before the batch is handed on
+constexpr size_t g_max_batch_size = 256;
+constexpr size_t g_max_queued_packets = 4096;
+
+std::string ipv4_to_string(in_addr_t address)
+{
+    return fmt::format("{}.{}.{}.{}", (address >> 24) & 0xff, (address >> 16) & 0xff, (address >> 8) & 0xff, address & 0xff);
 }
+} // namespace
 
 UdpServer::UdpServer(std::string host_, in_port_t port_, std::function<SocketCb> cb_)
     : host(host_), port(port_), cb(cb_)
+{
+    start();
+}
+UdpServer::UdpServer(std::string host_, in_port_t port_)
+    : host(host_), port(port_)
+{
+    start();
+}
+void UdpServer::start()
 {
     sock.bind(sockpp::inet_address(host, port));
-    kill_thr.test_and_set();
-    thr = std::thread(udp_data, std::move(sock), this);
+    // Bursts of packets pile up in the kernel while the thread is handing on the last batch
+    int receive_buffer = 1 << 20;
+    setsockopt(sock.handle(), SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receive_buffer), sizeof(receive_buffer));
+    stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    thr = std::thread(&UdpServer::receive, this);
 }
-void UdpServer::clear() // TODO: fix and expose: this and the destructor causes deadlock
+void UdpServer::receive()
 {
-    kill_thr.clear(std::memory_order_release);
+    ServiceThreads::get().register_current("UdpServer", THREAD_POOL::NETWORK);
+    // Also switches the socket to non-blocking, so every wakeup can read until the socket is empty
+    WSAEVENT read_event = WSACreateEvent();
+    WSAEventSelect(sock.handle(), read_event, FD_READ);
+    const HANDLE events[]{static_cast<HANDLE>(stop_event), read_event};
+
+    std::vector<char> buf(g_max_datagram_size);
+    std::vector<UdpPacket> batch;
+    while (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+    {
+        WSAResetEvent(read_event);
+
+        ssize_t n;
+        sockpp::inet_address src;
+        while (batch.size() < g_max_batch_size && (n = sock.recv_from(buf.data(), buf.size(), 0, &src)) >= 0)
+        {
+            if (cb)
+            {
+                std::optional<std::string> ret = cb(std::string(buf.data(), n));
+                if (ret)
+                {
+                    sock.send_to(ret.value(), src);
+                }
+                continue;
+            }
+            batch.push_back({std::string(buf.data(), n), ipv4_to_string(src.address()), src.port()});
+        }
+        // A full batch leaves data in the socket, FD_READ is only signalled again for new data though
+        if (batch.size() == g_max_batch_size)
+            WSASetEvent(read_event);
+
+        if (!batch.empty())
+        {
+            std::lock_guard lock{queue_lock};
+            const size_t fits = std::min(batch.size(), g_max_queued_packets - std::min(queue.size(), g_max_queued_packets));
+            std::move(batch.begin(), batch.begin() + fits, std::back_inserter(queue));
+            dropped.fetch_add(static_cast<uint32_t>(batch.size() - fits), std::memory_order_relaxed);
+            batch.clear();
+        }
+    }
+    WSACloseEvent(read_event);
+}
+void UdpServer::clear()
+{
+    if (!thr.joinable())
+        return;
+
+    // The thread never waits on anything but these events, so it's gone right away
+    SetEvent(static_cast<HANDLE>(stop_event));
     thr.join();
+    CloseHandle(static_cast<HANDLE>(stop_event));
+    stop_event = nullptr;
+    sock.close();
 }
 UdpServer::~UdpServer()
 {
-    if (thr.joinable())
+    clear();
+}
+std::vector<UdpPacket> UdpServer::take_packets()
+{
+    std::lock_guard lock{queue_lock};
+    return std::exchange(queue, {});
+}
+bool UdpServer::send(std::string_view msg, const std::string& host_, in_port_t port_)
+{
+    if (!sock.is_open())
+        return false;
+    return sock.send_to(msg.data(), msg.size(), sockpp::inet_address(host_, port_)) == static_cast<ssize_t>(msg.size());
+}
+uint32_t UdpServer::get_dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+namespace
+{
+// Runs the requests started with HttpRequest, so scripts that poll something don't start a thread each time
+// Never destroyed, threads can't be joined while the dll unloads
+class HttpWorkers
+{
+  public:
+    static HttpWorkers& get()
     {
-        kill_thr.clear(std::memory_order_release);
-        thr.join();
+        static HttpWorkers* workers = new HttpWorkers();
+        return *workers;
     }
+
+    void push(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock{jobs_lock};
+            jobs.push_back(std::move(job));
+        }
+        jobs_changed.notify_one();
+    }
+
+  private:
+    static constexpr size_t NUM_WORKERS = 2;
+
+    HttpWorkers()
+    {
+        for (size_t i = 0; i < NUM_WORKERS; ++i)
+        {
+            std::thread(&HttpWorkers::run, this).detach();
+        }
+    }
+
+    void run()
+    {
+        ServiceThreads::get().register_current("HttpWorker", THREAD_POOL::NETWORK);
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock lock{jobs_lock};
+                jobs_changed.wait(lock, [this]()
+                                  { return !jobs.empty(); });
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::mutex jobs_lock;
+    std::condition_variable jobs_changed;
+    std::deque<std::function<void()>> jobs;
+};
+
+// One session for the whole process, WinINet keeps the connections of a session alive and reuses them for the next request to the same host
+HINTERNET get_http_session()
+{
+    static HINTERNET session = []()
+    {
+        DWORD flags{0};
+        InternetGetConnectedState(&flags, 0);
+        const DWORD access_type = (flags & INTERNET_CONNECTION_PROXY) ? INTERNET_OPEN_TYPE_PRECONFIG : INTERNET_OPEN_TYPE_PRECONFIG_WITH_NO_AUTOPROXY;
+        return InternetOpenA("curl", access_type, NULL, NULL, 0);
+    }();
+    return session;
 }
+} // namespace
 
-bool http_get(const char* sURL, std::string& out, std::string& err)
+bool http_get(const char* sURL, const std::function<HttpChunkCb>& on_chunk, std::string& err)
 {
     const int BUFFER_SIZE = 32768;
     DWORD iFlags;
-    const char* sAgent = "curl";
-    const char* sHeader = NULL;
-    HINTERNET hInternet;
-    HINTERNET hConnect;
-    char acBuffer[BUFFER_SIZE];
-    DWORD iReadBytes;
-    DWORD iBytesToRead = 0;
-    DWORD iReadBytesOfRq = 4;
 
     // Get connection state
     InternetGetConnectedState(&iFlags, 0);
@@ -110,63 +269,53 @@ bool http_get(const char* sURL, std::string& out, std::string& err)
         return false;
     }
 
-    // Open internet session
-    if (!(iFlags & INTERNET_CONNECTION_PROXY))
+    HINTERNET hInternet = get_http_session();
+    if (!hInternet)
     {
-        hInternet = InternetOpenA(sAgent, INTERNET_OPEN_TYPE_PRECONFIG_WITH_NO_AUTOPROXY, NULL, NULL, 0);
+        err = "Can't connect to the internet";
+        return false;
     }
-    else
+
+    const char* sHeader = "Accept: */*\r\n\r\n";
+    HINTERNET hConnect = InternetOpenUrlA(hInternet, sURL, sHeader, lstrlenA(sHeader), INTERNET_FLAG_DONT_CACHE | INTERNET_FLAG_PRAGMA_NOCACHE | INTERNET_FLAG_RELOAD | INTERNET_FLAG_KEEP_CONNECTION, 0);
+    if (!hConnect)
     {
-        hInternet = InternetOpenA(sAgent, INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+        err = "Can't connect to the url";
+        return false;
     }
-    if (hInternet)
-    {
-        if (sHeader == NULL)
-        {
-            sHeader = "Accept: */*\r\n\r\n";
-        }
+    // Only the request is closed, its connection goes back to the session
+    ON_SCOPE_EXIT(InternetCloseHandle(hConnect));
 
-        hConnect = InternetOpenUrlA(hInternet, sURL, sHeader, lstrlenA(sHeader), INTERNET_FLAG_DONT_CACHE | INTERNET_FLAG_PRAGMA_NOCACHE | INTERNET_FLAG_RELOAD, 0);
-        if (!hConnect)
+    std::vector<char> acBuffer(BUFFER_SIZE);
+    while (true)
+    {
+        DWORD iReadBytes;
+        if (!InternetReadFile(hConnect, acBuffer.data(), BUFFER_SIZE, &iReadBytes))
         {
-            InternetCloseHandle(hInternet);
-            err = "Can't connect to the url";
+            err = "GET request failed";
             return false;
         }
-
-        // Get content size
-        if (!HttpQueryInfo(hConnect, HTTP_QUERY_CONTENT_LENGTH | HTTP_QUERY_FLAG_NUMBER, (LPVOID)&iBytesToRead, &iReadBytesOfRq, NULL))
+        if (iReadBytes == 0)
+            break;
+        if (!on_chunk(std::string_view{acBuffer.data(), iReadBytes}))
         {
-            iBytesToRead = 0;
+            err = "GET request aborted";
+            return false;
         }
-
-        do
-        {
-            if (!InternetReadFile(hConnect, acBuffer, BUFFER_SIZE, &iReadBytes))
-            {
-                InternetCloseHandle(hInternet);
-                err = "GET request failed";
-                return false;
-            }
-            if (iReadBytes > 0)
-            {
-                out += std::string(acBuffer, iReadBytes);
-            }
-            if (iReadBytes <= 0)
-            {
-                break;
-            }
-        } while (TRUE);
-        InternetCloseHandle(hInternet);
-    }
-    else
-    {
-        err = "Can't connect to the internet";
-        return false;
     }
-
     return true;
 }
+bool http_get(const char* sURL, std::string& out, std::string& err)
+{
+    return http_get(
+        sURL,
+        [&out](std::string_view chunk)
+        {
+            out += chunk;
+            return true;
+        },
+        err);
+}
 
 void http_get_async(HttpRequest* req)
 {
@@ -184,6 +333,40 @@ void http_get_async(HttpRequest* req)
 HttpRequest::HttpRequest(std::string url_, std::function<HttpCb> cb_)
     : url(url_), cb(cb_)
 {
-    std::thread thr(http_get_async, this);
-    thr.detach();
+    HttpWorkers::get().push([this]()
+                            { http_get_async(this); });
+}
+
+void http_download_async(std::string url, std::string path, std::function<HttpDownloadCb> cb)
+{
+    HttpWorkers::get().push(
+        [url = std::move(url), path = std::move(path), cb = std::move(cb)]()
+        {
+            std::string err;
+            bool ok;
+            {
+                std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                if (!file)
+                {
+                    cb(fmt::format("Can't open file '{}'", path));
+                    return;
+                }
+                ok = http_get(
+                    url.c_str(),
+                    [&file](std::string_view chunk)
+                    {
+                        file.write(chunk.data(), chunk.size());
+                        return file.good();
+                    },
+                    err);
+            }
+            if (!ok)
+            {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+                cb(std::move(err));
+                return;
+            }
+            cb(std::nullopt);
+        });
 }
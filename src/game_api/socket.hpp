@@ -1,30 +1,65 @@
 #pragma once
 
-#include <atomic>            // for atomic_flag
+#include <atomic>            // for atomic
+#include <cstdint>           // for uint32_t
 #include <functional>        // for function
+#include <mutex>             // for mutex
+#include <optional>          // for optional
 #include <sockpp/platform.h> // for in_port_t
 #include <string>            // for string
+#include <string_view>       // for string_view
 #include <thread>            // for thread
+#include <vector>            // for vector
 
 #include "sockpp/udp_socket.h" // for udp_socket
 
+/// A datagram received by a server from [udp_listen_batch](#udp_listen_batch)
+struct UdpPacket
+{
+    std::string data;
+    /// Address of the sender, can be used to reply with UdpServer:send
+    std::string host;
+    in_port_t port;
+};
+
 class UdpServer
 {
   public:
     using SocketCb = std::optional<std::string>(std::string);
 
+    // Calls `cb` on the receiving thread for every datagram, a returned string is sent back to the sender
     UdpServer(std::string host, in_port_t port, std::function<SocketCb> cb);
+    // Queues the datagrams instead, they are picked up with `take_packets`
+    UdpServer(std::string host, in_port_t port);
     ~UdpServer();
+
+    /// Stops the server, it doesn't receive anything anymore afterwards
     void clear();
+    // Datagrams received since the last call, oldest first
+    std::vector<UdpPacket> take_packets();
+    /// Send data to the specified address from the port of this server
+    bool send(std::string_view msg, const std::string& host, in_port_t port);
+    /// Datagrams that were thrown away because the queue was full, the queue holds up to 4096 datagrams
+    uint32_t get_dropped() const;
 
     std::string host;
     in_port_t port;
     std::function<SocketCb> cb;
-    std::thread thr;
-    std::atomic_flag kill_thr;
     sockpp::udp_socket sock;
+
+  private:
+    void start();
+    void receive();
+
+    std::thread thr;
+    // Signalled to wake the receiving thread up for shutdown
+    void* stop_event{nullptr};
+    std::mutex queue_lock;
+    std::vector<UdpPacket> queue;
+    std::atomic<uint32_t> dropped{0};
 };
 
+// Runs on a small pool of worker threads shared by all requests, deletes itself after calling `cb` there
 class HttpRequest
 {
   public:
@@ -37,5 +72,17 @@ class HttpRequest
     std::string error;
 };
 
-void dump_network();
+// Return false to abort the request
+using HttpChunkCb = bool(std::string_view chunk);
+// Called with the error or nullopt when the file was downloaded
+using HttpDownloadCb = void(std::optional<std::string>);
+
+// Hooks sendto and recvfrom and writes everything the game sends and receives to a pcap file
+bool dump_network(std::string path);
+// Stops the capture started by dump_network, the hooks stay in place for the next one
+void stop_dump_network();
+// Blocking, calls `on_chunk` with parts of the response as they arrive
+bool http_get(const char* sURL, const std::function<HttpChunkCb>& on_chunk, std::string& err);
 bool http_get(const char* sURL, std::string& out, std::string& err);
+// Streams the response into a file on one of the http worker threads, the file is removed again if the request failed
+void http_download_async(std::string url, std::string path, std::function<HttpDownloadCb> cb);
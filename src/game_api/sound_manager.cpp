@@ -7,11 +7,13 @@
 #include <memory>    // for remove_if, unique_ptr
 #include <mutex>     // for lock_guard, mutex
 
-#include "aliases.hpp"    //
-#include "entity.hpp"     //
-#include "logger.h"       // for DEBUG
-#include "overloaded.hpp" // for overloaded
-#include "search.hpp"     // for get_address
+#include "aliases.hpp"     //
+#include "entity.hpp"      //
+#include "file_api.hpp"    // for load_cached_pcm, write_cached_pcm, CachedPcm
+#include "logger.h"        // for DEBUG
+#include "mapped_file.hpp" // for MappedFile
+#include "overloaded.hpp"  // for overloaded
+#include "search.hpp"      // for get_address
 
 #define SOL_ALL_SAFETIES_ON 1
 
@@ -220,6 +222,20 @@ std::unordered_map<VANILLA_SOUND_PARAM, const char*> CustomSound::get_parameters
         m_FmodHandle);
 }
 
+const void* CustomSound::get_handle() const
+{
+    return std::visit(
+        overloaded{
+            [](FMOD::Sound* sound) -> const void*
+            { return sound; },
+            [](FMODStudio::EventDescription* event) -> const void*
+            { return event; },
+            [](std::monostate) -> const void*
+            { return nullptr; },
+        },
+        m_FmodHandle);
+}
+
 PlayingSound::PlayingSound(FMOD::Channel* fmod_channel, SoundManager* sound_manager)
     : m_FmodHandle{fmod_channel}, m_SoundManager{sound_manager}
 {
@@ -283,6 +299,8 @@ struct SoundManager::Sound
 {
     std::uint32_t ref_count;
     DecodedAudioBuffer buffer;
+    // Holds the samples instead of `buffer` when they came from the pcm cache
+    std::shared_ptr<MappedFile> cached_pcm;
     std::string path;
     FMOD::Sound* fmod_sound{nullptr};
 };
@@ -439,49 +457,96 @@ SoundManager::SoundManager(DecodeAudioFile* decode_function)
 }
 SoundManager::~SoundManager()
 {
-    for (Sound& sound : m_SoundStorage)
+    for (auto& [path, sound] : m_SoundStorage)
     {
-        m_ReleaseSound(sound.fmod_sound);
+        m_ReleaseSound(sound->fmod_sound);
     }
 }
 
-CustomSound SoundManager::get_sound(std::string path)
+CustomSound SoundManager::get_sound(std::string path, bool stream)
 {
-    auto it = std::find_if(m_SoundStorage.begin(), m_SoundStorage.end(), [&path](const Sound& sound)
-                           { return sound.path == path; });
+    auto it = m_SoundStorage.find(path);
     if (it != m_SoundStorage.end())
     {
-        it->ref_count++;
-        return CustomSound{it->fmod_sound, this};
+        it->second->ref_count++;
+        return CustomSound{it->second->fmod_sound, this};
     }
 
-    DecodedAudioBuffer buffer;
-    try
-    {
-        buffer = m_DecodeFunction(path.c_str());
-    }
-    catch (std::exception& except)
+    if (stream)
     {
-        DEBUG("Failed loading audio file {}\n{}", path, except.what());
-        return CustomSound{nullptr, nullptr};
+        // FMOD reads and decodes the file in chunks on its own stream thread, nothing but the stream buffer stays resident
+        auto new_sound = std::make_unique<Sound>();
+        new_sound->ref_count = 1;
+        new_sound->path = path;
+
+        FMOD::FMOD_MODE mode = (FMOD::FMOD_MODE)(FMOD::FMOD_MODE::MODE_CREATESTREAM | FMOD::FMOD_MODE::MODE_IGNORETAGS | FMOD::FMOD_MODE::MODE_LOOP_OFF);
+        FMOD::CREATESOUNDEXINFO create_sound_exinfo{};
+        create_sound_exinfo.cbsize = sizeof(create_sound_exinfo);
+        if (m_CreateSound(m_FmodSystem, path.c_str(), mode, &create_sound_exinfo, &new_sound->fmod_sound) == FMOD::FMOD_RESULT::OK)
+        {
+            FMOD::Sound* fmod_sound = new_sound->fmod_sound;
+            m_SoundsByHandle[fmod_sound] = new_sound.get();
+            set_sound_loaded(path, true);
+            m_SoundStorage[std::move(path)] = std::move(new_sound);
+            return CustomSound{fmod_sound, this};
+        }
+        DEBUG("FMOD can't stream audio file {}, decoding all of it instead", path);
     }
 
-    Sound new_sound;
+    auto new_sound_ptr = std::make_unique<Sound>();
+    Sound& new_sound = *new_sound_ptr;
     new_sound.ref_count = 1;
-    new_sound.buffer = std::move(buffer);
-    new_sound.path = std::move(path);
+    new_sound.path = path;
+
+    std::string_view samples;
+    std::int32_t num_channels;
+    std::int32_t frequency;
+    SoundFormat format;
+    if (std::optional<CachedPcm> cached = load_cached_pcm(path))
+    {
+        // Mapped, FMOD reads the samples right from the cache file
+        samples = cached->samples;
+        num_channels = cached->num_channels;
+        frequency = cached->frequency;
+        format = cached->format;
+        new_sound.cached_pcm = std::move(cached->file);
+    }
+    else
+    {
+        if (std::optional<DecodedAudioBuffer> predecoded = take_predecoded_sound(path))
+        {
+            new_sound.buffer = std::move(predecoded.value());
+        }
+        else
+        {
+            try
+            {
+                new_sound.buffer = m_DecodeFunction(path.c_str());
+            }
+            catch (std::exception& except)
+            {
+                DEBUG("Failed loading audio file {}\n{}", path, except.what());
+                return CustomSound{nullptr, nullptr};
+            }
+            write_cached_pcm(path, new_sound.buffer);
+        }
+        samples = {(const char*)new_sound.buffer.data.get() + 16, new_sound.buffer.data_size - 32}; // 16 bytes padding on both sides
+        num_channels = new_sound.buffer.num_channels;
+        frequency = new_sound.buffer.frequency;
+        format = new_sound.buffer.format;
+    }
 
     FMOD::FMOD_MODE mode =
         (FMOD::FMOD_MODE)(FMOD::FMOD_MODE::MODE_CREATESAMPLE | FMOD::FMOD_MODE::MODE_OPENMEMORY_POINT | FMOD::FMOD_MODE::MODE_OPENRAW | FMOD::FMOD_MODE::MODE_IGNORETAGS | FMOD::FMOD_MODE::MODE_LOOP_OFF);
 
     FMOD::CREATESOUNDEXINFO create_sound_exinfo{};
     create_sound_exinfo.cbsize = sizeof(create_sound_exinfo);
-    create_sound_exinfo.length = (std::uint32_t)new_sound.buffer.data_size - 32;
-    create_sound_exinfo.numchannels = new_sound.buffer.num_channels;
-    create_sound_exinfo.defaultfrequency = new_sound.buffer.frequency;
-    create_sound_exinfo.format = [path](SoundFormat format)
+    create_sound_exinfo.length = (std::uint32_t)samples.size();
+    create_sound_exinfo.numchannels = num_channels;
+    create_sound_exinfo.defaultfrequency = frequency;
+    create_sound_exinfo.format = [path](SoundFormat sound_format)
     {
-        switch (format)
+        switch (sound_format)
         {
         default:
             DEBUG("Sound format is not supported for file {}...", path);
@@ -497,17 +562,91 @@ CustomSound SoundManager::get_sound(std::string path)
         case SoundFormat::PCM_FLOAT:
             return FMOD::SOUND_FORMAT::PCMFLOAT;
         }
-    }(new_sound.buffer.format);
+    }(format);
 
-    auto data = (const char*)new_sound.buffer.data.get() + 16; // 16 bytes padding in front
-    FMOD::FMOD_RESULT err = m_CreateSound(m_FmodSystem, data, mode, &create_sound_exinfo, &new_sound.fmod_sound);
+    FMOD::FMOD_RESULT err = m_CreateSound(m_FmodSystem, samples.data(), mode, &create_sound_exinfo, &new_sound.fmod_sound);
     if (err != FMOD::FMOD_RESULT::OK)
     {
         return CustomSound{nullptr, nullptr};
     }
 
-    m_SoundStorage.push_back(std::move(new_sound));
-    return CustomSound{m_SoundStorage.back().fmod_sound, this};
+    FMOD::Sound* fmod_sound = new_sound.fmod_sound;
+    m_SoundsByHandle[fmod_sound] = new_sound_ptr.get();
+    set_sound_loaded(path, true);
+    m_SoundStorage[std::move(path)] = std::move(new_sound_ptr);
+    return CustomSound{fmod_sound, this};
+}
+bool SoundManager::predecode_sound(const std::string& path)
+{
+    {
+        // Already loaded or streamed sounds don't go through the decode again
+        std::lock_guard lock{m_PredecodedSoundsLock};
+        if (m_PredecodedSounds.contains(path) || m_LoadedSounds.contains(path))
+            return true;
+    }
+    // get_sound maps the cache file, there's nothing to decode ahead of time
+    if (load_cached_pcm(path))
+        return true;
+
+    DecodedAudioBuffer buffer;
+    try
+    {
+        buffer = m_DecodeFunction(path.c_str());
+    }
+    catch (std::exception& except)
+    {
+        DEBUG("Failed loading audio file {}\n{}", path, except.what());
+        return false;
+    }
+    write_cached_pcm(path, buffer);
+
+    std::lock_guard lock{m_PredecodedSoundsLock};
+    // Loaded while this was decoding, or another worker got there first
+    if (m_LoadedSounds.contains(path) || m_PredecodedSounds.contains(path))
+        return true;
+    // The oldest sounds nobody asked for yet go first, get_sound decodes them again if they're needed after all
+    m_PredecodedBytes += buffer.data_size;
+    m_PredecodedSounds.emplace(path, std::move(buffer));
+    m_PredecodedOrder.push_back(path);
+    while (m_PredecodedBytes > MAX_PREDECODED_BYTES && m_PredecodedOrder.size() > 1)
+    {
+        const std::string oldest = m_PredecodedOrder.front();
+        erase_predecoded_sound(oldest);
+    }
+    return true;
+}
+std::optional<DecodedAudioBuffer> SoundManager::take_predecoded_sound(const std::string& path)
+{
+    std::lock_guard lock{m_PredecodedSoundsLock};
+    auto it = m_PredecodedSounds.find(path);
+    if (it == m_PredecodedSounds.end())
+        return std::nullopt;
+    DecodedAudioBuffer buffer = std::move(it->second);
+    erase_predecoded_sound(path);
+    return buffer;
+}
+void SoundManager::erase_predecoded_sound(const std::string& path)
+{
+    auto it = m_PredecodedSounds.find(path);
+    if (it == m_PredecodedSounds.end())
+        return;
+    m_PredecodedBytes -= it->second.data_size;
+    m_PredecodedSounds.erase(it);
+    std::erase(m_PredecodedOrder, path);
+}
+void SoundManager::set_sound_loaded(const std::string& path, bool loaded)
+{
+    std::lock_guard lock{m_PredecodedSoundsLock};
+    if (loaded)
+    {
+        m_LoadedSounds.insert(path);
+        // Streamed sounds never take the buffer, and a loaded sound doesn't need it any more
+        erase_predecoded_sound(path);
+    }
+    else
+    {
+        m_LoadedSounds.erase(path);
+    }
 }
 CustomSound SoundManager::get_sound(const char* path)
 {
@@ -515,46 +654,46 @@ CustomSound SoundManager::get_sound(const char* path)
 }
 CustomSound SoundManager::get_existing_sound(std::string_view path)
 {
-    auto it = std::find_if(m_SoundStorage.begin(), m_SoundStorage.end(), [&path](const Sound& sound)
-                           { return sound.path == path; });
+    auto it = m_SoundStorage.find(std::string{path});
     if (it != m_SoundStorage.end())
     {
-        it->ref_count++;
-        return CustomSound{it->fmod_sound, this};
+        it->second->ref_count++;
+        return CustomSound{it->second->fmod_sound, this};
     }
     return CustomSound{nullptr, nullptr};
 }
 void SoundManager::acquire_sound(FMOD::Sound* fmod_sound)
 {
-    auto it = std::find_if(m_SoundStorage.begin(), m_SoundStorage.end(), [fmod_sound](const Sound& sound)
-                           { return sound.fmod_sound == fmod_sound; });
-    if (it == m_SoundStorage.end())
+    auto it = m_SoundsByHandle.find(fmod_sound);
+    if (it == m_SoundsByHandle.end())
     {
         DEBUG("Trying to acquire sound that does not exist...");
         return;
     }
 
-    it->ref_count++;
+    it->second->ref_count++;
 }
 void SoundManager::release_sound(FMOD::Sound* fmod_sound)
 {
-    auto it = std::find_if(m_SoundStorage.begin(), m_SoundStorage.end(), [fmod_sound](const Sound& sound)
-                           { return sound.fmod_sound == fmod_sound; });
-    if (it == m_SoundStorage.end())
+    auto it = m_SoundsByHandle.find(fmod_sound);
+    if (it == m_SoundsByHandle.end())
     {
         DEBUG("Trying to release sound that does not exist...");
         return;
     }
 
     // TODO: Really worth releasing or should we just keep this for eternity?
-    if (it->ref_count == 1)
+    Sound* sound = it->second;
+    if (sound->ref_count == 1)
     {
-        m_ReleaseSound(it->fmod_sound);
-        m_SoundStorage.erase(it);
+        m_ReleaseSound(sound->fmod_sound);
+        m_SoundsByHandle.erase(it);
+        set_sound_loaded(sound->path, false);
+        m_SoundStorage.erase(m_SoundStorage.find(sound->path));
     }
     else
     {
-        it->ref_count--;
+        sound->ref_count--;
     }
 }
 PlayingSound SoundManager::play_sound(FMOD::Sound* fmod_sound, bool paused, bool as_music)
@@ -3,14 +3,18 @@
 #include <array>
 #include <cstddef> // IWYU pragma: keep
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <new>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -61,6 +65,9 @@ class CustomSound
 
     std::unordered_map<VANILLA_SOUND_PARAM, const char*> get_parameters();
 
+    // The FMOD sound or event, identifies the sound regardless of which handle it is used through
+    const void* get_handle() const;
+
   private:
     CustomSound(std::nullptr_t, std::nullptr_t)
     {
@@ -100,6 +107,8 @@ class PlayingSound
     std::optional<float> get_parameter(VANILLA_SOUND_PARAM parameter_index);
     bool set_parameter(VANILLA_SOUND_PARAM parameter_index, float value);
 
+    bool operator==(const PlayingSound& rhs) const = default;
+
   private:
     PlayingSound(std::nullptr_t, std::nullptr_t)
     {
@@ -127,8 +136,12 @@ class SoundManager
         return m_IsInit;
     }
 
-    CustomSound get_sound(std::string path);
+    // With `stream` the file is opened as an FMOD stream instead of being decoded into memory, falls back to decoding if FMOD can't read the format
+    CustomSound get_sound(std::string path, bool stream = false);
     CustomSound get_sound(const char* path);
+    // Decodes the file into memory so a later get_sound doesn't have to, safe to call from any thread
+    // Skipped for sounds that are already loaded or streamed, the oldest buffers are dropped past MAX_PREDECODED_BYTES
+    bool predecode_sound(const std::string& path);
     CustomSound get_existing_sound(std::string_view path);
     void acquire_sound(FMOD::Sound* fmod_sound);
     void release_sound(FMOD::Sound* fmod_sound);
@@ -251,7 +264,21 @@ class SoundManager
 
     struct Sound;
 
-    std::vector<Sound> m_SoundStorage;
+    std::unordered_map<std::string, std::unique_ptr<Sound>> m_SoundStorage;
+    std::unordered_map<FMOD::Sound*, Sound*> m_SoundsByHandle;
+
+    std::optional<DecodedAudioBuffer> take_predecoded_sound(const std::string& path);
+    // Only with m_PredecodedSoundsLock held
+    void erase_predecoded_sound(const std::string& path);
+    void set_sound_loaded(const std::string& path, bool loaded);
+
+    static constexpr size_t MAX_PREDECODED_BYTES = 256 * 1024 * 1024;
+    std::mutex m_PredecodedSoundsLock;
+    std::unordered_map<std::string, DecodedAudioBuffer> m_PredecodedSounds;
+    std::deque<std::string> m_PredecodedOrder;
+    size_t m_PredecodedBytes{0};
+    // Paths in m_SoundStorage, which is only used on the game thread, so the preload workers can check it
+    std::unordered_set<std::string> m_LoadedSounds;
 };
 
 struct SoundInfo
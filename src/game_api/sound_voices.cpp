@@ -0,0 +1,122 @@
+#include "sound_voices.hpp"
+
+#include <algorithm> // for count_if
+
+#include "entity.hpp"        // for get_entity_ptr, Entity
+#include "math.hpp"          // for Vec2
+#include "state_structs.hpp" // for Camera
+
+void SoundVoices::set_sound_limit(const CustomSound& sound, uint32_t max_instances)
+{
+    if (max_instances == 0)
+        sound_limits.erase(sound.get_handle());
+    else
+        sound_limits[sound.get_handle()] = max_instances;
+}
+void SoundVoices::set_budget(uint32_t max_voices)
+{
+    budget = max_voices;
+}
+void SoundVoices::set_policy(VOICE_STEAL new_policy)
+{
+    policy = new_policy;
+}
+
+void SoundVoices::forget_stopped()
+{
+    std::erase_if(voices, [](Voice& voice)
+                  { return !voice.playing.is_playing(); });
+}
+
+template <class FunT>
+bool SoundVoices::make_room(FunT&& matches)
+{
+    auto victim = voices.end();
+    for (auto it = voices.begin(); it != voices.end(); ++it)
+    {
+        if (!matches(*it))
+            continue;
+        if (victim == voices.end() ||
+            (policy == VOICE_STEAL::OLDEST && it->started < victim->started) ||
+            (policy == VOICE_STEAL::QUIETEST && it->volume < victim->volume))
+        {
+            victim = it;
+        }
+    }
+    if (policy == VOICE_STEAL::NONE || victim == voices.end())
+        return false;
+
+    victim->playing.stop();
+    voices.erase(victim);
+    return true;
+}
+
+std::optional<PlayingSound> SoundVoices::play(CustomSound& sound, bool paused, SOUND_TYPE sound_type)
+{
+    if (budget == 0 && sound_limits.empty())
+        return sound.play(paused, sound_type);
+
+    forget_stopped();
+    const void* key = sound.get_handle();
+    if (auto limit = sound_limits.find(key); limit != sound_limits.end())
+    {
+        auto same_sound = [key](const Voice& voice)
+        { return voice.sound == key; };
+        const auto instances = static_cast<uint32_t>(std::count_if(voices.begin(), voices.end(), same_sound));
+        if (instances >= limit->second && !make_room(same_sound))
+            return std::nullopt;
+    }
+    if (budget != 0 && voices.size() >= budget && !make_room([](const Voice&)
+                                                             { return true; }))
+        return std::nullopt;
+
+    PlayingSound playing = sound.play(paused, sound_type);
+    voices.push_back({key, playing, next_start++, 1.0f});
+    return playing;
+}
+
+bool SoundVoices::set_volume(PlayingSound& playing_sound, float volume)
+{
+    for (Voice& voice : voices)
+    {
+        if (voice.playing == playing_sound)
+        {
+            voice.volume = volume;
+            break;
+        }
+    }
+    return playing_sound.set_volume(volume);
+}
+
+void SoundVoices::set_cull_distance(float distance)
+{
+    cull_distance = distance;
+}
+bool SoundVoices::is_culled(uint32_t source_uid) const
+{
+    if (cull_distance <= 0.0f)
+        return false;
+    Entity* source = get_entity_ptr(source_uid);
+    if (source == nullptr)
+        return false;
+    const Vec2 camera = Camera::get_position();
+    const Vec2 position = source->abs_position();
+    const float dx = position.x - camera.x;
+    const float dy = position.y - camera.y;
+    return dx * dx + dy * dy > cull_distance * cull_distance;
+}
+
+uint32_t SoundVoices::count()
+{
+    forget_stopped();
+    return static_cast<uint32_t>(voices.size());
+}
+
+void SoundVoices::clear()
+{
+    voices.clear();
+    sound_limits.clear();
+    budget = 0;
+    cull_distance = 0.0f;
+    policy = VOICE_STEAL::OLDEST;
+}
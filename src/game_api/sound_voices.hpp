@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>       // for uint32_t, uint64_t
+#include <optional>      // for optional
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+
+#include "sound_manager.hpp" // for CustomSound, PlayingSound, SOUND_TYPE
+
+enum class VOICE_STEAL
+{
+    // A sound that doesn't fit isn't played
+    NONE,
+    OLDEST,
+    QUIETEST,
+};
+
+// Keeps track of the sounds a script plays so it can't use up all of FMOD's channels, limits how many instances of each sound and how many sounds in total play at once
+// When a limit is hit one of the playing sounds it applies to is stopped to make room, or the new one isn't played, depending on the policy
+class SoundVoices
+{
+  public:
+    // 0 removes the limit
+    void set_sound_limit(const CustomSound& sound, uint32_t max_instances);
+    void set_budget(uint32_t max_voices);
+    void set_policy(VOICE_STEAL new_policy);
+
+    // nullopt if there was no room and nothing could be stopped to make some
+    std::optional<PlayingSound> play(CustomSound& sound, bool paused, SOUND_TYPE sound_type);
+    // Set through here so the quietest sound is known, FMOD doesn't tell
+    bool set_volume(PlayingSound& playing_sound, float volume);
+
+    // Sounds played at an entity further than this from the camera are not played at all, 0 disables it
+    void set_cull_distance(float distance);
+    bool is_culled(uint32_t source_uid) const;
+
+    uint32_t count();
+    // Forgets the sounds without stopping them and drops the limits, the budget, the policy and the cull distance, for the script being reset
+    void clear();
+
+  private:
+    struct Voice
+    {
+        const void* sound;
+        PlayingSound playing;
+        uint64_t started;
+        float volume;
+    };
+
+    void forget_stopped();
+    // Frees one of the voices that `matches`, false if none could be freed
+    template <class FunT>
+    bool make_room(FunT&& matches);
+
+    std::vector<Voice> voices;
+    std::unordered_map<const void*, uint32_t> sound_limits;
+    uint32_t budget{0};
+    float cull_distance{0.0f};
+    VOICE_STEAL policy{VOICE_STEAL::OLDEST};
+    uint64_t next_start{0};
+};
@@ -1,6 +1,7 @@
 #include "spawn_api.hpp"
 
 #include <Windows.h>   // for GetCurrentThread, LONG, NO_ERROR
+#include <algorithm>   // for min
 #include <array>       // for array
 #include <cmath>       // for roundf, INFINITY
 #include <cstddef>     // for size_t
@@ -13,12 +14,14 @@
 #include <vector>      // for vector, allocator, _Vector_iterator
 
 #include "containers/custom_vector.hpp" //
+#include "detour_transaction.hpp"       // for hook_transaction_begin, hook_transaction_commit
 #include "entities_chars.hpp"           // for Player
 #include "entities_items.hpp"           // for ClimbableRope
 #include "entities_liquids.hpp"         // for Lava
 #include "entities_monsters.hpp"        // for Shopkeeper, RoomOwner
 #include "entity.hpp"                   // for Entity, get_entity_ptr, Enti...
 #include "entity_db.hpp"                // for EntityFactory, to_id
+#include "entity_type_vtables.hpp"      // for on_entity_type_spawned
 #include "illumination.hpp"             //
 #include "items.hpp"                    //
 #include "layer.hpp"                    // for Layer, g_level_max_y, g_level_max_x
@@ -28,7 +31,7 @@
 #include "math.hpp"                     // for AABB
 #include "memory.hpp"                   // for write_mem_prot, memory_read
 #include "prng.hpp"                     // for PRNG, PRNG::PRNG_CLASS, PRNG::ENTIT...
-#include "script/events.hpp"            // for post_entity_spawn, pre_entity_spawn
+#include "script/events.hpp"            // for post_entity_spawn, pre_entity_spawn, EntitySpawnDispatchBatch
 #include "search.hpp"                   // for get_address
 #include "state.hpp"                    // for StateMemory
 #include "state_structs.hpp"            // for LiquidTileSpawnData, LiquidPhysics
@@ -179,6 +182,56 @@ int32_t spawn_entity_abs(ENT_TYPE entity_type, float x, float y, LAYER layer, fl
     return HeapBase::get().state()->layers[actual_layer]->spawn_entity(entity_type, x + offset_position.x, y + offset_position.y, false, vx, vy, false)->uid;
 }
 
+std::vector<int32_t> spawn_entities_abs(const std::vector<ENT_TYPE>& entity_types, const std::vector<float>& xs, const std::vector<float>& ys, LAYER layer)
+{
+    push_spawn_type_flags(SPAWN_TYPE_SCRIPT);
+    OnScopeExit pop{[]
+                    { pop_spawn_type_flags(SPAWN_TYPE_SCRIPT); }};
+
+    Vec2 offset_position;
+    uint8_t actual_layer = enum_to_layer(layer, offset_position);
+    Layer* target_layer = HeapBase::get().state()->layers[actual_layer];
+    EntitySpawnDispatchBatch dispatch_batch;
+
+    // A single type is used for every position
+    const bool single_type = entity_types.size() == 1;
+    size_t count = std::min(xs.size(), ys.size());
+    if (!single_type)
+        count = std::min(count, entity_types.size());
+
+    std::vector<int32_t> uids;
+    uids.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const ENT_TYPE entity_type = single_type ? entity_types[0] : entity_types[i];
+        uids.push_back(target_layer->spawn_entity(entity_type, xs[i] + offset_position.x, ys[i] + offset_position.y, false, 0.0f, 0.0f, false)->uid);
+    }
+    return uids;
+}
+
+std::vector<int32_t> SpawnBatch::spawn()
+{
+    push_spawn_type_flags(SPAWN_TYPE_SCRIPT);
+    OnScopeExit pop{[]
+                    { pop_spawn_type_flags(SPAWN_TYPE_SCRIPT); }};
+    EntitySpawnDispatchBatch dispatch_batch;
+
+    // Callbacks may add to the batch while it spawns, those spawns are kept for the next call
+    std::vector<Request> to_spawn = std::move(requests);
+    requests.clear();
+
+    auto* state = HeapBase::get().state();
+    std::vector<int32_t> uids;
+    uids.reserve(to_spawn.size());
+    for (const Request& request : to_spawn)
+    {
+        Vec2 offset_position;
+        const uint8_t actual_layer = enum_to_layer(request.layer, offset_position);
+        uids.push_back(state->layers[actual_layer]->spawn_entity(request.entity_type, request.x + offset_position.x, request.y + offset_position.y, false, request.vx, request.vy, false)->uid);
+    }
+    return uids;
+}
+
 int32_t spawn_entity_snap_to_floor(ENT_TYPE entity_type, float x, float y, LAYER layer)
 {
     push_spawn_type_flags(SPAWN_TYPE_SCRIPT);
@@ -645,6 +698,7 @@ Entity* spawn_entity(EntityFactory* entity_factory, std::uint32_t entity_type, f
     if (spawned_ent == nullptr)
     {
         spawned_ent = g_spawn_entity_trampoline(entity_factory, entity_type, x, y, layer, overlay, some_bool);
+        on_entity_type_spawned(spawned_ent);
     }
 
     post_entity_spawn(spawned_ent, g_SpawnTypeFlags);
@@ -664,14 +718,13 @@ Entity* spawn_entity(EntityFactory* entity_factory, std::uint32_t entity_type, f
 void init_spawn_hooks()
 {
     {
-        DetourTransactionBegin();
-        DetourUpdateThread(GetCurrentThread());
+        hook_transaction_begin();
 
         g_spawn_entity_trampoline = (SpawnEntityFun*)get_address("spawn_entity");
 
         DetourAttach((void**)&g_spawn_entity_trampoline, (SpawnEntityFun*)spawn_entity);
 
-        const LONG error = DetourTransactionCommit();
+        const LONG error = hook_transaction_commit();
         if (error != NO_ERROR)
         {
             DEBUG("Failed hooking SpawnEntity: {}\n", error);
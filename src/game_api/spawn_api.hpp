@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef> // for size_t
 #include <cstdint> // for int32_t, uint32_t, uint8_t, uint16_t, int16_t
+#include <vector>  // for vector
 
 #include "aliases.hpp" // for LAYER, ENT_TYPE, SPAWN_TYPE, ROOM_TEMPLATE
 
@@ -20,10 +22,44 @@ enum SpawnType : SPAWN_TYPE
     SPAWN_TYPE_ANY = SPAWN_TYPE_LEVEL_GEN | SPAWN_TYPE_SCRIPT | SPAWN_TYPE_SYSTEMIC
 };
 
+/// Collects spawns to run them in one pass, see [SpawnBatch](#SpawnBatch)
+struct SpawnBatch
+{
+    struct Request
+    {
+        ENT_TYPE entity_type;
+        float x;
+        float y;
+        LAYER layer;
+        float vx;
+        float vy;
+    };
+    std::vector<Request> requests;
+
+    /// Queue a spawn, the arguments are the same as for [spawn_entity](#spawn_entity)
+    void add(ENT_TYPE entity_type, float x, float y, LAYER layer, float vx, float vy)
+    {
+        requests.push_back({entity_type, x, y, layer, vx, vy});
+    }
+    /// Number of queued spawns
+    size_t size() const
+    {
+        return requests.size();
+    }
+    /// Drop all queued spawns
+    void clear()
+    {
+        requests.clear();
+    }
+    /// Spawn all queued entities in the order they were added and return their uids, empties the batch
+    std::vector<int32_t> spawn();
+};
+
 void spawn_liquid(ENT_TYPE entity_type, float x, float y);
 void spawn_liquid(ENT_TYPE entity_type, float x, float y, float velocityx, float velocityy, uint32_t liquid_flags, uint32_t amount, float blobs_separation);
 void spawn_liquid_ex(ENT_TYPE entity_type, float x, float y, float velocityx, float velocityy, uint32_t liquid_flags, uint32_t amount);
 int32_t spawn_entity_abs(ENT_TYPE entity_type, float x, float y, LAYER layer, float vx, float vy);
+std::vector<int32_t> spawn_entities_abs(const std::vector<ENT_TYPE>& entity_types, const std::vector<float>& xs, const std::vector<float>& ys, LAYER layer);
 int32_t spawn_entity_snap_to_floor(ENT_TYPE entity_type, float x, float y, LAYER layer);
 int32_t spawn_entity_snap_to_grid(ENT_TYPE entity_type, float x, float y, LAYER layer);
 int32_t spawn_entity_abs_nonreplaceable(ENT_TYPE entity_type, float x, float y, LAYER layer, float vx, float vy);
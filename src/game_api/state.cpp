@@ -8,17 +8,26 @@
 #include <new>         // for operator new
 #include <string>      // for allocator, operator""sv, operator""s
 #include <type_traits> // for move
+#include <xmmintrin.h> // for _mm_prefetch, _MM_HINT_T0
 
 #include "bucket.hpp"                            // for Bucket
 #include "containers/custom_allocator.hpp"       //
+#include "demand_hook.hpp"                       // for DemandHook, enable_demand_hooks, update_demand_hooks
+#include "detour_transaction.hpp"                // for DetourTransaction, hook_transaction_begin, hook_t...
 #include "entities_chars.hpp"                    // for Player
 #include "entity.hpp"                            // for to_id, Entity, HookWithId, EntityDB
 #include "entity_hooks_info.hpp"                 // for Player
+#include "entity_stream.hpp"                     // for EntityStream
+#include "frame_telemetry.hpp"                   // for FramePhaseScope, FRAME_PHASE, FrameTelemetry
 #include "game_api.hpp"                          // for GameAPI
+#include "game_heap_stats.hpp"                   // for GameHeapTag
 #include "game_manager.hpp"                      // for get_game_manager, GameManager, SaveR...
 #include "game_patches.hpp"                      //
+#include "input_replay.hpp"                      // for InputReplay
+#include "input_snapshot.hpp"                    // for InputSnapshots
 #include "items.hpp"                             // for Items, SelectPlayerSlot
 #include "level_api.hpp"                         // for LevelGenSystem, LevelGenSystem::(ano...
+#include "liquid_budget.hpp"                     // for LiquidBudget
 #include "liquid_engine.hpp"                     // for LiquidPhysicsEngine
 #include "logger.h"                              // for DEBUG
 #include "memory.hpp"                            // for write_mem_prot, memory_read
@@ -28,16 +37,22 @@
 #include "rpc.hpp"                               // for lowbias32
 #include "savedata.hpp"                          // for SaveData
 #include "screen.hpp"                            // for Screen
+#include "screen_transform.hpp"                  // for ScreenTransform
+#include "script/entity_delta.hpp"               // for EntityDeltaTracker
 #include "script/events.hpp"                     // for pre_entity_instagib
+#include "script/lua_backend.hpp"                // for LuaBackend, BackendEvent
+#include "script/lua_idle.hpp"                   // for LuaIdleScheduler
 #include "script/lua_vm.hpp"                     // for get_lua_vm
 #include "script/usertypes/theme_vtable_lua.hpp" // for NThemeVTables
 #include "search.hpp"                            // for get_address
 #include "sound_manager.hpp"                     // for SoundManager
 #include "spawn_api.hpp"                         // for init_spawn_hooks
-#include "steam_api.hpp"                         // for init_achievement_hooks
+#include "state_feed.hpp"                        // for StateFeed
 #include "strings.hpp"                           // for strings_init
+#include "turbo.hpp"                             // for Turbo
 #include "virtual_table.hpp"                     // for get_virtual_function_address, VTABLE...
 #include "vtable_hook.hpp"                       // for hook_vtable
+#include "window_api.hpp"                        // for wait_for_next_frame
 
 static uint64_t global_frame_count{0};
 static uint64_t global_update_count{0};
@@ -142,11 +157,13 @@ static bool g_godmode_companions_active = false;
 void API::godmode(bool g)
 {
     g_godmode_player_active = g;
+    attach_demand_hooks();
 }
 
 void API::godmode_companions(bool g)
 {
     g_godmode_companions_active = g;
+    attach_demand_hooks();
 }
 
 static bool is_active_player(Entity* e)
@@ -200,33 +217,24 @@ void on_instagib(Entity* victim, bool destroy_corpse, size_t param_3)
     }
 }
 
-void hook_godmode_functions()
-{
-    static bool functions_hooked = false;
-    if (!functions_hooked)
+// Only needed for godmode and the instagib callbacks, the damage of every entity goes through it otherwise
+DemandHook g_godmode_hook{
+    "on_damage/instagib",
+    []()
     {
         auto& memory = Memory::get();
-        auto addr_damage = memory.at_exe(get_virtual_function_address(VTABLE_OFFSET::CHAR_ANA_SPELUNKY, 48));
-        auto addr_insta = get_address("insta_gib");
-
-        g_on_damage_trampoline = (OnDamageFun*)addr_damage;
-        g_on_instagib_trampoline = (OnInstaGibFun*)addr_insta;
-
-        DetourTransactionBegin();
-        DetourUpdateThread(GetCurrentThread());
-
-        DetourAttach((void**)&g_on_damage_trampoline, &on_damage);
-        DetourAttach((void**)&g_on_instagib_trampoline, &on_instagib);
-
-        const LONG error = DetourTransactionCommit();
-        if (error != NO_ERROR)
-        {
-            DEBUG("Failed hooking on_damage/instagib: {}\n", error);
-        }
-
-        functions_hooked = true;
-    }
-}
+        g_on_damage_trampoline = (OnDamageFun*)memory.at_exe(get_virtual_function_address(VTABLE_OFFSET::CHAR_ANA_SPELUNKY, 48));
+        g_on_instagib_trampoline = (OnInstaGibFun*)get_address("insta_gib");
+    },
+    {
+        {(void**)&g_on_damage_trampoline, (void*)&on_damage},
+        {(void**)&g_on_instagib_trampoline, (void*)&on_instagib},
+    },
+    []()
+    {
+        return g_godmode_player_active || g_godmode_companions_active || LuaBackend::has_subscribers(BackendEvent::PRE_ENTITY_INSTAGIB);
+    },
+};
 
 struct ThemeHookImpl
 {
@@ -263,28 +271,14 @@ struct ThemeHookImpl
     }
 };
 
-static float get_zoom_level()
-{
-    auto game_api = GameAPI::get();
-    return game_api->get_current_zoom();
-}
-
 Vec2 API::click_position(float x, float y)
 {
-    float cz = get_zoom_level();
-    auto [cx, cy] = Camera::get_position();
-    float rx = cx + ZF * cz * x;
-    float ry = cy + (ZF / 16.0f * 9.0f) * cz * y;
-    return {rx, ry};
+    return ScreenTransform::get().to_world(x, y);
 }
 
 Vec2 API::screen_position(float x, float y)
 {
-    float cz = get_zoom_level();
-    auto [cx, cy] = Camera::get_position();
-    float rx = (x - cx) / cz / ZF;
-    float ry = (y - cy) / cz / (ZF / 16.0f * 9.0f);
-    return {rx, ry};
+    return ScreenTransform::get().to_screen(x, y);
 }
 
 void API::zoom(float level)
@@ -377,6 +371,7 @@ void Camera::set_position(float cx, float cy)
     calculated_focus_y = cy;
     *addr = cx;
     *(addr + 1) = cy;
+    ScreenTransform::invalidate();
 }
 
 void Camera::update_position()
@@ -387,6 +382,7 @@ void Camera::update_position()
     ucf(this);
     calculated_focus_x = adjusted_focus_x;
     calculated_focus_y = adjusted_focus_y;
+    ScreenTransform::invalidate();
 }
 
 void StateMemory::warp(uint8_t set_world, uint8_t set_level, uint8_t set_theme)
@@ -446,10 +442,70 @@ void StateMemory::set_seed(uint32_t set_seed)
     loading = 1;
 }
 
-Entity* StateMemory::get_entity(uint32_t uid) const
+namespace
+{
+// Index of the slot holding `hashed_uid_plus_one`, or ~0 if it isn't in the table
+uint32_t probe_uid_table(const RobinHoodTableEntry* data, uint32_t mask, uint32_t hashed_uid_plus_one)
 {
     // Ported from MauveAlert's python code in the CAT tracker
+    uint32_t cur_index = hashed_uid_plus_one & mask;
+    while (true)
+    {
+        const RobinHoodTableEntry& entry = data[cur_index];
+        if (entry.uid_plus_one == hashed_uid_plus_one)
+        {
+            return cur_index;
+        }
+
+        if (entry.uid_plus_one == 0)
+        {
+            return ~0u;
+        }
+
+        if (((cur_index - hashed_uid_plus_one) & mask) > ((cur_index - entry.uid_plus_one) & mask))
+        {
+            return ~0u;
+        }
+
+        cur_index = (cur_index + (uint32_t)1) & mask;
+    }
+}
+
+// Remembers where recently looked up uids were found, a hit is checked against the slot itself so it can't return an entity that
+// was destroyed or moved by a rehash since, no matter which state the table belongs to
+struct UidSlotCache
+{
+    static constexpr uint32_t SIZE = 256;
+    struct Line
+    {
+        const RobinHoodTableEntry* data;
+        uint32_t mask;
+        uint32_t hashed_uid_plus_one;
+        uint32_t index;
+    };
+    std::array<Line, SIZE> lines{};
+
+    Entity* find(const RobinHoodTableEntry* data, uint32_t mask, uint32_t uid, uint32_t hashed_uid_plus_one) const
+    {
+        const Line& line = lines[uid % SIZE];
+        if (line.data == data && line.mask == mask && line.hashed_uid_plus_one == hashed_uid_plus_one && line.index <= mask)
+        {
+            const RobinHoodTableEntry& entry = data[line.index];
+            if (entry.uid_plus_one == hashed_uid_plus_one)
+                return entry.entity;
+        }
+        return nullptr;
+    }
+    void insert(const RobinHoodTableEntry* data, uint32_t mask, uint32_t uid, uint32_t hashed_uid_plus_one, uint32_t index)
+    {
+        lines[uid % SIZE] = {data, mask, hashed_uid_plus_one, index};
+    }
+};
+thread_local UidSlotCache g_uid_slot_cache;
+} // namespace
 
+Entity* StateMemory::get_entity(uint32_t uid) const
+{
     // -1 (0xFFFFFFFF) is used as a null-like value for uids.
     if (uid == ~0)
     {
@@ -458,27 +514,56 @@ Entity* StateMemory::get_entity(uint32_t uid) const
 
     const uint32_t mask = uid_to_entity_mask;
     const uint32_t target_uid_plus_one = lowbias32(uid + 1);
-    uint32_t cur_index = target_uid_plus_one & mask;
-    while (true)
+    if (Entity* cached = g_uid_slot_cache.find(uid_to_entity_data, mask, uid, target_uid_plus_one))
+    {
+        return cached;
+    }
+
+    const uint32_t index = probe_uid_table(uid_to_entity_data, mask, target_uid_plus_one);
+    if (index == ~0u)
     {
-        auto entry = uid_to_entity_data[cur_index];
-        if (entry.uid_plus_one == target_uid_plus_one)
+        return nullptr;
+    }
+    g_uid_slot_cache.insert(uid_to_entity_data, mask, uid, target_uid_plus_one, index);
+    return uid_to_entity_data[index].entity;
+}
+
+std::vector<Entity*> StateMemory::get_entities(const std::vector<uint32_t>& uids) const
+{
+    // How far ahead of the probe the prefetches run, enough to hide a cache miss behind the probes in between
+    constexpr size_t PREFETCH_DISTANCE = 8;
+
+    const uint32_t mask = uid_to_entity_mask;
+    const RobinHoodTableEntry* data = uid_to_entity_data;
+    std::vector<uint32_t> hashed(uids.size());
+    for (size_t i = 0; i < uids.size(); ++i)
+    {
+        hashed[i] = lowbias32(uids[i] + 1);
+        if (i < PREFETCH_DISTANCE)
         {
-            return entry.entity;
+            _mm_prefetch(reinterpret_cast<const char*>(&data[hashed[i] & mask]), _MM_HINT_T0);
         }
+    }
 
-        if (entry.uid_plus_one == 0)
+    std::vector<Entity*> entities(uids.size(), nullptr);
+    for (size_t i = 0; i < uids.size(); ++i)
+    {
+        if (i + PREFETCH_DISTANCE < uids.size())
         {
-            return nullptr;
+            _mm_prefetch(reinterpret_cast<const char*>(&data[hashed[i + PREFETCH_DISTANCE] & mask]), _MM_HINT_T0);
         }
 
-        if (((cur_index - target_uid_plus_one) & mask) > ((cur_index - entry.uid_plus_one) & mask))
+        if (uids[i] == ~0)
         {
-            return nullptr;
+            continue;
+        }
+        const uint32_t index = probe_uid_table(data, mask, hashed[i]);
+        if (index != ~0u)
+        {
+            entities[i] = data[index].entity;
         }
-
-        cur_index = (cur_index + (uint32_t)1) & mask;
     }
+    return entities;
 }
 
 LiquidPhysicsEngine* LiquidPhysics::get_correct_liquid_engine(ENT_TYPE liquid_type) const
@@ -533,35 +618,57 @@ void StateUpdate(StateMemory* s)
         return;
     }
     static const auto pa = bucket->pause_api;
-    auto block = pre_event(ON::PRE_UPDATE);
-    if ((!g_forward_blocked_events || !pa->last_instance) && pa->event(PAUSE_TYPE::PRE_UPDATE))
-        block = true;
+    bool block;
+    {
+        FramePhaseScope phase{FRAME_PHASE::PRE_UPDATE};
+        block = pre_event(ON::PRE_UPDATE);
+        if ((!g_forward_blocked_events || !pa->last_instance) && pa->event(PAUSE_TYPE::PRE_UPDATE))
+            block = true;
+    }
     if (!block)
     {
-        g_state_update_trampoline(s);
+        {
+            FramePhaseScope phase{FRAME_PHASE::GAME_UPDATE};
+            static auto& liquid_budget = LiquidBudget::get();
+            liquid_budget.before_update(s);
+            const int64_t update_start = FrameTelemetry::now();
+            g_state_update_trampoline(s);
+            liquid_budget.after_update(s, FrameTelemetry::now() - update_start);
+        }
+        FramePhaseScope phase{FRAME_PHASE::LUA_CALLBACKS};
+        EntityDeltaTracker::get().update();
         post_event(ON::POST_UPDATE);
     }
     else
     {
-        post_event(ON::BLOCKED_UPDATE);
+        {
+            FramePhaseScope phase{FRAME_PHASE::LUA_CALLBACKS};
+            post_event(ON::BLOCKED_UPDATE);
+        }
         if (g_forward_blocked_events)
         {
+            FramePhaseScope phase{FRAME_PHASE::GAME_UPDATE};
             bucket->blocked_event = true;
             g_state_update_trampoline(s);
             bucket->blocked_event = false;
+            EntityDeltaTracker::get().update();
         }
     }
+    FramePhaseScope phase{FRAME_PHASE::LUA_CALLBACKS};
     update_backends();
+    // The callbacks cleared during the update have been swept by now, and none of the hooked functions can be on the stack
+    update_demand_hooks();
+    StateFeed::get().publish(s, static_cast<uint32_t>(global_update_count));
+    EntityStream::update_all();
 }
 
 void init_state_update_hook()
 {
     g_state_update_trampoline = (OnStateUpdate*)get_address("state_refresh");
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
+    hook_transaction_begin();
     DetourAttach((void**)&g_state_update_trampoline, &StateUpdate);
 
-    const LONG error = DetourTransactionCommit();
+    const LONG error = hook_transaction_commit();
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking state_refresh stuff: {}\n", error);
@@ -575,6 +682,12 @@ void ProcessInput(void* s)
     static bool had_focus;
     static const auto bucket = Bucket::get();
     static const auto gm = get_game_manager();
+    static auto& replay = InputReplay::get();
+    static const auto& turbo = Turbo::get();
+    if (!bucket->blocked_event && !turbo.is_enabled())
+        wait_for_next_frame();
+    LuaIdleScheduler::get().frame_started();
+    InputSnapshots::get().capture(global_update_count);
     if (bucket->blocked_event)
     {
         pre_event(ON::PRE_PROCESS_INPUT);
@@ -590,6 +703,7 @@ void ProcessInput(void* s)
     if (!block || (gm->game_props->game_has_focus && !had_focus))
     {
         g_process_input_trampoline(s);
+        replay.on_process_input(HeapBase::get().state());
         post_event(ON::POST_PROCESS_INPUT);
     }
     else
@@ -610,11 +724,10 @@ void ProcessInput(void* s)
 void init_process_input_hook()
 {
     g_process_input_trampoline = (OnProcessInput*)get_address("process_input");
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
+    hook_transaction_begin();
     DetourAttach((void**)&g_process_input_trampoline, &ProcessInput);
 
-    const LONG error = DetourTransactionCommit();
+    const LONG error = hook_transaction_commit();
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking process_input stuff: {}\n", error);
@@ -623,7 +736,7 @@ void init_process_input_hook()
 
 using OnGameLoop = void(void* a, float b, void* c);
 OnGameLoop* g_game_loop_trampoline{nullptr};
-void GameLoop(void* a, float b, void* c)
+void run_game_loop(void* a, float b, void* c)
 {
     static const auto bucket = Bucket::get();
     static const auto pa = bucket->pause_api;
@@ -664,15 +777,20 @@ void GameLoop(void* a, float b, void* c)
     if (!g_forward_blocked_events || !pa->last_instance)
         pa->post_loop();
 }
+void GameLoop(void* a, float b, void* c)
+{
+    static auto& turbo = Turbo::get();
+    turbo.run_frame([=]()
+                    { run_game_loop(a, b, c); });
+}
 
 void init_game_loop_hook()
 {
     g_game_loop_trampoline = (OnGameLoop*)get_address("game_loop");
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
+    hook_transaction_begin();
     DetourAttach((void**)&g_game_loop_trampoline, &GameLoop);
 
-    const LONG error = DetourTransactionCommit();
+    const LONG error = hook_transaction_commit();
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking game_loop stuff: {}\n", error);
@@ -905,6 +1023,7 @@ Logic* LogicList::start_logic(LOGIC idx)
     }
     static auto first_table_entry = get_address("virtual_functions_table");
 
+    GameHeapTag tag{"logic"};
     auto addr = (size_t*)custom_malloc(size);
     std::memset(addr, 0, size); // just in case
 
@@ -975,17 +1094,20 @@ void API::init(SoundManager* sound_manager)
 
         if (get_do_hooks())
         {
-            HeapBase::get_main().level_gen()->init();
-            init_spawn_hooks();
-            init_behavior_hooks();
-            init_render_api_hooks();
-            init_achievement_hooks();
-            hook_godmode_functions();
-            strings_init();
-            init_state_update_hook();
-            init_process_input_hook();
-            init_game_loop_hook();
-            init_heap_clone_hook();
+            {
+                // All of these go in with one transaction, so the game is never running with only some of the hooks
+                DetourTransaction hooks;
+                HeapBase::get_main().level_gen()->init();
+                init_spawn_hooks();
+                init_behavior_hooks();
+                init_render_api_hooks();
+                enable_demand_hooks();
+                strings_init();
+                init_state_update_hook();
+                init_process_input_hook();
+                init_game_loop_hook();
+                init_heap_clone_hook();
+            }
 
             auto bucket = Bucket::get();
             bucket->count++;
@@ -994,6 +1116,7 @@ void API::init(SoundManager* sound_manager)
                 bucket->patches_applied = true;
                 bucket->forward_blocked_events = true;
                 DEBUG("Applying patches");
+                PatchTransaction transaction;
                 patch_tiamat_kill_crash();
                 patch_orbs_limit();
                 patch_olmec_kill_crash();
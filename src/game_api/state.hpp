@@ -8,6 +8,7 @@
 
 #include "aliases.hpp"                  // for ENT_TYPE, LAYER
 #include "containers/custom_vector.hpp" //
+#include "heap_base.hpp"                // for HeapBase
 #include "memory.hpp"                   // for memory_read
 #include "state_structs.hpp"            // for JournalProgressStickerSlot, ...
 
@@ -339,6 +340,8 @@ struct StateMemory
     }
     void warp(uint8_t set_world, uint8_t set_level, uint8_t set_theme);
     Entity* get_entity(uint32_t uid) const;
+    // Same as calling get_entity for each uid, but the table slots of the whole list are prefetched before they are probed
+    std::vector<Entity*> get_entities(const std::vector<uint32_t>& uids) const;
     void set_seed(uint32_t set_seed);
     std::vector<Player*> get_players();
 };
@@ -347,6 +350,26 @@ struct StateMemory
 StateMemory* get_state_ptr();
 void update_state();
 
+// Looks up the state of the calling thread once, hold one over a batch of entity lookups instead of going through get_state_ptr or get_entity_ptr for each
+struct StateScope
+{
+    StateScope()
+        : state{HeapBase::get().state()}
+    {
+    }
+
+    StateMemory* operator->() const
+    {
+        return state;
+    }
+    Entity* get_entity(uint32_t uid) const
+    {
+        return state->get_entity(uid);
+    }
+
+    StateMemory* const state;
+};
+
 namespace API
 {
 void init(SoundManager* sound_manager = nullptr);
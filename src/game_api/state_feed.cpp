@@ -0,0 +1,118 @@
+#include "state_feed.hpp"
+
+#include <Windows.h> // for CreateFileMappingA, MapViewOfFile, FILE_MAP_ALL_ACCESS
+#include <cstddef>   // for offsetof
+#include <cstring>   // for memcpy
+#include <utility>   // for move
+
+#include "entities_chars.hpp" // for Player
+#include "entity.hpp"         // for Entity, get_entity_ptr
+#include "entity_lookup.hpp"  // for get_entities_by
+#include "items.hpp"          // for Inventory
+#include "logger.h"           // for DEBUG
+#include "movable.hpp"        // for Movable
+#include "state.hpp"          // for StateMemory
+
+StateFeed& StateFeed::get()
+{
+    static StateFeed feed;
+    return feed;
+}
+
+bool StateFeed::set_enabled(bool enable)
+{
+    if (enable && header == nullptr)
+    {
+        HANDLE file_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(StateFeedLayout::Header), StateFeedLayout::STATE_FEED_NAME);
+        if (file_mapping == nullptr)
+        {
+            DEBUG("Failed creating the state feed: {}\n", GetLastError());
+            return false;
+        }
+        void* view = MapViewOfFile(file_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StateFeedLayout::Header));
+        if (view == nullptr)
+        {
+            DEBUG("Failed mapping the state feed: {}\n", GetLastError());
+            CloseHandle(file_mapping);
+            return false;
+        }
+        mapping = file_mapping;
+        header = static_cast<StateFeedLayout::Header*>(view);
+        // Fresh mappings are zeroed, which leaves both sequences even and the frames empty
+        header->magic = StateFeedLayout::MAGIC;
+        header->version = StateFeedLayout::VERSION;
+        header->frame_size = sizeof(StateFeedLayout::Frame);
+    }
+    enabled.store(enable, std::memory_order_relaxed);
+    return true;
+}
+
+void StateFeed::set_entity_types(std::vector<ENT_TYPE> entity_types)
+{
+    std::lock_guard lock{types_lock};
+    types = std::move(entity_types);
+}
+
+void StateFeed::publish(StateMemory* state, uint32_t update)
+{
+    if (!enabled.load(std::memory_order_relaxed) || header == nullptr)
+        return;
+
+    frame.update = update;
+    frame.screen = state->screen;
+    frame.time_total = state->time_total;
+    frame.time_level = state->time_level;
+    frame.world = state->world;
+    frame.level = state->level;
+    frame.theme = state->theme;
+    frame.level_count = state->level_count;
+
+    frame.player_count = 0;
+    for (Player* player : state->get_players())
+    {
+        if (frame.player_count == StateFeedLayout::MAX_PLAYERS)
+            break;
+        const auto [x, y] = player->abs_position();
+        const Inventory* inventory = player->inventory_ptr;
+        frame.players[frame.player_count++] = {
+            player->uid,
+            player->type->id,
+            x,
+            y,
+            inventory != nullptr ? inventory->money : 0,
+            player->health,
+            inventory != nullptr ? inventory->bombs : uint8_t{0},
+            inventory != nullptr ? inventory->ropes : uint8_t{0},
+            player->layer,
+        };
+    }
+
+    frame.entity_count = 0;
+    {
+        std::lock_guard lock{types_lock};
+        if (!types.empty())
+        {
+            const std::vector<uint32_t> uids = get_entities_by(types, ENTITY_MASK::ANY, LAYER::BOTH);
+            const std::vector<Entity*> entities = state->get_entities(uids);
+            for (size_t i = 0; i < entities.size() && frame.entity_count < StateFeedLayout::MAX_ENTITIES; ++i)
+            {
+                Entity* entity = entities[i];
+                if (entity == nullptr)
+                    continue;
+                const auto [x, y] = entity->abs_position();
+                frame.entities[frame.entity_count++] = {static_cast<int32_t>(uids[i]), entity->type->id, x, y, entity->layer, {}};
+            }
+        }
+    }
+
+    // Only the used part of the entity list is copied, readers don't look past entity_count
+    const size_t size = offsetof(StateFeedLayout::Frame, entities) + frame.entity_count * sizeof(StateFeedLayout::Entity);
+    const uint32_t next = header->latest.load(std::memory_order_relaxed) ^ 1;
+    StateFeedLayout::Buffer& buffer = header->buffers[next];
+    const uint32_t sequence = buffer.sequence.load(std::memory_order_relaxed);
+    buffer.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&buffer.frame, &frame, size);
+    buffer.sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(next, std::memory_order_release);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>  // for atomic
+#include <cstdint> // for uint32_t, int32_t, uint8_t
+#include <mutex>   // for mutex
+#include <vector>  // for vector
+
+#include "aliases.hpp" // for ENT_TYPE
+
+struct StateMemory;
+
+// Layout of the shared memory the StateFeed publishes, external tools open STATE_FEED_NAME with OpenFileMappingA and map it read only
+// To read a frame: load `latest`, load that buffer's `sequence` and try again if it's odd, copy the frame, then load the sequence
+// again and try again if it changed. The buffer that was just written is left alone for a whole frame, so copies rarely have to retry
+namespace StateFeedLayout
+{
+constexpr const char* STATE_FEED_NAME = "Local\\OverlunkyStateFeed";
+// "OLSF"
+constexpr uint32_t MAGIC = 0x46534C4F;
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t MAX_PLAYERS = 4;
+constexpr uint32_t MAX_ENTITIES = 1024;
+
+struct Player
+{
+    int32_t uid;
+    ENT_TYPE type;
+    float x;
+    float y;
+    int32_t money;
+    uint8_t health;
+    uint8_t bombs;
+    uint8_t ropes;
+    uint8_t layer;
+};
+static_assert(sizeof(Player) == 24);
+
+struct Entity
+{
+    int32_t uid;
+    ENT_TYPE type;
+    float x;
+    float y;
+    uint8_t layer;
+    uint8_t padding[3];
+};
+static_assert(sizeof(Entity) == 20);
+
+struct Frame
+{
+    // Counts StateUpdate calls, same as get_global_update_count
+    uint32_t update;
+    uint32_t screen;
+    uint32_t time_total;
+    uint32_t time_level;
+    uint8_t world;
+    uint8_t level;
+    uint8_t theme;
+    uint8_t level_count;
+    uint32_t player_count;
+    Player players[MAX_PLAYERS];
+    // Entities of the types set with set_entity_types, in the order get_entities_by returns them, cut off at MAX_ENTITIES
+    uint32_t entity_count;
+    Entity entities[MAX_ENTITIES];
+};
+
+struct Buffer
+{
+    // Odd while the frame is written
+    std::atomic<uint32_t> sequence;
+    uint32_t padding;
+    Frame frame;
+};
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    // sizeof(Frame), so tools can tell they were built against the same layout
+    uint32_t frame_size;
+    // Index of the buffer that was written last
+    std::atomic<uint32_t> latest;
+    Buffer buffers[2];
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+} // namespace StateFeedLayout
+
+// Opt-in export of the game state for overlays and trackers in other processes, a snapshot is published to shared memory
+// after every StateUpdate so they don't have to ReadProcessMemory each field
+class StateFeed
+{
+  public:
+    static StateFeed& get();
+
+    // Creates the shared memory the first time it's enabled, disabling keeps it mapped but stops the updates
+    bool set_enabled(bool enable);
+    bool is_enabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    // Which entities are listed in every frame besides the players
+    void set_entity_types(std::vector<ENT_TYPE> entity_types);
+
+    // Called at the end of StateUpdate
+    void publish(StateMemory* state, uint32_t update);
+
+  private:
+    StateFeed() = default;
+
+    std::atomic<bool> enabled{false};
+    void* mapping{nullptr};
+    StateFeedLayout::Header* header{nullptr};
+    // Built here and copied in one go, so the sequence is odd for as short as possible
+    StateFeedLayout::Frame frame;
+    std::mutex types_lock;
+    std::vector<ENT_TYPE> types;
+};
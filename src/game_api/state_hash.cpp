@@ -0,0 +1,226 @@
+#include "state_hash.hpp"
+
+#include <algorithm> // for min
+#include <cstddef>   // for offsetof
+
+#include "crc32.hpp" // for crc32c_words
+#include "state.hpp" // for StateMemory
+
+namespace
+{
+constexpr size_t g_heap_size = 0x2000000;
+constexpr size_t g_chunk_words = STATE_HASH_CHUNK_SIZE / sizeof(uint64_t);
+
+struct HeapRegion
+{
+    size_t begin;
+    size_t end;
+    const char* name;
+};
+
+struct StateField
+{
+    size_t offset;
+    size_t size;
+    const char* name;
+};
+#define STATE_FIELD(field) StateField{offsetof(StateMemory, field), sizeof(StateMemory::field), #field}
+const StateField g_state_fields[]{
+    STATE_FIELD(screen_last),
+    STATE_FIELD(screen),
+    STATE_FIELD(screen_next),
+    STATE_FIELD(loading),
+    STATE_FIELD(illumination),
+    STATE_FIELD(fade_value),
+    STATE_FIELD(fade_timer),
+    STATE_FIELD(pause),
+    STATE_FIELD(quest_flags),
+    STATE_FIELD(correct_ushabti),
+    STATE_FIELD(speedrun_character),
+    STATE_FIELD(w),
+    STATE_FIELD(h),
+    STATE_FIELD(kali_favor),
+    STATE_FIELD(kali_status),
+    STATE_FIELD(outposts_spawned),
+    STATE_FIELD(money_shop_total),
+    STATE_FIELD(world_start),
+    STATE_FIELD(level_start),
+    STATE_FIELD(theme_start),
+    STATE_FIELD(seed),
+    STATE_FIELD(time_total),
+    STATE_FIELD(world),
+    STATE_FIELD(world_next),
+    STATE_FIELD(level),
+    STATE_FIELD(level_next),
+    STATE_FIELD(current_theme),
+    STATE_FIELD(theme),
+    STATE_FIELD(theme_next),
+    STATE_FIELD(win_state),
+    STATE_FIELD(end_spaceship_character),
+    STATE_FIELD(shoppie_aggro),
+    STATE_FIELD(shoppie_aggro_levels),
+    STATE_FIELD(merchant_aggro),
+    STATE_FIELD(saved_dogs),
+    STATE_FIELD(saved_cats),
+    STATE_FIELD(saved_hamsters),
+    STATE_FIELD(kills_npc),
+    STATE_FIELD(level_count),
+    STATE_FIELD(damage_taken),
+    STATE_FIELD(waddler_storage),
+    STATE_FIELD(waddler_storage_meta),
+    STATE_FIELD(journal_progress_sticker_slots),
+    STATE_FIELD(journal_progress_stain_slots),
+    STATE_FIELD(journal_progress_theme_slots),
+    STATE_FIELD(arena),
+    STATE_FIELD(journal_flags),
+    STATE_FIELD(first_damage_cause),
+    STATE_FIELD(time_last_level),
+    STATE_FIELD(time_level),
+    STATE_FIELD(time_speedrun),
+    STATE_FIELD(money_last_levels),
+    STATE_FIELD(level_flags),
+    STATE_FIELD(presence_flags),
+    STATE_FIELD(coffin_contents),
+    STATE_FIELD(cause_of_death),
+    STATE_FIELD(cause_of_death_entity_type),
+    STATE_FIELD(waddler_floor_storage),
+    STATE_FIELD(toast),
+    STATE_FIELD(speechbubble),
+    STATE_FIELD(speechbubble_timer),
+    STATE_FIELD(toast_timer),
+    STATE_FIELD(speechbubble_owner),
+    STATE_FIELD(basecamp_dialogue),
+    STATE_FIELD(screen_character_select),
+    STATE_FIELD(screen_level),
+    STATE_FIELD(next_entity_uid),
+    STATE_FIELD(screen_change_counter),
+    STATE_FIELD(player_inputs),
+    STATE_FIELD(items),
+    STATE_FIELD(level_gen),
+    STATE_FIELD(layers),
+    STATE_FIELD(logic),
+    STATE_FIELD(quests),
+    STATE_FIELD(ai_targets),
+    STATE_FIELD(liquid_physics),
+    STATE_FIELD(particle_emitters),
+    STATE_FIELD(lightsources),
+    STATE_FIELD(entity_lookup),
+    STATE_FIELD(uid_to_entity_mask),
+    STATE_FIELD(uid_to_entity_data),
+    STATE_FIELD(entities_switching_layer),
+    STATE_FIELD(layer_transition_timer),
+    STATE_FIELD(transition_to_layer),
+    STATE_FIELD(room_owners),
+    STATE_FIELD(time_startup),
+    STATE_FIELD(special_visibility_flags),
+    STATE_FIELD(camera),
+};
+#undef STATE_FIELD
+
+auto relative_pointers(uintptr_t base)
+{
+    // Same check as HeapBase::copy_to
+    return [base](uint64_t value) -> uint64_t
+    {
+        return value >= base + g_heap_size || value <= base ? value : value - base;
+    };
+}
+} // namespace
+
+StateDiffChunk StateHash::describe_chunk(uint32_t chunk, size_t offset)
+{
+    // Anything else on the heap is from the game's allocator, mostly entities
+    static constexpr HeapRegion g_regions[]{
+        {0, HeapBase::FRAME_COUNTER, "heap header"},
+        {HeapBase::FRAME_COUNTER, HeapBase::_PRNG, "frame counter"},
+        {HeapBase::_PRNG, HeapBase::STATE, "PRNG"},
+        {HeapBase::STATE, HeapBase::STATE + sizeof(StateMemory), "StateMemory"},
+        {HeapBase::LEVEL_GEN, HeapBase::LIQUID_ENGINE, "LevelGenSystem"},
+        {HeapBase::LIQUID_ENGINE, HeapBase::UNKNOWN3, "LiquidPhysics"},
+    };
+
+    StateDiffChunk diff{chunk, static_cast<uint32_t>(offset), "heap", {}};
+    for (const HeapRegion& region : g_regions)
+    {
+        if (offset >= region.begin && offset < region.end)
+        {
+            diff.region = region.name;
+            break;
+        }
+    }
+    const size_t chunk_begin = chunk * STATE_HASH_CHUNK_SIZE;
+    const size_t chunk_end = chunk_begin + STATE_HASH_CHUNK_SIZE;
+    for (const StateField& field : g_state_fields)
+    {
+        const size_t field_begin = HeapBase::STATE + field.offset;
+        if (field_begin < chunk_end && field_begin + field.size > chunk_begin)
+            diff.fields.push_back(field.name);
+    }
+    return diff;
+}
+
+std::vector<uint32_t> StateHash::hash_chunks(HeapBase heap)
+{
+    if (heap.is_null())
+        return {};
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(heap.address());
+    const auto transform = relative_pointers(heap.address());
+    std::vector<uint32_t> hashes(STATE_HASH_CHUNKS);
+    for (uint32_t chunk = 0; chunk < STATE_HASH_CHUNKS; ++chunk)
+        hashes[chunk] = ~crc32c_words(0xffffffff, words + chunk * g_chunk_words, g_chunk_words, transform);
+    return hashes;
+}
+
+uint32_t StateHash::hash(HeapBase heap, const std::vector<uint32_t>* chunks)
+{
+    if (heap.is_null())
+        return 0;
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(heap.address());
+    const auto transform = relative_pointers(heap.address());
+    if (chunks == nullptr)
+        return ~crc32c_words(0xffffffff, words, g_heap_size / sizeof(uint64_t), transform);
+
+    uint32_t crc = 0xffffffff;
+    for (const uint32_t chunk : *chunks)
+    {
+        if (chunk < STATE_HASH_CHUNKS)
+            crc = crc32c_words(crc, words + chunk * g_chunk_words, g_chunk_words, transform);
+    }
+    return ~crc;
+}
+
+std::vector<StateDiffChunk> StateHash::diff(HeapBase heap, HeapBase other)
+{
+    std::vector<StateDiffChunk> diffs;
+    if (heap.is_null() || other.is_null())
+        return diffs;
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(heap.address());
+    const uint64_t* other_words = reinterpret_cast<const uint64_t*>(other.address());
+    const auto transform = relative_pointers(heap.address());
+    const auto other_transform = relative_pointers(other.address());
+    for (uint32_t chunk = 0; chunk < STATE_HASH_CHUNKS; ++chunk)
+    {
+        const size_t begin = chunk * g_chunk_words;
+        for (size_t i = begin; i < begin + g_chunk_words; ++i)
+        {
+            if (transform(words[i]) != other_transform(other_words[i]))
+            {
+                diffs.push_back(describe_chunk(chunk, i * sizeof(uint64_t)));
+                break;
+            }
+        }
+    }
+    return diffs;
+}
+
+std::vector<StateDiffChunk> StateHash::diff_hashes(const std::vector<uint32_t>& hashes, const std::vector<uint32_t>& other_hashes)
+{
+    std::vector<StateDiffChunk> diffs;
+    const size_t count = std::min(hashes.size(), other_hashes.size());
+    for (uint32_t chunk = 0; chunk < count; ++chunk)
+    {
+        if (hashes[chunk] != other_hashes[chunk])
+            diffs.push_back(describe_chunk(chunk, chunk * STATE_HASH_CHUNK_SIZE));
+    }
+    return diffs;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint> // for uint32_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+#include "heap_base.hpp" // for HeapBase
+
+/// A part of the state heap that differs between two states
+struct StateDiffChunk
+{
+    /// Index of the chunk, 4KiB each, in the order of `SaveState:hash_chunks`
+    uint32_t chunk;
+    /// Offset in bytes from the start of the heap to the first difference in the chunk, or to the chunk if only hashes were compared
+    uint32_t offset;
+    /// Known part of the heap the offset is in, e.g. `StateMemory`, `PRNG` or `LevelGenSystem`
+    std::string region;
+    /// Fields of StateMemory overlapping the chunk, empty outside of StateMemory
+    std::vector<std::string> fields;
+};
+
+constexpr size_t STATE_HASH_CHUNK_SIZE = 0x1000;
+constexpr uint32_t STATE_HASH_CHUNKS = static_cast<uint32_t>(0x2000000 / STATE_HASH_CHUNK_SIZE);
+
+// Pointers into the heap are hashed relative to it, so copies of a state at other addresses hash the same
+// Pointers out of it, like vtables, are hashed as they are, so only processes with the game at the same address can compare hashes
+struct StateHash
+{
+    static std::vector<uint32_t> hash_chunks(HeapBase heap);
+    // Combined hash of either all chunks or only the ones listed
+    static uint32_t hash(HeapBase heap, const std::vector<uint32_t>* chunks);
+    static std::vector<StateDiffChunk> diff(HeapBase heap, HeapBase other);
+    // Compares two lists of chunk hashes, e.g. the own one and one sent by a peer
+    static std::vector<StateDiffChunk> diff_hashes(const std::vector<uint32_t>& hashes, const std::vector<uint32_t>& other_hashes);
+
+  private:
+    static StateDiffChunk describe_chunk(uint32_t chunk, size_t offset);
+};
@@ -0,0 +1,155 @@
+#include "state_tree.hpp"
+
+#include <algorithm> // for reverse
+#include <utility>   // for move
+
+#include "heap_base.hpp"     // for HeapBase
+#include "state.hpp"         // for StateMemory, update_state
+#include "state_structs.hpp" // for PlayerInputs, PlayerSlot
+
+StateTree::StateTree(uint32_t max_states)
+    : pool(max_states)
+{
+}
+
+int64_t StateTree::snapshot()
+{
+    const int64_t id = next_id++;
+    pool.save(id, true);
+    nodes[id] = Node{std::nullopt, 0, 0.0, {}, {}};
+    return id;
+}
+
+std::optional<int64_t> StateTree::branch(int64_t from, uint32_t frames, std::vector<INPUTS> inputs)
+{
+    auto parent = nodes.find(from);
+    if (parent == nodes.end() || !pool.load(from, true))
+        return std::nullopt;
+
+    // One entry per simulated frame, so the inputs of a path can be replayed as they are
+    const INPUTS last = inputs.empty() ? 0 : inputs.back();
+    inputs.resize(frames, last);
+
+    StateMemory* state = HeapBase::get().state();
+    for (uint32_t i = 0; i < frames; ++i)
+    {
+        auto& slot = state->player_inputs->player_slots[0];
+        slot.buttons_gameplay = inputs[i];
+        slot.buttons = inputs[i];
+        update_state();
+    }
+
+    const int64_t id = next_id++;
+    pool.save(id, true);
+    const double score = scorer ? scorer(state) : 0.0;
+    // The scorer may have removed nodes, the parent included
+    parent = nodes.find(from);
+    const uint32_t depth = parent != nodes.end() ? parent->second.depth + frames : frames;
+    if (parent != nodes.end())
+        parent->second.children.push_back(id);
+    nodes[id] = Node{parent != nodes.end() ? std::optional{from} : std::nullopt, depth, score, std::move(inputs), {}};
+    return id;
+}
+
+bool StateTree::restore(int64_t node)
+{
+    return nodes.contains(node) && pool.load(node, true);
+}
+
+void StateTree::set_scorer(StateScorer new_scorer)
+{
+    scorer = std::move(new_scorer);
+}
+
+const StateTree::Node* StateTree::find(int64_t node) const
+{
+    auto it = nodes.find(node);
+    return it != nodes.end() ? &it->second : nullptr;
+}
+
+bool StateTree::has_state(int64_t node) const
+{
+    return nodes.contains(node) && pool.has(node);
+}
+
+std::optional<double> StateTree::get_score(int64_t node) const
+{
+    if (const Node* found = find(node))
+        return found->score;
+    return std::nullopt;
+}
+
+std::optional<int64_t> StateTree::get_parent(int64_t node) const
+{
+    if (const Node* found = find(node))
+        return found->parent;
+    return std::nullopt;
+}
+
+std::optional<uint32_t> StateTree::get_depth(int64_t node) const
+{
+    if (const Node* found = find(node))
+        return found->depth;
+    return std::nullopt;
+}
+
+std::vector<INPUTS> StateTree::get_inputs(int64_t node) const
+{
+    std::vector<const Node*> path;
+    for (const Node* found = find(node); found != nullptr; found = found->parent ? find(found->parent.value()) : nullptr)
+        path.push_back(found);
+    std::reverse(path.begin(), path.end());
+
+    std::vector<INPUTS> inputs;
+    for (const Node* found : path)
+        inputs.insert(inputs.end(), found->inputs.begin(), found->inputs.end());
+    return inputs;
+}
+
+std::optional<int64_t> StateTree::best(std::optional<uint32_t> min_depth) const
+{
+    std::optional<int64_t> best_node;
+    double best_score = 0.0;
+    for (const auto& [id, node] : nodes)
+    {
+        if (node.depth < min_depth.value_or(0) || !pool.has(id))
+            continue;
+        if (!best_node.has_value() || node.score > best_score)
+        {
+            best_node = id;
+            best_score = node.score;
+        }
+    }
+    return best_node;
+}
+
+void StateTree::remove(int64_t node)
+{
+    auto it = nodes.find(node);
+    if (it == nodes.end())
+        return;
+
+    if (it->second.parent.has_value())
+    {
+        if (auto parent = nodes.find(it->second.parent.value()); parent != nodes.end())
+            std::erase(parent->second.children, node);
+    }
+    std::vector<int64_t> pending{node};
+    while (!pending.empty())
+    {
+        const int64_t id = pending.back();
+        pending.pop_back();
+        if (auto found = nodes.find(id); found != nodes.end())
+        {
+            pending.insert(pending.end(), found->second.children.begin(), found->second.children.end());
+            nodes.erase(found);
+        }
+        pool.remove(id);
+    }
+}
+
+void StateTree::clear()
+{
+    nodes.clear();
+    pool.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>       // for int64_t, uint32_t
+#include <functional>    // for function
+#include <optional>      // for optional
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+
+#include "aliases.hpp"   // for INPUTS
+#include "savestate.hpp" // for SaveStatePool
+
+struct StateMemory;
+
+using StateScorer = std::function<double(StateMemory*)>;
+
+class StateTree
+{
+  public:
+    /// Create a tree of states for bots that explore by branching, each node is a state reached by simulating frames with some inputs from its parent.
+    /// The states are kept in a SaveStatePool of `max_states` and saved and loaded incrementally, so branching off a recent node only copies what changed. Nodes whose state got reused are kept, they just can't be branched from or restored anymore.
+    StateTree(uint32_t max_states);
+
+    /// Add the current state as a new root node, returns its id
+    int64_t snapshot();
+    /// Load the node `from`, simulate `frames` updates with player 1 pressing `inputs[i]` on the i-th frame (the last one repeats if there are fewer) and add the result as a child node, scored with the scorer.
+    /// The game stays in the new state. Returns the id of the new node or nil if `from` is gone.
+    std::optional<int64_t> branch(int64_t from, uint32_t frames, std::vector<INPUTS> inputs);
+    /// Load the state of a node, returns false if it's gone
+    bool restore(int64_t node);
+    /// Set the function that scores the state of new nodes, called with the StateMemory right after simulating, higher is better. Clear it to score everything 0
+    void set_scorer(StateScorer new_scorer);
+
+    /// Check if the state of a node is still there to branch from or restore
+    bool has_state(int64_t node) const;
+    /// Get the score of a node
+    std::optional<double> get_score(int64_t node) const;
+    /// Get the parent of a node, nil for root nodes
+    std::optional<int64_t> get_parent(int64_t node) const;
+    /// Get the frames simulated from the root to the node
+    std::optional<uint32_t> get_depth(int64_t node) const;
+    /// Get the inputs from the root to the node, one per frame, to replay the branch
+    std::vector<INPUTS> get_inputs(int64_t node) const;
+    /// Get the node with the highest score that still has its state, optionally only among the nodes at least `min_depth` frames deep
+    std::optional<int64_t> best(std::optional<uint32_t> min_depth) const;
+    /// Remove a node and all of its children
+    void remove(int64_t node);
+    /// Remove all the nodes and free the states
+    void clear();
+    /// Get the amount of nodes
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(nodes.size());
+    }
+
+  private:
+    struct Node
+    {
+        std::optional<int64_t> parent;
+        uint32_t depth;
+        double score;
+        // Only the frames from the parent to this node
+        std::vector<INPUTS> inputs;
+        std::vector<int64_t> children;
+    };
+
+    SaveStatePool pool;
+    std::unordered_map<int64_t, Node> nodes;
+    int64_t next_id{0};
+    StateScorer scorer;
+
+    const Node* find(int64_t node) const;
+};
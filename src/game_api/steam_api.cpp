@@ -1,10 +1,11 @@
 #include "steam_api.hpp"
 
-#include <array>     // for array, _Array_const_iterator
-#include <detours.h> // for DetourAttach, DetourTransactionBegin
+#include <array> // for array, _Array_const_iterator
 
-#include "memory.hpp" // for vtable_find
+#include "demand_hook.hpp" // for DemandHook
+#include "memory.hpp"      // for vtable_find
 #include "script/events.hpp"
+#include "script/lua_backend.hpp" // for LuaBackend, BackendEvent
 #include "search.hpp" // for get_address
 #include "strings.hpp"
 #include "vtable_hook.hpp" // for get_hook_function, register_hook_function
@@ -166,26 +167,20 @@ void change_feat(FEAT feat, bool hidden, std::u16string_view name, std::u16strin
     set_feat_hidden(feat + 1, hidden);
 }
 
-void init_achievement_hooks()
-{
-    static bool hooked = false;
-    if (!hooked)
-    {
-        g_get_feat_trampoline = (GetFeatFun*)get_address("get_feat"sv);
-        g_set_feat_trampoline = (SetFeatFun*)get_address("set_feat"sv);
-
-        DetourTransactionBegin();
-        DetourUpdateThread(GetCurrentThread());
-
-        DetourAttach((void**)&g_get_feat_trampoline, &feat_unlocked);
-        DetourAttach((void**)&g_set_feat_trampoline, &unlock_feat);
-
-        const LONG error = DetourTransactionCommit();
-        if (error != NO_ERROR)
-        {
-            DEBUG("Failed hooking feats: {}\n", error);
-        }
-
-        hooked = true;
-    }
-}
+// The game checks feats all the time, so these are only hooked while a script has a callback for them
+DemandHook g_get_feat_hook{
+    "get_feat",
+    []()
+    { g_get_feat_trampoline = (GetFeatFun*)get_address("get_feat"sv); },
+    {{(void**)&g_get_feat_trampoline, (void*)&feat_unlocked}},
+    []()
+    { return LuaBackend::has_subscribers(BackendEvent::PRE_GET_FEAT); },
+};
+DemandHook g_set_feat_hook{
+    "set_feat",
+    []()
+    { g_set_feat_trampoline = (SetFeatFun*)get_address("set_feat"sv); },
+    {{(void**)&g_set_feat_trampoline, (void*)&unlock_feat}},
+    []()
+    { return LuaBackend::has_subscribers(BackendEvent::PRE_SET_FEAT); },
+};
@@ -8,15 +8,17 @@
 #include <limits>        // for numeric_limits
 #include <list>          // for _List_iterator, _List_const...
 #include <new>           // for operator new
+#include <optional>      // for optional
 #include <type_traits>   // for hash, move
 #include <unordered_map> // for unordered_map, _Umap_traits...
 #include <utility>       // for max, min, pair
 
 #include "bucket.hpp"                    // for Bucket
-#include "constants.hpp"                 //
 #include "containers/game_allocator.hpp" // for game_free, game_malloc
+#include "detour_transaction.hpp"        // for hook_transaction_begin, hook_transaction_commit
 #include "detours.h"                     // for DetourAttach, DetourTransac...
 #include "entity.hpp"                    // for get_type, Entity, EntityDB
+#include "game_heap_stats.hpp"           // for GameHeapTag
 #include "logger.h"                      // for DEBUG
 #include "memory.hpp"                    // for Memory
 #include "script/events.hpp"             // for pre_speach_bubble, pre_toast
@@ -25,6 +27,39 @@
 
 static STRINGID g_original_string_ids_end{std::numeric_limits<STRINGID>::max()};
 
+// Both indexes are built in strings_init, the pointer index is also rebuilt when the game reloads the table (e.g. on language change)
+static std::unordered_map<uint32_t, STRINGID> g_hash_to_stringid;
+static std::unordered_map<size_t, STRINGID> g_pointer_to_stringid;
+static std::pair<size_t, size_t> g_pointer_index_bounds{0, 0};
+
+static void build_hash_index()
+{
+    const auto& string_hashes{get_string_hashes()};
+    g_hash_to_stringid.clear();
+    g_hash_to_stringid.reserve(string_hashes.size());
+    for (size_t i = 0; i < string_hashes.size(); ++i)
+    {
+        // First entry wins on duplicate hashes, same as the linear search did
+        g_hash_to_stringid.emplace(string_hashes[i], (STRINGID)i);
+    }
+}
+static void build_pointer_index()
+{
+    auto strings_table = get_strings_table();
+    g_pointer_to_stringid.clear();
+    g_pointer_to_stringid.reserve(g_original_string_ids_end);
+    for (STRINGID i = 0; i < g_original_string_ids_end; ++i)
+    {
+        g_pointer_to_stringid.emplace((size_t)strings_table[i], i);
+    }
+    g_pointer_index_bounds = {(size_t)strings_table[0], (size_t)strings_table[g_original_string_ids_end - 1]};
+}
+static bool is_pointer_index_stale()
+{
+    auto strings_table = get_strings_table();
+    return g_pointer_to_stringid.empty() || g_pointer_index_bounds != std::pair{(size_t)strings_table[0], (size_t)strings_table[g_original_string_ids_end - 1]};
+}
+
 using OnShopItemNameFormatFun = void(Entity*, char16_t*);
 OnShopItemNameFormatFun* g_on_shopnameformat_trampoline{nullptr};
 void on_shopitemnameformat(Entity* item, char16_t* buffer)
@@ -52,48 +87,49 @@ void on_shopitemnameformat(Entity* item, char16_t* buffer)
     g_on_shopnameformat_trampoline(item, buffer);
 }
 
+// Replaced texts are handed to the game from here, the game copies them before the hooked functions return
+// It only grows, so once a mod's texts fit, replacing them doesn't allocate on the game's heap anymore
+// The game's own buffer is never written to, it can be an entry of the string table
+char16_t* replacement_buffer(const std::u16string& str)
+{
+    static char16_t* buffer{nullptr};
+    static size_t capacity{0};
+    if (str.size() + 1 > capacity)
+    {
+        GameHeapTag tag{"strings"};
+        game_free((void*)buffer);
+        capacity = std::max(str.size() + 1, capacity * 2);
+        buffer = (char16_t*)game_malloc(capacity * sizeof(char16_t));
+    }
+    memcpy(buffer, str.data(), str.size() * sizeof(char16_t));
+    buffer[str.size()] = u'\0';
+    return buffer;
+}
+
 using OnNPCDialogueFun = void(size_t, Entity*, char16_t*, int, bool);
 OnNPCDialogueFun* g_speach_bubble_trampoline{nullptr};
 void OnNPCDialogue(size_t hud, Entity* NPC, char16_t* buffer, int shoppie_sound_type, bool top)
 {
-    std::u16string str = pre_speach_bubble(NPC, buffer);
-    char16_t* new_string = nullptr;
-    if (str != no_return_str)
+    if (std::optional<std::u16string> str = pre_speach_bubble(NPC, buffer))
     {
-        if (str.empty())
+        if (str->empty())
             return;
-
-        const auto data_size = str.size() * sizeof(char16_t);
-        new_string = (char16_t*)game_malloc(data_size + sizeof(char16_t));
-        new_string[str.size()] = u'\0';
-        memcpy(new_string, str.data(), data_size);
-
-        buffer = new_string;
+        buffer = replacement_buffer(*str);
     }
     g_speach_bubble_trampoline(hud, NPC, buffer, shoppie_sound_type, top);
-    game_free((void*)new_string);
 }
 
 using OnToastFun = void(char16_t*);
 OnToastFun* g_toast_trampoline{nullptr};
 void OnToast(char16_t* buffer)
 {
-    std::u16string str = pre_toast(buffer);
-    char16_t* new_string = nullptr;
-    if (str != no_return_str)
+    if (std::optional<std::u16string> str = pre_toast(buffer))
     {
-        if (str.empty())
+        if (str->empty())
             return;
-
-        const auto data_size = str.size() * sizeof(char16_t);
-        new_string = (char16_t*)game_malloc(data_size + sizeof(char16_t));
-        new_string[str.size()] = u'\0';
-        memcpy(new_string, str.data(), data_size);
-
-        buffer = new_string;
+        buffer = replacement_buffer(*str);
     }
     g_toast_trampoline(buffer);
-    game_free((void*)new_string);
 }
 
 void strings_init()
@@ -103,6 +139,9 @@ void strings_init()
     if (bucket->next_stringid == 0)
         bucket->next_stringid = g_original_string_ids_end + 1;
 
+    build_hash_index();
+    build_pointer_index();
+
     auto addr_format_shopitem = Memory::get().at_exe(get_virtual_function_address(VTABLE_OFFSET::ITEM_PICKUP_ROPEPILE, 7));
     auto addr_npcdialogue = get_address("speech_bubble_fun");
     auto addr_toastfun = get_address("toast");
@@ -111,14 +150,13 @@ void strings_init()
     g_speach_bubble_trampoline = (OnNPCDialogueFun*)addr_npcdialogue;
     g_toast_trampoline = (OnToastFun*)addr_toastfun;
 
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
+    hook_transaction_begin();
 
     DetourAttach((void**)&g_on_shopnameformat_trampoline, &on_shopitemnameformat);
     DetourAttach((void**)&g_speach_bubble_trampoline, &OnNPCDialogue);
     DetourAttach((void**)&g_toast_trampoline, &OnToast);
 
-    const LONG error = DetourTransactionCommit();
+    const LONG error = hook_transaction_commit();
     if (error != NO_ERROR)
     {
         DEBUG("Failed hooking strings stuff: {}\n", error);
@@ -133,13 +171,10 @@ const char16_t** get_strings_table()
 
 STRINGID hash_to_stringid(uint32_t hash)
 {
-    const auto& string_hashes{get_string_hashes()};
-    for (auto& it : string_hashes)
-    {
-        if (it == hash)
-            return (STRINGID)(&it - &string_hashes[0]);
-    }
-    return g_original_string_ids_end;
+    if (g_hash_to_stringid.empty())
+        build_hash_index();
+    auto it = g_hash_to_stringid.find(hash);
+    return it != g_hash_to_stringid.end() ? it->second : g_original_string_ids_end;
 }
 
 const char16_t* get_string(STRINGID string_id)
@@ -162,13 +197,21 @@ const char16_t* get_string(STRINGID string_id)
 
 STRINGID pointer_to_stringid(size_t ptr)
 {
-    auto strings_table = get_strings_table();
-    for (STRINGID i = 0; i < g_original_string_ids_end; ++i)
+    if (g_original_string_ids_end == std::numeric_limits<STRINGID>::max())
+        return g_original_string_ids_end;
+
+    // A miss is only trusted if the table wasn't swapped out underneath the index
+    auto it = g_pointer_to_stringid.find(ptr);
+    if (it == g_pointer_to_stringid.end() || get_strings_table()[it->second] != (const char16_t*)ptr)
     {
-        if ((size_t)strings_table[i] == ptr)
-            return i;
+        if (!is_pointer_index_stale())
+            return g_original_string_ids_end;
+        build_pointer_index();
+        it = g_pointer_to_stringid.find(ptr);
+        if (it == g_pointer_to_stringid.end())
+            return g_original_string_ids_end;
     }
-    return g_original_string_ids_end;
+    return it->second;
 }
 
 void change_string(STRINGID string_id, std::u16string_view str)
@@ -190,12 +233,17 @@ void change_string(STRINGID string_id, std::u16string_view str)
         if (std::char_traits<char16_t>::length(*old_string) < str.length())
         {
             const auto data_size = str.size() * sizeof(char16_t);
+            GameHeapTag tag{"strings"};
             char16_t* new_string = (char16_t*)game_malloc(data_size + sizeof(char16_t));
             new_string[str.size()] = NULL;
             std::memcpy(new_string, str.data(), data_size);
 
+            g_pointer_to_stringid.erase((size_t)*old_string);
             game_free((void*)*old_string);
             *old_string = new_string;
+            g_pointer_to_stringid[(size_t)new_string] = string_id;
+            if (string_id == 0 || string_id == g_original_string_ids_end - 1)
+                g_pointer_index_bounds = {(size_t)get_strings_table()[0], (size_t)get_strings_table()[g_original_string_ids_end - 1]};
         }
         else
         {
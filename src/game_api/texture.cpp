@@ -1,5 +1,6 @@
 #include "texture.hpp"
 
+#include <algorithm>
 #include <cstddef> // IWYU pragma: keep
 #include <cstring>
 #include <functional>
@@ -7,13 +8,17 @@
 #include <mutex>
 #include <new>
 #include <type_traits>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "asset_preloader.hpp"
 #include "character_def.hpp"
 #include "memory.hpp"
 #include "render_api.hpp"
 #include "search.hpp"
+#include "util.hpp"
 
 Textures* get_textures()
 {
@@ -21,6 +26,58 @@ Textures* get_textures()
     return textures_ptr;
 }
 
+// Texture names by path for get_texture, both maps are guarded by RenderAPI::custom_textures_lock
+// Keys point at the names owned by the game, which stay alive for as long as the texture does
+struct TextureNameIndex
+{
+    std::unordered_map<std::string_view, std::vector<TEXTURE>> custom;
+    std::unordered_map<std::string_view, std::vector<Texture*>> vanilla;
+    bool vanilla_indexed{false};
+};
+
+std::string_view strip_vanilla_texture_path(std::string_view name)
+{
+    constexpr char c_VanillaTexturePath[]{"Data/Textures/../../"};
+    if (name.starts_with(c_VanillaTexturePath))
+    {
+        name.remove_prefix(sizeof(c_VanillaTexturePath) - 1);
+    }
+    return name;
+}
+
+TextureNameIndex& get_texture_name_index()
+{
+    static TextureNameIndex index;
+    if (!index.vanilla_indexed)
+    {
+        index.vanilla_indexed = true;
+        for (auto& texture : get_textures()->textures)
+        {
+            if (texture.name != nullptr)
+                index.vanilla[*texture.name].push_back(&texture);
+        }
+    }
+    return index;
+}
+
+void unindex_vanilla_texture(TextureNameIndex& index, Texture* texture)
+{
+    if (texture->name == nullptr)
+        return;
+    auto it = index.vanilla.find(*texture->name);
+    if (it != index.vanilla.end())
+    {
+        std::erase(it->second, texture);
+        if (it->second.empty())
+            index.vanilla.erase(it);
+    }
+}
+void index_vanilla_texture(TextureNameIndex& index, Texture* texture)
+{
+    if (texture->name != nullptr)
+        index.vanilla[*texture->name].push_back(texture);
+}
+
 TextureDefinition get_texture_definition(TEXTURE texture_id)
 {
     if (Texture* tex = get_texture(texture_id))
@@ -130,6 +187,7 @@ TEXTURE define_texture(TextureDefinition data)
     *new_texture_target = backup_texture;
 
     render.custom_textures[new_texture.id] = new_texture;
+    get_texture_name_index().custom[strip_vanilla_texture_path(*new_texture.name)].push_back(new_texture.id);
 
     return new_texture.id;
 }
@@ -170,95 +228,81 @@ std::optional<TEXTURE> get_texture(TextureDefinition data)
         return memcmp((char*)&lhs + compare_offset, (char*)&rhs + compare_offset, compare_size) == 0;
     };
 
-    std::lock_guard lock{render.custom_textures_lock};
-
-    for (auto& [id, texture] : render.custom_textures)
+    const Texture* found{nullptr};
     {
-        std::string_view existing_name{*texture.name};
-        constexpr char c_VanillaTexturePath[]{"Data/Textures/../../"};
-        if (existing_name.starts_with(c_VanillaTexturePath))
+        std::lock_guard lock{render.custom_textures_lock};
+        auto& index = get_texture_name_index();
+
+        if (auto it = index.custom.find(data.texture_path); it != index.custom.end())
         {
-            existing_name.remove_prefix(sizeof(c_VanillaTexturePath) - 1);
+            for (TEXTURE id : it->second)
+            {
+                const Texture& texture = render.custom_textures[id];
+                if (is_same(texture, new_texture))
+                {
+                    found = &texture;
+                    break;
+                }
+            }
         }
-        if (existing_name == data.texture_path && is_same(texture, new_texture))
+        if (found == nullptr)
         {
-            reload_texture(texture.name);
-            return texture.id;
+            if (auto it = index.vanilla.find(data.texture_path); it != index.vanilla.end())
+            {
+                for (const Texture* texture : it->second)
+                {
+                    if (is_same(*texture, new_texture))
+                    {
+                        found = texture;
+                        break;
+                    }
+                }
+            }
         }
     }
 
-    for (auto& texture : textures->textures)
+    // Reloading goes through the renderer, no need to hold the lock for it
+    if (found != nullptr)
     {
-        if (texture.name != nullptr && *texture.name == data.texture_path && is_same(texture, new_texture))
-        {
-            reload_texture(texture.name);
-            return texture.id;
-        }
+        reload_texture(found->name);
+        return found->id;
     }
-
     return std::nullopt;
 }
-std::optional<TEXTURE> get_texture(std::string_view texture_name)
+// Finds the first texture with this path, custom textures first, returns nullptr if there is none
+const Texture* find_texture_by_name(std::string_view texture_name)
 {
-    auto* textures = get_textures();
     auto& render = RenderAPI::get();
 
     std::lock_guard lock{render.custom_textures_lock};
+    auto& index = get_texture_name_index();
 
-    for (auto& [id, texture] : render.custom_textures)
+    if (auto it = index.custom.find(texture_name); it != index.custom.end() && !it->second.empty())
     {
-        std::string_view existing_name{*texture.name};
-        constexpr char c_VanillaTexturePath[]{"Data/Textures/../../"};
-        if (existing_name.starts_with(c_VanillaTexturePath))
-        {
-            existing_name.remove_prefix(sizeof(c_VanillaTexturePath) - 1);
-        }
-        if (existing_name == texture_name)
-        {
-            reload_texture(texture.name);
-            return texture.id;
-        }
+        return &render.custom_textures[it->second.front()];
     }
-
-    for (auto& texture : textures->textures)
+    if (auto it = index.vanilla.find(texture_name); it != index.vanilla.end() && !it->second.empty())
     {
-        if (texture.name != nullptr && *texture.name == texture_name)
-        {
-            reload_texture(texture.name);
-            return texture.id;
-        }
+        return it->second.front();
     }
-
-    return std::nullopt;
+    return nullptr;
 }
 
-void reload_texture(const char* texture_name)
+std::optional<TEXTURE> get_texture(std::string_view texture_name)
 {
+    if (const Texture* texture = find_texture_by_name(texture_name))
     {
-        auto& render = RenderAPI::get();
-
-        std::lock_guard lock{render.custom_textures_lock};
-        for (auto& [id, texture] : render.custom_textures)
-        {
-            std::string_view existing_name{*texture.name};
-            existing_name.remove_prefix(sizeof("Data/Textures/../../") - 1);
-            if (existing_name == texture_name)
-            {
-                reload_texture(texture.name);
-                return;
-            }
-        }
+        reload_texture(texture->name);
+        return texture->id;
     }
+    return std::nullopt;
+}
 
-    std::string_view name_view{texture_name};
-    auto* textures = get_textures();
-    for (auto& texture : textures->textures)
+void reload_texture(const char* texture_name)
+{
+    if (const Texture* texture = find_texture_by_name(texture_name))
     {
-        if (texture.name && *texture.name == name_view)
-        {
-            reload_texture(texture.name);
-            return;
-        }
+        reload_texture(texture->name);
     }
 }
 void reload_texture(const char** texture_name)
@@ -305,15 +349,21 @@ void set_heart_color_from_texture(TEXTURE vanilla_id, TEXTURE custom_id)
     }
 }
 
-bool replace_texture(TEXTURE vanilla_id, TEXTURE custom_id)
+// Swaps the definition of the vanilla texture, returns the name to reload or nullptr if either id is invalid
+// Called with RenderAPI::custom_textures_lock held
+const char** assign_texture(TEXTURE vanilla_id, TEXTURE custom_id)
 {
     auto* textures = get_textures();
     auto& render = RenderAPI::get();
 
-    std::lock_guard lock{render.custom_textures_lock};
-
     if (vanilla_id >= 0 && vanilla_id < 0x192)
     {
+        // The entry's name changes with every branch below, so it is indexed again under the new one
+        auto& index = get_texture_name_index();
+        Texture* vanilla_texture = &textures->textures[vanilla_id];
+        unindex_vanilla_texture(index, vanilla_texture);
+        ON_SCOPE_EXIT(index_vanilla_texture(index, vanilla_texture));
+
         if (vanilla_id != custom_id && !render.original_textures.contains(vanilla_id))
         {
             render.original_textures[vanilla_id] = textures->textures[vanilla_id];
@@ -321,26 +371,74 @@ bool replace_texture(TEXTURE vanilla_id, TEXTURE custom_id)
         if (vanilla_id == custom_id && render.original_textures.contains(vanilla_id))
         {
             textures->textures[vanilla_id] = render.original_textures[custom_id];
-            reload_texture(textures->textures[vanilla_id].name);
-            return true;
+            return textures->textures[vanilla_id].name;
         }
         else if (render.custom_textures.contains(custom_id))
         {
             textures->textures[vanilla_id] = render.custom_textures[custom_id];
             textures->textures[vanilla_id].id = vanilla_id;
-            reload_texture(textures->textures[vanilla_id].name);
-            return true;
+            return textures->textures[vanilla_id].name;
         }
         else if (custom_id >= 0 && custom_id < 0x192)
         {
             textures->textures[vanilla_id] = textures->textures[custom_id];
             textures->textures[vanilla_id].id = vanilla_id;
-            reload_texture(textures->textures[vanilla_id].name);
-            return true;
+            return textures->textures[vanilla_id].name;
+        }
+    }
+
+    return nullptr;
+}
+
+bool replace_texture(TEXTURE vanilla_id, TEXTURE custom_id)
+{
+    const char** name;
+    {
+        std::lock_guard lock{RenderAPI::get().custom_textures_lock};
+        name = assign_texture(vanilla_id, custom_id);
+    }
+    if (name == nullptr)
+        return false;
+    reload_texture(name);
+    return true;
+}
+
+bool replace_textures(const std::vector<std::pair<TEXTURE, TEXTURE>>& replacements, bool heart_colors)
+{
+    bool all_replaced{true};
+    std::vector<const char**> names;
+    names.reserve(replacements.size());
+    {
+        std::lock_guard lock{RenderAPI::get().custom_textures_lock};
+        for (auto [vanilla_id, custom_id] : replacements)
+        {
+            const char** name = assign_texture(vanilla_id, custom_id);
+            if (name == nullptr)
+                all_replaced = false;
+            // Replacing a texture twice in the same batch only needs the last one loaded
+            else if (std::find(names.begin(), names.end(), name) == names.end())
+                names.push_back(name);
         }
     }
 
-    return false;
+    // Converting the images is what takes the time, so all of them are converted to the dds cache on the preload workers
+    // before the renderer is asked for the first one, the loads below only read the cached files
+    AssetPreloadList images;
+    images.images.reserve(names.size());
+    for (const char** name : names)
+        images.images.emplace_back(strip_vanilla_texture_path(*name));
+    preload_assets(std::move(images), nullptr).wait();
+
+    for (const char** name : names)
+        reload_texture(name);
+
+    // The heart colors are read from the textures while they are loaded
+    if (heart_colors)
+    {
+        for (auto [vanilla_id, custom_id] : replacements)
+            set_heart_color_from_texture(vanilla_id, custom_id);
+    }
+    return all_replaced;
 }
 
 bool replace_texture_and_heart_color(TEXTURE vanilla_id, TEXTURE custom_id)
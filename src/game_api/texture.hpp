@@ -5,6 +5,8 @@
 #include <optional>    // for optional
 #include <string>      // for string
 #include <string_view> // for string_view
+#include <utility>     // for pair
+#include <vector>      // for vector
 
 #include "aliases.hpp" // for TEXTURE
 
@@ -58,3 +60,6 @@ void reload_texture(const char** texture_name); // Reloads the texture directly
 bool replace_texture(TEXTURE vanilla_id, TEXTURE custom_id);
 void reset_texture(TEXTURE vanilla_id);
 bool replace_texture_and_heart_color(TEXTURE vanilla_id, TEXTURE custom_id);
+// Replaces all of them before reloading any, the images are converted in parallel and the renderer reloads each texture once
+// Returns false if any of the ids was invalid, the valid ones are still replaced
+bool replace_textures(const std::vector<std::pair<TEXTURE, TEXTURE>>& replacements, bool heart_colors);
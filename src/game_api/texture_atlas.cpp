@@ -0,0 +1,148 @@
+#include "texture_atlas.hpp"
+
+#include <algorithm>    // for sort, max
+#include <cstdint>      // for uint32_t, uint8_t
+#include <cstring>      // for memcpy
+#include <filesystem>   // for create_directories
+#include <fmt/format.h> // for format
+#include <functional>   // for hash
+#include <string>       // for string
+#include <utility>      // for move
+#include <vector>       // for vector
+
+#include "file_api.hpp" // for encode_rgba_as_dds, write_cache_file
+#include "logger.h"     // for DEBUG
+#include "util.hpp"     // for ON_SCOPE_EXIT
+
+#include "stb_image.h"
+
+constexpr uint32_t c_AtlasPageSize{2048};
+// Images larger than this keep their own texture, packing them saves nothing
+constexpr uint32_t c_AtlasMaxImageSize{512};
+// Transparent border around each image so bilinear filtering doesn't read the neighbours, with mipmaps that holds for the first level only,
+// the smaller levels do blend neighbouring images together
+constexpr uint32_t c_AtlasPadding{2};
+
+struct AtlasImage
+{
+    size_t definition_index;
+    uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t page{0};
+    uint32_t x{0};
+    uint32_t y{0};
+};
+
+std::vector<TextureDefinition> pack_texture_atlas(std::vector<TextureDefinition> definitions, bool generate_mipmaps)
+{
+    std::vector<AtlasImage> images;
+    ON_SCOPE_EXIT(for (AtlasImage& image : images) stbi_image_free(image.pixels));
+
+    std::string atlas_key;
+    for (size_t i = 0; i < definitions.size(); ++i)
+    {
+        int width = 0;
+        int height = 0;
+        unsigned char* pixels = stbi_load(definitions[i].texture_path.c_str(), &width, &height, NULL, 4);
+        if (pixels == nullptr)
+            continue;
+        if (static_cast<uint32_t>(width) > c_AtlasMaxImageSize || static_cast<uint32_t>(height) > c_AtlasMaxImageSize)
+        {
+            stbi_image_free(pixels);
+            continue;
+        }
+        images.push_back({i, pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height)});
+        atlas_key += definitions[i].texture_path;
+        atlas_key += '|';
+    }
+    if (images.empty())
+        return definitions;
+
+    // Shelf packing, tallest images first
+    std::vector<AtlasImage*> order;
+    order.reserve(images.size());
+    for (AtlasImage& image : images)
+        order.push_back(&image);
+    std::sort(order.begin(), order.end(), [](const AtlasImage* lhs, const AtlasImage* rhs)
+              { return lhs->height > rhs->height; });
+
+    std::vector<uint32_t> page_heights{0};
+    uint32_t shelf_x = 0;
+    uint32_t shelf_y = 0;
+    uint32_t shelf_height = 0;
+    for (AtlasImage* image : order)
+    {
+        const uint32_t padded_width = image->width + c_AtlasPadding * 2;
+        const uint32_t padded_height = image->height + c_AtlasPadding * 2;
+        if (shelf_x + padded_width > c_AtlasPageSize)
+        {
+            shelf_y += shelf_height;
+            shelf_x = 0;
+            shelf_height = 0;
+        }
+        if (shelf_y + padded_height > c_AtlasPageSize)
+        {
+            page_heights.push_back(0);
+            shelf_x = 0;
+            shelf_y = 0;
+            shelf_height = 0;
+        }
+        image->page = static_cast<uint32_t>(page_heights.size() - 1);
+        image->x = shelf_x + c_AtlasPadding;
+        image->y = shelf_y + c_AtlasPadding;
+        shelf_x += padded_width;
+        shelf_height = std::max(shelf_height, padded_height);
+        page_heights.back() = std::max(page_heights.back(), shelf_y + shelf_height);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories("Mods/Cache", ec);
+
+    const size_t atlas_hash = std::hash<std::string>{}(atlas_key);
+    std::vector<std::string> page_paths;
+    for (uint32_t page = 0; page < page_heights.size(); ++page)
+    {
+        // Rounded up to a multiple of 4 so the first two mip levels halve exactly, the smaller ones round down
+        const uint32_t page_height = (page_heights[page] + 3) & ~3u;
+        std::vector<uint8_t> page_pixels(static_cast<size_t>(c_AtlasPageSize) * page_height * 4, 0);
+        for (const AtlasImage& image : images)
+        {
+            if (image.page != page)
+                continue;
+            for (uint32_t row = 0; row < image.height; ++row)
+            {
+                memcpy(&page_pixels[((image.y + row) * c_AtlasPageSize + image.x) * 4], image.pixels + static_cast<size_t>(row) * image.width * 4, image.width * 4);
+            }
+        }
+
+        std::string page_path = fmt::format("Mods/Cache/atlas_{:016x}_{}.dds", atlas_hash, page);
+        std::vector<char> dds = encode_rgba_as_dds(page_pixels.data(), c_AtlasPageSize, page_height, generate_mipmaps);
+        if (!write_cache_file(page_path, dds))
+        {
+            DEBUG("Couldn't write texture atlas page '{}'", page_path);
+            page_path.clear();
+        }
+        page_paths.push_back(std::move(page_path));
+
+        for (const AtlasImage& image : images)
+        {
+            if (image.page != page || page_paths.back().empty())
+                continue;
+
+            TextureDefinition& definition = definitions[image.definition_index];
+            if (definition.sub_image_width == 0 || definition.sub_image_height == 0)
+            {
+                definition.sub_image_width = definition.width;
+                definition.sub_image_height = definition.height;
+            }
+            definition.texture_path = page_paths.back();
+            definition.width = c_AtlasPageSize;
+            definition.height = page_height;
+            definition.sub_image_offset_x += image.x;
+            definition.sub_image_offset_y += image.y;
+        }
+    }
+
+    return definitions;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <vector> // for vector
+
+#include "texture.hpp" // for TextureDefinition
+
+// Packs the images of the definitions into shared atlas pages in the texture cache and returns the definitions remapped to those pages,
+// definitions that don't fit on a page or fail to load are returned unchanged
+std::vector<TextureDefinition> pack_texture_atlas(std::vector<TextureDefinition> definitions, bool generate_mipmaps);
@@ -0,0 +1,132 @@
+#include "thread_policy.hpp"
+
+#include <Windows.h> // for GetCurrentThread, SetThreadPriority, SetThreadAffinityMask, GetThreadTimes, ...
+#include <algorithm> // for erase_if
+#include <array>     // for array
+
+#include "frame_telemetry.hpp" // for FrameTelemetry
+#include "heap_base.hpp"       // for get_main_thread
+#include "logger.h"            // for DEBUG
+
+namespace
+{
+struct PoolPolicy
+{
+    const char* name;
+    int priority;
+};
+constexpr std::array<PoolPolicy, (size_t)THREAD_POOL::COUNT> g_pool_policies{{
+    {"IO", THREAD_PRIORITY_BELOW_NORMAL},
+    {"Network", THREAD_PRIORITY_BELOW_NORMAL},
+    {"Worker", THREAD_PRIORITY_BELOW_NORMAL},
+    {"Watchdog", THREAD_PRIORITY_NORMAL},
+}};
+
+uint64_t filetime_to_100ns(FILETIME time)
+{
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+uint64_t get_cpu_time(HANDLE thread)
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(thread, &creation, &exit, &kernel, &user))
+        return 0;
+    return filetime_to_100ns(kernel) + filetime_to_100ns(user);
+}
+
+void set_thread_name(const char* name)
+{
+    // Not there before Windows 10 1607
+    using SetThreadDescriptionFun = HRESULT(WINAPI*)(HANDLE, PCWSTR);
+    static const auto set_thread_description = reinterpret_cast<SetThreadDescriptionFun>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetThreadDescription"));
+    if (set_thread_description == nullptr)
+        return;
+    wchar_t wide_name[64]{};
+    MultiByteToWideChar(CP_UTF8, 0, name, -1, wide_name, (int)std::size(wide_name) - 1);
+    set_thread_description(GetCurrentThread(), wide_name);
+}
+} // namespace
+
+ServiceThreads& ServiceThreads::get()
+{
+    // Never destroyed, detached threads can still register while the process exits
+    static ServiceThreads* service_threads = new ServiceThreads();
+    return *service_threads;
+}
+
+uint64_t ServiceThreads::service_affinity()
+{
+    if (affinity_known)
+        return affinity;
+    affinity_known = true;
+
+    DWORD_PTR process_mask, system_mask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+        return affinity;
+    PROCESSOR_NUMBER main_core{};
+    HANDLE main_thread = get_main_thread();
+    if (main_thread == NULL || !GetThreadIdealProcessorEx(main_thread, &main_core) || main_core.Group != 0)
+        return affinity;
+
+    const uint64_t mask = static_cast<uint64_t>(process_mask) & ~(1ull << main_core.Number);
+    affinity = mask != 0 ? mask : 0;
+    DEBUG("Service threads run on {:#x}, the game loop on core {}", affinity, main_core.Number);
+    return affinity;
+}
+
+void ServiceThreads::register_current(const char* name, THREAD_POOL pool)
+{
+    set_thread_name(name);
+    SetThreadPriority(GetCurrentThread(), g_pool_policies[(size_t)pool].priority);
+
+    HANDLE handle = NULL;
+    DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &handle, THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0);
+
+    std::lock_guard lock{mutex};
+    if (const uint64_t mask = service_affinity())
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask));
+
+    std::erase_if(threads, [name](const Entry& entry)
+                  {
+                      DWORD exit_code = 0;
+                      if (entry.name != name || !GetExitCodeThread(entry.handle, &exit_code) || exit_code == STILL_ACTIVE)
+                          return false;
+                      CloseHandle(entry.handle);
+                      return true; });
+    threads.push_back(Entry{name, pool, GetCurrentThreadId(), handle, get_cpu_time(handle), FrameTelemetry::now()});
+}
+
+std::vector<ServiceThreadStats> ServiceThreads::collect()
+{
+    std::lock_guard lock{mutex};
+    const int64_t now = FrameTelemetry::now();
+    std::vector<ServiceThreadStats> stats;
+    stats.reserve(threads.size());
+    for (Entry& entry : threads)
+    {
+        DWORD exit_code = 0;
+        const bool running = GetExitCodeThread(entry.handle, &exit_code) && exit_code == STILL_ACTIVE;
+        const uint64_t cpu = get_cpu_time(entry.handle);
+        const float wall_ms = FrameTelemetry::ticks_to_ms(now - entry.last_sampled);
+        if (wall_ms >= SAMPLE_MS)
+        {
+            entry.cpu_percent = (cpu - entry.last_cpu) / 10000.0f * 100.0f / wall_ms;
+            entry.last_sampled = now;
+            entry.last_cpu = cpu;
+        }
+
+        ServiceThreadStats& thread_stats = stats.emplace_back();
+        thread_stats.name = entry.name;
+        thread_stats.pool = entry.pool;
+        thread_stats.thread_id = entry.thread_id;
+        thread_stats.cpu_ms = cpu / 10000.0f;
+        thread_stats.cpu_percent = entry.cpu_percent;
+        thread_stats.running = running;
+    }
+    return stats;
+}
+
+const char* ServiceThreads::pool_name(THREAD_POOL pool)
+{
+    return g_pool_policies[(size_t)pool].name;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint> // for uint8_t, uint32_t, uint64_t, int64_t
+#include <mutex>   // for mutex
+#include <string>  // for string
+#include <vector>  // for vector
+
+enum class THREAD_POOL : uint8_t
+{
+    // Disk writes and reads that nothing waits on
+    IO,
+    // Sockets, the udp server and http requests
+    NETWORK,
+    // Pools running jobs for the scripts and the api
+    WORKER,
+    // Threads that mostly sleep and have to wake up on time, like the infinite loop detection
+    WATCHDOG,
+    COUNT,
+};
+
+struct ServiceThreadStats
+{
+    std::string name;
+    THREAD_POOL pool;
+    uint32_t thread_id;
+    // Kernel and user time of the whole thread
+    float cpu_ms;
+    // Share of one core, averaged over at least SAMPLE_MS since the thread times only tick with the scheduler
+    float cpu_percent;
+    bool running;
+};
+
+// Every thread the api starts registers here from its entry point, which names it for the debugger and the profilers,
+// sets the priority of its pool and keeps it off the core the game loop runs on, so a busy worker never preempts a frame
+class ServiceThreads
+{
+  public:
+    static constexpr float SAMPLE_MS = 500.0f;
+
+    static ServiceThreads& get();
+
+    // Called on the new thread, before it does any work
+    void register_current(const char* name, THREAD_POOL pool);
+
+    // Exited threads are listed until the next thread with the same name registers
+    std::vector<ServiceThreadStats> collect();
+
+    static const char* pool_name(THREAD_POOL pool);
+
+  private:
+    ServiceThreads() = default;
+
+    // Process affinity without the ideal core of the main thread, 0 if that would leave nothing
+    uint64_t service_affinity();
+
+    struct Entry
+    {
+        std::string name;
+        THREAD_POOL pool;
+        uint32_t thread_id;
+        void* handle;
+        uint64_t last_cpu{0};
+        int64_t last_sampled{0};
+        float cpu_percent{0.0f};
+    };
+    std::mutex mutex;
+    std::vector<Entry> threads;
+    bool affinity_known{false};
+    uint64_t affinity{0};
+};
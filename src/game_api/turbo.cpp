@@ -0,0 +1,44 @@
+#include "turbo.hpp"
+
+#include "frame_limiter.hpp" // for FrameLimiter
+#include "game_manager.hpp"  // for get_game_manager, GameManager, GameProps
+#include "rpc.hpp"           // for freeze_speedhack_clock, step_speedhack_clock, get_frametime
+
+Turbo& Turbo::get()
+{
+    static Turbo turbo;
+    return turbo;
+}
+
+void Turbo::set(std::optional<uint32_t> loops)
+{
+    const uint32_t new_loops = loops.value_or(1) > 1 ? loops.value() : 1;
+    if (new_loops == loops_per_frame)
+        return;
+    // The clock stays frozen between frames too, or the time spent presenting would be simulated on top
+    if (new_loops > 1 || loops_per_frame > 1)
+        freeze_speedhack_clock(new_loops > 1);
+    loops_per_frame = new_loops;
+}
+
+void Turbo::run_frame(const std::function<void()>& game_loop)
+{
+    const uint32_t loops = loops_per_frame;
+    if (loops <= 1)
+    {
+        game_loop();
+        return;
+    }
+
+    static const auto gm = get_game_manager();
+    // Games in the background, like the ones in a farm, update at the unfocused frametime
+    const double frametime = gm->game_props->game_has_focus ? get_frametime() : get_frametime_inactive();
+    for (uint32_t i = 0; i < loops; ++i)
+    {
+        render = i + 1 == loops;
+        // A frametime of 0 makes the game update as often as it's called, which it is anyway, the frame limiter sets it to 0 while it paces the game
+        step_speedhack_clock(frametime > 0.0 ? frametime : FrameLimiter::get().get_target().value_or(1.0 / 60.0));
+        game_loop();
+    }
+    render = true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>    // for uint32_t
+#include <functional> // for function
+#include <optional>   // for optional
+
+// Runs the game loop several times per presented frame to simulate faster than real time
+// Every loop sees the clock move by exactly one engine frametime, a frozen speedhack clock, so each one does one update
+// Only the last loop of a frame renders the game and the frame limiter is skipped, vsync still caps the presented frames
+class Turbo
+{
+  public:
+    static Turbo& get();
+
+    // Game loops per presented frame, nullopt or 1 turns it off
+    void set(std::optional<uint32_t> loops_per_frame);
+    uint32_t get_loops_per_frame() const
+    {
+        return loops_per_frame;
+    }
+    bool is_enabled() const
+    {
+        return loops_per_frame > 1;
+    }
+    // False during the loops of a frame that aren't going to be presented
+    bool should_render() const
+    {
+        return render;
+    }
+
+    // Called from the game_loop hook with the actual loop
+    void run_frame(const std::function<void()>& game_loop);
+
+  private:
+    Turbo() = default;
+
+    uint32_t loops_per_frame{1};
+    bool render{true};
+};
@@ -1,95 +1,121 @@
 #include "vtable_hook.hpp"
 
-#include <Windows.h> // for GetLastError, VirtualProtect, DWORD, LPVOID
-#include <cstdint>   // for uintptr_t
-#include <vector>    // for vector, _Vector_iterator, allocator, _Vector_c...
+#include <Windows.h>     // for GetLastError, VirtualProtect, DWORD, LPVOID
+#include <algorithm>     // for min, max
+#include <cstdint>       // for uintptr_t, UINTPTR_MAX
+#include <functional>    // for hash
+#include <unordered_map> // for unordered_map
+#include <unordered_set> // for unordered_set
 
 #include "logger.h"   // for DEBUG, PANIC
 #include "memory.hpp" // for vtable_find
+#include "search.hpp" // for symbolicate_address
 
-struct VFunctionHook
+namespace
 {
-    std::size_t vtable_index;
-    void* original_function;
-};
-struct VTableHook
+struct VFunctionKey
 {
     void** vtable;
-    std::vector<VFunctionHook> functions;
-};
-std::vector<VTableHook> g_TableHooks;
+    std::size_t vtable_index;
 
-VTableHook* get_vtable_hook(void** vtable)
+    bool operator==(const VFunctionKey&) const = default;
+};
+struct VFunctionKeyHash
 {
-    auto it = std::find_if(g_TableHooks.begin(), g_TableHooks.end(), [vtable](const VTableHook& hook)
-                           { return hook.vtable == vtable; });
-    if (it != g_TableHooks.end())
+    std::size_t operator()(const VFunctionKey& key) const
     {
-        return &*it;
+        const auto addr = reinterpret_cast<std::uintptr_t>(key.vtable);
+        return std::hash<std::uintptr_t>{}(addr ^ (key.vtable_index * 0x9E3779B97F4A7C15ull));
     }
-    return nullptr;
-}
-VFunctionHook* get_vfunction_hook(VTableHook& vtable_hook, size_t index)
+};
+// Original function of every hooked vtable entry
+std::unordered_map<VFunctionKey, void*, VFunctionKeyHash> g_FunctionHooks;
+// Vtables live in read-only pages, remember the ones we already made writable
+std::unordered_set<std::uintptr_t> g_WritablePages;
+
+constexpr std::uintptr_t page_mask = 0xFFF;
+
+void make_writable(std::uintptr_t first_page, std::uintptr_t last_page)
 {
-    auto it = std::find_if(vtable_hook.functions.begin(), vtable_hook.functions.end(), [index](const VFunctionHook& hook)
-                           { return hook.vtable_index == index; });
-    if (it != vtable_hook.functions.end())
+    while (first_page <= last_page && g_WritablePages.contains(first_page))
+        first_page += page_mask + 1;
+    while (last_page >= first_page && g_WritablePages.contains(last_page))
+        last_page -= page_mask + 1;
+    if (first_page > last_page)
+        return;
+
+    DWORD oldProtect;
+    if (!VirtualProtect(reinterpret_cast<LPVOID>(first_page), last_page - first_page + page_mask + 1, PAGE_READWRITE, &oldProtect))
     {
-        return &*it;
+        PANIC("VirtualProtect error on {}: {:#x}\n", symbolicate_address(first_page), GetLastError());
     }
-    return nullptr;
+    for (std::uintptr_t page = first_page; page <= last_page; page += page_mask + 1)
+        g_WritablePages.insert(page);
 }
+} // namespace
 
 void* register_hook_function(void*** vtable, size_t index, void* hook_function)
 {
-    VTableHook* vtable_hook = get_vtable_hook(*vtable);
-    if (vtable_hook == nullptr)
-    {
-        g_TableHooks.push_back({*vtable});
-        vtable_hook = &g_TableHooks.back();
-    }
-    if (auto* existing_hook = get_vfunction_hook(*vtable_hook, index))
-    {
-        DEBUG("Multiple hooks to the same function are not allowed...");
-        return existing_hook->original_function;
-    }
-    else if (void** vtable_ptr = vtable_find<void*>(vtable, index))
+    VFunctionHookRequest request{index, hook_function};
+    register_hook_functions(vtable, std::span{&request, 1});
+    return request.original_function;
+}
+void register_hook_functions(void*** vtable, std::span<VFunctionHookRequest> hooks)
+{
+    std::uintptr_t first_page = UINTPTR_MAX;
+    std::uintptr_t last_page = 0;
+    for (VFunctionHookRequest& hook : hooks)
     {
-        DWORD oldProtect;
-        if (!VirtualProtect(reinterpret_cast<LPVOID>(reinterpret_cast<uintptr_t>(vtable_ptr) & ~0xFFF), 0x1000, PAGE_READWRITE, &oldProtect))
+        hook.original_function = nullptr;
+        if (auto it = g_FunctionHooks.find({*vtable, hook.index}); it != g_FunctionHooks.end())
+        {
+            DEBUG("Multiple hooks to the same function are not allowed... ({})", symbolicate_address(reinterpret_cast<size_t>(it->second)));
+            hook.original_function = it->second;
+            hook.hook_function = nullptr;
+        }
+        else if (void** vtable_ptr = vtable_find<void*>(vtable, hook.index))
+        {
+            const auto addr = reinterpret_cast<std::uintptr_t>(vtable_ptr);
+            first_page = std::min(first_page, addr & ~page_mask);
+            last_page = std::max(last_page, addr & ~page_mask);
+        }
+        else
         {
-            PANIC("VirtualProtect error: {:#x}\n", GetLastError());
+            hook.hook_function = nullptr;
         }
+    }
+    if (first_page > last_page)
+        return;
+
+    // One VirtualProtect for all the entries, they're usually in the same page anyways
+    make_writable(first_page, last_page);
+    for (VFunctionHookRequest& hook : hooks)
+    {
+        if (hook.hook_function == nullptr)
+            continue;
 
-        void* original_function = *vtable_ptr;
-        *vtable_ptr = hook_function;
-        vtable_hook->functions.push_back({index, original_function});
-        return original_function;
+        void** vtable_ptr = vtable_find<void*>(vtable, hook.index);
+        hook.original_function = *vtable_ptr;
+        *vtable_ptr = hook.hook_function;
+        g_FunctionHooks[{*vtable, hook.index}] = hook.original_function;
     }
-    return nullptr;
 }
 void unregister_hook_function(void*** vtable, size_t index)
 {
-    if (VTableHook* vtable_hook = get_vtable_hook(*vtable))
+    if (auto it = g_FunctionHooks.find({*vtable, index}); it != g_FunctionHooks.end())
     {
-        if (VFunctionHook* vfunction_hook = get_vfunction_hook(*vtable_hook, index))
+        if (void** vtable_ptr = vtable_find<void*>(vtable, index))
         {
-            if (void** vtable_ptr = vtable_find<void*>(vtable, index))
-            {
-                *vtable_ptr = vfunction_hook->original_function;
-                vtable_hook->functions.erase(vtable_hook->functions.begin() + (vfunction_hook - &vtable_hook->functions.front()));
-            }
+            *vtable_ptr = it->second;
+            g_FunctionHooks.erase(it);
         }
     }
 }
 void* get_hook_function(void*** vtable, size_t index)
 {
-    if (VTableHook* vtable_hook = get_vtable_hook(*vtable))
+    if (auto it = g_FunctionHooks.find({*vtable, index}); it != g_FunctionHooks.end())
     {
-        if (VFunctionHook* vfunction_hook = get_vfunction_hook(*vtable_hook, index))
-        {
-            return vfunction_hook->original_function;
-        }
+        return it->second;
     }
     return nullptr;
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>         // for array
 #include <cstddef>       // for size_t
+#include <cstdint>       // for uint16_t, uint32_t, uintptr_t
 #include <functional>    // for equal_to, function, _Func_class
 #include <new>           // for operator new
+#include <span>          // for span
 #include <type_traits>   // for forward
 #include <unordered_map> // for unordered_map, _Umap_traits<>::allocator_type
 #include <utility>       // for min, max
@@ -10,7 +13,17 @@
 
 #include "util.hpp" // for function_signature
 
+struct VFunctionHookRequest
+{
+    std::size_t index;
+    void* hook_function;
+    // Set by register_hook_functions, nullptr if the entry couldn't be hooked
+    void* original_function{nullptr};
+};
+
 void* register_hook_function(void*** vtable, size_t index, void* hook_function);
+// Hooks several entries of one vtable with a single VirtualProtect, for hooking a whole type at once
+void register_hook_functions(void*** vtable, std::span<VFunctionHookRequest> hooks);
 void unregister_hook_function(void*** vtable, size_t index);
 void* get_hook_function(void*** vtable, size_t index);
 
@@ -36,6 +49,33 @@ struct VDestructorDetour
     inline static std::unordered_map<void*, std::vector<DtorTaskT>> s_Tasks{};
 };
 
+// Counts hooked objects per pointer hash, a zero count means the object is definitely not hooked
+// Lets the detours skip the hash map lookup for the many objects that share a hooked vtable but aren't hooked themselves
+struct HookedObjectFilter
+{
+    static constexpr std::size_t Size{1024};
+
+    static std::size_t slot(const void* obj)
+    {
+        const auto addr = reinterpret_cast<std::uintptr_t>(obj);
+        return ((addr >> 4) ^ (addr >> 14)) & (Size - 1);
+    }
+    bool maybe_contains(const void* obj) const
+    {
+        return counts[slot(obj)] != 0;
+    }
+    void add(const void* obj)
+    {
+        ++counts[slot(obj)];
+    }
+    void remove(const void* obj)
+    {
+        --counts[slot(obj)];
+    }
+
+    std::array<std::uint16_t, Size> counts{};
+};
+
 template <function_signature VFunT, size_t Index>
 struct VTableDetour;
 
@@ -48,27 +88,51 @@ struct VTableDetour<RetT(ClassT*, ArgsT...), Index>
     static RetT detour(ClassT* self, ArgsT... args)
     {
         void** vtable = *(void***)self;
-        if constexpr (std::is_void_v<RetT>)
+        if (s_Filter.maybe_contains(self))
         {
-            if (s_Functions.contains(self))
+            if (auto it = s_Functions.find(self); it != s_Functions.end())
             {
-                s_Functions[self](self, args..., s_Originals[vtable]);
-                return;
+                return it->second(self, args..., s_Originals[vtable]);
             }
-            s_Originals[vtable](self, std::move(args)...);
         }
-        else
+        if constexpr (requires { self->type->id; })
         {
-            if (s_Functions.contains(self))
+            if (!s_TypeFunctions.empty())
             {
-                return s_Functions[self](self, args..., s_Originals[vtable]);
+                if (auto it = s_TypeFunctions.find(self->type->id); it != s_TypeFunctions.end())
+                {
+                    return it->second(self, args..., s_Originals[vtable]);
+                }
             }
-            return s_Originals[vtable](self, std::move(args)...);
+        }
+        return s_Originals[vtable](self, std::move(args)...);
+    }
+
+    static void set_function(ClassT* self, DetourFunT fun)
+    {
+        if (s_Functions.insert_or_assign(self, std::move(fun)).second)
+        {
+            s_Filter.add(self);
+        }
+    }
+    static void erase_function(ClassT* self)
+    {
+        if (s_Functions.erase(self) != 0)
+        {
+            s_Filter.remove(self);
         }
     }
 
     inline static std::unordered_map<void**, VFunT*> s_Originals{};
+    static void set_type_function(std::uint32_t type_id, DetourFunT fun)
+    {
+        s_TypeFunctions.insert_or_assign(type_id, std::move(fun));
+    }
+
     inline static std::unordered_map<ClassT*, DetourFunT> s_Functions{};
+    inline static HookedObjectFilter s_Filter{};
+    // For entities hooked by type instead of by object, only used for objects that aren't hooked themselves
+    inline static std::unordered_map<std::uint32_t, DetourFunT> s_TypeFunctions{};
 };
 
 template <class HookFunT>
@@ -84,8 +148,8 @@ void hook_dtor(void* obj, HookFunT&& hook_fun, std::size_t dtor_index = 0)
     DestructorDetourT::s_Tasks[obj].push_back(std::forward<HookFunT>(hook_fun));
 }
 
-template <class VTableFunT, std::size_t VTableIndex, class T, class HookFunT>
-void hook_vtable_no_dtor(T* obj, HookFunT&& hook_fun)
+template <class VTableFunT, std::size_t VTableIndex, class T>
+void patch_vtable(T* obj)
 {
     using DetourT = VTableDetour<VTableFunT, VTableIndex>;
     void*** vtable = (void***)obj;
@@ -93,7 +157,14 @@ void hook_vtable_no_dtor(T* obj, HookFunT&& hook_fun)
     {
         DetourT::s_Originals[*vtable] = (VTableFunT*)register_hook_function(vtable, VTableIndex, (void*)&DetourT::detour);
     }
-    DetourT::s_Functions[obj] = std::forward<HookFunT>(hook_fun);
+}
+
+template <class VTableFunT, std::size_t VTableIndex, class T, class HookFunT>
+void hook_vtable_no_dtor(T* obj, HookFunT&& hook_fun)
+{
+    using DetourT = VTableDetour<VTableFunT, VTableIndex>;
+    patch_vtable<VTableFunT, VTableIndex>(obj);
+    DetourT::set_function(obj, std::forward<HookFunT>(hook_fun));
 }
 
 template <class VTableFunT, std::size_t VTableIndex, class T, class HookFunT>
@@ -116,6 +187,17 @@ void hook_vtable(T* obj, HookFunT&& hook_fun, std::size_t dtor_index = 0)
         }
     }
 
+    // The first hook of a type patches its entry and its destructor, both in one go
+    void*** vtable = (void***)obj;
+    if (!get_hook_function(vtable, VTableIndex) && !get_hook_function(vtable, dtor_index))
+    {
+        using DetourT = VTableDetour<VTableFunT, VTableIndex>;
+        std::array<VFunctionHookRequest, 2> requests{{{VTableIndex, (void*)&DetourT::detour}, {dtor_index, (void*)&VDestructorDetour::detour}}};
+        register_hook_functions(vtable, requests);
+        DetourT::s_Originals[*vtable] = (VTableFunT*)requests[0].original_function;
+        VDestructorDetour::s_OriginalDtors[*vtable] = (VDestructorDetour::VFunT*)requests[1].original_function;
+    }
+
     hook_vtable_no_dtor<VTableFunT, VTableIndex>(obj, std::forward<HookFunT>(hook_fun));
 
     // Unhook in dtor
@@ -124,7 +206,7 @@ void hook_vtable(T* obj, HookFunT&& hook_fun, std::size_t dtor_index = 0)
         [](void* self)
         {
             using DetourT = VTableDetour<VTableFunT, VTableIndex>;
-            DetourT::s_Functions.erase((T*)self);
+            DetourT::erase_function((T*)self);
         },
         dtor_index);
 }
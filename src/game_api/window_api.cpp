@@ -4,15 +4,23 @@
 #include <backends/imgui_impl_win32.h>
 #include <d3d11.h>
 #include <detours.h>
+#include <dxgi1_3.h>
 #include <imgui.h>
 #include <imgui_internal.h>
 
 #include <atomic>
 #include <chrono>
 
+#include "async_file_writer.hpp" // for AsyncFileWriter
 #include "bucket.hpp"
+#include "frame_limiter.hpp"
+#include "frame_telemetry.hpp"
+#include "gpu_timing.hpp"
 #include "logger.h"
+#include "screen_transform.hpp"
 #include "script/lua_backend.hpp"
+#include "script/lua_gc.hpp"
+#include "script/lua_idle.hpp"
 #include "search.hpp"
 #include "state.hpp"
 
@@ -148,7 +156,11 @@ LRESULT CALLBACK hkWndProc(HWND window, UINT message, WPARAM wParam, LPARAM lPar
     {
         return DefWindowProc(window, message, wParam, lParam);
     }
-    return CallWindowProc(g_OrigWndProc, window, message, wParam, lParam);
+    const LRESULT result = CallWindowProc(g_OrigWndProc, window, message, wParam, lParam);
+    // The game saves on its way out, the writes still queued have to land before the process goes
+    if (message == WM_DESTROY)
+        AsyncFileWriter::get().flush();
+    return result;
 }
 
 void init_imgui()
@@ -257,6 +269,7 @@ HRESULT STDMETHODCALLTYPE hkPresent(IDXGISwapChain* pSwapChain, UINT SyncInterva
             g_kbHook = SetWindowsHookEx(WH_KEYBOARD_LL, hkKeyboard, NULL, 0);
             create_render_target();
             init_imgui();
+            GpuTiming::get().init(g_Device, g_Context);
             init = true;
         }
         else
@@ -281,6 +294,8 @@ HRESULT STDMETHODCALLTYPE hkPresent(IDXGISwapChain* pSwapChain, UINT SyncInterva
         }
     }
 
+    const int64_t draw_start = FrameTelemetry::now();
+    ScreenTransform::begin_frame();
     if (g_PreDrawCallback)
     {
         g_PreDrawCallback();
@@ -297,15 +312,18 @@ HRESULT STDMETHODCALLTYPE hkPresent(IDXGISwapChain* pSwapChain, UINT SyncInterva
 
     ImGui::Render();
 
-    g_Context->OMSetRenderTargets(1, &g_MainRenderTargetView, NULL);
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-
-    if (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
     {
-        skip_hkPresent = true;
-        ImGui::UpdatePlatformWindows();
-        ImGui::RenderPlatformWindowsDefault();
-        skip_hkPresent = false;
+        GpuSectionScope gpu_section{GPU_SECTION::IMGUI};
+        g_Context->OMSetRenderTargets(1, &g_MainRenderTargetView, NULL);
+        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+
+        if (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+        {
+            skip_hkPresent = true;
+            ImGui::UpdatePlatformWindows();
+            ImGui::RenderPlatformWindowsDefault();
+            skip_hkPresent = false;
+        }
     }
 
     {
@@ -344,7 +362,19 @@ HRESULT STDMETHODCALLTYPE hkPresent(IDXGISwapChain* pSwapChain, UINT SyncInterva
         bucket->io->WantCaptureMouse = std::nullopt;
     }
 
-    return g_OrigSwapChainPresent(pSwapChain, SyncInterval, Flags);
+    ScreenTransform::end_frame();
+    auto& telemetry = FrameTelemetry::get();
+    telemetry.add_phase_time(FRAME_PHASE::IMGUI_DRAW, FrameTelemetry::now() - draw_start);
+    GpuTiming::get().end_frame();
+    HRESULT result;
+    {
+        FramePhaseScope phase{FRAME_PHASE::PRESENT};
+        result = g_OrigSwapChainPresent(pSwapChain, SyncInterval, Flags);
+    }
+    LuaGcScheduler::get().after_present();
+    LuaIdleScheduler::get().after_present();
+    telemetry.end_frame();
+    return result;
 }
 
 HRESULT STDMETHODCALLTYPE
@@ -364,7 +394,7 @@ void hook_virtual_function(FunT hook_fun, FunT& orig_fun, int vtable_index)
         DWORD oldProtect;
         if (!VirtualProtect(reinterpret_cast<LPVOID>(reinterpret_cast<uintptr_t>(vtable_ptr) & ~0xFFF), 0x1000, PAGE_READWRITE, &oldProtect))
         {
-            PANIC("VirtualProtect error: {:#x}\n", GetLastError());
+            PANIC("VirtualProtect error on {}: {:#x}\n", symbolicate_address(reinterpret_cast<size_t>(vtable_ptr)), GetLastError());
         }
 
         if (*vtable_ptr == nullptr)
@@ -531,6 +561,71 @@ void imgui_vsync(bool enable)
     g_SyncInterval = (UINT)enable;
 }
 
+void rebuild_imgui_fonts()
+{
+    // The backend only creates the font texture with its device objects, the next NewFrame creates them again
+    ImGui_ImplDX11_InvalidateDeviceObjects();
+}
+
+bool g_LowLatencyWanted{false};
+bool g_LowLatencyApplied{false};
+HANDLE g_FrameLatencyWaitable{nullptr};
+
+// Flip model swap chains can't be switched to after the game created them, so the waitable object is only used if the game already asked for it
+void apply_low_latency_mode()
+{
+    if (g_Device == nullptr || g_LowLatencyApplied == g_LowLatencyWanted)
+        return;
+    g_LowLatencyApplied = g_LowLatencyWanted;
+
+    if (g_FrameLatencyWaitable != nullptr)
+    {
+        CloseHandle(g_FrameLatencyWaitable);
+        g_FrameLatencyWaitable = nullptr;
+    }
+
+    IDXGIDevice1* dxgi_device{nullptr};
+    if (SUCCEEDED(g_Device->QueryInterface(__uuidof(IDXGIDevice1), (void**)&dxgi_device)))
+    {
+        // 3 is the DXGI default
+        dxgi_device->SetMaximumFrameLatency(g_LowLatencyWanted ? 1 : 3);
+        dxgi_device->Release();
+    }
+
+    if (!g_LowLatencyWanted || g_SwapChain == nullptr)
+        return;
+
+    DXGI_SWAP_CHAIN_DESC desc;
+    IDXGISwapChain2* swap_chain2{nullptr};
+    if (SUCCEEDED(g_SwapChain->GetDesc(&desc)) && (desc.Flags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT) &&
+        SUCCEEDED(g_SwapChain->QueryInterface(__uuidof(IDXGISwapChain2), (void**)&swap_chain2)))
+    {
+        swap_chain2->SetMaximumFrameLatency(1);
+        g_FrameLatencyWaitable = swap_chain2->GetFrameLatencyWaitableObject();
+        swap_chain2->Release();
+    }
+}
+
+void set_low_latency_mode(bool enable)
+{
+    g_LowLatencyWanted = enable;
+    apply_low_latency_mode();
+}
+bool get_low_latency_mode()
+{
+    return g_LowLatencyWanted;
+}
+
+void wait_for_next_frame()
+{
+    apply_low_latency_mode();
+    if (g_FrameLatencyWaitable != nullptr)
+        WaitForSingleObjectEx(g_FrameLatencyWaitable, 1000, TRUE);
+
+    static auto& frame_limiter = FrameLimiter::get();
+    frame_limiter.wait();
+}
+
 ID3D11Device* get_device()
 {
     return g_Device;
@@ -33,5 +33,13 @@ HWND get_window();
 void show_cursor();
 void hide_cursor();
 void imgui_vsync(bool enable);
+// Uploads the font atlas again on the next frame, after the fonts were changed
+void rebuild_imgui_fonts();
+
+// Keeps at most one frame queued on the GPU, and waits on the swap chain latency object when the game created a waitable flip model swap chain
+void set_low_latency_mode(bool enable);
+bool get_low_latency_mode();
+// Called right before the game processes input, so input is read as late as possible, also paces the game with the FrameLimiter
+void wait_for_next_frame();
 
 struct ID3D11Device* get_device();
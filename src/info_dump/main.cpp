@@ -4,14 +4,18 @@
 #include <cctype>            // for toupper
 #include <chrono>            // for operator<=>, operator-
 #include <cmath>             // for round, abs
+#include <codecvt>           // for codecvt_utf8_utf16
 #include <compare>           // for operator<, operator<=
 #include <cstdint>           // for uint32_t, int64_t, uint...
 #include <cstdlib>           // for abs, size_t, exit, NULL
+#include <cstring>           // for memcpy
 #include <filesystem>        // for create_directories
 #include <fmt/format.h>      // for check_format_string
 #include <fstream>           // for char_traits, operator<<
 #include <functional>        // for equal_to, less
+#include <future>            // for async, future
 #include <initializer_list>  // for initializer_list
+#include <iterator>          // for istreambuf_iterator
 #include <list>              // for _List_iterator, _List_c...
 #include <locale>            // for num_put
 #include <map>               // for multimap, _Tree_iterator
@@ -30,6 +34,7 @@
 #include "console.hpp"                       // for SpelunkyConsole
 #include "containers/game_unordered_map.hpp" // for game_unordered_map
 #include "entity.hpp"                        // for EntityDB, EntityItem
+#include "game_data_binary.h"                // for GameDataBinary
 #include "level_api.hpp"                     // for LevelGenData, LevelGenS...
 #include "logger.h"                          // for DEBUG
 #include "memory.hpp"                        // for Memory
@@ -38,6 +43,7 @@
 #include "settings_api.hpp"                  // for get_settings_names_and_...
 #include "sound_manager.hpp"                 // for SoundManager, SoundMana...
 #include "state.hpp"                         // for API::init
+#include "strings.hpp"                       // for get_string, get_string_hashes
 #include "texture.hpp"                       // for Texture, get_textures
 #include "virtual_table.hpp"                 // for VTABLE_OFFSET, VTABLE_O...
 
@@ -946,10 +952,7 @@ void get_vtables()
             VTABLE_OFFSET::LIQUID_COARSE_LAVA};
         const size_t* vtable_off = (size_t*)get_address("virtual_functions_table");
 
-        std::vector<EntityItem> names = list_entities();
-
-        std::sort(names.begin(), names.end(), [](EntityItem a, EntityItem b)
-                  { return a.id < b.id; });
+        const std::vector<EntityItem>& names = list_entities();
 
         std::set<size_t> base_functions;
         for (const auto& it : offsets)
@@ -1080,31 +1083,174 @@ void to_json(float_json& j, const Texture& tex)
 
 using namespace std::chrono_literals;
 
+// Leaves the file alone if it already has this content, so regenerating after a game update only touches what changed
+void write_if_changed(const char* path, const std::string& content, std::ios::openmode mode = {})
+{
+    if (std::ifstream existing = std::ifstream(path, std::ios::in | mode))
+    {
+        const std::string old_content{std::istreambuf_iterator<char>(existing), std::istreambuf_iterator<char>()};
+        if (old_content == content)
+            return;
+    }
+    if (std::ofstream file = std::ofstream(path, std::ios::out | mode))
+    {
+        file.write(content.data(), content.size());
+    }
+}
+
+// Builds the sections of game_data.bin, see game_data_binary.h for the layout
+class GameDataBinaryWriter
+{
+  public:
+    GameDataBinary::String add_string(std::string_view str)
+    {
+        const GameDataBinary::String result{static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(str.size())};
+        pool.append(str);
+        pool.push_back('\0');
+        return result;
+    }
+
+    // Records have to be sorted by id already
+    template <class T>
+    void add_section(GameDataBinary::SectionKind kind, const std::vector<T>& records)
+    {
+        sections.push_back({kind, static_cast<uint32_t>(records.size()), static_cast<uint32_t>(records_data.size()), sizeof(T)});
+        records_data.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+    }
+
+    std::string finish() const
+    {
+        const uint32_t records_offset = static_cast<uint32_t>(sizeof(GameDataBinary::Header) + sections.size() * sizeof(GameDataBinary::Section));
+        GameDataBinary::Header header{
+            {},
+            GameDataBinary::version,
+            static_cast<uint32_t>(sections.size()),
+            records_offset + static_cast<uint32_t>(records_data.size()),
+            static_cast<uint32_t>(pool.size()),
+        };
+        std::memcpy(header.magic, GameDataBinary::magic, sizeof(header.magic));
+
+        std::string out;
+        out.reserve(header.string_pool_offset + pool.size());
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (GameDataBinary::Section section : sections)
+        {
+            section.offset += records_offset;
+            out.append(reinterpret_cast<const char*>(&section), sizeof(section));
+        }
+        out.append(records_data);
+        out.append(pool);
+        return out;
+    }
+
+  private:
+    std::vector<GameDataBinary::Section> sections;
+    std::string records_data;
+    std::string pool;
+};
+
+// Fields are read back from the same json the text dumps are made of, so both formats always agree
+std::string dump_game_data_binary(const std::vector<EntityItem>& items, Textures* textures_ptr)
+{
+    GameDataBinaryWriter writer;
+
+    std::vector<GameDataBinary::Entity> entities;
+    for (auto& ent : items)
+    {
+        EntityDB* db = get_type(ent.id);
+        if (!db)
+            break;
+
+        const float_json j = *db;
+        GameDataBinary::Entity& record = entities.emplace_back();
+        record.id = ent.id;
+        record.name = writer.add_string(ent.name);
+        record.search_flags = j["search_flags"].get<uint32_t>();
+        record.texture = j["texture"].get<uint32_t>();
+        record.technique = j["technique"].get<int32_t>();
+        record.tile_x = j["tile_x"].get<int32_t>();
+        record.tile_y = j["tile_y"].get<int32_t>();
+        record.width = j["width"].get<float>();
+        record.height = j["height"].get<float>();
+        record.friction = j["friction"].get<float>();
+        record.elasticity = j["elasticity"].get<float>();
+        record.weight = j["weight"].get<float>();
+        record.acceleration = j["acceleration"].get<float>();
+        record.max_speed = j["max_speed"].get<float>();
+        record.sprint_factor = j["sprint_factor"].get<float>();
+        record.jump = j["jump"].get<float>();
+        record.damage = j["damage"].get<uint8_t>();
+        record.life = j["life"].get<uint8_t>();
+    }
+    writer.add_section(GameDataBinary::SectionKind::Entities, entities);
+
+    std::vector<GameDataBinary::Texture> textures;
+    for (std::size_t i = 0; i < textures_ptr->num_textures; i++)
+    {
+        Texture& tex = textures_ptr->textures[i];
+        if (tex.name == nullptr)
+            continue;
+
+        const float_json j = tex;
+        GameDataBinary::Texture& record = textures.emplace_back();
+        record.id = static_cast<uint32_t>(tex.id);
+        record.path = writer.add_string(j["path"].get<std::string>());
+        record.width = j["width"].get<uint32_t>();
+        record.height = j["height"].get<uint32_t>();
+        record.num_tiles_width = j["num_tiles"]["width"].get<uint32_t>();
+        record.num_tiles_height = j["num_tiles"]["height"].get<uint32_t>();
+        record.tile_width = j["tile_width"].get<uint32_t>();
+        record.tile_height = j["tile_height"].get<uint32_t>();
+        record.offset_width = j["offset"]["width"].get<uint32_t>();
+        record.offset_height = j["offset"]["height"].get<uint32_t>();
+    }
+    writer.add_section(GameDataBinary::SectionKind::Textures, textures);
+
+    std::vector<GameDataBinary::Particle> particles;
+    for (const auto& particle : list_particles())
+    {
+        particles.push_back({particle.id, writer.add_string(particle.name)});
+    }
+    std::sort(particles.begin(), particles.end(), [](const auto& a, const auto& b)
+              { return a.id < b.id; });
+    writer.add_section(GameDataBinary::SectionKind::Particles, particles);
+
+    std::vector<GameDataBinary::GameString> strings;
+    std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
+    const auto& string_hashes = get_string_hashes();
+    for (size_t i = 0; i < string_hashes.size(); ++i)
+    {
+        const char16_t* str = get_string(static_cast<STRINGID>(i));
+        strings.push_back({static_cast<uint32_t>(i), string_hashes[i], writer.add_string(str != nullptr ? convert.to_bytes(str) : std::string{})});
+    }
+    writer.add_section(GameDataBinary::SectionKind::Strings, strings);
+
+    return writer.finish();
+}
+
 void run()
 {
     DEBUG("Game injected! Press Ctrl+C to detach this window from the process.");
 
     while (true)
     {
-        auto entities = list_entities();
-        if (entities.size() >= 876)
+        const size_t num_entities = get_entity_type_count();
+        if (num_entities >= 876)
         {
-            DEBUG("Found {} entities, that's enough", entities.size());
+            DEBUG("Found {} entities, that's enough", num_entities);
             std::this_thread::sleep_for(100ms);
-            DEBUG("Added {} entities", entities.size());
+            DEBUG("Added {} entities", num_entities);
             break;
         }
-        else if (entities.size() > 0)
+        else if (num_entities > 0)
         {
-            DEBUG("Found {} entities", entities.size());
+            DEBUG("Found {} entities", num_entities);
         }
         std::this_thread::sleep_for(100ms);
     }
 
     API::init();
-    auto items = list_entities();
-    std::sort(items.begin(), items.end(), [](EntityItem& a, EntityItem& b) -> bool
-              { return a.id < b.id; });
+    const std::vector<EntityItem>& items = list_entities();
 
     Textures* textures_ptr = get_textures();
     std::sort(
@@ -1113,77 +1259,102 @@ void run()
 
     std::filesystem::create_directories("game_data");
 
-    if (std::ofstream entities_file = std::ofstream("game_data/entities.json"))
+    for (auto& ent : items)
     {
-        float_json entities(float_json::object());
-        for (auto& ent : items)
-        {
-            EntityDB* db = get_type(ent.id);
-            if (!db)
-                break;
+        EntityDB* db = get_type(ent.id);
+        if (!db)
+            break;
 
 #define HAX_FIX_FLOAT(x)                           \
     if (std::abs(x) < 1e-10 || std::abs(x) > 1e10) \
     x = 0.0f
-            HAX_FIX_FLOAT(db->width);
-            HAX_FIX_FLOAT(db->height);
-            HAX_FIX_FLOAT(db->friction);
-            HAX_FIX_FLOAT(db->elasticity);
-            HAX_FIX_FLOAT(db->weight);
-            HAX_FIX_FLOAT(db->acceleration);
-            HAX_FIX_FLOAT(db->max_speed);
-            HAX_FIX_FLOAT(db->sprint_factor);
-            HAX_FIX_FLOAT(db->jump);
-            HAX_FIX_FLOAT(db->default_color.r);
-            HAX_FIX_FLOAT(db->default_color.g);
-            HAX_FIX_FLOAT(db->default_color.b);
-            HAX_FIX_FLOAT(db->default_color.a);
-            HAX_FIX_FLOAT(db->field_a8);
-            HAX_FIX_FLOAT(db->default_special_offsetx);
-            HAX_FIX_FLOAT(db->default_special_offsety);
+        HAX_FIX_FLOAT(db->width);
+        HAX_FIX_FLOAT(db->height);
+        HAX_FIX_FLOAT(db->friction);
+        HAX_FIX_FLOAT(db->elasticity);
+        HAX_FIX_FLOAT(db->weight);
+        HAX_FIX_FLOAT(db->acceleration);
+        HAX_FIX_FLOAT(db->max_speed);
+        HAX_FIX_FLOAT(db->sprint_factor);
+        HAX_FIX_FLOAT(db->jump);
+        HAX_FIX_FLOAT(db->default_color.r);
+        HAX_FIX_FLOAT(db->default_color.g);
+        HAX_FIX_FLOAT(db->default_color.b);
+        HAX_FIX_FLOAT(db->default_color.a);
+        HAX_FIX_FLOAT(db->field_a8);
+        HAX_FIX_FLOAT(db->default_special_offsetx);
+        HAX_FIX_FLOAT(db->default_special_offsety);
 #undef HAX_FIX_FLOAT
-
-            entities[ent.name] = *db;
-        }
-
-        std::string dump = entities.dump(2);
-        entities_file.write(dump.data(), dump.size());
-    }
-
-    if (std::ofstream entities_file = std::ofstream("game_data/entities_texture_only.json"))
-    {
-        float_json entities(float_json::object());
-        for (auto& ent : items)
-        {
-            EntityDB* db = get_type(ent.id);
-            if (!db)
-                break;
-
-            entities[ent.name] = float_json{
-                {"id", ent.id},
-                {"texture", db->texture_id},
-                {"animations", get_animations_as_string_map(*db)}};
-        }
-
-        std::string dump = entities.dump(2);
-        entities_file.write(dump.data(), dump.size());
     }
 
-    if (std::ofstream textures_file = std::ofstream("game_data/textures.json"))
-    {
-        float_json textures(float_json::object());
-        for (std::size_t i = 0; i < textures_ptr->num_textures; i++)
-        {
-            Texture& tex = textures_ptr->textures[i];
-            if (tex.name != nullptr)
-            {
-                textures[std::to_string(tex.id)] = tex;
-            }
-        }
+    // The json files only read the entity and texture dbs, which don't change anymore, so they are serialized side by side
+    std::vector<std::pair<const char*, std::future<std::string>>> json_outputs;
+    json_outputs.emplace_back(
+        "game_data/entities.json",
+        std::async(std::launch::async, [&items]()
+                   {
+                       float_json entities(float_json::object());
+                       for (auto& ent : items)
+                       {
+                           EntityDB* db = get_type(ent.id);
+                           if (!db)
+                               break;
+                           entities[ent.name] = *db;
+                       }
+                       return entities.dump(2); }));
+    json_outputs.emplace_back(
+        "game_data/entities_texture_only.json",
+        std::async(std::launch::async, [&items]()
+                   {
+                       float_json entities(float_json::object());
+                       for (auto& ent : items)
+                       {
+                           EntityDB* db = get_type(ent.id);
+                           if (!db)
+                               break;
 
-        std::string dump = textures.dump(2);
-        textures_file.write(dump.data(), dump.size());
-    }
+                           entities[ent.name] = float_json{
+                               {"id", ent.id},
+                               {"texture", db->texture_id},
+                               {"animations", get_animations_as_string_map(*db)}};
+                       }
+                       return entities.dump(2); }));
+    json_outputs.emplace_back(
+        "game_data/textures.json",
+        std::async(std::launch::async, [textures_ptr]()
+                   {
+                       float_json textures(float_json::object());
+                       for (std::size_t i = 0; i < textures_ptr->num_textures; i++)
+                       {
+                           Texture& tex = textures_ptr->textures[i];
+                           if (tex.name != nullptr)
+                           {
+                               textures[std::to_string(tex.id)] = tex;
+                           }
+                       }
+                       return textures.dump(2); }));
+    json_outputs.emplace_back(
+        "game_data/search_flags.json",
+        std::async(std::launch::async, [&items]()
+                   {
+                       float_json search_flags(float_json::object());
+                       for (int i = 0; i < 32; ++i)
+                       {
+                           std::uint32_t search_flag = 1U << i;
+                           std::vector<std::string> entities;
+                           for (auto& ent : items)
+                           {
+                               EntityDB* db = get_type(ent.id);
+                               if (!db)
+                                   break;
+                               if ((std::uint32_t)db->search_flags & search_flag)
+                               {
+                                   entities.push_back(ent.name);
+                               }
+                           }
+                           search_flags[fmt::format("{}", search_flag)] = std::move(entities);
+                       }
+                       return search_flags.dump(2); }));
 
     if (std::ofstream file = std::ofstream("game_data/textures.txt"))
     {
@@ -1208,29 +1379,11 @@ void run()
         }
     }
 
-    if (std::ofstream search_flags_file = std::ofstream("game_data/search_flags.json"))
+    for (auto& [path, dump] : json_outputs)
     {
-        float_json search_flags(float_json::object());
-        for (int i = 0; i < 32; ++i)
-        {
-            std::uint32_t search_flag = 1U << i;
-            std::vector<std::string> entities;
-            for (auto& ent : items)
-            {
-                EntityDB* db = get_type(ent.id);
-                if (!db)
-                    break;
-                if ((std::uint32_t)db->search_flags & search_flag)
-                {
-                    entities.push_back(ent.name);
-                }
-            }
-            search_flags[fmt::format("{}", search_flag)] = std::move(entities);
-        }
-
-        std::string dump = search_flags.dump(2);
-        search_flags_file.write(dump.data(), dump.size());
+        write_if_changed(path, dump.get());
     }
+    write_if_changed("game_data/game_data.bin", dump_game_data_binary(items, textures_ptr), std::ios::binary);
 
     if (auto file = std::ofstream("game_data/entities.txt"))
     {
@@ -1286,6 +1439,11 @@ void run()
         // file << "---@diagnostic disable: lowercase-global,deprecated" << std::endl;
     }
 
+    {
+        SpelunkyConsole api_gen_script(&sound_mgr);
+        write_if_changed("game_data/lua_api.json", api_gen_script.dump_api_json());
+    }
+
     auto level_gen = HeapBase::get_main().level_gen();
 
     if (auto file = std::ofstream("game_data/tile_codes.txt"))
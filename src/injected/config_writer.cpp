@@ -0,0 +1,120 @@
+#include "config_writer.hpp"
+
+#include <filesystem> // for rename, remove
+#include <fstream>    // for ofstream
+#include <utility>    // for move
+
+#include "logger.h"          // for DEBUG
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+ConfigWriter& ConfigWriter::get()
+{
+    // Never destroyed, the detached writer thread may still be waiting on it while statics are torn down
+    static ConfigWriter* writer = new ConfigWriter();
+    return *writer;
+}
+
+void ConfigWriter::write(std::string path, std::string contents)
+{
+    {
+        std::lock_guard guard{lock};
+        pending_path = std::move(path);
+        pending_contents = std::move(contents);
+        pending = true;
+        due = std::chrono::steady_clock::now() + DEBOUNCE;
+        if (!thread.joinable())
+        {
+            // Lives as long as the process, it only ever waits on the condition variable when there is nothing to write
+            thread = std::thread(&ConfigWriter::run, this);
+            thread.detach();
+        }
+    }
+    wake.notify_one();
+}
+
+void ConfigWriter::flush()
+{
+    std::unique_lock guard{lock};
+    if (pending && !writing)
+    {
+        std::string path = std::move(pending_path);
+        std::string contents = std::move(pending_contents);
+        pending = false;
+        writing = true;
+        guard.unlock();
+        write_file(path, contents);
+        guard.lock();
+        writing = false;
+        written.notify_all();
+        // A save that came in meanwhile is left to the writer thread
+        wake.notify_one();
+        return;
+    }
+    written.wait(guard, [this]
+                 { return !pending && !writing; });
+}
+
+void ConfigWriter::drain()
+{
+    // The thread may have been killed holding the lock, then the save is lost either way
+    std::unique_lock guard{lock, std::try_to_lock};
+    if (!guard.owns_lock() || !pending)
+        return;
+    pending = false;
+    write_file(pending_path, pending_contents);
+}
+
+void ConfigWriter::run()
+{
+    ServiceThreads::get().register_current("ConfigWriter", THREAD_POOL::IO);
+    std::unique_lock guard{lock};
+    while (true)
+    {
+        wake.wait(guard, [this]
+                  { return pending && !writing; });
+        // Every save pushes the deadline back, so a burst of saves ends in a single write
+        while (pending && std::chrono::steady_clock::now() < due)
+            wake.wait_until(guard, due);
+        if (!pending || writing)
+            continue;
+
+        std::string path = std::move(pending_path);
+        std::string contents = std::move(pending_contents);
+        pending = false;
+        writing = true;
+        guard.unlock();
+        write_file(path, contents);
+        guard.lock();
+        writing = false;
+        written.notify_all();
+    }
+}
+
+void ConfigWriter::write_file(const std::string& path, const std::string& contents)
+{
+    if (path == last_path && contents == last_written)
+        return;
+
+    // Written next to the file and moved over it, so a crash mid write never leaves a half written config behind
+    const std::string temp_path = path + ".tmp";
+    {
+        // Text mode like the config always was written, so the line endings on disk don't change
+        std::ofstream out(temp_path, std::ios::trunc);
+        out.write(contents.data(), contents.size());
+        if (!out)
+        {
+            DEBUG("Could not write {}", temp_path);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        DEBUG("Could not replace {}: {}", path, ec.message());
+        std::filesystem::remove(temp_path, ec);
+        return;
+    }
+    last_path = path;
+    last_written = contents;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>             // for steady_clock
+#include <condition_variable> // for condition_variable
+#include <mutex>              // for mutex
+#include <string>             // for string
+#include <thread>             // for thread
+
+// Writes the config file on a background thread, so toggling options quickly never waits for the disk
+// Saves that come in quick succession are folded into one write of the latest contents, and contents that match what is already on disk
+// aren't written at all
+class ConfigWriter
+{
+  public:
+    static ConfigWriter& get();
+
+    ConfigWriter(const ConfigWriter&) = delete;
+    ConfigWriter& operator=(const ConfigWriter&) = delete;
+
+    void write(std::string path, std::string contents);
+    // Blocks until the queued contents are on disk, call before reading the file back
+    void flush();
+    // Writes the queued contents on the calling thread without waiting for the writer thread, for the process shutting down
+    void drain();
+
+  private:
+    ConfigWriter() = default;
+
+    // How long to wait for more saves before writing
+    static constexpr std::chrono::milliseconds DEBOUNCE{250};
+
+    void run();
+    void write_file(const std::string& path, const std::string& contents);
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable written;
+    std::thread thread;
+    std::string pending_path;
+    std::string pending_contents;
+    bool pending{false};
+    bool writing{false};
+    std::chrono::steady_clock::time_point due;
+
+    // Only touched by the writer thread, or by flush while it holds the lock and the writer is idle
+    std::string last_path;
+    std::string last_written;
+};
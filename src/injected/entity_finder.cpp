@@ -0,0 +1,117 @@
+#include "entity_finder.hpp"
+
+#include <algorithm> // for transform
+#include <cctype>    // for tolower
+#include <numeric>   // for iota
+
+#include "entity.hpp"    // for Entity, get_entities_ptr
+#include "entity_db.hpp" // for EntityDB, EntityCatalog
+#include "heap_base.hpp" // for HeapBase
+#include "state.hpp"     // for StateMemory
+
+bool EntityFinder::set_query(const EntityFinderQuery& new_query, const EntityCatalog& catalog)
+{
+    if (compiled && new_query == query)
+        return false;
+
+    query = new_query;
+    compiled = true;
+    filter_base = EntityFilter{};
+    filter_base.mask = static_cast<ENTITY_MASK>(query.mask);
+    filter_base.flags = query.flags;
+    filter_base.not_flags = query.not_flags;
+    filter_base.more_flags = query.more_flags;
+    filter_base.not_more_flags = query.not_more_flags;
+
+    types.clear();
+    matches_nothing = false;
+    if (!query.name.empty())
+    {
+        std::string lower_name{query.name};
+        std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), [](unsigned char c)
+                       { return (char)std::tolower(c); });
+        for (size_t i = 0; i < catalog.items.size(); ++i)
+        {
+            const ENT_TYPE id = catalog.items[i].id;
+            if ((query.type == 0 || id == query.type) && catalog.search_keys[i].find(lower_name) != std::string::npos)
+                types.push_back(id);
+        }
+        matches_nothing = types.empty();
+    }
+    else if (query.type != 0)
+    {
+        types.push_back(query.type);
+    }
+    filter_base.set_types(types);
+    resolve_layer();
+    return true;
+}
+
+bool EntityFinder::resolve_layer()
+{
+    const uint8_t layer = query.layer == -128 ? 2 : enum_to_layer(static_cast<LAYER>(query.layer));
+    const bool changed = layer != resolved_layer;
+    resolved_layer = layer;
+    filter_base.layer = layer == 2 ? LAYER::BOTH : static_cast<LAYER>(layer);
+    return changed;
+}
+
+bool EntityFinder::matches(const Entity* entity) const
+{
+    if (entity == nullptr || !filter_base.matches(entity))
+        return false;
+    if (entity->draw_depth < query.min_depth || entity->draw_depth > query.max_depth)
+        return false;
+    const uint32_t entity_properties = static_cast<uint32_t>(entity->type->properties_flags);
+    return (entity_properties & query.properties_flags) == query.properties_flags && (entity_properties & query.not_properties_flags) == 0;
+}
+
+std::vector<uint32_t> EntityFinder::search()
+{
+    resolve_layer();
+    StateMemory* state = HeapBase::get().state();
+    screen_change_counter = state->screen_change_counter;
+    next_uid = state->next_entity_uid;
+    if (matches_nothing)
+        return {};
+
+    // The type and mask already narrow down which lists are walked, the rest is tested in one pass
+    std::vector<uint32_t> uids = ::get_entities_by(types, filter_base.mask, filter_base.layer);
+    filter(uids);
+    return uids;
+}
+
+void EntityFinder::filter(std::vector<uint32_t>& uids)
+{
+    const std::vector<Entity*> entities = get_entities_ptr(uids);
+    size_t kept = 0;
+    for (size_t i = 0; i < uids.size(); ++i)
+    {
+        if (matches(entities[i]))
+            uids[kept++] = uids[i];
+    }
+    uids.resize(kept);
+}
+
+void EntityFinder::update(std::vector<uint32_t>& uids)
+{
+    StateMemory* state = HeapBase::get().state();
+    const uint32_t state_next_uid = state->next_entity_uid;
+    // Uids only ever go up within a level, anything else means the entities were replaced wholesale
+    if (resolve_layer() || state->screen_change_counter != screen_change_counter || state_next_uid < next_uid ||
+        state_next_uid - next_uid > MAX_INCREMENTAL_UIDS)
+    {
+        uids = search();
+        return;
+    }
+
+    filter(uids);
+    if (state_next_uid != next_uid && !matches_nothing)
+    {
+        std::vector<uint32_t> spawned(state_next_uid - next_uid);
+        std::iota(spawned.begin(), spawned.end(), next_uid);
+        filter(spawned);
+        uids.insert(uids.end(), spawned.begin(), spawned.end());
+    }
+    next_uid = state_next_uid;
+}
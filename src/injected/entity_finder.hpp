@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint> // for uint32_t, uint8_t, uint16_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+#include "aliases.hpp"       // for ENT_TYPE
+#include "entity_lookup.hpp" // for EntityFilter
+
+class Entity;
+struct EntityCatalog;
+
+// What the finder searches for, as set in the UI
+struct EntityFinderQuery
+{
+    std::string name;
+    ENT_TYPE type{0};
+    // -128 for both layers, -1 for the layer of the player
+    int layer{-128};
+    int min_depth{0};
+    int max_depth{52};
+    uint32_t mask{0};
+    uint32_t flags{0};
+    uint32_t not_flags{0};
+    uint32_t more_flags{0};
+    uint32_t not_more_flags{0};
+    uint32_t properties_flags{0};
+    uint32_t not_properties_flags{0};
+
+    bool operator==(const EntityFinderQuery&) const = default;
+};
+
+// Entity finder that compiles its query into a single predicate once instead of filtering the results again for every condition
+// The text filter is turned into a set of types up front, so no entity name is compared during a search
+class EntityFinder
+{
+  public:
+    // Returns true if the query differs from the last one and was compiled again
+    bool set_query(const EntityFinderQuery& new_query, const EntityCatalog& catalog);
+
+    // Full search over the entity lists of the layer
+    std::vector<uint32_t> search();
+    // Drops the uids that don't exist anymore or don't match
+    void filter(std::vector<uint32_t>& uids);
+    // Keeps the results of the last search live, appends the entities spawned since the last call and drops the ones that are gone
+    // or don't match anymore, searches everything again only when the level or the searched layer changed
+    void update(std::vector<uint32_t>& uids);
+
+  private:
+    bool matches(const Entity* entity) const;
+    // Resolves the layer of the query, which can follow the player, returns true if it changed
+    bool resolve_layer();
+
+    static constexpr uint32_t MAX_INCREMENTAL_UIDS = 0x4000;
+
+    EntityFinderQuery query;
+    bool compiled{false};
+    EntityFilter filter_base;
+    std::vector<ENT_TYPE> types;
+    bool matches_nothing{false};
+
+    uint8_t resolved_layer{0};
+    uint16_t screen_change_counter{0};
+    uint32_t next_uid{0};
+};
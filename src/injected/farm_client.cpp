@@ -0,0 +1,96 @@
+#include "farm_client.hpp"
+
+#include <Windows.h> // for CreateFileA, ReadFile, WriteFile, GetEnvironmentVariableA
+#include <thread>    // for thread
+#include <utility>   // for move
+
+#include "logger.h"          // for DEBUG
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+FarmClient* FarmClient::get()
+{
+    // Never destroyed, the thread lives as long as the game and the launcher kills the game when it's done
+    static FarmClient* client = []() -> FarmClient*
+    {
+        char pipe_name[MAX_PATH]{};
+        if (GetEnvironmentVariableA("OVERLUNKY_FARM_PIPE", pipe_name, sizeof(pipe_name)) == 0)
+            return nullptr;
+        HANDLE pipe = CreateFileA(pipe_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE)
+        {
+            DEBUG("Couldn't connect to farm pipe {}: {}", pipe_name, GetLastError());
+            return nullptr;
+        }
+        DEBUG("Connected to farm pipe {}", pipe_name);
+        return new FarmClient(pipe);
+    }();
+    return client;
+}
+
+FarmClient::FarmClient(void* pipe_)
+    : pipe{pipe_}
+{
+    std::thread{&FarmClient::run, this}.detach();
+}
+
+std::optional<std::string> FarmClient::take_job()
+{
+    std::lock_guard guard{lock};
+    if (jobs.empty())
+        return std::nullopt;
+    std::string job = std::move(jobs.front());
+    jobs.pop_front();
+    return job;
+}
+
+void FarmClient::send_result(std::string new_result)
+{
+    {
+        std::lock_guard guard{lock};
+        result = std::move(new_result);
+    }
+    result_ready.notify_one();
+}
+
+void FarmClient::run()
+{
+    ServiceThreads::get().register_current("FarmClient", THREAD_POOL::NETWORK);
+    // Reads and writes take turns on the one synchronous handle, a blocking read would hold up a write from another thread
+    std::string buffer;
+    while (true)
+    {
+        size_t end;
+        while ((end = buffer.find('\n')) == std::string::npos)
+        {
+            char chunk[0x1000];
+            DWORD bytes;
+            if (!ReadFile(pipe, chunk, sizeof(chunk), &bytes, NULL) || bytes == 0)
+            {
+                DEBUG("Farm pipe closed");
+                return;
+            }
+            buffer.append(chunk, bytes);
+        }
+        {
+            std::lock_guard guard{lock};
+            jobs.push_back(buffer.substr(0, end));
+        }
+        buffer.erase(0, end + 1);
+
+        std::string line;
+        {
+            std::unique_lock guard{lock};
+            result_ready.wait(guard, [this]()
+                              { return result.has_value(); });
+            line = std::move(result.value());
+            result.reset();
+        }
+        line += '\n';
+        DWORD written;
+        if (!WriteFile(pipe, line.data(), (DWORD)line.size(), &written, NULL))
+        {
+            DEBUG("Farm pipe closed");
+            return;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <condition_variable> // for condition_variable
+#include <deque>              // for deque
+#include <mutex>              // for mutex
+#include <optional>           // for optional
+#include <string>             // for string
+
+// The game side of the launcher's --farm mode, talks to the pipe named in OVERLUNKY_FARM_PIPE on a background thread
+// The launcher sends one json job per line and waits for one json result line before it sends the next one
+class FarmClient
+{
+  public:
+    // Connects once, nullptr if this game wasn't started by a farm or the pipe is gone
+    static FarmClient* get();
+
+    // The next job if one came in, doesn't block
+    std::optional<std::string> take_job();
+    // Answers the job taken last
+    void send_result(std::string result);
+
+  private:
+    FarmClient(void* pipe);
+
+    void run();
+
+    void* pipe;
+    std::mutex lock;
+    std::condition_variable result_ready;
+    std::deque<std::string> jobs;
+    std::optional<std::string> result;
+};
@@ -0,0 +1,152 @@
+#include "fuzzy_search.hpp"
+
+#include <algorithm> // for sort, min, equal
+#include <cctype>    // for tolower
+#include <climits>   // for INT32_MIN
+#include <utility>   // for move
+
+namespace
+{
+char fold(char c)
+{
+    return (char)std::tolower((unsigned char)c);
+}
+bool is_word_start(std::string_view key, size_t pos)
+{
+    return pos == 0 || key[pos - 1] == '_' || key[pos - 1] == ' ';
+}
+bool is_subsequence(std::string_view query, std::string_view key)
+{
+    size_t pos = 0;
+    for (char c : query)
+    {
+        pos = key.find(c, pos);
+        if (pos == std::string_view::npos)
+            return false;
+        pos++;
+    }
+    return true;
+}
+} // namespace
+
+uint64_t FuzzySearchIndex::signature_of(std::string_view str)
+{
+    // a-z and 0-9 get a bit each, everything else shares the last one
+    uint64_t signature = 0;
+    for (char c : str)
+    {
+        if (c >= 'a' && c <= 'z')
+            signature |= 1ull << (c - 'a');
+        else if (c >= '0' && c <= '9')
+            signature |= 1ull << (26 + c - '0');
+        else
+            signature |= 1ull << 63;
+    }
+    return signature;
+}
+
+void FuzzySearchIndex::build(const std::vector<std::string>& names, std::string_view prefix)
+{
+    entries.clear();
+    entries.reserve(names.size());
+    for (const std::string& name : names)
+    {
+        std::string key;
+        key.reserve(name.size());
+        for (char c : name)
+            key.push_back(fold(c));
+        if (!prefix.empty() && key.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), key.begin(), [](char a, char b)
+                                                                         { return fold(a) == b; }))
+            key.erase(0, prefix.size());
+        const uint64_t signature = signature_of(key);
+        entries.push_back({std::move(key), signature});
+    }
+    last_query.clear();
+    last_matches.clear();
+    last_result.clear();
+}
+
+int32_t FuzzySearchIndex::score(std::string_view query, std::string_view key)
+{
+    if (const size_t pos = key.find(query); pos != std::string_view::npos)
+    {
+        // Whole substring, ranked above any scattered match, best at the start of a word and in short names
+        return 1000 + (pos == 0 ? 200 : 0) + (is_word_start(key, pos) ? 100 : 0) - (int32_t)key.size();
+    }
+
+    if (!is_subsequence(query, key))
+        return INT32_MIN;
+
+    int32_t total = 0;
+    size_t pos = 0;
+    size_t last_match = std::string_view::npos;
+    for (size_t i = 0; i < query.size(); ++i)
+    {
+        const char c = query[i];
+        size_t found = key.find(c, pos);
+        // Prefer a later occurrence that starts a word, as long as the rest of the query still fits after it
+        for (size_t next = found; next != std::string_view::npos && !is_word_start(key, found); next = key.find(c, next + 1))
+        {
+            if (is_word_start(key, next) && is_subsequence(query.substr(i + 1), key.substr(next + 1)))
+                found = next;
+        }
+
+        total += 10;
+        if (is_word_start(key, found))
+            total += 8;
+        if (last_match != std::string_view::npos)
+        {
+            if (found == last_match + 1)
+                total += 6;
+            else
+                total -= std::min<int32_t>((int32_t)(found - last_match - 1), 5);
+        }
+        last_match = found;
+        pos = found + 1;
+    }
+    return total - (int32_t)key.size() / 4;
+}
+
+const std::vector<uint32_t>& FuzzySearchIndex::search(std::string_view query)
+{
+    std::string folded;
+    folded.reserve(query.size());
+    for (char c : query)
+        folded.push_back(fold(c));
+
+    if (!last_result.empty() && folded == last_query)
+        return last_result;
+
+    const uint64_t needed = signature_of(folded);
+    std::vector<Match> matches;
+    auto try_match = [&](uint32_t index)
+    {
+        const Entry& entry = entries[index];
+        if ((entry.signature & needed) != needed)
+            return;
+        if (const int32_t entry_score = score(folded, entry.key); entry_score != INT32_MIN)
+            matches.push_back({index, entry_score});
+    };
+
+    // Anything the longer query matches the shorter one matched too, so only those are scored again
+    if (!last_query.empty() && folded.size() > last_query.size() && folded.starts_with(last_query))
+    {
+        for (const Match& previous : last_matches)
+            try_match(previous.index);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < entries.size(); ++i)
+            try_match(i);
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b)
+              { return a.score != b.score ? a.score > b.score : a.index < b.index; });
+
+    last_query = std::move(folded);
+    last_matches = std::move(matches);
+    last_result.clear();
+    for (const Match& match : last_matches)
+        last_result.push_back(match.index);
+    return last_result;
+}
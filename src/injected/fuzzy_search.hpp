@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>     // for uint32_t, uint64_t
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+// Ranked fuzzy search over a fixed list of names, the query matches a name if its characters appear in it in order ("mgjf" finds MEGAJELLYFISH)
+// Every name gets a signature of the characters it contains when the index is built, so most names are rejected with a single bit test,
+// and a query that extends the previous one only looks at what the previous one matched
+class FuzzySearchIndex
+{
+  public:
+    // `prefix` is cut from the names before matching, e.g. "ENT_TYPE_"
+    void build(const std::vector<std::string>& names, std::string_view prefix = {});
+
+    // Indices of the matching names, best match first, names that score the same keep their order
+    const std::vector<uint32_t>& search(std::string_view query);
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    struct Entry
+    {
+        std::string key;
+        uint64_t signature;
+    };
+    struct Match
+    {
+        uint32_t index;
+        int32_t score;
+    };
+
+    static uint64_t signature_of(std::string_view str);
+    // Score of `query` against `key`, or INT32_MIN if it doesn't match
+    static int32_t score(std::string_view query, std::string_view key);
+
+    std::vector<Entry> entries;
+
+    std::string last_query;
+    std::vector<Match> last_matches;
+    std::vector<uint32_t> last_result;
+};
@@ -15,13 +15,15 @@
 #include <utility>      // for max, min
 #include <vector>       // for vector
 
-#include "entity.hpp"     // for EntityItem, list_entities
-#include "logger.h"       // for DEBUG
-#include "render_api.hpp" // for RenderAPI
-#include "search.hpp"     // for preload_addresses, register_application_ve...
-#include "ui.hpp"         // for create_box, init_ui
-#include "version.hpp"    // for get_version
-#include "window_api.hpp" // for init_hooks
+#include "async_file_writer.hpp" // for AsyncFileWriter
+#include "config_writer.hpp"     // for ConfigWriter
+#include "entity.hpp"            // for EntityItem, list_entities, get_entity_type_count
+#include "logger.h"              // for DEBUG
+#include "render_api.hpp"        // for RenderAPI
+#include "search.hpp"            // for preload_addresses, register_application_ve...
+#include "ui.hpp"                // for create_box, init_ui
+#include "version.hpp"           // for get_version
+#include "window_api.hpp"        // for init_hooks
 
 using namespace std::chrono_literals;
 
@@ -83,6 +85,7 @@ BOOL WINAPI ctrl_handler(DWORD ctrl_type)
     case CTRL_CLOSE_EVENT:
     {
         DEBUG("Console detached, you can now close this window.");
+        LogSink::get().flush();
         FreeConsole();
         return TRUE;
     }
@@ -113,22 +116,27 @@ void run()
     }
 
     register_application_version(fmt::format("Overlunky {}", get_version()));
-    preload_addresses();
+    // Opt-in, mostly useful for setups that restart the game a lot
+    char address_cache[MAX_PATH]{};
+    size_t address_cache_size{0};
+    getenv_s(&address_cache_size, address_cache, "OVERLUNKY_ADDRESS_CACHE");
+    preload_addresses(true, address_cache_size > 0 ? std::string_view{address_cache} : ""sv);
 
     while (true)
     {
-        auto entities = list_entities();
-        if (entities.size() >= 876)
+        // The catalog is built once from whatever the factory has, so wait for the game to fill it first
+        const size_t num_entities = get_entity_type_count();
+        if (num_entities >= 876)
         {
-            DEBUG("Found {} entities, that's enough", entities.size());
+            DEBUG("Found {} entities, that's enough", num_entities);
             std::this_thread::sleep_for(100ms);
-            create_box(entities);
-            DEBUG("Added {} entities", entities.size());
+            create_box(list_entities());
+            DEBUG("Added {} entities", num_entities);
             break;
         }
-        else if (entities.size() > 0)
+        else if (num_entities > 0)
         {
-            DEBUG("Found {} entities", entities.size());
+            DEBUG("Found {} entities", num_entities);
         }
         std::this_thread::sleep_for(100ms);
     }
@@ -151,5 +159,11 @@ BOOL WINAPI DllMain([[maybe_unused]] HINSTANCE hinst, DWORD dwReason, [[maybe_un
         std::thread thr(run);
         thr.detach();
     }
+    else if (dwReason == DLL_PROCESS_DETACH)
+    {
+        // The game can exit without destroying its window, the other threads are gone by now
+        AsyncFileWriter::get().drain();
+        ConfigWriter::get().drain();
+    }
     return TRUE;
 }
@@ -0,0 +1,95 @@
+#include "script_watcher.hpp"
+
+#include <Windows.h> // for ReadDirectoryChangesW, CreateFileW, FILE_NOTIFY_INFORMATION, ...
+#include <array>     // for array
+#include <utility>   // for move
+
+#include "thread_policy.hpp" // for ServiceThreads, THREAD_POOL
+
+DirectoryWatcher::DirectoryWatcher(std::filesystem::path dir_, bool recursive_)
+    : dir{std::move(dir_)}, recursive{recursive_}
+{
+    HANDLE handle = CreateFileW(
+        dir.wstring().c_str(),
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+
+    dir_handle = handle;
+    stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    thread = std::thread{&DirectoryWatcher::run, this};
+}
+DirectoryWatcher::~DirectoryWatcher()
+{
+    if (dir_handle == nullptr)
+        return;
+
+    SetEvent(stop_event);
+    if (thread.joinable())
+        thread.join();
+    CloseHandle(stop_event);
+    CloseHandle(dir_handle);
+}
+
+bool DirectoryWatcher::take_changes(std::vector<std::filesystem::path>& changed)
+{
+    std::lock_guard lock{changes_lock};
+    changed = std::move(changes);
+    changes.clear();
+    const bool complete = !overflowed;
+    overflowed = false;
+    return complete;
+}
+
+void DirectoryWatcher::run()
+{
+    ServiceThreads::get().register_current("DirectoryWatcher", THREAD_POOL::IO);
+    constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+    alignas(DWORD) std::array<char, 64 * 1024> buffer;
+
+    OVERLAPPED overlapped{};
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    const HANDLE events[]{stop_event, overlapped.hEvent};
+    while (true)
+    {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(dir_handle, buffer.data(), static_cast<DWORD>(buffer.size()), recursive, filter, nullptr, &overlapped, nullptr))
+            break;
+
+        if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+        {
+            CancelIo(dir_handle);
+            DWORD ignored;
+            GetOverlappedResult(dir_handle, &overlapped, &ignored, TRUE);
+            break;
+        }
+
+        DWORD bytes{0};
+        if (!GetOverlappedResult(dir_handle, &overlapped, &bytes, FALSE))
+            break;
+
+        std::lock_guard lock{changes_lock};
+        if (bytes == 0)
+        {
+            // The buffer overflowed and the system threw the changes away
+            overflowed = true;
+            continue;
+        }
+
+        const char* entry = buffer.data();
+        while (true)
+        {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry);
+            changes.emplace_back(std::wstring_view{info->FileName, info->FileNameLength / sizeof(WCHAR)});
+            if (info->NextEntryOffset == 0)
+                break;
+            entry += info->NextEntryOffset;
+        }
+    }
+    CloseHandle(overlapped.hEvent);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem> // for path
+#include <mutex>      // for mutex
+#include <thread>     // for thread
+#include <vector>     // for vector
+
+// Collects changes to the files in a directory on a background thread with ReadDirectoryChangesW
+class DirectoryWatcher
+{
+  public:
+    DirectoryWatcher(std::filesystem::path dir, bool recursive);
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    bool is_watching() const
+    {
+        return dir_handle != nullptr;
+    }
+    const std::filesystem::path& get_dir() const
+    {
+        return dir;
+    }
+
+    // Files that were added, removed, renamed or written since the last call, relative to the watched directory
+    // Returns false if changes were lost because too many happened at once, the directory should be rescanned then
+    bool take_changes(std::vector<std::filesystem::path>& changed);
+
+  private:
+    void run();
+
+    std::filesystem::path dir;
+    bool recursive;
+    void* dir_handle{nullptr};
+    void* stop_event{nullptr};
+    std::thread thread;
+
+    std::mutex changes_lock;
+    std::vector<std::filesystem::path> changes;
+    bool overflowed{false};
+};
@@ -14,19 +14,25 @@
 #include <charconv>
 #include <chrono>
 #include <codecvt>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <locale>
 #include <map>
 #include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_set>
 
 #pragma warning(push, 0)
 #include <toml.hpp>
 #pragma warning(pop)
 #include <fmt/chrono.h>
 #include <fmt/core.h>
+#include <nlohmann/json.hpp>
 
 #include "olfont.h"
 
@@ -40,9 +46,13 @@
 #include "entities_mounts.hpp"
 #include "file_api.hpp"
 #include "flags.hpp"
+#include "frame_limiter.hpp"
 #include "game_api.hpp"
+#include "game_heap_stats.hpp"
 #include "game_manager.hpp"
+#include "heap_base.hpp"
 #include "illumination.hpp"
+#include "input_replay.hpp"
 #include "items.hpp"
 #include "level_api.hpp"
 #include "liquid_engine.hpp"
@@ -55,15 +65,33 @@
 #include "socket.hpp"
 #include "sound_manager.hpp" // TODO: remove from here?
 #include "state.hpp"
+#include "state_feed.hpp"
 #include "state_structs.hpp"
 #include "steam_api.hpp"
+#include "strings.hpp"
+#include "turbo.hpp"
 #include "version.hpp"
 #include "window_api.hpp"
 
+#include "config_writer.hpp"
 #include "decode_audio_file.hpp"
+#include "entity_finder.hpp"
+#include "farm_client.hpp"
+#include "fuzzy_search.hpp"
 
 #include "render_api.hpp"
 #include "script/usertypes/vanilla_render_lua.hpp"
+#include "script/callback_profiler.hpp"
+#include "script/lua_bytecode_cache.hpp"
+#include "script/lua_gc.hpp"
+#include "script/lua_idle.hpp"
+#include "script/lua_memory.hpp"
+#include "script/script_util.hpp"
+#include "frame_telemetry.hpp"
+#include "gpu_timing.hpp"
+#include "level_gen_stats.hpp"
+#include "script_watcher.hpp"
+#include "thread_policy.hpp"
 
 #pragma warning(disable : 4366)
 
@@ -78,10 +106,43 @@ std::unique_ptr<SoundManager> g_SoundManager;
 std::unique_ptr<SpelunkyConsole> g_Console;
 std::deque<ScriptMessage> g_ConsoleMessages;
 
+// Characters of the game strings in the current language and the custom strings, the asian fonts only bake these instead of their full ranges
+ImFontGlyphRangesBuilder g_font_used_glyphs;
+// Characters seen in script messages and typed text, they are kept so rebuilding the atlas doesn't drop them again
+ImFontGlyphRangesBuilder g_font_extra_glyphs;
+bool g_font_extra_missing = false;
+
+void add_font_glyph(unsigned int c)
+{
+    if (c < 0x80 || c > IM_UNICODE_CODEPOINT_MAX || g_font_extra_glyphs.GetBit((ImWchar)c))
+        return;
+    g_font_extra_glyphs.AddChar((ImWchar)c);
+    if (!g_font_used_glyphs.GetBit((ImWchar)c))
+        g_font_extra_missing = true;
+}
+void add_font_glyphs(std::string_view utf8)
+{
+    const char* it = utf8.data();
+    const char* end = it + utf8.size();
+    while (it < end)
+    {
+        unsigned int c;
+        const int length = ImTextCharFromUtf8(&c, it, end);
+        if (length == 0)
+            break;
+        add_font_glyph(c);
+        it += length;
+    }
+}
+
 std::map<std::string, std::unique_ptr<SpelunkyScript>> g_scripts;
 std::map<std::string, std::unique_ptr<SpelunkyScript>> g_ui_scripts;
 std::vector<std::filesystem::path> g_script_files;
 std::vector<std::string> g_script_autorun;
+std::unique_ptr<DirectoryWatcher> g_scripts_watcher;
+std::unique_ptr<DirectoryWatcher> g_packs_watcher;
+// Changed script files and when they were last changed, editors tend to write a file more than once when saving
+std::map<std::string, std::chrono::steady_clock::time_point> g_pending_script_changes;
 ScriptImage g_cursor;
 
 std::map<std::string, int64_t> default_keys{
@@ -238,6 +299,20 @@ std::map<std::string, int64_t> default_keys{
 
 auto keys = default_keys;
 
+// Every keycode something is bound to, key events that aren't in here skip the whole process_keys chain
+std::unordered_set<uint64_t> g_bound_keycodes;
+
+// Has to run after every change to keys, they all go through load_config or save_config
+void compile_key_bindings()
+{
+    g_bound_keycodes.clear();
+    for (const auto& [name, keycode] : keys)
+    {
+        if ((keycode & 0xff) != 0)
+            g_bound_keycodes.insert((unsigned)keycode);
+    }
+}
+
 struct Window
 {
     std::string name;
@@ -273,6 +348,9 @@ unsigned int g_level_width = 0, grid_x = 0, grid_y = 0;
 uint8_t g_level = 1, g_world = 1, g_to = 0;
 uint32_t g_held_flags = 0, g_dark_mode = 0, g_last_kit_spawn = 0;
 std::vector<EntityItem> g_items;
+// Built from g_items when they're loaded, the spawner filter never scans the whole list
+FuzzySearchIndex g_items_index;
+std::map<uint32_t, int> g_items_by_id;
 std::vector<int> g_filtered_items;
 struct Kit
 {
@@ -295,8 +373,18 @@ StateMemory* g_state = 0;
 SaveData* g_save = 0;
 GameManager* g_game_manager = 0;
 Bucket* g_bucket = 0;
-std::map<int, std::string> entity_names;
-std::map<int, std::string> entity_full_names;
+// Looks the names up in the entity catalog instead of keeping a copy, ids without a type have an empty name
+struct EntityNameLookup
+{
+    bool full;
+    const std::string& operator[](ENT_TYPE id) const
+    {
+        const EntityCatalog& catalog = get_entity_catalog();
+        return full ? catalog.full_name(id) : catalog.short_name(id);
+    }
+};
+const EntityNameLookup entity_names{false};
+const EntityNameLookup entity_full_names{true};
 std::string active_tab = "", activate_tab = "", detach_tab = "", focused_tool = "", g_load_void = "";
 std::vector<std::string> tab_order = {"tool_entity", "tool_door", "tool_camera", "tool_entity_properties", "tool_game_properties", "tool_save", "tool_finder", "tool_script", "tool_texture", "tool_options", "tool_style", "tool_keys", "tool_debug"};
 std::vector<std::string> tab_order_main = {"tool_entity", "tool_door", "tool_camera", "tool_entity_properties", "tool_game_properties", "tool_save", "tool_finder", "tool_script", "tool_options"};
@@ -378,6 +466,7 @@ std::map<std::string, bool> options = {
     {"borders", false},
     {"console_alt_keys", false},
     {"vsync", true},
+    {"low_latency", false},
     {"uncap_unfocused_fps", true},
     {"pause_update_camera", true},
     {"pause_last_instance", true},
@@ -385,6 +474,8 @@ std::map<std::string, bool> options = {
     {"modifiers_clear_input", true},
     {"load_scripts", true},
     {"load_packs", false},
+    {"hot_reload_scripts", false},
+    {"font_all_glyphs", false},
 };
 
 double g_engine_fps = 60.0, g_unfocused_fps = 33.0;
@@ -728,6 +819,18 @@ void load_script(std::wstring wfile, bool enable = true)
     }
 }
 
+// Runs the changed file in the scripts environment again, keeping its entity hooks and user data
+void hot_reload_script(SpelunkyScript& script, const std::filesystem::path& path)
+{
+    std::ifstream data(path, std::ios::in | std::ios::binary);
+    std::ostringstream buf;
+    if (!data.fail())
+    {
+        buf << data.rdbuf();
+        script.hot_reload(buf.str());
+    }
+}
+
 std::string key_string(int64_t keycode)
 {
     UCHAR virtualKey = keycode & 0xff;
@@ -804,7 +907,22 @@ bool SliderByte(const char* label, char* value, char min = 0, char max = 0, cons
     return ImGui::SliderScalar(label, ImGuiDataType_U8, value, &min, &max, format);
 }
 
-void refresh_script_files()
+void update_script_watchers()
+{
+    const bool watch_scripts = options["load_scripts"] && std::filesystem::is_directory(scriptpath);
+    if (!watch_scripts)
+        g_scripts_watcher.reset();
+    else if (!g_scripts_watcher || g_scripts_watcher->get_dir() != std::filesystem::path(scriptpath))
+        g_scripts_watcher = std::make_unique<DirectoryWatcher>(scriptpath, false);
+
+    const bool watch_packs = options["load_packs"] && std::filesystem::is_directory("Mods/Packs");
+    if (!watch_packs)
+        g_packs_watcher.reset();
+    else if (!g_packs_watcher)
+        g_packs_watcher = std::make_unique<DirectoryWatcher>("Mods/Packs", true);
+}
+
+void refresh_script_files(bool precompile = true)
 {
     g_script_files.clear();
     if (options["load_scripts"] && std::filesystem::exists(scriptpath) && std::filesystem::is_directory(scriptpath))
@@ -822,7 +940,7 @@ void refresh_script_files()
         std::vector<std::string> unload_scripts;
         for (const auto& script : g_scripts)
         {
-            if (!script.second->is_enabled() && std::filesystem::equivalent(std::filesystem::path(script.second->get_path()), std::filesystem::path(scriptpath)))
+            if (!script.second->is_enabled() && std::filesystem::path(script.second->get_path()).lexically_normal() == std::filesystem::path(scriptpath).lexically_normal())
             {
                 unload_scripts.push_back(script.second->get_file());
             }
@@ -850,7 +968,7 @@ void refresh_script_files()
         std::vector<std::string> unload_scripts;
         for (const auto& script : g_scripts)
         {
-            if (!script.second->is_enabled() && std::filesystem::equivalent(std::filesystem::path(script.second->get_path()).parent_path(), std::filesystem::path("Mods/Packs")))
+            if (!script.second->is_enabled() && std::filesystem::path(script.second->get_path()).parent_path().lexically_normal() == std::filesystem::path("Mods/Packs").lexically_normal())
             {
                 unload_scripts.push_back(script.second->get_file());
             }
@@ -863,21 +981,254 @@ void refresh_script_files()
         }
     }
 
+    // Compiling is the slow part with many scripts and can be done on all cores, running them can't
+    if (precompile)
+        precompile_lua_scripts(g_script_files);
     for (auto& file : g_script_files)
     {
         load_script(file.wstring(), false);
     }
+
+    update_script_watchers();
+}
+
+std::string script_file_key(const std::filesystem::path& file)
+{
+    std::string key = cvt.to_bytes(file.wstring());
+    std::replace(key.begin(), key.end(), '\\', '/');
+    return key;
+}
+
+// Applies the changes the watchers saw to g_script_files and g_scripts, instead of rescanning the folders
+void process_script_changes()
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::filesystem::path> changed;
+    if (g_scripts_watcher)
+    {
+        if (!g_scripts_watcher->take_changes(changed))
+        {
+            refresh_script_files();
+            return;
+        }
+        for (auto& file : changed)
+        {
+            if (file.extension() == ".lua" && !file.has_parent_path())
+                g_pending_script_changes[script_file_key(std::filesystem::path(scriptpath) / file)] = now;
+        }
+    }
+    if (g_packs_watcher)
+    {
+        if (!g_packs_watcher->take_changes(changed))
+        {
+            refresh_script_files();
+            return;
+        }
+        for (auto& file : changed)
+        {
+            if (file.extension() != ".lua" || file.begin() == file.end())
+                continue;
+            if (file.filename() == "main.lua")
+            {
+                g_pending_script_changes[script_file_key(std::filesystem::path("Mods/Packs") / file)] = now;
+            }
+            else
+            {
+                // Some module of a pack, reload the pack that could be requiring it
+                g_pending_script_changes[script_file_key(std::filesystem::path("Mods/Packs") / *file.begin() / "main.lua")] = now;
+            }
+        }
+    }
+
+    static constexpr auto settle_time = std::chrono::milliseconds(250);
+    for (auto it = g_pending_script_changes.begin(); it != g_pending_script_changes.end();)
+    {
+        if (now - it->second < settle_time)
+        {
+            ++it;
+            continue;
+        }
+
+        const std::string file = it->first;
+        it = g_pending_script_changes.erase(it);
+
+        const std::filesystem::path path{cvt.from_bytes(file)};
+        auto known = std::find_if(g_script_files.begin(), g_script_files.end(), [&](const std::filesystem::path& script_file)
+                                  { return script_file_key(script_file) == file; });
+        auto loaded = g_scripts.find(file);
+        if (!std::filesystem::is_regular_file(path))
+        {
+            if (known != g_script_files.end())
+                g_script_files.erase(known);
+            if (loaded != g_scripts.end() && !loaded->second->is_enabled())
+                g_scripts.erase(loaded);
+            continue;
+        }
+
+        if (known == g_script_files.end())
+            g_script_files.push_back(path);
+        const bool enabled = loaded != g_scripts.end() && loaded->second->is_enabled();
+        if (enabled && options["hot_reload_scripts"])
+            hot_reload_script(*loaded->second, path);
+        else
+            load_script(path.wstring(), enabled);
+    }
 }
 
-void autorun_scripts()
+// Startup is staged so nothing waits on the scripts: the hooks are in after init_ui, the ui draws its first frame right
+// after imgui_init and the autorun scripts are compiled on a background thread meanwhile, to be run once they're in the cache
+struct StartupTimes
+{
+    int64_t started{0};
+    // From init_ui to the first frame the ui drew, -1 until then
+    float interactive_ms{-1.0f};
+    // From init_ui to when every autorun script ran for the first time, -1 until then
+    float scripts_ms{-1.0f};
+    size_t scripts{0};
+};
+StartupTimes g_startup;
+
+struct AutorunScript
 {
+    std::string file;
+    // Ids of the scripts it imports, found in the source before it ran
+    std::vector<std::string> imports;
+};
+std::future<std::vector<AutorunScript>> g_autorun_compiled;
+std::vector<std::string> g_autorun_running;
+
+// Only the literal ids, good enough to order the scripts, import still works for anything this misses
+std::vector<std::string> find_imported_ids(std::string_view code)
+{
+    std::vector<std::string> ids;
+    size_t pos = 0;
+    while ((pos = code.find("import", pos)) != std::string_view::npos)
+    {
+        pos += 6;
+        const size_t start = code.find_first_not_of(" \t(", pos);
+        if (start == std::string_view::npos || (code[start] != '"' && code[start] != '\''))
+            continue;
+        const size_t end = code.find(code[start], start + 1);
+        if (end == std::string_view::npos)
+            break;
+        ids.push_back(sanitize(std::string{code.substr(start + 1, end - start - 1)}));
+        pos = end + 1;
+    }
+    return ids;
+}
+
+void start_autorun_scripts()
+{
+    std::vector<std::filesystem::path> autorun;
+    std::vector<std::string> autorun_keys;
     for (auto& file : g_script_autorun)
     {
         std::string script = scriptpath + "/" + file;
         if (std::filesystem::exists(script) && std::filesystem::is_regular_file(script))
         {
-            load_script(script, true);
+            autorun.push_back(script);
+            std::replace(script.begin(), script.end(), '\\', '/');
+            autorun_keys.push_back(std::move(script));
+        }
+    }
+    std::vector<std::filesystem::path> others;
+    for (auto& file : g_script_files)
+    {
+        if (std::find(autorun_keys.begin(), autorun_keys.end(), script_file_key(file)) == autorun_keys.end())
+            others.push_back(file);
+    }
+    g_startup.scripts = autorun.size();
+
+    std::promise<std::vector<AutorunScript>> compiled;
+    g_autorun_compiled = compiled.get_future();
+    std::thread(
+        [compiled = std::move(compiled), autorun = std::move(autorun), autorun_keys = std::move(autorun_keys), others = std::move(others)]() mutable
+        {
+            ServiceThreads::get().register_current("ScriptCompiler", THREAD_POOL::WORKER);
+            precompile_lua_scripts(autorun);
+
+            std::vector<AutorunScript> scripts;
+            for (size_t i = 0; i < autorun.size(); ++i)
+            {
+                std::ifstream data(autorun[i], std::ios::in | std::ios::binary);
+                std::ostringstream buf;
+                buf << data.rdbuf();
+                scripts.push_back(AutorunScript{std::move(autorun_keys[i]), find_imported_ids(buf.str())});
+            }
+            compiled.set_value(std::move(scripts));
+
+            // The rest is only cached for when they're enabled from the ui, after the autorun scripts could start
+            precompile_lua_scripts(others);
+        })
+        .detach();
+}
+
+// Loads imported scripts first, the import would otherwise start the disabled copy from refresh_script_files and autorun a second one
+void load_autorun_scripts(const std::vector<AutorunScript>& scripts)
+{
+    std::vector<std::string> ids;
+    for (auto& script : scripts)
+    {
+        auto it = g_scripts.find(script.file);
+        ids.push_back(it != g_scripts.end() ? it->second->get_id() : "");
+    }
+
+    std::vector<bool> visited(scripts.size(), false);
+    std::vector<size_t> order;
+    std::function<void(size_t)> visit = [&](size_t i)
+    {
+        // Also where a cycle stops, those keep the order of the autorun list
+        if (visited[i])
+            return;
+        visited[i] = true;
+        for (auto& imported : scripts[i].imports)
+        {
+            for (size_t j = 0; j < ids.size(); ++j)
+            {
+                if (j != i && ids[j] == imported)
+                    visit(j);
+            }
         }
+        order.push_back(i);
+    };
+    for (size_t i = 0; i < scripts.size(); ++i)
+        visit(i);
+
+    // The backends update in the order they were made, so this is also the order they first run in
+    for (size_t i : order)
+    {
+        load_script(scripts[i].file, true);
+        g_autorun_running.push_back(scripts[i].file);
+    }
+}
+
+// Called every frame by imgui_draw, moves the startup along and takes its times
+void update_autorun_scripts()
+{
+    if (g_startup.interactive_ms < 0.0f)
+    {
+        g_startup.interactive_ms = FrameTelemetry::ticks_to_ms(FrameTelemetry::now() - g_startup.started);
+        INFO("Startup: ui interactive after {:.0f} ms", g_startup.interactive_ms);
+    }
+    if (g_startup.scripts_ms >= 0.0f)
+        return;
+
+    if (g_autorun_compiled.valid())
+    {
+        if (g_autorun_compiled.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        load_autorun_scripts(g_autorun_compiled.get());
+    }
+
+    // A script runs on the next update after it was loaded, or right away if it was imported
+    std::erase_if(g_autorun_running, [](const std::string& file)
+                  {
+                      auto it = g_scripts.find(file);
+                      return it == g_scripts.end() || !it->second->is_enabled() || !it->second->is_changed(); });
+    if (g_autorun_running.empty())
+    {
+        g_startup.scripts_ms = FrameTelemetry::ticks_to_ms(FrameTelemetry::now() - g_startup.started);
+        INFO("Startup: {} autorun scripts ran after {:.0f} ms", g_startup.scripts, g_startup.scripts_ms);
     }
 }
 
@@ -889,7 +1240,8 @@ void update_frametimes()
 
 void save_config(std::string file)
 {
-    std::ofstream writeData(file);
+    compile_key_bindings();
+    std::ostringstream writeData;
     writeData << "# Overlunky hotkeys" << std::endl
               << "# Syntax:" << std::endl
               << "# function = keycode_in_hex" << std::endl
@@ -1031,11 +1383,13 @@ void save_config(std::string file)
 
     writeData << "tab_active = \"" << active_tab << "\"" << std::endl;
 
-    writeData.close();
+    ConfigWriter::get().write(std::move(file), writeData.str());
 }
 
 void load_config(std::string file)
 {
+    // A save may still be waiting to be written
+    ConfigWriter::get().flush();
     toml::value data;
     try
     {
@@ -1061,6 +1415,7 @@ void load_config(std::string file)
     {
         keys[kv.first] = toml::find_or<toml::integer>(hotkeys, kv.first, kv.second);
     }
+    compile_key_bindings();
 
     toml::value opts;
     try
@@ -1132,6 +1487,7 @@ void load_config(std::string file)
     ImGui::GetIO().ConfigDockingWithShift = options["docking_with_shift"];
     g_Console->set_alt_keys(options["console_alt_keys"]);
     imgui_vsync(options["vsync"]);
+    set_low_latency_mode(options["low_latency"]);
     if (options["uncap_unfocused_fps"])
     {
         g_unfocused_fps = 0;
@@ -2040,6 +2396,167 @@ void restart_adventure()
     }
 }
 
+// Starts the run a replay was recorded in again, the replay itself starts with the first input of the level
+void restart_for_replay(const InputReplayHeader& header)
+{
+    if (header.seeded)
+    {
+        quick_start(12, header.world_start, header.level_start, header.theme_start, header.seed);
+        return;
+    }
+    if (g_state->screen < 11)
+        quick_start(12, header.world_start, header.level_start, header.theme_start);
+    UI::set_adventure_seed(header.seed_first, header.seed_second);
+    g_state->world_start = header.world_start;
+    g_state->level_start = header.level_start;
+    g_state->theme_start = header.theme_start;
+    g_state->world_next = header.world_start;
+    g_state->level_next = header.level_start;
+    g_state->theme_next = header.theme_start;
+    g_state->screen_next = 12;
+    g_state->quest_flags |= 1;
+    g_state->fade_enabled = false;
+    g_state->loading = 2;
+}
+
+// The job a farm launcher handed to this game, started once the level it starts in is loaded
+struct FarmJob
+{
+    nlohmann::json job;
+    std::vector<std::string> scripts;
+    bool replay{false};
+    bool started{false};
+    uint16_t screen_counter{0};
+    uint32_t max_frames{0};
+};
+std::optional<FarmJob> g_farm_job;
+
+void finish_farm_job(std::string_view status)
+{
+    FarmJob& farm_job = g_farm_job.value();
+    nlohmann::json result{
+        {"status", status},
+        {"job", farm_job.job},
+        {"frames", g_state->time_total},
+        {"world", g_state->world},
+        {"level", g_state->level},
+        {"theme", (uint8_t)g_state->theme},
+        {"screen", (int)g_state->screen},
+    };
+    // The result of a script is its last error, if it had one
+    nlohmann::json scripts = nlohmann::json::object();
+    for (const std::string& file : farm_job.scripts)
+    {
+        if (auto it = g_scripts.find(file); it != g_scripts.end())
+        {
+            scripts[file] = it->second->get_result();
+            g_scripts.erase(it);
+        }
+        else
+        {
+            scripts[file] = "not loaded";
+        }
+    }
+    result["scripts"] = std::move(scripts);
+
+    InputReplay::get().stop();
+    Turbo::get().set(std::nullopt);
+    g_farm_job.reset();
+    FarmClient::get()->send_result(result.dump());
+}
+
+void start_farm_job(const std::string& line)
+{
+    FarmJob farm_job;
+    farm_job.job = nlohmann::json::parse(line, nullptr, false);
+    if (!farm_job.job.is_object())
+    {
+        FarmClient::get()->send_result(nlohmann::json{{"status", "invalid"}, {"error", "job is not a json object"}, {"job", line}}.dump());
+        return;
+    }
+    const nlohmann::json& job = farm_job.job;
+
+    std::string replay;
+    std::optional<uint32_t> seed;
+    uint32_t turbo;
+    try
+    {
+        replay = job.value("replay", "");
+        if (job.contains("seed"))
+            seed = job.at("seed").get<uint32_t>();
+        turbo = job.value("turbo", 20u);
+        // Ten minutes of game time by default, so a stuck run can't hold up the farm
+        farm_job.max_frames = job.value("max_frames", 60u * 60u * 10u);
+    }
+    catch (const nlohmann::json::exception& e)
+    {
+        FarmClient::get()->send_result(nlohmann::json{{"status", "invalid"}, {"error", e.what()}, {"job", job}}.dump());
+        return;
+    }
+
+    std::optional<InputReplayHeader> header;
+    if (!replay.empty())
+    {
+        header = InputReplay::get().load(replay);
+        if (!header.has_value())
+        {
+            FarmClient::get()->send_result(nlohmann::json{{"status", "invalid"}, {"error", "can't load the replay"}, {"job", job}}.dump());
+            return;
+        }
+    }
+
+    if (const auto scripts = job.find("scripts"); scripts != job.end() && scripts->is_array())
+    {
+        for (const nlohmann::json& script : *scripts)
+        {
+            if (!script.is_string())
+                continue;
+            std::string file = script.get<std::string>();
+            std::replace(file.begin(), file.end(), '\\', '/');
+            load_script(file, true);
+            farm_job.scripts.push_back(std::move(file));
+        }
+    }
+
+    farm_job.replay = header.has_value();
+    farm_job.screen_counter = g_state->screen_change_counter;
+    Turbo::get().set(turbo);
+    if (header.has_value())
+        restart_for_replay(header.value());
+    else
+        quick_start(12, 1, 1, 1, seed);
+    g_farm_job = std::move(farm_job);
+}
+
+void update_farm()
+{
+    FarmClient* farm = FarmClient::get();
+    if (farm == nullptr)
+        return;
+    if (!g_farm_job.has_value())
+    {
+        if (auto job = farm->take_job())
+            start_farm_job(job.value());
+        return;
+    }
+
+    FarmJob& farm_job = g_farm_job.value();
+    if (!farm_job.started)
+    {
+        if (g_state->screen != 12 || g_state->screen_change_counter == farm_job.screen_counter)
+            return;
+        farm_job.started = true;
+    }
+    if (farm_job.replay && InputReplay::get().get_mode() == INPUT_REPLAY_MODE::NONE)
+        finish_farm_job("finished");
+    else if (g_state->screen == 14)
+        finish_farm_job("dead");
+    else if (g_state->screen >= 16 && g_state->screen <= 20)
+        finish_farm_job("won");
+    else if (g_state->time_total >= farm_job.max_frames)
+        finish_farm_job("timeout");
+}
+
 std::string get_clipboard()
 {
     if (!OpenClipboard(nullptr))
@@ -2441,16 +2958,8 @@ void respawn()
     }
 }
 
-bool pressed(std::string keyname, WPARAM wParam)
+WPARAM with_modifiers(WPARAM wParam)
 {
-    if (g_bucket->overlunky->ignore_keys.contains(keyname))
-        return false;
-
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
-    {
-        return false;
-    }
-    int64_t keycode = keys[keyname];
     if (ImGui::GetIO().KeyCtrl)
     {
         wParam += OL_KEY_CTRL;
@@ -2463,19 +2972,34 @@ bool pressed(std::string keyname, WPARAM wParam)
     {
         wParam += OL_KEY_ALT;
     }
-    return wParam == (unsigned)keycode && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
+    return wParam;
 }
 
-bool pressing(std::string keyname)
+bool pressed(const std::string& keyname, WPARAM wParam)
 {
     if (g_bucket->overlunky->ignore_keys.contains(keyname))
         return false;
 
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
+    {
+        return false;
+    }
+    int64_t keycode = it->second;
+    return with_modifiers(wParam) == (unsigned)keycode && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
+}
+
+bool pressing(const std::string& keyname)
+{
+    if (g_bucket->overlunky->ignore_keys.contains(keyname))
+        return false;
+
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
     {
         return false;
     }
-    int64_t keycode = keys[keyname];
+    int64_t keycode = it->second;
     int key = (int)(keycode & 0xff);
     int64_t wParam = key;
 
@@ -2494,17 +3018,18 @@ bool pressing(std::string keyname)
     return wParam == (unsigned)keycode && (GetKeyState(key) & 0x8000) && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
 }
 
-bool clicked(std::string keyname)
+bool clicked(const std::string& keyname)
 {
     if (g_bucket->overlunky->ignore_keys.contains(keyname))
         return false;
 
     int wParam = OL_BUTTON_MOUSE;
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
     {
         return false;
     }
-    int64_t keycode = keys[keyname];
+    int64_t keycode = it->second;
     if (ImGui::GetIO().KeyCtrl)
     {
         wParam += OL_KEY_CTRL;
@@ -2542,17 +3067,18 @@ bool clicked(std::string keyname)
     return wParam == keycode && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
 }
 
-bool dblclicked(std::string keyname)
+bool dblclicked(const std::string& keyname)
 {
     if (g_bucket->overlunky->ignore_keys.contains(keyname))
         return false;
 
     int wParam = OL_BUTTON_MOUSE;
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
     {
         return false;
     }
-    int64_t keycode = keys[keyname];
+    int64_t keycode = it->second;
     if (ImGui::GetIO().KeyCtrl)
     {
         wParam += OL_KEY_CTRL;
@@ -2576,17 +3102,18 @@ bool dblclicked(std::string keyname)
     return wParam == keycode && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
 }
 
-bool held(std::string keyname)
+bool held(const std::string& keyname)
 {
     if (g_bucket->overlunky->ignore_keys.contains(keyname))
         return false;
 
     int wParam = OL_BUTTON_MOUSE;
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
     {
         return false;
     }
-    int64_t keycode = keys[keyname];
+    int64_t keycode = it->second;
     if (ImGui::GetIO().KeyCtrl)
     {
         wParam += OL_KEY_CTRL;
@@ -2610,17 +3137,18 @@ bool held(std::string keyname)
     return wParam == keycode && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
 }
 
-bool released(std::string keyname)
+bool released(const std::string& keyname)
 {
     if (g_bucket->overlunky->ignore_keys.contains(keyname))
         return false;
 
     int wParam = OL_BUTTON_MOUSE;
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
     {
         return false;
     }
-    int64_t keycode = keys[keyname];
+    int64_t keycode = it->second;
     if (ImGui::GetIO().KeyCtrl)
     {
         wParam += OL_KEY_CTRL;
@@ -2644,17 +3172,18 @@ bool released(std::string keyname)
     return wParam == keycode && !g_bucket->overlunky->ignore_keycodes.contains(keycode);
 }
 
-bool dragging(std::string keyname)
+bool dragging(const std::string& keyname)
 {
     if (g_bucket->overlunky->ignore_keys.contains(keyname))
         return false;
 
     int wParam = OL_BUTTON_MOUSE;
-    if (keys.find(keyname) == keys.end() || (keys[keyname] & 0xff) == 0)
+    auto it = keys.find(keyname);
+    if (it == keys.end() || (it->second & 0xff) == 0)
     {
         return false;
     }
-    int64_t keycode = keys[keyname];
+    int64_t keycode = it->second;
     if (ImGui::GetIO().KeyCtrl)
     {
         wParam += OL_KEY_CTRL;
@@ -2761,18 +3290,31 @@ std::string last_word(std::string str)
 void update_filter(std::string s)
 {
     int count = 0;
-    std::string last = last_word(s);
-    uint32_t searchid = 0;
-    // auto res = std::from_chars(last.c_str(), last.c_str() + last.size(), searchid);
-    for (unsigned int i = 0; i < g_items.size(); i++)
+    const std::string last = last_word(s);
+    if (s[0] == '\0' || std::isspace(s.back()) || last.empty())
     {
-        if (s[0] == '\0' || std::isspace(s.back()) || StrStrIA(g_items[i].name.data(), last.data()) || g_items[i].id == searchid)
+        for (unsigned int i = 0; i < g_items.size(); i++)
         {
             if (g_items[i].id == 0 && s[0] != '\0')
                 continue;
             g_filtered_items[count++] = i;
         }
     }
+    else
+    {
+        // An exact id goes first, then the fuzzy matches on the name, best first
+        uint32_t searchid = 0;
+        const auto res = std::from_chars(last.data(), last.data() + last.size(), searchid);
+        const bool is_id = res.ec == std::errc{} && res.ptr == last.data() + last.size() && searchid != 0;
+        if (auto it = g_items_by_id.find(searchid); is_id && it != g_items_by_id.end())
+            g_filtered_items[count++] = it->second;
+        for (uint32_t i : g_items_index.search(last))
+        {
+            if (g_items[i].id == 0 || (is_id && g_items[i].id == searchid))
+                continue;
+            g_filtered_items[count++] = i;
+        }
+    }
     g_filtered_count = count;
     g_current_item = 0;
     scroll_top = true;
@@ -2839,7 +3381,10 @@ bool process_keys(UINT nCode, WPARAM wParam, [[maybe_unused]] LPARAM lParam)
     auto& io = ImGui::GetIO();
     ImGuiWindow* current = g.NavWindow;
 
-    if (nCode == WM_KEYUP && !io.WantCaptureKeyboard && !g_bucket->io->WantCaptureKeyboard.value_or(false))
+    // Every action below needs a pressed() match, so a key that nothing is bound to with the held modifiers can't do anything
+    const bool bound = g_bound_keycodes.contains(with_modifiers(wParam));
+
+    if (nCode == WM_KEYUP && bound && !io.WantCaptureKeyboard && !g_bucket->io->WantCaptureKeyboard.value_or(false))
     {
         if (pressed("speedhack_turbo", wParam))
         {
@@ -2868,7 +3413,7 @@ bool process_keys(UINT nCode, WPARAM wParam, [[maybe_unused]] LPARAM lParam)
 
     g_speedhack_ui_multiplier = UI::get_speedhack();
 
-    if (current != nullptr && current == ImGui::FindWindowByName("KeyCapture"))
+    if (!bound || (current != nullptr && current == ImGui::FindWindowByName("KeyCapture")))
         return false;
 
     if (g_Console && g_Console->is_toggled())
@@ -3690,6 +4235,23 @@ bool render_uid(int uid, const char* section, bool rembtn = false)
     return remove;
 }
 
+// Only lays out the rows that are visible, returns the uid whose remove button was pressed or -1
+int render_uid_list(const std::vector<uint32_t>& uids, const char* section)
+{
+    int removed_uid = -1;
+    ImGuiListClipper clipper;
+    clipper.Begin((int)uids.size());
+    while (clipper.Step())
+    {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+        {
+            if (render_uid(uids[i], section, true))
+                removed_uid = uids[i];
+        }
+    }
+    return removed_uid;
+}
+
 void render_light(const char* name, LightParams* light)
 {
     ImGui::PushID(name);
@@ -4450,6 +5012,56 @@ void erase_entities()
     }
 }
 
+// World space data of the debug overlays that only changes with the level, it's projected to the screen every frame
+struct LevelOverlayCache
+{
+    struct RoomLabel
+    {
+        float x;
+        float y;
+        std::string text;
+    };
+
+    uint8_t level_count{0};
+    THEME theme{0};
+    uint32_t time_level{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    std::optional<std::vector<RoomLabel>> room_labels[2];
+    std::optional<std::vector<std::pair<float, float>>> path;
+
+    // Drops everything when the level changed, time_level going backwards catches restarts of the same level
+    void update()
+    {
+        if (level_count != g_state->level_count || theme != g_state->theme || time_level > g_state->time_level || width != g_state->w || height != g_state->h)
+        {
+            level_count = g_state->level_count;
+            theme = g_state->theme;
+            width = g_state->w;
+            height = g_state->h;
+            room_labels[0].reset();
+            room_labels[1].reset();
+            path.reset();
+        }
+        time_level = g_state->time_level;
+    }
+};
+LevelOverlayCache g_overlay_cache;
+
+AABB get_visible_world_area(float margin)
+{
+    auto [left, top] = UI::click_position(-1.0f, 1.0f);
+    auto [right, bottom] = UI::click_position(1.0f, -1.0f);
+    return AABB{left - margin, top + margin, right + margin, bottom - margin};
+}
+
+bool is_hitbox_visible(Entity* ent, const AABB& visible)
+{
+    auto [x, y] = UI::get_position(ent);
+    AABB hitbox{x - ent->hitboxx + ent->offsetx, y + ent->hitboxy + ent->offsety, x + ent->hitboxx + ent->offsetx, y - ent->hitboxy + ent->offsety};
+    return visible.overlaps_with(hitbox);
+}
+
 void render_grid(ImColor gridcolor = ImColor(1.0f, 1.0f, 1.0f, 0.2f))
 {
     if (g_state == 0 || (g_state->screen < 11 || g_state->screen > 13))
@@ -4516,22 +5128,35 @@ void render_grid(ImColor gridcolor = ImColor(1.0f, 1.0f, 1.0f, 0.2f))
         draw_list->AddLine(fix_pos(ImVec2(0, grids.y)), fix_pos(ImVec2(res.x, grids.y)), ImColor(0, 255, 0, 200), 2);
         draw_list->AddLine(fix_pos(ImVec2(grids.x, 0)), fix_pos(ImVec2(grids.x, res.y)), ImColor(0, 255, 0, 200), 2);
     }
-    for (unsigned int x = 0; x < g_state->w; ++x)
+    g_overlay_cache.update();
+    auto& room_labels = g_overlay_cache.room_labels[g_state->camera_layer ? 1 : 0];
+    if (!room_labels.has_value())
     {
-        for (unsigned int y = 0; y < g_state->h; ++y)
+        room_labels.emplace();
+        for (unsigned int x = 0; x < g_state->w; ++x)
         {
-            auto room_temp = UI::get_room_template(x, y, g_state->camera_layer);
-            if (room_temp.has_value())
+            for (unsigned int y = 0; y < g_state->h; ++y)
             {
-                auto room_name = UI::get_room_template_name(room_temp.value());
-                auto room_pos = UI::get_room_pos(x, y);
-                auto pos = UI::screen_position(room_pos.first, room_pos.second);
-                ImVec2 spos = screenify({pos.first, pos.second});
-                std::string room_text = fmt::format("{:d},{:d} {:s} ({:d})", x, y, room_name, room_temp.value());
-                draw_list->AddText(fix_pos(ImVec2(spos.x + 5.0f, spos.y + 5.0f)), ImColor(1.0f, 1.0f, 1.0f, 1.0f), room_text.c_str());
+                auto room_temp = UI::get_room_template(x, y, g_state->camera_layer);
+                if (room_temp.has_value())
+                {
+                    auto room_name = UI::get_room_template_name(room_temp.value());
+                    auto room_pos = UI::get_room_pos(x, y);
+                    room_labels->push_back({room_pos.first, room_pos.second, fmt::format("{:d},{:d} {:s} ({:d})", x, y, room_name, room_temp.value())});
+                }
             }
         }
     }
+    // labels are anchored at the top-left corner of a 10x8 room
+    const AABB visible = get_visible_world_area(0.0f);
+    for (auto& label : room_labels.value())
+    {
+        if (!visible.overlaps_with(AABB{label.x, label.y, label.x + 10.0f, label.y - 8.0f}))
+            continue;
+        auto pos = UI::screen_position(label.x, label.y);
+        ImVec2 spos = screenify({pos.first, pos.second});
+        draw_list->AddText(fix_pos(ImVec2(spos.x + 5.0f, spos.y + 5.0f)), ImColor(1.0f, 1.0f, 1.0f, 1.0f), label.text.c_str());
+    }
 }
 
 bool is_entrance_room(unsigned int x, unsigned int y)
@@ -4653,29 +5278,39 @@ void render_path()
     if (g_state == 0 || g_state->screen != 12 || g_state->theme == 10)
         return;
     auto* draw_list = ImGui::GetWindowDrawList();
-    std::vector<std::pair<unsigned int, unsigned int>> path;
-    int dy = 1;
-    if (g_state->theme == 9 || g_state->theme == 16)
-        dy = -1;
-    auto room = get_entrance();
-    if (!room.has_value())
-        return;
-    auto [x, y] = room.value();
-    path.push_back({x, y});
-    while (get_next_room(x, y, dy, path))
+    g_overlay_cache.update();
+    if (!g_overlay_cache.path.has_value())
     {
-        path.push_back({x, y});
-        if (is_exit_room(x, y))
-            break;
+        auto& room_centers = g_overlay_cache.path.emplace();
+        std::vector<std::pair<unsigned int, unsigned int>> path;
+        int dy = 1;
+        if (g_state->theme == 9 || g_state->theme == 16)
+            dy = -1;
+        auto room = get_entrance();
+        if (room.has_value())
+        {
+            auto [x, y] = room.value();
+            path.push_back({x, y});
+            while (get_next_room(x, y, dy, path))
+            {
+                path.push_back({x, y});
+                if (is_exit_room(x, y))
+                    break;
+            }
+        }
+        for (auto [px, py] : path)
+        {
+            auto room_pos = UI::get_room_pos(px, py);
+            room_centers.push_back({room_pos.first + 5.0f, room_pos.second - 4.0f});
+        }
     }
-    if (path.size() < 2)
+    if (g_overlay_cache.path->size() < 2)
         return;
 
     std::vector<ImVec2> points;
-    for (auto [px, py] : path)
+    for (auto [wx, wy] : g_overlay_cache.path.value())
     {
-        auto room_pos = UI::get_room_pos(px, py);
-        auto pos = UI::screen_position(room_pos.first + 5.0f, room_pos.second - 4.0f);
+        auto pos = UI::screen_position(wx, wy);
         ImVec2 spos = screenify({pos.first, pos.second});
         points.push_back(spos);
     }
@@ -4943,14 +5578,20 @@ void render_messages()
         {
             std::vector<ScriptMessage> messages;
             for (auto&& message : script->consume_messages())
+            {
+                add_font_glyphs(message.message);
                 messages.push_back(message);
+            }
             if (messages.size() > 0)
                 g_Console->push_history(fmt::format("--- [{}] at {:%Y-%m-%d %X}", script->get_name(), time_buf), std::move(messages));
         }
         {
             std::vector<ScriptMessage> messages;
             for (auto&& message : g_Console->consume_messages())
+            {
+                add_font_glyphs(message.message);
                 messages.push_back(message);
+            }
             if (messages.size() > 0)
                 g_Console->push_history(fmt::format("--- [Console] at {:%Y-%m-%d %X}", time_buf), std::move(messages));
         }
@@ -4966,6 +5607,7 @@ void render_messages()
             {
                 if (options["fade_script_messages"] && now - 12s > message.time)
                     return;
+                add_font_glyphs(message.message);
                 std::istringstream messages(message.message);
                 while (!messages.eof())
                 {
@@ -4977,6 +5619,7 @@ void render_messages()
     }
     for (auto&& message : g_Console->consume_messages())
     {
+        add_font_glyphs(message.message);
         g_ConsoleMessages.push_back(std::move(message));
     }
     for (auto& message : g_ConsoleMessages)
@@ -5091,10 +5734,11 @@ void render_clickhandler()
     if (options["draw_hitboxes"] && g_state->screen != 5)
     {
         static const auto olmec = to_id("ENT_TYPE_ACTIVEFLOOR_OLMEC");
+        const AABB visible = get_visible_world_area(1.0f);
         for (auto entity : UI::get_entities_by({}, (ENTITY_MASK)g_hitbox_mask, (LAYER)g_state->camera_layer))
         {
             auto ent = get_entity_ptr(entity);
-            if (!ent)
+            if (!ent || !is_hitbox_visible(ent, visible))
                 continue;
 
             if (ent->type->id == olmec)
@@ -5148,7 +5792,8 @@ void render_clickhandler()
             for (auto entity : UI::get_entities_by(additional_fixed_entities, ENTITY_MASK::FLOOR | ENTITY_MASK::ACTIVEFLOOR, (LAYER)g_state->camera_layer))
             {
                 auto ent = get_entity_ptr(entity);
-                render_hitbox(ent, false, ImColor(0, 255, 255, 150));
+                if (ent && is_hitbox_visible(ent, visible))
+                    render_hitbox(ent, false, ImColor(0, 255, 255, 150));
             }
             for (auto entity : UI::get_entities_by({(ENT_TYPE)CUSTOM_TYPE::TRIGGER}, ENTITY_MASK::LOGICAL, (LAYER)g_state->camera_layer))
             {
@@ -5751,6 +6396,8 @@ void render_style_editor()
     ImGui::DragFloat("Small print##FontSmall", &fontsize[0], 0.1f, 6.0f, 32.0f);
     ImGui::DragFloat("Medium print##FontMedium", &fontsize[1], 0.1f, 16.0f, 48.0f);
     ImGui::DragFloat("Large print##FontLarge", &fontsize[2], 0.1f, 24.0f, 96.0f);
+    ImGui::Checkbox("Load all asian glyphs##FontAllGlyphs", &options["font_all_glyphs"]);
+    tooltip("Bake the full japanese, korean and chinese glyph ranges instead of\nonly the characters the game strings use. Slower to start.\nSave and restart to take effect.");
     ImGui::Separator();
     ImGui::Checkbox("Inverted (black on light colors)##StyleInvert", &options["inverted"]);
     ImGui::Checkbox("Borders##StyleBorder", &options["borders"]);
@@ -6081,6 +6728,25 @@ void render_options()
             g_speedhack_ui_multiplier = 1.0f;
             UI::speedhack(g_speedhack_ui_multiplier);
         }
+        int turbo_loops = (int)Turbo::get().get_loops_per_frame();
+        if (ImGui::SliderInt("Turbo##Turbo", &turbo_loops, 1, 50, "%dx", ImGuiSliderFlags_AlwaysClamp))
+            Turbo::get().set((uint32_t)turbo_loops);
+        tooltip("Run this many full engine frames per rendered frame,\nwithout the frame limiter. 1 = off.");
+        ImGui::SameLine();
+        if (ImGui::Button("Reset##ResetTurbo"))
+            Turbo::get().set(std::nullopt);
+        double limiter_fps = FrameLimiter::get().get_target().has_value() ? 1.0 / FrameLimiter::get().get_target().value() : 0.0;
+        if (ImGui::SliderScalar("Precise FPS##FrameLimiterFPS", ImGuiDataType_Double, &limiter_fps, &fps_min, &fps_max, "%f"))
+            FrameLimiter::get().set(limiter_fps > 0.0 ? std::optional<double>{1.0 / limiter_fps} : std::nullopt);
+        tooltip("Pace the engine with a high resolution timer instead,\nfor steady frame times. Sets Engine FPS to 0 while on.\n0 = off.");
+        ImGui::SameLine();
+        if (ImGui::Button("Reset##ResetFrameLimiter"))
+            FrameLimiter::get().set(std::nullopt);
+        if (FrameLimiter::get().get_target().has_value())
+        {
+            const FrameLimiterStats stats = FrameLimiter::get().get_stats();
+            ImGui::Text("%.3f ms avg, %.3f-%.3f ms, %.3f ms dev, %llu late", stats.average_ms, stats.min_ms, stats.max_ms, stats.deviation_ms, stats.late);
+        }
         if (ImGui::SliderScalar("Engine FPS##EngineFPS", ImGuiDataType_Double, &g_engine_fps, &fps_min, &fps_max, "%f"))
             update_frametimes();
         tooltip("Set target engine FPS. Always capped by max GPU FPS.\n0 = as fast as it can go.");
@@ -6145,6 +6811,10 @@ void render_options()
             imgui_vsync(options["vsync"]);
         tooltip("Disabling game vsync may affect performance with external windows,\nfor better or worse.");
 
+        if (ImGui::Checkbox("Low latency mode", &options["low_latency"]))
+            set_low_latency_mode(options["low_latency"]);
+        tooltip("Only let the GPU queue one frame to reduce input latency,\nmay lower fps on slower machines.");
+
         if (ImGui::Checkbox("Docking only while holding Shift", &options["docking_with_shift"]))
         {
             ImGui::GetIO().ConfigDockingWithShift = options["docking_with_shift"];
@@ -6252,6 +6922,22 @@ void render_options()
                 ImGui::SeparatorText("Pause on screens (or any)");
                 render_flags(screen_names, &g_bucket->pause_api->pause_screen);
             }
+            if ((g_bucket->pause_api->pause_trigger & PAUSE_TRIGGER::TIME_LEVEL) != PAUSE_TRIGGER::NONE)
+                ImGui::InputScalar("Pause on level frame##PauseTimeLevel", ImGuiDataType_U32, &g_bucket->pause_api->trigger_time_level);
+            if (g_bucket->pause_api->last_trigger != PAUSE_TRIGGER::NONE)
+            {
+                ImGui::SeparatorText("Last trigger");
+                uint64_t last_trigger = (uint64_t)g_bucket->pause_api->last_trigger;
+                for (size_t i = 0; i < pause_triggers.size(); ++i)
+                {
+                    if (last_trigger & (1ull << i))
+                        ImGui::TextUnformatted(pause_triggers[i]);
+                }
+                if ((g_bucket->pause_api->last_trigger & PAUSE_TRIGGER::SPAWN) != PAUSE_TRIGGER::NONE)
+                    ImGui::Text("Spawned uid: %d", g_bucket->pause_api->last_spawn_uid);
+                if ((g_bucket->pause_api->last_trigger & PAUSE_TRIGGER::SCRIPT_ERROR) != PAUSE_TRIGGER::NONE)
+                    ImGui::TextWrapped("%s", g_bucket->pause_api->last_error.c_str());
+            }
             endmenu();
         }
         if (submenu("Automatic unpause triggers"))
@@ -6343,6 +7029,292 @@ void render_options()
     tooltip("Load overlunky.ini.", "load_settings");
 }
 
+void render_frame_telemetry()
+{
+    auto& telemetry = FrameTelemetry::get();
+    bool enabled = telemetry.enabled;
+    if (ImGui::Checkbox("Record frame telemetry##FrameTelemetryEnabled", &enabled))
+        telemetry.enabled = enabled;
+
+    const std::vector<FrameSample> samples = telemetry.samples();
+    const auto stats = FrameTelemetry::percentiles(samples);
+    if (ImGui::BeginTable("##FrameTelemetryStats", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("Phase");
+        ImGui::TableSetupColumn("p50 ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(FrameTelemetry::phase_name((FRAME_PHASE)i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats[i].p50);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats[i].p99);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats[i].max);
+        }
+        ImGui::EndTable();
+    }
+
+    std::vector<float> frame_ms(samples.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+        frame_ms[i] = samples[i].frame_ms;
+    const auto& frame_stats = stats.back();
+    std::string overlay = fmt::format("p50 {:.2f} ms / p99 {:.2f} ms", frame_stats.p50, frame_stats.p99);
+    ImGui::PlotHistogram("##FrameTimes", frame_ms.data(), (int)frame_ms.size(), 0, overlay.c_str(), 0.0f, std::max(frame_stats.p99 * 1.5f, 16.7f), ImVec2(-1.0f, 80.0f));
+
+    auto& gc_scheduler = LuaGcScheduler::get();
+    bool gc_enabled = gc_scheduler.enabled;
+    if (ImGui::Checkbox("Schedule Lua GC after present##LuaGcScheduler", &gc_enabled))
+        gc_scheduler.enabled = gc_enabled;
+    tooltip("Stops the automatic garbage collection of the scripts and runs a generational step after the frame was presented instead,\nwhen it fits into the time left until the next frame is due. Turned off the collector runs whenever the scripts allocate enough.");
+    const auto& gc_stats = gc_scheduler.stats();
+    ImGui::Text("Lua heap %.1f MB, %llu steps, fell back to automatic collection for %llu frames",
+                gc_stats.heap_kb / 1024.0f,
+                (unsigned long long)gc_stats.total_steps,
+                (unsigned long long)gc_stats.fallback_frames);
+    const auto& idle_stats = LuaIdleScheduler::get().stats();
+    ImGui::Text("ON.IDLE: %.0f us slack, %.0f us used by %u scripts, %u skipped, %llu frames without slack",
+                idle_stats.slack_us,
+                idle_stats.used_us,
+                idle_stats.backends_run,
+                idle_stats.backends_skipped,
+                (unsigned long long)idle_stats.busy_frames);
+    if (g_startup.scripts_ms >= 0.0f)
+        ImGui::Text("Startup: interactive after %.0f ms, %u autorun scripts ran after %.0f ms", g_startup.interactive_ms, (unsigned)g_startup.scripts, g_startup.scripts_ms);
+    else
+        ImGui::Text("Startup: interactive after %.0f ms, %u autorun scripts still loading", g_startup.interactive_ms, (unsigned)g_startup.scripts);
+    tooltip("Both from when the api started hooking the game. The autorun scripts are compiled in the background\nand only run after the ui is up, scripts they import run before them.");
+
+    // Rates are taken over a second, the counters only ever grow
+    const auto& copy_stats = get_copy_state_stats();
+    static auto last_copy_sample = std::chrono::steady_clock::now();
+    static uint64_t last_heap_clones = 0;
+    static float heap_clones_per_second = 0.0f;
+    const auto copy_sample = std::chrono::steady_clock::now();
+    const float copy_sample_seconds = std::chrono::duration<float>(copy_sample - last_copy_sample).count();
+    if (copy_sample_seconds >= 1.0f)
+    {
+        const uint64_t heap_clones = copy_stats.heap_clones.load(std::memory_order_relaxed);
+        heap_clones_per_second = (heap_clones - last_heap_clones) / copy_sample_seconds;
+        last_heap_clones = heap_clones;
+        last_copy_sample = copy_sample;
+    }
+    const uint64_t state_copies = copy_stats.copies.load(std::memory_order_relaxed);
+    const float copy_total_ms = FrameTelemetry::ticks_to_ms(copy_stats.copy_ticks.load(std::memory_order_relaxed));
+    ImGui::Text("Heap clones: %.1f/s, %llu state copies took %.1f ms in scripts (%.1f us each), user_data copied %llu times, shared %llu times",
+                heap_clones_per_second,
+                (unsigned long long)state_copies,
+                copy_total_ms,
+                state_copies != 0 ? copy_total_ms * 1000.0f / state_copies : 0.0f,
+                (unsigned long long)copy_stats.copied_user_datas.load(std::memory_order_relaxed),
+                (unsigned long long)copy_stats.shared_user_datas.load(std::memory_order_relaxed));
+    tooltip("The game clones its heap for the rollback in online play, every clone copies the locals of every script.\nA state's user_data table is only copied if the script got at it since the last copy.");
+
+    auto& heap_stats = GameHeapStats::get();
+    bool heap_stats_enabled = heap_stats.is_enabled();
+    if (ImGui::Checkbox("Count game heap allocations##GameHeapStats", &heap_stats_enabled))
+        heap_stats.set_enabled(heap_stats_enabled);
+    tooltip("Counts what the API and the scripts allocate on the game's heap, by where it was allocated from.\nThe live size is estimated from a sample of the allocations, turn it off and on again to start over.");
+    if (heap_stats_enabled && ImGui::BeginTable("##GameHeapStats", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("Allocated by");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableSetupColumn("Total KB");
+        ImGui::TableSetupColumn("Live KB (est.)");
+        ImGui::TableHeadersRow();
+        for (const GameHeapTagStats& tag_stats : heap_stats.collect())
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(tag_stats.tag);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)tag_stats.allocations);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", tag_stats.bytes / 1024.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", tag_stats.live_bytes / 1024.0f);
+        }
+        ImGui::EndTable();
+    }
+
+    static bool show_service_threads = false;
+    ImGui::Checkbox("Show service threads##ServiceThreads", &show_service_threads);
+    tooltip("Threads started by the API, they run below the game's priority and off the core the game loop runs on.\nCPU is the share of one core over the last half second.");
+    if (show_service_threads && ImGui::BeginTable("##ServiceThreadStats", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("Thread");
+        ImGui::TableSetupColumn("Pool");
+        ImGui::TableSetupColumn("Id");
+        ImGui::TableSetupColumn("CPU %");
+        ImGui::TableSetupColumn("CPU total ms");
+        ImGui::TableHeadersRow();
+        for (const ServiceThreadStats& stats : ServiceThreads::get().collect())
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (stats.running)
+                ImGui::TextUnformatted(stats.name.c_str());
+            else
+                ImGui::TextDisabled("%s (exited)", stats.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(ServiceThreads::pool_name(stats.pool));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats.thread_id);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.cpu_percent);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f", stats.cpu_ms);
+        }
+        ImGui::EndTable();
+    }
+
+    auto& state_feed = StateFeed::get();
+    bool feed_enabled = state_feed.is_enabled();
+    if (ImGui::Checkbox("Publish state feed##StateFeed", &feed_enabled))
+        state_feed.set_enabled(feed_enabled);
+    tooltip("Writes the screen, level, timers and players to the shared memory Local\\OverlunkyStateFeed after every update,\nfor overlays and trackers that would otherwise read the game memory. Scripts can add entity lists with set_state_feed.");
+
+    if (!telemetry.is_streaming())
+    {
+        static int port = 8811;
+        ImGui::InputInt("Port##FrameTelemetryPort", &port);
+        if (ImGui::Button("Stream over UDP##FrameTelemetryStream"))
+            telemetry.start_streaming("127.0.0.1", (uint16_t)port);
+        tooltip("Answer every datagram sent to this port with the frames recorded since the last one.\nEach line is: frame pre_update game_update lua imgui present lua_gc total");
+    }
+    else
+    {
+        ImGui::TextUnformatted("Streaming frame telemetry over UDP");
+    }
+
+    auto& gpu_timing = GpuTiming::get();
+    bool gpu_enabled = gpu_timing.enabled;
+    if (ImGui::Checkbox("Record GPU timings##GpuTimingEnabled", &gpu_enabled))
+        gpu_timing.enabled = gpu_enabled;
+    tooltip("Times the vanilla render hooks on the GPU with timestamp queries, the results lag a few frames behind.\nIf the GPU frame is much shorter than the CPU frame, the frame is CPU bound.");
+    const std::vector<GpuSectionTiming> gpu_timings = gpu_timing.last_frame();
+    if (!gpu_timings.empty() && ImGui::BeginTable("##GpuTimings", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("GPU section");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableHeadersRow();
+        for (auto& timing : gpu_timings)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(timing.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", timing.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.ms);
+        }
+        ImGui::EndTable();
+    }
+}
+
+void render_level_gen_stats()
+{
+    bool enabled = LevelGenStats::enabled;
+    if (ImGui::Checkbox("Time level generation##LevelGenStatsEnabled", &enabled))
+        LevelGenStats::enabled = enabled;
+    tooltip("Times the hooked level generation functions during the next level generation.\nPhases include the time of the phases they call.");
+
+    const std::vector<LevelGenPhaseStats> stats = LevelGenStats::get().stats();
+    if (ImGui::BeginTable("##LevelGenStats", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("Phase");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Total ms");
+        ImGui::TableSetupColumn("Callbacks ms");
+        ImGui::TableSetupColumn("Vanilla ms");
+        ImGui::TableHeadersRow();
+        for (const LevelGenPhaseStats& phase : stats)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(phase.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", phase.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", phase.total_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", phase.callback_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", phase.vanilla_ms);
+        }
+        ImGui::EndTable();
+    }
+}
+
+void render_panel_timings();
+
+void render_input_replay()
+{
+    static std::string replay_path = "replay.olr";
+    auto& replay = InputReplay::get();
+    const auto mode = replay.get_mode();
+
+    ImGui::InputText("File##InputReplayFile", &replay_path);
+    if (mode == INPUT_REPLAY_MODE::NONE)
+    {
+        if (ImGui::Button("Record from run start##InputReplayRecord"))
+        {
+            replay.record();
+            restart_adventure();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Replay##InputReplayPlay"))
+        {
+            if (auto header = replay.load(replay_path))
+                restart_for_replay(header.value());
+            else
+                DEBUG("Couldn't read input replay '{}'", replay_path);
+        }
+    }
+    else if (mode == INPUT_REPLAY_MODE::RECORD_ARMED || mode == INPUT_REPLAY_MODE::RECORDING)
+    {
+        if (ImGui::Button("Stop and save##InputReplaySave"))
+        {
+            if (!replay.save(replay_path))
+                DEBUG("Couldn't write input replay '{}'", replay_path);
+        }
+        ImGui::SameLine();
+        ImGui::Text("Recorded %u frames", replay.get_frame());
+    }
+    else
+    {
+        if (ImGui::Button("Stop##InputReplayStop"))
+            replay.stop();
+        ImGui::SameLine();
+        bool fast_forward = replay.is_fast_forwarding();
+        if (ImGui::Checkbox("Fast forward##InputReplayFastForward", &fast_forward))
+            replay.set_fast_forward(fast_forward);
+        if (mode == INPUT_REPLAY_MODE::REPLAYING && replay.get_length() > 0)
+        {
+            // Follows the replay until it's dragged, seeks once it's let go
+            static int seek_frame = 0;
+            static bool seeking = false;
+            if (!seeking)
+                seek_frame = static_cast<int>(replay.get_frame());
+            ImGui::SliderInt("Seek##InputReplaySeek", &seek_frame, 0, static_cast<int>(replay.get_length()) - 1, "%d", ImGuiSliderFlags_AlwaysClamp);
+            seeking = ImGui::IsItemActive();
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                replay.seek(static_cast<uint32_t>(seek_frame));
+            ImGui::Text("Frame %u of %u", replay.get_frame(), replay.get_length());
+        }
+        else
+        {
+            ImGui::TextUnformatted("Waiting for the level to start");
+        }
+    }
+}
+
 void render_debug()
 {
     ImGui::PushItemWidth(-ImGui::GetWindowWidth() * 0.5f);
@@ -6378,6 +7350,26 @@ void render_debug()
         "%08X",
         ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AlwaysInsertMode | ImGuiInputTextFlags_CharsHexadecimal);
     ImGui::PopItemWidth();
+    if (submenu("Frame telemetry##FrameTelemetry"))
+    {
+        render_frame_telemetry();
+        endmenu();
+    }
+    if (submenu("Level generation timings##LevelGenStats"))
+    {
+        render_level_gen_stats();
+        endmenu();
+    }
+    if (submenu("UI panel timings##PanelTimings"))
+    {
+        render_panel_timings();
+        endmenu();
+    }
+    if (submenu("Input replay##InputReplay"))
+    {
+        render_input_replay();
+        endmenu();
+    }
 }
 
 std::string gen_random(const int len)
@@ -6546,6 +7538,83 @@ bool find_match(std::string needle, std::string haystack)
     return fpos != haystack.end();
 }
 
+void render_script_profiler()
+{
+    ImGui::Checkbox("Profile callbacks##ProfileCallbacks", &CallbackProfiler::enabled);
+    ImGui::SameLine();
+    if (ImGui::Button("Reset##ResetCallbackStats"))
+        reset_callback_stats();
+    tooltip("Clear the recorded callback times of all scripts");
+
+    std::vector<CallbackStats> stats = get_callback_stats();
+    double frame_total = 0.0;
+    for (const auto& stat : stats)
+        frame_total += stat.frame_ms;
+    ImGui::Text("Total: %.3f ms per frame", frame_total);
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingStretchProp;
+    if (!ImGui::BeginTable("##ScriptProfiler", 7, flags, ImVec2(0.0f, 300.0f)))
+        return;
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Script");
+    ImGui::TableSetupColumn("Id");
+    ImGui::TableSetupColumn("Aux");
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableSetupColumn("Total ms");
+    ImGui::TableSetupColumn("Max ms");
+    ImGui::TableSetupColumn("ms/frame", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableHeadersRow();
+
+    if (ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs(); sort_specs && sort_specs->SpecsCount > 0)
+    {
+        const ImGuiTableColumnSortSpecs& spec = sort_specs->Specs[0];
+        const auto key = [column = spec.ColumnIndex](const CallbackStats& stat)
+        {
+            switch (column)
+            {
+            case 1:
+                return (double)stat.id;
+            case 2:
+                return (double)stat.aux_id;
+            case 3:
+                return (double)stat.calls;
+            case 4:
+                return stat.total_ms;
+            case 5:
+                return stat.max_ms;
+            default:
+                return stat.frame_ms;
+            }
+        };
+        const bool ascending = spec.SortDirection == ImGuiSortDirection_Ascending;
+        std::stable_sort(stats.begin(), stats.end(), [&](const CallbackStats& lhs, const CallbackStats& rhs)
+                         {
+                             if (spec.ColumnIndex == 0)
+                                 return ascending ? lhs.script < rhs.script : lhs.script > rhs.script;
+                             return ascending ? key(lhs) < key(rhs) : key(lhs) > key(rhs); });
+    }
+
+    for (const auto& stat : stats)
+    {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(stat.script.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%d", stat.id);
+        ImGui::TableNextColumn();
+        ImGui::Text("%d", stat.aux_id);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", stat.calls);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stat.total_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stat.max_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stat.frame_ms);
+    }
+    ImGui::EndTable();
+}
+
 void render_scripts()
 {
     ImGui::PushTextWrapPos(0.0f);
@@ -6566,6 +7635,8 @@ void render_scripts()
     tooltip(scriptpath.c_str());
     if (ImGui::Checkbox("Load scripts from Mods/Packs##LoadScriptsPacks", &options["load_packs"]))
         refresh_script_files();
+    ImGui::Checkbox("Hot reload changed scripts##HotReloadScripts", &options["hot_reload_scripts"]);
+    tooltip("Run an enabled script that changed on disk again in place instead of loading it from scratch.\nHooks on entities and their user data are kept, only the required modules that changed are loaded again.");
     if (ImGui::Button("Create new quick script"))
     {
         std::string name = "_" + gen_random(16);
@@ -6587,6 +7658,8 @@ void render_scripts()
     ImGui::SameLine();
     if (ImGui::Button("Clear##ClearScriptFilter"))
         script_filter.clear();
+    const auto& shared_memory = get_shared_lua_memory_account();
+    ImGui::TextDisabled("Shared Lua memory: %.2f MB (peak %.2f MB)", shared_memory.used.load() / 1048576.0, shared_memory.peak.load() / 1048576.0);
     ImGui::PushItemWidth(-1);
     int i = 0;
     std::vector<std::string> unload_scripts;
@@ -6675,6 +7748,13 @@ void render_scripts()
                     {
                         ++i;
                     }
+                    ImGui::TextDisabled("Memory: %.2f MB (peak %.2f MB)", script->get_memory_used() / 1048576.0, script->get_memory_peak() / 1048576.0);
+                    ImGui::SameLine();
+                    float memory_limit = script->get_memory_limit() / 1048576.0f;
+                    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6.0f);
+                    if (ImGui::InputFloat("Limit (MB)##MemoryLimit", &memory_limit, 0.0f, 0.0f, "%.1f", ImGuiInputTextFlags_EnterReturnsTrue))
+                        script->set_memory_limit(static_cast<std::size_t>(std::max(memory_limit, 0.0f) * 1048576.0f));
+                    tooltip("A script that goes over the limit gets a Lua memory error, 0 for no limit");
                     ImGui::PushItemWidth(-ImGui::GetWindowWidth() * 0.5f);
                     ImGui::Separator();
                     script->render_options();
@@ -6714,6 +7794,11 @@ void render_scripts()
         render_script_files();
         endmenu();
     }
+    if (submenu("Script profiler##ScriptProfiler"))
+    {
+        render_script_profiler();
+        endmenu();
+    }
     ImGui::PopItemWidth();
 }
 
@@ -7268,136 +8353,43 @@ void render_entity_finder()
     ImGui::PopStyleColor();
     ImGui::Text("");
 
-    static bool run_filter = false;
-    static bool extra_filter = false;
+    static EntityFinder finder;
+    static bool live_finder = false;
+    const EntityFinderQuery query{
+        search_entity_name,
+        search_entity_type,
+        search_entity_layer,
+        search_entity_depth[0],
+        search_entity_depth[1],
+        (uint32_t)search_entity_mask,
+        search_entity_flags,
+        search_entity_not_flags,
+        search_entity_more_flags,
+        search_entity_not_more_flags,
+        search_entity_properties_flags,
+        search_entity_not_properties_flags,
+    };
     if (ImGui::Button("Search##SearchEntities") || run_finder)
     {
-        g_selected_ids = UI::get_entities_by({search_entity_type}, (ENTITY_MASK)search_entity_mask, (LAYER)search_entity_layer);
-        run_filter = true;
+        finder.set_query(query, get_entity_catalog());
+        g_selected_ids = finder.search();
         run_finder = false;
     }
     ImGui::SameLine();
     if (ImGui::Button("Filter##FilterEntities"))
     {
-        run_filter = true;
-        extra_filter = true;
-    }
-    if (run_filter)
-    {
-        run_filter = false;
-        if (extra_filter)
-        {
-            if (search_entity_type != 0)
-            {
-                g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                    {
-                                                        auto ent = get_entity_ptr(filter_uid);
-                                                        if (!ent)
-                                                            return true;
-                                                        return ent->type->id != search_entity_type; }),
-                                     g_selected_ids.end());
-            }
-            if (search_entity_mask != 0)
-            {
-                g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                    {
-                                                        auto ent = get_entity_ptr(filter_uid);
-                                                        if (!ent)
-                                                            return true;
-                                                        return ((int)ent->type->search_flags & search_entity_mask) == 0; }),
-                                     g_selected_ids.end());
-            }
-            {
-                g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                    {
-                                                        auto ent = get_entity_ptr(filter_uid);
-                                                        if (!ent)
-                                                            return true;
-                                                        return ent->layer != enum_to_layer((LAYER)search_entity_layer); }),
-                                     g_selected_ids.end());
-            }
-            extra_filter = false;
-        }
-        if (search_entity_flags != 0)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return (ent->flags & search_entity_flags) != search_entity_flags; }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_not_flags != 0)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return (ent->flags & search_entity_not_flags) != 0; }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_more_flags != 0)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return (ent->more_flags & search_entity_more_flags) != search_entity_more_flags; }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_not_more_flags != 0)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return (ent->more_flags & search_entity_not_more_flags) != 0; }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_properties_flags != 0)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return (ent->type->properties_flags & search_entity_properties_flags) != search_entity_properties_flags; }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_not_properties_flags != 0)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return (ent->type->properties_flags & search_entity_not_properties_flags) != 0; }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_name != "")
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return !StrStrIA(entity_names[ent->type->id].c_str(), search_entity_name.c_str()); }),
-                                 g_selected_ids.end());
-        }
-        if (search_entity_depth[0] > 0 || search_entity_depth[1] < 52)
-        {
-            g_selected_ids.erase(std::remove_if(g_selected_ids.begin(), g_selected_ids.end(), [&](uint32_t filter_uid)
-                                                {
-                                                    auto ent = get_entity_ptr(filter_uid);
-                                                    if (!ent)
-                                                        return true;
-                                                    return ent->draw_depth < search_entity_depth[0] || ent->draw_depth > search_entity_depth[1]; }),
-                                 g_selected_ids.end());
-        }
+        finder.set_query(query, get_entity_catalog());
+        finder.filter(g_selected_ids);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Live##LiveSearchEntities", &live_finder);
+    tooltip("Keep the selection up to date with the search,\nadds entities as they spawn and drops the ones that are gone or don't match anymore.");
+    if (live_finder)
+    {
+        if (finder.set_query(query, get_entity_catalog()))
+            g_selected_ids = finder.search();
+        else
+            finder.update(g_selected_ids);
     }
     ImGui::SameLine();
     if (ImGui::Button("Reset##ResetSearchEntities"))
@@ -7454,9 +8446,14 @@ void render_entity_finder()
             }
             g_selected_ids.clear();
         }
-        for (auto selected_uid : g_selected_ids)
+        ImGuiListClipper clipper;
+        clipper.Begin((int)g_selected_ids.size());
+        while (clipper.Step())
         {
-            render_uid(selected_uid, "Multiselect");
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+            {
+                render_uid(g_selected_ids[i], "Multiselect");
+            }
         }
     }
     ImGui::PopItemWidth();
@@ -7721,26 +8718,26 @@ void render_entity_props(int uid, bool detached = false)
         ImGui::SeparatorText("Items");
         if (!(entity->type->search_flags & (ENTITY_MASK::PLAYER | ENTITY_MASK::MOUNT | ENTITY_MASK::MONSTER)))
         {
-            int removed_uid = -1;
+            std::vector<uint32_t> shown_items;
             for (auto ent : entity->items.entities())
             {
                 if (fx || !(ent->type->search_flags & ENTITY_MASK::FX))
-                    if (render_uid(ent->uid, "EntityItems", true))
-                        removed_uid = ent->uid;
+                    shown_items.push_back(ent->uid);
             }
+            int removed_uid = render_uid_list(shown_items, "EntityItems");
             if (auto removed = get_entity_ptr(removed_uid))
                 entity->remove_item(removed, true);
         }
         else
         {
             auto entity_pow = entity->as<PowerupCapable>();
-            int removed_uid = -1;
+            std::vector<uint32_t> shown_items;
             for (auto ent : entity->items.entities())
             {
                 if ((fx || !(ent->type->search_flags & ENTITY_MASK::FX)) && !entity_pow->has_powerup(ent->type->id))
-                    if (render_uid(ent->uid, "EntityItems", true))
-                        removed_uid = ent->uid;
+                    shown_items.push_back(ent->uid);
             }
+            int removed_uid = render_uid_list(shown_items, "EntityItems");
             if (auto removed = get_entity_ptr(removed_uid))
                 entity_pow->remove_item(removed, true);
             ImGui::SeparatorText("Powerups");
@@ -9007,6 +10004,80 @@ void render_game_props()
     ImGui::PopItemWidth();
 }
 
+// Ranges have to stay alive until the atlas is built, the deque doesn't move them
+std::deque<ImVector<ImWchar>> g_font_glyph_ranges;
+uint64_t g_font_strings_hash{0};
+
+ImFontGlyphRangesBuilder collect_used_glyphs()
+{
+    ImFontGlyphRangesBuilder builder;
+    const auto add_string = [&builder](const char16_t* str)
+    {
+        for (; str != nullptr && *str != 0; ++str)
+        {
+            // ImWchar is 32 bits in this build, so the characters outside the BMP are decoded from their surrogate pair
+            char32_t c = *str;
+            if (c >= 0xD800 && c < 0xDC00 && str[1] >= 0xDC00 && str[1] < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (str[1] - 0xDC00);
+                ++str;
+            }
+            if (c <= IM_UNICODE_CODEPOINT_MAX)
+                builder.AddChar((ImWchar)c);
+        }
+    };
+
+    const auto strings_table = get_strings_table();
+    for (size_t i = 0; i < get_string_hashes().size(); ++i)
+        add_string(strings_table[i]);
+    for (const auto& [id, str] : g_bucket->custom_strings)
+        add_string(str.c_str());
+    for (int i = 0; i < builder.UsedChars.Size; ++i)
+        builder.UsedChars[i] |= g_font_extra_glyphs.UsedChars[i];
+    return builder;
+}
+// The game reloads the table on language change and scripts add or change custom strings, hashing the content notices edits in place too
+uint64_t get_font_strings_hash()
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    const auto add_string = [&hash](const char16_t* str)
+    {
+        for (; str != nullptr && *str != 0; ++str)
+            hash = (hash ^ *str) * 0x100000001b3;
+        hash = (hash ^ 0xFFFF) * 0x100000001b3;
+    };
+    const auto strings_table = get_strings_table();
+    for (size_t i = 0; i < get_string_hashes().size(); ++i)
+        add_string(strings_table[i]);
+    for (const auto& [id, str] : g_bucket->custom_strings)
+        add_string(str.c_str());
+    return hash;
+}
+// Only the used characters of `ranges`, nullptr if there are none and the font doesn't need to be loaded at all
+const ImWchar* subset_glyph_ranges(const ImWchar* ranges)
+{
+    if (options["font_all_glyphs"])
+        return ranges;
+
+    ImFontGlyphRangesBuilder builder;
+    bool any = false;
+    for (; ranges[0] != 0; ranges += 2)
+    {
+        for (unsigned int c = ranges[0]; c <= ranges[1]; ++c)
+        {
+            if (g_font_used_glyphs.GetBit((ImWchar)c))
+            {
+                builder.AddChar((ImWchar)c);
+                any = true;
+            }
+        }
+    }
+    if (!any)
+        return nullptr;
+    builder.BuildRanges(&g_font_glyph_ranges.emplace_back());
+    return g_font_glyph_ranges.back().Data;
+}
+
 void load_font()
 {
     ImGuiIO& io = ImGui::GetIO();
@@ -9090,14 +10161,24 @@ void load_font()
         io.Fonts->AddFontFromFileTTF(font_ru.c_str(), fontsize[0], &font_config, io.Fonts->GetGlyphRangesCyrillic());
         io.Fonts->AddFontFromFileTTF(font_ru.c_str(), fontsize[0], &font_config, ellipsis_range);
     }
-    if (font_jp != "")
-        io.Fonts->AddFontFromFileTTF(font_jp.c_str(), fontsize[0], &font_config, io.Fonts->GetGlyphRangesJapanese());
-    if (font_ko != "")
-        io.Fonts->AddFontFromFileTTF(font_ko.c_str(), fontsize[0], &font_config, io.Fonts->GetGlyphRangesKorean());
-    if (font_zhcn != "")
-        io.Fonts->AddFontFromFileTTF(font_zhcn.c_str(), fontsize[0], &font_config, io.Fonts->GetGlyphRangesChineseSimplifiedCommon());
-    if (font_zhtw != "")
-        io.Fonts->AddFontFromFileTTF(font_zhtw.c_str(), fontsize[0], &font_config, io.Fonts->GetGlyphRangesChineseFull());
+
+    g_font_used_glyphs = collect_used_glyphs();
+    g_font_strings_hash = get_font_strings_hash();
+    g_font_extra_missing = false;
+    g_font_glyph_ranges.clear();
+    const std::pair<std::string&, const ImWchar*> asian_fonts[]{
+        {font_jp, io.Fonts->GetGlyphRangesJapanese()},
+        {font_ko, io.Fonts->GetGlyphRangesKorean()},
+        {font_zhcn, io.Fonts->GetGlyphRangesChineseSimplifiedCommon()},
+        {font_zhtw, io.Fonts->GetGlyphRangesChineseFull()},
+    };
+    for (const auto& [font_file, ranges] : asian_fonts)
+    {
+        if (font_file == "")
+            continue;
+        if (const ImWchar* used_ranges = subset_glyph_ranges(ranges))
+            io.Fonts->AddFontFromFileTTF(font_file.c_str(), fontsize[0], &font_config, used_ranges);
+    }
     if (font_emoji != "")
         io.Fonts->AddFontFromFileTTF(font_emoji.c_str(), fontsize[0], &font_config, emoji_range);
 
@@ -9105,6 +10186,36 @@ void load_font()
     hugefont = io.Fonts->AddFontFromMemoryCompressedTTF(OLFont_compressed_data, OLFont_compressed_size, fontsize[2]);
 }
 
+// Rebuilds the atlas after the frame if the strings, script messages or typed text now use characters the asian fonts didn't bake
+void update_font_glyphs()
+{
+    if (options["font_all_glyphs"])
+        return;
+    // Hashing all the strings isn't free, so changes to them are only looked for every half a second
+    static uint32_t frames = 0;
+    if (!std::exchange(g_font_extra_missing, false))
+    {
+        if (++frames % 30 != 0)
+            return;
+        const uint64_t hash = get_font_strings_hash();
+        if (hash == g_font_strings_hash)
+            return;
+        g_font_strings_hash = hash;
+    }
+
+    ImFontGlyphRangesBuilder used_glyphs = collect_used_glyphs();
+    bool missing = false;
+    for (int i = 0; i < used_glyphs.UsedChars.Size && !missing; ++i)
+        missing = (used_glyphs.UsedChars[i] & ~g_font_used_glyphs.UsedChars[i]) != 0;
+    if (!missing)
+        return;
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.Fonts->Clear();
+    load_font();
+    rebuild_imgui_fonts();
+}
+
 void render_spawner()
 {
     int n = 0;
@@ -9426,9 +10537,58 @@ void render_prohud()
     }
 }
 
-void render_tool(std::string tool)
+struct PanelTiming
+{
+    float last_ms{0.0f};
+    float average_ms{0.0f};
+    float peak_ms{0.0f};
+    // ImGui frame the panel was last drawn in
+    int frame{-1};
+};
+std::map<std::string, PanelTiming> g_panel_timings;
+
+void render_panel_timings()
+{
+    if (ImGui::Button("Reset peaks##ResetPanelTimings"))
+    {
+        for (auto& [tool, timing] : g_panel_timings)
+            timing.peak_ms = 0.0f;
+    }
+    // The panel this is drawn in hasn't finished yet, so everything is shown from the previous frame
+    const int last_frame = ImGui::GetFrameCount() - 1;
+    float total_ms = 0.0f;
+    if (ImGui::BeginTable("##PanelTimings", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("Panel");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Average ms");
+        ImGui::TableSetupColumn("Peak ms");
+        ImGui::TableHeadersRow();
+        for (const auto& [tool, timing] : g_panel_timings)
+        {
+            const bool drawn = timing.frame >= last_frame;
+            if (drawn)
+                total_ms += timing.last_ms;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(windows.contains(tool) ? windows[tool]->name.c_str() : tool.c_str());
+            ImGui::TableNextColumn();
+            if (drawn)
+                ImGui::Text("%.3f", timing.last_ms);
+            else
+                ImGui::TextDisabled("hidden");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.average_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.peak_ms);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::Text("Open panels took %.3f ms last frame", total_ms);
+}
+
+void render_tool_contents(const std::string& tool)
 {
-    active_tab = tool;
     if (tool == "tool_entity")
         render_spawner();
     else if (tool == "tool_door")
@@ -9457,6 +10617,20 @@ void render_tool(std::string tool)
         render_texture_viewer();
 }
 
+void render_tool(std::string tool)
+{
+    active_tab = tool;
+    const auto start = std::chrono::steady_clock::now();
+    render_tool_contents(tool);
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    PanelTiming& timing = g_panel_timings[tool];
+    timing.last_ms = ms;
+    timing.average_ms = timing.frame < 0 ? ms : timing.average_ms + (ms - timing.average_ms) * 0.05f;
+    timing.peak_ms = std::max(timing.peak_ms, ms);
+    timing.frame = ImGui::GetFrameCount();
+}
+
 bool is_tab_open(std::string name)
 {
     return std::find(tabs_open.begin(), tabs_open.end(), name) != tabs_open.end();
@@ -9502,8 +10676,9 @@ void imgui_init(ImGuiContext*)
     load_config(cfgfile);
     load_font();
     load_cursor();
-    refresh_script_files();
-    autorun_scripts();
+    // Everything gets compiled on the background thread
+    refresh_script_files(false);
+    start_autorun_scripts();
     set_colors();
     version_check();
     windows["tool_entity"] = new Window({"Spawner", is_tab_detached("tool_entity"), is_tab_open("tool_entity")});
@@ -9613,6 +10788,10 @@ void imgui_draw()
     auto base = ImGui::GetMainViewport();
     ImGuiContext& g = *GImGui;
 
+    // Typed characters are only queued until the end of the frame
+    for (const ImWchar c : ImGui::GetIO().InputQueueCharacters)
+        add_font_glyph(c);
+
     if (get_setting(GAME_SETTING::WINDOW_MODE) == 0u)
         ImGui::GetIO().ConfigFlags &= ~ImGuiConfigFlags_ViewportsEnable;
     else if (options["multi_viewports"])
@@ -9624,6 +10803,8 @@ void imgui_draw()
         viewport->Flags |= ImGuiViewportFlags_NoFocusOnClick | ImGuiViewportFlags_NoFocusOnAppearing | ImGuiViewportFlags_OwnedByApp;
     }
 
+    process_script_changes();
+    update_autorun_scripts();
     render_clickhandler();
     if (!hide_ui && options["draw_hotbar"])
         render_hotbar();
@@ -9817,14 +10998,17 @@ void imgui_draw()
                 ImGui::SetNextWindowViewport(ImGui::GetMainViewport()->ID);
                 flags |= ImGuiWindowFlags_NoBackground;
             }
-            ImGui::Begin(tab.second->name.c_str(), &tab.second->detached, flags);
-            ImGui::PushID(tab.second->name.c_str());
-            if (tab.first != "tool_texture")
-                ImGui::BeginChild("ScrollableTool");
-            render_tool(tab.first);
-            if (tab.first != "tool_texture")
-                ImGui::EndChild();
-            ImGui::PopID();
+            // Collapsed windows and windows docked behind another tab aren't drawn at all
+            if (ImGui::Begin(tab.second->name.c_str(), &tab.second->detached, flags))
+            {
+                ImGui::PushID(tab.second->name.c_str());
+                if (tab.first != "tool_texture")
+                    ImGui::BeginChild("ScrollableTool");
+                render_tool(tab.first);
+                if (tab.first != "tool_texture")
+                    ImGui::EndChild();
+                ImGui::PopID();
+            }
             ImGui::End();
         }
         if (detach_tab != "")
@@ -9973,6 +11157,7 @@ void update_bucket()
 void post_draw()
 {
     check_focus();
+    update_font_glyphs();
     update_players();
     force_kits();
     force_zoom();
@@ -9981,27 +11166,33 @@ void post_draw()
     force_cheats();
     force_lights();
     update_bucket();
+    update_farm();
 }
 
-void create_box(std::vector<EntityItem> items)
+void create_box(const std::vector<EntityItem>& items)
 {
-    std::vector<EntityItem> new_items(items);
-    new_items.emplace(new_items.begin(), "ENT_TYPE_Use entity picker or select entity to spawn:", 0);
-
-    std::sort(new_items.begin(), new_items.end());
+    // Sorted by id already, the placeholder with id 0 goes first
+    std::vector<EntityItem> new_items;
+    new_items.reserve(items.size() + 1);
+    new_items.emplace_back("ENT_TYPE_Use entity picker or select entity to spawn:", 0);
+    new_items.insert(new_items.end(), items.begin(), items.end());
 
     std::vector<int> new_filtered_items(new_items.size());
+    std::vector<std::string> new_item_names(new_items.size());
+    std::map<uint32_t, int> new_items_by_id;
     for (unsigned int i = 0; i < new_items.size(); i++)
     {
         new_filtered_items[i] = i;
-        entity_names[new_items[i].id] = new_items[i].name.substr(9);
-        entity_full_names[new_items[i].id] = new_items[i].name;
+        new_item_names[i] = new_items[i].name;
+        new_items_by_id[new_items[i].id] = i;
     }
 
     // TODO: add atomic and wrap it as struct
     {
         g_current_item = 0;
         g_items = new_items;
+        g_items_index.build(new_item_names, "ENT_TYPE_");
+        g_items_by_id = std::move(new_items_by_id);
         g_filtered_items = new_filtered_items;
         g_filtered_count = static_cast<int>(g_items.size());
     }
@@ -10018,6 +11209,7 @@ std::string make_save_path(std::string_view script_path, std::string_view script
 
 void init_ui(ImGuiContext* ctx)
 {
+    g_startup.started = FrameTelemetry::now();
     g_SoundManager = std::make_unique<SoundManager>(&LoadAudioFile);
 
     API::init(g_SoundManager.get());
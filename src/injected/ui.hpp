@@ -51,6 +51,6 @@ const int OL_WHEEL_UP = 0x12;
 
 struct EntityItem;
 
-void create_box(std::vector<EntityItem> items);
+void create_box(const std::vector<EntityItem>& items);
 void init_ui(struct ImGuiContext* ctx);
 void reload_enabled_scripts();
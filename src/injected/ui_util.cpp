@@ -13,7 +13,7 @@
 #include "entities_items.hpp"        // for Torch
 #include "entities_mounts.hpp"       // for Mount
 #include "entity.hpp"                // for to_id, Entity, get_entity_ptr
-#include "entity_lookup.hpp"         //
+#include "entity_lookup.hpp"         // for get_nearest_entity_at
 #include "game_api.hpp"              //
 #include "game_manager.hpp"          // for get_game_manager, GameManager
 #include "game_patches.hpp"          //
@@ -169,66 +169,13 @@ float UI::screen_distance(float x)
 }
 Entity* UI::get_entity_at(float x, float y, bool s, float radius, uint32_t mask)
 {
-    static const auto masks_order = {
-        0x1,    // Player
-        0x2,    // Mount
-        0x4,    // Monster
-        0x8,    // Item
-        0x80,   // Activefloor
-        0x100,  // Floor
-        0x200,  // Decoration
-        0x400,  // BG
-        0x800,  // Shadow
-        0x2000, // Water
-        0x4000, // Lava
-        0x40,   // FX
-        0x10,   // Explosion
-        0x20,   // Rope
-        0x1000, // Logical
-    };
     if (s)
     {
         std::tie(x, y) = API::click_position(x, y);
     }
-    Entity* current_entity = nullptr;
-    float current_distance = radius;
-    auto check_distance = [&current_entity, &current_distance, &x, &y](Entity* test_entity)
-    {
-        const auto [ix, iy] = test_entity->abs_position();
-        const float distance = (float)std::sqrt(std::pow(x - ix, 2) + std::pow(y - iy, 2));
-        if (distance < current_distance)
-        {
-            current_entity = test_entity;
-            current_distance = distance;
-        }
-    };
+    // Called for every hover, the region grids keep it from going through every entity of the layer
     auto state = HeapBase::get().state();
-    if (mask == 0)
-    {
-        for (auto& item : state->layers[state->camera_layer]->all_entities.entities())
-        {
-            check_distance(item);
-        }
-    }
-    else
-    {
-        for (auto current_mask : masks_order)
-        {
-            if ((mask & current_mask) == 0)
-                continue;
-
-            const auto& entities = state->layers[state->camera_layer]->entities_by_mask.find(current_mask);
-            if (entities == state->layers[state->camera_layer]->entities_by_mask.end())
-                continue;
-
-            for (auto& item : entities->second.entities())
-            {
-                check_distance(item);
-            }
-        }
-    }
-
-    return current_entity;
+    return get_nearest_entity_at(static_cast<ENTITY_MASK>(mask), x, y, state->layers[state->camera_layer], radius);
 }
 void UI::move_entity(uint32_t uid, float x, float y, bool s, float vx, float vy, bool snap)
 {
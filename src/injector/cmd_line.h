@@ -1,9 +1,10 @@
 #pragma once
 
-#include <charconv>    // for from_chars, from_chars_result
-#include <new>         // for operator new
-#include <string_view> // for string_view
-#include <vector>      // for allocator, vector
+#include <charconv>     // for from_chars, from_chars_result
+#include <new>          // for operator new
+#include <string_view>  // for string_view
+#include <system_error> // for errc
+#include <vector>       // for allocator, vector
 
 class CmdLineParser
 {
@@ -42,7 +43,7 @@ inline int GetCmdLineParam<int>(const CmdLineParser& parser, std::string_view ar
     int ret;
     std::string_view param = GetCmdLineParam<std::string_view>(parser, arg, "none");
     std::from_chars_result char_conv_result = std::from_chars(param.data(), param.data() + param.size(), ret);
-    if (char_conv_result.ptr == arg.data())
+    if (char_conv_result.ec != std::errc{})
     {
         return default_value;
     }
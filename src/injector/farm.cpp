@@ -0,0 +1,289 @@
+#include "farm.h"
+
+#include <Windows.h>    // for CreateNamedPipeA, ConnectNamedPipe, SetProcessAffinityMask, ...
+#include <algorithm>    // for min
+#include <cstring>      // for strlen
+#include <deque>        // for deque
+#include <detours.h>    // for DetourCreateProcessWithDlls
+#include <fmt/format.h> // for format
+#include <fstream>      // for ifstream, ofstream
+#include <mutex>        // for mutex, lock_guard
+#include <optional>     // for optional, nullopt
+#include <string>       // for string, getline
+#include <thread>       // for thread, hardware_concurrency
+#include <vector>       // for vector
+
+#include "logger.h" // for INFO, ERR
+
+namespace fs = std::filesystem;
+
+namespace
+{
+class FarmQueue
+{
+  public:
+    FarmQueue(const fs::path& jobs_path, const fs::path& results_path)
+        : results{results_path, std::ios::out | std::ios::trunc}
+    {
+        std::ifstream file(jobs_path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                jobs.push_back(std::move(line));
+        }
+        total = jobs.size();
+    }
+
+    std::optional<std::string> pop()
+    {
+        std::lock_guard lock{mutex};
+        if (jobs.empty())
+            return std::nullopt;
+        std::string job = std::move(jobs.front());
+        jobs.pop_front();
+        return job;
+    }
+    void push_result(const std::string& result)
+    {
+        std::lock_guard lock{mutex};
+        results << result << '\n';
+        results.flush();
+        done++;
+        INFO("Farm: {}/{} jobs done", done, total);
+    }
+    bool results_open() const
+    {
+        return results.good();
+    }
+    size_t size() const
+    {
+        return total;
+    }
+
+  private:
+    std::mutex mutex;
+    std::deque<std::string> jobs;
+    std::ofstream results;
+    size_t total{0};
+    size_t done{0};
+};
+
+class FarmInstance
+{
+  public:
+    FarmInstance(const FarmOptions& options, FarmQueue& queue, uint32_t index)
+        : options{options}, queue{queue}, index{index}
+    {
+        pipe_name = fmt::format("\\\\.\\pipe\\overlunky_farm_{}_{}", GetCurrentProcessId(), index);
+    }
+
+    void run()
+    {
+        std::optional<std::string> job = queue.pop();
+        while (job.has_value())
+        {
+            if (!launch())
+            {
+                ERR("Farm: Instance {} couldn't launch the game, giving its job up", index);
+                queue.push_result(fmt::format("{{\"status\":\"launch_failed\",\"job\":{}}}", job.value()));
+                job = queue.pop();
+                continue;
+            }
+            // Hands out jobs until the game dies or there are none left, a job that was running when it died goes to the results as crashed
+            while (job.has_value())
+            {
+                std::string result;
+                if (!write_line(job.value()) || !read_line(result))
+                {
+                    ERR("Farm: Instance {} lost its game", index);
+                    queue.push_result(fmt::format("{{\"status\":\"crashed\",\"job\":{}}}", job.value()));
+                    job = queue.pop();
+                    break;
+                }
+                queue.push_result(result);
+                job = queue.pop();
+            }
+            shutdown();
+        }
+    }
+
+  private:
+    bool launch()
+    {
+        pipe = CreateNamedPipeA(pipe_name.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 1, 0x10000, 0x10000, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE)
+            return false;
+
+        std::string child_env = "SteamAppId=418530";
+        child_env += '\0';
+        child_env += fmt::format("{}={}", FARM_PIPE_ENV, pipe_name);
+        const auto this_env = GetEnvironmentStrings();
+        for (auto variable = this_env; *variable; variable += strlen(variable) + 1)
+        {
+            child_env += '\0';
+            child_env += variable;
+        }
+        FreeEnvironmentStrings(this_env);
+        child_env += '\0';
+
+        const auto exe_dir = fs::canonical(options.exe).parent_path().string();
+        const std::string dll_path = options.dll.string();
+        const char* dll_paths[] = {dll_path.c_str()};
+        std::string cmdline{"Spel2.exe"};
+        if (options.oldflip)
+            cmdline += " -oldflip";
+
+        PROCESS_INFORMATION pi{};
+        STARTUPINFOA si{};
+        si.cb = sizeof(STARTUPINFO);
+        // Started suspended so it runs on its core from the first instruction
+        if (!DetourCreateProcessWithDlls(options.exe.string().c_str(), cmdline.data(), NULL, NULL, FALSE, CREATE_DEFAULT_ERROR_MODE | CREATE_SUSPENDED, child_env.data(), exe_dir.c_str(), &si, &pi, 1, dll_paths, NULL))
+        {
+            close_pipe();
+            return false;
+        }
+        process = pi.hProcess;
+        const uint32_t cores = std::min(std::thread::hardware_concurrency(), 64u);
+        if (cores > 0)
+            SetProcessAffinityMask(process, DWORD_PTR{1} << (index % cores));
+        ResumeThread(pi.hThread);
+        CloseHandle(pi.hThread);
+        INFO("Farm: Instance {} launched PID {}", index, pi.dwProcessId);
+
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        bool connected = ConnectNamedPipe(pipe, &overlapped) || GetLastError() == ERROR_PIPE_CONNECTED;
+        if (!connected && GetLastError() == ERROR_IO_PENDING)
+        {
+            // The game may die before it ever connects, waiting on the connection alone would hang then
+            HANDLE handles[] = {overlapped.hEvent, process};
+            DWORD bytes;
+            connected = WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 && GetOverlappedResult(pipe, &overlapped, &bytes, FALSE);
+            if (!connected)
+                CancelIo(pipe);
+        }
+        CloseHandle(overlapped.hEvent);
+        if (!connected)
+            shutdown();
+        return connected;
+    }
+
+    bool wait_io(BOOL started, OVERLAPPED& overlapped, DWORD& bytes)
+    {
+        if (!started && GetLastError() != ERROR_IO_PENDING)
+            return false;
+        HANDLE handles[] = {overlapped.hEvent, process};
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+        {
+            CancelIo(pipe);
+            return false;
+        }
+        return GetOverlappedResult(pipe, &overlapped, &bytes, FALSE);
+    }
+
+    bool write_line(const std::string& line)
+    {
+        const std::string data = line + '\n';
+        size_t written = 0;
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        while (written < data.size())
+        {
+            DWORD bytes = 0;
+            if (!wait_io(WriteFile(pipe, data.data() + written, (DWORD)(data.size() - written), NULL, &overlapped), overlapped, bytes))
+                break;
+            written += bytes;
+        }
+        CloseHandle(overlapped.hEvent);
+        return written == data.size();
+    }
+
+    bool read_line(std::string& line)
+    {
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        bool ok = false;
+        while (true)
+        {
+            if (const auto end = buffer.find('\n'); end != std::string::npos)
+            {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                ok = true;
+                break;
+            }
+            char chunk[0x1000];
+            DWORD bytes = 0;
+            if (!wait_io(ReadFile(pipe, chunk, sizeof(chunk), NULL, &overlapped), overlapped, bytes))
+                break;
+            buffer.append(chunk, bytes);
+        }
+        CloseHandle(overlapped.hEvent);
+        return ok;
+    }
+
+    void close_pipe()
+    {
+        if (pipe != INVALID_HANDLE_VALUE)
+            CloseHandle(pipe);
+        pipe = INVALID_HANDLE_VALUE;
+        buffer.clear();
+    }
+
+    void shutdown()
+    {
+        close_pipe();
+        if (process != NULL)
+        {
+            // The game doesn't have a clean way to quit from the outside, nothing is lost since the results are in already
+            TerminateProcess(process, 0);
+            CloseHandle(process);
+        }
+        process = NULL;
+    }
+
+    const FarmOptions& options;
+    FarmQueue& queue;
+    uint32_t index;
+    std::string pipe_name;
+    HANDLE pipe{INVALID_HANDLE_VALUE};
+    HANDLE process{NULL};
+    std::string buffer;
+};
+} // namespace
+
+void run_farm(const FarmOptions& options)
+{
+    FarmQueue queue{options.jobs, options.results};
+    if (!queue.results_open())
+    {
+        ERR("Farm: Can't write results to {}", options.results.string());
+        return;
+    }
+    if (queue.size() == 0)
+    {
+        INFO("Farm: No jobs in {}", options.jobs.string());
+        return;
+    }
+
+    const uint32_t instances = static_cast<uint32_t>(std::min<size_t>(options.instances, queue.size()));
+    INFO("Farm: Running {} jobs on {} instances", queue.size(), instances);
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < instances; ++i)
+    {
+        workers.emplace_back(
+            [&options, &queue, i]()
+            {
+                FarmInstance instance{options, queue, i};
+                instance.run();
+            });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    INFO("Farm: All jobs done, results are in {}", options.results.string());
+}
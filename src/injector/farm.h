@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>    // for uint32_t
+#include <filesystem> // for path
+
+// Name of the environment variable that tells an injected game which farm pipe to connect to
+inline constexpr const char* FARM_PIPE_ENV = "OVERLUNKY_FARM_PIPE";
+
+struct FarmOptions
+{
+    std::filesystem::path exe;
+    std::filesystem::path dll;
+    // One game process per instance, each one pinned to its own logical core
+    uint32_t instances;
+    // One json job per line, the lines are handed out as they are to the games
+    std::filesystem::path jobs;
+    // One json result per line, in the order the jobs finished
+    std::filesystem::path results;
+    bool oldflip;
+};
+
+// Launches the instances, feeds them the jobs over a named pipe each and collects the results, returns once every job is done
+// A game that crashes gets a "crashed" result for its job and is started again for the rest
+void run_farm(const FarmOptions& options);
@@ -1,7 +1,7 @@
 #include "injector.h"
 
-#include <Psapi.h>     // for GetModuleBaseNameA
-#include <TlHelp32.h>  // for PROCESSENTRY32, CreateToolhelp32Snapshot, Pro...
+#include <Psapi.h>     // for EnumProcessModules, GetModuleFileNameEx
+#include <TlHelp32.h>  // for PROCESSENTRY32, MODULEENTRY32, CreateToolhelp32Snapshot, Pro...
 #include <algorithm>   // for transform
 #include <cctype>      // for tolower
 #include <cstring>     // for size_t, strrchr, NULL
@@ -16,20 +16,24 @@ using namespace std::chrono_literals;
 
 std::vector<MemoryMap> memory_map(const Process& proc)
 {
+    // No unicode
+#undef Module32First
+#undef Module32Next
+#undef MODULEENTRY32
+    // One snapshot of the loaded modules instead of asking for a module name at every memory region
     std::vector<MemoryMap> result;
-    size_t cur = 0;
-    MEMORY_BASIC_INFORMATION mbf = {};
-    char buffer[0x1000] = {};
+    auto snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32, proc.info.pid);
+    if (snapshot == INVALID_HANDLE_VALUE)
+        return result;
 
-    while (VirtualQueryEx(proc.handle, (LPVOID)cur, &mbf, sizeof(mbf)) != 0)
+    MODULEENTRY32 entry = {sizeof(entry)};
+    auto module = Module32First(snapshot, &entry);
+    while (module)
     {
-        auto res = GetModuleBaseNameA(proc.handle, (HMODULE)cur, buffer, sizeof(buffer));
-        if (res != 0)
-        {
-            result.push_back(MemoryMap{cur, std::string(buffer)});
-        };
-        cur += mbf.RegionSize;
+        result.push_back(MemoryMap{(size_t)entry.modBaseAddr, std::string(entry.szModule)});
+        module = Module32Next(snapshot, &entry);
     }
+    CloseHandle(snapshot);
     return result;
 }
 
@@ -197,3 +201,17 @@ std::optional<Process> find_process(std::string name)
     }
     return {};
 }
+
+std::vector<Process> find_processes(std::string name)
+{
+    std::vector<Process> res;
+    for (auto& proc : get_processes())
+    {
+        if (proc.name == name)
+        {
+            if (HANDLE handle = OpenProcess(PROCESS_ALL_ACCESS, 0, proc.pid))
+                res.push_back(Process{handle, proc});
+        }
+    }
+    return res;
+}
@@ -4,6 +4,7 @@
 #include <optional>  // for optional
 #include <stddef.h>  // for size_t
 #include <string>    // for string
+#include <vector>    // for vector
 
 struct MemoryMap
 {
@@ -27,4 +28,5 @@ void inject_dll(const Process& proc, const std::string& name);
 LPTHREAD_START_ROUTINE find_function(const Process& proc, const std::string& library, const std::string& function);
 void call(const Process& proc, LPTHREAD_START_ROUTINE addr, LPVOID args);
 std::optional<Process> find_process(std::string name);
+std::vector<Process> find_processes(std::string name);
 bool find_dll_in_process(DWORD pid, const std::string& name);
@@ -21,10 +21,12 @@
 #include <thread>      // for sleep_for
 #include <type_traits> // for move
 #include <utility>     // for max, min
+#include <vector>      // for vector
 #include <wininet.h>   // for InternetCloseHandle, InternetOpenA, InternetG...
 
 #include "cmd_line.h"  // for GetCmdLineParam, CmdLineParser
-#include "injector.h"  // for Process, ProcessInfo, call, find_function
+#include "farm.h"      // for run_farm, FarmOptions
+#include "injector.h"  // for Process, ProcessInfo, call, find_function, find_processes
 #include "logger.h"    // for INFO, PANIC
 #include "version.hpp" // for get_version
 
@@ -360,6 +362,39 @@ bool inject_search(fs::path overlunky_path)
     return false;
 }
 
+void inject_all(fs::path overlunky_path)
+{
+    auto processes = find_processes(g_exe);
+    if (processes.empty())
+    {
+        INFO("No {} processes found", g_exe);
+        return;
+    }
+
+    // Every injection waits on its own remote thread, so do them side by side
+    std::vector<std::thread> injections;
+    for (Process& proc : processes)
+    {
+        if (find_dll_in_process(proc.info.pid, "Overlunky.dll"))
+        {
+            INFO("PID {} is already injected, skipping it", proc.info.pid);
+            CloseHandle(proc.handle);
+            continue;
+        }
+        injections.emplace_back(
+            [proc, dll_path = overlunky_path.string()]()
+            {
+                inject_dll(proc, dll_path);
+                INFO("DLL injected into PID {}", proc.info.pid);
+                CloseHandle(proc.handle);
+            });
+    }
+    for (std::thread& injection : injections)
+    {
+        injection.join();
+    }
+}
+
 bool launch(fs::path exe_path, fs::path overlunky_path, bool& do_inject, bool& oldflip)
 {
     auto exe_dir = fs::canonical(exe_path).parent_path();
@@ -461,6 +496,10 @@ int main(int argc, char** argv)
         INFO("  --oldflip               launch the game with -oldflip, may improve performance with external windows");
         INFO("  --console               keep console open to debug scripts etc");
         INFO("  --inject                use the old injection method instead of Detours with --launch_game");
+        INFO("  --all                   inject into every running Spel2.exe process that isn't injected yet and exit");
+        INFO("  --farm [count]          launch count games (default one per core) pinned to their own cores and run --jobs on them");
+        INFO("  --jobs [path]           json jobs for --farm, one per line with seed or replay, scripts, turbo and max_frames");
+        INFO("  --results [path]        where --farm writes the json results, one per line (default farm_results.jsonl)");
         INFO("  --info_dump             output a bunch of game data to 'Spelunky 2/game_data'");
         INFO("  --update                reset AutoUpdate setting and update launcher and DLL to the latest WHIP build");
         INFO("  --update_launcher       update launcher to the latest WHIP build");
@@ -525,6 +564,8 @@ int main(int argc, char** argv)
     bool do_inject = GetCmdLineParam<bool>(cmd_line_parser, "inject", false);
     g_console = GetCmdLineParam<bool>(cmd_line_parser, "console", false);
     bool oldflip = GetCmdLineParam<bool>(cmd_line_parser, "oldflip", false);
+    bool all_processes = GetCmdLineParam<bool>(cmd_line_parser, "all", false);
+    bool farm = GetCmdLineParam<bool>(cmd_line_parser, "farm", false);
     if (info_dump)
     {
         do_inject = true;
@@ -532,6 +573,14 @@ int main(int argc, char** argv)
     }
     fs::path exe;
 
+    if (all_processes)
+    {
+        inject_all(overlunky_path);
+        LogSink::get().shutdown();
+        FreeConsole();
+        return 0;
+    }
+
     if (!launch_game.empty())
     {
         auto launch_path = fs::canonical(launch_game);
@@ -541,10 +590,34 @@ int main(int argc, char** argv)
             exe = launch_path;
     }
 
+    if (farm)
+    {
+        if (!fs::exists(exe))
+            exe = fs::absolute("../Spel2.exe");
+        auto jobs = GetCmdLineParam<std::string_view>(cmd_line_parser, "jobs", "");
+        if (!fs::exists(exe) || jobs.empty())
+        {
+            INFO("Farm needs the game, see --launch_game, and a --jobs file");
+            return 1;
+        }
+        const int instances = GetCmdLineParam<int>(cmd_line_parser, "farm", (int)std::thread::hardware_concurrency());
+        FarmOptions options{
+            .exe = exe,
+            .dll = overlunky_path,
+            .instances = (uint32_t)std::max(instances, 1),
+            .jobs = jobs,
+            .results = GetCmdLineParam<std::string_view>(cmd_line_parser, "results", "farm_results.jsonl"),
+            .oldflip = oldflip,
+        };
+        run_farm(options);
+        return 0;
+    }
+
     if (fs::exists(exe))
     {
         if (launch(exe, overlunky_path, do_inject, oldflip))
         {
+            LogSink::get().shutdown();
             FreeConsole();
             return 0;
         }
@@ -556,6 +629,7 @@ int main(int argc, char** argv)
             launch(fs::canonical("../Spel2.exe"), overlunky_path, do_inject, oldflip);
         }
     }
+    LogSink::get().shutdown();
     FreeConsole();
     return 0;
 }
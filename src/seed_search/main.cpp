@@ -0,0 +1,296 @@
+#include <algorithm>    // for sort, min, max
+#include <atomic>       // for atomic
+#include <charconv>     // for from_chars
+#include <chrono>       // for steady_clock, duration
+#include <cstdint>      // for uint32_t, uint64_t, int64_t
+#include <fmt/format.h> // for print
+#include <mutex>        // for mutex, lock_guard
+#include <optional>     // for optional, nullopt
+#include <string_view>  // for string_view
+#include <system_error> // for errc
+#include <thread>       // for thread, hardware_concurrency
+#include <vector>       // for vector
+
+#include "cmd_line.h"     // for GetCmdLineParam, CmdLineParser
+#include "prng_model.hpp" // for seed_prng_pairs, advance_prng_pair, wrap_prng_random
+
+// Searches seeded runs for seeds whose PRNG state matches all given predicates, without running the game
+// Every predicate looks at a single roll: the n-th number taken from one of the PRNG classes after `seed_prng`
+// Keep in mind that the game takes plenty of rolls while generating the first level, so `roll` has to account for those
+
+enum class RollKind
+{
+    Chance,
+    Int,
+    Float,
+};
+
+struct RollPredicate
+{
+    RollKind kind;
+    std::uint32_t prng_class;
+    /// 1-based index of the roll in the class
+    std::uint32_t roll;
+    /// Chance: inverse chance, Int: min of the range
+    std::int64_t a;
+    /// Int: max of the range, Float: upper bound
+    std::int64_t b;
+    /// Int: expected value
+    std::int64_t c;
+    float below;
+};
+
+template <class T>
+std::optional<T> parse_number(std::string_view str, int base = 10)
+{
+    T ret;
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), ret, base);
+    if (ec != std::errc{} || ptr != str.data() + str.size())
+        return std::nullopt;
+    return ret;
+}
+
+std::optional<float> parse_float(std::string_view str)
+{
+    float ret;
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), ret);
+    if (ec != std::errc{} || ptr != str.data() + str.size())
+        return std::nullopt;
+    return ret;
+}
+
+std::vector<std::string_view> split_args(std::string_view arg)
+{
+    std::vector<std::string_view> parts;
+    while (true)
+    {
+        const size_t comma = arg.find(',');
+        parts.push_back(arg.substr(0, comma));
+        if (comma == std::string_view::npos)
+            break;
+        arg.remove_prefix(comma + 1);
+    }
+    return parts;
+}
+
+std::optional<RollPredicate> parse_predicate(RollKind kind, std::string_view arg)
+{
+    const std::vector<std::string_view> parts = split_args(arg);
+    const size_t expected_parts = kind == RollKind::Int ? 5 : 3;
+    if (parts.size() != expected_parts)
+        return std::nullopt;
+
+    RollPredicate pred{kind, 0, 0, 0, 0, 0, 0.0f};
+    const auto prng_class = parse_number<std::uint32_t>(parts[0]);
+    const auto roll = parse_number<std::uint32_t>(parts[1]);
+    if (!prng_class || *prng_class > 9 || !roll || *roll == 0)
+        return std::nullopt;
+    pred.prng_class = *prng_class;
+    pred.roll = *roll;
+
+    switch (kind)
+    {
+    case RollKind::Chance:
+    {
+        const auto inverse_chance = parse_number<std::int64_t>(parts[2]);
+        if (!inverse_chance)
+            return std::nullopt;
+        pred.a = *inverse_chance;
+        break;
+    }
+    case RollKind::Int:
+    {
+        const auto min = parse_number<std::int64_t>(parts[2]);
+        const auto max = parse_number<std::int64_t>(parts[3]);
+        const auto value = parse_number<std::int64_t>(parts[4]);
+        if (!min || !max || !value)
+            return std::nullopt;
+        pred.a = std::min(*min, *max);
+        pred.b = std::max(*min, *max);
+        pred.c = *value;
+        break;
+    }
+    case RollKind::Float:
+    {
+        const auto below = parse_float(parts[2]);
+        if (!below)
+            return std::nullopt;
+        pred.below = *below;
+        break;
+    }
+    }
+    return pred;
+}
+
+// Same math as `PRNG::random_chance`, `PRNG::random_int` and `PRNG::random_float`
+bool test_roll(const RollPredicate& pred, const prng_pair& pair)
+{
+    switch (pred.kind)
+    {
+    case RollKind::Chance:
+        if (pred.a <= 0)
+            return false;
+        if (pred.a == 1)
+            return true;
+        return wrap_prng_random(static_cast<std::int64_t>(pair.first), 0, pred.a) == 0;
+    case RollKind::Int:
+        return wrap_prng_random(static_cast<std::int64_t>(pair.first), pred.a, pred.b + 1) == pred.c;
+    case RollKind::Float:
+        return prng_pair_to_float(pair) < pred.below;
+    }
+    return false;
+}
+
+bool test_seed(std::uint32_t seed, const std::vector<RollPredicate>& predicates)
+{
+    const prng_pairs pairs = seed_prng_pairs(seed);
+
+    // Predicates are sorted by class and roll, so each class is only walked forward once
+    prng_pair pair{};
+    std::uint32_t current_class = ~0u;
+    std::uint32_t current_roll = 0;
+    for (const RollPredicate& pred : predicates)
+    {
+        if (pred.prng_class != current_class)
+        {
+            current_class = pred.prng_class;
+            current_roll = 1;
+            pair = pairs[current_class];
+        }
+        for (; current_roll < pred.roll; ++current_roll)
+        {
+            advance_prng_pair(pair);
+        }
+        if (!test_roll(pred, pair))
+            return false;
+    }
+    return true;
+}
+
+void print_usage()
+{
+    fmt::print(
+        "Usage: seed_search [predicates] [options]\n"
+        "Predicates, all of them have to match, the same flag can take multiple predicates:\n"
+        "--chance CLASS,ROLL,INVERSE_CHANCE  roll number ROLL of PRNG_CLASS CLASS passes random_chance(INVERSE_CHANCE)\n"
+        "--int CLASS,ROLL,MIN,MAX,VALUE      roll number ROLL of PRNG_CLASS CLASS gives VALUE for random_int(MIN, MAX)\n"
+        "--float CLASS,ROLL,BELOW            roll number ROLL of PRNG_CLASS CLASS gives less than BELOW for random_float()\n"
+        "Options:\n"
+        "--from SEED    first seed to test, in hex like the game shows seeds (default 0)\n"
+        "--to SEED      last seed to test, in hex (default FFFFFFFF)\n"
+        "--limit N      stop after N matching seeds (default 100)\n"
+        "--threads N    number of worker threads (default all cores)\n");
+}
+
+int main(int argc, char** argv)
+{
+    CmdLineParser cmd_line_parser(argc, argv);
+
+    if (GetCmdLineParam<bool>(cmd_line_parser, "help", false))
+    {
+        print_usage();
+        return 0;
+    }
+
+    std::vector<RollPredicate> predicates;
+    constexpr std::pair<std::string_view, RollKind> predicate_args[]{
+        {"chance", RollKind::Chance},
+        {"int", RollKind::Int},
+        {"float", RollKind::Float},
+    };
+    for (const auto& [arg_name, kind] : predicate_args)
+    {
+        for (std::string_view arg : GetCmdLineParam<std::vector<std::string_view>>(cmd_line_parser, arg_name, {}))
+        {
+            if (auto pred = parse_predicate(kind, arg))
+            {
+                predicates.push_back(*pred);
+            }
+            else
+            {
+                fmt::print("Invalid --{} predicate '{}'\n", arg_name, arg);
+                print_usage();
+                return 1;
+            }
+        }
+    }
+    if (predicates.empty())
+    {
+        print_usage();
+        return 1;
+    }
+    std::sort(predicates.begin(), predicates.end(), [](const RollPredicate& lhs, const RollPredicate& rhs)
+              { return lhs.prng_class != rhs.prng_class ? lhs.prng_class < rhs.prng_class : lhs.roll < rhs.roll; });
+
+    const auto from = parse_number<std::uint32_t>(GetCmdLineParam<std::string_view>(cmd_line_parser, "from", "0"), 16);
+    const auto to = parse_number<std::uint32_t>(GetCmdLineParam<std::string_view>(cmd_line_parser, "to", "FFFFFFFF"), 16);
+    if (!from || !to || *to < *from)
+    {
+        fmt::print("Invalid seed range\n");
+        return 1;
+    }
+
+    const int limit = std::max(GetCmdLineParam<int>(cmd_line_parser, "limit", 100), 1);
+    const int num_threads = std::max(GetCmdLineParam<int>(cmd_line_parser, "threads", static_cast<int>(std::thread::hardware_concurrency())), 1);
+
+    // Workers grab seeds in blocks, keeps contention on the counter negligible
+    constexpr std::uint64_t block_size = 1 << 16;
+    const std::uint64_t first_seed = *from;
+    const std::uint64_t end_seed = static_cast<std::uint64_t>(*to) + 1;
+    std::atomic<std::uint64_t> next_block{first_seed};
+    std::atomic<int> num_found{0};
+
+    std::mutex found_mutex;
+    std::vector<std::uint32_t> found_seeds;
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(
+            [&]()
+            {
+                std::vector<std::uint32_t> local_found;
+                while (num_found.load(std::memory_order_relaxed) < limit)
+                {
+                    const std::uint64_t block_begin = next_block.fetch_add(block_size, std::memory_order_relaxed);
+                    if (block_begin >= end_seed)
+                        break;
+
+                    const std::uint64_t block_end = std::min(block_begin + block_size, end_seed);
+                    for (std::uint64_t seed = block_begin; seed < block_end; ++seed)
+                    {
+                        if (test_seed(static_cast<std::uint32_t>(seed), predicates))
+                        {
+                            local_found.push_back(static_cast<std::uint32_t>(seed));
+                            num_found.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                }
+
+                std::lock_guard lock{found_mutex};
+                found_seeds.insert(found_seeds.end(), local_found.begin(), local_found.end());
+            });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    const std::uint64_t tested_seeds = std::min(next_block.load(), end_seed) - first_seed;
+
+    // Blocks finish out of order, so sort to report the lowest matching seeds
+    std::sort(found_seeds.begin(), found_seeds.end());
+    if (found_seeds.size() > static_cast<size_t>(limit))
+        found_seeds.resize(limit);
+
+    for (std::uint32_t seed : found_seeds)
+    {
+        fmt::print("{:08X}\n", seed);
+    }
+    fmt::print("Found {} seeds, tested {} seeds in {:.2f}s ({:.1f}M seeds/s)\n", found_seeds.size(), tested_seeds, elapsed.count(), tested_seeds / elapsed.count() / 1'000'000.0);
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>   // for lower_bound
+#include <cstddef>     // for size_t, byte
+#include <cstdint>     // for uint32_t, int32_t, uint8_t
+#include <cstring>     // for memcmp
+#include <span>        // for span
+#include <string_view> // for string_view
+
+// Layout of game_data/game_data.bin, written by info_dump next to the json files
+// Everything is little endian and 4 byte aligned, so the file can be memory mapped and used in place:
+//   Header, Section[num_sections], section records, string pool
+// Records in every section are sorted by id, names point into the string pool and are null terminated there as well
+namespace GameDataBinary
+{
+inline constexpr char magic[4]{'O', 'L', 'G', 'D'};
+// Bump when a record changes, readers refuse files with another version
+inline constexpr uint32_t version = 1;
+
+enum class SectionKind : uint32_t
+{
+    Entities = 1,
+    Textures = 2,
+    Particles = 3,
+    Strings = 4,
+};
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t num_sections;
+    uint32_t string_pool_offset;
+    uint32_t string_pool_size;
+};
+
+struct Section
+{
+    SectionKind kind;
+    uint32_t count;
+    uint32_t offset;
+    // Readers ignore sections whose record size doesn't match their own struct
+    uint32_t record_size;
+};
+
+struct String
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct Entity
+{
+    uint32_t id;
+    String name;
+    uint32_t search_flags;
+    uint32_t texture;
+    int32_t technique;
+    int32_t tile_x;
+    int32_t tile_y;
+    float width;
+    float height;
+    float friction;
+    float elasticity;
+    float weight;
+    float acceleration;
+    float max_speed;
+    float sprint_factor;
+    float jump;
+    uint8_t damage;
+    uint8_t life;
+    uint8_t padding[2];
+};
+
+struct Texture
+{
+    uint32_t id;
+    String path;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_tiles_width;
+    uint32_t num_tiles_height;
+    uint32_t tile_width;
+    uint32_t tile_height;
+    uint32_t offset_width;
+    uint32_t offset_height;
+};
+
+struct Particle
+{
+    uint32_t id;
+    String name;
+};
+
+// Game strings by STRINGID, text is utf-8
+struct GameString
+{
+    uint32_t id;
+    uint32_t hash;
+    String text;
+};
+
+// Read-only view over the bytes of a game_data.bin, doesn't copy anything so the data has to outlive the view
+class View
+{
+  public:
+    View() = default;
+    explicit View(std::span<const std::byte> data_)
+    {
+        if (data_.size() < sizeof(Header))
+            return;
+        const Header* header = reinterpret_cast<const Header*>(data_.data());
+        if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version)
+            return;
+        if (sizeof(Header) + size_t{header->num_sections} * sizeof(Section) > data_.size() ||
+            size_t{header->string_pool_offset} + header->string_pool_size > data_.size())
+            return;
+
+        const Section* sections = reinterpret_cast<const Section*>(data_.data() + sizeof(Header));
+        for (uint32_t i = 0; i < header->num_sections; ++i)
+        {
+            const Section& section = sections[i];
+            if (size_t{section.offset} + size_t{section.count} * section.record_size > data_.size())
+                return;
+        }
+
+        data = data_;
+        pool = {reinterpret_cast<const char*>(data_.data() + header->string_pool_offset), header->string_pool_size};
+    }
+
+    // False if the data is too short, from another version or not a game_data.bin at all
+    bool valid() const
+    {
+        return !data.empty();
+    }
+
+    std::span<const Entity> entities() const
+    {
+        return records<Entity>(SectionKind::Entities);
+    }
+    std::span<const Texture> textures() const
+    {
+        return records<Texture>(SectionKind::Textures);
+    }
+    std::span<const Particle> particles() const
+    {
+        return records<Particle>(SectionKind::Particles);
+    }
+    std::span<const GameString> strings() const
+    {
+        return records<GameString>(SectionKind::Strings);
+    }
+
+    const Entity* entity(uint32_t id) const
+    {
+        return find(entities(), id);
+    }
+    const Texture* texture(uint32_t id) const
+    {
+        return find(textures(), id);
+    }
+    const Particle* particle(uint32_t id) const
+    {
+        return find(particles(), id);
+    }
+    const GameString* string(uint32_t id) const
+    {
+        return find(strings(), id);
+    }
+
+    std::string_view text(String str) const
+    {
+        if (size_t{str.offset} + str.size > pool.size())
+            return {};
+        return pool.substr(str.offset, str.size);
+    }
+
+  private:
+    template <class T>
+    std::span<const T> records(SectionKind kind) const
+    {
+        if (!valid())
+            return {};
+        const Header* header = reinterpret_cast<const Header*>(data.data());
+        const Section* sections = reinterpret_cast<const Section*>(data.data() + sizeof(Header));
+        for (uint32_t i = 0; i < header->num_sections; ++i)
+        {
+            // Records of another size can't be used in place
+            if (sections[i].kind == kind && sections[i].record_size == sizeof(T))
+                return {reinterpret_cast<const T*>(data.data() + sections[i].offset), sections[i].count};
+        }
+        return {};
+    }
+
+    template <class T>
+    static const T* find(std::span<const T> table, uint32_t id)
+    {
+        auto it = std::lower_bound(table.begin(), table.end(), id, [](const T& record, uint32_t value)
+                                   { return record.id < value; });
+        if (it == table.end() || it->id != id)
+            return nullptr;
+        return &*it;
+    }
+
+    std::span<const std::byte> data;
+    std::string_view pool;
+};
+} // namespace GameDataBinary
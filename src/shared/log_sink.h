@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>   // for array
+#include <atomic>  // for atomic, memory_order
+#include <chrono>  // for steady_clock, milliseconds
+#include <cstdint> // for intptr_t, uint32_t
+#include <cstdio>  // for fwrite, fflush, stdout
+#include <cstdlib> // for atexit, getenv_s
+#include <cstring> // for strcmp
+#include <mutex>   // for mutex, once_flag, call_once, unique_lock
+#include <string>  // for string
+#include <thread>  // for thread, sleep_for
+#include <utility> // for move
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_PANIC 3
+
+// Messages below this level are compiled out, define it for the target to drop the DEBUG output of a build entirely
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Takes preformatted lines from any thread into a lock-free ring and writes them to stdout on a background thread,
+// so logging doesn't wait on the console. Identical lines in a row are written once with a count of the repeats,
+// lines are only dropped and counted if the ring stays full for a while. The level can also be raised with OVERLUNKY_LOG_LEVEL=info|error
+class LogSink
+{
+  public:
+    static constexpr size_t CAPACITY = 4096;
+    static constexpr uint32_t MAX_WAITS = 1000;
+
+    static LogSink& get()
+    {
+        // Never destroyed, the writer thread runs until shutdown or the process exits
+        static LogSink* sink = new LogSink();
+        return *sink;
+    }
+
+    bool enabled(int level) const
+    {
+        return level >= min_level.load(std::memory_order_relaxed);
+    }
+    void set_level(int level)
+    {
+        min_level.store(level, std::memory_order_relaxed);
+    }
+
+    // False if the ring stayed full and the line was dropped
+    bool push(std::string line)
+    {
+        std::call_once(writer_started, [this]()
+                       { writer = std::thread([this]()
+                                              { run_writer(); }); });
+        // Once the writer is gone the lines are written right away
+        if (stopping.load(std::memory_order_acquire))
+        {
+            enqueue(std::move(line));
+            flush();
+            return true;
+        }
+        return enqueue(std::move(line));
+    }
+
+    // Writes everything queued so far on the calling thread, gives up after a moment if the writer thread doesn't let go,
+    // it may already be gone when this runs at exit
+    void flush()
+    {
+        std::unique_lock lock{consumer, std::defer_lock};
+        for (int i = 0; i < 100 && !lock.try_lock(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (lock.owns_lock())
+        {
+            drain();
+            write_repeats();
+            fflush(stdout);
+        }
+    }
+
+    // Stops and joins the writer thread, then writes what is left. Call it before the console goes away,
+    // anything logged after this is written synchronously
+    void shutdown()
+    {
+        stopping.store(true, std::memory_order_release);
+        if (writer.joinable() && writer.get_id() != std::this_thread::get_id())
+            writer.join();
+        flush();
+    }
+
+  private:
+    struct Slot
+    {
+        // Equal to the push position when free, one past it when it holds a line
+        std::atomic<size_t> sequence;
+        std::string line;
+    };
+
+    bool enqueue(std::string line)
+    {
+
+        size_t pos = head.load(std::memory_order_relaxed);
+        uint32_t waits = 0;
+        while (true)
+        {
+            Slot& slot = slots[pos % CAPACITY];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.line = std::move(line);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Full, give the writer a moment before losing the line
+                if (++waits > MAX_WAITS)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                std::this_thread::yield();
+                pos = head.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    LogSink()
+    {
+        for (size_t i = 0; i < CAPACITY; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+
+        char level[16]{};
+        size_t level_size{0};
+        getenv_s(&level_size, level, "OVERLUNKY_LOG_LEVEL");
+        if (std::strcmp(level, "info") == 0)
+            min_level = LOG_LEVEL_INFO;
+        else if (std::strcmp(level, "error") == 0)
+            min_level = LOG_LEVEL_ERROR;
+
+        std::atexit([]()
+                    { LogSink::get().flush(); });
+    }
+
+    void run_writer()
+    {
+        while (!stopping.load(std::memory_order_acquire))
+        {
+            bool wrote;
+            {
+                std::lock_guard lock{consumer};
+                wrote = drain();
+                // Repeats are only written when a different line comes, or after a second without one
+                if (repeats > 0 && std::chrono::steady_clock::now() - last_write > std::chrono::seconds(1))
+                {
+                    write_repeats();
+                    wrote = true;
+                }
+                if (wrote)
+                    fflush(stdout);
+            }
+            if (!wrote)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Only called with the consumer lock held
+    bool drain()
+    {
+        bool wrote = false;
+        while (true)
+        {
+            Slot& slot = slots[tail % CAPACITY];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+                break;
+            std::string line = std::move(slot.line);
+            slot.line.clear();
+            slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+            tail++;
+            write(line);
+            wrote = true;
+        }
+        if (const size_t lost = dropped.exchange(0, std::memory_order_relaxed); lost > 0)
+        {
+            write_repeats();
+            const std::string line = "[log] dropped " + std::to_string(lost) + " messages\n";
+            fwrite(line.data(), 1, line.size(), stdout);
+            wrote = true;
+        }
+        return wrote;
+    }
+    void write(std::string& line)
+    {
+        if (line == last_line)
+        {
+            repeats++;
+            return;
+        }
+        write_repeats();
+        fwrite(line.data(), 1, line.size(), stdout);
+        last_line = std::move(line);
+        last_write = std::chrono::steady_clock::now();
+    }
+    void write_repeats()
+    {
+        if (repeats == 0)
+            return;
+        const std::string line = "[log] last message repeated " + std::to_string(repeats) + " times\n";
+        fwrite(line.data(), 1, line.size(), stdout);
+        repeats = 0;
+        last_write = std::chrono::steady_clock::now();
+    }
+
+    std::array<Slot, CAPACITY> slots;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> dropped{0};
+    std::atomic<int> min_level{LOG_MIN_LEVEL};
+    std::once_flag writer_started;
+    std::thread writer;
+    std::atomic<bool> stopping{false};
+
+    std::mutex consumer;
+    size_t tail{0};
+    std::string last_line;
+    size_t repeats{0};
+    std::chrono::steady_clock::time_point last_write;
+};
@@ -5,6 +5,8 @@
 
 #include <span>
 
+#include "log_sink.h"
+
 struct ByteStr
 {
     std::string_view str;
@@ -56,44 +58,54 @@ struct fmt::formatter<ByteStr>
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
 
-#define COMMON_FORMATTER(name, format, ...)                 \
-    try                                                     \
-    {                                                       \
-        fflush(stdout);                                     \
-        fmt::print("[" name "] " format "\n", __VA_ARGS__); \
-        fflush(stdout);                                     \
-    }                                                       \
-    catch (fmt::format_error & e)                           \
-    {                                                       \
-        puts("Formatting exception:" format);               \
-        puts(__FILE__ " at " TOSTRING(__LINE__));           \
-        puts(e.what());                                     \
-    }                                                       \
-    catch (...)                                             \
-    {                                                       \
+#define COMMON_FORMATTER(level, name, message, ...)                                    \
+    try                                                                                \
+    {                                                                                  \
+        if (LogSink::get().enabled(level))                                             \
+            LogSink::get().push(fmt::format("[" name "] " message "\n", __VA_ARGS__)); \
+    }                                                                                  \
+    catch (fmt::format_error & e)                                                      \
+    {                                                                                  \
+        LogSink::get().push("Formatting exception:" message "\n");                     \
+        LogSink::get().push(__FILE__ " at " TOSTRING(__LINE__) "\n");                  \
+        LogSink::get().push(e.what() + std::string{"\n"});                             \
+    }                                                                                  \
+    catch (...)                                                                        \
+    {                                                                                  \
     }
 
-#define PANIC(format, ...)                              \
-    do                                                  \
-    {                                                   \
-        COMMON_FORMATTER("panic", format, __VA_ARGS__); \
-        std::exit(-1);                                  \
+// Everything queued before the panic is written out before exiting
+#define PANIC(format, ...)                                               \
+    do                                                                   \
+    {                                                                    \
+        COMMON_FORMATTER(LOG_LEVEL_PANIC, "panic", format, __VA_ARGS__); \
+        LogSink::get().flush();                                          \
+        std::exit(-1);                                                   \
     } while (false)
 
-#define ERR(format, ...)                                \
-    do                                                  \
-    {                                                   \
-        COMMON_FORMATTER("error", format, __VA_ARGS__); \
+#define ERR(format, ...)                                                     \
+    do                                                                       \
+    {                                                                        \
+        if constexpr (LOG_LEVEL_ERROR >= LOG_MIN_LEVEL)                      \
+        {                                                                    \
+            COMMON_FORMATTER(LOG_LEVEL_ERROR, "error", format, __VA_ARGS__); \
+        }                                                                    \
     } while (false)
 
-#define DEBUG(format, ...)                              \
-    do                                                  \
-    {                                                   \
-        COMMON_FORMATTER("debug", format, __VA_ARGS__); \
+#define DEBUG(format, ...)                                                   \
+    do                                                                       \
+    {                                                                        \
+        if constexpr (LOG_LEVEL_DEBUG >= LOG_MIN_LEVEL)                      \
+        {                                                                    \
+            COMMON_FORMATTER(LOG_LEVEL_DEBUG, "debug", format, __VA_ARGS__); \
+        }                                                                    \
     } while (false)
 
-#define INFO(format, ...)                              \
-    do                                                 \
-    {                                                  \
-        COMMON_FORMATTER("info", format, __VA_ARGS__); \
+#define INFO(format, ...)                                                  \
+    do                                                                     \
+    {                                                                      \
+        if constexpr (LOG_LEVEL_INFO >= LOG_MIN_LEVEL)                     \
+        {                                                                  \
+            COMMON_FORMATTER(LOG_LEVEL_INFO, "info", format, __VA_ARGS__); \
+        }                                                                  \
     } while (false)
@@ -0,0 +1,149 @@
+#include "shared_export.hpp"
+
+#include <Windows.h> // for CreateFileMappingA, MapViewOfFile
+#include <algorithm> // for min
+#include <atomic>    // for atomic_thread_fence
+#include <chrono>    // for duration_cast, milliseconds
+#include <cstdint>   // for UINT64_MAX
+#include <cstring>   // for memcpy
+
+#include "heap_base.hpp"                // for HeapBase
+#include "script.hpp"                   // for SpelunkyScript, ScriptMessage
+#include "script/callback_profiler.hpp" // for CallbackProfiler, get_callback_stats
+#include "state.hpp"                    // for StateMemory
+
+namespace
+{
+// Collecting the callback stats allocates, so they're only summed every so often
+constexpr uint64_t SCRIPT_STATS_INTERVAL = 30;
+} // namespace
+
+SharedExport& SharedExport::get()
+{
+    static SharedExport shared_export;
+    return shared_export;
+}
+
+const SpelunkyExport* SharedExport::open(const char* name)
+{
+    if (region != nullptr)
+        return region;
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(SpelunkyExport), name);
+    if (mapping == nullptr)
+        return nullptr;
+    region = static_cast<SpelunkyExport*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SpelunkyExport)));
+    if (region == nullptr)
+    {
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return nullptr;
+    }
+
+    // Fresh mappings are zeroed, so every slot starts out as not written
+    region->Version = SPELUNKY_EXPORT_VERSION;
+    region->Size = sizeof(SpelunkyExport);
+    message_head = 0;
+    // Only messages printed from now on are published
+    for (ScriptCursor& cursor : scripts)
+        cursor.sequence = cursor.script->loop_messages_since(UINT64_MAX, [](const ScriptMessage&) {});
+    return region;
+}
+void SharedExport::close()
+{
+    if (region != nullptr)
+        UnmapViewOfFile(region);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    region = nullptr;
+    mapping = nullptr;
+}
+
+void SharedExport::add_script(SpelunkyScript* script)
+{
+    scripts.push_back({script, 0});
+}
+void SharedExport::remove_script(SpelunkyScript* script)
+{
+    std::erase_if(scripts, [script](const ScriptCursor& cursor)
+                  { return cursor.script == script; });
+}
+
+void SharedExport::publish()
+{
+    if (region == nullptr)
+        return;
+
+    const double publish_start_ms = CallbackProfiler::ticks_to_ms(CallbackProfiler::now());
+    for (ScriptCursor& cursor : scripts)
+    {
+        const uint64_t script_id = reinterpret_cast<uint64_t>(cursor.script);
+        cursor.sequence = cursor.script->loop_messages_since(
+            cursor.sequence,
+            [&](const ScriptMessage& message)
+            {
+                SpelunkyExportMessage& slot = region->Messages[message_head % SPELUNKY_EXPORT_NUM_MESSAGES];
+                slot.Sequence = 0;
+                std::atomic_thread_fence(std::memory_order_release);
+
+                const size_t length = std::min<size_t>(message.message.size(), SPELUNKY_EXPORT_MESSAGE_SIZE - 1);
+                if (length < message.message.size())
+                    messages_cut++;
+                slot.TimeMilliSecond = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(message.time.time_since_epoch()).count());
+                slot.Script = script_id;
+                slot.Length = static_cast<uint32_t>(message.message.size());
+                std::memcpy(slot.Text, message.message.data(), length);
+                slot.Text[length] = '\0';
+
+                std::atomic_thread_fence(std::memory_order_release);
+                slot.Sequence = message_head + 1;
+                message_head++;
+            });
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    region->MessageHead = message_head;
+
+    publish_state(publish_start_ms);
+}
+
+void SharedExport::publish_state(double publish_start_ms)
+{
+    const int64_t now = CallbackProfiler::now();
+    if (last_publish != 0)
+        frame_ms = CallbackProfiler::ticks_to_ms(now - last_publish);
+    last_publish = now;
+
+    const uint64_t frames = region->State.Frames + 1;
+    if (frames % SCRIPT_STATS_INTERVAL == 1)
+    {
+        script_ms = 0.0;
+        for (const CallbackStats& stats : get_callback_stats())
+            script_ms += stats.frame_ms;
+    }
+
+    SpelunkyExportState state{};
+    if (StateMemory* game_state = HeapBase::get().state())
+    {
+        state.Screen = static_cast<SpelunkyScreen>(game_state->screen);
+        state.Pause = static_cast<uint32_t>(game_state->pause);
+        state.TimeLevel = game_state->time_level;
+        state.TimeTotal = game_state->time_total;
+        state.TimeStartup = game_state->time_startup;
+        state.Seed = game_state->seed;
+        state.World = game_state->world;
+        state.Level = game_state->level;
+        state.Theme = static_cast<uint8_t>(game_state->theme);
+    }
+    state.Frames = frames;
+    state.FrameMilliSecond = frame_ms;
+    state.ScriptMilliSecond = script_ms;
+    state.MessagesCut = messages_cut;
+    state.PublishMilliSecond = CallbackProfiler::ticks_to_ms(CallbackProfiler::now()) - publish_start_ms;
+
+    // Seqlock, readers retry if the sequence was odd or changed while they copied
+    region->StateSequence = region->StateSequence + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+    region->State = state;
+    std::atomic_thread_fence(std::memory_order_release);
+    region->StateSequence = region->StateSequence + 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint> // for uint64_t
+#include <vector>  // for vector
+
+#include "spel2.h" // for SpelunkyExport
+
+class SpelunkyScript;
+
+// Owns the mapped SpelunkyExport region and fills it once per frame, only ever touched from the render thread
+class SharedExport
+{
+  public:
+    static SharedExport& get();
+
+    const SpelunkyExport* open(const char* name);
+    void close();
+
+    void add_script(SpelunkyScript* script);
+    void remove_script(SpelunkyScript* script);
+
+    // Copies what's new since the last call, does nothing while the region isn't open
+    void publish();
+
+  private:
+    SharedExport() = default;
+
+    void publish_state(double publish_start_ms);
+
+    struct ScriptCursor
+    {
+        SpelunkyScript* script;
+        uint64_t sequence;
+    };
+
+    void* mapping{nullptr};
+    SpelunkyExport* region{nullptr};
+    std::vector<ScriptCursor> scripts;
+    uint64_t message_head{0};
+    uint64_t messages_cut{0};
+    int64_t last_publish{0};
+    double frame_ms{0.0};
+    double script_ms{0.0};
+};
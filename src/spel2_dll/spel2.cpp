@@ -4,11 +4,13 @@
 #include "console.hpp"
 #include "entity.hpp"
 #include "file_api.hpp"
+#include "level_gen_batch.hpp"
 #include "memory.hpp"
 #include "render_api.hpp"
 #include "screen.hpp"
 #include "script.hpp"
 #include "search.hpp"
+#include "shared_export.hpp"
 #include "sound_manager.hpp"
 #include "spawn_api.hpp"
 #include "state.hpp"
@@ -20,6 +22,7 @@
 
 SoundManager* g_SoundManager{nullptr};
 SpelunkyConsole* g_Console{nullptr};
+PostDrawFunc g_PostDraw{nullptr};
 
 void Spelunky_SetDoHooks(bool do_hooks)
 {
@@ -100,9 +103,19 @@ void Spelunky_RegisterPreDrawFunc(PreDrawFunc pre_draw)
 {
     register_pre_draw(pre_draw);
 }
+// The export is published from the same hook, the host function runs right after
+static void export_post_draw()
+{
+    SharedExport::get().publish();
+    if (g_PostDraw)
+    {
+        g_PostDraw();
+    }
+}
 void Spelunky_RegisterPostDrawFunc(PostDrawFunc post_draw)
 {
-    register_post_draw(post_draw);
+    g_PostDraw = post_draw;
+    register_post_draw(&export_post_draw);
 }
 void Spelunky_RegisterOnQuitFunc(OnQuitFunc on_quit)
 {
@@ -202,12 +215,15 @@ SpelunkyScript* Spelunky_CreateScript(const char* file_path, bool enabled)
     std::string code = read_whole_file(file_path);
     if (!code.empty())
     {
-        return new SpelunkyScript(std::move(code), file_path, g_SoundManager, g_Console, enabled);
+        SpelunkyScript* script = new SpelunkyScript(std::move(code), file_path, g_SoundManager, g_Console, enabled);
+        SharedExport::get().add_script(script);
+        return script;
     }
     return nullptr;
 }
 void Spelunky_FreeScript(SpelunkyScript* script)
 {
+    SharedExport::get().remove_script(script);
     delete script;
 }
 
@@ -339,6 +355,10 @@ void SpelunkyConsole_SetMaxHistorySize(SpelunkyConsole* console, size_t max_hist
 {
     console->set_max_history_size(max_history);
 }
+void SpelunkyConsole_SetMaxHistoryBytes(SpelunkyConsole* console, size_t max_history_bytes)
+{
+    console->set_max_history_bytes(max_history_bytes);
+}
 void SpelunkyConsole_SaveHistory(SpelunkyConsole* console, const char* path)
 {
     console->save_history(path);
@@ -348,6 +368,20 @@ void SpelunkyConsole_LoadHistory(SpelunkyConsole* console, const char* path)
     console->load_history(path);
 }
 
+const SpelunkyExport* Spelunky_OpenExport(const char* name)
+{
+    const SpelunkyExport* region = SharedExport::get().open(name);
+    if (region != nullptr)
+    {
+        register_post_draw(&export_post_draw);
+    }
+    return region;
+}
+void Spelunky_CloseExport()
+{
+    SharedExport::get().close();
+}
+
 SpelunkyScreen SpelunkyState_GetScreen()
 {
     auto state = HeapBase::get().state();
@@ -359,6 +393,17 @@ int32_t Spelunky_SpawnEntity(uint32_t entity_id, int32_t layer, float x, float y
     return spawn_entity_abs(entity_id, x, y, (LAYER)layer, vel_x, vel_y);
 }
 
+bool Spelunky_RunLevelGenBatch(const Spelunky_LevelGenBatchJob* jobs, size_t num_jobs, const char* out_json_path)
+{
+    std::vector<LevelGenBatchJob> real_jobs;
+    real_jobs.reserve(num_jobs);
+    for (size_t i = 0; i < num_jobs; ++i)
+    {
+        real_jobs.push_back({jobs[i].seed, jobs[i].world, jobs[i].level, jobs[i].theme});
+    }
+    return run_level_gen_batch(real_jobs, out_json_path);
+}
+
 const char16_t* Spelunky_GetCharacterFullName(uint32_t character_index)
 {
     return NCharacterDB::get_character_full_name(character_index);
@@ -141,6 +141,7 @@ void SpelunkyConsole_ConsumeMessages(SpelunkyConsole* console, SpelunkyConsole_M
 
 bool SpelunkyConsole_HasNewHistory(SpelunkyConsole* console);
 void SpelunkyConsole_SetMaxHistorySize(SpelunkyConsole* console, size_t max_history);
+void SpelunkyConsole_SetMaxHistoryBytes(SpelunkyConsole* console, size_t max_history_bytes);
 void SpelunkyConsole_SaveHistory(SpelunkyConsole* console, const char* path);
 void SpelunkyConsole_LoadHistory(SpelunkyConsole* console, const char* path);
 
@@ -170,8 +171,77 @@ enum class SpelunkyScreen
 };
 SpelunkyScreen SpelunkyState_GetScreen();
 
+// Shared memory export, the DLL publishes script messages, a summary of the state and some perf counters into a mapped region
+// once per frame after drawing, hosts read it directly instead of polling the functions above, without calls or locks
+#define SPELUNKY_EXPORT_VERSION 1
+#define SPELUNKY_EXPORT_NUM_MESSAGES 256
+#define SPELUNKY_EXPORT_MESSAGE_SIZE 488
+
+struct SpelunkyExportMessage
+{
+    // Number of the message in the slot + 1, 0 while it's being written
+    // To read message n: check sequence == n + 1, copy the slot, check sequence is still n + 1, otherwise the writer lapped the reader
+    volatile uint64_t Sequence;
+    uint64_t TimeMilliSecond;
+    // The SpelunkyScript* the message belongs to
+    uint64_t Script;
+    // Real length of the message, only the first SPELUNKY_EXPORT_MESSAGE_SIZE - 1 bytes are in Text
+    uint32_t Length;
+    uint32_t Padding;
+    char Text[SPELUNKY_EXPORT_MESSAGE_SIZE];
+};
+
+struct SpelunkyExportState
+{
+    SpelunkyScreen Screen;
+    uint32_t Pause;
+    uint32_t TimeLevel;
+    uint32_t TimeTotal;
+    uint32_t TimeStartup;
+    uint32_t Seed;
+    uint8_t World;
+    uint8_t Level;
+    uint8_t Theme;
+    uint8_t Padding;
+    // Frames the DLL published so far
+    uint64_t Frames;
+    // Time between the last two publishes
+    double FrameMilliSecond;
+    // Time the last publish took
+    double PublishMilliSecond;
+    // Time spent in script callbacks per frame, averaged and only refreshed every 30 frames
+    double ScriptMilliSecond;
+    uint64_t MessagesCut;
+};
+
+struct SpelunkyExport
+{
+    uint32_t Version;
+    uint32_t Size;
+    // Odd while State is being written, read State between two equal even values
+    volatile uint64_t StateSequence;
+    SpelunkyExportState State;
+    // Number of messages published so far, the last SPELUNKY_EXPORT_NUM_MESSAGES of them are in Messages
+    volatile uint64_t MessageHead;
+    SpelunkyExportMessage Messages[SPELUNKY_EXPORT_NUM_MESSAGES];
+};
+
+// Creates the region, named so other processes can open it with OpenFileMapping or unnamed if name is null, returns null on failure
+// Calling it again returns the region that is already open
+const SpelunkyExport* Spelunky_OpenExport(const char* name);
+void Spelunky_CloseExport();
+
 int32_t Spelunky_SpawnEntity(uint32_t entity_id, int32_t layer, float x, float y, float vel_x, float vel_y);
 
+struct Spelunky_LevelGenBatchJob
+{
+    uint32_t seed;
+    uint8_t world;
+    uint8_t level;
+    uint8_t theme;
+};
+bool Spelunky_RunLevelGenBatch(const Spelunky_LevelGenBatchJob* jobs, size_t num_jobs, const char* out_json_path);
+
 const char16_t* Spelunky_GetCharacterFullName(uint32_t character_index);
 const char16_t* Spelunky_GetCharacterShortName(uint32_t character_index);
 void Spelunky_GetCharacterHeartColor(uint32_t character_index, float (&color)[4]);